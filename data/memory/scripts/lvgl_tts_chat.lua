@@ -9,43 +9,32 @@ function speak_and_play(response_text)
 
     println("LVGL AI: Generazione TTS per '" .. response_text .. "'")
 
-    local file_path = tts.speak(response_text)  -- Crea WAV in /sd/audio/
-    if not file_path then
-        println("Errore TTS - Mantieni testo LVGL")
+    -- Volume per chat (non disturbare)
+    radio.set_volume(60)
+
+    -- Riproduzione progressiva: parte mentre l'audio è ancora in download,
+    -- nessun file temporaneo da cancellare
+    local ok, err = tts.play(response_text)
+    if not ok then
+        println("Errore TTS - Mantieni testo LVGL: " .. tostring(err))
         return false
     end
 
-    println("TTS generato: " .. file_path)
+    println("Dettatura in corso")
 
-    -- Volume per chat (non disturbare)
-    radio.set_volume(60)
-
-    -- Play
-    local ok, msg = radio.play(file_path)
-    if ok then
-        println("Dettatura in corso: " .. file_path)
-
-        -- Opzionale: Poll per fine (screen status)
-        local attempts = 0
-        while attempts < 60 do  -- Max 60s
-            delay(1000)
-            local _, status = radio.status()
-            if string.find(status, "ENDED") or string.find(status, "STOPPED") then
-                break
-            end
-            attempts = attempts + 1
+    -- Opzionale: Poll per fine (screen status)
+    local attempts = 0
+    while attempts < 60 do  -- Max 60s
+        delay(1000)
+        local _, status = radio.status()
+        if string.find(status, "ENDED") or string.find(status, "STOPPED") then
+            break
         end
-
-        -- Cleanup
-        memory.delete_file(file_path)
-        println("Dettatura completata")
-        return true
-    else
-        println("Errore play: " .. msg)
-        -- Cleanup su errore
-        memory.delete_file(file_path)
-        return false
+        attempts = attempts + 1
     end
+
+    println("Dettatura completata")
+    return true
 end
 
 -- Esempio hook per screen (simula call dopo risposta)
@@ -111,6 +111,7 @@ private:
     /** FreeRTOS Task */
     static void schedulerTask(void* param);
     void checkAndRunEvents();
+    void publishMinute();
     void executeEvent(CalendarEvent& event);
 
     /** Time calculations */
@@ -138,6 +139,7 @@ private:
     TaskHandle_t task_handle_;
 
     uint16_t max_history_entries_ = 100;
+    time_t last_minute_published_ = 0;
 
     static constexpr const char* LOG_TAG = "TimeScheduler";
     static constexpr const char* STORAGE_PATH = "/calendar_events.json";
@@ -12,7 +12,8 @@ class Mp3SeekTable;
 enum class SourceType {
     LITTLEFS,
     SD_CARD,
-    HTTP_STREAM
+    HTTP_STREAM,
+    HTTP_RESPONSE   // Forward-only network audio: HTTP response body, pipelined TTS (no timeshift)
 };
 
 class IDataSource {
@@ -1,12 +1,16 @@
 #include "core/async_request_manager.h"
 
+#include <algorithm>
 #include <cstdio>
-#include <new>
+#include <cstdlib>
 
 #include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
+#include "core/cancel_token.h"
+#include "core/command_center.h"
+#include "core/http_client_pool.h"
 #include "core/settings_manager.h"
 #include "core/task_config.h"
 #include "core/voice_assistant.h"
@@ -18,15 +22,37 @@
 #define LOG_W(...) Logger::getInstance().warnf("[" LOG_TAG "] " __VA_ARGS__)
 #define LOG_E(...) Logger::getInstance().errorf("[" LOG_TAG "] " __VA_ARGS__)
 
+namespace {
+constexpr const char* kLocalEndpoint = "local";     // Commands run on the device
+constexpr const char* kTypeNames[] = {"stt", "llm", "tts", "command"};
+constexpr uint8_t kDefaultLaneLimits[] = {1, 2, 1, 2};   // LLM: one for background jobs, one kept for the rest
+
+size_t laneOf(AsyncRequestManager::RequestType type) {
+    return static_cast<size_t>(type);
+}
+
+uint32_t average(uint32_t current, uint32_t sample) {
+    return current == 0 ? sample : (current * 7 + sample) / 8;
+}
+} // namespace
+
+constexpr size_t AsyncRequestManager::kWorkers;
+constexpr uint8_t AsyncRequestManager::kDefaultEndpointLimit;
+
 AsyncRequestManager& AsyncRequestManager::getInstance() {
     static AsyncRequestManager instance;
     return instance;
 }
 
-AsyncRequestManager::AsyncRequestManager()
-    : request_queue_(nullptr),
-      worker_task_(nullptr),
-      cleanup_task_(nullptr) {
+AsyncRequestManager::AsyncRequestManager() {
+    for (size_t lane = 0; lane < RequestScheduler::kMaxLanes; ++lane) {
+        scheduler_.setLaneLimit(lane, kDefaultLaneLimits[lane]);
+    }
+    endpoints_[0] = kLocalEndpoint;
+    scheduler_.setEndpointLimit(0, kWorkers);
+    for (std::atomic<bool>& flag : cancel_flags_) {
+        flag.store(false);
+    }
 }
 
 AsyncRequestManager::~AsyncRequestManager() {
@@ -40,57 +66,37 @@ bool AsyncRequestManager::begin() {
     }
 
     LOG_I("Starting AsyncRequestManager...");
-
-    // Create request queue
-    request_queue_ = xQueueCreate(MAX_PENDING_REQUESTS, sizeof(PendingRequest*));
-    if (!request_queue_) {
-        LOG_E("Failed to create request queue");
-        return false;
-    }
-
     running_ = true;
 
-    // Create worker task
-    BaseType_t result = xTaskCreatePinnedToCore(
-        workerTask,
-        "async_worker",
-        TaskConfig::VOICE_ASSISTANT_STACK_SIZE,
-        this,
-        TaskConfig::VOICE_ASSISTANT_PRIORITY,
-        &worker_task_,
-        TaskConfig::VOICE_ASSISTANT_CORE
-    );
-
-    if (result != pdPASS) {
-        LOG_E("Failed to create worker task");
-        running_ = false;
-        vQueueDelete(request_queue_);
-        request_queue_ = nullptr;
-        return false;
+    size_t started = 0;
+    for (size_t i = 0; i < kWorkers; ++i) {
+        char name[16];
+        snprintf(name, sizeof(name), "async_worker%u", static_cast<unsigned>(i));
+        ++workers_alive_;
+        BaseType_t result = xTaskCreatePinnedToCore(
+            workerTask,
+            name,
+            TaskConfig::VOICE_ASSISTANT_STACK_SIZE,
+            this,
+            TaskConfig::VOICE_ASSISTANT_PRIORITY,
+            &workers_[i],
+            TaskConfig::VOICE_ASSISTANT_CORE
+        );
+        if (result != pdPASS) {
+            --workers_alive_;
+            workers_[i] = nullptr;
+            LOG_E("Failed to create worker task %u", static_cast<unsigned>(i));
+            continue;
+        }
+        ++started;
     }
 
-    // Create cleanup task
-    result = xTaskCreatePinnedToCore(
-        cleanupTask,
-        "async_cleanup",
-        2048,  // Small stack for cleanup
-        this,
-        1,  // Low priority
-        &cleanup_task_,
-        TaskConfig::VOICE_ASSISTANT_CORE
-    );
-
-    if (result != pdPASS) {
-        LOG_E("Failed to create cleanup task");
+    if (started == 0) {
         running_ = false;
-        vTaskDelete(worker_task_);
-        worker_task_ = nullptr;
-        vQueueDelete(request_queue_);
-        request_queue_ = nullptr;
         return false;
     }
 
-    LOG_I("Started successfully");
+    LOG_I("Started successfully (%u workers)", static_cast<unsigned>(started));
     return true;
 }
 
@@ -101,332 +107,545 @@ void AsyncRequestManager::end() {
 
     LOG_I("Stopping...");
     running_ = false;
+    for (std::atomic<bool>& flag : cancel_flags_) {
+        flag.store(true);   // Requests in flight give their workers back
+    }
+    wakeWorkers();
 
     const TickType_t wait_deadline = xTaskGetTickCount() + pdMS_TO_TICKS(1000);
-    while ((worker_task_ != nullptr || cleanup_task_ != nullptr) &&
-           xTaskGetTickCount() < wait_deadline) {
+    while (workers_alive_ > 0 && xTaskGetTickCount() < wait_deadline) {
         vTaskDelay(pdMS_TO_TICKS(10));
     }
 
-    if (worker_task_ != nullptr) {
-        vTaskDelete(worker_task_);
-        worker_task_ = nullptr;
-    }
-
-    if (cleanup_task_ != nullptr) {
-        vTaskDelete(cleanup_task_);
-        cleanup_task_ = nullptr;
-    }
-
-    // Clear queue and free pending messages
-    if (request_queue_) {
-        PendingRequest* pending = nullptr;
-        while (xQueueReceive(request_queue_, &pending, 0) == pdPASS) {
-            delete pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (TaskHandle_t& worker : workers_) {
+            if (worker != nullptr) {
+                vTaskDelete(worker);    // Still inside a request
+                worker = nullptr;
+            }
         }
-        vQueueDelete(request_queue_);
-        request_queue_ = nullptr;
-    }
+        workers_alive_ = 0;
 
-    // Clear results
-    {
-        std::lock_guard<std::mutex> lock(results_mutex_);
-        results_.clear();
+        // Forget every request, keep the limits
+        RequestScheduler fresh;
+        for (size_t lane = 0; lane < RequestScheduler::kMaxLanes; ++lane) {
+            fresh.setLaneLimit(lane, scheduler_.laneLimit(lane));
+        }
+        for (size_t endpoint = 0; endpoint < RequestScheduler::kMaxEndpoints; ++endpoint) {
+            fresh.setEndpointLimit(endpoint, scheduler_.endpointLimit(endpoint));
+        }
+        scheduler_ = fresh;
+        requests_.fill(Request());
     }
 
     LOG_I("Stopped");
 }
 
 bool AsyncRequestManager::submitRequest(const std::string& message, std::string& request_id) {
-    if (!running_ || request_queue_ == nullptr) {
+    return submitLLM(message, request_id, Priority::Interactive);
+}
+
+bool AsyncRequestManager::submitSTT(const std::string& audio_file, std::string& request_id,
+                                    Priority priority, uint32_t timeout_ms) {
+    return submit(RequestType::STT, audio_file, {}, priority, timeout_ms, request_id);
+}
+
+bool AsyncRequestManager::submitLLM(const std::string& text, std::string& request_id,
+                                    Priority priority, uint32_t timeout_ms) {
+    return submit(RequestType::LLM, text, {}, priority, timeout_ms, request_id);
+}
+
+bool AsyncRequestManager::submitTTS(const std::string& text, std::string& request_id,
+                                    Priority priority, uint32_t timeout_ms) {
+    return submit(RequestType::TTS, text, {}, priority, timeout_ms, request_id);
+}
+
+bool AsyncRequestManager::submitCommand(const std::string& command, const std::vector<std::string>& args,
+                                        std::string& request_id, Priority priority, uint32_t timeout_ms) {
+    return submit(RequestType::COMMAND, command, args, priority, timeout_ms, request_id);
+}
+
+bool AsyncRequestManager::submit(RequestType type, const std::string& input, const std::vector<std::string>& args,
+                                 Priority priority, uint32_t timeout_ms, std::string& request_id) {
+    if (!running_) {
         LOG_E("Not running");
         return false;
     }
 
-    if (message.empty()) {
-        LOG_E("Empty message");
+    if (input.empty()) {
+        LOG_E("Empty %s request", typeName(type));
         return false;
     }
 
     // Check if voice assistant is enabled
-    SettingsManager& settings = SettingsManager::getInstance();
-    if (!settings.getVoiceAssistantEnabled()) {
+    if (type != RequestType::COMMAND && !SettingsManager::getInstance().getVoiceAssistantEnabled()) {
         LOG_E("Voice assistant is disabled");
         return false;
     }
 
-    // Generate unique request ID
-    request_id = generateRequestId();
-
-    // Create pending request
-    PendingRequest* req = new (std::nothrow) PendingRequest();
-    if (!req) {
-        LOG_E("Failed to allocate pending request");
-        return false;
-    }
-    req->request_id = request_id;
-    req->message = message;
-    req->created_at_ms = getCurrentTimeMs();
-
-    // Create initial result entry
+    const uint64_t now = getCurrentTimeMs();
     {
-        std::lock_guard<std::mutex> lock(results_mutex_);
-
-        // Check if we have too many stored results
-        if (results_.size() >= MAX_STORED_RESULTS) {
-            LOG_W("Too many stored results, cleaning oldest...");
-            // This should be rare due to cleanup task, but handle it anyway
-            auto oldest = results_.begin();
-            for (auto it = results_.begin(); it != results_.end(); ++it) {
-                if (it->second.created_at_ms < oldest->second.created_at_ms) {
-                    oldest = it;
-                }
-            }
-            results_.erase(oldest);
+        std::lock_guard<std::mutex> lock(mutex_);
+        purgeLocked(now);
+        const RequestScheduler::Ticket ticket =
+            scheduler_.submit(static_cast<uint8_t>(laneOf(type)), endpointLocked(type), static_cast<uint8_t>(priority),
+                              static_cast<uint32_t>(now), timeout_ms ? timeout_ms : defaultTimeout(type));
+        if (ticket == RequestScheduler::kNoTicket) {
+            LOG_E("Failed to queue %s request (table full of pending or uncollected results)", typeName(type));
+            return false;
         }
 
-        RequestResult result;
-        result.status = RequestStatus::PENDING;
-        result.created_at_ms = req->created_at_ms;
-        result.completed_at_ms = 0;
-        results_[request_id] = result;
-    }
-
-    // Queue the request
-    if (xQueueSend(request_queue_, &req, 0) != pdPASS) {
-        LOG_E("Failed to queue request (queue full)");
-
-        // Remove from results
-        std::lock_guard<std::mutex> lock(results_mutex_);
-        results_.erase(request_id);
-        delete req;
-        return false;
+        cancel_flags_[RequestScheduler::slot(ticket)].store(false);
+        Request& request = requests_[RequestScheduler::slot(ticket)];
+        request = Request();
+        request.ticket = ticket;
+        request.input = input;
+        request.args = args;
+        request.priority = priority;
+        request.result.type = type;
+        request.result.created_at_ms = now;
+        request_id = formatId(ticket);
     }
 
-    LOG_I("Request %s queued: %s", request_id.c_str(), message.c_str());
+    wakeWorkers();
+    LOG_I("Request %s queued (%s): %s", request_id.c_str(), typeName(type), input.c_str());
     return true;
 }
 
 bool AsyncRequestManager::getRequestStatus(const std::string& request_id, RequestResult& result) {
-    std::lock_guard<std::mutex> lock(results_mutex_);
-
-    auto it = results_.find(request_id);
-    if (it == results_.end()) {
+    RequestScheduler::Ticket ticket;
+    if (!parseId(request_id, ticket)) {
         return false;
     }
 
-    result = it->second;
+    std::lock_guard<std::mutex> lock(mutex_);
+    scheduler_.expire(static_cast<uint32_t>(getCurrentTimeMs()));
+    RequestScheduler::Entry entry;
+    if (!scheduler_.get(ticket, entry)) {
+        return false;
+    }
+    refreshLocked(ticket);
+    result = requests_[RequestScheduler::slot(ticket)].result;
+    scheduler_.collect(ticket);     // Once finished, the slot may go to a new request
     return true;
 }
 
 bool AsyncRequestManager::cancelRequest(const std::string& request_id) {
-    std::lock_guard<std::mutex> lock(results_mutex_);
-
-    auto it = results_.find(request_id);
-    if (it == results_.end()) {
+    RequestScheduler::Ticket ticket;
+    if (!parseId(request_id, ticket)) {
         return false;
     }
 
-    // Can only cancel pending or processing requests
-    if (it->second.status != RequestStatus::PENDING &&
-        it->second.status != RequestStatus::PROCESSING) {
+    const uint64_t now = getCurrentTimeMs();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!scheduler_.cancel(ticket, static_cast<uint32_t>(now))) {
         return false;
     }
+    refreshLocked(ticket);
 
-    it->second.status = RequestStatus::FAILED;
-    it->second.error_message = "Cancelled by user";
-    it->second.completed_at_ms = getCurrentTimeMs();
+    // A running request notices within HttpClientPool::kCancelPollMs
+    cancel_flags_[RequestScheduler::slot(ticket)].store(true);
+    requests_[RequestScheduler::slot(ticket)].cancelled_at_ms = now;
 
     LOG_I("Request %s cancelled", request_id.c_str());
     return true;
 }
 
 size_t AsyncRequestManager::getPendingCount() const {
-    if (!request_queue_) {
-        return 0;
-    }
-    return uxQueueMessagesWaiting(request_queue_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    return scheduler_.queued();
 }
 
 size_t AsyncRequestManager::getProcessingCount() const {
-    std::lock_guard<std::mutex> lock(results_mutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    return scheduler_.running();
+}
+
+void AsyncRequestManager::setLaneLimit(RequestType type, uint8_t limit) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        scheduler_.setLaneLimit(laneOf(type), std::min<uint8_t>(limit, kWorkers));
+    }
+    wakeWorkers();
+}
 
-    size_t count = 0;
-    for (const auto& pair : results_) {
-        if (pair.second.status == RequestStatus::PROCESSING) {
-            count++;
+bool AsyncRequestManager::setEndpointLimit(const std::string& key, uint8_t limit) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const std::string host = key == kLocalEndpoint ? key : HttpClientPool::hostKey(key);
+        const int endpoint = findEndpointLocked(host, true);
+        if (endpoint < 0) {
+            return false;
+        }
+        endpoint_limits_[host] = limit;
+        scheduler_.setEndpointLimit(endpoint, limit);
+    }
+    wakeWorkers();
+    return true;
+}
+
+std::vector<AsyncRequestManager::LaneStats> AsyncRequestManager::getLaneStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<LaneStats> stats;
+    for (size_t lane = 0; lane < RequestScheduler::kMaxLanes; ++lane) {
+        LaneStats lane_stats;
+        lane_stats.type = static_cast<RequestType>(lane);
+        lane_stats.scheduler = scheduler_.laneStats(lane);
+        lane_stats.limit = scheduler_.laneLimit(lane);
+        lane_stats.aborted = aborts_[lane].count;
+        lane_stats.avg_abort_ms = aborts_[lane].avg_ms;
+        lane_stats.max_abort_ms = aborts_[lane].max_ms;
+        stats.push_back(lane_stats);
+    }
+    return stats;
+}
+
+std::vector<AsyncRequestManager::EndpointStats> AsyncRequestManager::getEndpointStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<EndpointStats> stats;
+    for (size_t endpoint = 0; endpoint < endpoints_.size(); ++endpoint) {
+        if (endpoints_[endpoint].empty()) {
+            continue;
         }
+        EndpointStats endpoint_stats;
+        endpoint_stats.key = endpoints_[endpoint];
+        endpoint_stats.running = scheduler_.endpointRunning(endpoint);
+        endpoint_stats.limit = scheduler_.endpointLimit(endpoint);
+        stats.push_back(endpoint_stats);
     }
-    return count;
+    return stats;
+}
+
+const char* AsyncRequestManager::typeName(RequestType type) {
+    return laneOf(type) < RequestScheduler::kMaxLanes ? kTypeNames[laneOf(type)] : "unknown";
+}
+
+bool AsyncRequestManager::parseType(const std::string& name, RequestType& type) {
+    for (size_t lane = 0; lane < RequestScheduler::kMaxLanes; ++lane) {
+        if (name == kTypeNames[lane]) {
+            type = static_cast<RequestType>(lane);
+            return true;
+        }
+    }
+    return false;
 }
 
 void AsyncRequestManager::workerTask(void* param) {
     AsyncRequestManager* manager = static_cast<AsyncRequestManager*>(param);
-    PendingRequest* request = nullptr;
 
     LOG_I("Worker task started");
 
     while (manager->running_) {
-        // Wait for a request (blocking with timeout)
-        if (xQueueReceive(manager->request_queue_, &request, pdMS_TO_TICKS(1000)) == pdPASS) {
-            if (request) {
-                LOG_I("Processing request %s", request->request_id.c_str());
-                manager->processRequest(*request);
-                delete request;
-                request = nullptr;
-            }
+        RequestScheduler::Ticket ticket;
+        Request request;
+        if (!manager->takeNext(ticket, request)) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WORKER_IDLE_WAIT_MS));
+            continue;
         }
 
-        // Yield to other tasks
-        vTaskDelay(pdMS_TO_TICKS(10));
+        const std::string request_id = formatId(ticket);
+        LOG_I("Processing %s request %s", typeName(request.result.type), request_id.c_str());
+        RequestResult result = request.result;
+        bool success = false;
+        {
+            // HTTP waits, downloads and Lua calls below give up once the request is cancelled or overdue
+            const CancelToken token(&manager->cancel_flags_[RequestScheduler::slot(ticket)], request.deadline_ms);
+            CancelToken::Scope cancel_scope(token);
+            manager->process(request, result, success);
+        }
+        manager->complete(ticket, result, success);
+
+        // The lane and endpoint slot just freed may unblock another worker's request
+        manager->wakeWorkers();
     }
 
     LOG_I("Worker task stopped");
-    manager->worker_task_ = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(manager->mutex_);
+        for (TaskHandle_t& worker : manager->workers_) {
+            if (worker == xTaskGetCurrentTaskHandle()) {
+                worker = nullptr;
+            }
+        }
+    }
+    --manager->workers_alive_;
     vTaskDelete(nullptr);
 }
 
-void AsyncRequestManager::cleanupTask(void* param) {
-    AsyncRequestManager* manager = static_cast<AsyncRequestManager*>(param);
-
-    LOG_I("Cleanup task started");
+bool AsyncRequestManager::takeNext(RequestScheduler::Ticket& ticket, Request& request) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint64_t now = getCurrentTimeMs();
 
-    while (manager->running_) {
-        vTaskDelay(pdMS_TO_TICKS(CLEANUP_INTERVAL_MS));
+    purgeLocked(now);
+    ticket = scheduler_.next(static_cast<uint32_t>(now));
+    if (ticket == RequestScheduler::kNoTicket) {
+        return false;
+    }
+    Request& stored = requests_[RequestScheduler::slot(ticket)];
+    RequestScheduler::Entry entry;
+    scheduler_.get(ticket, entry);
+    stored.result.status = RequestStatus::PROCESSING;
+    stored.result.started_at_ms = now;
+    stored.deadline_ms = entry.deadline_ms;
+    request = stored;
+    return true;
+}
 
-        std::lock_guard<std::mutex> lock(manager->results_mutex_);
+void AsyncRequestManager::complete(RequestScheduler::Ticket ticket, RequestResult& result, bool success) {
+    const uint64_t now = getCurrentTimeMs();
+    std::lock_guard<std::mutex> lock(mutex_);
+    scheduler_.expire(static_cast<uint32_t>(now));     // The deadline may be why the request stopped
+    RequestScheduler::Entry entry;
+    if (!scheduler_.get(ticket, entry)) {
+        return;     // Forgotten by end()
+    }
+    if (!scheduler_.finish(ticket, success, static_cast<uint32_t>(now))) {
+        // Timed out or cancelled while running: the caller already got that status
+        const Request& stored = requests_[RequestScheduler::slot(ticket)];
+        const uint32_t fired_ms = stored.cancelled_at_ms ? static_cast<uint32_t>(stored.cancelled_at_ms)
+                                                         : stored.deadline_ms;
+        const uint32_t elapsed = static_cast<uint32_t>(now) - fired_ms;
+        const uint32_t abort_ms = static_cast<int32_t>(elapsed) > 0 ? elapsed : 0;
+        AbortStats& aborts = aborts_[entry.lane];
+        ++aborts.count;
+        aborts.avg_ms = average(aborts.avg_ms, abort_ms);
+        aborts.max_ms = std::max(aborts.max_ms, abort_ms);
+        LOG_W("Request %s %s, worker free after %u ms", formatId(ticket).c_str(),
+              stored.cancelled_at_ms ? "cancelled" : "timed out", static_cast<unsigned>(abort_ms));
+        refreshLocked(ticket);
+        return;
+    }
 
-        uint64_t now = manager->getCurrentTimeMs();
-        auto it = manager->results_.begin();
+    result.status = success ? RequestStatus::COMPLETED : RequestStatus::FAILED;
+    result.completed_at_ms = now;
+    requests_[RequestScheduler::slot(ticket)].result = std::move(result);
+    LOG_I("Request %s %s in %u ms", formatId(ticket).c_str(), success ? "completed" : "failed",
+          static_cast<unsigned>(now - requests_[RequestScheduler::slot(ticket)].result.started_at_ms));
+}
 
-        while (it != manager->results_.end()) {
-            const RequestResult& result = it->second;
-            bool should_remove = false;
+void AsyncRequestManager::process(const Request& request, RequestResult& result, bool& success) {
+    if (request.result.type == RequestType::COMMAND) {
+        CommandResult command_result;
+        if (request.input == "lua_script" && !request.args.empty()) {
+            command_result = VoiceAssistant::getInstance().executeLuaScript(request.args[0]);
+        } else {
+            command_result = CommandCenter::getInstance().executeCommand(request.input, request.args);
+        }
+        success = command_result.success;
+        result.output = command_result.message;
+        if (!success) {
+            result.error_message = command_result.message;
+        }
+        return;
+    }
 
-            // Remove completed/failed requests older than TTL
-            if ((result.status == RequestStatus::COMPLETED ||
-                 result.status == RequestStatus::FAILED ||
-                 result.status == RequestStatus::TIMEOUT) &&
-                result.completed_at_ms > 0 &&
-                (now - result.completed_at_ms) > COMPLETED_REQUEST_TTL_MS) {
-                should_remove = true;
-                LOG_I("Removing expired request %s", it->first.c_str());
-            }
+    if (!ensureAssistant(result)) {
+        success = false;
+        return;
+    }
 
-            // Timeout stuck requests
-            if ((result.status == RequestStatus::PENDING ||
-                 result.status == RequestStatus::PROCESSING) &&
-                (now - result.created_at_ms) > REQUEST_TIMEOUT_MS) {
-                LOG_W("Request %s timed out", it->first.c_str());
-                it->second.status = RequestStatus::TIMEOUT;
-                it->second.error_message = "Request processing timeout";
-                it->second.completed_at_ms = now;
+    VoiceAssistant& assistant = VoiceAssistant::getInstance();
+    switch (request.result.type) {
+        case RequestType::STT:
+            success = assistant.transcribeFile(request.input, result.output) && !result.output.empty();
+            if (!success) {
+                result.error_message = "Speech to text failed";
             }
-
-            if (should_remove) {
-                it = manager->results_.erase(it);
+            break;
+        case RequestType::LLM:
+            // Background jobs stay out of the chat; the others join it under the LLM lock
+            success = assistant.processText(request.input, result.response,
+                                            request.priority == Priority::Background
+                                                ? VoiceAssistant::TextTurn::Detached
+                                                : VoiceAssistant::TextTurn::Record);
+            if (success) {
+                result.output = result.response.text;
             } else {
-                ++it;
+                result.error_message = "No response from voice assistant";
             }
-        }
+            break;
+        case RequestType::TTS:
+            success = assistant.synthesizeToFile(request.input, result.output);
+            if (!success) {
+                result.error_message = "TTS synthesis failed";
+            }
+            break;
+        default:
+            success = false;
+            result.error_message = "Unknown request type";
+            break;
     }
-
-    LOG_I("Cleanup task stopped");
-    manager->cleanup_task_ = nullptr;
-    vTaskDelete(nullptr);
 }
 
-void AsyncRequestManager::processRequest(const PendingRequest& request) {
-    // Update status to processing
-    {
-        std::lock_guard<std::mutex> lock(results_mutex_);
-        auto it = results_.find(request.request_id);
-        if (it != results_.end()) {
-            it->second.status = RequestStatus::PROCESSING;
-        }
-    }
+bool AsyncRequestManager::ensureAssistant(RequestResult& result) {
+    std::lock_guard<std::mutex> lock(assistant_mutex_);
 
     // Initialize voice assistant if needed
     VoiceAssistant& assistant = VoiceAssistant::getInstance();
-    if (!assistant.isInitialized()) {
-        LOG_I("Initializing VoiceAssistant for request %s", request.request_id.c_str());
-
-        // Suspend LVGL to free DRAM
-        LVGLPowerMgr.switchToVoiceMode();
-        vTaskDelay(pdMS_TO_TICKS(100));
-
-        if (!assistant.begin()) {
-            LOG_E("Failed to initialize VoiceAssistant");
-
-            // Resume LVGL on failure
-            LVGLPowerMgr.switchToUIMode();
-
-            // Mark as failed
-            std::lock_guard<std::mutex> lock(results_mutex_);
-            auto it = results_.find(request.request_id);
-            if (it != results_.end()) {
-                it->second.status = RequestStatus::FAILED;
-                it->second.error_message = "Voice assistant initialization failed";
-                it->second.completed_at_ms = getCurrentTimeMs();
-            }
-            return;
-        }
+    if (assistant.isInitialized()) {
+        return true;
+    }
+
+    LOG_I("Initializing VoiceAssistant");
+
+    // Suspend LVGL to free DRAM
+    LVGLPowerMgr.switchToVoiceMode();
+    vTaskDelay(pdMS_TO_TICKS(100));
+
+    if (!assistant.begin()) {
+        LOG_E("Failed to initialize VoiceAssistant");
 
-        LOG_I("VoiceAssistant initialized successfully");
+        // Resume LVGL on failure
+        LVGLPowerMgr.switchToUIMode();
+        result.error_message = "Voice assistant initialization failed";
+        return false;
     }
 
-    // Send message to voice assistant
-    if (!assistant.sendTextMessage(request.message)) {
-        LOG_E("Failed to send message to VoiceAssistant");
+    LOG_I("VoiceAssistant initialized successfully");
+    return true;
+}
 
-        std::lock_guard<std::mutex> lock(results_mutex_);
-        auto it = results_.find(request.request_id);
-        if (it != results_.end()) {
-            it->second.status = RequestStatus::FAILED;
-            it->second.error_message = "Failed to send message to voice assistant";
-            it->second.completed_at_ms = getCurrentTimeMs();
+void AsyncRequestManager::purgeLocked(uint64_t now) {
+    if (scheduler_.purge(static_cast<uint32_t>(now), COMPLETED_REQUEST_TTL_MS) == 0) {
+        return;
+    }
+    RequestScheduler::Entry entry;
+    for (Request& stored : requests_) {
+        if (stored.ticket != RequestScheduler::kNoTicket && !scheduler_.get(stored.ticket, entry)) {
+            stored = Request();
         }
+    }
+}
+
+void AsyncRequestManager::refreshLocked(RequestScheduler::Ticket ticket) {
+    RequestScheduler::Entry entry;
+    if (!scheduler_.get(ticket, entry)) {
         return;
     }
 
-    // Wait for response (with no timeout - handled by cleanup task)
-    VoiceAssistant::VoiceCommand response;
-    if (!assistant.getLastResponse(response, REQUEST_TIMEOUT_MS)) {
-        LOG_E("No response from VoiceAssistant for request %s", request.request_id.c_str());
+    RequestResult& result = requests_[RequestScheduler::slot(ticket)].result;
+    switch (entry.state) {
+        case RequestScheduler::State::Queued:
+            result.status = RequestStatus::PENDING;
+            break;
+        case RequestScheduler::State::Running:
+            result.status = RequestStatus::PROCESSING;
+            break;
+        case RequestScheduler::State::TimedOut:
+            if (result.status != RequestStatus::TIMEOUT) {
+                LOG_W("Request %s timed out", formatId(ticket).c_str());
+                result.status = RequestStatus::TIMEOUT;
+                result.error_message = "Request processing timeout";
+                result.completed_at_ms = getCurrentTimeMs();
+            }
+            break;
+        case RequestScheduler::State::Cancelled:
+            if (result.status != RequestStatus::FAILED) {
+                result.status = RequestStatus::FAILED;
+                result.error_message = "Cancelled by user";
+                result.completed_at_ms = getCurrentTimeMs();
+            }
+            break;
+        default:
+            break;      // Done / Failed: set by complete()
+    }
+}
+
+uint8_t AsyncRequestManager::endpointLocked(RequestType type) {
+    if (type == RequestType::COMMAND) {
+        return 0;
+    }
+
+    const SettingsSnapshot& settings = SettingsManager::getInstance().getSnapshot();
+    const bool local = settings.localApiMode;
+    std::string url;
+    switch (type) {
+        case RequestType::STT:
+            url = local ? settings.whisperLocalEndpoint : settings.whisperCloudEndpoint;
+            break;
+        case RequestType::LLM:
+            url = local ? settings.llmLocalEndpoint : settings.llmCloudEndpoint;
+            break;
+        default:
+            url = local ? settings.ttsLocalEndpoint : settings.ttsCloudEndpoint;
+            break;
+    }
+
+    const int endpoint = findEndpointLocked(HttpClientPool::hostKey(url), true);
+    return endpoint < 0 ? 0 : static_cast<uint8_t>(endpoint);
+}
 
-        std::lock_guard<std::mutex> lock(results_mutex_);
-        auto it = results_.find(request.request_id);
-        if (it != results_.end()) {
-            it->second.status = RequestStatus::FAILED;
-            it->second.error_message = "No response from voice assistant";
-            it->second.completed_at_ms = getCurrentTimeMs();
+int AsyncRequestManager::findEndpointLocked(const std::string& key, bool create) {
+    for (size_t endpoint = 0; endpoint < endpoints_.size(); ++endpoint) {
+        if (endpoints_[endpoint] == key) {
+            return static_cast<int>(endpoint);
         }
-        return;
+    }
+    if (!create) {
+        return -1;
     }
 
-    // Success! Store the result
-    {
-        std::lock_guard<std::mutex> lock(results_mutex_);
-        auto it = results_.find(request.request_id);
-        if (it != results_.end()) {
-            it->second.status = RequestStatus::COMPLETED;
-            it->second.response = response;
-            it->second.completed_at_ms = getCurrentTimeMs();
-
-            LOG_I("Request %s completed successfully", request.request_id.c_str());
+    // A free entry, else one with nothing running or queued (its server was reconfigured away)
+    int chosen = -1;
+    for (size_t endpoint = 1; endpoint < endpoints_.size() && chosen < 0; ++endpoint) {
+        if (endpoints_[endpoint].empty()) {
+            chosen = static_cast<int>(endpoint);
+        }
+    }
+    for (size_t endpoint = 1; endpoint < endpoints_.size() && chosen < 0; ++endpoint) {
+        if (scheduler_.endpointRunning(endpoint) == 0 && scheduler_.endpointQueued(endpoint) == 0) {
+            LOG_I("Endpoint %s replaced by %s", endpoints_[endpoint].c_str(), key.c_str());
+            chosen = static_cast<int>(endpoint);
         }
     }
+    if (chosen < 0) {
+        return -1;
+    }
+
+    endpoints_[chosen] = key;
+    const auto configured = endpoint_limits_.find(key);
+    scheduler_.setEndpointLimit(chosen,
+                                configured != endpoint_limits_.end() ? configured->second : kDefaultEndpointLimit);
+    return chosen;
 }
 
-std::string AsyncRequestManager::generateRequestId() {
-    uint32_t counter = request_counter_.fetch_add(1);
-    uint64_t timestamp = getCurrentTimeMs();
+void AsyncRequestManager::wakeWorkers() {
+    for (TaskHandle_t worker : workers_) {
+        if (worker != nullptr) {
+            xTaskNotifyGive(worker);
+        }
+    }
+}
 
-    char buffer[64];
-    snprintf(buffer, sizeof(buffer), "req_%llu_%u", timestamp, counter);
+std::string AsyncRequestManager::formatId(RequestScheduler::Ticket ticket) {
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "req_%u", static_cast<unsigned>(ticket));
     return std::string(buffer);
 }
 
+bool AsyncRequestManager::parseId(const std::string& request_id, RequestScheduler::Ticket& ticket) {
+    if (request_id.compare(0, 4, "req_") != 0) {
+        return false;
+    }
+    char* end = nullptr;
+    const unsigned long value = std::strtoul(request_id.c_str() + 4, &end, 10);
+    if (end == request_id.c_str() + 4 || *end != '\0') {
+        return false;
+    }
+    ticket = static_cast<RequestScheduler::Ticket>(value);
+    return ticket != RequestScheduler::kNoTicket;
+}
+
+uint32_t AsyncRequestManager::defaultTimeout(RequestType type) {
+    switch (type) {
+        case RequestType::STT: return 60000;
+        case RequestType::LLM: return 180000;   // 3 minutes max per LLM request
+        case RequestType::TTS: return 60000;
+        default: return 30000;
+    }
+}
+
 uint64_t AsyncRequestManager::getCurrentTimeMs() const {
     return esp_timer_get_time() / 1000;
 }
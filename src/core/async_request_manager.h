@@ -2,38 +2,88 @@
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
-#include <freertos/queue.h>
 
+#include <array>
 #include <atomic>
+#include <map>
 #include <mutex>
 #include <string>
-#include <unordered_map>
-#include <memory>
+#include <vector>
 
 #include "core/voice_assistant.h"
+#include "utils/request_scheduler.h"
 
 /**
  * Async Request Manager
- * Manages asynchronous LLM requests without blocking the web server
+ * Runs STT, LLM, TTS and command requests on a small pool of workers
+ * without blocking the web server or the UI.
+ *
+ * Each request type is a lane with its own concurrency limit, and requests
+ * calling the same server (scheme://host:port of the configured endpoint)
+ * share that endpoint's limit, so a long LLM call occupies one worker while
+ * commands and TTS keep flowing on the others. Within what may run, higher
+ * priority goes first, then the earliest deadline (see RequestScheduler).
+ * Background requests never take the last slot of a lane or server, so the
+ * LLM lane's second slot stays free for someone waiting on a reply.
+ *
+ * A request runs under a CancelToken (its cancel flag and deadline), so
+ * cancelRequest() or the deadline aborts its HTTP wait within
+ * HttpClientPool::kCancelPollMs and frees the worker; the time from either to
+ * the worker being idle again is reported per lane.
+ *
+ * Results are kept in a fixed table of RequestScheduler::kMaxRequests slots;
+ * request ids name the slot, so lookups are O(1) and a stale id never matches
+ * a newer request. A finished result is kept until getRequestStatus() has
+ * returned it or COMPLETED_REQUEST_TTL_MS passes; while the table is full of
+ * such results, new requests are refused rather than evicting one.
  */
 class AsyncRequestManager {
 public:
+    using RequestType = VoiceAssistant::RequestType;
+
     enum class RequestStatus {
         PENDING,    // Request queued, waiting to be processed
-        PROCESSING, // Currently being processed by LLM
+        PROCESSING, // Currently being processed
         COMPLETED,  // Successfully completed
-        FAILED,     // Failed with error
-        TIMEOUT     // Request timed out
+        FAILED,     // Failed with error (or cancelled)
+        TIMEOUT     // Request passed its deadline
+    };
+
+    enum class Priority : uint8_t {
+        Background,     // Scheduled jobs, prefetch
+        Normal,
+        Interactive     // Someone is waiting on the screen or the web page
     };
 
     struct RequestResult {
-        RequestStatus status;
-        VoiceAssistant::VoiceCommand response;
+        RequestType type = RequestType::LLM;
+        RequestStatus status = RequestStatus::PENDING;
+        VoiceAssistant::VoiceCommand response;     // LLM requests
+        std::string output;             // Transcription, audio file path or command output
         std::string error_message;
-        uint64_t created_at_ms;
-        uint64_t completed_at_ms;
+        uint64_t created_at_ms = 0;
+        uint64_t started_at_ms = 0;
+        uint64_t completed_at_ms = 0;
+    };
+
+    struct LaneStats {
+        RequestType type;
+        RequestScheduler::LaneStats scheduler;
+        uint8_t limit = 0;
+        uint32_t aborted = 0;           // Running requests cancelled or past their deadline
+        uint32_t avg_abort_ms = 0;      // Cancel (or deadline) to worker idle
+        uint32_t max_abort_ms = 0;
+    };
+
+    struct EndpointStats {
+        std::string key;
+        uint8_t running = 0;
+        uint8_t limit = 0;
     };
 
+    static constexpr size_t kWorkers = 3;
+    static constexpr uint8_t kDefaultEndpointLimit = 2;
+
     static AsyncRequestManager& getInstance();
 
     bool begin();
@@ -41,13 +91,29 @@ public:
     bool isRunning() const { return running_; }
 
     /**
-     * Submit a new async request
+     * Submit a chat message for the LLM (interactive priority)
      * @param message User message to send to LLM
      * @param request_id Output parameter for the generated request ID
      * @return true if request was queued successfully
      */
     bool submitRequest(const std::string& message, std::string& request_id);
 
+    /**
+     * Queue a request of each type. An LLM request joins the conversation
+     * unless it is Background, which runs without history and stays out of
+     * the chat.
+     * @param timeout_ms Deadline from now, 0 for the type's default
+     * @return true if queued; request_id then names it for getRequestStatus()
+     */
+    bool submitSTT(const std::string& audio_file, std::string& request_id,
+                   Priority priority = Priority::Normal, uint32_t timeout_ms = 0);
+    bool submitLLM(const std::string& text, std::string& request_id,
+                   Priority priority = Priority::Normal, uint32_t timeout_ms = 0);
+    bool submitTTS(const std::string& text, std::string& request_id,
+                   Priority priority = Priority::Normal, uint32_t timeout_ms = 0);
+    bool submitCommand(const std::string& command, const std::vector<std::string>& args, std::string& request_id,
+                       Priority priority = Priority::Normal, uint32_t timeout_ms = 0);
+
     /**
      * Check the status of a request
      * @param request_id The request ID to check
@@ -73,51 +139,83 @@ public:
      */
     size_t getProcessingCount() const;
 
+    /** Concurrency of a request type (1..kWorkers) */
+    void setLaneLimit(RequestType type, uint8_t limit);
+
+    /**
+     * Concurrency towards one server, keyed like "http://192.168.1.51:11434"
+     * (kDefaultEndpointLimit until set). Kept for the key even when its slot is
+     * later given to another server.
+     */
+    bool setEndpointLimit(const std::string& key, uint8_t limit);
+
+    std::vector<LaneStats> getLaneStats() const;
+    std::vector<EndpointStats> getEndpointStats() const;
+
+    static const char* typeName(RequestType type);
+    static bool parseType(const std::string& name, RequestType& type);
+
 private:
     AsyncRequestManager();
     ~AsyncRequestManager();
     AsyncRequestManager(const AsyncRequestManager&) = delete;
     AsyncRequestManager& operator=(const AsyncRequestManager&) = delete;
 
-    struct PendingRequest {
-        std::string request_id;
-        std::string message;
-        uint64_t created_at_ms;
+    struct Request {
+        RequestScheduler::Ticket ticket = RequestScheduler::kNoTicket;
+        std::string input;              // Audio file, text or command name
+        std::vector<std::string> args;
+        Priority priority = Priority::Normal;
+        RequestResult result;
+        uint32_t deadline_ms = 0;
+        uint64_t cancelled_at_ms = 0;
+    };
+
+    struct AbortStats {
+        uint32_t count = 0;
+        uint32_t avg_ms = 0;
+        uint32_t max_ms = 0;
     };
 
     // Worker task that processes requests asynchronously
     static void workerTask(void* param);
 
-    // Cleanup task that removes expired completed requests
-    static void cleanupTask(void* param);
-
-    // Generate unique request ID
-    std::string generateRequestId();
+    bool submit(RequestType type, const std::string& input, const std::vector<std::string>& args,
+                Priority priority, uint32_t timeout_ms, std::string& request_id);
+    bool takeNext(RequestScheduler::Ticket& ticket, Request& request);
+    void complete(RequestScheduler::Ticket ticket, RequestResult& result, bool success);
+    void process(const Request& request, RequestResult& result, bool& success);
+    bool ensureAssistant(RequestResult& result);
+
+    // Sync a slot's status with the scheduler (timeouts, cancellation); lock held
+    void refreshLocked(RequestScheduler::Ticket ticket);
+    // Drop results nobody collected within COMPLETED_REQUEST_TTL_MS; lock held
+    void purgeLocked(uint64_t now);
+    uint8_t endpointLocked(RequestType type);
+    int findEndpointLocked(const std::string& key, bool create);
+    void wakeWorkers();
+
+    static std::string formatId(RequestScheduler::Ticket ticket);
+    static bool parseId(const std::string& request_id, RequestScheduler::Ticket& ticket);
+    static uint32_t defaultTimeout(RequestType type);
 
     // Get current timestamp in milliseconds
     uint64_t getCurrentTimeMs() const;
 
-    // Internal processing
-    void processRequest(const PendingRequest& request);
-
-    // Storage for pending and completed requests
-    std::unordered_map<std::string, RequestResult> results_;
-    mutable std::mutex results_mutex_;
-
-    // Queue for pending requests
-    QueueHandle_t request_queue_;
-
-    // Worker task handle
-    TaskHandle_t worker_task_;
-    TaskHandle_t cleanup_task_;
-
+    RequestScheduler scheduler_;
+    std::array<Request, RequestScheduler::kMaxRequests> requests_;
+    std::array<std::string, RequestScheduler::kMaxEndpoints> endpoints_;
+    std::map<std::string, uint8_t> endpoint_limits_;   // Set by setEndpointLimit(), kept across slot reuse
+    std::array<std::atomic<bool>, RequestScheduler::kMaxRequests> cancel_flags_;    // Per slot
+    std::array<AbortStats, RequestScheduler::kMaxLanes> aborts_{};
+    mutable std::mutex mutex_;
+    std::mutex assistant_mutex_;            // Serializes VoiceAssistant start-up
+
+    std::array<TaskHandle_t, kWorkers> workers_{};
+    std::atomic<size_t> workers_alive_{0};
     std::atomic<bool> running_{false};
-    std::atomic<uint32_t> request_counter_{0};
 
     // Configuration
-    static constexpr size_t MAX_PENDING_REQUESTS = 10;
-    static constexpr size_t MAX_STORED_RESULTS = 50;
-    static constexpr uint32_t CLEANUP_INTERVAL_MS = 30000;  // 30 seconds
     static constexpr uint32_t COMPLETED_REQUEST_TTL_MS = 300000;  // 5 minutes
-    static constexpr uint32_t REQUEST_TIMEOUT_MS = 180000;  // 3 minutes max per request
+    static constexpr uint32_t WORKER_IDLE_WAIT_MS = 1000;
 };
@@ -1,5 +1,7 @@
 #include "audio_manager.h"
+#include "microphone_manager.h"
 #include "utils/logger.h"
+#include "core/event_router.h"
 #include "drivers/sd_card_driver.h"
 
 AudioManager& AudioManager::getInstance() {
@@ -59,6 +61,9 @@ bool AudioManager::playFile(const char* path, uint32_t expected_sample_rate, uin
     auto& logger = Logger::getInstance();
     logger.infof("[AudioMgr] Playing file: %s (expected sr=%u, br=%u)", path, expected_sample_rate, expected_bitrate);
 
+    // Background wake-word capture holds I2S_NUM_1; take it back before starting the player
+    MicrophoneManager::getInstance().preemptBackgroundRecording();
+
     // Stop current playback
     if (player_->is_playing()) {
         player_->stop();
@@ -117,6 +122,8 @@ bool AudioManager::playRadio(const char* url, uint32_t expected_sample_rate, uin
     auto& logger = Logger::getInstance();
     logger.infof("[AudioMgr] Starting radio stream: %s (expected sr=%u, br=%u)", url, expected_sample_rate, expected_bitrate);
 
+    MicrophoneManager::getInstance().preemptBackgroundRecording();
+
     // Stop current playback
     if (player_->is_playing()) {
         player_->stop();
@@ -207,6 +214,50 @@ bool AudioManager::playRadio(const char* url, uint32_t expected_sample_rate, uin
     return true;
 }
 
+bool AudioManager::playSource(std::unique_ptr<IDataSource> source, uint32_t expected_sample_rate) {
+    if (!source) return false;
+
+    auto& logger = Logger::getInstance();
+    const std::string uri = source->uri() ? source->uri() : "";
+    logger.infof("[AudioMgr] Playing source: %s (expected sr=%u)", uri.c_str(), expected_sample_rate);
+
+    MicrophoneManager::getInstance().preemptBackgroundRecording();
+
+    // Stop current playback
+    if (player_->is_playing()) {
+        player_->stop();
+        vTaskDelay(pdMS_TO_TICKS(300));
+    }
+
+    player_->select_source(std::move(source));
+
+    if (!player_->arm_source()) {
+        logger.errorf("[AudioMgr] Failed to arm source %s", uri.c_str());
+        return false;
+    }
+
+    player_->start();
+
+    if (player_->state() != PlayerState::PLAYING) {
+        logger.errorf("[AudioMgr] Failed to start playback of %s", uri.c_str());
+        return false;
+    }
+
+    uint32_t detected_sr = player_->current_sample_rate();
+    logger.infof("[AudioMgr] Source playback started: sr=%u Hz", detected_sr);
+
+    if (expected_sample_rate > 0 && detected_sr != expected_sample_rate) {
+        logger.warnf("[AudioMgr] Sample rate mismatch: detected %u != expected %u.", detected_sr, expected_sample_rate);
+    }
+    if (detected_sr == 0 || detected_sr > 96000) {
+        logger.errorf("[AudioMgr] Invalid sample rate detected (%u Hz).", detected_sr);
+        player_->stop();
+        return false;
+    }
+
+    return true;
+}
+
 bool AudioManager::playRadioStation(size_t station_index) {
     if (station_index >= radio_stations_.size()) {
         return false;
@@ -328,6 +379,12 @@ void AudioManager::onMetadata(const Metadata& meta, const char* path) {
     if (instance.metadata_callback_) {
         instance.metadata_callback_(meta);
     }
+
+    // Stream titles (ICY) and ID3 tags, for events.on("audio.title", ...) in scripts
+    if (meta.title.length() > 0) {
+        String title = meta.artist.length() > 0 ? meta.artist + " - " + meta.title : meta.title;
+        EventRouter::getInstance()->publish("audio.title", const_cast<char*>(title.c_str()));
+    }
 }
 
 void AudioManager::onStart(const char* path) {
@@ -33,6 +33,8 @@ public:
     bool playFile(const char* path, uint32_t expected_sample_rate = 0, uint32_t expected_bitrate = 0);
     bool playRadio(const char* url, uint32_t expected_sample_rate = 0, uint32_t expected_bitrate = 0);
     bool playRadioStation(size_t station_index);
+    // Play an already-open source (e.g. an in-flight HTTP response); ownership moves to the player
+    bool playSource(std::unique_ptr<IDataSource> source, uint32_t expected_sample_rate = 0);
     void stop();
     void togglePause();
     void setPause(bool pause);
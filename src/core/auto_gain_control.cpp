@@ -0,0 +1,111 @@
+#include "auto_gain_control.h"
+
+#include <algorithm>
+
+namespace {
+
+inline int32_t blockPeak(const int16_t* samples, size_t count) {
+    int32_t peak = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const int32_t value = samples[i];
+        const int32_t magnitude = value < 0 ? -value : value;
+        peak = magnitude > peak ? magnitude : peak;
+    }
+    return peak;
+}
+
+} // namespace
+
+AutoGainControl::AutoGainControl() {
+    configure(Config());
+}
+
+AutoGainControl::AutoGainControl(const Config& config) {
+    configure(config);
+}
+
+void AutoGainControl::configure(const Config& config) {
+    config_ = config;
+    config_.min_gain_q10 = std::max<int32_t>(1, config_.min_gain_q10);
+    config_.max_gain_q10 = std::max(config_.min_gain_q10, config_.max_gain_q10);
+    config_.limiter_knee = std::min<int32_t>(std::max<int32_t>(1, config_.limiter_knee), 32766);
+    reset();
+}
+
+void AutoGainControl::reset() {
+    envelope_ = 0;
+    gain_q10_ = kUnityGain;
+}
+
+int32_t AutoGainControl::computeTargetGain(bool& gated) const {
+    gated = envelope_ < config_.gate_threshold;
+    if (gated) {
+        return config_.gate_gain_q10;
+    }
+    const int32_t target = static_cast<int32_t>((static_cast<int64_t>(config_.target_peak) << 10) / envelope_);
+    return std::min(config_.max_gain_q10, std::max(config_.min_gain_q10, target));
+}
+
+int32_t AutoGainControl::smoothGain(int32_t target) const {
+    if (target < gain_q10_) {
+        const int32_t step = std::max<int32_t>(1, (gain_q10_ - target) >> config_.attack_shift);
+        return gain_q10_ - step;
+    }
+    if (target > gain_q10_) {
+        const int32_t step = std::max<int32_t>(1, (target - gain_q10_) >> config_.release_shift);
+        return gain_q10_ + step;
+    }
+    return gain_q10_;
+}
+
+int32_t AutoGainControl::softLimit(int32_t value) const {
+    const int32_t magnitude = value < 0 ? -value : value;
+    if (magnitude <= config_.limiter_knee) {
+        return value;
+    }
+    // Rational knee: approaches full scale asymptotically, never clips
+    const int64_t range = 32767 - config_.limiter_knee;
+    const int64_t over = magnitude - config_.limiter_knee;
+    const int32_t limited = config_.limiter_knee + static_cast<int32_t>((over * range) / (over + range));
+    return value < 0 ? -limited : limited;
+}
+
+AutoGainControl::Stats AutoGainControl::process(int16_t* samples, size_t count) {
+    Stats stats;
+    int32_t peak_in = 0;
+    int32_t peak_out = 0;
+    bool gated = false;
+
+    for (size_t offset = 0; offset < count; offset += kBlockSamples) {
+        const size_t block = std::min(kBlockSamples, count - offset);
+        int16_t* data = samples + offset;
+
+        const int32_t peak = blockPeak(data, block);
+        peak_in = std::max(peak_in, peak);
+
+        if (peak > envelope_) {
+            envelope_ = peak;
+        } else {
+            envelope_ -= (envelope_ - peak) >> config_.envelope_release_shift;
+        }
+
+        const int32_t start_gain = gain_q10_;
+        gain_q10_ = smoothGain(computeTargetGain(gated));
+        const int32_t delta = gain_q10_ - start_gain;
+
+        for (size_t i = 0; i < block; ++i) {
+            // Linear ramp over a full block; a short tail block simply stops early
+            const int32_t gain = start_gain + ((delta * static_cast<int32_t>(i + 1)) >> kBlockShift);
+            const int32_t scaled = softLimit((static_cast<int32_t>(data[i]) * gain) >> 10);
+            data[i] = static_cast<int16_t>(scaled);
+            const int32_t magnitude = scaled < 0 ? -scaled : scaled;
+            peak_out = magnitude > peak_out ? magnitude : peak_out;
+        }
+    }
+
+    stats.peak_in = static_cast<uint16_t>(std::min<int32_t>(peak_in, 32767));
+    stats.peak_out = static_cast<uint16_t>(std::min<int32_t>(peak_out, 32767));
+    stats.gain_q10 = gain_q10_;
+    stats.gated = gated;
+    return stats;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Fixed-point Automatic Gain Control for 16-bit mono capture
+ *
+ * Processing per 64-sample block:
+ * - Peak envelope follower (instant attack, exponential release)
+ * - Target gain = target_peak / envelope, clamped to [min_gain, max_gain]
+ * - Gain smoothing with separate attack (gain down) and release (gain up) rates
+ * - Noise gate: below gate_threshold the gain moves towards gate_gain instead
+ *   of boosting background noise
+ * - Gain ramped linearly across the block (no zipper noise), then a soft-knee
+ *   limiter instead of hard clipping
+ *
+ * Integer-only inner loops with no calls or per-sample divisions on the common
+ * path, so the compiler can vectorize them on the ESP32-S3.
+ */
+class AutoGainControl {
+public:
+    static constexpr int32_t kUnityGain = 1 << 10;  // Q10
+    static constexpr size_t kBlockShift = 6;
+    static constexpr size_t kBlockSamples = 1 << kBlockShift;
+
+    struct Config {
+        int32_t target_peak = 26000;       // Leaves headroom for the limiter knee
+        int32_t max_gain_q10 = 20 * kUnityGain;
+        int32_t min_gain_q10 = kUnityGain;
+        uint8_t attack_shift = 1;          // Gain reduction: 1/2 of the error per block
+        uint8_t release_shift = 5;         // Gain increase: 1/32 of the error per block
+        uint8_t envelope_release_shift = 4;
+        int32_t gate_threshold = 250;      // Envelope below this (~-42 dBFS) is treated as noise
+        int32_t gate_gain_q10 = kUnityGain / 2;
+        int32_t limiter_knee = 24576;      // Soft limiting starts at -2.5 dBFS
+    };
+
+    /**
+     * @brief Per-call statistics for metering
+     */
+    struct Stats {
+        uint16_t peak_in = 0;
+        uint16_t peak_out = 0;
+        int32_t gain_q10 = kUnityGain;
+        bool gated = false;
+    };
+
+    AutoGainControl();
+    explicit AutoGainControl(const Config& config);
+
+    void configure(const Config& config);
+    void reset();
+
+    /**
+     * @brief Apply AGC in place
+     * @return Peaks before/after processing and the gain at the end of the buffer
+     */
+    Stats process(int16_t* samples, size_t count);
+
+    int32_t gainQ10() const { return gain_q10_; }
+
+private:
+    int32_t computeTargetGain(bool& gated) const;
+    int32_t smoothGain(int32_t target) const;
+    int32_t softLimit(int32_t value) const;
+
+    Config config_;
+    int32_t envelope_ = 0;
+    int32_t gain_q10_ = kUnityGain;
+};
@@ -0,0 +1,267 @@
+#include "core/auto_populate_cache.h"
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <algorithm>
+#include <memory>
+
+#include "core/cancel_token.h"
+#include "core/command_plan_executor.h"
+#include "core/event_router.h"
+#include "core/task_config.h"
+#include "utils/command_plan.h"
+#include "utils/logger.h"
+
+namespace {
+
+constexpr const char* TAG = "AutoPopulate";
+constexpr uint32_t kWaitPollMs = 20;
+
+uint32_t average(uint32_t current, uint32_t sample) {
+    return current == 0 ? sample : (current * 7 + sample) / 8;
+}
+
+}  // namespace
+
+struct AutoPopulateCache::Refresh {
+    AutoPopulateCache* cache = nullptr;
+    std::vector<std::string> keys;
+    Runner runner;
+};
+
+std::string AutoPopulateCache::makeKey(const AutoPopulateCommand& command) {
+    std::string key = command.command;
+    for (const std::string& arg : command.args) {
+        key += ' ';
+        key += arg;
+    }
+    return key;
+}
+
+bool AutoPopulateCache::freshLocked(const Entry& entry, uint32_t now) const {
+    return entry.has_value && !entry.stale && now - entry.fetched_ms < entry.command.ttl_ms;
+}
+
+std::vector<AutoPopulateCache::Result> AutoPopulateCache::populate(const std::vector<AutoPopulateCommand>& commands,
+                                                                   const Runner& runner) {
+    std::vector<std::string> keys;
+    std::vector<std::string> run_now;
+    std::vector<std::string> run_later;
+    std::vector<std::string> run_elsewhere;     // Misses another caller is already running
+    std::vector<std::string> new_events;
+    keys.reserve(commands.size());
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const AutoPopulateCommand& command : commands) {
+            keys.push_back(makeKey(command));
+        }
+
+        // Commands dropped from the prompt definition
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            if (!it->second.running && std::find(keys.begin(), keys.end(), it->first) == keys.end()) {
+                it = entries_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        const uint32_t now = millis();
+        for (size_t i = 0; i < commands.size(); ++i) {
+            Entry& entry = entries_[keys[i]];
+            entry.command = commands[i];
+            entry.stats.command = keys[i];
+            for (const std::string& event : entry.command.invalidate_on) {
+                if (subscribed_.insert(event).second) {
+                    new_events.push_back(event);
+                }
+            }
+
+            if (freshLocked(entry, now)) {
+                ++entry.stats.hits;
+                continue;
+            }
+            const bool use_stale = entry.has_value && entry.command.stale_while_revalidate;
+            if (use_stale) {
+                ++entry.stats.stale_hits;
+            } else {
+                ++entry.stats.misses;
+            }
+            if (!entry.running) {
+                entry.running = true;
+                (use_stale ? run_later : run_now).push_back(keys[i]);
+            } else if (!use_stale) {
+                run_elsewhere.push_back(keys[i]);
+            }
+        }
+    }
+
+    // Outside the lock: publish() may be invalidating on another task
+    for (const std::string& event : new_events) {
+        EventRouter::getInstance()->subscribe(event.c_str(), [this, event](const char*, void*) {
+            invalidate(event);
+        });
+    }
+
+    if (!run_later.empty()) {
+        refreshInBackground(std::move(run_later), runner);
+    }
+    if (!run_now.empty()) {
+        run(run_now, runner);
+    }
+
+    const CancelToken cancel = CancelToken::current();
+    while (!run_elsewhere.empty() && !cancel.cancelled()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            run_elsewhere.erase(std::remove_if(run_elsewhere.begin(), run_elsewhere.end(),
+                                               [this](const std::string& key) {
+                                                   auto it = entries_.find(key);
+                                                   return it == entries_.end() || !it->second.running;
+                                               }),
+                                run_elsewhere.end());
+        }
+        if (!run_elsewhere.empty()) {
+            vTaskDelay(pdMS_TO_TICKS(kWaitPollMs));
+        }
+    }
+
+    std::vector<Result> results(keys.size());
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        auto it = entries_.find(keys[i]);
+        if (it != entries_.end() && it->second.has_value) {
+            results[i].valid = true;
+            results[i].value = it->second.value;
+        }
+    }
+    return results;
+}
+
+void AutoPopulateCache::run(const std::vector<std::string>& keys, const Runner& runner) {
+    const CommandPlanExecutor::Runner step_runner = [this, &runner](const std::string& key,
+                                                                    const std::vector<std::string>&) {
+        return runOne(key, runner);
+    };
+
+    for (size_t first = 0; first < keys.size(); first += CommandPlan::kMaxSteps) {
+        // Independent steps named by their cache key; the arguments stay in the
+        // entry so "{{...}}" in them is not read as a step reference
+        CommandPlan plan;
+        const size_t last = std::min(keys.size(), first + CommandPlan::kMaxSteps);
+        for (size_t i = first; i < last; ++i) {
+            CommandPlan::Step step;
+            step.id = std::to_string(i + 1);
+            step.command = keys[i];
+            plan.addStep(std::move(step));
+        }
+        std::string error;
+        if (plan.prepare(error)) {
+            CommandPlanExecutor::run(plan, step_runner);
+            continue;
+        }
+
+        Logger::getInstance().errorf("[%s] Invalid plan: %s", TAG, error.c_str());
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = first; i < last; ++i) {
+            auto it = entries_.find(keys[i]);
+            if (it != entries_.end()) {
+                it->second.running = false;
+            }
+        }
+    }
+}
+
+CommandResult AutoPopulateCache::runOne(const std::string& key, const Runner& runner) {
+    AutoPopulateCommand command;
+    uint32_t epoch = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it == entries_.end()) {
+            return CommandResult{false, "Dropped from the prompt"};
+        }
+        command = it->second.command;
+        epoch = it->second.epoch;
+    }
+
+    Value value;
+    const uint32_t start = millis();
+    const bool success = runner(command, value);
+    const uint32_t cost = millis() - start;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        return CommandResult{success, ""};
+    }
+    Entry& entry = it->second;
+    entry.running = false;
+    ++entry.stats.runs;
+    entry.stats.avg_ms = average(entry.stats.avg_ms, cost);
+    entry.stats.max_ms = std::max(entry.stats.max_ms, cost);
+    if (success) {
+        entry.value = std::move(value);
+        entry.has_value = true;
+        entry.fetched_ms = millis();
+        entry.stale = entry.epoch != epoch;
+    } else {
+        ++entry.stats.failures;
+    }
+    return CommandResult{success, ""};
+}
+
+void AutoPopulateCache::refreshInBackground(std::vector<std::string> keys, const Runner& runner) {
+    auto* job = new Refresh();
+    job->cache = this;
+    job->keys = std::move(keys);
+    job->runner = runner;
+
+    BaseType_t result = xTaskCreatePinnedToCore(
+        refreshTask, "autopop_refresh", TaskConfig::STACK_AUTOPOP_REFRESH,
+        job, TaskConfig::PRIO_AUTOPOP_REFRESH, nullptr, TaskConfig::CORE_AUTOPOP_REFRESH);
+    if (result != pdPASS) {
+        Logger::getInstance().warnf("[%s] Failed to create refresh task, refreshing inline", TAG);
+        std::unique_ptr<Refresh> owned(job);
+        run(owned->keys, owned->runner);
+    }
+}
+
+void AutoPopulateCache::refreshTask(void* param) {
+    std::unique_ptr<Refresh> job(static_cast<Refresh*>(param));
+    job->cache->run(job->keys, job->runner);
+    job.reset();
+    vTaskDelete(nullptr);
+}
+
+void AutoPopulateCache::invalidate(const std::string& event) {
+    size_t count = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& item : entries_) {
+            Entry& entry = item.second;
+            const std::vector<std::string>& events = entry.command.invalidate_on;
+            if (std::find(events.begin(), events.end(), event) != events.end()) {
+                entry.stale = true;
+                ++entry.epoch;
+                ++count;
+            }
+        }
+    }
+    if (count > 0) {
+        Logger::getInstance().infof("[%s] %s invalidated %u cached results", TAG, event.c_str(), (unsigned)count);
+    }
+}
+
+std::vector<AutoPopulateCache::Stats> AutoPopulateCache::getStats() const {
+    std::vector<Stats> stats;
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint32_t now = millis();
+    stats.reserve(entries_.size());
+    for (const auto& item : entries_) {
+        Stats entry_stats = item.second.stats;
+        entry_stats.age_ms = item.second.has_value ? static_cast<int32_t>(now - item.second.fetched_ms) : -1;
+        stats.push_back(std::move(entry_stats));
+    }
+    return stats;
+}
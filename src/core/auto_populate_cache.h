@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "core/command_center.h"
+#include "core/voice_assistant_prompt.h"
+
+/**
+ * @brief Results of the prompt's auto_populate commands, run in parallel and cached
+ *
+ * Each command keeps its last result for its ttl_ms, or until one of its
+ * invalidate_on events is published on the EventRouter. populate() runs the
+ * commands without a usable result at the same time (CommandPlanExecutor) and
+ * waits for them. A stale_while_revalidate command instead hands back its
+ * previous result at once and is refreshed on a background task, so the turn
+ * never waits for it once it has run.
+ *
+ * A command runs for one caller at a time; others wait for that run.
+ */
+class AutoPopulateCache {
+public:
+    struct Value {
+        std::string output;
+        std::string refined_output;
+    };
+
+    /** Runs one command on a worker task; false if it failed */
+    using Runner = std::function<bool(const AutoPopulateCommand& command, Value& value)>;
+
+    struct Result {
+        bool valid = false;         // Failed with no earlier result to fall back on
+        Value value;
+    };
+
+    struct Stats {
+        std::string command;        // Command and arguments
+        uint32_t hits = 0;          // Fresh result reused
+        uint32_t stale_hits = 0;    // Previous result used while a refresh runs
+        uint32_t misses = 0;        // Turn waited for the command
+        uint32_t runs = 0;
+        uint32_t failures = 0;
+        uint32_t avg_ms = 0;        // Cost of one run
+        uint32_t max_ms = 0;
+        int32_t age_ms = -1;        // Of the cached result, -1 if none
+    };
+
+    /**
+     * @brief Current result of each command, in order
+     * @param runner Copied for background refreshes, so what it refers to must outlive them
+     */
+    std::vector<Result> populate(const std::vector<AutoPopulateCommand>& commands, const Runner& runner);
+
+    std::vector<Stats> getStats() const;
+
+private:
+    struct Entry {
+        AutoPopulateCommand command;    // Latest settings from the prompt definition
+        Value value;
+        bool has_value = false;
+        bool stale = false;             // Invalidated by an event
+        bool running = false;
+        uint32_t fetched_ms = 0;
+        uint32_t epoch = 0;             // Bumped on invalidation: a run started before stays stale
+        Stats stats;
+    };
+
+    struct Refresh;
+
+    static std::string makeKey(const AutoPopulateCommand& command);
+    bool freshLocked(const Entry& entry, uint32_t now) const;
+    void run(const std::vector<std::string>& keys, const Runner& runner);
+    CommandResult runOne(const std::string& key, const Runner& runner);
+    void refreshInBackground(std::vector<std::string> keys, const Runner& runner);
+    void invalidate(const std::string& event);
+    static void refreshTask(void* param);
+
+    std::map<std::string, Entry> entries_;
+    std::set<std::string> subscribed_;     // EventRouter events routed to invalidate()
+    mutable std::mutex mutex_;
+};
@@ -0,0 +1,28 @@
+#include "core/cancel_token.h"
+
+#include <Arduino.h>
+
+namespace {
+thread_local const CancelToken* s_current = nullptr;
+} // namespace
+
+bool CancelToken::cancelled() const {
+    if (flag_ && flag_->load()) {
+        return true;
+    }
+    return has_deadline_ && static_cast<int32_t>(millis() - deadline_ms_) >= 0;
+}
+
+CancelToken CancelToken::current() {
+    return s_current ? *s_current : CancelToken();
+}
+
+CancelToken::Scope::Scope(const CancelToken& token) : token_(token), previous_(s_current) {
+    if (!token_.empty()) {
+        s_current = &token_;
+    }
+}
+
+CancelToken::Scope::~Scope() {
+    s_current = previous_;
+}
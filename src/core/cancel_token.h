@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Cancellation of the request the calling task is working on
+ *
+ * A token is a flag another task may set, plus an optional deadline
+ * (millis()). Code running a cancellable request opens a CancelToken::Scope;
+ * the layers underneath (HttpClientPool waits, web downloads, command
+ * execution) ask current() instead of the token being passed through every
+ * call. Scopes nest and the innermost non-empty token applies.
+ *
+ * The flag must outlive every use of the token, including pooled HTTP handles
+ * acquired inside the scope and read after it (streamed playback).
+ */
+class CancelToken {
+public:
+    CancelToken() = default;
+    explicit CancelToken(const std::atomic<bool>* flag) : flag_(flag) {}
+    CancelToken(const std::atomic<bool>* flag, uint32_t deadline_ms)
+        : flag_(flag), deadline_ms_(deadline_ms), has_deadline_(true) {}
+
+    bool empty() const { return !flag_ && !has_deadline_; }
+
+    /** Flag set or deadline passed */
+    bool cancelled() const;
+
+    /** Token of the innermost scope open on the calling task (empty if none) */
+    static CancelToken current();
+
+    class Scope;
+
+private:
+    const std::atomic<bool>* flag_ = nullptr;
+    uint32_t deadline_ms_ = 0;
+    bool has_deadline_ = false;
+};
+
+/** Makes a token current() on the calling task until destroyed */
+class CancelToken::Scope {
+public:
+    explicit Scope(const CancelToken& token);
+    ~Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    CancelToken token_;
+    const CancelToken* previous_;
+};
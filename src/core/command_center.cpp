@@ -12,9 +12,17 @@
 
 #include "drivers/sd_card_driver.h"
 #include "drivers/rgb_led_driver.h"
+#include "core/async_request_manager.h"
 #include "core/ble_hid_manager.h"
 #include "core/audio_manager.h"
 #include "core/backlight_manager.h"
+#include "core/http_client_pool.h"
+#include "core/intent_matcher.h"
+#include "core/lua_bytecode_cache.h"
+#include "core/lua_sandbox_pool.h"
+#include "core/lua_scheduler.h"
+#include "core/lua_events.h"
+#include "core/response_templates.h"
 #include "core/time_manager.h"
 #include "core/time_scheduler.h"
 #include "core/voice_assistant.h"
@@ -426,6 +434,7 @@ bool CommandCenter::registerCommand(const std::string& name,
         .description = description,
         .handler = std::move(handler)
     });
+    generation_++;
 
     xSemaphoreGive(mutex_);
     return true;
@@ -620,6 +629,7 @@ void CommandCenter::registerBuiltins() {
                     case SourceType::LITTLEFS: source_str = "LITTLEFS"; break;
                     case SourceType::SD_CARD: source_str = "SD_CARD"; break;
                     case SourceType::HTTP_STREAM: source_str = "HTTP_STREAM (Timeshift)"; break;
+                    case SourceType::HTTP_RESPONSE: source_str = "HTTP_RESPONSE (TTS)"; break;
                 }
                 status << "Source: " << source_str << "\n";
 
@@ -841,6 +851,22 @@ void CommandCenter::registerBuiltins() {
             return CommandResult{true, "Volume set to " + std::to_string(new_volume) + "%"};
         });
 
+    registerCommand("volume_set", "Set audio volume",
+        [](const std::vector<std::string>& args) {
+            if (args.empty()) {
+                return CommandResult{false, "Usage: volume_set <percentage>"};
+            }
+            int volume = std::min(100, std::max(0, static_cast<int>(std::strtol(args[0].c_str(), nullptr, 10))));
+            AudioManager::getInstance().setVolume(volume);
+            return CommandResult{true, "Volume set to " + std::to_string(volume) + "%"};
+        });
+
+    registerCommand("radio_stop", "Stop audio playback",
+        [](const std::vector<std::string>& args) {
+            AudioManager::getInstance().stop();
+            return CommandResult{true, "Playback stopped"};
+        });
+
     // Brightness control
     registerCommand("brightness_up", "Increase display brightness",
         [](const std::vector<std::string>& args) {
@@ -860,6 +886,17 @@ void CommandCenter::registerBuiltins() {
             return CommandResult{true, "Brightness set to " + std::to_string(new_brightness) + "%"};
         });
 
+    registerCommand("brightness_set", "Set display brightness",
+        [](const std::vector<std::string>& args) {
+            if (args.empty()) {
+                return CommandResult{false, "Usage: brightness_set <percentage>"};
+            }
+            // Same floor as brightness_down: never switch the screen off by voice
+            uint8_t brightness = static_cast<uint8_t>(std::min(100L, std::max(10L, std::strtol(args[0].c_str(), nullptr, 10))));
+            BacklightManager::getInstance().setBrightness(brightness);
+            return CommandResult{true, "Brightness set to " + std::to_string(brightness) + "%"};
+        });
+
     // LED brightness
     registerCommand("led_brightness", "Set LED brightness",
         [](const std::vector<std::string>& args) {
@@ -891,6 +928,251 @@ void CommandCenter::registerBuiltins() {
             return CommandResult{true, msg};
         });
 
+    // Local intent fast-path
+    registerCommand("intent_stats", "Local intent matcher hit rate and LLM time saved",
+        [](const std::vector<std::string>& args) {
+            const IntentMatcher::Stats stats = IntentMatcher::getInstance().getStats();
+            const uint32_t rate = stats.utterances ? (stats.matched * 100) / stats.utterances : 0;
+            std::string msg = "utterances=" + std::to_string(stats.utterances) +
+                             " matched=" + std::to_string(stats.matched) +
+                             " match_rate=" + std::to_string(rate) + "%" +
+                             " failed=" + std::to_string(stats.failed) +
+                             " avg_local_ms=" + std::to_string(stats.avg_local_ms) +
+                             " avg_llm_ms=" + std::to_string(stats.avg_llm_ms) +
+                             " saved_ms=" + std::to_string(stats.saved_ms) +
+                             " patterns=" + std::to_string(stats.patterns);
+            return CommandResult{true, msg};
+        });
+
+    registerCommand("intent_reload", "Reload local intents from /intents.json",
+        [](const std::vector<std::string>& args) {
+            IntentMatcher::getInstance().reload();
+            return CommandResult{true, "Intents will be reloaded on next utterance"};
+        });
+
+    registerCommand("refine_stats", "Command outputs phrased by local templates vs the LLM",
+        [](const std::vector<std::string>& args) {
+            const ResponseTemplates::Stats stats = ResponseTemplates::getInstance().getStats();
+            const uint32_t total = stats.rendered + stats.missed;
+            const uint32_t rate = total ? (stats.rendered * 100) / total : 0;
+            std::string msg = "rendered=" + std::to_string(stats.rendered) +
+                             " llm=" + std::to_string(stats.missed) +
+                             " local_rate=" + std::to_string(rate) + "%" +
+                             " avg_render_us=" + std::to_string(stats.avg_render_us) +
+                             " templates=" + std::to_string(stats.templates);
+            return CommandResult{true, msg};
+        });
+
+    registerCommand("refine_reload", "Reload response templates from the API docs",
+        [](const std::vector<std::string>& args) {
+            ResponseTemplates::getInstance().reload();
+            return CommandResult{true, "Response templates will be reloaded on next use"};
+        });
+
+    registerCommand("lua_cache_stats", "Compiled Lua chunk cache: hit rate and compile time saved",
+        [](const std::vector<std::string>& args) {
+            if (!args.empty() && args[0] == "clear") {
+                const bool ok = LuaBytecodeCache::getInstance().clear();
+                return CommandResult{ok, ok ? "Lua bytecode cache cleared" : "Failed to remove some cached chunks"};
+            }
+            const LuaBytecodeCache::Stats stats = LuaBytecodeCache::getInstance().getStats();
+            const uint32_t hits = stats.memory_hits + stats.disk_hits;
+            const uint32_t total = hits + stats.misses;
+            const uint32_t rate = total ? (hits * 100) / total : 0;
+            std::string msg = "hits=" + std::to_string(hits) +
+                             " (memory=" + std::to_string(stats.memory_hits) +
+                             " flash=" + std::to_string(stats.disk_hits) + ")" +
+                             " misses=" + std::to_string(stats.misses) +
+                             " hit_rate=" + std::to_string(rate) + "%" +
+                             " compile_ms=" + std::to_string(stats.compile_us / 1000) +
+                             " saved_ms=" + std::to_string(stats.saved_us / 1000) +
+                             " load_ms=" + std::to_string(stats.load_us / 1000) +
+                             " memory=" + std::to_string(stats.memory_entries) + "/" +
+                             std::to_string(stats.memory_bytes) + "B" +
+                             " flash=" + std::to_string(stats.disk_entries) + "/" +
+                             std::to_string(stats.disk_bytes) + "B";
+            return CommandResult{true, msg};
+        });
+
+    registerCommand("lua_pool_stats", "Lua sandbox pool occupancy, wait times and memory",
+        [](const std::vector<std::string>& args) {
+            const LuaSandboxPool::Stats stats = LuaSandboxPool::getInstance().getStats();
+            std::string msg = "in_use=" + std::to_string(stats.in_use) + "/" +
+                             std::to_string(LuaSandboxPool::kPoolSize) +
+                             " created=" + std::to_string(stats.size) +
+                             " peak=" + std::to_string(stats.peak_in_use) +
+                             " acquired=" + std::to_string(stats.acquired) +
+                             " waited=" + std::to_string(stats.waited) +
+                             " timeouts=" + std::to_string(stats.timeouts) +
+                             " avg_wait_ms=" + std::to_string(stats.avg_wait_ms) +
+                             " max_wait_ms=" + std::to_string(stats.max_wait_ms) +
+                             " avg_reset_us=" + std::to_string(stats.avg_reset_us) +
+                             " recycled=" + std::to_string(stats.recycled) +
+                             " arena_bytes=" + std::to_string(stats.arena_bytes);
+            return CommandResult{true, msg};
+        });
+
+    registerCommand("lua_sched_stats", "Lua coroutine scheduler: live scripts, preemption, timeouts",
+        [](const std::vector<std::string>& args) {
+            const LuaScheduler::Stats stats = LuaScheduler::getInstance().getStats();
+            std::string msg = "live=" + std::to_string(stats.coroutines.live) +
+                             " ready=" + std::to_string(stats.coroutines.ready) +
+                             " sleeping=" + std::to_string(stats.coroutines.sleeping) +
+                             " waiting=" + std::to_string(stats.coroutines.waiting) +
+                             " submitted=" + std::to_string(stats.submitted) +
+                             " completed=" + std::to_string(stats.coroutines.completed) +
+                             " failed=" + std::to_string(stats.coroutines.failed) +
+                             " timed_out=" + std::to_string(stats.coroutines.timed_out) +
+                             " preempted=" + std::to_string(stats.coroutines.preempted) +
+                             " rejected=" + std::to_string(stats.rejected) +
+                             " fallbacks=" + std::to_string(stats.fallbacks) +
+                             " offloaded=" + std::to_string(stats.offloaded) +
+                             " io_queued=" + std::to_string(stats.io_queued) +
+                             " avg_ms=" + std::to_string(stats.avg_elapsed_ms) +
+                             " max_ms=" + std::to_string(stats.max_elapsed_ms) +
+                             " memory=" + std::to_string(stats.memory_bytes) + "B timeouts_ms=";
+            for (size_t i = 0; i < static_cast<size_t>(LuaScheduler::Source::Count); ++i) {
+                msg += std::string(i ? "," : "") + LuaScheduler::sourceName(static_cast<LuaScheduler::Source>(i)) +
+                       ":" + std::to_string(stats.timeout_ms[i]);
+            }
+            return CommandResult{true, msg};
+        });
+
+    registerCommand("lua_timeout", "Set the Lua script timeout for a source (scheduler|web|llm|event) in ms",
+        [](const std::vector<std::string>& args) {
+            LuaScheduler::Source source;
+            if (args.size() < 2 || !LuaScheduler::parseSource(args[0], source)) {
+                return CommandResult{false, "Usage: lua_timeout <scheduler|web|llm|event> <ms>"};
+            }
+            const long timeout_ms = std::strtol(args[1].c_str(), nullptr, 10);
+            if (timeout_ms <= 0) {
+                return CommandResult{false, "Timeout must be a positive number of ms"};
+            }
+            auto& scheduler = LuaScheduler::getInstance();
+            scheduler.setTimeout(source, static_cast<uint32_t>(timeout_ms));
+            return CommandResult{true, std::string(LuaScheduler::sourceName(source)) + " scripts time out after " +
+                                           std::to_string(scheduler.timeout(source)) + " ms"};
+        });
+
+    registerCommand("lua_events", "Lua event handlers: calls, drops, queue latency and busy time",
+        [](const std::vector<std::string>& args) {
+            const LuaEvents::Stats stats = LuaEvents::getInstance().getStats();
+            std::string msg = "posted=" + std::to_string(stats.posted) +
+                             " dropped=" + std::to_string(stats.dropped) +
+                             " pending=" + std::to_string(stats.pending) +
+                             " running=" + std::to_string(stats.running) +
+                             " handlers=" + std::to_string(stats.handlers.size());
+            for (const auto& handler : stats.handlers) {
+                msg += "\n#" + std::to_string(handler.id) + " " + handler.event + " (" + handler.label + ")" +
+                       " calls=" + std::to_string(handler.calls) +
+                       " failures=" + std::to_string(handler.failures) +
+                       " dropped=" + std::to_string(handler.dropped) +
+                       " pending=" + std::to_string(handler.pending) +
+                       " latency_ms=" + std::to_string(handler.avg_latency_ms) + "/" +
+                       std::to_string(handler.max_latency_ms) +
+                       " busy_us=" + std::to_string(handler.avg_busy_us) + "/" + std::to_string(handler.max_busy_us);
+            }
+            return CommandResult{true, msg};
+        });
+
+    registerCommand("async_stats", "Async request lanes: queue wait, run time, timeouts, cancel-to-idle, endpoint load",
+        [](const std::vector<std::string>& args) {
+            AsyncRequestManager& manager = AsyncRequestManager::getInstance();
+            std::string msg;
+            for (const AsyncRequestManager::LaneStats& lane : manager.getLaneStats()) {
+                const RequestScheduler::LaneStats& stats = lane.scheduler;
+                if (!msg.empty()) {
+                    msg += "\n";
+                }
+                msg += std::string(AsyncRequestManager::typeName(lane.type)) +
+                       ": submitted=" + std::to_string(stats.submitted) +
+                       " completed=" + std::to_string(stats.completed) +
+                       " failed=" + std::to_string(stats.failed) +
+                       " timed_out=" + std::to_string(stats.timed_out) +
+                       " cancelled=" + std::to_string(stats.cancelled) +
+                       " rejected=" + std::to_string(stats.rejected) +
+                       " queued=" + std::to_string(stats.queued) +
+                       " running=" + std::to_string(stats.running) + "/" + std::to_string(lane.limit) +
+                       " wait_ms=" + std::to_string(stats.avg_wait_ms) + "/" + std::to_string(stats.max_wait_ms) +
+                       " run_ms=" + std::to_string(stats.avg_run_ms) + "/" + std::to_string(stats.max_run_ms) +
+                       " aborted=" + std::to_string(lane.aborted) +
+                       " abort_ms=" + std::to_string(lane.avg_abort_ms) + "/" + std::to_string(lane.max_abort_ms);
+            }
+            for (const AsyncRequestManager::EndpointStats& endpoint : manager.getEndpointStats()) {
+                msg += "\n" + endpoint.key + ": running=" + std::to_string(endpoint.running) + "/" +
+                       std::to_string(endpoint.limit);
+            }
+            return CommandResult{true, msg};
+        });
+
+    registerCommand("async_limit", "Set concurrent async requests for a lane (stt|llm|tts|command) or a server URL",
+        [](const std::vector<std::string>& args) {
+            const long limit = args.size() < 2 ? 0 : std::strtol(args[1].c_str(), nullptr, 10);
+            if (limit <= 0 || limit > static_cast<long>(AsyncRequestManager::kWorkers)) {
+                return CommandResult{false, "Usage: async_limit <stt|llm|tts|command|scheme://host:port> <1-" +
+                                                std::to_string(AsyncRequestManager::kWorkers) + ">"};
+            }
+            AsyncRequestManager& manager = AsyncRequestManager::getInstance();
+            AsyncRequestManager::RequestType type;
+            if (AsyncRequestManager::parseType(args[0], type)) {
+                manager.setLaneLimit(type, static_cast<uint8_t>(limit));
+            } else if (!manager.setEndpointLimit(args[0], static_cast<uint8_t>(limit))) {
+                return CommandResult{false, "No room for another endpoint: " + args[0]};
+            }
+            return CommandResult{true, args[0] + " runs up to " + std::to_string(limit) + " requests at once"};
+        });
+
+    registerCommand("http_pool_stats", "Connect time per stage, cold vs pre-warmed connections, cancellations",
+        [](const std::vector<std::string>& args) {
+            const std::vector<HttpClientPool::StageStats> stats = HttpClientPool::getInstance().getStats();
+            if (stats.empty()) {
+                return CommandResult{true, "No pooled HTTP requests yet"};
+            }
+            std::string msg;
+            for (const HttpClientPool::StageStats& stage : stats) {
+                const int32_t saved = (stage.cold && stage.warm)
+                    ? static_cast<int32_t>(stage.cold_avg_ms) - static_cast<int32_t>(stage.warm_avg_ms) : 0;
+                if (!msg.empty()) {
+                    msg += "\n";
+                }
+                msg += stage.stage + ": cold=" + std::to_string(stage.cold) +
+                       " cold_avg_ms=" + std::to_string(stage.cold_avg_ms) +
+                       " warm=" + std::to_string(stage.warm) +
+                       " warm_avg_ms=" + std::to_string(stage.warm_avg_ms) +
+                       " saved_ms=" + std::to_string(saved) +
+                       " retries=" + std::to_string(stage.retries) +
+                       " cancelled=" + std::to_string(stage.cancelled);
+            }
+            return CommandResult{true, msg};
+        });
+
+    registerCommand("autopop_stats", "Prompt auto_populate commands: cache hit rate, run cost, result age",
+        [](const std::vector<std::string>& args) {
+            const std::vector<AutoPopulateCache::Stats> stats = VoiceAssistant::getInstance().getAutoPopulateStats();
+            if (stats.empty()) {
+                return CommandResult{true, "No auto_populate commands run yet"};
+            }
+            std::string msg;
+            for (const AutoPopulateCache::Stats& entry : stats) {
+                const uint32_t lookups = entry.hits + entry.stale_hits + entry.misses;
+                const uint32_t hit_pct = lookups ? (entry.hits + entry.stale_hits) * 100 / lookups : 0;
+                std::string name = entry.command.substr(0, 48);
+                std::replace(name.begin(), name.end(), '\n', ' ');
+                if (!msg.empty()) {
+                    msg += "\n";
+                }
+                msg += name + ": hits=" + std::to_string(entry.hits) +
+                       " stale=" + std::to_string(entry.stale_hits) +
+                       " misses=" + std::to_string(entry.misses) +
+                       " hit_rate=" + std::to_string(hit_pct) + "%" +
+                       " runs=" + std::to_string(entry.runs) +
+                       " failed=" + std::to_string(entry.failures) +
+                       " cost_ms=" + std::to_string(entry.avg_ms) + "/" + std::to_string(entry.max_ms) +
+                       " age_ms=" + std::to_string(entry.age_ms);
+            }
+            return CommandResult{true, msg};
+        });
+
     registerCommand("lua_exec", "Execute Lua script and return output",
         [](const std::vector<std::string>& args) {
             if (args.empty()) {
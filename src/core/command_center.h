@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <string>
 #include <vector>
@@ -36,6 +38,9 @@ public:
 
     std::vector<CommandInfo> listCommands() const;
 
+    /** Bumped on every registration, for caches derived from the command list */
+    uint32_t getGeneration() const { return generation_.load(); }
+
 private:
     CommandCenter();
 
@@ -49,4 +54,5 @@ private:
 
     std::vector<CommandEntry> commands_;
     SemaphoreHandle_t mutex_;
+    std::atomic<uint32_t> generation_{0};
 };
@@ -0,0 +1,124 @@
+#include "core/command_plan_executor.h"
+#include "core/task_config.h"
+#include "utils/logger.h"
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+constexpr uint32_t kWaitPollMs = 5;
+
+}  // namespace
+
+struct CommandPlanExecutor::Job {
+    CommandPlan* plan = nullptr;
+    const Runner* runner = nullptr;
+    std::mutex mutex;
+    uint8_t workers = 0;        // Extra tasks still running
+};
+
+void CommandPlanExecutor::work(Job& job) {
+    for (;;) {
+        size_t index = 0;
+        std::string id;
+        std::string command;
+        std::vector<std::string> args;
+        {
+            std::unique_lock<std::mutex> lock(job.mutex);
+            if (!job.plan->claimNext(index)) {
+                if (job.plan->finished()) {
+                    return;
+                }
+                lock.unlock();
+                vTaskDelay(pdMS_TO_TICKS(kWaitPollMs));  // A dependency is still running
+                continue;
+            }
+            id = job.plan->step(index).id;
+            command = job.plan->step(index).command;
+            args = job.plan->resolvedArgs(index);
+        }
+
+        Logger::getInstance().infof("[Plan] Step %s: %s (%u args)",
+                                    id.c_str(), command.c_str(), (unsigned)args.size());
+        const uint32_t start = millis();
+        CommandResult result = (*job.runner)(command, args);
+        const uint32_t duration = millis() - start;
+
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.plan->complete(index, result.success, std::move(result.message), duration);
+    }
+}
+
+void CommandPlanExecutor::workerEntry(void* param) {
+    auto* ref = static_cast<std::shared_ptr<Job>*>(param);
+    work(**ref);
+    {
+        std::lock_guard<std::mutex> lock((*ref)->mutex);
+        --(*ref)->workers;
+    }
+    delete ref;
+    vTaskDelete(nullptr);
+}
+
+bool CommandPlanExecutor::run(CommandPlan& plan, const Runner& runner, Stats* stats, uint8_t max_workers) {
+    auto& logger = Logger::getInstance();
+    const uint32_t start = millis();
+
+    auto job = std::make_shared<Job>();
+    job->plan = &plan;
+    job->runner = &runner;
+
+    const size_t wanted = std::min<size_t>(std::max<uint8_t>(max_workers, 1), plan.width());
+    uint8_t spawned = 0;
+    for (size_t i = 1; i < wanted; ++i) {
+        auto* ref = new std::shared_ptr<Job>(job);
+        {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            ++job->workers;
+        }
+        BaseType_t result = xTaskCreatePinnedToCore(
+            workerEntry, "plan_worker", TaskConfig::STACK_PLAN_WORKER,
+            ref, TaskConfig::PRIO_PLAN_WORKER, nullptr, TaskConfig::CORE_PLAN_WORKER);
+        if (result != pdPASS) {
+            delete ref;
+            std::lock_guard<std::mutex> lock(job->mutex);
+            --job->workers;
+            logger.warn("[Plan] Failed to create worker task, running with fewer workers");
+            break;
+        }
+        ++spawned;
+    }
+
+    work(*job);
+
+    // The plan and runner belong to the caller: wait for the workers to let go
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            if (job->workers == 0) {
+                break;
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(kWaitPollMs));
+    }
+
+    uint32_t serial_ms = 0;
+    for (const CommandPlan::Step& step : plan.steps()) {
+        serial_ms += step.duration_ms;
+    }
+    const uint32_t elapsed = millis() - start;
+    logger.infof("[Plan] %u steps in %u ms (%u ms run one by one), %u workers, depth %u",
+                 (unsigned)plan.size(), (unsigned)elapsed, (unsigned)serial_ms,
+                 (unsigned)(spawned + 1), (unsigned)plan.depth());
+
+    if (stats) {
+        stats->elapsed_ms = elapsed;
+        stats->serial_ms = serial_ms;
+        stats->workers = spawned + 1;
+    }
+    return plan.succeeded();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "core/command_center.h"
+#include "utils/command_plan.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Runs a CommandPlan with independent steps in parallel
+ *
+ * The calling task works through the plan itself; when several steps can run at
+ * the same time, up to kMaxWorkers - 1 extra worker tasks are started for the
+ * duration of the plan. run() returns once every step is done, failed or
+ * skipped.
+ */
+class CommandPlanExecutor {
+public:
+    static constexpr uint8_t kMaxWorkers = 3;   // Including the calling task
+
+    using Runner = std::function<CommandResult(const std::string& command, const std::vector<std::string>& args)>;
+
+    struct Stats {
+        uint32_t elapsed_ms = 0;
+        uint32_t serial_ms = 0;     // Sum of the step durations
+        uint8_t workers = 0;        // Tasks that ran steps (including the caller)
+    };
+
+    /**
+     * @brief Execute a prepared plan
+     * @return true if every step succeeded
+     */
+    static bool run(CommandPlan& plan, const Runner& runner, Stats* stats = nullptr,
+                    uint8_t max_workers = kMaxWorkers);
+
+private:
+    struct Job;
+
+    static void workerEntry(void* param);
+    static void work(Job& job);
+};
@@ -93,6 +93,7 @@ bool ConversationBuffer::addEntry(ConversationEntry entry) {
     }
 
     std::lock_guard<std::mutex> lock(mutex_);
+    entry.id = next_id_++;
     entries_.push_back(std::move(entry));
     while (entries_.size() > limit_) {
         entries_.pop_front();
@@ -106,6 +107,8 @@ bool ConversationBuffer::clear() {
     }
     std::lock_guard<std::mutex> lock(mutex_);
     entries_.clear();
+    summary_.text.clear();
+    summary_.upto_id = next_id_ - 1;  // Rejects summaries of the cleared entries still in flight
     return persistLocked();
 }
 
@@ -154,6 +157,27 @@ std::vector<ConversationEntry> ConversationBuffer::getEntries() const {
     return copy;
 }
 
+ConversationBuffer::Summary ConversationBuffer::getSummary() const {
+    if (!ensureReady()) {
+        return Summary();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    return summary_;
+}
+
+bool ConversationBuffer::setSummary(const std::string& text, uint32_t upto_id) {
+    if (!ensureReady()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (upto_id <= summary_.upto_id || upto_id >= next_id_) {
+        return false;  // Stale, or the buffer was cleared meanwhile
+    }
+    summary_.text = text;
+    summary_.upto_id = upto_id;
+    return persistLocked();
+}
+
 bool ConversationBuffer::loadLocked() {
     File file = LittleFS.open(FILE_PATH, FILE_READ);
     if (!file) {
@@ -172,10 +196,18 @@ bool ConversationBuffer::loadLocked() {
     limit_ = std::max(MIN_LIMIT, std::min(MAX_LIMIT, loaded_limit));
 
     entries_.clear();
+    next_id_ = doc["next_id"] | 1u;
+    summary_.text = doc["summary"]["text"] | "";
+    summary_.upto_id = doc["summary"]["upto"] | 0u;
+    uint32_t last_id = 0;
     JsonArrayConst arr = doc["messages"].as<JsonArrayConst>();
     if (!arr.isNull()) {
         for (JsonObjectConst item : arr) {
             ConversationEntry entry;
+            entry.id = item["id"] | 0u;
+            if (entry.id <= last_id) {
+                entry.id = last_id + 1;  // Files written before ids existed
+            }
             entry.role = item["role"].as<const char*>() ? item["role"].as<const char*>() : "";
             entry.text = item["text"].as<const char*>() ? item["text"].as<const char*>() : "";
             entry.timestamp = item["timestamp"] | 0u;
@@ -194,11 +226,13 @@ bool ConversationBuffer::loadLocked() {
             }
 
             if (!entry.role.empty() || !entry.text.empty()) {
+                last_id = entry.id;
                 entries_.push_back(std::move(entry));
             }
         }
     }
 
+    next_id_ = std::max(next_id_, last_id + 1);
     while (entries_.size() > limit_) {
         entries_.pop_front();
     }
@@ -209,9 +243,16 @@ bool ConversationBuffer::loadLocked() {
 bool ConversationBuffer::persistLocked() {
     JsonDocument doc;
     doc["limit"] = static_cast<uint32_t>(limit_);
+    doc["next_id"] = next_id_;
+    if (!summary_.text.empty()) {
+        JsonObject summary = doc["summary"].to<JsonObject>();
+        summary["text"] = summary_.text.c_str();
+        summary["upto"] = summary_.upto_id;
+    }
     JsonArray arr = doc["messages"].to<JsonArray>();
     for (const auto& entry : entries_) {
         JsonObject obj = arr.add<JsonObject>();
+        obj["id"] = entry.id;
         obj["role"] = entry.role.c_str();
         obj["text"] = entry.text.c_str();
         obj["timestamp"] = entry.timestamp;
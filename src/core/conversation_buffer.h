@@ -9,6 +9,7 @@
 #include <vector>
 
 struct ConversationEntry {
+    uint32_t id = 0;            // Increasing sequence number, assigned by the buffer
     std::string role;
     std::string text;
     std::string output;
@@ -21,6 +22,12 @@ struct ConversationEntry {
 
 class ConversationBuffer {
 public:
+    /** Rolling summary of the turns that no longer fit the LLM context */
+    struct Summary {
+        std::string text;
+        uint32_t upto_id = 0;   // Last entry id folded into text
+    };
+
     static ConversationBuffer& getInstance();
 
     bool begin();
@@ -41,6 +48,11 @@ public:
 
     std::vector<ConversationEntry> getEntries() const;
 
+    Summary getSummary() const;
+
+    /** Replace the summary; ignored unless it covers entries past the current one */
+    bool setSummary(const std::string& text, uint32_t upto_id);
+
 private:
     ConversationBuffer() = default;
     ConversationBuffer(const ConversationBuffer&) = delete;
@@ -59,4 +71,6 @@ private:
     mutable bool initialized_ = false;
     size_t limit_ = DEFAULT_LIMIT;
     std::deque<ConversationEntry> entries_;
+    uint32_t next_id_ = 1;
+    Summary summary_;
 };
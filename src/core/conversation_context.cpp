@@ -0,0 +1,60 @@
+#include "core/conversation_context.h"
+
+#include <iterator>
+
+constexpr size_t ConversationContext::kMessageOverheadTokens;
+
+size_t ConversationContext::estimateTokens(const std::string& text) {
+    size_t characters = 0;
+    for (unsigned char c : text) {
+        if ((c & 0xC0) != 0x80) {  // Count UTF-8 code points, not bytes
+            ++characters;
+        }
+    }
+    return (characters + 3) / 4 + kMessageOverheadTokens;
+}
+
+ConversationContext::Plan ConversationContext::fit(std::vector<Turn> turns,
+                                                   const ConversationBuffer::Summary& summary,
+                                                   size_t budget_tokens) {
+    Plan plan;
+    for (Turn& turn : turns) {
+        turn.tokens = estimateTokens(turn.content);
+    }
+
+    if (budget_tokens == 0) {
+        for (const Turn& turn : turns) {
+            plan.tokens += turn.tokens;
+        }
+        plan.turns = std::move(turns);
+        return plan;
+    }
+
+    size_t used = 0;
+    if (!summary.text.empty()) {
+        plan.summary = summary.text;
+        used = estimateTokens(summary.text);
+    }
+
+    // Walk back from the newest turn while the budget allows
+    size_t first_kept = turns.size();
+    while (first_kept > 0) {
+        const Turn& turn = turns[first_kept - 1];
+        if (first_kept < turns.size() && used + turn.tokens > budget_tokens) {
+            break;
+        }
+        used += turn.tokens;
+        --first_kept;
+    }
+
+    for (size_t i = 0; i < first_kept; ++i) {
+        if (turns[i].id > summary.upto_id) {
+            plan.pending.push_back(std::move(turns[i]));
+        }
+    }
+    plan.omitted = first_kept;
+    plan.turns.assign(std::make_move_iterator(turns.begin() + first_kept),
+                      std::make_move_iterator(turns.end()));
+    plan.tokens = used;
+    return plan;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "core/conversation_buffer.h"
+
+/**
+ * @brief Fits the conversation history into a token budget for LLM requests
+ *
+ * The most recent turns are kept verbatim, newest first, until the budget is
+ * spent (the newest turn is always kept). When a rolling summary exists it is
+ * sent ahead of them and its size comes out of the same budget. Older turns
+ * the summary does not cover yet are reported as pending so the idle
+ * summarizer can fold them in.
+ *
+ * Token counts are estimates (about four characters per token plus a small
+ * per-message overhead); they only need to be stable, not exact.
+ */
+class ConversationContext {
+public:
+    struct Turn {
+        uint32_t id = 0;
+        std::string role;       // "user" or "assistant"
+        std::string content;
+        size_t tokens = 0;
+    };
+
+    struct Plan {
+        std::string summary;            // Empty when no summary is sent
+        std::vector<Turn> turns;        // Verbatim turns, oldest first
+        std::vector<Turn> pending;      // Older turns not covered by the summary, oldest first
+        size_t tokens = 0;              // Estimate for summary + verbatim turns
+        size_t omitted = 0;             // Turns left out of the request
+    };
+
+    static constexpr size_t kMessageOverheadTokens = 4;
+
+    static size_t estimateTokens(const std::string& text);
+
+    /** budget_tokens == 0 keeps every turn (no summary) */
+    static Plan fit(std::vector<Turn> turns, const ConversationBuffer::Summary& summary, size_t budget_tokens);
+};
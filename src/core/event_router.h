@@ -10,6 +10,15 @@
 
 using EventCallback = std::function<void(const char* event, void* data)>;
 
+/**
+ * @brief Named publish/subscribe events between modules
+ *
+ * By convention `data` is a NUL-terminated `const char*` payload (possibly
+ * empty) that is only valid during the callback, so events can be forwarded
+ * to Lua handlers (see LuaEvents). Events published today: wifi.connected
+ * (IP), wifi.disconnected, audio.title, time.minute ("YYYY-MM-DD HH:MM") and
+ * settings.* (new value).
+ */
 class EventRouter {
 public:
     static EventRouter* getInstance();
@@ -0,0 +1,628 @@
+#include "core/http_client_pool.h"
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+#include "core/task_config.h"
+#include "utils/logger.h"
+
+namespace {
+constexpr const char* TAG = "HttpPool";
+constexpr const char* kPrewarmStage = "prewarm";
+constexpr uint32_t kPrewarmPollMs = 20;
+
+bool isPrewarm(const char* stage) {
+    return stage && strcmp(stage, kPrewarmStage) == 0;
+}
+
+bool writeAll(esp_http_client_handle_t client, const char* data, size_t length) {
+    size_t offset = 0;
+    while (offset < length) {
+        const int written = esp_http_client_write(client, data + offset, length - offset);
+        if (written <= 0) {
+            return false;
+        }
+        offset += written;
+    }
+    return true;
+}
+
+// A cancellable wait came back empty after most of a slice: the server is just slow
+bool keepWaiting(uint32_t call_start, uint32_t wait_start, uint32_t timeout_ms) {
+    const uint32_t now = millis();
+    return now - call_start >= HttpClientPool::kCancelPollMs / 2 && now - wait_start < timeout_ms;
+}
+} // namespace
+
+constexpr size_t HttpClientPool::kMaxClients;
+constexpr size_t HttpClientPool::kMaxClientsPerHost;
+constexpr uint32_t HttpClientPool::kDefaultKeepAliveMs;
+constexpr uint32_t HttpClientPool::kMinKeepAliveMs;
+constexpr uint32_t HttpClientPool::kHandleTtlMs;
+constexpr uint32_t HttpClientPool::kPrewarmTimeoutMs;
+constexpr uint32_t HttpClientPool::kCancelPollMs;
+
+HttpClientPool& HttpClientPool::getInstance() {
+    static HttpClientPool instance;
+    return instance;
+}
+
+std::string HttpClientPool::hostKey(const std::string& url) {
+    const size_t scheme_end = url.find("://");
+    std::string scheme = scheme_end == std::string::npos ? "http" : url.substr(0, scheme_end);
+    std::transform(scheme.begin(), scheme.end(), scheme.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    const size_t host_start = scheme_end == std::string::npos ? 0 : scheme_end + 3;
+    size_t host_end = url.find_first_of("/?#", host_start);
+    if (host_end == std::string::npos) {
+        host_end = url.size();
+    }
+    std::string authority = url.substr(host_start, host_end - host_start);
+    const size_t at = authority.rfind('@');
+    if (at != std::string::npos) {
+        authority.erase(0, at + 1);
+    }
+    std::transform(authority.begin(), authority.end(), authority.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    if (authority.find(':') == std::string::npos) {
+        authority += scheme == "https" ? ":443" : ":80";
+    }
+    return scheme + "://" + authority;
+}
+
+uint32_t HttpClientPool::keepAliveLocked(const std::string& key) const {
+    auto it = keep_alive_ms_.find(key);
+    return it != keep_alive_ms_.end() ? it->second : kDefaultKeepAliveMs;
+}
+
+HttpClientPool::Entry* HttpClientPool::findLocked(esp_http_client_handle_t client) {
+    for (auto& entry : entries_) {
+        if (entry->client == client) {
+            return entry.get();
+        }
+    }
+    return nullptr;
+}
+
+void HttpClientPool::sweepLocked(uint32_t now) {
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        Entry& entry = **it;
+        if (!entry.busy && entry.warm && now - entry.warm_since_ms > keepAliveLocked(entry.key)) {
+            esp_http_client_close(entry.client);  // The server has probably dropped it by now
+            entry.warm = false;
+        }
+        if (!entry.busy && !entry.warm && now - entry.last_used_ms > kHandleTtlMs) {
+            esp_http_client_cleanup(entry.client);
+            it = entries_.erase(it);
+            continue;
+        }
+        ++it;
+    }
+}
+
+HttpClientPool::Entry* HttpClientPool::createLocked(const std::string& url, const std::string& key,
+                                                    const Options& options) {
+    // Make room by freeing the least recently used idle handle
+    const size_t host_clients = std::count_if(entries_.begin(), entries_.end(),
+                                              [&key](const std::unique_ptr<Entry>& e) { return e->key == key; });
+    if (entries_.size() >= kMaxClients || host_clients >= kMaxClientsPerHost) {
+        auto victim = entries_.end();
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            if ((*it)->busy || (host_clients >= kMaxClientsPerHost && (*it)->key != key)) {
+                continue;
+            }
+            if (victim == entries_.end() || (*it)->last_used_ms < (*victim)->last_used_ms) {
+                victim = it;
+            }
+        }
+        if (victim != entries_.end()) {
+            esp_http_client_cleanup((*victim)->client);
+            entries_.erase(victim);
+        }
+    }
+
+    esp_http_client_config_t config = {};
+    config.url = url.c_str();
+    config.method = options.method;
+    config.timeout_ms = options.timeout_ms;
+    config.buffer_size = options.buffer_size;
+    config.buffer_size_tx = options.buffer_size_tx;
+    config.keep_alive_enable = true;  // TCP keep-alive probes detect dead peers on warm connections
+    config.keep_alive_idle = 5;
+    config.keep_alive_interval = 5;
+    config.keep_alive_count = 3;
+#if defined(CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS)
+    config.save_client_session = true;  // Reconnects resume the TLS session
+#endif
+    // For HTTPS: skip certificate validation (development mode)
+    config.skip_cert_common_name_check = true;
+    config.use_global_ca_store = false;
+
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (!client) {
+        Logger::getInstance().errorf("[%s] Failed to initialize HTTP client for %s", TAG, key.c_str());
+        return nullptr;
+    }
+
+    std::unique_ptr<Entry> entry(new Entry());
+    entry->client = client;
+    entry->key = key;
+    entry->buffer_size = options.buffer_size;
+    entry->buffer_size_tx = options.buffer_size_tx;
+    entries_.push_back(std::move(entry));
+    return entries_.back().get();
+}
+
+esp_http_client_handle_t HttpClientPool::acquire(const std::string& url, const Options& options) {
+    const std::string key = hostKey(url);
+    const bool prewarm = isPrewarm(options.stage);
+    const uint32_t wait_start = millis();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        const uint32_t now = millis();
+        sweepLocked(now);
+
+        Entry* chosen = nullptr;
+        bool prewarming = false;
+        for (auto& entry : entries_) {
+            if (entry->key != key) {
+                continue;
+            }
+            if (entry->busy) {
+                prewarming |= entry->stage == kPrewarmStage;
+                continue;
+            }
+            if (entry->buffer_size < options.buffer_size || entry->buffer_size_tx < options.buffer_size_tx ||
+                (prewarm && entry->warm)) {
+                continue;
+            }
+            if (!chosen || (entry->warm && !chosen->warm)) {
+                chosen = entry.get();
+            }
+        }
+
+        if ((!chosen || !chosen->warm) && prewarming && !prewarm &&
+            now - wait_start < kPrewarmTimeoutMs) {
+            // The prewarm for this host is mid-handshake: it will be ready sooner than a new connection
+            lock.unlock();
+            vTaskDelay(pdMS_TO_TICKS(kPrewarmPollMs));
+            lock.lock();
+            continue;
+        }
+
+        if (!chosen) {
+            chosen = createLocked(url, key, options);
+            if (!chosen) {
+                return nullptr;
+            }
+        } else {
+            esp_http_client_set_url(chosen->client, url.c_str());  // Same host: the connection is kept
+            esp_http_client_set_method(chosen->client, options.method);
+            esp_http_client_set_timeout_ms(chosen->client, options.timeout_ms);
+        }
+
+        chosen->busy = true;
+        chosen->stage = options.stage ? options.stage : "http";
+        chosen->reused = chosen->warm;
+        chosen->warm = false;
+        chosen->cancel = options.cancel.empty() ? CancelToken::current() : options.cancel;
+        chosen->timeout_ms = static_cast<uint32_t>(options.timeout_ms);
+        chosen->sliced = false;
+        chosen->aborted = false;
+        chosen->failed = false;
+        chosen->sent = false;
+        chosen->received = false;
+        return chosen->client;
+    }
+}
+
+void HttpClientPool::setHeader(esp_http_client_handle_t client, const char* key, const char* value) {
+    if (!client || !key || !value) {
+        return;
+    }
+    esp_http_client_set_header(client, key, value);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry* entry = findLocked(client);
+    if (entry && std::find(entry->headers.begin(), entry->headers.end(), key) == entry->headers.end()) {
+        entry->headers.emplace_back(key);
+    }
+}
+
+void HttpClientPool::release(esp_http_client_handle_t client) {
+    if (!client) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry* entry = findLocked(client);
+    if (!entry) {
+        esp_http_client_close(client);
+        esp_http_client_cleanup(client);
+        return;
+    }
+
+    for (const std::string& header : entry->headers) {
+        esp_http_client_delete_header(client, header.c_str());
+    }
+    entry->headers.clear();
+
+    // Keep the connection only at a request/response boundary: after an error,
+    // a cancellation, a body not written to the end or one left unread the
+    // socket state is unknown
+    const bool cancelled = entry->aborted || (!entry->cancel.empty() && entry->cancel.cancelled());
+    const bool keep = !entry->failed && !cancelled && entry->sent && entry->received;
+    if (!keep) {
+        esp_http_client_close(client);
+    }
+
+    const uint32_t now = millis();
+    entry->cancel = CancelToken();
+    entry->sliced = false;
+    entry->busy = false;
+    entry->warm = keep;
+    entry->warm_since_ms = now;
+    entry->reused = false;
+    entry->failed = false;
+    entry->sent = false;
+    entry->received = false;
+    entry->last_used_ms = now;
+}
+
+void HttpClientPool::markFailed(esp_http_client_handle_t client) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry* entry = findLocked(client);
+    if (entry) {
+        entry->failed = true;
+    }
+}
+
+void HttpClientPool::markSent(esp_http_client_handle_t client) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry* entry = findLocked(client);
+    if (entry) {
+        entry->sent = true;
+    }
+}
+
+bool HttpClientPool::writeChunk(esp_http_client_handle_t client, const char* data, size_t length) {
+    // esp_http_client only sets the Transfer-Encoding header, the framing is up to the caller
+    char size_line[16];
+    const int size_length = snprintf(size_line, sizeof(size_line), "%x\r\n", static_cast<unsigned>(length));
+    const bool ok = writeAll(client, size_line, size_length) && (length == 0 || writeAll(client, data, length)) &&
+                    writeAll(client, "\r\n", 2);
+    if (!ok) {
+        markFailed(client);
+    } else if (length == 0) {
+        markSent(client);
+    }
+    return ok;
+}
+
+void HttpClientPool::markReceived(esp_http_client_handle_t client) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry* entry = findLocked(client);
+    if (entry) {
+        entry->received = true;
+    }
+}
+
+esp_err_t HttpClientPool::openOnce(esp_http_client_handle_t client, int write_len, bool& was_warm) {
+    std::string stage;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry* entry = findLocked(client);
+        was_warm = entry && entry->reused;
+        stage = entry ? entry->stage : "http";
+    }
+
+    const uint32_t start = millis();
+    const esp_err_t err = esp_http_client_open(client, write_len);
+    const uint32_t elapsed = millis() - start;
+
+    if (err == ESP_OK) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry* entry = findLocked(client);
+        if (entry) {
+            // A new exchange starts
+            entry->failed = false;
+            entry->sent = write_len == 0;
+            entry->received = false;
+        }
+        StageTotals& totals = stats_[stage];
+        if (was_warm) {
+            ++totals.warm;
+            totals.warm_ms += elapsed;
+        } else {
+            ++totals.cold;
+            totals.cold_ms += elapsed;
+        }
+    }
+    return err;
+}
+
+bool HttpClientPool::dropWarm(esp_http_client_handle_t client) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry* entry = findLocked(client);
+        if (!entry || !entry->reused) {
+            return false;
+        }
+        entry->reused = false;
+        ++stats_[entry->stage].retries;
+        // The server closes idle connections sooner than assumed: trust them for less time
+        const uint32_t keep_alive = std::max(kMinKeepAliveMs, keepAliveLocked(entry->key) / 2);
+        keep_alive_ms_[entry->key] = keep_alive;
+        Logger::getInstance().warnf("[%s] Warm connection to %s was dead, reconnecting (keep-alive now %u ms)",
+                                    TAG, entry->key.c_str(), (unsigned)keep_alive);
+    }
+    esp_http_client_close(client);
+    return true;
+}
+
+esp_err_t HttpClientPool::open(esp_http_client_handle_t client, int write_len) {
+    if (cancelled(client)) {
+        markFailed(client);
+        return ESP_FAIL;
+    }
+    bool was_warm = false;
+    esp_err_t err = openOnce(client, write_len, was_warm);
+    if (err != ESP_OK && was_warm && !cancelled(client) && dropWarm(client)) {
+        err = openOnce(client, write_len, was_warm);
+    }
+    if (err != ESP_OK) {
+        markFailed(client);
+    }
+    return err;
+}
+
+int HttpClientPool::request(esp_http_client_handle_t client, int write_len, const BodyWriter& write_body,
+                            int& content_length) {
+    content_length = -1;
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        if (cancelled(client)) {
+            markFailed(client);
+            return -1;
+        }
+        bool was_warm = false;
+        esp_err_t err = openOnce(client, write_len, was_warm);
+        if (err == ESP_OK) {
+            if (write_body && !write_body(client)) {
+                err = ESP_FAIL;
+            } else {
+                markSent(client);
+                content_length = fetchHeaders(client);
+                const int status = esp_http_client_get_status_code(client);
+                if (content_length >= 0 && status > 0) {
+                    return status;
+                }
+                err = ESP_ERR_HTTP_FETCH_HEADER;
+            }
+        }
+
+        if (cancelled(client)) {
+            markFailed(client);
+            return -1;
+        }
+        if (!was_warm || !dropWarm(client)) {
+            Logger::getInstance().errorf("[%s] Request failed: %s", TAG, esp_err_to_name(err));
+            markFailed(client);
+            return -1;
+        }
+    }
+    markFailed(client);
+    return -1;
+}
+
+int HttpClientPool::request(esp_http_client_handle_t client, const char* body, size_t length, int& content_length) {
+    return request(client, static_cast<int>(length), [body, length](esp_http_client_handle_t c) {
+        return length == 0 || writeAll(c, body, length);
+    }, content_length);
+}
+
+int HttpClientPool::fetchHeaders(esp_http_client_handle_t client) {
+    uint32_t timeout_ms = 0;
+    const CancelToken token = beginWait(client, timeout_ms);
+    int content_length = -1;
+    if (token.empty()) {
+        content_length = esp_http_client_fetch_headers(client);
+    } else {
+        // Slices that time out leave the parser where it was, so fetching again continues
+        const uint32_t wait_start = millis();
+        while (!checkCancelled(client, token)) {
+            const uint32_t start = millis();
+            content_length = esp_http_client_fetch_headers(client);
+            if (content_length >= 0 || !keepWaiting(start, wait_start, timeout_ms)) {
+                break;
+            }
+        }
+    }
+    if (content_length < 0) {
+        markFailed(client);
+    } else if (esp_http_client_is_complete_data_received(client)) {
+        markReceived(client);   // No body to read
+    }
+    return content_length;
+}
+
+int HttpClientPool::read(esp_http_client_handle_t client, char* buffer, int length) {
+    uint32_t timeout_ms = 0;
+    const CancelToken token = beginWait(client, timeout_ms);
+    int read_len = -1;
+    if (token.empty()) {
+        read_len = esp_http_client_read(client, buffer, length);
+    } else {
+        const uint32_t wait_start = millis();
+        while (!checkCancelled(client, token)) {
+            const uint32_t start = millis();
+            read_len = esp_http_client_read(client, buffer, length);
+            if (read_len > 0 || esp_http_client_is_complete_data_received(client) ||
+                !keepWaiting(start, wait_start, timeout_ms)) {
+                break;
+            }
+            read_len = -1;
+        }
+    }
+    if (read_len < 0) {
+        markFailed(client);
+    } else if (esp_http_client_is_complete_data_received(client)) {
+        markReceived(client);   // The headers of this response were fetched: the flag is current
+    }
+    return read_len;
+}
+
+bool HttpClientPool::cancelled(esp_http_client_handle_t client) {
+    CancelToken token;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry* entry = findLocked(client);
+        if (!entry) {
+            return false;
+        }
+        token = entry->cancel;
+    }
+    return checkCancelled(client, token);
+}
+
+CancelToken HttpClientPool::beginWait(esp_http_client_handle_t client, uint32_t& timeout_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry* entry = findLocked(client);
+    if (!entry || entry->cancel.empty()) {
+        return CancelToken();
+    }
+    if (!entry->sliced) {
+        esp_http_client_set_timeout_ms(client, kCancelPollMs);
+        entry->sliced = true;
+    }
+    timeout_ms = entry->timeout_ms;
+    return entry->cancel;
+}
+
+bool HttpClientPool::checkCancelled(esp_http_client_handle_t client, const CancelToken& token) {
+    if (token.empty() || !token.cancelled()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry* entry = findLocked(client);
+    if (entry && !entry->aborted) {
+        entry->aborted = true;
+        ++stats_[entry->stage].cancelled;
+        Logger::getInstance().infof("[%s] %s request to %s cancelled", TAG, entry->stage.c_str(), entry->key.c_str());
+    }
+    return true;
+}
+
+void HttpClientPool::prewarm(std::vector<PrewarmTarget> targets) {
+    if (targets.empty() || prewarm_running_.exchange(true)) {
+        return;
+    }
+
+    auto* param = new std::vector<PrewarmTarget>(std::move(targets));
+    BaseType_t result = xTaskCreatePinnedToCore(
+        prewarmTask, "http_prewarm", TaskConfig::STACK_HTTP_PREWARM,
+        param, TaskConfig::PRIO_HTTP_PREWARM, nullptr, TaskConfig::CORE_HTTP_PREWARM);
+    if (result != pdPASS) {
+        delete param;
+        prewarm_running_.store(false);
+        Logger::getInstance().error("[HttpPool] Failed to create prewarm task");
+    }
+}
+
+void HttpClientPool::prewarmTask(void* param) {
+    std::unique_ptr<std::vector<PrewarmTarget>> targets(static_cast<std::vector<PrewarmTarget>*>(param));
+    HttpClientPool& pool = getInstance();
+    std::unordered_map<std::string, size_t> per_host;
+    for (const PrewarmTarget& target : *targets) {
+        pool.prewarmOne(target, ++per_host[hostKey(target.url)]);
+    }
+    targets.reset();
+    pool.prewarm_running_.store(false);
+    vTaskDelete(nullptr);
+}
+
+void HttpClientPool::prewarmOne(const PrewarmTarget& target, size_t wanted) {
+    const std::string key = hostKey(target.url);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sweepLocked(millis());
+        // Connections already up (or in use) for this host count toward the wanted ones
+        const size_t connected = std::count_if(entries_.begin(), entries_.end(),
+                                               [&key](const std::unique_ptr<Entry>& e) {
+                                                   return e->key == key && (e->busy || e->warm);
+                                               });
+        if (connected >= std::min(wanted, kMaxClientsPerHost)) {
+            return;
+        }
+    }
+
+    Options options = target.options;
+    options.stage = kPrewarmStage;
+    options.method = HTTP_METHOD_GET;
+    options.timeout_ms = kPrewarmTimeoutMs;
+    esp_http_client_handle_t client = acquire(target.url, options);
+    if (!client) {
+        return;
+    }
+
+    // Any response will do (405/404/401 included): only the connection matters
+    esp_http_client_set_post_field(client, nullptr, 0);
+    const uint32_t start = millis();
+    const esp_err_t err = esp_http_client_perform(client);
+    const uint32_t elapsed = millis() - start;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry* entry = findLocked(client);
+    if (!entry) {
+        return;
+    }
+    if (err == ESP_OK) {
+        entry->warm = true;
+        entry->warm_since_ms = millis();
+        Logger::getInstance().infof("[%s] Prewarmed %s in %u ms (status %d)", TAG, key.c_str(),
+                                    (unsigned)elapsed, esp_http_client_get_status_code(client));
+    } else {
+        esp_http_client_close(client);
+        Logger::getInstance().warnf("[%s] Prewarm of %s failed: %s", TAG, key.c_str(), esp_err_to_name(err));
+    }
+    entry->busy = false;
+    entry->stage.clear();
+    entry->last_used_ms = millis();
+}
+
+std::vector<HttpClientPool::StageStats> HttpClientPool::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<StageStats> result;
+    for (const auto& item : stats_) {
+        StageStats stats;
+        stats.stage = item.first;
+        stats.cold = item.second.cold;
+        stats.cold_avg_ms = item.second.cold ? static_cast<uint32_t>(item.second.cold_ms / item.second.cold) : 0;
+        stats.warm = item.second.warm;
+        stats.warm_avg_ms = item.second.warm ? static_cast<uint32_t>(item.second.warm_ms / item.second.warm) : 0;
+        stats.retries = item.second.retries;
+        stats.cancelled = item.second.cancelled;
+        result.push_back(std::move(stats));
+    }
+    std::sort(result.begin(), result.end(),
+              [](const StageStats& a, const StageStats& b) { return a.stage < b.stage; });
+    return result;
+}
+
+void HttpClientPool::closeIdle() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if ((*it)->busy) {
+            ++it;
+            continue;
+        }
+        esp_http_client_cleanup((*it)->client);
+        it = entries_.erase(it);
+    }
+}
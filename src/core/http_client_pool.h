@@ -0,0 +1,203 @@
+#pragma once
+
+#include <esp_http_client.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "core/cancel_token.h"
+
+/**
+ * @brief Per-host pool of esp_http_client handles for the assistant endpoints
+ *
+ * Handles are keyed by scheme://host:port and kept between requests, so a
+ * reconnect resumes the TLS session (when CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+ * is enabled) instead of doing a full handshake, and no handle is re-allocated
+ * per request. TCP keep-alive probes detect peers that went away.
+ *
+ * prewarm() connects ahead of use with a throw-away GET: esp_http_client keeps
+ * the connection open after esp_http_client_perform() when the server allows
+ * it, and the next acquire() for that host gets it already connected. A
+ * request's connection is kept the same way: release() leaves it open (warm)
+ * when the request body was written to the end and the response was read to
+ * the end, without an error or a cancellation, and closes it otherwise: an
+ * unfinished body would swallow the next request, unread bytes would be taken
+ * for the next response. Both are recorded per request, since
+ * esp_http_client_is_complete_data_received() still describes the previous
+ * response until the new one's headers are fetched.
+ *
+ * Health checks: a warm connection idle for longer than the host's keep-alive
+ * window is closed before use; if a warm connection still fails (e.g. the
+ * server closed it after its response), request() and open() retry once on a
+ * fresh connection and the host's window is halved. Handles unused for
+ * kHandleTtlMs are freed.
+ *
+ * Cancellation: a handle acquired with a CancelToken (Options::cancel, else the
+ * acquiring task's CancelToken::current()) waits for the response in slices of
+ * kCancelPollMs, so fetchHeaders() and read() return -1 within one slice of the
+ * token firing instead of after the full timeout; release() then closes the
+ * socket. The request's own timeout still applies to the time without data.
+ *
+ * Usage: acquire() -> setHeader() -> request()/open() -> read() -> release().
+ * Every acquired handle must be released, on every path.
+ */
+class HttpClientPool {
+public:
+    static constexpr size_t kMaxClients = 6;
+    static constexpr size_t kMaxClientsPerHost = 3;
+    static constexpr uint32_t kDefaultKeepAliveMs = 15000;  // Idle time a warm connection is trusted
+    static constexpr uint32_t kMinKeepAliveMs = 2000;
+    static constexpr uint32_t kHandleTtlMs = 5 * 60 * 1000;
+    static constexpr uint32_t kPrewarmTimeoutMs = 5000;
+    static constexpr uint32_t kCancelPollMs = 100;          // Wait slice of a cancellable request
+
+    struct Options {
+        const char* stage = "http";                   // Stats bucket ("stt", "llm", "tts", ...)
+        esp_http_client_method_t method = HTTP_METHOD_POST;
+        int timeout_ms = 30000;
+        int buffer_size = 4096;
+        int buffer_size_tx = 4096;
+        CancelToken cancel;                           // Empty: the acquiring task's CancelToken::current()
+    };
+
+    struct PrewarmTarget {
+        std::string url;
+        Options options;
+    };
+
+    /** Connect time per stage: cold = new TCP/TLS connection, warm = kept or prewarmed one */
+    struct StageStats {
+        std::string stage;
+        uint32_t cold = 0;
+        uint32_t cold_avg_ms = 0;
+        uint32_t warm = 0;
+        uint32_t warm_avg_ms = 0;
+        uint32_t retries = 0;       // Warm connections found dead and reopened
+        uint32_t cancelled = 0;     // Requests abandoned on their CancelToken
+    };
+
+    /** Writes the request body after the headers; called again on a retry */
+    using BodyWriter = std::function<bool(esp_http_client_handle_t client)>;
+
+    static HttpClientPool& getInstance();
+
+    esp_http_client_handle_t acquire(const std::string& url, const Options& options);
+    void release(esp_http_client_handle_t client);
+
+    /** Set a request header; removed again on release() */
+    void setHeader(esp_http_client_handle_t client, const char* key, const char* value);
+
+    /** esp_http_client_open() with connect timing and one retry on a dead warm connection */
+    esp_err_t open(esp_http_client_handle_t client, int write_len);
+
+    /**
+     * @brief Open, write the body and fetch the response headers
+     * @return HTTP status, or -1 if the request could not be sent
+     */
+    int request(esp_http_client_handle_t client, int write_len, const BodyWriter& write_body, int& content_length);
+    int request(esp_http_client_handle_t client, const char* body, size_t length, int& content_length);
+
+    /**
+     * @brief The request body has been written to the end
+     *
+     * request() records this itself; after open() the caller writes the body
+     * and calls this once the last byte (or the terminating chunk) is out.
+     */
+    void markSent(esp_http_client_handle_t client);
+
+    /**
+     * @brief Write one chunk of a chunked request body (open() with write_len -1)
+     *
+     * length 0 writes the terminating chunk and marks the body sent. A failed
+     * write marks the request failed.
+     */
+    bool writeChunk(esp_http_client_handle_t client, const char* data, size_t length);
+
+    /** Give up the current request (e.g. an upload stopped midway): release() closes the connection */
+    void markFailed(esp_http_client_handle_t client);
+
+    /** esp_http_client_fetch_headers(), returning -1 once the handle's token is cancelled */
+    int fetchHeaders(esp_http_client_handle_t client);
+
+    /** esp_http_client_read(), returning -1 once the handle's token is cancelled */
+    int read(esp_http_client_handle_t client, char* buffer, int length);
+
+    /** The token the handle was acquired with has fired */
+    bool cancelled(esp_http_client_handle_t client);
+
+    /**
+     * @brief Connect to the given endpoints in the background
+     *
+     * One connection per target, so endpoints sharing a host (cloud STT, LLM
+     * and TTS) each get their own; hosts already warm are skipped.
+     */
+    void prewarm(std::vector<PrewarmTarget> targets);
+
+    std::vector<StageStats> getStats() const;
+
+    /** Close and free every idle handle (e.g. on WiFi loss) */
+    void closeIdle();
+
+    /** scheme://host:port of a URL (default port filled in), the key handles are pooled by */
+    static std::string hostKey(const std::string& url);
+
+private:
+    struct Entry {
+        esp_http_client_handle_t client = nullptr;
+        std::string key;
+        int buffer_size = 0;
+        int buffer_size_tx = 0;
+        bool busy = false;
+        bool warm = false;              // Idle and connected (prewarmed, or kept after a complete response)
+        bool reused = false;            // Current lease started on a warm connection
+        bool failed = false;            // The current request or a read failed
+        bool sent = false;              // The current request's body was written to the end
+        bool received = false;          // Its response was read to the end
+        uint32_t warm_since_ms = 0;
+        uint32_t last_used_ms = 0;
+        std::string stage;
+        std::vector<std::string> headers;
+        CancelToken cancel;
+        uint32_t timeout_ms = 0;
+        bool sliced = false;            // Socket timeout cut to kCancelPollMs
+        bool aborted = false;           // Cancellation seen (counted once)
+    };
+
+    struct StageTotals {
+        uint32_t cold = 0;
+        uint64_t cold_ms = 0;
+        uint32_t warm = 0;
+        uint64_t warm_ms = 0;
+        uint32_t retries = 0;
+        uint32_t cancelled = 0;
+    };
+
+    HttpClientPool() = default;
+    HttpClientPool(const HttpClientPool&) = delete;
+    HttpClientPool& operator=(const HttpClientPool&) = delete;
+
+    static void prewarmTask(void* param);
+
+    Entry* findLocked(esp_http_client_handle_t client);
+    Entry* createLocked(const std::string& url, const std::string& key, const Options& options);
+    void sweepLocked(uint32_t now);
+    uint32_t keepAliveLocked(const std::string& key) const;
+    esp_err_t openOnce(esp_http_client_handle_t client, int write_len, bool& was_warm);
+    bool dropWarm(esp_http_client_handle_t client);
+    void markReceived(esp_http_client_handle_t client);
+    CancelToken beginWait(esp_http_client_handle_t client, uint32_t& timeout_ms);
+    bool checkCancelled(esp_http_client_handle_t client, const CancelToken& token);
+    void prewarmOne(const PrewarmTarget& target, size_t wanted);
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Entry>> entries_;
+    std::unordered_map<std::string, uint32_t> keep_alive_ms_;
+    std::unordered_map<std::string, StageTotals> stats_;
+    std::atomic<bool> prewarm_running_{false};
+};
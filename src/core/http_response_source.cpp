@@ -0,0 +1,433 @@
+#include "core/http_response_source.h"
+#include "core/http_client_pool.h"
+#include "core/task_config.h"
+#include "utils/logger.h"
+#include <Arduino.h>
+#include <freertos/task.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr size_t kDownloadChunkBytes = 1024;
+constexpr uint32_t kReceiveSliceMs = 50;
+constexpr uint32_t kSendSliceMs = 100;
+
+uint32_t readLe32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void writeLe32(uint8_t* p, uint32_t value) {
+    p[0] = static_cast<uint8_t>(value);
+    p[1] = static_cast<uint8_t>(value >> 8);
+    p[2] = static_cast<uint8_t>(value >> 16);
+    p[3] = static_cast<uint8_t>(value >> 24);
+}
+
+// Offset of the "data" chunk header in a RIFF/WAVE prefix (same walk as WavDecoder)
+// Returns 0 if not WAV or the chunk is not within the prefix
+size_t findWavDataChunk(const uint8_t* head, size_t length) {
+    if (length < 12 || memcmp(head, "RIFF", 4) != 0 || memcmp(head + 8, "WAVE", 4) != 0) {
+        return 0;
+    }
+    size_t offset = 12;
+    while (offset + 8 <= length) {
+        if (memcmp(head + offset, "data", 4) == 0) {
+            return offset;
+        }
+        offset += 8 + readLe32(head + offset + 4);
+    }
+    return 0;
+}
+
+bool isOpenEndedSize(uint32_t size) {
+    return size == 0 || size == 0xFFFFFFFF;
+}
+
+} // namespace
+
+struct HttpResponseSource::Download {
+    esp_http_client_handle_t client = nullptr;
+    int content_length = -1;
+    StreamBufferHandle_t ring = nullptr;
+    StaticStreamBuffer_t* ring_struct = nullptr;
+    uint8_t* ring_storage = nullptr;
+    fs::FS* tee_fs = nullptr;
+    std::string tee_path;
+    std::function<void(bool, size_t)> on_tee_closed;
+    std::function<void(esp_http_client_handle_t)> release_client;
+    std::atomic<size_t> received{0};
+    std::atomic<bool> finished{false};
+    std::atomic<bool> failed{false};
+    std::atomic<bool> abort{false};
+
+    ~Download() {
+        releaseClient();
+        if (ring) {
+            vStreamBufferDelete(ring);
+        }
+        heap_caps_free(ring_storage);
+        heap_caps_free(ring_struct);
+    }
+
+    void releaseClient() {
+        if (!client) {
+            return;
+        }
+        if (release_client) {
+            release_client(client);
+        } else {
+            esp_http_client_close(client);
+            esp_http_client_cleanup(client);
+        }
+        client = nullptr;
+    }
+};
+
+HttpResponseSource::HttpResponseSource(const Config& config, const char* uri)
+    : config_(config), uri_(uri ? uri : "") {}
+
+HttpResponseSource::~HttpResponseSource() {
+    close();
+}
+
+bool HttpResponseSource::attach(esp_http_client_handle_t client, int content_length) {
+    auto& logger = Logger::getInstance();
+    if (!client) {
+        return false;
+    }
+    if (download_) {
+        if (config_.release_client) {
+            config_.release_client(client);
+        } else {
+            esp_http_client_close(client);
+            esp_http_client_cleanup(client);
+        }
+        logger.warn("[HttpSource] Already attached to a response");
+        return false;
+    }
+
+    auto download = std::make_shared<Download>();
+    download->client = client;
+    download->content_length = content_length > 0 ? content_length : -1;
+    download->tee_fs = config_.tee_fs;
+    download->tee_path = config_.tee_path;
+    download->on_tee_closed = config_.on_tee_closed;
+    download->release_client = config_.release_client;
+
+    const size_t ring_bytes = std::max(config_.ring_bytes, kHeadBytes);
+    download->ring_struct = static_cast<StaticStreamBuffer_t*>(heap_caps_malloc(sizeof(StaticStreamBuffer_t), MALLOC_CAP_INTERNAL));
+    download->ring_storage = static_cast<uint8_t*>(heap_caps_malloc(ring_bytes + 1, MALLOC_CAP_SPIRAM));
+    if (download->ring_struct && download->ring_storage) {
+        download->ring = xStreamBufferCreateStatic(ring_bytes, 1, download->ring_storage, download->ring_struct);
+    }
+    if (!head_) {
+        head_ = static_cast<uint8_t*>(heap_caps_malloc(kHeadBytes, MALLOC_CAP_SPIRAM));
+    }
+    if (!download->ring || !head_) {
+        logger.error("[HttpSource] Failed to allocate jitter buffer");
+        return false;
+    }
+
+    auto* task_ref = new std::shared_ptr<Download>(download);
+    BaseType_t result = xTaskCreatePinnedToCore(
+        taskEntry, "http_source", TaskConfig::STACK_HTTP_SOURCE,
+        task_ref, TaskConfig::PRIO_HTTP_SOURCE, nullptr, TaskConfig::CORE_HTTP_SOURCE);
+    if (result != pdPASS) {
+        delete task_ref;
+        logger.error("[HttpSource] Failed to create download task");
+        return false;
+    }
+
+    download_ = download;
+    head_length_ = 0;
+    header_checked_ = false;
+    position_ = 0;
+    consumed_ = 0;
+    logger.infof("[HttpSource] Streaming response body (%d bytes, ring %u KB%s%s)",
+                 download->content_length, (unsigned)(ring_bytes / 1024),
+                 download->tee_fs ? ", tee " : "", download->tee_fs ? download->tee_path.c_str() : "");
+    return true;
+}
+
+bool HttpResponseSource::waitForPrebuffer() {
+    if (!download_) {
+        return false;
+    }
+
+    const size_t target = std::min(config_.prebuffer_bytes, config_.ring_bytes);
+    const uint32_t start = millis();
+    while (!download_->abort.load()) {
+        const size_t buffered = xStreamBufferBytesAvailable(download_->ring);
+        if (buffered >= target) {
+            return true;
+        }
+        if (download_->finished.load()) {
+            return buffered > 0 && !download_->failed.load();
+        }
+        if (millis() - start > config_.prebuffer_timeout_ms) {
+            Logger::getInstance().warnf("[HttpSource] Prebuffer timeout (%u of %u bytes)",
+                                        (unsigned)buffered, (unsigned)target);
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    return false;
+}
+
+HttpResponseSource::Stats HttpResponseSource::getStats() const {
+    Stats stats;
+    if (download_) {
+        stats.received = download_->received.load();
+        stats.buffered = xStreamBufferBytesAvailable(download_->ring);
+        stats.content_length = download_->content_length;
+        stats.finished = download_->finished.load();
+        stats.failed = download_->failed.load();
+    }
+    return stats;
+}
+
+size_t HttpResponseSource::read(void* buffer, size_t size) {
+    if (!download_ || !buffer) {
+        return 0;
+    }
+
+    uint8_t* out = static_cast<uint8_t*>(buffer);
+    size_t total = 0;
+    while (total < size) {
+        if (position_ < head_length_) {
+            const size_t n = std::min(size - total, head_length_ - position_);
+            memcpy(out + total, head_ + position_, n);
+            position_ += n;
+            total += n;
+            continue;
+        }
+
+        size_t got;
+        if (consumed_ < kHeadBytes) {
+            // Header region: land in head_ first so it can be patched and re-read
+            got = receive(head_ + head_length_, std::min(kHeadBytes - head_length_, size - total));
+            head_length_ += got;
+            consumed_ += got;
+            if (!header_checked_) {
+                patchWavHeader();
+            }
+        } else {
+            got = receive(out + total, size - total);
+            consumed_ += got;
+            position_ += got;
+            total += got;
+        }
+        if (got == 0) {
+            break;
+        }
+    }
+    return total;
+}
+
+bool HttpResponseSource::seek(size_t position) {
+    if (!download_) {
+        return false;
+    }
+    if (position == position_) {
+        return true;
+    }
+    if (position <= head_length_ && consumed_ == head_length_) {
+        position_ = position;
+        return true;
+    }
+    if (position < consumed_) {
+        return false;  // Already streamed past the retained header
+    }
+
+    // Forward: discard up to the target
+    position_ = consumed_;
+    uint8_t scratch[256];
+    while (consumed_ < position) {
+        size_t got;
+        if (consumed_ < kHeadBytes) {
+            got = receive(head_ + head_length_, std::min(kHeadBytes - head_length_, position - consumed_));
+            head_length_ += got;
+            if (!header_checked_) {
+                patchWavHeader();
+            }
+        } else {
+            got = receive(scratch, std::min(sizeof(scratch), position - consumed_));
+        }
+        if (got == 0) {
+            return false;
+        }
+        consumed_ += got;
+        position_ = consumed_;
+    }
+    return true;
+}
+
+size_t HttpResponseSource::size() const {
+    if (download_ && download_->content_length > 0) {
+        return static_cast<size_t>(download_->content_length);
+    }
+    return SIZE_MAX;  // Unknown: never let a decoder stop at a guessed end
+}
+
+bool HttpResponseSource::open(const char* uri) {
+    // The response is attached, not opened by URI
+    (void)uri;
+    return download_ != nullptr;
+}
+
+void HttpResponseSource::close() {
+    request_stop();
+    download_.reset();
+    heap_caps_free(head_);
+    head_ = nullptr;
+    head_length_ = 0;
+    position_ = 0;
+    consumed_ = 0;
+}
+
+void HttpResponseSource::request_stop() {
+    if (download_) {
+        download_->abort.store(true);
+    }
+}
+
+size_t HttpResponseSource::receive(void* buffer, size_t size) {
+    uint8_t* out = static_cast<uint8_t*>(buffer);
+    size_t got = 0;
+    uint32_t last_data = millis();
+    while (got < size && !download_->abort.load()) {
+        // Checked before blocking, so the end of the body costs no receive slice
+        if (download_->finished.load() && xStreamBufferIsEmpty(download_->ring)) {
+            break;
+        }
+        const size_t n = xStreamBufferReceive(download_->ring, out + got, size - got, pdMS_TO_TICKS(kReceiveSliceMs));
+        if (n > 0) {
+            got += n;
+            last_data = millis();
+            continue;
+        }
+        if (millis() - last_data > config_.read_timeout_ms) {
+            Logger::getInstance().warnf("[HttpSource] No data for %u ms, ending stream", (unsigned)config_.read_timeout_ms);
+            break;
+        }
+    }
+    return got;
+}
+
+void HttpResponseSource::patchWavHeader() {
+    if (head_length_ < 12) {
+        return;
+    }
+    if (memcmp(head_, "RIFF", 4) != 0 || memcmp(head_ + 8, "WAVE", 4) != 0) {
+        header_checked_ = true;  // Not WAV (MP3 needs no fix-up)
+        return;
+    }
+
+    const size_t offset = findWavDataChunk(head_, head_length_);
+    if (offset == 0) {
+        header_checked_ = head_length_ >= kHeadBytes;
+        return;
+    }
+    if (isOpenEndedSize(readLe32(head_ + offset + 4))) {
+        const size_t data_offset = offset + 8;
+        const int content_length = download_->content_length;
+        const uint32_t patched = content_length > static_cast<int>(data_offset)
+                               ? static_cast<uint32_t>(content_length - data_offset)
+                               : 0xFFFFFFFF;
+        writeLe32(head_ + offset + 4, patched);
+        Logger::getInstance().infof("[HttpSource] Streaming WAV: data size set to %u", (unsigned)patched);
+    }
+    header_checked_ = true;
+}
+
+void HttpResponseSource::taskEntry(void* param) {
+    auto* ref = static_cast<std::shared_ptr<Download>*>(param);
+    runDownload(**ref);
+    delete ref;  // May free the download if the source is already gone
+    vTaskDelete(nullptr);
+}
+
+void HttpResponseSource::runDownload(Download& download) {
+    auto& logger = Logger::getInstance();
+
+    File tee;
+    bool tee_ok = false;
+    if (download.tee_fs && !download.tee_path.empty()) {
+        tee = download.tee_fs->open(download.tee_path.c_str(), FILE_WRITE);
+        tee_ok = static_cast<bool>(tee);
+        if (!tee) {
+            logger.warnf("[HttpSource] Cannot open tee file %s", download.tee_path.c_str());
+        }
+    }
+
+    uint8_t chunk[kDownloadChunkBytes];
+    uint8_t header[256];       // Body prefix, to finalize a streamed WAV header in the tee
+    size_t header_length = 0;
+    bool complete = false;
+    while (!download.abort.load()) {
+        const int n = HttpClientPool::getInstance().read(download.client, reinterpret_cast<char*>(chunk), sizeof(chunk));
+        if (n < 0) {
+            logger.errorf("[HttpSource] Read failed after %u bytes", (unsigned)download.received.load());
+            break;
+        }
+        if (n == 0) {
+            complete = esp_http_client_is_complete_data_received(download.client);
+            if (!complete) {
+                logger.errorf("[HttpSource] Body truncated at %u bytes", (unsigned)download.received.load());
+            }
+            break;
+        }
+
+        if (header_length < sizeof(header)) {
+            const size_t take = std::min(sizeof(header) - header_length, static_cast<size_t>(n));
+            memcpy(header + header_length, chunk, take);
+            header_length += take;
+        }
+
+        if (tee && tee.write(chunk, n) != static_cast<size_t>(n)) {
+            logger.warnf("[HttpSource] Tee write failed, dropping %s", download.tee_path.c_str());
+            tee.close();
+            download.tee_fs->remove(download.tee_path.c_str());
+            tee_ok = false;
+        }
+
+        size_t sent = 0;
+        while (sent < static_cast<size_t>(n) && !download.abort.load()) {
+            sent += xStreamBufferSend(download.ring, chunk + sent, n - sent, pdMS_TO_TICKS(kSendSliceMs));
+        }
+        download.received.fetch_add(n);
+    }
+
+    if (tee) {
+        // The file is replayed later, so give it the real RIFF and data sizes
+        const size_t data_chunk = complete ? findWavDataChunk(header, header_length) : 0;
+        if (data_chunk > 0 && isOpenEndedSize(readLe32(header + data_chunk + 4))) {
+            const size_t total = download.received.load();
+            uint8_t size_field[4];
+            writeLe32(size_field, static_cast<uint32_t>(total - 8));
+            tee.seek(4);
+            tee.write(size_field, 4);
+            writeLe32(size_field, static_cast<uint32_t>(total - data_chunk - 8));
+            tee.seek(data_chunk + 4);
+            tee.write(size_field, 4);
+        }
+        tee.close();
+        if (!complete) {
+            download.tee_fs->remove(download.tee_path.c_str());
+        }
+    }
+    if (download.on_tee_closed && download.tee_fs) {
+        download.on_tee_closed(tee_ok && complete, download.received.load());
+    }
+
+    download.releaseClient();
+
+    download.failed.store(!complete);
+    download.finished.store(true);
+    logger.infof("[HttpSource] Download %s (%u bytes)",
+                 complete ? "complete" : (download.abort.load() ? "aborted" : "failed"),
+                 (unsigned)download.received.load());
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/stream_buffer.h>
+#include <esp_http_client.h>
+#include <FS.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "../lib/openESPaudio/src/data_source.h"
+
+/**
+ * @brief IDataSource over the body of an in-flight HTTP response
+ *
+ * attach() takes an esp_http_client whose headers have already been fetched and
+ * starts a download task that drains the body into a PSRAM jitter ring, so the
+ * player can start decoding after waitForPrebuffer() instead of after the whole
+ * download. The body can optionally be teed to a file; a partial file is removed
+ * if the download fails or is aborted.
+ *
+ * The source is forward-only. The first kHeadBytes stay addressable so decoders
+ * can seek around the container header (WAV chunk walk), and forward seeks are
+ * served by discarding. read() only returns short at end of body, on stop or
+ * after read_timeout_ms without data, so PCM frames stay aligned.
+ *
+ * Streaming WAV encoders write 0 or 0xFFFFFFFF as the data chunk size; the size
+ * is rewritten from Content-Length (or left open-ended) so WavDecoder plays the
+ * body to its end, and the tee file gets the real sizes once the body is complete.
+ *
+ * The download state is shared with the task, so destroying the source never
+ * waits for a blocked socket read: the task exits and frees it on its own.
+ */
+class HttpResponseSource : public IDataSource {
+public:
+    static constexpr size_t kHeadBytes = 4096;
+
+    struct Config {
+        size_t ring_bytes = 128 * 1024;        // ~2.7 s of 24 kHz mono PCM16
+        size_t prebuffer_bytes = 16 * 1024;    // Jitter buffer before playback starts
+        uint32_t prebuffer_timeout_ms = 10000;
+        uint32_t read_timeout_ms = 10000;      // Stall tolerated mid-stream
+        fs::FS* tee_fs = nullptr;              // Optional copy of the body
+        std::string tee_path;
+        // Called from the download task once the tee is closed (saved = complete file kept)
+        std::function<void(bool saved, size_t bytes)> on_tee_closed;
+        // Hands the client back when done (e.g. to HttpClientPool); default is close + cleanup
+        std::function<void(esp_http_client_handle_t client)> release_client;
+    };
+
+    struct Stats {
+        size_t received = 0;                   // Body bytes downloaded so far
+        size_t buffered = 0;                   // Bytes waiting in the ring
+        int content_length = -1;               // -1 when chunked/unknown
+        bool finished = false;
+        bool failed = false;
+    };
+
+    explicit HttpResponseSource(const Config& config, const char* uri = "http://response.wav");
+    ~HttpResponseSource() override;
+
+    /**
+     * @brief Take ownership of an open client and start downloading its body
+     * @param client Client after esp_http_client_fetch_headers(); cleaned up by the source in any case
+     * @param content_length Value returned by fetch_headers (<= 0 if unknown)
+     */
+    bool attach(esp_http_client_handle_t client, int content_length);
+
+    /**
+     * @brief Block until prebuffer_bytes are buffered or the body is complete
+     * @return false on timeout, download failure or stop
+     */
+    bool waitForPrebuffer();
+
+    Stats getStats() const;
+
+    // IDataSource
+    size_t read(void* buffer, size_t size) override;
+    bool seek(size_t position) override;
+    size_t tell() const override { return position_; }
+    size_t size() const override;
+    bool open(const char* uri) override;
+    void close() override;
+    bool is_open() const override { return download_ != nullptr; }
+    bool is_seekable() const override { return false; }
+    SourceType type() const override { return SourceType::HTTP_RESPONSE; }
+    const char* uri() const override { return uri_.c_str(); }
+    void request_stop() override;
+
+private:
+    struct Download;
+
+    static void taskEntry(void* param);
+    static void runDownload(Download& download);
+    size_t receive(void* buffer, size_t size);
+    void patchWavHeader();
+
+    Config config_;
+    std::string uri_;
+    std::shared_ptr<Download> download_;
+
+    uint8_t* head_ = nullptr;
+    size_t head_length_ = 0;
+    bool header_checked_ = false;
+    size_t position_ = 0;     // Logical read position
+    size_t consumed_ = 0;     // Bytes taken out of the ring
+};
@@ -0,0 +1,92 @@
+#include "core/intent_matcher.h"
+
+#include <LittleFS.h>
+
+#include "core/command_center.h"
+#include "utils/logger.h"
+
+namespace {
+constexpr const char* TAG = "IntentMatcher";
+
+uint32_t average(uint32_t current, uint32_t sample) {
+    return current == 0 ? sample : (current * 7 + sample) / 8;
+}
+} // namespace
+
+constexpr size_t IntentMatcher::kMaxWords;
+
+IntentMatcher& IntentMatcher::getInstance() {
+    static IntentMatcher instance;
+    return instance;
+}
+
+bool IntentMatcher::match(const std::string& text, Result& result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!built_ || CommandCenter::getInstance().getGeneration() != command_generation_) {
+        buildLocked();
+    }
+
+    ++stats_.utterances;
+    return table_.match(text, result);
+}
+
+void IntentMatcher::recordLocal(bool success, uint32_t elapsed_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!success) {
+        ++stats_.failed;
+        return;
+    }
+    ++stats_.matched;
+    stats_.avg_local_ms = average(stats_.avg_local_ms, elapsed_ms);
+    if (stats_.avg_llm_ms > elapsed_ms) {
+        stats_.saved_ms += stats_.avg_llm_ms - elapsed_ms;
+    }
+}
+
+void IntentMatcher::recordLlm(uint32_t elapsed_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.avg_llm_ms = average(stats_.avg_llm_ms, elapsed_ms);
+}
+
+void IntentMatcher::reload() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    built_ = false;
+}
+
+IntentMatcher::Stats IntentMatcher::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.patterns = table_.patterns();
+    return stats;
+}
+
+void IntentMatcher::buildLocked() {
+    table_.clear();
+
+    command_generation_ = CommandCenter::getInstance().getGeneration();
+    std::vector<std::string> registered;
+    for (const CommandInfo& info : CommandCenter::getInstance().listCommands()) {
+        registered.push_back(info.name);
+    }
+
+    loadUserIntentsLocked();
+    table_.addBuiltins(registered);
+    table_.addCommandNames(registered);
+
+    built_ = true;
+    Logger::getInstance().infof("[%s] Grammar built: %u intents, %u patterns", TAG,
+                                (unsigned)table_.intents(), (unsigned)table_.patterns());
+}
+
+void IntentMatcher::loadUserIntentsLocked() {
+    if (!LittleFS.exists(USER_FILE)) {
+        return;
+    }
+    File file = LittleFS.open(USER_FILE, FILE_READ);
+    if (!file) {
+        return;
+    }
+    const String json = file.readString();
+    file.close();
+    table_.addUserIntents(json.c_str());
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "utils/intent_table.h"
+
+/**
+ * @brief Local fast-path for common spoken commands
+ *
+ * Runs on the user text before it is sent to the LLM. The grammar is compiled
+ * from, in priority order:
+ *   1. user intents in LittleFS /intents.json
+ *   2. built-in Italian phrasings for registered CommandCenter commands
+ *      ("alza il volume", "luminosità al 50", "ferma la radio")
+ *   3. every registered command by name ("system status", "heap")
+ *
+ * /intents.json format:
+ * {"intents": [{"command": "lua_script",
+ *               "patterns": ["accendi [la] luce {room:word}"],
+ *               "args": ["lights.on(\"{room}\")"],
+ *               "reply": "Luce {room} accesa"}]}
+ *
+ * Slots are substituted into args and reply ({result} in the reply is the
+ * command output); values substituted into lua_script args are escaped for Lua
+ * string literals. Only utterances fully covered by a pattern match; anything
+ * else goes to the LLM. The grammar (an IntentTable) is rebuilt when commands
+ * are registered or reload() is called.
+ */
+class IntentMatcher {
+public:
+    static constexpr const char* USER_FILE = "/intents.json";
+    static constexpr size_t kMaxWords = IntentTable::kMaxWords;
+
+    using Result = IntentTable::Result;
+
+    struct Stats {
+        uint32_t utterances = 0;       // Texts checked
+        uint32_t matched = 0;          // Handled locally (command succeeded)
+        uint32_t failed = 0;           // Matched but the command failed (fell through to the LLM)
+        uint32_t avg_local_ms = 0;
+        uint32_t avg_llm_ms = 0;       // LLM round trip, for the saving estimate
+        uint32_t saved_ms = 0;         // Sum of (avg LLM round trip - local time) per match
+        size_t patterns = 0;
+    };
+
+    static IntentMatcher& getInstance();
+
+    /** Match text against the grammar (counts as one utterance) */
+    bool match(const std::string& text, Result& result);
+
+    /** Outcome of executing a matched intent */
+    void recordLocal(bool success, uint32_t elapsed_ms);
+
+    /** Duration of an LLM round trip that was not avoided */
+    void recordLlm(uint32_t elapsed_ms);
+
+    /** Re-read /intents.json and the command list on next match */
+    void reload();
+
+    Stats getStats() const;
+
+private:
+    IntentMatcher() = default;
+    IntentMatcher(const IntentMatcher&) = delete;
+    IntentMatcher& operator=(const IntentMatcher&) = delete;
+
+    void buildLocked();
+    void loadUserIntentsLocked();
+
+    mutable std::mutex mutex_;
+    IntentTable table_;
+    bool built_ = false;
+    uint32_t command_generation_ = 0;  // CommandCenter generation the grammar was built from
+    Stats stats_;
+};
@@ -0,0 +1,192 @@
+#include "keyword_spotter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr size_t kHeaderSize = 16;
+constexpr size_t kLayerHeaderSize = 8;
+
+inline uint16_t readLe16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline uint32_t readLe32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline size_t alignTo4(size_t value) {
+    return (value + 3) & ~static_cast<size_t>(3);
+}
+
+inline int8_t saturateInt8(int32_t value) {
+    return static_cast<int8_t>(std::max<int32_t>(-128, std::min<int32_t>(127, value)));
+}
+
+} // namespace
+
+bool KeywordSpotter::loadModel(const uint8_t* data, size_t size) {
+    unload();
+    if (!data || size < kHeaderSize || (reinterpret_cast<uintptr_t>(data) & 3) != 0) {
+        return false;
+    }
+    if (readLe32(data) != kModelMagic) {
+        return false;
+    }
+
+    const uint16_t frames = readLe16(data + 4);
+    const uint8_t bins = data[6];
+    const uint8_t layer_count = data[7];
+    if (frames == 0 || bins == 0 || layer_count == 0 || layer_count > kMaxLayers) {
+        return false;
+    }
+
+    std::vector<Layer> layers;
+    layers.reserve(layer_count);
+    size_t offset = kHeaderSize;
+    size_t expected_inputs = static_cast<size_t>(frames) * bins;
+    size_t widest = expected_inputs;
+    size_t macs = 0;
+
+    for (uint8_t i = 0; i < layer_count; ++i) {
+        if (offset + kLayerHeaderSize > size) {
+            return false;
+        }
+        Layer layer;
+        layer.inputs = readLe16(data + offset);
+        layer.outputs = readLe16(data + offset + 2);
+        layer.shift = data[offset + 4];
+        layer.relu = (data[offset + 5] & 0x01) != 0;
+        offset += kLayerHeaderSize;
+
+        if (layer.inputs != expected_inputs || layer.outputs == 0 || layer.shift > 31) {
+            return false;
+        }
+        const size_t bias_bytes = static_cast<size_t>(layer.outputs) * sizeof(int32_t);
+        const size_t weight_bytes = static_cast<size_t>(layer.outputs) * layer.inputs;
+        if (offset + bias_bytes + alignTo4(weight_bytes) > size) {
+            return false;
+        }
+        layer.bias = reinterpret_cast<const int32_t*>(data + offset);
+        offset += bias_bytes;
+        layer.weights = reinterpret_cast<const int8_t*>(data + offset);
+        offset += alignTo4(weight_bytes);
+
+        macs += weight_bytes;
+        widest = std::max<size_t>(widest, layer.outputs);
+        expected_inputs = layer.outputs;
+        layers.push_back(layer);
+    }
+
+    const uint8_t keyword_index = data[11];
+    if (keyword_index >= layers.back().outputs) {
+        return false;
+    }
+
+    float output_scale = 1.0f;
+    memcpy(&output_scale, data + 12, sizeof(output_scale));
+    if (!(output_scale > 0.0f)) {
+        return false;
+    }
+
+    frames_ = frames;
+    bins_ = bins;
+    input_offset_ = static_cast<int16_t>(readLe16(data + 8));
+    input_shift_ = std::min<uint8_t>(data[10], 15);
+    keyword_index_ = keyword_index;
+    output_scale_ = output_scale;
+    macs_ = macs;
+    layers_ = std::move(layers);
+
+    window_.assign(static_cast<size_t>(frames_) * bins_, 0);
+    activations_a_.assign(widest, 0);
+    activations_b_.assign(widest, 0);
+    reset();
+    return true;
+}
+
+void KeywordSpotter::unload() {
+    layers_.clear();
+    window_.clear();
+    activations_a_.clear();
+    activations_b_.clear();
+    frames_ = 0;
+    bins_ = 0;
+    macs_ = 0;
+    reset();
+}
+
+void KeywordSpotter::reset() {
+    std::fill(window_.begin(), window_.end(), 0);
+    next_frame_ = 0;
+    frames_seen_ = 0;
+}
+
+void KeywordSpotter::pushFrame(const int16_t* features) {
+    if (!isLoaded() || !features) {
+        return;
+    }
+    int8_t* slot = &window_[next_frame_ * bins_];
+    for (uint8_t i = 0; i < bins_; ++i) {
+        slot[i] = saturateInt8((static_cast<int32_t>(features[i]) - input_offset_) >> input_shift_);
+    }
+    next_frame_ = (next_frame_ + 1) % frames_;
+    if (frames_seen_ < frames_) {
+        ++frames_seen_;
+    }
+}
+
+void KeywordSpotter::runLayer(const Layer& layer, const int8_t* input, int8_t* output) {
+    const int32_t rounding = layer.shift > 0 ? (1 << (layer.shift - 1)) : 0;
+    for (size_t o = 0; o < layer.outputs; ++o) {
+        const int8_t* weights = layer.weights + o * layer.inputs;
+        int32_t acc = layer.bias[o];
+        for (size_t i = 0; i < layer.inputs; ++i) {
+            acc += static_cast<int32_t>(weights[i]) * input[i];
+        }
+        int32_t value = (acc + rounding) >> layer.shift;
+        if (layer.relu && value < 0) {
+            value = 0;
+        }
+        output[o] = saturateInt8(value);
+    }
+}
+
+uint8_t KeywordSpotter::infer() {
+    if (!isLoaded()) {
+        return 0;
+    }
+
+    // Flatten the ring oldest frame first
+    const size_t split = next_frame_ * bins_;
+    const size_t total = window_.size();
+    memcpy(activations_a_.data(), window_.data() + split, total - split);
+    memcpy(activations_a_.data() + (total - split), window_.data(), split);
+
+    int8_t* input = activations_a_.data();
+    int8_t* output = activations_b_.data();
+    for (const Layer& layer : layers_) {
+        runLayer(layer, input, output);
+        std::swap(input, output);
+    }
+
+    // Softmax over the few output classes; float is fine at this size
+    const Layer& last = layers_.back();
+    int32_t max_logit = input[0];
+    for (size_t i = 1; i < last.outputs; ++i) {
+        max_logit = std::max<int32_t>(max_logit, input[i]);
+    }
+    float sum = 0.0f;
+    float keyword = 0.0f;
+    for (size_t i = 0; i < last.outputs; ++i) {
+        const float e = std::exp((input[i] - max_logit) * output_scale_);
+        sum += e;
+        if (i == keyword_index_) {
+            keyword = e;
+        }
+    }
+    return static_cast<uint8_t>(std::lround(255.0f * keyword / sum));
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Int8 quantized keyword-spotting network over a sliding log-mel window
+ *
+ * The model is a stack of fully connected int8 layers (int32 accumulators,
+ * per-layer power-of-two requantization, optional ReLU) applied to the last
+ * `frames` feature frames produced by LogMelFrontend. The final layer yields
+ * int8 logits; softmax over them gives the keyword probability.
+ *
+ * Model blob layout (little-endian, every section 4-byte aligned):
+ *   Header  (16 bytes): uint32 magic 'KWS1', uint16 frames, uint8 bins, uint8 layers,
+ *                       int16 input_offset, uint8 input_shift, uint8 keyword_index,
+ *                       float output_scale
+ *   Layer    (8 bytes): uint16 inputs, uint16 outputs, uint8 shift, uint8 flags (bit0 = ReLU),
+ *                       uint16 reserved
+ *            followed by int32 bias[outputs] and int8 weights[outputs][inputs]
+ *            (row-major, padded to a multiple of 4 bytes)
+ *
+ * Input quantization: q = clamp((feature - input_offset) >> input_shift, -128, 127),
+ * with features in LogMelFrontend units (64 * log2 energy). The first layer's
+ * input is the window flattened oldest frame first.
+ *
+ * The blob is not copied: it must outlive the spotter (keep it in PSRAM).
+ */
+class KeywordSpotter {
+public:
+    static constexpr uint32_t kModelMagic = 0x3153574B;  // "KWS1"
+    static constexpr uint8_t kMaxLayers = 8;
+
+    KeywordSpotter() = default;
+
+    /**
+     * @brief Validate and bind a model blob
+     * @return false if the blob is malformed; the spotter is left unloaded
+     */
+    bool loadModel(const uint8_t* data, size_t size);
+    void unload();
+    bool isLoaded() const { return !layers_.empty(); }
+
+    /** Forget buffered frames (call when the audio stream restarts) */
+    void reset();
+
+    /** Append one feature frame of bins() values; the oldest frame drops out */
+    void pushFrame(const int16_t* features);
+
+    /** True once a full window of frames has been pushed since reset() */
+    bool ready() const { return frames_seen_ >= frames_; }
+
+    /**
+     * @brief Run the network on the current window
+     * @return Keyword probability scaled to 0-255
+     */
+    uint8_t infer();
+
+    uint16_t frames() const { return frames_; }
+    uint8_t bins() const { return bins_; }
+    size_t macsPerInference() const { return macs_; }
+
+private:
+    struct Layer {
+        uint16_t inputs = 0;
+        uint16_t outputs = 0;
+        uint8_t shift = 0;
+        bool relu = false;
+        const int32_t* bias = nullptr;
+        const int8_t* weights = nullptr;
+    };
+
+    static void runLayer(const Layer& layer, const int8_t* input, int8_t* output);
+
+    std::vector<Layer> layers_;
+    uint16_t frames_ = 0;
+    uint8_t bins_ = 0;
+    int16_t input_offset_ = 0;
+    uint8_t input_shift_ = 0;
+    uint8_t keyword_index_ = 0;
+    float output_scale_ = 1.0f;
+    size_t macs_ = 0;
+
+    std::vector<int8_t> window_;    // Ring of frames_ * bins_ quantized features
+    size_t next_frame_ = 0;
+    uint32_t frames_seen_ = 0;
+    std::vector<int8_t> activations_a_;
+    std::vector<int8_t> activations_b_;
+};
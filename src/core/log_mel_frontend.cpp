@@ -0,0 +1,231 @@
+#include "log_mel_frontend.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr float kPi = 3.14159265358979f;
+
+inline float hzToMel(float hz) {
+    return 2595.0f * std::log10(1.0f + hz / 700.0f);
+}
+
+inline float melToHz(float mel) {
+    return 700.0f * (std::pow(10.0f, mel / 2595.0f) - 1.0f);
+}
+
+inline int16_t toQ15(float value) {
+    const float scaled = std::round(value * 32767.0f);
+    return static_cast<int16_t>(std::max(-32767.0f, std::min(32767.0f, scaled)));
+}
+
+inline int countLeadingZeros64(uint64_t value) {
+#if defined(__GNUC__)
+    return __builtin_clzll(value);
+#else
+    int count = 0;
+    for (uint64_t mask = 1ULL << 63; mask && !(value & mask); mask >>= 1) {
+        ++count;
+    }
+    return count;
+#endif
+}
+
+} // namespace
+
+LogMelFrontend::LogMelFrontend() {
+    configure(Config());
+}
+
+bool LogMelFrontend::configure(const Config& config) {
+    if (config.sample_rate == 0 || config.window_samples == 0 || config.window_samples > kFftSize ||
+        config.hop_samples == 0 || config.hop_samples > config.window_samples ||
+        config.num_bins == 0 || config.num_bins > kMaxBins ||
+        config.lower_hz >= config.upper_hz || config.upper_hz > config.sample_rate / 2) {
+        return false;
+    }
+    config_ = config;
+
+    samples_.assign(config_.window_samples, 0);
+    re_.assign(kFftSize, 0);
+    im_.assign(kFftSize, 0);
+    power_.assign(kFftSize / 2 + 1, 0);
+    features_.assign(config_.num_bins, 0);
+
+    window_q15_.resize(config_.window_samples);
+    for (size_t i = 0; i < config_.window_samples; ++i) {
+        window_q15_[i] = toQ15(0.5f - 0.5f * std::cos(2.0f * kPi * i / config_.window_samples));
+    }
+
+    cos_q15_.resize(kFftSize / 2);
+    sin_q15_.resize(kFftSize / 2);
+    for (size_t i = 0; i < kFftSize / 2; ++i) {
+        const float angle = 2.0f * kPi * i / kFftSize;
+        cos_q15_[i] = toQ15(std::cos(angle));
+        sin_q15_[i] = toQ15(std::sin(angle));
+    }
+
+    bit_reverse_.resize(kFftSize);
+    for (size_t i = 0; i < kFftSize; ++i) {
+        size_t reversed = 0;
+        for (size_t bit = 0; bit < kFftStages; ++bit) {
+            reversed |= ((i >> bit) & 1u) << (kFftStages - 1 - bit);
+        }
+        bit_reverse_[i] = static_cast<uint16_t>(reversed);
+    }
+
+    // Triangular filters equally spaced on the mel scale, stored sparsely
+    const float bin_hz = static_cast<float>(config_.sample_rate) / kFftSize;
+    const float mel_low = hzToMel(config_.lower_hz);
+    const float mel_step = (hzToMel(config_.upper_hz) - mel_low) / (config_.num_bins + 1);
+
+    filters_.assign(config_.num_bins, MelFilter());
+    filter_weights_q15_.clear();
+    for (uint8_t m = 0; m < config_.num_bins; ++m) {
+        const float left = melToHz(mel_low + mel_step * m);
+        const float center = melToHz(mel_low + mel_step * (m + 1));
+        const float right = melToHz(mel_low + mel_step * (m + 2));
+
+        MelFilter& filter = filters_[m];
+        filter.weight_offset = static_cast<uint16_t>(filter_weights_q15_.size());
+        const size_t first = static_cast<size_t>(std::ceil(left / bin_hz));
+        for (size_t k = first; k <= kFftSize / 2; ++k) {
+            const float hz = k * bin_hz;
+            if (hz >= right) {
+                break;
+            }
+            const float weight = hz <= center ? (hz - left) / (center - left) : (right - hz) / (right - center);
+            if (weight <= 0.0f) {
+                continue;
+            }
+            if (filter.length == 0) {
+                filter.first_bin = static_cast<uint16_t>(k);
+            }
+            filter_weights_q15_.push_back(static_cast<uint16_t>(toQ15(weight)));
+            filter.length = static_cast<uint16_t>(k - filter.first_bin + 1);
+        }
+        if (filter.length == 0) {
+            // Narrower than one FFT bin (low frequencies): take the nearest bin
+            filter.first_bin = static_cast<uint16_t>(std::min<size_t>(kFftSize / 2, std::lround(center / bin_hz)));
+            filter.length = 1;
+            filter_weights_q15_.push_back(32767);
+        }
+    }
+
+    reset();
+    return true;
+}
+
+void LogMelFrontend::reset() {
+    std::fill(samples_.begin(), samples_.end(), 0);
+    std::fill(features_.begin(), features_.end(), 0);
+    fill_ = 0;
+    frame_ready_ = false;
+}
+
+size_t LogMelFrontend::push(const int16_t* samples, size_t count) {
+    frame_ready_ = false;
+    if (!samples || samples_.empty()) {
+        return count;
+    }
+
+    const size_t take = std::min(count, samples_.size() - fill_);
+    memcpy(&samples_[fill_], samples, take * sizeof(int16_t));
+    fill_ += take;
+
+    if (fill_ == samples_.size()) {
+        computeFrame();
+        frame_ready_ = true;
+        // Keep the overlap for the next window
+        const size_t keep = config_.window_samples - config_.hop_samples;
+        memmove(samples_.data(), samples_.data() + config_.hop_samples, keep * sizeof(int16_t));
+        fill_ = keep;
+    }
+    return take;
+}
+
+int32_t LogMelFrontend::log2Q6(uint64_t value) {
+    const uint64_t x = value + 1;
+    const int msb = 63 - countLeadingZeros64(x);
+    const uint32_t mantissa = static_cast<uint32_t>(
+        (msb >= 16 ? (x >> (msb - 16)) : (x << (16 - msb))) & 0xFFFF);
+    // log2(1 + f) ~= f + 0.3466 * f * (1 - f)
+    const uint64_t curve = (static_cast<uint64_t>(mantissa) * (65536 - mantissa)) >> 16;
+    const uint32_t fraction = mantissa + static_cast<uint32_t>((curve * 22713) >> 16);
+    return (msb << 6) + static_cast<int32_t>(fraction >> 10);
+}
+
+void LogMelFrontend::fft() {
+    for (size_t len = 2, stride = kFftSize / 2; len <= kFftSize; len <<= 1, stride >>= 1) {
+        const size_t half = len >> 1;
+        for (size_t start = 0; start < kFftSize; start += len) {
+            for (size_t j = 0; j < half; ++j) {
+                const int32_t w_re = cos_q15_[j * stride];
+                const int32_t w_im = -sin_q15_[j * stride];
+                const size_t a = start + j;
+                const size_t b = a + half;
+                const int32_t t_re = (re_[b] * w_re - im_[b] * w_im) >> 15;
+                const int32_t t_im = (re_[b] * w_im + im_[b] * w_re) >> 15;
+                // Halving every stage keeps magnitudes below the 2^14 input bound
+                re_[b] = (re_[a] - t_re) >> 1;
+                im_[b] = (im_[a] - t_im) >> 1;
+                re_[a] = (re_[a] + t_re) >> 1;
+                im_[a] = (im_[a] + t_im) >> 1;
+            }
+        }
+    }
+}
+
+void LogMelFrontend::computeFrame() {
+    int32_t peak = 0;
+    for (size_t i = 0; i < samples_.size(); ++i) {
+        const int32_t value = samples_[i];
+        const int32_t magnitude = value < 0 ? -value : value;
+        peak = magnitude > peak ? magnitude : peak;
+    }
+    if (peak == 0) {
+        std::fill(features_.begin(), features_.end(), 0);
+        return;
+    }
+
+    // Block exponent: bring the frame peak into [2^13, 2^14)
+    int shift = 0;
+    while (peak < (1 << 13)) {
+        peak <<= 1;
+        ++shift;
+    }
+    while (peak >= (1 << 14)) {
+        peak >>= 1;
+        --shift;
+    }
+
+    std::fill(re_.begin(), re_.end(), 0);
+    std::fill(im_.begin(), im_.end(), 0);
+    for (size_t i = 0; i < samples_.size(); ++i) {
+        const int32_t value = shift >= 0 ? (static_cast<int32_t>(samples_[i]) << shift)
+                                         : (static_cast<int32_t>(samples_[i]) >> -shift);
+        re_[bit_reverse_[i]] = (value * window_q15_[i]) >> 15;
+    }
+
+    fft();
+
+    for (size_t k = 0; k < power_.size(); ++k) {
+        power_[k] = static_cast<uint32_t>(re_[k] * re_[k] + im_[k] * im_[k]);
+    }
+
+    // Undo the block exponent (power scales by 2^2shift) and the FFT's 2^-9 amplitude scaling
+    const int32_t compensation = (2 * static_cast<int32_t>(kFftStages) - 2 * shift) * 64;
+    for (size_t m = 0; m < filters_.size(); ++m) {
+        const MelFilter& filter = filters_[m];
+        const uint32_t* power = &power_[filter.first_bin];
+        const uint16_t* weights = &filter_weights_q15_[filter.weight_offset];
+        uint64_t energy = 0;
+        for (size_t k = 0; k < filter.length; ++k) {
+            energy += static_cast<uint64_t>(power[k]) * weights[k];
+        }
+        const int32_t log_energy = log2Q6(energy >> 15) + compensation;
+        features_[m] = static_cast<int16_t>(std::max<int32_t>(0, std::min<int32_t>(32767, log_energy)));
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Fixed-point log-mel feature extractor for keyword spotting
+ *
+ * Per hop (default 30 ms window, 20 ms hop, 40 bins at 16 kHz):
+ * - Block floating point: the frame is shifted so its peak uses ~14 bits
+ * - Q15 Hann window, 512-point radix-2 FFT with 1/2 scaling per stage
+ * - 32-bit power spectrum, triangular mel filters with Q15 weights
+ * - Integer log2 with a quadratic mantissa correction (error < 0.01)
+ *
+ * Features are 64 * log2(mel energy), compensated for the block exponent and
+ * FFT scaling so they do not depend on the frame's own level. Tables are built
+ * once in configure(); the per-frame path is integer only.
+ *
+ * Usage:
+ *   size_t offset = 0;
+ *   while (offset < count) {
+ *       offset += frontend.push(samples + offset, count - offset);
+ *       if (frontend.frameReady()) consume(frontend.features());
+ *   }
+ */
+class LogMelFrontend {
+public:
+    static constexpr size_t kFftSize = 512;
+    static constexpr size_t kFftStages = 9;
+    static constexpr uint8_t kMaxBins = 64;
+
+    struct Config {
+        uint32_t sample_rate = 16000;
+        uint16_t window_samples = 480;  // 30 ms
+        uint16_t hop_samples = 320;     // 20 ms
+        uint8_t num_bins = 40;
+        uint16_t lower_hz = 125;
+        uint16_t upper_hz = 7500;
+    };
+
+    LogMelFrontend();
+
+    /**
+     * @brief Build window, twiddle and filterbank tables
+     * @return false if the configuration cannot be represented (window > FFT size, too many bins...)
+     */
+    bool configure(const Config& config);
+    void reset();
+
+    /**
+     * @brief Consume samples until one frame completes or input runs out
+     * @return Number of samples consumed
+     */
+    size_t push(const int16_t* samples, size_t count);
+
+    /** True right after push() completed a frame (cleared by the next push) */
+    bool frameReady() const { return frame_ready_; }
+
+    /** Features of the last completed frame, numBins() values */
+    const int16_t* features() const { return features_.data(); }
+
+    uint8_t numBins() const { return config_.num_bins; }
+    const Config& config() const { return config_; }
+
+    /** Fixed-point 64 * log2(value + 1) */
+    static int32_t log2Q6(uint64_t value);
+
+private:
+    struct MelFilter {
+        uint16_t first_bin = 0;
+        uint16_t weight_offset = 0;
+        uint16_t length = 0;
+    };
+
+    void computeFrame();
+    void fft();
+
+    Config config_;
+    std::vector<int16_t> samples_;
+    size_t fill_ = 0;
+    bool frame_ready_ = false;
+
+    std::vector<int16_t> window_q15_;
+    std::vector<int16_t> cos_q15_;
+    std::vector<int16_t> sin_q15_;
+    std::vector<uint16_t> bit_reverse_;
+    std::vector<int32_t> re_;
+    std::vector<int32_t> im_;
+    std::vector<uint32_t> power_;
+    std::vector<MelFilter> filters_;
+    std::vector<uint16_t> filter_weights_q15_;
+    std::vector<int16_t> features_;
+};
@@ -0,0 +1,302 @@
+#include "core/lua_bytecode_cache.h"
+
+#include <LittleFS.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <esp_timer.h>
+
+#include "utils/logger.h"
+
+extern "C" {
+#include <lauxlib.h>
+}
+
+namespace {
+constexpr const char* TAG = "LuaCache";
+constexpr const char* FILE_SUFFIX = ".luac";
+constexpr char kMagic[4] = {'L', 'B', 'C', '1'};
+constexpr size_t kHeaderBytes = 8;          // Magic + compile_us (little endian)
+constexpr uint32_t kPreprocessorVersion = 1;  // Bump when preprocessScript() output changes
+
+void hashBytes(uint64_t& hash, const void* data, size_t length) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;  // FNV-1a 64
+    }
+}
+
+int appendChunk(lua_State*, const void* data, size_t size, void* user_data) {
+    auto* code = static_cast<PsramVector<uint8_t>*>(user_data);
+    if (code->size() + size > LuaBytecodeCache::kMaxChunkBytes) {
+        return 1;  // Aborts lua_dump()
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    code->insert(code->end(), bytes, bytes + size);
+    return 0;
+}
+
+uint32_t elapsedUs(int64_t start) {
+    return static_cast<uint32_t>(esp_timer_get_time() - start);
+}
+} // namespace
+
+constexpr size_t LuaBytecodeCache::kMaxMemoryBytes;
+constexpr size_t LuaBytecodeCache::kMaxMemoryEntries;
+constexpr size_t LuaBytecodeCache::kMaxDiskBytes;
+constexpr size_t LuaBytecodeCache::kMaxDiskEntries;
+constexpr size_t LuaBytecodeCache::kMaxChunkBytes;
+
+LuaBytecodeCache& LuaBytecodeCache::getInstance() {
+    static LuaBytecodeCache instance;
+    return instance;
+}
+
+uint64_t LuaBytecodeCache::makeKey(const std::string& source, bool preprocessed) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const uint32_t salt[] = {static_cast<uint32_t>(LUA_VERSION_NUM), preprocessed ? kPreprocessorVersion : 0};
+    hashBytes(hash, salt, sizeof(salt));
+    hashBytes(hash, source.data(), source.size());
+    return hash;
+}
+
+bool LuaBytecodeCache::load(lua_State* L, uint64_t key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int64_t start = esp_timer_get_time();
+
+    bool from_disk = false;
+    Entry* entry = findLocked(key);
+    if (!entry) {
+        Entry loaded;
+        if (!readFileLocked(key, loaded)) {
+            ++stats_.misses;
+            return false;
+        }
+        insertLocked(std::move(loaded));
+        entry = findLocked(key);
+        from_disk = true;
+    }
+
+    const int status = luaL_loadbufferx(L, reinterpret_cast<const char*>(entry->code.data()),
+                                        entry->code.size(), "=lua_cache", "b");
+    if (status != LUA_OK) {
+        // Built by another Lua configuration or damaged on flash: compile again
+        Logger::getInstance().warnf("[%s] Dropping unloadable chunk %016" PRIx64 ": %s", TAG, key,
+                                    lua_tostring(L, -1));
+        lua_pop(L, 1);
+        if (entry->persisted) {
+            removeFileLocked(key);
+        }
+        memory_bytes_ -= entry->code.size();
+        entries_.erase(entries_.begin() + (entry - entries_.data()));
+        ++stats_.misses;
+        return false;
+    }
+
+    entry->last_use = ++tick_;
+    if (from_disk) {
+        ++stats_.disk_hits;
+    } else {
+        ++stats_.memory_hits;
+        if (!entry->persisted) {
+            writeFileLocked(*entry);  // Second use: worth keeping across reboots
+        }
+    }
+    stats_.saved_us += entry->compile_us;
+    stats_.load_us += elapsedUs(start);
+    return true;
+}
+
+void LuaBytecodeCache::store(lua_State* L, uint64_t key, uint32_t compile_us) {
+    Entry entry;
+    entry.key = key;
+    entry.compile_us = compile_us;
+    // Debug info is kept so runtime errors still carry line numbers
+    if (lua_dump(L, appendChunk, &entry.code, 0) != 0 || entry.code.empty()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.compile_us += compile_us;
+    if (findLocked(key)) {
+        return;
+    }
+    insertLocked(std::move(entry));
+}
+
+LuaBytecodeCache::Stats LuaBytecodeCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.memory_entries = entries_.size();
+    stats.memory_bytes = memory_bytes_;
+    stats.disk_entries = disk_.size();
+    stats.disk_bytes = disk_bytes_;
+    return stats;
+}
+
+bool LuaBytecodeCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    memory_bytes_ = 0;
+    scanDiskLocked();
+    bool ok = true;
+    for (const DiskEntry& disk : disk_) {
+        ok = LittleFS.remove(pathFor(disk.key).c_str()) && ok;
+    }
+    disk_.clear();
+    disk_bytes_ = 0;
+    return ok;
+}
+
+LuaBytecodeCache::Entry* LuaBytecodeCache::findLocked(uint64_t key) {
+    for (Entry& entry : entries_) {
+        if (entry.key == key) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+void LuaBytecodeCache::insertLocked(Entry entry) {
+    if (entry.code.size() > kMaxChunkBytes) {
+        return;
+    }
+    while (!entries_.empty() &&
+           (entries_.size() >= kMaxMemoryEntries || memory_bytes_ + entry.code.size() > kMaxMemoryBytes)) {
+        auto oldest = std::min_element(entries_.begin(), entries_.end(),
+                                       [](const Entry& a, const Entry& b) { return a.last_use < b.last_use; });
+        memory_bytes_ -= oldest->code.size();
+        entries_.erase(oldest);
+        ++stats_.evictions;
+    }
+    entry.last_use = ++tick_;
+    memory_bytes_ += entry.code.size();
+    entries_.push_back(std::move(entry));
+}
+
+bool LuaBytecodeCache::readFileLocked(uint64_t key, Entry& entry) {
+    scanDiskLocked();
+    auto it = std::find_if(disk_.begin(), disk_.end(), [key](const DiskEntry& d) { return d.key == key; });
+    if (it == disk_.end()) {
+        return false;
+    }
+
+    const std::string path = pathFor(key);
+    File file = LittleFS.open(path.c_str(), FILE_READ);
+    const size_t size = file ? file.size() : 0;
+    uint8_t header[kHeaderBytes];
+    bool ok = size > kHeaderBytes && size - kHeaderBytes <= kMaxChunkBytes &&
+              file.read(header, kHeaderBytes) == kHeaderBytes && memcmp(header, kMagic, sizeof(kMagic)) == 0;
+    if (ok) {
+        entry.code.resize(size - kHeaderBytes);
+        ok = file.read(entry.code.data(), entry.code.size()) == entry.code.size();
+    }
+    if (file) {
+        file.close();
+    }
+    if (!ok) {
+        removeFileLocked(key);
+        return false;
+    }
+
+    entry.key = key;
+    entry.compile_us = static_cast<uint32_t>(header[4]) | (static_cast<uint32_t>(header[5]) << 8) |
+                       (static_cast<uint32_t>(header[6]) << 16) | (static_cast<uint32_t>(header[7]) << 24);
+    entry.persisted = true;
+    return true;
+}
+
+void LuaBytecodeCache::writeFileLocked(Entry& entry) {
+    scanDiskLocked();
+    const size_t bytes = kHeaderBytes + entry.code.size();
+    while (!disk_.empty() && (disk_.size() >= kMaxDiskEntries || disk_bytes_ + bytes > kMaxDiskBytes)) {
+        removeFileLocked(disk_.front().key);
+    }
+    if (bytes > kMaxDiskBytes) {
+        return;
+    }
+    if (!LittleFS.exists(CACHE_DIR) && !LittleFS.mkdir(CACHE_DIR)) {
+        Logger::getInstance().errorf("[%s] Failed to create %s", TAG, CACHE_DIR);
+        entry.persisted = true;  // Do not retry on every hit
+        return;
+    }
+
+    const std::string path = pathFor(entry.key);
+    File file = LittleFS.open(path.c_str(), FILE_WRITE);
+    if (!file) {
+        Logger::getInstance().errorf("[%s] Failed to open %s", TAG, path.c_str());
+        entry.persisted = true;
+        return;
+    }
+    uint8_t header[kHeaderBytes];
+    memcpy(header, kMagic, sizeof(kMagic));
+    for (int i = 0; i < 4; ++i) {
+        header[4 + i] = static_cast<uint8_t>(entry.compile_us >> (8 * i));
+    }
+    const bool ok = file.write(header, kHeaderBytes) == kHeaderBytes &&
+                    file.write(entry.code.data(), entry.code.size()) == entry.code.size();
+    file.close();
+    entry.persisted = true;
+    if (!ok) {
+        LittleFS.remove(path.c_str());
+        Logger::getInstance().warnf("[%s] Failed to write %s", TAG, path.c_str());
+        return;
+    }
+
+    disk_.push_back({entry.key, static_cast<uint32_t>(bytes)});
+    disk_bytes_ += bytes;
+    ++stats_.disk_writes;
+}
+
+void LuaBytecodeCache::removeFileLocked(uint64_t key) {
+    LittleFS.remove(pathFor(key).c_str());
+    auto it = std::find_if(disk_.begin(), disk_.end(), [key](const DiskEntry& d) { return d.key == key; });
+    if (it != disk_.end()) {
+        disk_bytes_ -= it->bytes;
+        disk_.erase(it);
+    }
+}
+
+void LuaBytecodeCache::scanDiskLocked() {
+    if (disk_scanned_) {
+        return;
+    }
+    disk_scanned_ = true;
+
+    File dir = LittleFS.open(CACHE_DIR);
+    if (!dir || !dir.isDirectory()) {
+        return;
+    }
+
+    std::vector<std::pair<time_t, DiskEntry>> found;
+    for (File file = dir.openNextFile(); file; file = dir.openNextFile()) {
+        const std::string name = file.name();
+        const size_t suffix = strlen(FILE_SUFFIX);
+        if (!file.isDirectory() && name.size() == 16 + suffix && name.compare(16, suffix, FILE_SUFFIX) == 0) {
+            const uint64_t key = strtoull(name.substr(0, 16).c_str(), nullptr, 16);
+            found.push_back({file.getLastWrite(), {key, static_cast<uint32_t>(file.size())}});
+        }
+        file.close();
+    }
+    dir.close();
+
+    std::stable_sort(found.begin(), found.end(),
+                     [](const std::pair<time_t, DiskEntry>& a, const std::pair<time_t, DiskEntry>& b) {
+                         return a.first < b.first;
+                     });
+    for (const auto& item : found) {
+        disk_.push_back(item.second);
+        disk_bytes_ += item.second.bytes;
+    }
+    Logger::getInstance().infof("[%s] %u compiled chunks on flash (%u bytes)", TAG, (unsigned)disk_.size(),
+                                (unsigned)disk_bytes_);
+}
+
+std::string LuaBytecodeCache::pathFor(uint64_t key) {
+    char path[48];
+    snprintf(path, sizeof(path), "%s/%016" PRIx64 "%s", CACHE_DIR, key, FILE_SUFFIX);
+    return path;
+}
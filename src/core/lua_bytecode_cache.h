@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "utils/psram_allocator.h"
+
+extern "C" {
+#include <lua.h>
+}
+
+/**
+ * @brief Compiled Lua chunks keyed by a hash of their source
+ *
+ * A hit loads the lua_dump() output instead of preprocessing and parsing the
+ * script again, which matters for scheduled events, memory scripts and
+ * snippets the web console or the LLM repeat.
+ *
+ * Chunks live in PSRAM (LRU, kMaxMemoryBytes). A chunk that is used a second
+ * time is also written to LittleFS (CACHE_DIR/<key>.luac) so it survives a
+ * reboot; one-off snippets never reach flash. The key covers the source, the
+ * preprocessing mode and the Lua version, so a changed script or firmware
+ * never loads stale bytecode; a chunk Lua refuses to load is dropped.
+ */
+class LuaBytecodeCache {
+public:
+    static constexpr const char* CACHE_DIR = "/lua_cache";
+    static constexpr size_t kMaxMemoryBytes = 256 * 1024;
+    static constexpr size_t kMaxMemoryEntries = 64;
+    static constexpr size_t kMaxDiskBytes = 192 * 1024;
+    static constexpr size_t kMaxDiskEntries = 48;
+    static constexpr size_t kMaxChunkBytes = 32 * 1024;   // Larger chunks are not cached
+
+    struct Stats {
+        uint32_t memory_hits = 0;
+        uint32_t disk_hits = 0;
+        uint32_t misses = 0;
+        uint32_t disk_writes = 0;
+        uint32_t evictions = 0;
+        uint64_t compile_us = 0;        // Spent preprocessing + compiling on misses
+        uint64_t saved_us = 0;          // Compile time the hits did not spend
+        uint64_t load_us = 0;           // Spent loading bytecode on hits
+        size_t memory_entries = 0;
+        size_t memory_bytes = 0;
+        size_t disk_entries = 0;
+        size_t disk_bytes = 0;
+    };
+
+    static LuaBytecodeCache& getInstance();
+
+    /** Key of a script; preprocessed tells execute() snippets from raw files */
+    static uint64_t makeKey(const std::string& source, bool preprocessed);
+
+    /** Push the cached chunk for key onto the stack of L; false on a miss */
+    bool load(lua_State* L, uint64_t key);
+
+    /** Cache the function on top of the stack of L (left in place) */
+    void store(lua_State* L, uint64_t key, uint32_t compile_us);
+
+    Stats getStats() const;
+    bool clear();
+
+private:
+    struct Entry {
+        uint64_t key = 0;
+        PsramVector<uint8_t> code;
+        uint32_t compile_us = 0;
+        uint32_t last_use = 0;      // LRU tick
+        bool persisted = false;
+    };
+
+    struct DiskEntry {
+        uint64_t key = 0;
+        uint32_t bytes = 0;
+    };
+
+    LuaBytecodeCache() = default;
+    LuaBytecodeCache(const LuaBytecodeCache&) = delete;
+    LuaBytecodeCache& operator=(const LuaBytecodeCache&) = delete;
+
+    Entry* findLocked(uint64_t key);
+    void insertLocked(Entry entry);
+    bool readFileLocked(uint64_t key, Entry& entry);
+    void writeFileLocked(Entry& entry);
+    void removeFileLocked(uint64_t key);
+    void scanDiskLocked();
+    static std::string pathFor(uint64_t key);
+
+    mutable std::mutex mutex_;
+    std::vector<Entry> entries_;
+    size_t memory_bytes_ = 0;
+    std::vector<DiskEntry> disk_;   // Oldest first
+    size_t disk_bytes_ = 0;
+    bool disk_scanned_ = false;
+    uint32_t tick_ = 0;
+    Stats stats_;
+};
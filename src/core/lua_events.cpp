@@ -0,0 +1,215 @@
+#include "core/lua_events.h"
+
+#include <Arduino.h>
+#include <algorithm>
+
+#include "core/event_router.h"
+#include "utils/logger.h"
+
+extern "C" {
+#include <lauxlib.h>
+}
+
+namespace {
+constexpr const char* TAG = "LuaEvents";
+
+uint32_t average(uint32_t current, uint32_t sample) {
+    return current == 0 ? sample : (current * 7 + sample) / 8;
+}
+
+void routeToLua(const char* event, void* data) {
+    LuaEvents::getInstance().post(event, static_cast<const char*>(data));
+}
+} // namespace
+
+constexpr size_t LuaEvents::kMaxHandlers;
+constexpr size_t LuaEvents::kMaxPending;
+constexpr size_t LuaEvents::kMaxPendingPerHandler;
+constexpr size_t LuaEvents::kMaxRunning;
+constexpr size_t LuaEvents::kMaxPayloadBytes;
+
+LuaEvents& LuaEvents::getInstance() {
+    static LuaEvents instance;
+    return instance;
+}
+
+void LuaEvents::begin() {
+    EventRouter::getInstance();  // Create it here rather than racing on first publish
+}
+
+uint32_t LuaEvents::on(lua_State* L, const std::string& event, int fn_index, const std::string& label) {
+    bool subscribe = false;
+    uint32_t id = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (handlers_.size() >= kMaxHandlers) {
+            return 0;
+        }
+        Handler handler;
+        lua_pushvalue(L, fn_index);
+        handler.ref = luaL_ref(L, LUA_REGISTRYINDEX);
+        handler.stats.id = id = ++next_id_;
+        handler.stats.event = event;
+        handler.stats.label = label;
+        handlers_.push_back(std::move(handler));
+        subscribe = subscribed_.insert(event).second;
+    }
+
+    if (subscribe) {
+        EventRouter::getInstance()->subscribe(event.c_str(), routeToLua);
+    }
+    Logger::getInstance().infof("[%s] Handler %u (%s) registered for '%s'", TAG, (unsigned)id, label.c_str(),
+                                event.c_str());
+    return id;
+}
+
+bool LuaEvents::off(lua_State* L, uint32_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find_if(handlers_.begin(), handlers_.end(),
+                           [id](const Handler& handler) { return handler.stats.id == id; });
+    if (it == handlers_.end()) {
+        return false;
+    }
+    luaL_unref(L, LUA_REGISTRYINDEX, it->ref);
+    handlers_.erase(it);    // Its queued invocations are skipped by next()
+    return true;
+}
+
+void LuaEvents::post(const char* event, const char* payload) {
+    if (!event) {
+        return;
+    }
+    std::string text = payload ? payload : "";
+    if (text.size() > kMaxPayloadBytes) {
+        text.resize(kMaxPayloadBytes);
+    }
+
+    bool queued = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const uint32_t now = millis();
+        for (Handler& handler : handlers_) {
+            if (handler.stats.event != event) {
+                continue;
+            }
+            if (handler.stats.pending >= kMaxPendingPerHandler) {
+                // Keep the latest events of a handler that cannot keep up
+                auto oldest = std::find_if(pending_.begin(), pending_.end(), [&handler](const Invocation& invocation) {
+                    return invocation.handler_id == handler.stats.id;
+                });
+                if (oldest != pending_.end()) {
+                    pending_.erase(oldest);
+                    --handler.stats.pending;
+                }
+                ++handler.stats.dropped;
+                ++dropped_;
+            } else if (pending_.size() >= kMaxPending) {
+                ++handler.stats.dropped;
+                ++dropped_;
+                continue;
+            }
+
+            Invocation invocation;
+            invocation.handler_id = handler.stats.id;
+            invocation.ref = handler.ref;
+            invocation.event = event;
+            invocation.payload = text;
+            invocation.queued_ms = now;
+            pending_.push_back(std::move(invocation));
+            ++handler.stats.pending;
+            ++posted_;
+            queued = true;
+        }
+    }
+
+    if (queued && wakeup_) {
+        wakeup_();
+    }
+}
+
+bool LuaEvents::next(Invocation& invocation) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = pending_.begin(); it != pending_.end() && running_ < kMaxRunning;) {
+        Handler* handler = find(it->handler_id);
+        if (!handler) {
+            it = pending_.erase(it);    // Handler removed since the event was posted
+            continue;
+        }
+        if (handler->stats.running) {
+            ++it;                       // Keep a handler's invocations in order
+            continue;
+        }
+
+        invocation = std::move(*it);
+        pending_.erase(it);
+        --handler->stats.pending;
+        handler->stats.running = true;
+        ++running_;
+
+        const uint32_t latency_ms = millis() - invocation.queued_ms;
+        handler->stats.avg_latency_ms = average(handler->stats.avg_latency_ms, latency_ms);
+        handler->stats.max_latency_ms = std::max(handler->stats.max_latency_ms, latency_ms);
+        return true;
+    }
+    return false;
+}
+
+void LuaEvents::finished(uint32_t handler_id, bool success, uint32_t busy_us) {
+    bool more = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_ > 0) {
+            --running_;
+        }
+        Handler* handler = find(handler_id);
+        if (handler) {
+            handler->stats.running = false;
+            ++handler->stats.calls;
+            if (!success) {
+                ++handler->stats.failures;
+            }
+            handler->stats.avg_busy_us = average(handler->stats.avg_busy_us, busy_us);
+            handler->stats.max_busy_us = std::max(handler->stats.max_busy_us, busy_us);
+        }
+        more = !pending_.empty();
+    }
+
+    // Invocations held back by this one can start now
+    if (more && wakeup_) {
+        wakeup_();
+    }
+}
+
+void LuaEvents::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    handlers_.clear();
+    pending_.clear();
+    running_ = 0;
+}
+
+bool LuaEvents::empty() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return handlers_.empty();
+}
+
+LuaEvents::Stats LuaEvents::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.posted = posted_;
+    stats.dropped = dropped_;
+    stats.pending = pending_.size();
+    stats.running = running_;
+    for (const Handler& handler : handlers_) {
+        stats.handlers.push_back(handler.stats);
+    }
+    return stats;
+}
+
+LuaEvents::Handler* LuaEvents::find(uint32_t id) {
+    for (Handler& handler : handlers_) {
+        if (handler.stats.id == id) {
+            return &handler;
+        }
+    }
+    return nullptr;
+}
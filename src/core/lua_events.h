@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <lua.h>
+}
+
+/**
+ * @brief Lua handlers for EventRouter events (events.on(name, fn) in scripts)
+ *
+ * A script registers a function for an event name; the function stays alive
+ * in the scheduler's Lua state after the script ends. Each publish queues one
+ * invocation per matching handler and wakes the LuaScheduler, which runs it
+ * as a coroutine with (name, payload). Settings changes arrive as the
+ * "settings.*" events SettingsManager publishes.
+ *
+ * Backpressure: a handler keeps at most kMaxPendingPerHandler invocations
+ * (the oldest is dropped, so a burst of radio titles ends with the latest),
+ * the whole queue at most kMaxPending, and at most kMaxRunning handlers run at
+ * once, one invocation per handler at a time. Queue latency and busy time
+ * are kept per handler so slow scripts stand out in `lua_events`.
+ *
+ * post() is safe from any task; the rest runs on the scheduler task.
+ */
+class LuaEvents {
+public:
+    static constexpr size_t kMaxHandlers = 32;
+    static constexpr size_t kMaxPending = 32;
+    static constexpr size_t kMaxPendingPerHandler = 4;
+    static constexpr size_t kMaxRunning = 4;
+    static constexpr size_t kMaxPayloadBytes = 256;
+
+    struct Invocation {
+        uint32_t handler_id = 0;
+        int ref = 0;                    // Registry reference to the handler function
+        std::string event;
+        std::string payload;
+        uint32_t queued_ms = 0;
+    };
+
+    struct HandlerStats {
+        uint32_t id = 0;
+        std::string event;
+        std::string label;              // Where the handler was defined
+        uint32_t calls = 0;
+        uint32_t failures = 0;
+        uint32_t dropped = 0;
+        size_t pending = 0;
+        bool running = false;
+        uint32_t avg_busy_us = 0;       // Time spent running Lua, sleeps excluded
+        uint32_t max_busy_us = 0;
+        uint32_t avg_latency_ms = 0;    // Publish to start
+        uint32_t max_latency_ms = 0;
+    };
+
+    struct Stats {
+        uint32_t posted = 0;            // Invocations queued
+        uint32_t dropped = 0;
+        size_t pending = 0;
+        size_t running = 0;
+        std::vector<HandlerStats> handlers;
+    };
+
+    static LuaEvents& getInstance();
+
+    /** Create the EventRouter before any task publishes */
+    void begin();
+
+    /**
+     * @brief Register the function at fn_index for event
+     * @return handler id, 0 if kMaxHandlers are registered
+     */
+    uint32_t on(lua_State* L, const std::string& event, int fn_index, const std::string& label);
+    bool off(lua_State* L, uint32_t id);
+
+    /** Queue the handlers of event (any task) */
+    void post(const char* event, const char* payload);
+
+    /** Next invocation that may start now; the handler counts as running until finished() */
+    bool next(Invocation& invocation);
+    void finished(uint32_t handler_id, bool success, uint32_t busy_us);
+
+    /** Forget every handler (their Lua state is gone) */
+    void clear();
+    bool empty() const;
+
+    void setWakeup(std::function<void()> wakeup) { wakeup_ = std::move(wakeup); }
+    Stats getStats() const;
+
+private:
+    struct Handler {
+        HandlerStats stats;
+        int ref = 0;
+    };
+
+    LuaEvents() = default;
+    LuaEvents(const LuaEvents&) = delete;
+    LuaEvents& operator=(const LuaEvents&) = delete;
+
+    Handler* find(uint32_t id);
+
+    mutable std::mutex mutex_;
+    std::vector<Handler> handlers_;
+    std::deque<Invocation> pending_;
+    std::set<std::string> subscribed_;      // EventRouter names already routed here
+    size_t running_ = 0;
+    uint32_t next_id_ = 0;
+    uint32_t posted_ = 0;
+    uint32_t dropped_ = 0;
+    std::function<void()> wakeup_;
+};
@@ -0,0 +1,3 @@
+#include "core/lua_sandbox_pool.h"
+
+template class LuaStatePool<VoiceAssistant::LuaSandbox>;
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "core/lua_state_pool.h"
+#include "core/voice_assistant.h"
+
+/**
+ * @brief Independent Lua states for scripts that cannot use the LuaScheduler
+ *
+ * Scripts normally run as coroutines on the LuaScheduler. A script started
+ * from inside another one (which would wait on its own scheduler task), or
+ * any script when the scheduler failed to start, gets a state of its own
+ * here instead. The states are created on first use with the bindings
+ * registered; on release the stack is cleared and the globals a script added
+ * or replaced are put back, which is far cheaper than building a new state. Changes inside library tables (e.g.
+ * gpio.write = nil) are not undone. A state whose script hit the memory limit
+ * or whose arena grew past LuaSandbox::kRecycleFootprint is rebuilt instead.
+ *
+ * acquireUi() hands out a separate long-lived state that is never reset, for
+ * screens that load a script once and call into it later.
+ */
+using LuaSandboxPool = LuaStatePool<VoiceAssistant::LuaSandbox>;
+
+extern template class LuaStatePool<VoiceAssistant::LuaSandbox>;
@@ -0,0 +1,387 @@
+#include "core/lua_scheduler.h"
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/semphr.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "core/cancel_token.h"
+#include "core/lua_events.h"
+#include "core/lua_sandbox_pool.h"
+#include "core/task_config.h"
+#include "core/voice_assistant.h"
+#include "utils/logger.h"
+
+namespace {
+constexpr const char* TAG = "LuaSched";
+constexpr uint32_t kResultMarginMs = 5000;     // Caller waits this long past the script deadline
+constexpr uint32_t kCancelPollMs = 100;        // Wait slice of a caller with a CancelToken
+constexpr uint32_t kDefaultTimeoutMs[] = {60000, 30000, 30000, 10000};
+constexpr const char* kSourceNames[] = {"scheduler", "web", "llm", "event"};
+
+uint32_t average(uint32_t current, uint32_t sample) {
+    return current == 0 ? sample : (current * 7 + sample) / 8;
+}
+} // namespace
+
+constexpr size_t LuaScheduler::kMaxQueued;
+constexpr size_t LuaScheduler::kIoWorkers;
+constexpr size_t LuaScheduler::kMaxIoQueued;
+
+// Per coroutine, handed to LuaCoroutines as the user pointer
+struct LuaScheduler::Context {
+    std::string output;             // Swapped into the sandbox while the coroutine runs
+    int64_t entered_us = 0;
+    uint32_t busy_us = 0;           // Time spent running Lua
+};
+
+struct LuaScheduler::Job : Context {
+    std::string script;
+    Source source = Source::Llm;
+    uint32_t timeout_ms = 0;
+    CommandResult result;
+    SemaphoreHandle_t done;
+
+    Job() : done(xSemaphoreCreateBinary()) {}
+    ~Job() {
+        if (done) {
+            vSemaphoreDelete(done);
+        }
+    }
+};
+
+struct LuaScheduler::Runtime {
+    VoiceAssistant::LuaSandbox sandbox;
+    std::unique_ptr<LuaCoroutines> coroutines;
+    std::atomic<uint32_t> io_pending{0};    // Offloaded work not yet completed
+
+    void attach(LuaScheduler* scheduler) {
+        coroutines.reset(new LuaCoroutines(sandbox.state(), [] { return static_cast<uint32_t>(millis()); }));
+        coroutines->setObserver([this](void* user, bool entering) {
+            Context* context = static_cast<Context*>(user);
+            std::swap(sandbox.output_buffer_, context->output);
+            if (entering) {
+                context->entered_us = esp_timer_get_time();
+            } else {
+                context->busy_us += static_cast<uint32_t>(esp_timer_get_time() - context->entered_us);
+            }
+        });
+        coroutines->setWakeup([scheduler] { scheduler->wake(); });
+    }
+};
+
+LuaScheduler& LuaScheduler::getInstance() {
+    static LuaScheduler instance;
+    return instance;
+}
+
+LuaScheduler::LuaScheduler() {
+    std::copy(std::begin(kDefaultTimeoutMs), std::end(kDefaultTimeoutMs), timeouts_);
+}
+
+bool LuaScheduler::begin() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (started_ || failed_) {
+        return started_;
+    }
+
+    auto& logger = Logger::getInstance();
+    runtime_.reset(new Runtime());
+    if (!runtime_->sandbox.state()) {
+        logger.errorf("[%s] Failed to create Lua state", TAG);
+        runtime_.reset();
+        failed_ = true;
+        return false;
+    }
+    runtime_->attach(this);
+    LuaEvents::getInstance().setWakeup([this] { wake(); });
+    LuaEvents::getInstance().begin();
+
+    io_queue_ = xQueueCreate(kMaxIoQueued, sizeof(IoRequest*));
+    if (!io_queue_ ||
+        xTaskCreatePinnedToCore(schedulerTask, "lua_sched", TaskConfig::STACK_LUA_SCHEDULER, this,
+                                TaskConfig::PRIO_LUA_SCHEDULER, &task_, TaskConfig::CORE_LUA_SCHEDULER) != pdPASS) {
+        logger.errorf("[%s] Failed to start scheduler task, scripts will run on pooled states", TAG);
+        if (io_queue_) {
+            vQueueDelete(io_queue_);
+            io_queue_ = nullptr;
+        }
+        runtime_.reset();
+        failed_ = true;
+        return false;
+    }
+
+    size_t workers = 0;
+    for (size_t i = 0; i < kIoWorkers; ++i) {
+        if (xTaskCreatePinnedToCore(ioTask, "lua_io", TaskConfig::STACK_LUA_IO, this,
+                                    TaskConfig::PRIO_LUA_IO, nullptr, TaskConfig::CORE_LUA_IO) == pdPASS) {
+            ++workers;
+        }
+    }
+    if (workers == 0) {
+        // Bindings see a full queue and block inline instead
+        logger.warnf("[%s] No I/O worker started, HTTP and TTS calls will block the scheduler", TAG);
+        vQueueDelete(io_queue_);
+        io_queue_ = nullptr;
+    }
+
+    started_ = true;
+    logger.infof("[%s] Scheduler running (%u I/O workers)", TAG, (unsigned)workers);
+    return true;
+}
+
+CommandResult LuaScheduler::run(const std::string& script, Source source) {
+    // A script that runs another one (e.g. through a command) cannot wait for its own task
+    if (!begin() || xTaskGetCurrentTaskHandle() == task_) {
+        return runOnPool(script);
+    }
+
+    auto job = std::make_shared<Job>();
+    if (!job->done) {
+        return {false, "Out of memory"};
+    }
+    job->script = script;
+    job->source = source;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queued_.size() >= kMaxQueued) {
+            ++stats_.rejected;
+            return {false, "Lua scheduler is busy, try again later"};
+        }
+        job->timeout_ms = timeouts_[static_cast<size_t>(source)];
+        queued_.push_back(job);
+        ++stats_.submitted;
+    }
+    wake();
+
+    // A cancelled caller stops waiting; the script itself runs on to its own deadline
+    const CancelToken cancel = CancelToken::current();
+    const uint32_t wait_ms = job->timeout_ms + kResultMarginMs;
+    const uint32_t wait_start = millis();
+    while (xSemaphoreTake(job->done, pdMS_TO_TICKS(cancel.empty() ? wait_ms : kCancelPollMs)) != pdTRUE) {
+        if (cancel.cancelled()) {
+            return {false, "Cancelled"};
+        }
+        if (millis() - wait_start >= wait_ms) {
+            Logger::getInstance().warnf("[%s] %s script still running after %u ms", TAG, sourceName(source),
+                                        (unsigned)wait_ms);
+            return {false, "Lua script did not finish in time"};
+        }
+    }
+    return job->result;
+}
+
+void LuaScheduler::setTimeout(Source source, uint32_t timeout_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    timeouts_[static_cast<size_t>(source)] = std::max<uint32_t>(timeout_ms, 100);
+}
+
+uint32_t LuaScheduler::timeout(Source source) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return timeouts_[static_cast<size_t>(source)];
+}
+
+bool LuaScheduler::offload(lua_State* L, IoWork work) {
+    LuaCoroutines* coroutines = LuaCoroutines::current();
+    if (!io_queue_ || !coroutines || !LuaCoroutines::canYield(L) || uxQueueSpacesAvailable(io_queue_) == 0) {
+        return false;
+    }
+
+    // Only the scheduler task sends, so the space checked above is still there
+    IoRequest* request = new IoRequest{coroutines, LuaCoroutines::suspend(L), std::move(work)};
+    ++runtime_->io_pending;
+    xQueueSend(io_queue_, &request, 0);
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.offloaded;
+    return true;
+}
+
+LuaScheduler::Stats LuaScheduler::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    std::copy(timeouts_, timeouts_ + static_cast<size_t>(Source::Count), stats.timeout_ms);
+    stats.io_queued = runtime_ ? runtime_->io_pending.load() : 0;
+    return stats;
+}
+
+bool LuaScheduler::owns(lua_State* L) const {
+    if (!runtime_ || !L) {
+        return false;
+    }
+    lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+    lua_State* main = lua_tothread(L, -1);
+    lua_pop(L, 1);
+    return main == runtime_->sandbox.state();
+}
+
+const char* LuaScheduler::sourceName(Source source) {
+    return source < Source::Count ? kSourceNames[static_cast<size_t>(source)] : "unknown";
+}
+
+bool LuaScheduler::parseSource(const std::string& name, Source& source) {
+    for (size_t i = 0; i < static_cast<size_t>(Source::Count); ++i) {
+        if (name == kSourceNames[i]) {
+            source = static_cast<Source>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void LuaScheduler::schedulerTask(void* param) {
+    static_cast<LuaScheduler*>(param)->loop();
+}
+
+void LuaScheduler::ioTask(void* param) {
+    auto* self = static_cast<LuaScheduler*>(param);
+    for (;;) {
+        IoRequest* request = nullptr;
+        if (xQueueReceive(self->io_queue_, &request, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        LuaCoroutines::Values results;
+        request->work(results);
+        request->coroutines->complete(request->ticket, std::move(results));
+        delete request;
+        --self->runtime_->io_pending;
+    }
+}
+
+void LuaScheduler::wake() {
+    if (task_) {
+        xTaskNotifyGive(task_);
+    }
+}
+
+void LuaScheduler::loop() {
+    Runtime& runtime = *runtime_;
+    VoiceAssistant::LuaSandbox::activate(&runtime.sandbox);
+
+    for (;;) {
+        startQueued();
+        startHandlers();
+        const uint32_t wait_ms = runtime.coroutines->step();
+
+        // Rebuild an oversized state once nothing references it (offloaded work holds the
+        // coroutines, event handlers live in the state)
+        if (runtime.coroutines->empty() && runtime.io_pending == 0 && LuaEvents::getInstance().empty() &&
+            runtime.sandbox.needsRecycle()) {
+            Logger::getInstance().infof("[%s] Rebuilding Lua state (%u bytes)", TAG,
+                                        (unsigned)runtime.sandbox.arena().stats().footprint);
+            runtime.coroutines.reset();
+            runtime.sandbox.recycle();
+            runtime.attach(this);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.coroutines = runtime.coroutines->getStats();
+            stats_.memory_bytes = runtime.sandbox.arena().stats().current;
+        }
+
+        // Yield at least a tick between turns so a busy script cannot starve lower priority tasks
+        const TickType_t ticks = wait_ms == LuaCoroutines::kIdle ? portMAX_DELAY
+                                                                : std::max<TickType_t>(pdMS_TO_TICKS(wait_ms), 1);
+        ulTaskNotifyTake(pdTRUE, ticks);
+    }
+}
+
+void LuaScheduler::startQueued() {
+    std::deque<std::shared_ptr<Job>> jobs;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs.swap(queued_);
+    }
+
+    Runtime& runtime = *runtime_;
+    lua_State* L = runtime.sandbox.state();
+    for (std::shared_ptr<Job>& job : jobs) {
+        if (runtime.sandbox.loadScript(job->script) != LUA_OK) {
+            LuaCoroutines::Result result;
+            result.status = LuaCoroutines::Status::Error;
+            const char* error = lua_tostring(L, -1);
+            result.error = error ? error : "unknown";
+            lua_pop(L, 1);
+            finishJob(*job, nullptr, result);
+            continue;
+        }
+        runtime.coroutines->spawn(job->timeout_ms,
+                                  [this, job](lua_State* co, const LuaCoroutines::Result& result) {
+                                      finishJob(*job, co, result);
+                                  },
+                                  job.get(), true);
+    }
+}
+
+void LuaScheduler::startHandlers() {
+    auto& events = LuaEvents::getInstance();
+    lua_State* L = runtime_->sandbox.state();
+    const uint32_t timeout_ms = timeout(Source::Event);
+
+    LuaEvents::Invocation invocation;
+    while (events.next(invocation)) {
+        lua_rawgeti(L, LUA_REGISTRYINDEX, invocation.ref);
+        lua_pushlstring(L, invocation.event.data(), invocation.event.size());
+        lua_pushlstring(L, invocation.payload.data(), invocation.payload.size());
+
+        auto context = std::make_shared<Context>();
+        const uint32_t handler_id = invocation.handler_id;
+        std::string event = std::move(invocation.event);
+        runtime_->coroutines->spawn(
+            timeout_ms,
+            [context, handler_id, event](lua_State*, const LuaCoroutines::Result& result) {
+                const bool success = result.status == LuaCoroutines::Status::Ok;
+                if (!success) {
+                    Logger::getInstance().warnf("[%s] Handler %u for '%s' failed: %s", TAG, (unsigned)handler_id,
+                                                event.c_str(), result.error.c_str());
+                }
+                if (!context->output.empty()) {
+                    Logger::getInstance().infof("[%s] Handler %u output: %s", TAG, (unsigned)handler_id,
+                                                context->output.c_str());
+                }
+                LuaEvents::getInstance().finished(handler_id, success, context->busy_us);
+            },
+            context.get(), false, 2);
+    }
+}
+
+void LuaScheduler::finishJob(Job& job, lua_State* co, const LuaCoroutines::Result& result) {
+    if (result.status == LuaCoroutines::Status::Ok) {
+        VoiceAssistant::LuaSandbox::appendReturnValue(co, job.output);
+        job.result = {true, job.output.empty() ? "Lua script executed" : job.output};
+    } else {
+        std::string message = "Lua error: " + result.error;
+        Logger::getInstance().errorf("[%s] %s script failed: %s", TAG, sourceName(job.source), message.c_str());
+        if (!job.output.empty()) {
+            message += "\nOutput:\n";
+            message += job.output;
+        }
+        job.result = {false, message};
+    }
+
+    Logger::getInstance().infof("[%s] %s script %s in %u ms (%u slices)", TAG, sourceName(job.source),
+                                result.status == LuaCoroutines::Status::Ok        ? "finished"
+                                : result.status == LuaCoroutines::Status::Timeout ? "timed out"
+                                                                                  : "failed",
+                                (unsigned)result.elapsed_ms, (unsigned)result.slices);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.avg_elapsed_ms = average(stats_.avg_elapsed_ms, result.elapsed_ms);
+        stats_.max_elapsed_ms = std::max(stats_.max_elapsed_ms, result.elapsed_ms);
+    }
+    xSemaphoreGive(job.done);
+}
+
+CommandResult LuaScheduler::runOnPool(const std::string& script) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.fallbacks;
+    }
+    LuaSandboxPool::Lease sandbox = LuaSandboxPool::getInstance().acquire();
+    if (!sandbox) {
+        return {false, "All Lua sandboxes are busy"};
+    }
+    return sandbox->execute(script);
+}
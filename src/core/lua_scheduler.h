@@ -0,0 +1,117 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "core/command_center.h"
+#include "utils/lua_coroutines.h"
+
+/**
+ * @brief Runs every Lua script as a coroutine on one scheduler task
+ *
+ * Scripts from the time scheduler, the web console and the LLM share one Lua
+ * state, each with its own globals table. delay() and the HTTP/TTS bindings
+ * yield instead of blocking, so a hundred scripts sleeping between polls cost
+ * about a kilobyte each rather than a task and a state apiece; the HTTP and
+ * TTS work itself runs on kIoWorkers small worker tasks (offload()). A count
+ * hook preempts scripts that compute without yielding, and each source has
+ * its own deadline after which the script fails. Handlers registered with
+ * events.on() (LuaEvents) run here too, under the Event deadline.
+ *
+ * run() blocks the caller until its script ends, like LuaSandbox::execute().
+ * Called from inside a script (a command that runs Lua), or if the task could
+ * not start, the script runs on a LuaSandboxPool state instead.
+ */
+class LuaScheduler {
+public:
+    enum class Source : uint8_t { Scheduler, Web, Llm, Event, Count };
+
+    static constexpr size_t kMaxQueued = 16;
+    static constexpr size_t kIoWorkers = 2;
+    static constexpr size_t kMaxIoQueued = 16;
+
+    /** Blocking work for offload(); fills the values returned to the script */
+    using IoWork = std::function<void(LuaCoroutines::Values& results)>;
+
+    struct Stats {
+        LuaCoroutines::Stats coroutines;
+        uint32_t submitted = 0;
+        uint32_t rejected = 0;          // Queue full
+        uint32_t fallbacks = 0;         // Ran on a pool state instead
+        uint32_t offloaded = 0;
+        size_t io_queued = 0;
+        uint32_t avg_elapsed_ms = 0;
+        uint32_t max_elapsed_ms = 0;
+        uint32_t timeout_ms[static_cast<size_t>(Source::Count)] = {};
+        size_t memory_bytes = 0;        // Lua heap shared by the scripts
+    };
+
+    static LuaScheduler& getInstance();
+
+    /** Start the scheduler and I/O tasks (run() calls this on first use) */
+    bool begin();
+
+    /** Execute a script and wait for it to finish or time out */
+    CommandResult run(const std::string& script, Source source);
+
+    void setTimeout(Source source, uint32_t timeout_ms);
+    uint32_t timeout(Source source) const;
+
+    /**
+     * @brief Hand blocking work to an I/O worker and suspend the calling script
+     *
+     * For bindings, which must `return lua_yield(L, 0);` when this returns true.
+     * Returns false (do the work inline) when L cannot yield or the I/O queue is full.
+     */
+    bool offload(lua_State* L, IoWork work);
+
+    Stats getStats() const;
+
+    /** True if L is the scheduler's state or one of its coroutines (scheduler task only) */
+    bool owns(lua_State* L) const;
+
+    static const char* sourceName(Source source);
+    static bool parseSource(const std::string& name, Source& source);
+
+private:
+    struct Context;
+    struct Job;
+    struct Runtime;
+    struct IoRequest {
+        LuaCoroutines* coroutines;
+        uint32_t ticket;
+        IoWork work;
+    };
+
+    LuaScheduler();
+    LuaScheduler(const LuaScheduler&) = delete;
+    LuaScheduler& operator=(const LuaScheduler&) = delete;
+
+    static void schedulerTask(void* param);
+    static void ioTask(void* param);
+    void loop();
+    void startQueued();
+    void startHandlers();
+    void finishJob(Job& job, lua_State* co, const LuaCoroutines::Result& result);
+    CommandResult runOnPool(const std::string& script);
+    void wake();
+
+    mutable std::mutex mutex_;
+    bool started_ = false;
+    bool failed_ = false;
+    TaskHandle_t task_ = nullptr;
+    QueueHandle_t io_queue_ = nullptr;
+    std::deque<std::shared_ptr<Job>> queued_;
+    uint32_t timeouts_[static_cast<size_t>(Source::Count)];
+    Stats stats_;
+
+    std::unique_ptr<Runtime> runtime_;      // Owned by the scheduler task once started
+};
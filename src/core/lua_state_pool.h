@@ -0,0 +1,251 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "utils/logger.h"
+
+/**
+ * @brief Fixed set of Lua states handed out one caller at a time
+ *
+ * The pool logic behind LuaSandboxPool, independent of the sandbox type so it
+ * builds without the rest of the firmware. Sandbox must be default
+ * constructible and provide reset(), needsRecycle(), recycle() and arena().
+ *
+ * The states are created on first use (or by begin()). On release the state
+ * is reset; one that needsRecycle() is rebuilt instead.
+ */
+template <typename Sandbox>
+class LuaStatePool {
+public:
+    static constexpr size_t kPoolSize = 3;
+    static constexpr uint32_t kAcquireTimeoutMs = 30000;
+
+    struct Stats {
+        size_t size = 0;                // States created
+        size_t in_use = 0;
+        size_t peak_in_use = 0;
+        uint32_t acquired = 0;
+        uint32_t waited = 0;            // Acquisitions that found every state busy
+        uint32_t timeouts = 0;
+        uint32_t avg_wait_ms = 0;       // Over the acquisitions that waited
+        uint32_t max_wait_ms = 0;
+        uint32_t avg_reset_us = 0;
+        uint32_t recycled = 0;          // States rebuilt after hitting the memory limit or growing
+        size_t arena_bytes = 0;         // PSRAM held by the pooled states when last released
+    };
+
+    /** Exclusive use of a sandbox, given back when the lease is destroyed */
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Lease&& other) noexcept
+            : pool_(other.pool_), sandbox_(other.sandbox_), slot_(other.slot_) {
+            other.pool_ = nullptr;
+            other.sandbox_ = nullptr;
+        }
+        Lease& operator=(Lease&& other) noexcept {
+            if (this != &other) {
+                release();
+                pool_ = other.pool_;
+                sandbox_ = other.sandbox_;
+                slot_ = other.slot_;
+                other.pool_ = nullptr;
+                other.sandbox_ = nullptr;
+            }
+            return *this;
+        }
+        ~Lease() { release(); }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        explicit operator bool() const { return sandbox_ != nullptr; }
+        Sandbox* operator->() const { return sandbox_; }
+        Sandbox& operator*() const { return *sandbox_; }
+
+    private:
+        friend class LuaStatePool;
+        Lease(LuaStatePool* pool, Sandbox* sandbox, int slot)
+            : pool_(pool), sandbox_(sandbox), slot_(slot) {}
+        void release() {
+            if (pool_ && sandbox_) {
+                pool_->release(slot_);
+            }
+            pool_ = nullptr;
+            sandbox_ = nullptr;
+        }
+
+        LuaStatePool* pool_ = nullptr;
+        Sandbox* sandbox_ = nullptr;
+        int slot_ = -1;
+    };
+
+    static LuaStatePool& getInstance() {
+        static LuaStatePool instance;
+        return instance;
+    }
+
+    /** Create the states ahead of the first script (acquire() creates them on demand) */
+    void begin();
+
+    /** @return an empty lease if no state frees up within timeout_ms */
+    Lease acquire(uint32_t timeout_ms = kAcquireTimeoutMs);
+
+    /** The long-lived UI state (blocks while another UI caller holds it) */
+    Lease acquireUi();
+
+    Stats getStats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+private:
+    static constexpr int kUiSlot = -1;
+    static constexpr const char* TAG = "LuaPool";
+
+    LuaStatePool() { available_ = xSemaphoreCreateCounting(kPoolSize, kPoolSize); }
+    LuaStatePool(const LuaStatePool&) = delete;
+    LuaStatePool& operator=(const LuaStatePool&) = delete;
+
+    static uint32_t average(uint32_t current, uint32_t sample) {
+        return current == 0 ? sample : (current * 7 + sample) / 8;
+    }
+
+    void release(int slot);
+
+    mutable std::mutex mutex_;
+    SemaphoreHandle_t available_ = nullptr;     // Counts free slots
+    std::unique_ptr<Sandbox> sandboxes_[kPoolSize];
+    bool in_use_[kPoolSize] = {};
+    size_t footprint_[kPoolSize] = {};
+    Stats stats_;
+
+    std::mutex ui_mutex_;
+    std::unique_ptr<Sandbox> ui_sandbox_;
+};
+
+template <typename Sandbox>
+constexpr size_t LuaStatePool<Sandbox>::kPoolSize;
+template <typename Sandbox>
+constexpr uint32_t LuaStatePool<Sandbox>::kAcquireTimeoutMs;
+template <typename Sandbox>
+constexpr const char* LuaStatePool<Sandbox>::TAG;
+
+template <typename Sandbox>
+void LuaStatePool<Sandbox>::begin() {
+    const int64_t start = esp_timer_get_time();
+    size_t created = 0;
+    for (size_t i = 0; i < kPoolSize; ++i) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!sandboxes_[i] && !in_use_[i]) {
+            sandboxes_[i].reset(new Sandbox());
+            ++created;
+        }
+    }
+    if (created > 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.size += created;
+        Logger::getInstance().infof("[%s] %u Lua states ready in %u ms", TAG, (unsigned)created,
+                                    (unsigned)((esp_timer_get_time() - start) / 1000));
+    }
+}
+
+template <typename Sandbox>
+typename LuaStatePool<Sandbox>::Lease LuaStatePool<Sandbox>::acquire(uint32_t timeout_ms) {
+    if (!available_) {
+        return {};
+    }
+
+    const uint32_t start = millis();
+    bool waited = false;
+    if (xSemaphoreTake(available_, 0) != pdTRUE) {
+        waited = true;
+        if (xSemaphoreTake(available_, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++stats_.timeouts;
+            Logger::getInstance().warnf("[%s] No Lua state free after %u ms", TAG, (unsigned)timeout_ms);
+            return {};
+        }
+    }
+    const uint32_t wait_ms = millis() - start;
+
+    // The semaphore guarantees a free slot; prefer one whose state already exists
+    int slot = -1;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < kPoolSize; ++i) {
+            if (!in_use_[i] && (slot < 0 || (sandboxes_[i] && !sandboxes_[slot]))) {
+                slot = static_cast<int>(i);
+            }
+        }
+        in_use_[slot] = true;
+
+        ++stats_.acquired;
+        ++stats_.in_use;
+        stats_.peak_in_use = std::max(stats_.peak_in_use, stats_.in_use);
+        if (waited) {
+            ++stats_.waited;
+            stats_.avg_wait_ms = average(stats_.avg_wait_ms, wait_ms);
+            stats_.max_wait_ms = std::max(stats_.max_wait_ms, wait_ms);
+        }
+    }
+
+    if (!sandboxes_[slot]) {
+        // Only reached before begin(): build the state outside the lock
+        std::unique_ptr<Sandbox> sandbox(new Sandbox());
+        std::lock_guard<std::mutex> lock(mutex_);
+        sandboxes_[slot] = std::move(sandbox);
+        ++stats_.size;
+    }
+    return Lease(this, sandboxes_[slot].get(), slot);
+}
+
+template <typename Sandbox>
+typename LuaStatePool<Sandbox>::Lease LuaStatePool<Sandbox>::acquireUi() {
+    ui_mutex_.lock();
+    if (!ui_sandbox_) {
+        ui_sandbox_.reset(new Sandbox());
+    }
+    return Lease(this, ui_sandbox_.get(), kUiSlot);
+}
+
+template <typename Sandbox>
+void LuaStatePool<Sandbox>::release(int slot) {
+    if (slot == kUiSlot) {
+        ui_mutex_.unlock();
+        return;
+    }
+
+    // The slot is still ours: reset without holding the lock
+    Sandbox& sandbox = *sandboxes_[slot];
+    const int64_t start = esp_timer_get_time();
+    sandbox.reset();
+    const uint32_t reset_us = static_cast<uint32_t>(esp_timer_get_time() - start);
+    const bool recycle = sandbox.needsRecycle();
+    if (recycle) {
+        Logger::getInstance().infof("[%s] Rebuilding Lua state %d (%u bytes, %u failed allocations)", TAG, slot,
+                                    (unsigned)sandbox.arena().stats().footprint,
+                                    (unsigned)sandbox.arena().stats().failures);
+        sandbox.recycle();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        in_use_[slot] = false;
+        --stats_.in_use;
+        stats_.avg_reset_us = average(stats_.avg_reset_us, reset_us);
+        if (recycle) {
+            ++stats_.recycled;
+        }
+        stats_.arena_bytes = stats_.arena_bytes - footprint_[slot] + sandbox.arena().stats().footprint;
+        footprint_[slot] = sandbox.arena().stats().footprint;
+    }
+    xSemaphoreGive(available_);
+}
@@ -1,13 +1,15 @@
 #include "microphone_manager.h"
 #include "audio_manager.h"
+#include "voice_activity_detector.h"
+#include "auto_gain_control.h"
 #include "utils/logger.h"
 #include <Arduino.h>
 #include <FS.h>
 #include <SD_MMC.h>
 #include <LittleFS.h>
 #include <driver/i2s.h>
+#include <esp_heap_caps.h>
 #include <algorithm>
-#include <limits>
 #include <cstring>
 
 #include "es8311.h"
@@ -24,13 +26,31 @@ constexpr int kMicI2sMckPin = 4;
 // Default recording directory
 constexpr const char* kRecordingsDir = "/test_recordings";
 
-// AGC (Auto Gain Control) parameters
-constexpr float kTargetPeak = 32000.0f;
-constexpr float kMaxGainFactor = 20.0f;
-
 // Recording buffer configuration
 constexpr size_t kSamplesPerChunk = 2048;
 
+// Upper bound for silence held back in memory when VAD auto-stop is disabled
+constexpr uint32_t kMaxVadHoldMs = 2000;
+
+// Flag bits of the packed level snapshot (bytes 0-2 hold level, input level and gain)
+constexpr uint32_t kLevelGatedBit = 1u << 24;
+constexpr uint32_t kLevelSpeechBit = 1u << 25;
+constexpr uint32_t kLevelRecordingBit = 1u << 26;
+
+inline uint16_t chunkPeak(const int16_t* samples, size_t count) {
+    int32_t peak = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const int32_t value = samples[i];
+        const int32_t magnitude = value < 0 ? -value : value;
+        peak = magnitude > peak ? magnitude : peak;
+    }
+    return static_cast<uint16_t>(std::min<int32_t>(peak, 32767));
+}
+
+inline uint8_t peakToPercent(uint16_t peak) {
+    return static_cast<uint8_t>(std::min<uint32_t>(100, (static_cast<uint32_t>(peak) * 100) / 32767));
+}
+
 /**
  * @brief WAV file header structure (PCM format)
  */
@@ -217,6 +237,89 @@ std::string buildPlaybackPath(const RecordingStorageInfo& info, const std::strin
     return relative_path;
 }
 
+/**
+ * @brief Byte ring that holds back silent audio while the VAD decides whether to keep it
+ *
+ * Before speech starts it acts as a pre-roll (oldest audio is dropped); after
+ * speech starts, pauses are held here and flushed to the file only if speech
+ * resumes, so trailing silence never reaches the WAV.
+ */
+class PcmHoldBuffer {
+public:
+    ~PcmHoldBuffer() {
+        if (data_) {
+            heap_caps_free(data_);
+        }
+    }
+
+    bool allocate(size_t capacity) {
+        data_ = static_cast<uint8_t*>(heap_caps_malloc(capacity, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+        if (!data_) {
+            data_ = static_cast<uint8_t*>(heap_caps_malloc(capacity, MALLOC_CAP_8BIT));
+        }
+        capacity_ = data_ ? capacity : 0;
+        return data_ != nullptr;
+    }
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+
+    void clear() {
+        head_ = 0;
+        size_ = 0;
+    }
+
+    /**
+     * @brief Remove up to max_bytes from the oldest end, handing contiguous pieces to sink
+     */
+    template <typename Sink>
+    size_t popFront(size_t max_bytes, Sink&& sink) {
+        size_t remaining = std::min(max_bytes, size_);
+        size_t popped = 0;
+        while (remaining > 0) {
+            const size_t piece = std::min(remaining, capacity_ - head_);
+            sink(data_ + head_, piece);
+            head_ = (head_ + piece) % capacity_;
+            size_ -= piece;
+            remaining -= piece;
+            popped += piece;
+        }
+        return popped;
+    }
+
+    /**
+     * @brief Append bytes; anything beyond limit is evicted oldest-first through evict
+     */
+    template <typename Sink>
+    void push(const uint8_t* bytes, size_t len, size_t limit, Sink&& evict) {
+        if (capacity_ == 0) {
+            evict(bytes, len);
+            return;
+        }
+        limit = std::min(limit, capacity_);
+        if (len > limit) {
+            popFront(size_, evict);
+            evict(bytes, len - limit);
+            bytes += len - limit;
+            len = limit;
+        }
+        if (size_ + len > limit) {
+            popFront(size_ + len - limit, evict);
+        }
+        const size_t tail = (head_ + size_) % capacity_;
+        const size_t first = std::min(len, capacity_ - tail);
+        memcpy(data_ + tail, bytes, first);
+        memcpy(data_, bytes + first, len - first);
+        size_ += len;
+    }
+
+private:
+    uint8_t* data_ = nullptr;
+    size_t capacity_ = 0;
+    size_t head_ = 0;
+    size_t size_ = 0;
+};
+
 } // namespace
 
 // Singleton instance
@@ -273,10 +376,30 @@ MicrophoneManager::RecordingHandle MicrophoneManager::startRecording(
         return nullptr;
     }
 
-    if (is_recording_.load()) {
+    if (config.preemptible && AudioManager::getInstance().isPlaying()) {
+        // Background capture never interrupts playback; the caller retries later
+        return nullptr;
+    }
+
+    // A foreground request takes over from background capture; retry in case the
+    // background owner restarted between the preemption and the claim below
+    bool claimed = false;
+    for (int attempt = 0; attempt < 3 && !claimed; ++attempt) {
+        if (!config.preemptible) {
+            preemptBackgroundRecording();
+        }
+        bool expected = false;
+        claimed = is_recording_.compare_exchange_strong(expected, true);
+        if (config.preemptible) {
+            break;
+        }
+    }
+    if (!claimed) {
         Logger::getInstance().warn("[MicMgr] Recording already in progress");
         return nullptr;
     }
+    active_stop_flag_.store(&stop_flag);
+    active_preemptible_.store(config.preemptible);
 
     // Create recording context
     auto* ctx = new RecordingContext();
@@ -285,9 +408,6 @@ MicrophoneManager::RecordingHandle MicrophoneManager::startRecording(
     ctx->stop_flag = &stop_flag;
     ctx->completed = false;
 
-    // Mark as recording
-    is_recording_.store(true);
-
     // Create recording task
     xTaskCreate(
         recordingTaskImpl,
@@ -324,6 +444,65 @@ MicrophoneManager::RecordingResult MicrophoneManager::getRecordingResult(Recordi
     return result;
 }
 
+bool MicrophoneManager::preemptBackgroundRecording(uint32_t timeout_ms) {
+    if (!is_recording_.load() || !active_preemptible_.load()) {
+        return true;
+    }
+
+    Logger::getInstance().info("[MicMgr] Preempting background recording");
+    std::atomic<bool>* stop_flag = active_stop_flag_.load();
+    if (stop_flag) {
+        stop_flag->store(true);
+    }
+
+    const uint32_t start_ms = millis();
+    while (is_recording_.load() && millis() - start_ms < timeout_ms) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    if (is_recording_.load()) {
+        Logger::getInstance().warn("[MicMgr] Background recording did not stop in time");
+        return false;
+    }
+    return true;
+}
+
+void MicrophoneManager::buildWavHeader(uint8_t* out, uint32_t sample_rate, uint16_t channels,
+                                       uint16_t bits_per_sample, uint32_t data_bytes) {
+    static_assert(sizeof(WAVHeader) == kWavHeaderSize, "WAVHeader must be packed to 44 bytes");
+
+    WAVHeader header;
+    header.sampleRate = sample_rate;
+    header.channels = channels;
+    header.bitsPerSample = bits_per_sample;
+    header.bytesPerSecond = sample_rate * channels * bits_per_sample / 8;
+    header.blockAlign = channels * (bits_per_sample / 8);
+    header.dataSize = data_bytes;
+    header.fileSize = (data_bytes == kWavUnknownLength) ? kWavUnknownLength : 36 + data_bytes;
+    memcpy(out, &header, sizeof(header));
+}
+
+void MicrophoneManager::publishLevel(const LevelSnapshot& snapshot) {
+    const uint32_t packed = static_cast<uint32_t>(snapshot.level)
+                          | (static_cast<uint32_t>(snapshot.input_level) << 8)
+                          | (static_cast<uint32_t>(snapshot.gain_x10) << 16)
+                          | (snapshot.gated ? kLevelGatedBit : 0)
+                          | (snapshot.speech ? kLevelSpeechBit : 0)
+                          | (snapshot.recording ? kLevelRecordingBit : 0);
+    level_snapshot_.store(packed, std::memory_order_relaxed);
+}
+
+MicrophoneManager::LevelSnapshot MicrophoneManager::getLevelSnapshot() const {
+    const uint32_t packed = level_snapshot_.load(std::memory_order_relaxed);
+    LevelSnapshot snapshot;
+    snapshot.level = static_cast<uint8_t>(packed);
+    snapshot.input_level = static_cast<uint8_t>(packed >> 8);
+    snapshot.gain_x10 = static_cast<uint8_t>(packed >> 16);
+    snapshot.gated = (packed & kLevelGatedBit) != 0;
+    snapshot.speech = (packed & kLevelSpeechBit) != 0;
+    snapshot.recording = (packed & kLevelRecordingBit) != 0;
+    return snapshot;
+}
+
 bool MicrophoneManager::setMicrophoneEnabled(bool enabled) {
     // TODO: Implement microphone enable/disable via codec control
     Logger::getInstance().infof("[MicMgr] Microphone %s", enabled ? "enabled" : "disabled");
@@ -384,42 +563,54 @@ void MicrophoneManager::recordingTaskImpl(void* param) {
         return;
     }
 
+    const bool save_to_file = config.save_to_file || !config.stream_buffer;
+    if (!config.save_to_file && !config.stream_buffer) {
+        Logger::getInstance().warn("[MicMgr] No stream buffer given, saving to file anyway");
+    }
+
     // Get storage info and generate filename
     auto storage = getRecordingStorageInfo(config.custom_directory, config.filename_prefix);
-    if (!storage.fs || !ensureRecordingDirectory(storage)) {
-        Logger::getInstance().error("[MicMgr] Unable to access recording storage");
-        ctx->result.success = false;
-        ctx->completed = true;
-        manager->is_recording_.store(false);
-        manager->releaseI2SExclusiveAccess();
-        vTaskDelete(nullptr);
-        return;
-    }
+    std::string filename;
+    File file;
+
+    if (save_to_file) {
+        if (!storage.fs || !ensureRecordingDirectory(storage)) {
+            Logger::getInstance().error("[MicMgr] Unable to access recording storage");
+            ctx->result.success = false;
+            ctx->completed = true;
+            manager->is_recording_.store(false);
+            manager->releaseI2SExclusiveAccess();
+            vTaskDelete(nullptr);
+            return;
+        }
 
-    std::string filename = generateRecordingFilename(storage);
-    Logger::getInstance().infof("[MicMgr] Recording to %s:%s", storage.label, filename.c_str());
+        filename = generateRecordingFilename(storage);
+        Logger::getInstance().infof("[MicMgr] Recording to %s:%s", storage.label, filename.c_str());
+
+        // Open file for writing
+        file = storage.fs->open(filename.c_str(), FILE_WRITE);
+        if (!file) {
+            Logger::getInstance().errorf("[MicMgr] Failed to open file on %s", storage.label);
+            ctx->result.success = false;
+            ctx->completed = true;
+            manager->is_recording_.store(false);
+            manager->releaseI2SExclusiveAccess();
+            vTaskDelete(nullptr);
+            return;
+        }
 
-    // Open file for writing
-    File file = storage.fs->open(filename.c_str(), FILE_WRITE);
-    if (!file) {
-        Logger::getInstance().errorf("[MicMgr] Failed to open file on %s", storage.label);
-        ctx->result.success = false;
-        ctx->completed = true;
-        manager->is_recording_.store(false);
-        manager->releaseI2SExclusiveAccess();
-        vTaskDelete(nullptr);
-        return;
+        // Write initial WAV header (will be updated at the end)
+        WAVHeader initial_header;
+        initial_header.sampleRate = config.sample_rate;
+        initial_header.channels = config.channels;
+        initial_header.bitsPerSample = config.bits_per_sample;
+        initial_header.bytesPerSecond = config.sample_rate * config.channels * config.bits_per_sample / 8;
+        initial_header.blockAlign = config.channels * (config.bits_per_sample / 8);
+        file.write((uint8_t*)&initial_header, sizeof(WAVHeader));
+    } else {
+        Logger::getInstance().info("[MicMgr] Recording to stream only (no file copy)");
     }
 
-    // Write initial WAV header (will be updated at the end)
-    WAVHeader initial_header;
-    initial_header.sampleRate = config.sample_rate;
-    initial_header.channels = config.channels;
-    initial_header.bitsPerSample = config.bits_per_sample;
-    initial_header.bytesPerSecond = config.sample_rate * config.channels * config.bits_per_sample / 8;
-    initial_header.blockAlign = config.channels * (config.bits_per_sample / 8);
-    file.write((uint8_t*)&initial_header, sizeof(WAVHeader));
-
     // Create ES8311 handle
     es8311_handle_t es_handle = es8311_create(I2C_NUM_0, 0x18);
     if (!es_handle) {
@@ -518,6 +709,118 @@ void MicrophoneManager::recordingTaskImpl(void* param) {
     uint32_t total_bytes = 0;
     uint64_t recorded_samples = 0;
 
+    // Voice Activity Detection runs on the raw (pre-AGC) samples
+    bool vad_enabled = config.enable_vad;
+    if (vad_enabled && (config.bits_per_sample != 16 || config.channels != 1)) {
+        Logger::getInstance().warn("[MicMgr] VAD requires 16-bit mono audio, disabled");
+        vad_enabled = false;
+    }
+
+    VoiceActivityDetector::Config vad_config;
+    vad_config.sample_rate = config.sample_rate;
+    VoiceActivityDetector vad(vad_config);
+
+    AutoGainControl agc;
+
+    const uint32_t bytes_per_second = config.sample_rate * sizeof(int16_t);
+    const size_t padding_bytes = (static_cast<size_t>(config.vad_padding_ms) * config.sample_rate / 1000) * sizeof(int16_t);
+    const uint32_t hold_ms = config.vad_auto_stop ? config.vad_end_silence_ms : kMaxVadHoldMs;
+    const size_t hold_bytes = (static_cast<size_t>(hold_ms) * config.sample_rate / 1000) * sizeof(int16_t) + padding_bytes;
+
+    PcmHoldBuffer hold;
+    bool trim_silence = vad_enabled && config.vad_trim_silence;
+    if (trim_silence && !hold.allocate(std::max(hold_bytes, kSamplesPerChunk * sizeof(int16_t)))) {
+        Logger::getInstance().warn("[MicMgr] VAD hold buffer allocation failed, silence trimming disabled");
+        trim_silence = false;
+    }
+
+    uint32_t dropped_bytes = 0;   // Leading silence never written
+    uint32_t discarded_bytes = 0; // Trailing silence never written
+    bool stopped_by_vad = false;
+
+    uint32_t stream_dropped_bytes = 0;
+
+    // Every byte kept for the recording goes through here: file copy and/or live stream consumer
+    auto write_pcm = [&](const uint8_t* data, size_t len) {
+        if (file) {
+            file.write(data, len);
+        }
+        if (config.stream_buffer) {
+            // Never block the capture loop on a slow consumer; send whole chunks only so the
+            // consumer always sees sample-aligned data (single producer, so the check is safe)
+            if (xStreamBufferSpacesAvailable(config.stream_buffer) >= len) {
+                xStreamBufferSend(config.stream_buffer, data, len, 0);
+            } else {
+                stream_dropped_bytes += len;
+            }
+        }
+        total_bytes += len;
+    };
+
+    // VAD, AGC, silence trimming and level metering for one block of 16-bit samples (modified in place)
+    auto process_samples = [&](int16_t* samples, size_t sample_count) {
+        bool chunk_has_speech = true;
+        if (vad_enabled) {
+            chunk_has_speech = vad.process(samples, sample_count);
+        }
+
+        // Log first few samples for debugging
+        if (recorded_samples < 10) {
+            Logger::getInstance().infof("[MicMgr] Debug samples %llu-%llu: %d %d %d %d",
+                recorded_samples, recorded_samples + 3,
+                samples[0], samples[1], samples[2], samples[3]);
+        }
+
+        AutoGainControl::Stats agc_stats;
+        if (config.enable_agc) {
+            agc_stats = agc.process(samples, sample_count);
+        } else {
+            agc_stats.peak_in = chunkPeak(samples, sample_count);
+            agc_stats.peak_out = agc_stats.peak_in;
+        }
+
+        // Write to file (silent chunks are held back while trimming)
+        size_t mono_bytes = sample_count * sizeof(int16_t);
+        const uint8_t* pcm = reinterpret_cast<uint8_t*>(samples);
+        if (!trim_silence) {
+            write_pcm(pcm, mono_bytes);
+        } else if (chunk_has_speech) {
+            hold.popFront(hold.size(), write_pcm);
+            write_pcm(pcm, mono_bytes);
+        } else {
+            const bool speech_started = vad.hasDetectedSpeech();
+            hold.push(pcm, mono_bytes, speech_started ? hold.capacity() : padding_bytes,
+                      [&](const uint8_t* data, size_t len) {
+                          if (speech_started) {
+                              write_pcm(data, len);
+                          } else {
+                              dropped_bytes += len;
+                          }
+                      });
+        }
+        recorded_samples += sample_count;
+
+        LevelSnapshot snapshot;
+        snapshot.level = peakToPercent(agc_stats.peak_out);
+        snapshot.input_level = peakToPercent(agc_stats.peak_in);
+        snapshot.gain_x10 = static_cast<uint8_t>(
+            std::min<int32_t>(255, (agc_stats.gain_q10 * 10 + AutoGainControl::kUnityGain / 2) >> 10));
+        snapshot.gated = config.enable_agc && agc_stats.gated;
+        snapshot.speech = vad_enabled && vad.isSpeech();
+        snapshot.recording = true;
+        manager->publishLevel(snapshot);
+    };
+
+    if (!config.preroll.empty()) {
+        if (config.bits_per_sample == 16 && config.channels == 1) {
+            Logger::getInstance().infof("[MicMgr] Prepending %u pre-roll samples",
+                                        static_cast<unsigned>(config.preroll.size()));
+            process_samples(config.preroll.data(), config.preroll.size());
+        } else {
+            Logger::getInstance().warn("[MicMgr] Pre-roll requires 16-bit mono audio, ignored");
+        }
+    }
+
     Logger::getInstance().info("[MicMgr] Recording started");
 
     // Recording loop
@@ -533,6 +836,20 @@ void MicrophoneManager::recordingTaskImpl(void* param) {
             break;
         }
 
+        if (vad_enabled) {
+            if (vad.hasDetectedSpeech()) {
+                if (config.vad_auto_stop && !vad.isSpeech() && vad.silenceMs() >= config.vad_end_silence_ms) {
+                    Logger::getInstance().info("[MicMgr] VAD end of speech, stopping");
+                    stopped_by_vad = true;
+                    break;
+                }
+            } else if (config.vad_no_speech_timeout_ms > 0 && vad.silenceMs() >= config.vad_no_speech_timeout_ms) {
+                Logger::getInstance().info("[MicMgr] VAD no speech within timeout, stopping");
+                stopped_by_vad = true;
+                break;
+            }
+        }
+
         size_t bytes_read = 0;
         err = i2s_read(I2S_NUM_1, buffer, kSamplesPerChunk * sizeof(int16_t), &bytes_read, pdMS_TO_TICKS(100));
 
@@ -540,76 +857,14 @@ void MicrophoneManager::recordingTaskImpl(void* param) {
             int16_t* samples = reinterpret_cast<int16_t*>(buffer);
             size_t sample_count = bytes_read / sizeof(int16_t);
 
-            // Calculate peak level for this chunk
-            int32_t chunk_peak = 0;
-            for (size_t i = 0; i < sample_count; ++i) {
-                int32_t value = std::abs(samples[i]);
-                if (value > chunk_peak) {
-                    chunk_peak = value;
-                }
-            }
-
-            // Apply AGC if enabled
-            float gain = 1.0f;
-            int32_t scaled_peak = chunk_peak;
-
-    // Temporarily disable AGC for debugging
-    if (config.enable_agc && chunk_peak > 0 && chunk_peak < kTargetPeak) {
-        gain = std::min<float>(kMaxGainFactor, kTargetPeak / static_cast<float>(chunk_peak));
-    } else {
-        gain = 1.0f;  // Force no AGC
-    }
-
-    // Log first few samples for debugging
-    if (recorded_samples < 10) {
-        Logger::getInstance().infof("[MicMgr] Debug samples %llu-%llu: %d %d %d %d",
-            recorded_samples, recorded_samples + 3,
-            samples[0], samples[1], samples[2], samples[3]);
-    }
-
-    if (gain != 1.0f) {
-        scaled_peak = 0;
-        constexpr int32_t kInt16Min = std::numeric_limits<int16_t>::min();
-        constexpr int32_t kInt16Max = std::numeric_limits<int16_t>::max();
-        for (size_t i = 0; i < sample_count; ++i) {
-            float scaled_value = samples[i] * gain;
-            int32_t scaled_int = static_cast<int32_t>(scaled_value);
-            if (scaled_int < kInt16Min) {
-                scaled_int = kInt16Min;
-            } else if (scaled_int > kInt16Max) {
-                scaled_int = kInt16Max;
-            }
-            samples[i] = static_cast<int16_t>(scaled_int);
-            int32_t abs_value = std::abs(scaled_int);
-            if (abs_value > scaled_peak) {
-                scaled_peak = abs_value;
-            }
-        }
-    }
-
-            // Write to file
-            size_t mono_bytes = sample_count * sizeof(int16_t);
-            file.write(reinterpret_cast<uint8_t*>(samples), mono_bytes);
-            recorded_samples += sample_count;
-            total_bytes += mono_bytes;
-
-            // Update current level and call callback
-            uint16_t level = static_cast<uint16_t>(std::min<int>(100, (scaled_peak * 100) / 32767));
-            manager->current_level_.store(level);
-
-            if (config.level_callback) {
-                config.level_callback(level);
-            }
+            process_samples(samples, sample_count);
         } else {
             vTaskDelay(pdMS_TO_TICKS(10));
         }
     }
 
     // Reset level
-    manager->current_level_.store(0);
-    if (config.level_callback) {
-        config.level_callback(0);
-    }
+    manager->publishLevel(LevelSnapshot());
 
     // Delete ES8311 handle
     if (es_handle) {
@@ -621,6 +876,18 @@ void MicrophoneManager::recordingTaskImpl(void* param) {
     free(buffer);
     i2s_driver_uninstall(I2S_NUM_1);
 
+    // Close the VAD stream and keep only a short tail after the last speech
+    if (vad_enabled) {
+        vad.finish();
+        if (trim_silence) {
+            if (vad.hasDetectedSpeech()) {
+                hold.popFront(padding_bytes, write_pcm);
+            }
+            discarded_bytes += hold.size();
+            hold.clear();
+        }
+    }
+
     uint32_t recording_duration_ms = millis() - start_ms;
     if (recording_duration_ms == 0) {
         recording_duration_ms = 1;
@@ -631,8 +898,12 @@ void MicrophoneManager::recordingTaskImpl(void* param) {
                                 static_cast<unsigned long long>(recorded_samples),
                                 recording_duration_ms);
 
+    if (stream_dropped_bytes > 0) {
+        Logger::getInstance().warnf("[MicMgr] Stream consumer too slow, %u bytes dropped", stream_dropped_bytes);
+    }
+
     // Update WAV header with actual data size
-    if (total_bytes > 0) {
+    if (file && total_bytes > 0) {
         WAVHeader header;
         header.sampleRate = config.sample_rate;
         header.channels = config.channels;
@@ -653,11 +924,46 @@ void MicrophoneManager::recordingTaskImpl(void* param) {
 
     // Populate result
     ctx->result.success = (total_bytes > 0);
-    ctx->result.file_path = buildPlaybackPath(storage, filename);
+    ctx->result.file_path = save_to_file ? buildPlaybackPath(storage, filename) : std::string();
     ctx->result.duration_ms = recording_duration_ms;
     ctx->result.sample_rate = config.sample_rate;
+    ctx->result.pcm_bytes = total_bytes;
+    ctx->result.stream_dropped_bytes = stream_dropped_bytes;
+
+    if (vad_enabled) {
+        ctx->result.speech_detected = vad.hasDetectedSpeech();
+        ctx->result.stopped_by_vad = stopped_by_vad;
+        ctx->result.trimmed_ms = static_cast<uint32_t>(
+            (static_cast<uint64_t>(dropped_bytes + discarded_bytes) * 1000) / bytes_per_second);
+
+        // Segment offsets are shifted by the leading silence that never reached the file
+        const uint32_t dropped_samples = dropped_bytes / sizeof(int16_t);
+        const uint32_t written_samples = total_bytes / sizeof(int16_t);
+        for (const auto& segment : vad.segments()) {
+            const uint32_t start = segment.start_sample > dropped_samples ? segment.start_sample - dropped_samples : 0;
+            const uint32_t end = std::min(segment.end_sample - std::min(segment.end_sample, dropped_samples), written_samples);
+            if (end <= start) {
+                continue;
+            }
+            SpeechSegment out;
+            out.start_ms = static_cast<uint32_t>((static_cast<uint64_t>(start) * 1000) / config.sample_rate);
+            out.end_ms = static_cast<uint32_t>((static_cast<uint64_t>(end) * 1000) / config.sample_rate);
+            ctx->result.speech_segments.push_back(out);
+        }
+
+        Logger::getInstance().infof("[MicMgr] VAD: speech=%s, %u segment(s), trimmed %u ms, noise floor %u",
+                                    ctx->result.speech_detected ? "yes" : "no",
+                                    static_cast<unsigned>(ctx->result.speech_segments.size()),
+                                    ctx->result.trimmed_ms,
+                                    vad.noiseFloor());
+
+        if (save_to_file && trim_silence && total_bytes == 0) {
+            // Nothing worth keeping: don't leave an empty WAV behind
+            storage.fs->remove(filename.c_str());
+        }
+    }
 
-    if (ctx->result.success) {
+    if (ctx->result.success && save_to_file) {
         // Get file size
         File check_file = storage.fs->open(filename.c_str(), FILE_READ);
         if (check_file) {
@@ -668,6 +974,8 @@ void MicrophoneManager::recordingTaskImpl(void* param) {
         Logger::getInstance().infof("[MicMgr] Recording saved: %s (%u bytes)",
                                     ctx->result.file_path.c_str(),
                                     ctx->result.file_size_bytes);
+    } else if (ctx->result.success) {
+        Logger::getInstance().infof("[MicMgr] Recording streamed: %u bytes", total_bytes);
     } else {
         Logger::getInstance().error("[MicMgr] Recording failed");
     }
@@ -3,10 +3,12 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/semphr.h>
+#include <freertos/stream_buffer.h>
 #include <atomic>
 #include <string>
 #include <functional>
 #include <cstdint>
+#include <vector>
 
 /**
  * @brief Centralized Microphone Manager
@@ -15,6 +17,7 @@
  * - I2S exclusive management for recording
  * - WAV file generation
  * - Auto Gain Control (AGC)
+ * - Voice Activity Detection (auto-stop, silence trimming, speech segments)
  * - Coordination with AudioManager for I2S arbitration
  *
  * This class eliminates the need for UI screens (like MicrophoneTestScreen)
@@ -22,6 +25,14 @@
  */
 class MicrophoneManager {
 public:
+    /**
+     * @brief Speech segment detected by the VAD (offsets relative to the saved audio)
+     */
+    struct SpeechSegment {
+        uint32_t start_ms = 0;
+        uint32_t end_ms = 0;
+    };
+
     /**
      * @brief Recording result structure
      */
@@ -31,6 +42,12 @@ public:
         size_t file_size_bytes = 0;
         uint32_t duration_ms = 0;
         uint32_t sample_rate = 16000;
+        size_t pcm_bytes = 0;               // PCM bytes kept (written to file and/or stream)
+        size_t stream_dropped_bytes = 0;    // PCM bytes lost because the stream buffer was full
+        bool speech_detected = false;   // VAD only: at least one speech segment found
+        bool stopped_by_vad = false;    // VAD only: recording ended by end-of-speech/no-speech timeout
+        uint32_t trimmed_ms = 0;        // VAD only: silence dropped from the file
+        std::vector<SpeechSegment> speech_segments;
     };
 
     /**
@@ -42,9 +59,43 @@ public:
         uint8_t bits_per_sample = 16;
         uint8_t channels = 1;           // Mono
         bool enable_agc = true;         // Auto Gain Control enabled by default
-        std::function<void(uint16_t)> level_callback = nullptr; // Real-time level updates (0-100%)
         const char* custom_directory = nullptr; // Optional custom directory (default: /test_recordings)
         const char* filename_prefix = nullptr;  // Optional filename prefix (default: "test")
+
+        // Live streaming: kept PCM (post-AGC, post-trim) is also pushed here without blocking.
+        // The consumer detects end of stream when isRecording() turns false and the buffer is drained.
+        StreamBufferHandle_t stream_buffer = nullptr;
+        bool save_to_file = true;               // false = stream only (requires stream_buffer)
+
+        // Background capture (wake-word listening): refused while playback is active and stopped
+        // by preemptBackgroundRecording() when playback or a foreground recording starts
+        bool preemptible = false;
+
+        // 16-bit mono PCM run through VAD/AGC/output ahead of the live capture (e.g. wake-word pre-roll)
+        std::vector<int16_t> preroll;
+
+        // Voice Activity Detection (disabled by default)
+        bool enable_vad = false;                // Run the VAD on the raw capture
+        bool vad_auto_stop = true;              // Stop after vad_end_silence_ms of silence following speech
+        bool vad_trim_silence = true;           // Drop leading/trailing silence before finalizing the WAV
+        uint16_t vad_end_silence_ms = 900;      // Silence that marks the end of the utterance
+        uint16_t vad_no_speech_timeout_ms = 0;  // Give up if no speech starts within this time (0 = never)
+        uint16_t vad_padding_ms = 200;          // Audio kept before the first and after the last speech
+    };
+
+    /**
+     * @brief Latest capture level, published once per chunk by the recording task
+     *
+     * The capture loop never calls into UI code: consumers poll getLevelSnapshot()
+     * at their own rate (e.g. from an lv_timer).
+     */
+    struct LevelSnapshot {
+        uint8_t level = 0;          // Post-AGC peak (0-100%)
+        uint8_t input_level = 0;    // Raw peak before AGC (0-100%)
+        uint8_t gain_x10 = 10;      // Current AGC gain in tenths (10 = 1.0x)
+        bool gated = false;         // AGC noise gate closed
+        bool speech = false;        // VAD reports speech (always false without VAD)
+        bool recording = false;
     };
 
     /**
@@ -98,6 +149,16 @@ public:
      */
     bool isRecording() const { return is_recording_.load(); }
 
+    /**
+     * @brief Stop the active recording if it was started as preemptible
+     *
+     * Called before playback and foreground recordings so background capture
+     * hands I2S over instead of failing the caller.
+     * @param timeout_ms Maximum time to wait for the capture task to release I2S
+     * @return true if no background recording is running anymore
+     */
+    bool preemptBackgroundRecording(uint32_t timeout_ms = 1000);
+
     /**
      * @brief Enable or disable the microphone
      * @param enabled true to enable, false to disable
@@ -109,7 +170,26 @@ public:
      * @brief Get the current microphone level
      * @return Current level (0-100%)
      */
-    uint16_t getCurrentLevel() const { return current_level_.load(); }
+    uint16_t getCurrentLevel() const { return getLevelSnapshot().level; }
+
+    /**
+     * @brief Get the latest level snapshot (lock-free, safe from any task)
+     */
+    LevelSnapshot getLevelSnapshot() const;
+
+    /** Size of the canonical PCM WAV header produced by buildWavHeader() */
+    static constexpr size_t kWavHeaderSize = 44;
+
+    /** data_bytes value for streams whose final length is unknown when the header is sent */
+    static constexpr uint32_t kWavUnknownLength = 0xFFFFFFFF;
+
+    /**
+     * @brief Fill a PCM WAV header for the given format
+     * @param out Destination buffer of at least kWavHeaderSize bytes
+     * @param data_bytes PCM payload size, or kWavUnknownLength for live streams
+     */
+    static void buildWavHeader(uint8_t* out, uint32_t sample_rate, uint16_t channels,
+                               uint16_t bits_per_sample, uint32_t data_bytes);
 
 private:
     MicrophoneManager();
@@ -145,9 +225,16 @@ private:
      */
     void releaseI2SExclusiveAccess();
 
+    /**
+     * @brief Publish a level snapshot (packed in one word so readers never see a torn update)
+     */
+    void publishLevel(const LevelSnapshot& snapshot);
+
     // Internal state
     SemaphoreHandle_t i2s_mutex_ = nullptr;
     std::atomic<bool> is_recording_{false};
-    std::atomic<uint16_t> current_level_{0};
+    std::atomic<uint32_t> level_snapshot_{0};
+    std::atomic<std::atomic<bool>*> active_stop_flag_{nullptr};
+    std::atomic<bool> active_preemptible_{false};
     bool initialized_ = false;
 };
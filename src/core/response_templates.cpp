@@ -0,0 +1,146 @@
+#include "core/response_templates.h"
+
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <esp_timer.h>
+
+#include "utils/logger.h"
+
+namespace {
+constexpr const char* TAG = "ResponseTemplates";
+
+struct BuiltinTemplate {
+    const char* command;
+    const char* italian;
+    const char* english;
+};
+
+// Key=value outputs registered in CommandCenter
+constexpr BuiltinTemplate kBuiltins[] = {
+    {"heap",
+     "Memoria libera: {heap_free|bytes} di RAM interna (blocco più grande {heap_largest|bytes}) "
+     "e {psram_free|bytes} di PSRAM.",
+     "Free memory: {heap_free|bytes} of internal RAM (largest block {heap_largest|bytes}) "
+     "and {psram_free|bytes} of PSRAM."},
+    {"system_status",
+     "Memoria libera: {heap_free|bytes} di RAM e {psram_free|bytes} di PSRAM, "
+     "scheda SD {sd_card|map:mounted=montata/not_mounted=non montata}.",
+     "Free memory: {heap_free|bytes} of RAM and {psram_free|bytes} of PSRAM, "
+     "SD card {sd_card|map:mounted=mounted/not_mounted=not mounted}."},
+    {"uptime",
+     "Sono acceso da {uptime_seconds|duration}.",
+     "I have been running for {uptime_seconds|duration}."},
+    {"sd_status",
+     "La scheda SD è montata: {used|bytes} usati su {total|bytes}.",
+     "The SD card is mounted: {used|bytes} used of {total|bytes}."},
+    {"calendar_list",
+     "{$items|plural:Non ci sono eventi in calendario/Hai # evento in calendario/Hai # eventi in calendario}.",
+     "{$items|plural:There are no calendar events/You have # calendar event/You have # calendar events}."},
+};
+
+uint32_t average(uint32_t current, uint32_t sample) {
+    return current == 0 ? sample : (current * 7 + sample) / 8;
+}
+} // namespace
+
+ResponseTemplates& ResponseTemplates::getInstance() {
+    static ResponseTemplates instance;
+    return instance;
+}
+
+bool ResponseTemplates::render(const std::string& command, const std::vector<std::string>& args,
+                               const std::string& output, const std::string& user_text, std::string& text) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!built_) {
+        buildLocked();
+    }
+
+    const int64_t start = esp_timer_get_time();
+    const bool english = ResponseTemplate::guessLanguage(user_text) == ResponseTemplate::Language::English;
+    for (const Entry& entry : entries_) {
+        if (entry.command != command ||
+            (!entry.match.empty() && (args.empty() || args[0].find(entry.match) == std::string::npos))) {
+            continue;
+        }
+        const ResponseTemplate& chosen = english && !entry.english.empty() ? entry.english : entry.italian;
+        if (chosen.render(output, text)) {
+            ++stats_.rendered;
+            stats_.avg_render_us = average(stats_.avg_render_us, static_cast<uint32_t>(esp_timer_get_time() - start));
+            return true;
+        }
+    }
+    ++stats_.missed;
+    return false;
+}
+
+void ResponseTemplates::reload() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    built_ = false;
+}
+
+ResponseTemplates::Stats ResponseTemplates::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.templates = entries_.size();
+    return stats;
+}
+
+void ResponseTemplates::buildLocked() {
+    entries_.clear();
+    loadDocsLocked();
+    for (const BuiltinTemplate& builtin : kBuiltins) {
+        addLocked(builtin.command, "", builtin.italian, builtin.english, "builtin");
+    }
+    built_ = true;
+    Logger::getInstance().infof("[%s] %u templates loaded", TAG, (unsigned)entries_.size());
+}
+
+void ResponseTemplates::loadDocsLocked() {
+    File dir = LittleFS.open(DOCS_DIR);
+    if (!dir || !dir.isDirectory()) {
+        return;
+    }
+
+    for (File file = dir.openNextFile(); file; file = dir.openNextFile()) {
+        const std::string name = file.name();
+        if (file.isDirectory() || name.size() < 5 || name.compare(name.size() - 5, 5, ".json") != 0) {
+            file.close();
+            continue;
+        }
+
+        // Only the template arrays are kept from the (larger) API descriptions
+        JsonDocument filter;
+        filter["response_templates"] = true;
+        JsonDocument doc;
+        DeserializationError err = deserializeJson(doc, file, DeserializationOption::Filter(filter));
+        file.close();
+        if (err) {
+            Logger::getInstance().errorf("[%s] %s parse error: %s", TAG, name.c_str(), err.c_str());
+            continue;
+        }
+
+        for (JsonObjectConst item : doc["response_templates"].as<JsonArrayConst>()) {
+            addLocked(item["command"] | "", item["match"] | "", item["it"] | "", item["en"] | "", name.c_str());
+        }
+    }
+    dir.close();
+}
+
+void ResponseTemplates::addLocked(const char* command, const char* match, const char* italian,
+                                  const char* english, const char* source) {
+    if (!*command || !*italian) {
+        return;
+    }
+
+    Entry entry;
+    entry.command = command;
+    entry.match = match;
+    std::string error;
+    if (!entry.italian.compile(italian, ResponseTemplate::Language::Italian, &error) ||
+        (*english && !entry.english.compile(english, ResponseTemplate::Language::English, &error))) {
+        Logger::getInstance().warnf("[%s] Ignoring malformed template for %s (%s): %s", TAG,
+                                    command, source, error.c_str());
+        return;
+    }
+    entries_.push_back(std::move(entry));
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "utils/response_template.h"
+
+/**
+ * @brief Local phrasing of command output, tried before LLM refinement
+ *
+ * Templates come from, in priority order:
+ *   1. "response_templates" arrays in the API docs (LittleFS /memory/docs/api/*.json)
+ *   2. built-in templates for the CommandCenter commands with technical output
+ *      (heap, system_status, uptime, sd_status, calendar_list)
+ *
+ * Docs format:
+ * {"response_templates": [{"command": "lua_script", "match": "open-meteo",
+ *                          "it": "Ci sono {current.temperature_2m|round} gradi",
+ *                          "en": "It is {current.temperature_2m|round} degrees"}]}
+ *
+ * "match" (optional) must occur in the first argument (the script for
+ * lua_script). The first template of the command that renders the output wins;
+ * the English text is used when the user spoke English and one is given. When
+ * none renders, the caller falls back to the LLM. Syntax: see ResponseTemplate.
+ */
+class ResponseTemplates {
+public:
+    static constexpr const char* DOCS_DIR = "/memory/docs/api";
+
+    struct Stats {
+        uint32_t rendered = 0;          // Outputs phrased locally
+        uint32_t missed = 0;            // No template matched (refined by the LLM)
+        uint32_t avg_render_us = 0;
+        size_t templates = 0;
+    };
+
+    static ResponseTemplates& getInstance();
+
+    /**
+     * @brief Phrase a command output
+     * @param user_text What the user said (picks the language)
+     * @return false if no template matches
+     */
+    bool render(const std::string& command, const std::vector<std::string>& args,
+                const std::string& output, const std::string& user_text, std::string& text);
+
+    /** Re-read the docs on next render */
+    void reload();
+
+    Stats getStats() const;
+
+private:
+    struct Entry {
+        std::string command;
+        std::string match;
+        ResponseTemplate italian;
+        ResponseTemplate english;       // Empty if not given
+    };
+
+    ResponseTemplates() = default;
+    ResponseTemplates(const ResponseTemplates&) = delete;
+    ResponseTemplates& operator=(const ResponseTemplates&) = delete;
+
+    void buildLocked();
+    void loadDocsLocked();
+    void addLocked(const char* command, const char* match, const char* italian, const char* english,
+                   const char* source);
+
+    mutable std::mutex mutex_;
+    std::vector<Entry> entries_;
+    bool built_ = false;
+    Stats stats_;
+};
@@ -1,4 +1,5 @@
 #include "core/settings_manager.h"
+#include "core/event_router.h"
 #include "core/storage_manager.h"
 #include "drivers/sd_card_driver.h"
 #include <Arduino.h>
@@ -36,6 +37,48 @@ std::string sanitizeString(const std::string& value, size_t max_len) {
     }
     return value.substr(0, max_len);
 }
+
+// Settings that scripts can react to, published as "settings.<name>" with the new value
+bool settingsEvent(SettingsManager::SettingKey key, const SettingsSnapshot& snapshot,
+                   const char*& name, std::string& value) {
+    using Key = SettingsManager::SettingKey;
+    switch (key) {
+        case Key::AudioVolume:
+            name = "settings.volume";
+            value = std::to_string(snapshot.audioVolume);
+            return true;
+        case Key::AudioEnabled:
+            name = "settings.audio_enabled";
+            value = snapshot.audioEnabled ? "true" : "false";
+            return true;
+        case Key::Brightness:
+            name = "settings.brightness";
+            value = std::to_string(snapshot.brightness);
+            return true;
+        case Key::LedBrightness:
+            name = "settings.led_brightness";
+            value = std::to_string(snapshot.ledBrightness);
+            return true;
+        case Key::VoiceAssistantEnabled:
+            name = "settings.assistant_enabled";
+            value = snapshot.voiceAssistantEnabled ? "true" : "false";
+            return true;
+        case Key::Theme:
+            name = "settings.theme";
+            value = snapshot.theme;
+            return true;
+        case Key::Timezone:
+            name = "settings.timezone";
+            value = snapshot.timezone;
+            return true;
+        case Key::WifiSsid:
+            name = "settings.wifi_ssid";
+            value = snapshot.wifiSsid;
+            return true;
+        default:
+            return false;
+    }
+}
 } // namespace
 
 SettingsManager& SettingsManager::getInstance() {
@@ -795,6 +838,64 @@ void SettingsManager::setWhisperLocalEndpoint(const std::string& endpoint) {
     notify(SettingKey::WhisperLocalEndpoint);
 }
 
+void SettingsManager::setWhisperCloudUploadFormat(const std::string& format) {
+    if (!initialized_ || format == current_.whisperCloudUploadFormat) {
+        return;
+    }
+    current_.whisperCloudUploadFormat = format;
+    persistSnapshot();
+    notify(SettingKey::WhisperCloudUploadFormat);
+}
+
+void SettingsManager::setWhisperLocalUploadFormat(const std::string& format) {
+    if (!initialized_ || format == current_.whisperLocalUploadFormat) {
+        return;
+    }
+    current_.whisperLocalUploadFormat = format;
+    persistSnapshot();
+    notify(SettingKey::WhisperLocalUploadFormat);
+}
+
+void SettingsManager::setSttStreamingUpload(bool enabled) {
+    if (!initialized_ || enabled == current_.sttStreamingUpload) {
+        return;
+    }
+    current_.sttStreamingUpload = enabled;
+    persistSnapshot();
+    notify(SettingKey::SttStreamingUpload);
+}
+
+void SettingsManager::setSttSaveRecordings(bool enabled) {
+    if (!initialized_ || enabled == current_.sttSaveRecordings) {
+        return;
+    }
+    current_.sttSaveRecordings = enabled;
+    persistSnapshot();
+    notify(SettingKey::SttSaveRecordings);
+}
+
+void SettingsManager::setWakeWordEnabled(bool enabled) {
+    if (!initialized_ || enabled == current_.wakeWordEnabled) {
+        return;
+    }
+    current_.wakeWordEnabled = enabled;
+    persistSnapshot();
+    notify(SettingKey::WakeWordEnabled);
+}
+
+void SettingsManager::setWakeWordThreshold(uint8_t threshold) {
+    if (!initialized_) {
+        return;
+    }
+    uint8_t clamped = std::min<uint8_t>(99, std::max<uint8_t>(50, threshold));
+    if (clamped == current_.wakeWordThreshold) {
+        return;
+    }
+    current_.wakeWordThreshold = clamped;
+    persistSnapshot();
+    notify(SettingKey::WakeWordThreshold);
+}
+
 void SettingsManager::setLlmCloudEndpoint(const std::string& endpoint) {
     if (!initialized_ || endpoint == current_.llmCloudEndpoint) {
         return;
@@ -822,6 +923,28 @@ void SettingsManager::setLlmModel(const std::string& model) {
     notify(SettingKey::LlmModel);
 }
 
+void SettingsManager::setLlmStreaming(bool enabled) {
+    if (!initialized_ || enabled == current_.llmStreaming) {
+        return;
+    }
+    current_.llmStreaming = enabled;
+    persistSnapshot();
+    notify(SettingKey::LlmStreaming);
+}
+
+void SettingsManager::setLlmContextTokens(uint16_t tokens) {
+    if (!initialized_) {
+        return;
+    }
+    const uint16_t clamped = tokens == 0 ? 0 : std::min<uint16_t>(8192, std::max<uint16_t>(256, tokens));
+    if (clamped == current_.llmContextTokens) {
+        return;
+    }
+    current_.llmContextTokens = clamped;
+    persistSnapshot();
+    notify(SettingKey::LlmContextTokens);
+}
+
 void SettingsManager::setTtsEnabled(bool enabled) {
     if (!initialized_ || enabled == current_.ttsEnabled) {
         return;
@@ -1025,4 +1148,10 @@ void SettingsManager::notify(SettingKey key) {
             entry.fn(key, current_);
         }
     }
+
+    const char* event = nullptr;
+    std::string value;
+    if (settingsEvent(key, current_, event, value)) {
+        EventRouter::getInstance()->publish(event, const_cast<char*>(value.c_str()));
+    }
 }
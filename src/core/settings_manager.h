@@ -49,11 +49,19 @@ struct SettingsSnapshot {
     // Whisper STT endpoints
     std::string whisperCloudEndpoint = "https://api.openai.com/v1/audio/transcriptions";
     std::string whisperLocalEndpoint = "http://192.168.1.51:8002/v1/audio/transcriptions";
+    std::string whisperCloudUploadFormat = "wav";  // Upload encoding per endpoint: wav (PCM) or adpcm (IMA-ADPCM, 4:1)
+    std::string whisperLocalUploadFormat = "wav";
+    bool sttStreamingUpload = false;  // Upload audio to Whisper while recording (chunked transfer)
+    bool sttSaveRecordings = true;    // Keep a WAV copy of each assistant recording
+    bool wakeWordEnabled = false;     // Always-listening wake-word mode (needs a KWS model file)
+    uint8_t wakeWordThreshold = 85;   // Keyword probability (%) required to trigger listening
 
     // LLM/GPT endpoints
     std::string llmCloudEndpoint = "https://api.openai.com/v1/chat/completions";
     std::string llmLocalEndpoint = "http://192.168.1.51:11434/v1/chat/completions";
     std::string llmModel = "llama3.2:3b";  // Model name for LLM requests
+    bool llmStreaming = true;  // Request "stream": true and show the reply as it is generated
+    uint16_t llmContextTokens = 1024;  // History budget per request (0 = send the whole buffer)
 
     // TTS (Text-to-Speech) endpoints
     bool ttsEnabled = false;
@@ -145,9 +153,17 @@ public:
         DockerHostIp,
         WhisperCloudEndpoint,
         WhisperLocalEndpoint,
+        WhisperCloudUploadFormat,
+        WhisperLocalUploadFormat,
+        SttStreamingUpload,
+        SttSaveRecordings,
+        WakeWordEnabled,
+        WakeWordThreshold,
         LlmCloudEndpoint,
         LlmLocalEndpoint,
         LlmModel,
+        LlmStreaming,
+        LlmContextTokens,
         VoiceAssistantSystemPrompt,
         AutosendEnabled,
 
@@ -306,6 +322,24 @@ public:
     const std::string& getWhisperLocalEndpoint() const { return current_.whisperLocalEndpoint; }
     void setWhisperLocalEndpoint(const std::string& endpoint);
 
+    const std::string& getWhisperCloudUploadFormat() const { return current_.whisperCloudUploadFormat; }
+    void setWhisperCloudUploadFormat(const std::string& format);
+
+    const std::string& getWhisperLocalUploadFormat() const { return current_.whisperLocalUploadFormat; }
+    void setWhisperLocalUploadFormat(const std::string& format);
+
+    bool getSttStreamingUpload() const { return current_.sttStreamingUpload; }
+    void setSttStreamingUpload(bool enabled);
+
+    bool getSttSaveRecordings() const { return current_.sttSaveRecordings; }
+    void setSttSaveRecordings(bool enabled);
+
+    bool getWakeWordEnabled() const { return current_.wakeWordEnabled; }
+    void setWakeWordEnabled(bool enabled);
+
+    uint8_t getWakeWordThreshold() const { return current_.wakeWordThreshold; }
+    void setWakeWordThreshold(uint8_t threshold);
+
     const std::string& getLlmCloudEndpoint() const { return current_.llmCloudEndpoint; }
     void setLlmCloudEndpoint(const std::string& endpoint);
 
@@ -315,6 +349,12 @@ public:
     const std::string& getLlmModel() const { return current_.llmModel; }
     void setLlmModel(const std::string& model);
 
+    bool getLlmStreaming() const { return current_.llmStreaming; }
+    void setLlmStreaming(bool enabled);
+
+    uint16_t getLlmContextTokens() const { return current_.llmContextTokens; }
+    void setLlmContextTokens(uint16_t tokens);
+
     bool getAutosendEnabled() const { return current_.autosendEnabled; }
     void setAutosendEnabled(bool enabled);
 
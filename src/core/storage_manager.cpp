@@ -53,9 +53,17 @@ void fillJsonFromSnapshot(const SettingsSnapshot& snapshot, JsonDocument& doc) {
     voiceAssistant["dockerHostIp"] = snapshot.dockerHostIp;
     voiceAssistant["whisperCloudEndpoint"] = snapshot.whisperCloudEndpoint;
     voiceAssistant["whisperLocalEndpoint"] = snapshot.whisperLocalEndpoint;
+    voiceAssistant["whisperCloudUploadFormat"] = snapshot.whisperCloudUploadFormat;
+    voiceAssistant["whisperLocalUploadFormat"] = snapshot.whisperLocalUploadFormat;
+    voiceAssistant["sttStreamingUpload"] = snapshot.sttStreamingUpload;
+    voiceAssistant["sttSaveRecordings"] = snapshot.sttSaveRecordings;
+    voiceAssistant["wakeWordEnabled"] = snapshot.wakeWordEnabled;
+    voiceAssistant["wakeWordThreshold"] = snapshot.wakeWordThreshold;
     voiceAssistant["llmCloudEndpoint"] = snapshot.llmCloudEndpoint;
     voiceAssistant["llmLocalEndpoint"] = snapshot.llmLocalEndpoint;
     voiceAssistant["llmModel"] = snapshot.llmModel;
+    voiceAssistant["llmStreaming"] = snapshot.llmStreaming;
+    voiceAssistant["llmContextTokens"] = snapshot.llmContextTokens;
     voiceAssistant["systemPromptTemplate"] = snapshot.voiceAssistantSystemPromptTemplate;
 
     // Theme palette
@@ -130,9 +138,19 @@ void fillSnapshotFromJson(SettingsSnapshot& snapshot, const JsonDocument& doc) {
     snapshot.dockerHostIp = doc["voiceAssistant"]["dockerHostIp"] | snapshot.dockerHostIp;
     snapshot.whisperCloudEndpoint = doc["voiceAssistant"]["whisperCloudEndpoint"] | snapshot.whisperCloudEndpoint;
     snapshot.whisperLocalEndpoint = doc["voiceAssistant"]["whisperLocalEndpoint"] | snapshot.whisperLocalEndpoint;
+    snapshot.whisperCloudUploadFormat =
+        doc["voiceAssistant"]["whisperCloudUploadFormat"] | snapshot.whisperCloudUploadFormat;
+    snapshot.whisperLocalUploadFormat =
+        doc["voiceAssistant"]["whisperLocalUploadFormat"] | snapshot.whisperLocalUploadFormat;
+    snapshot.sttStreamingUpload = doc["voiceAssistant"]["sttStreamingUpload"] | snapshot.sttStreamingUpload;
+    snapshot.sttSaveRecordings = doc["voiceAssistant"]["sttSaveRecordings"] | snapshot.sttSaveRecordings;
+    snapshot.wakeWordEnabled = doc["voiceAssistant"]["wakeWordEnabled"] | snapshot.wakeWordEnabled;
+    snapshot.wakeWordThreshold = doc["voiceAssistant"]["wakeWordThreshold"] | snapshot.wakeWordThreshold;
     snapshot.llmCloudEndpoint = doc["voiceAssistant"]["llmCloudEndpoint"] | snapshot.llmCloudEndpoint;
     snapshot.llmLocalEndpoint = doc["voiceAssistant"]["llmLocalEndpoint"] | snapshot.llmLocalEndpoint;
     snapshot.llmModel = doc["voiceAssistant"]["llmModel"] | snapshot.llmModel;
+    snapshot.llmStreaming = doc["voiceAssistant"]["llmStreaming"] | snapshot.llmStreaming;
+    snapshot.llmContextTokens = doc["voiceAssistant"]["llmContextTokens"] | snapshot.llmContextTokens;
     snapshot.voiceAssistantSystemPromptTemplate =
         doc["voiceAssistant"]["systemPromptTemplate"] | snapshot.voiceAssistantSystemPromptTemplate;
 
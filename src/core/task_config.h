@@ -39,4 +39,43 @@ constexpr uint32_t VOICE_ASSISTANT_STACK_SIZE = 8192;
 constexpr UBaseType_t VOICE_ASSISTANT_PRIORITY = 4;
 constexpr BaseType_t VOICE_ASSISTANT_CORE = CORE_WORK;
 
+// Wake-word listener (log-mel front end + KWS inference, kept off the UI core)
+constexpr uint32_t STACK_WAKE_WORD = 4096;
+constexpr UBaseType_t PRIO_WAKE_WORD = 3;
+constexpr BaseType_t CORE_WAKE_WORD = CORE_WORK;
+
+// HTTP response body downloader feeding progressive playback (TTS)
+constexpr uint32_t STACK_HTTP_SOURCE = 4096;
+constexpr UBaseType_t PRIO_HTTP_SOURCE = 4;
+constexpr BaseType_t CORE_HTTP_SOURCE = CORE_WORK;
+
+// Sentence-pipelined TTS synthesis workers (TLS handshake needs the stack)
+constexpr uint32_t STACK_TTS_WORKER = 8192;
+constexpr UBaseType_t PRIO_TTS_WORKER = 3;
+constexpr BaseType_t CORE_TTS_WORKER = CORE_WORK;
+
+// Push-to-talk connection pre-warm for the assistant endpoints (TLS handshake)
+constexpr uint32_t STACK_HTTP_PREWARM = 8192;
+constexpr UBaseType_t PRIO_HTTP_PREWARM = 2;
+constexpr BaseType_t CORE_HTTP_PREWARM = CORE_WORK;
+
+// Extra workers running independent steps of a multi-command plan (Lua, HTTP)
+constexpr uint32_t STACK_PLAN_WORKER = 8192;
+constexpr UBaseType_t PRIO_PLAN_WORKER = 3;
+constexpr BaseType_t CORE_PLAN_WORKER = CORE_WORK;
+
+// Background refresh of stale-while-revalidate prompt auto_populate commands
+constexpr uint32_t STACK_AUTOPOP_REFRESH = 8192;
+constexpr UBaseType_t PRIO_AUTOPOP_REFRESH = 2;
+constexpr BaseType_t CORE_AUTOPOP_REFRESH = CORE_WORK;
+
+// Lua scripts run as coroutines on one scheduler task; bindings that block
+// (HTTP, TTS) hand their work to the I/O workers (TLS handshake needs the stack)
+constexpr uint32_t STACK_LUA_SCHEDULER = 12288;
+constexpr UBaseType_t PRIO_LUA_SCHEDULER = 3;
+constexpr BaseType_t CORE_LUA_SCHEDULER = CORE_WORK;
+constexpr uint32_t STACK_LUA_IO = 8192;
+constexpr UBaseType_t PRIO_LUA_IO = 3;
+constexpr BaseType_t CORE_LUA_IO = CORE_WORK;
+
 }  // namespace TaskConfig
@@ -1,7 +1,8 @@
 #include "core/time_scheduler.h"
 #include "core/storage_access_manager.h"
-#include "core/command_center.h"
+#include "core/lua_scheduler.h"
 #include "core/time_manager.h"
+#include "core/event_router.h"
 #include "utils/logger.h"
 
 #include <Arduino.h>
@@ -105,6 +106,8 @@ void TimeScheduler::schedulerTask(void* param) {
         // Check every 30 seconds
         vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(30000));
 
+        scheduler->publishMinute();
+
         if (!scheduler->enabled_) {
             continue;
         }
@@ -114,6 +117,25 @@ void TimeScheduler::schedulerTask(void* param) {
     }
 }
 
+void TimeScheduler::publishMinute() {
+    if (!TimeManager::getInstance().isSynchronized()) {
+        return;
+    }
+
+    // "time.minute" for event-driven scripts, at most 30 s after the minute starts
+    time_t minute = TimeManager::getInstance().now() / 60 * 60;
+    if (minute == last_minute_published_) {
+        return;
+    }
+    last_minute_published_ = minute;
+
+    struct tm now_tm;
+    localtime_r(&minute, &now_tm);
+    char payload[20];
+    strftime(payload, sizeof(payload), "%Y-%m-%d %H:%M", &now_tm);
+    EventRouter::getInstance()->publish("time.minute", payload);
+}
+
 void TimeScheduler::checkAndRunEvents() {
     if (!TimeManager::getInstance().isSynchronized()) {
         // Skip if time not synced
@@ -188,10 +210,8 @@ void TimeScheduler::executeEvent(CalendarEvent& event) {
 
     uint32_t start_ms = millis();
 
-    // Execute Lua script via CommandCenter
-    auto& cmd_center = CommandCenter::getInstance();
-    std::vector<std::string> args = { event.lua_script };
-    auto result = cmd_center.executeCommand("lua_script", args);
+    // Execute Lua script on the Lua scheduler (scheduler timeout applies)
+    auto result = LuaScheduler::getInstance().run(event.lua_script, LuaScheduler::Source::Scheduler);
 
     record.duration_ms = millis() - start_ms;
     record.success = result.success;
@@ -0,0 +1,468 @@
+#include "core/tts_cache.h"
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include "utils/logger.h"
+
+namespace {
+constexpr const char* TAG = "TtsCache";
+constexpr const char* INDEX_FILE = "index.json";
+constexpr const char* FILE_PREFIX = "c_";
+constexpr const char* FILE_SUFFIX = ".wav";
+constexpr const char* TEMP_SUFFIX = ".part";   // Being written: never handed out for playback
+constexpr uint32_t kSyncedEpoch = 1700000000;  // Anything earlier means SNTP has not run yet
+
+uint32_t nowEpoch() {
+    const time_t now = time(nullptr);
+    return now >= static_cast<time_t>(kSyncedEpoch) ? static_cast<uint32_t>(now) : 0;
+}
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+void hashBytes(uint64_t& hash, const char* data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 0x100000001b3ULL;  // FNV-1a 64
+    }
+}
+
+void hashField(uint64_t& hash, const std::string& field) {
+    hashBytes(hash, field.data(), field.size());
+    hashBytes(hash, "\x1f", 1);  // Field separator: ("ab","c") != ("a","bc")
+}
+} // namespace
+
+constexpr size_t TtsCache::kMaxEntries;
+constexpr uint32_t TtsCache::kMaxAgeDays;
+constexpr size_t TtsCache::kMaxIndexedTextChars;
+constexpr uint32_t TtsCache::kIndexFlushMs;
+
+TtsCache& TtsCache::getInstance() {
+    static TtsCache instance;
+    return instance;
+}
+
+std::string TtsCache::makeKey(const std::string& text, const VoiceParams& params) {
+    // Trim and collapse whitespace so "Buongiorno " and "Buongiorno" share audio
+    std::string normalized;
+    normalized.reserve(text.size());
+    bool pending_space = false;
+    for (char c : text) {
+        if (isSpace(c)) {
+            pending_space = !normalized.empty();
+            continue;
+        }
+        if (pending_space) {
+            normalized.push_back(' ');
+            pending_space = false;
+        }
+        normalized.push_back(c);
+    }
+
+    char speed[16];
+    snprintf(speed, sizeof(speed), "%.2f", params.speed);  // Float noise must not change the key
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hashField(hash, normalized);
+    hashField(hash, params.voice);
+    hashField(hash, params.model);
+    hashField(hash, speed);
+    hashField(hash, params.format);
+
+    char key[17];
+    snprintf(key, sizeof(key), "%08lx%08lx",
+             static_cast<unsigned long>(hash >> 32), static_cast<unsigned long>(hash & 0xffffffffULL));
+    return key;
+}
+
+bool TtsCache::configure(fs::FS* filesystem, const std::string& dir_on_fs, const std::string& display_dir,
+                         size_t max_bytes) {
+    if (!filesystem || dir_on_fs.empty()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fs_ == filesystem && dir_ == dir_on_fs) {
+        display_dir_ = display_dir;
+        if (max_bytes != max_bytes_) {
+            max_bytes_ = max_bytes;
+            evictLocked();
+        }
+        return true;
+    }
+
+    if (fs_ && dirty_) {
+        persistIndexLocked();
+    }
+
+    fs_ = filesystem;
+    dir_ = dir_on_fs;
+    display_dir_ = display_dir;
+    max_bytes_ = max_bytes;
+    entries_.clear();
+    bytes_ = 0;
+    tick_ = 0;
+    dirty_ = false;
+
+    if (!fs_->exists(dir_.c_str()) && !fs_->mkdir(dir_.c_str())) {
+        Logger::getInstance().errorf("[%s] Cannot create %s", TAG, dir_.c_str());
+        fs_ = nullptr;
+        return false;
+    }
+
+    if (!loadIndexLocked()) {
+        entries_.clear();
+        bytes_ = 0;
+    }
+    removeOrphansLocked();
+    evictLocked();
+    if (dirty_) {
+        persistIndexLocked();
+    }
+
+    Logger::getInstance().infof("[%s] %u entries, %u KB of %u KB in %s", TAG,
+                                (unsigned)entries_.size(), (unsigned)(bytes_ / 1024),
+                                (unsigned)(max_bytes_ / 1024), dir_.c_str());
+    return true;
+}
+
+bool TtsCache::lookup(const std::string& key, std::string& output_file_path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!fs_) {
+        return false;
+    }
+
+    Entry* entry = findLocked(key);
+    if (entry && !fs_->exists((dir_ + "/" + fileNameFor(key)).c_str())) {
+        Logger::getInstance().warnf("[%s] %s missing on storage, dropping entry", TAG, key.c_str());
+        removeEntryLocked(entry - entries_.data());
+        entry = nullptr;
+    }
+    if (!entry) {
+        ++stats_.misses;
+        return false;
+    }
+
+    ++stats_.hits;
+    ++entry->hits;
+    entry->last_use = ++tick_;
+    dirty_ = true;
+    output_file_path = display_dir_ + "/" + fileNameFor(key);
+
+    if (millis() - last_persist_ms_ >= kIndexFlushMs) {
+        persistIndexLocked();
+    }
+    return true;
+}
+
+bool TtsCache::contains(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return const_cast<TtsCache*>(this)->findLocked(key) != nullptr;
+}
+
+bool TtsCache::store(const std::string& key, const std::string& text, const PsramVector<uint8_t>& audio,
+                     std::string& output_file_path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!fs_ || audio.empty() || audio.size() > max_bytes_ / 4) {
+        return false;  // One reply must not flush the whole cache
+    }
+
+    const std::string path = dir_ + "/" + tempNameFor(key);
+    File file = fs_->open(path.c_str(), FILE_WRITE);
+    if (!file) {
+        Logger::getInstance().errorf("[%s] Cannot write %s", TAG, path.c_str());
+        return false;
+    }
+    const size_t written = file.write(audio.data(), audio.size());
+    file.close();
+    if (written != audio.size()) {
+        Logger::getInstance().errorf("[%s] Short write on %s (%u of %u bytes)", TAG, path.c_str(),
+                                     (unsigned)written, (unsigned)audio.size());
+        fs_->remove(path.c_str());
+        return false;
+    }
+    if (!moveIntoPlaceLocked(key)) {
+        return false;
+    }
+
+    addEntryLocked(key, text, audio.size());
+    output_file_path = display_dir_ + "/" + fileNameFor(key);
+    return true;
+}
+
+bool TtsCache::reserve(const std::string& key, fs::FS*& filesystem, std::string& path_on_fs,
+                       std::string& output_file_path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!fs_) {
+        return false;
+    }
+    filesystem = fs_;
+    path_on_fs = dir_ + "/" + tempNameFor(key);
+    output_file_path = display_dir_ + "/" + fileNameFor(key);
+    return true;
+}
+
+void TtsCache::commit(const std::string& key, const std::string& text, bool saved, size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!fs_) {
+        return;
+    }
+    const std::string temp = dir_ + "/" + tempNameFor(key);
+    if (!saved || bytes == 0 || bytes > max_bytes_ / 4) {
+        if (fs_->exists(temp.c_str())) {
+            fs_->remove(temp.c_str());  // Usually already removed by the writer
+        }
+        return;
+    }
+    if (moveIntoPlaceLocked(key)) {
+        addEntryLocked(key, text, bytes);
+    }
+}
+
+std::vector<std::string> TtsCache::frequentTexts(size_t max_items, uint32_t min_hits) const {
+    std::vector<const Entry*> candidates;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Entry& entry : entries_) {
+        if (!entry.text.empty() && entry.hits >= min_hits) {
+            candidates.push_back(&entry);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Entry* a, const Entry* b) { return a->hits > b->hits; });
+
+    std::vector<std::string> texts;
+    for (const Entry* entry : candidates) {
+        if (texts.size() >= max_items) {
+            break;
+        }
+        if (std::find(texts.begin(), texts.end(), entry->text) == texts.end()) {
+            texts.push_back(entry->text);  // Same phrase cached under several voices
+        }
+    }
+    return texts;
+}
+
+TtsCache::Stats TtsCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.entries = entries_.size();
+    stats.bytes = bytes_;
+    stats.max_bytes = max_bytes_;
+    return stats;
+}
+
+bool TtsCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!fs_) {
+        return false;
+    }
+    while (!entries_.empty()) {
+        removeEntryLocked(entries_.size() - 1);
+    }
+    tick_ = 0;
+    return persistIndexLocked();
+}
+
+void TtsCache::addEntryLocked(const std::string& key, const std::string& text, size_t bytes) {
+    Entry* entry = findLocked(key);
+    if (entry) {
+        bytes_ -= entry->bytes;  // Re-synthesized: file was overwritten
+    } else {
+        entries_.emplace_back();
+        entry = &entries_.back();
+        entry->key = key;
+    }
+    entry->text = text.size() <= kMaxIndexedTextChars ? text : std::string();
+    entry->bytes = static_cast<uint32_t>(bytes);
+    entry->created = nowEpoch();
+    entry->last_use = ++tick_;
+    bytes_ += bytes;
+    ++stats_.stores;
+
+    evictLocked();
+    persistIndexLocked();
+}
+
+void TtsCache::evictLocked() {
+    const uint32_t now = nowEpoch();
+    const uint32_t max_age_s = kMaxAgeDays * 24 * 3600;
+
+    for (size_t i = entries_.size(); i-- > 0;) {
+        if (now == 0) {
+            break;
+        }
+        Entry& entry = entries_[i];
+        if (entry.created == 0) {
+            entry.created = now;  // Age counts from the first synced clock
+            dirty_ = true;
+        } else if (now - entry.created > max_age_s) {
+            removeEntryLocked(i);
+        }
+    }
+
+    while (!entries_.empty() && (bytes_ > max_bytes_ || entries_.size() > kMaxEntries)) {
+        size_t oldest = 0;
+        for (size_t i = 1; i < entries_.size(); ++i) {
+            if (entries_[i].last_use < entries_[oldest].last_use) {
+                oldest = i;
+            }
+        }
+        removeEntryLocked(oldest);
+    }
+}
+
+void TtsCache::removeEntryLocked(size_t index) {
+    const Entry& entry = entries_[index];
+    fs_->remove((dir_ + "/" + fileNameFor(entry.key)).c_str());
+    bytes_ -= entry.bytes;
+    ++stats_.evictions;
+    entries_.erase(entries_.begin() + index);
+    dirty_ = true;
+}
+
+TtsCache::Entry* TtsCache::findLocked(const std::string& key) {
+    for (Entry& entry : entries_) {
+        if (entry.key == key) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+std::string TtsCache::fileNameFor(const std::string& key) const {
+    return std::string(FILE_PREFIX) + key + FILE_SUFFIX;
+}
+
+std::string TtsCache::tempNameFor(const std::string& key) const {
+    return std::string(FILE_PREFIX) + key + TEMP_SUFFIX;
+}
+
+bool TtsCache::moveIntoPlaceLocked(const std::string& key) {
+    const std::string temp = dir_ + "/" + tempNameFor(key);
+    const std::string path = dir_ + "/" + fileNameFor(key);
+    if (fs_->exists(path.c_str())) {
+        fs_->remove(path.c_str());  // FAT rename does not replace an existing file
+    }
+    if (!fs_->rename(temp.c_str(), path.c_str())) {
+        Logger::getInstance().errorf("[%s] Cannot rename %s to %s", TAG, temp.c_str(), path.c_str());
+        fs_->remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool TtsCache::loadIndexLocked() {
+    const std::string path = dir_ + "/" + INDEX_FILE;
+    if (!fs_->exists(path.c_str())) {
+        return true;
+    }
+    File file = fs_->open(path.c_str(), FILE_READ);
+    if (!file) {
+        return false;
+    }
+
+    JsonDocument doc;
+    DeserializationError err = deserializeJson(doc, file);
+    file.close();
+    if (err) {
+        Logger::getInstance().errorf("[%s] Index parse error: %s", TAG, err.c_str());
+        dirty_ = true;  // Rewritten after the orphan sweep
+        return false;
+    }
+
+    tick_ = doc["tick"] | 0u;
+    JsonArrayConst arr = doc["entries"].as<JsonArrayConst>();
+    for (JsonObjectConst item : arr) {
+        const char* key = item["key"] | "";
+        if (strlen(key) != 16 || findLocked(key)) {
+            continue;
+        }
+        Entry entry;
+        entry.key = key;
+        entry.text = item["text"] | "";
+        entry.bytes = item["bytes"] | 0u;
+        entry.created = item["created"] | 0u;
+        entry.last_use = item["last_use"] | 0u;
+        entry.hits = item["hits"] | 0u;
+        tick_ = std::max(tick_, entry.last_use);
+        bytes_ += entry.bytes;
+        entries_.push_back(std::move(entry));
+    }
+    return true;
+}
+
+bool TtsCache::persistIndexLocked() {
+    JsonDocument doc;
+    doc["version"] = 1;
+    doc["tick"] = tick_;
+    JsonArray arr = doc["entries"].to<JsonArray>();
+    for (const Entry& entry : entries_) {
+        JsonObject item = arr.add<JsonObject>();
+        item["key"] = entry.key;
+        if (!entry.text.empty()) {
+            item["text"] = entry.text;
+        }
+        item["bytes"] = entry.bytes;
+        item["created"] = entry.created;
+        item["last_use"] = entry.last_use;
+        item["hits"] = entry.hits;
+    }
+
+    const std::string path = dir_ + "/" + INDEX_FILE;
+    File file = fs_->open(path.c_str(), FILE_WRITE);
+    if (!file) {
+        Logger::getInstance().errorf("[%s] Cannot write %s", TAG, path.c_str());
+        return false;
+    }
+    serializeJson(doc, file);
+    file.close();
+
+    dirty_ = false;
+    last_persist_ms_ = millis();
+    return true;
+}
+
+void TtsCache::removeOrphansLocked() {
+    // Audio written before a crash or power loss never made it into the index,
+    // and a .part file is a write that never completed
+    File dir = fs_->open(dir_.c_str());
+    if (!dir || !dir.isDirectory()) {
+        return;
+    }
+
+    std::vector<std::string> orphans;
+    File file = dir.openNextFile();
+    while (file) {
+        std::string name = file.name();
+        const size_t slash = name.rfind('/');
+        if (slash != std::string::npos) {
+            name = name.substr(slash + 1);
+        }
+        file.close();
+
+        const bool audio = name.size() == 2 + 16 + strlen(FILE_SUFFIX) &&
+                           name.compare(2 + 16, std::string::npos, FILE_SUFFIX) == 0;
+        const bool partial = name.size() == 2 + 16 + strlen(TEMP_SUFFIX) &&
+                             name.compare(2 + 16, std::string::npos, TEMP_SUFFIX) == 0;
+        if (name.compare(0, 2, FILE_PREFIX) == 0 &&
+            (partial || (audio && !findLocked(name.substr(2, 16))))) {
+            orphans.push_back(name);
+        }
+        file = dir.openNextFile();
+    }
+    dir.close();
+
+    for (const std::string& name : orphans) {
+        fs_->remove((dir_ + "/" + name).c_str());
+    }
+    if (!orphans.empty()) {
+        Logger::getInstance().infof("[%s] Removed %u unindexed files", TAG, (unsigned)orphans.size());
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <FS.h>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "utils/psram_allocator.h"
+
+/**
+ * @brief Content-addressed cache of synthesized speech
+ *
+ * Audio is stored as c_<key>.wav in the cache directory, where key is a 64-bit
+ * FNV-1a hash of the normalized text and the settings that shape the audio
+ * (voice, model, speed, format): a fixed phrase is synthesized once per voice
+ * and replayed from storage without network afterwards. Audio is written to
+ * c_<key>.part and renamed once complete, so a c_<key>.wav is always whole.
+ *
+ * index.json in the same directory keeps size, creation time, hit count and LRU
+ * order. Least recently used entries are evicted once the cache exceeds its byte
+ * budget or kMaxEntries, and any entry older than kMaxAgeDays is dropped (age is
+ * only enforced once the clock has been synced). Short phrases keep their text in
+ * the index so frequently used ones can be synthesized again after the voice
+ * settings change (see VoiceAssistant::prewarmTTSCache()).
+ */
+class TtsCache {
+public:
+    static constexpr size_t kMaxEntries = 256;
+    static constexpr uint32_t kMaxAgeDays = 30;
+    static constexpr size_t kMaxIndexedTextChars = 160;  // Longer texts are not kept for pre-warming
+
+    struct VoiceParams {
+        std::string voice;
+        std::string model;
+        std::string format;
+        float speed = 1.0f;
+    };
+
+    struct Stats {
+        uint32_t hits = 0;
+        uint32_t misses = 0;
+        uint32_t stores = 0;
+        uint32_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t max_bytes = 0;
+    };
+
+    static TtsCache& getInstance();
+
+    /**
+     * @brief Point the cache at a directory (reloads the index when it changes)
+     * @param dir_on_fs Directory path on filesystem
+     * @param display_dir Same directory as returned to callers (/sd/..., /littlefs/...)
+     */
+    bool configure(fs::FS* filesystem, const std::string& dir_on_fs, const std::string& display_dir, size_t max_bytes);
+
+    /** Stable key for text spoken with params (whitespace-insensitive) */
+    static std::string makeKey(const std::string& text, const VoiceParams& params);
+
+    /** Cached audio for key, counted as hit/miss; returns the playable path */
+    bool lookup(const std::string& key, std::string& output_file_path);
+
+    /** Key is cached (not counted in stats) */
+    bool contains(const std::string& key) const;
+
+    /** Write audio for key; false if it does not fit the cache or the write failed */
+    bool store(const std::string& key, const std::string& text, const PsramVector<uint8_t>& audio,
+               std::string& output_file_path);
+
+    /**
+     * @brief Temporary path a download can be written to directly, then commit()ted
+     * @param output_file_path Playable path of the entry once committed
+     */
+    bool reserve(const std::string& key, fs::FS*& filesystem, std::string& path_on_fs, std::string& output_file_path);
+
+    /** Rename a complete download into place and index it; otherwise drop the temporary file */
+    void commit(const std::string& key, const std::string& text, bool saved, size_t bytes);
+
+    /** Texts of the most used entries, most hits first */
+    std::vector<std::string> frequentTexts(size_t max_items, uint32_t min_hits) const;
+
+    Stats getStats() const;
+    bool clear();
+
+private:
+    struct Entry {
+        std::string key;
+        std::string text;
+        uint32_t bytes = 0;
+        uint32_t created = 0;    // Epoch seconds, 0 = clock was not synced
+        uint32_t last_use = 0;   // LRU tick
+        uint32_t hits = 0;
+    };
+
+    TtsCache() = default;
+    TtsCache(const TtsCache&) = delete;
+    TtsCache& operator=(const TtsCache&) = delete;
+
+    bool loadIndexLocked();
+    bool persistIndexLocked();
+    void removeOrphansLocked();
+    void addEntryLocked(const std::string& key, const std::string& text, size_t bytes);
+    void evictLocked();
+    void removeEntryLocked(size_t index);
+    Entry* findLocked(const std::string& key);
+    std::string fileNameFor(const std::string& key) const;
+    std::string tempNameFor(const std::string& key) const;
+    bool moveIntoPlaceLocked(const std::string& key);
+
+    static constexpr uint32_t kIndexFlushMs = 60000;  // Hits only touch the index this often
+
+    mutable std::mutex mutex_;
+    fs::FS* fs_ = nullptr;
+    std::string dir_;
+    std::string display_dir_;
+    size_t max_bytes_ = 0;
+    std::vector<Entry> entries_;
+    size_t bytes_ = 0;
+    uint32_t tick_ = 0;
+    bool dirty_ = false;
+    uint32_t last_persist_ms_ = 0;
+    Stats stats_;
+};
@@ -0,0 +1,563 @@
+#include "core/tts_pipeline.h"
+#include "core/task_config.h"
+#include "utils/logger.h"
+#include "utils/tts_segmenter.h"
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "../lib/openESPaudio/src/data_source.h"
+
+namespace {
+
+constexpr size_t kWavHeaderBytes = 44;
+constexpr uint32_t kWorkerIdleMs = 20;
+constexpr uint32_t kReadPollMs = 10;
+
+struct WavFormat {
+    uint16_t format = 0;
+    uint16_t channels = 0;
+    uint32_t sample_rate = 0;
+    uint16_t block_align = 0;
+    uint16_t bits = 0;
+
+    bool operator==(const WavFormat& other) const {
+        return format == other.format && channels == other.channels && sample_rate == other.sample_rate &&
+               block_align == other.block_align && bits == other.bits;
+    }
+    bool operator!=(const WavFormat& other) const { return !(*this == other); }
+};
+
+uint16_t readLe16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t readLe32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void writeLe16(uint8_t* p, uint16_t value) {
+    p[0] = static_cast<uint8_t>(value);
+    p[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void writeLe32(uint8_t* p, uint32_t value) {
+    writeLe16(p, static_cast<uint16_t>(value));
+    writeLe16(p + 2, static_cast<uint16_t>(value >> 16));
+}
+
+// Locate the PCM payload of a synthesized segment (same chunk walk as WavDecoder)
+bool parseWav(const PsramVector<uint8_t>& wav, WavFormat& format, size_t& data_offset, size_t& data_length) {
+    const uint8_t* data = wav.data();
+    const size_t size = wav.size();
+    if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+
+    bool have_fmt = false;
+    size_t offset = 12;
+    while (offset + 8 <= size) {
+        const uint32_t chunk_size = readLe32(data + offset + 4);
+        if (memcmp(data + offset, "fmt ", 4) == 0) {
+            if (offset + 8 + 16 > size) {
+                return false;
+            }
+            const uint8_t* fmt = data + offset + 8;
+            format.format = readLe16(fmt);
+            format.channels = readLe16(fmt + 2);
+            format.sample_rate = readLe32(fmt + 4);
+            format.block_align = readLe16(fmt + 12);
+            format.bits = readLe16(fmt + 14);
+            have_fmt = format.channels > 0 && format.block_align > 0;
+        } else if (memcmp(data + offset, "data", 4) == 0) {
+            if (!have_fmt) {
+                return false;
+            }
+            data_offset = offset + 8;
+            const size_t available = size - data_offset;
+            // Streaming encoders leave 0/0xFFFFFFFF here
+            data_length = (chunk_size == 0 || chunk_size > available) ? available : chunk_size;
+            data_length -= data_length % format.block_align;
+            return data_length > 0;
+        }
+        offset += 8 + chunk_size;
+    }
+    return false;
+}
+
+void buildWavHeader(const WavFormat& format, uint8_t* header) {
+    memcpy(header, "RIFF", 4);
+    writeLe32(header + 4, 0xFFFFFFFF);
+    memcpy(header + 8, "WAVE", 4);
+    memcpy(header + 12, "fmt ", 4);
+    writeLe32(header + 16, 16);
+    writeLe16(header + 20, format.format);
+    writeLe16(header + 22, format.channels);
+    writeLe32(header + 24, format.sample_rate);
+    writeLe32(header + 28, format.sample_rate * format.block_align);
+    writeLe16(header + 32, format.block_align);
+    writeLe16(header + 34, format.bits);
+    memcpy(header + 36, "data", 4);
+    writeLe32(header + 40, 0xFFFFFFFF);  // Open-ended: ends when the session does
+}
+
+} // namespace
+
+struct TtsPipeline::Session {
+    enum class State : uint8_t { Pending, Synthesizing, Ready, Failed };
+
+    struct Segment {
+        std::string text;
+        State state = State::Pending;
+        PsramVector<uint8_t> audio;
+    };
+
+    uint32_t id = 0;
+    uint32_t started_ms = 0;
+    std::mutex mutex;
+    std::vector<Segment> segments;
+    TtsSegmenter segmenter;
+    size_t next_play = 0;          // Segment the player is on
+    uint8_t workers = 0;
+    bool closed = false;           // No more text will come
+    bool playback_started = false;
+    bool done = false;
+    uint16_t synthesized = 0;
+    uint16_t failed = 0;
+    uint16_t played = 0;
+    uint32_t first_audio_ms = 0;
+    std::atomic<bool> cancelled{false};
+    Synthesizer synthesizer;
+    Player player;
+
+    bool hasPending() const {
+        for (const Segment& segment : segments) {
+            if (segment.state == State::Pending) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/**
+ * @brief The session's segments as one continuous WAV stream
+ */
+class TtsPipeline::SegmentSource : public IDataSource {
+public:
+    SegmentSource(std::shared_ptr<Session> session, const WavFormat& format)
+        : session_(std::move(session)), format_(format) {
+        buildWavHeader(format_, header_);
+    }
+    ~SegmentSource() override { close(); }
+
+    size_t read(void* buffer, size_t size) override;
+
+    bool seek(size_t position) override {
+        // Only the synthetic header is addressable (WavDecoder's chunk walk)
+        if (position == position_) {
+            return true;
+        }
+        if (position <= kWavHeaderBytes && position_ <= kWavHeaderBytes) {
+            position_ = position;
+            return true;
+        }
+        return false;
+    }
+
+    size_t tell() const override { return position_; }
+    size_t size() const override { return SIZE_MAX; }
+    bool open(const char* uri) override { (void)uri; return session_ != nullptr; }
+
+    void close() override {
+        if (!session_) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(session_->mutex);
+            session_->done = true;
+        }
+        session_->cancelled.store(true);  // Nothing left to synthesize for
+        session_.reset();
+    }
+
+    bool is_open() const override { return session_ != nullptr; }
+    bool is_seekable() const override { return false; }
+    SourceType type() const override { return SourceType::HTTP_RESPONSE; }
+    const char* uri() const override { return "tts://pipeline.wav"; }
+
+    void request_stop() override {
+        if (session_) {
+            session_->cancelled.store(true);
+        }
+    }
+
+private:
+    std::shared_ptr<Session> session_;
+    WavFormat format_;
+    uint8_t header_[kWavHeaderBytes];
+    size_t position_ = 0;
+    bool segment_open_ = false;    // segment_offset_/segment_end_ are valid for next_play
+    size_t segment_offset_ = 0;
+    size_t segment_end_ = 0;
+};
+
+size_t TtsPipeline::SegmentSource::read(void* buffer, size_t size) {
+    if (!session_ || !buffer) {
+        return 0;
+    }
+
+    uint8_t* out = static_cast<uint8_t*>(buffer);
+    size_t total = 0;
+    uint32_t wait_start = millis();
+    Session& session = *session_;
+
+    while (total < size) {
+        if (position_ < kWavHeaderBytes) {
+            const size_t n = std::min(size - total, kWavHeaderBytes - position_);
+            memcpy(out + total, header_ + position_, n);
+            position_ += n;
+            total += n;
+            continue;
+        }
+        if (session.cancelled.load()) {
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(session.mutex);
+        if (session.next_play >= session.segments.size()) {
+            if (session.closed) {
+                break;  // All segments played
+            }
+        } else {
+            Session::Segment& segment = session.segments[session.next_play];
+            if (segment.state == Session::State::Failed) {
+                ++session.next_play;
+                continue;
+            }
+            if (segment.state == Session::State::Ready) {
+                if (!segment_open_) {
+                    WavFormat format;
+                    size_t data_length = 0;
+                    if (!parseWav(segment.audio, format, segment_offset_, data_length) || format != format_) {
+                        Logger::getInstance().warnf("[TtsPipeline] Skipping segment %u (unsupported or mismatched audio)",
+                                                    (unsigned)session.next_play);
+                        PsramVector<uint8_t>().swap(segment.audio);
+                        segment.state = Session::State::Failed;
+                        ++session.next_play;
+                        continue;
+                    }
+                    segment_end_ = segment_offset_ + data_length;
+                    segment_open_ = true;
+                }
+
+                const size_t n = std::min(size - total, segment_end_ - segment_offset_);
+                memcpy(out + total, segment.audio.data() + segment_offset_, n);
+                segment_offset_ += n;
+                position_ += n;
+                total += n;
+                wait_start = millis();
+
+                if (segment_offset_ >= segment_end_) {
+                    PsramVector<uint8_t>().swap(segment.audio);
+                    segment_open_ = false;
+                    ++session.played;
+                    ++session.next_play;
+                }
+                continue;
+            }
+        }
+        lock.unlock();
+
+        // Next segment still being written or synthesized
+        if (millis() - wait_start > kSegmentWaitMs) {
+            Logger::getInstance().warnf("[TtsPipeline] No segment for %u ms, ending playback", (unsigned)kSegmentWaitMs);
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(kReadPollMs));
+    }
+
+    if (total < size) {
+        std::lock_guard<std::mutex> lock(session.mutex);
+        session.done = true;
+    }
+    return total;
+}
+
+TtsPipeline& TtsPipeline::getInstance() {
+    static TtsPipeline instance;
+    return instance;
+}
+
+void TtsPipeline::setBackend(Synthesizer synthesizer, Player player) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    synthesizer_ = std::move(synthesizer);
+    player_ = std::move(player);
+}
+
+uint32_t TtsPipeline::start() {
+    auto session = std::make_shared<Session>();
+    session->started_ms = millis();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (session_) {
+        session_->cancelled.store(true);
+    }
+    session->id = next_session_id_++;
+    session->synthesizer = synthesizer_;
+    session->player = player_;
+    session_ = session;
+    return session->id;
+}
+
+void TtsPipeline::update(const std::string& text) {
+    queueText(text, false);
+}
+
+void TtsPipeline::finish(const std::string& text) {
+    bool need_session;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        need_session = !session_ || session_->closed;
+    }
+    if (need_session) {
+        start();
+    }
+    queueText(text, true);
+}
+
+uint32_t TtsPipeline::speak(const std::string& text) {
+    const uint32_t id = start();
+    queueText(text, true);
+    return id;
+}
+
+void TtsPipeline::cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (session_ && !session_->cancelled.load()) {
+        session_->cancelled.store(true);
+        Logger::getInstance().infof("[TtsPipeline] Session %u cancelled", (unsigned)session_->id);
+    }
+}
+
+bool TtsPipeline::isActive() const {
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        session = session_;
+    }
+    if (!session || session->cancelled.load()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(session->mutex);
+    return !session->done;
+}
+
+TtsPipeline::Stats TtsPipeline::getStats() const {
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        session = session_;
+    }
+    Stats stats;
+    if (!session) {
+        return stats;
+    }
+    std::lock_guard<std::mutex> lock(session->mutex);
+    stats.session = session->id;
+    stats.segments = static_cast<uint16_t>(session->segments.size());
+    stats.synthesized = session->synthesized;
+    stats.failed = session->failed;
+    stats.played = session->played;
+    stats.first_audio_ms = session->first_audio_ms;
+    stats.active = !session->done && !session->cancelled.load();
+    return stats;
+}
+
+void TtsPipeline::queueText(const std::string& text, bool final) {
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        session = session_;
+    }
+    if (!session || session->cancelled.load()) {
+        return;
+    }
+
+    std::vector<std::string> pieces;
+    std::lock_guard<std::mutex> lock(session->mutex);
+    if (session->closed) {
+        return;
+    }
+    if (final) {
+        session->segmenter.finish(text, pieces);
+        session->closed = true;
+    } else {
+        session->segmenter.update(text, pieces);
+    }
+
+    for (std::string& piece : pieces) {
+        Logger::getInstance().infof("[TtsPipeline] Segment %u queued (%u chars)",
+                                    (unsigned)session->segments.size(), (unsigned)piece.size());
+        Session::Segment segment;
+        segment.text = std::move(piece);
+        session->segments.push_back(std::move(segment));
+    }
+
+    if (session->closed && session->segments.empty()) {
+        session->done = true;  // Nothing to say
+        return;
+    }
+    spawnWorkers(session);
+}
+
+// Called with session->mutex held
+void TtsPipeline::spawnWorkers(const std::shared_ptr<Session>& session) {
+    size_t pending = 0;
+    for (const Session::Segment& segment : session->segments) {
+        if (segment.state == Session::State::Pending) {
+            ++pending;
+        }
+    }
+
+    while (session->workers < kMaxInFlight && session->workers < pending) {
+        auto* ref = new std::shared_ptr<Session>(session);
+        BaseType_t result = xTaskCreatePinnedToCore(
+            workerEntry, "tts_worker", TaskConfig::STACK_TTS_WORKER,
+            ref, TaskConfig::PRIO_TTS_WORKER, nullptr, TaskConfig::CORE_TTS_WORKER);
+        if (result != pdPASS) {
+            delete ref;
+            Logger::getInstance().error("[TtsPipeline] Failed to create worker task");
+            break;
+        }
+        ++session->workers;
+    }
+}
+
+void TtsPipeline::workerEntry(void* param) {
+    auto* ref = static_cast<std::shared_ptr<Session>*>(param);
+    runWorker(*ref);
+    delete ref;
+    vTaskDelete(nullptr);
+}
+
+void TtsPipeline::runWorker(const std::shared_ptr<Session>& session) {
+    for (;;) {
+        size_t index = 0;
+        std::string text;
+        {
+            std::unique_lock<std::mutex> lock(session->mutex);
+            bool found = false;
+            if (!session->cancelled.load()) {
+                const size_t window_end = std::min(session->segments.size(), session->next_play + kMaxAhead);
+                for (size_t i = session->next_play; i < window_end; ++i) {
+                    if (session->segments[i].state == Session::State::Pending) {
+                        index = i;
+                        found = true;
+                        break;
+                    }
+                }
+            }
+
+            if (!found) {
+                if (session->cancelled.load() || !session->hasPending()) {
+                    // Exit decision and worker count change under the same lock as queueText()
+                    if (--session->workers == 0 && !session->playback_started &&
+                        (session->closed || session->cancelled.load()) && !session->hasPending()) {
+                        session->done = true;  // Every segment failed
+                    }
+                    return;
+                }
+                lock.unlock();
+                vTaskDelay(pdMS_TO_TICKS(kWorkerIdleMs));  // Too far ahead of playback
+                continue;
+            }
+
+            session->segments[index].state = Session::State::Synthesizing;
+            text = session->segments[index].text;
+        }
+
+        PsramVector<uint8_t> audio;
+        const bool ok = session->synthesizer && session->synthesizer(text, audio, &session->cancelled);
+
+        bool start_playback = false;
+        {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            Session::Segment& segment = session->segments[index];
+            if (ok && !session->cancelled.load()) {
+                segment.audio = std::move(audio);
+                segment.state = Session::State::Ready;
+                ++session->synthesized;
+            } else {
+                segment.state = Session::State::Failed;
+                ++session->failed;
+            }
+
+            if (!session->playback_started && !session->cancelled.load()) {
+                // Play once the earliest segment that did not fail is ready
+                for (const Session::Segment& candidate : session->segments) {
+                    if (candidate.state == Session::State::Failed) {
+                        continue;
+                    }
+                    start_playback = candidate.state == Session::State::Ready;
+                    break;
+                }
+                session->playback_started = start_playback;
+            }
+        }
+
+        if (start_playback) {
+            startPlayback(session);
+        }
+    }
+}
+
+void TtsPipeline::startPlayback(const std::shared_ptr<Session>& session) {
+    auto& logger = Logger::getInstance();
+
+    WavFormat format;
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        for (size_t i = session->next_play; i < session->segments.size(); ++i) {
+            Session::Segment& segment = session->segments[i];
+            if (segment.state != Session::State::Ready) {
+                break;
+            }
+            size_t data_offset = 0;
+            size_t data_length = 0;
+            if (parseWav(segment.audio, format, data_offset, data_length) &&
+                (format.format == 1 || format.format == 3)) {
+                found = true;
+                break;
+            }
+            logger.warnf("[TtsPipeline] Segment %u is not PCM WAV, skipping", (unsigned)i);
+            PsramVector<uint8_t>().swap(segment.audio);
+            segment.state = Session::State::Failed;
+            session->next_play = i + 1;
+        }
+        if (!found) {
+            session->playback_started = false;  // Let the next ready segment retry
+            return;
+        }
+    }
+
+    std::unique_ptr<IDataSource> source(new SegmentSource(session, format));
+    if (!session->player || !session->player(std::move(source), format.sample_rate)) {
+        logger.error("[TtsPipeline] Failed to start playback");
+        session->cancelled.store(true);
+        std::lock_guard<std::mutex> lock(session->mutex);
+        session->done = true;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(session->mutex);
+    session->first_audio_ms = millis() - session->started_ms;
+    logger.infof("[TtsPipeline] Session %u playing after %u ms (%u Hz, %u ch)",
+                 (unsigned)session->id, (unsigned)session->first_audio_ms,
+                 (unsigned)format.sample_rate, (unsigned)format.channels);
+}
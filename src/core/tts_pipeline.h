@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "utils/psram_allocator.h"
+
+class IDataSource;
+
+/**
+ * @brief Sentence-pipelined speech output
+ *
+ * A session takes reply text (all at once or cumulatively while the LLM is still
+ * streaming), splits it with TtsSegmenter and synthesizes the segments on up to
+ * kMaxInFlight worker tasks, at most kMaxAhead segments ahead of playback.
+ *
+ * Playback starts as soon as the first segment is synthesized. All segments are
+ * served to the player as ONE open-ended WAV stream (header from the first
+ * segment, then the PCM of each segment in order), so there is no player
+ * restart and no gap between sentences. Segments whose format differs from the
+ * first one, or that failed to synthesize, are skipped.
+ *
+ * Starting a new session, cancel(), or anything else stopping the player
+ * cancels the session: pending segments are dropped and in-flight downloads
+ * are abandoned.
+ *
+ * Synthesis and playback go through the backend installed with setBackend()
+ * (VoiceAssistant's TTS endpoint and AudioManager on the device); each session
+ * keeps the backend it was started with.
+ */
+class TtsPipeline {
+public:
+    static constexpr uint8_t kMaxInFlight = 2;         // Concurrent TTS requests
+    static constexpr uint8_t kMaxAhead = 3;            // Synthesized segments waiting to be played
+    static constexpr uint32_t kSegmentWaitMs = 20000;  // Player stall tolerated while the next segment is produced
+
+    struct Stats {
+        uint32_t session = 0;
+        uint16_t segments = 0;          // Queued so far
+        uint16_t synthesized = 0;
+        uint16_t failed = 0;
+        uint16_t played = 0;
+        uint32_t first_audio_ms = 0;    // Session start to playback start (0 = not yet)
+        bool active = false;
+    };
+
+    /** Synthesize one segment into a WAV; the flag is set once the session is abandoned */
+    using Synthesizer = std::function<bool(const std::string& text, PsramVector<uint8_t>& audio,
+                                           const std::atomic<bool>* cancel)>;
+    /** Start playing the session's WAV stream */
+    using Player = std::function<bool(std::unique_ptr<IDataSource> source, uint32_t sample_rate)>;
+
+    static TtsPipeline& getInstance();
+
+    /** Install the TTS endpoint and the player used by sessions started from now on */
+    void setBackend(Synthesizer synthesizer, Player player);
+
+    /**
+     * @brief Start a new session, cancelling the previous one
+     * @return Session id
+     */
+    uint32_t start();
+
+    /** Feed the cumulative reply text; complete sentences are queued immediately */
+    void update(const std::string& text);
+
+    /** Final reply text: queue the remainder and close the session (starts one if needed) */
+    void finish(const std::string& text);
+
+    /** One-shot: start() + finish(text) */
+    uint32_t speak(const std::string& text);
+
+    /** Drop pending segments and end playback of the current session */
+    void cancel();
+
+    /** A session is synthesizing or playing */
+    bool isActive() const;
+
+    Stats getStats() const;
+
+private:
+    TtsPipeline() = default;
+    ~TtsPipeline() = default;
+    TtsPipeline(const TtsPipeline&) = delete;
+    TtsPipeline& operator=(const TtsPipeline&) = delete;
+
+    struct Session;
+    class SegmentSource;
+
+    void queueText(const std::string& text, bool final);
+    static void spawnWorkers(const std::shared_ptr<Session>& session);
+    static void workerEntry(void* param);
+    static void runWorker(const std::shared_ptr<Session>& session);
+    static void startPlayback(const std::shared_ptr<Session>& session);
+
+    std::shared_ptr<Session> session_;
+    Synthesizer synthesizer_;
+    Player player_;
+    mutable std::mutex mutex_;
+    uint32_t next_session_id_ = 1;
+};
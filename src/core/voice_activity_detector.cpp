@@ -0,0 +1,226 @@
+#include "voice_activity_detector.h"
+
+#include <algorithm>
+
+VoiceActivityDetector::VoiceActivityDetector() {
+    configure(Config());
+}
+
+VoiceActivityDetector::VoiceActivityDetector(const Config& config) {
+    configure(config);
+}
+
+void VoiceActivityDetector::configure(const Config& config) {
+    config_ = config;
+    if (config_.sample_rate == 0) {
+        config_.sample_rate = 16000;
+    }
+    if (config_.frame_samples == 0) {
+        config_.frame_samples = 256;
+    }
+    onset_required_ = std::max<uint32_t>(1, msToFrames(config_.onset_ms));
+    hangover_frames_ = std::max<uint32_t>(1, msToFrames(config_.hangover_ms));
+    stationary_required_ = std::max<uint32_t>(1, msToFrames(config_.stationary_ms));
+    segments_.reserve(kMaxSegments);
+    reset();
+}
+
+void VoiceActivityDetector::reset() {
+    segments_.clear();
+    energy_acc_ = 0;
+    zero_crossings_ = 0;
+    frame_fill_ = 0;
+    last_negative_ = false;
+    noise_floor_ = 0;
+    floor_initialized_ = false;
+    in_speech_ = false;
+    onset_frames_ = 0;
+    onset_start_sample_ = 0;
+    hangover_left_ = 0;
+    stationary_level_ = 0;
+    stationary_frames_ = 0;
+    last_speech_end_ = 0;
+    processed_samples_ = 0;
+}
+
+uint32_t VoiceActivityDetector::msToFrames(uint16_t ms) const {
+    const uint32_t frame_samples = config_.frame_samples;
+    const uint32_t samples = (static_cast<uint32_t>(ms) * config_.sample_rate) / 1000;
+    return (samples + frame_samples - 1) / frame_samples;
+}
+
+bool VoiceActivityDetector::process(const int16_t* samples, size_t count) {
+    if (!samples || count == 0) {
+        return in_speech_;
+    }
+
+    bool any_speech = false;
+    const uint32_t base = processed_samples_;
+
+    for (size_t i = 0; i < count; ++i) {
+        const int32_t sample = samples[i];
+        energy_acc_ += static_cast<uint32_t>(sample * sample);
+        const bool negative = sample < 0;
+        if (negative != last_negative_) {
+            ++zero_crossings_;
+        }
+        last_negative_ = negative;
+
+        if (++frame_fill_ < config_.frame_samples) {
+            continue;
+        }
+
+        const uint32_t mean_square = static_cast<uint32_t>(energy_acc_ / frame_fill_);
+        const uint16_t zcr_q8 = static_cast<uint16_t>((static_cast<uint32_t>(zero_crossings_) << 8) / frame_fill_);
+        const uint32_t frame_start = base + static_cast<uint32_t>(i) + 1 - frame_fill_;
+
+        if (processFrame(mean_square, zcr_q8, frame_start)) {
+            any_speech = true;
+        }
+
+        energy_acc_ = 0;
+        zero_crossings_ = 0;
+        frame_fill_ = 0;
+    }
+
+    processed_samples_ = base + static_cast<uint32_t>(count);
+    return any_speech;
+}
+
+void VoiceActivityDetector::finish() {
+    if (in_speech_) {
+        closeSegment(last_speech_end_);
+        in_speech_ = false;
+    }
+    onset_frames_ = 0;
+    hangover_left_ = 0;
+}
+
+uint32_t VoiceActivityDetector::silenceSamples() const {
+    if (in_speech_) {
+        return processed_samples_ - last_speech_end_;
+    }
+    if (segments_.empty()) {
+        return processed_samples_;
+    }
+    return processed_samples_ - segments_.back().end_sample;
+}
+
+uint32_t VoiceActivityDetector::silenceMs() const {
+    return static_cast<uint32_t>((static_cast<uint64_t>(silenceSamples()) * 1000) / config_.sample_rate);
+}
+
+bool VoiceActivityDetector::classifyFrame(uint32_t mean_square, uint16_t zcr_q8) const {
+    if (mean_square < config_.min_energy || zcr_q8 > config_.max_zcr_q8) {
+        return false;
+    }
+
+    // Ratios are Q4 so the comparison stays in integer math: energy * 16 > floor * ratio
+    const uint64_t scaled_energy = static_cast<uint64_t>(mean_square) << 4;
+    const uint64_t floor = std::max<uint32_t>(noise_floor_, 1);
+
+    if (scaled_energy > floor * config_.speech_ratio_q4) {
+        return true;
+    }
+    return zcr_q8 >= config_.fricative_zcr_q8 && scaled_energy > floor * config_.weak_ratio_q4;
+}
+
+void VoiceActivityDetector::trackStationarity(uint32_t mean_square, bool speech) {
+    if (!speech) {
+        stationary_frames_ = 0;
+        return;
+    }
+
+    // Syllables swing well beyond 6 dB within a few frames; a fan or a tap does not
+    const uint64_t energy = mean_square;
+    const uint64_t level = stationary_level_;
+    if (stationary_frames_ > 0 && energy * 4 >= level && energy <= level * 4) {
+        ++stationary_frames_;
+        const int64_t delta = static_cast<int64_t>(energy) - static_cast<int64_t>(level);
+        stationary_level_ = static_cast<uint32_t>(static_cast<int64_t>(level) + delta / 8);
+    } else {
+        stationary_frames_ = 1;
+        stationary_level_ = mean_square;
+    }
+}
+
+void VoiceActivityDetector::updateNoiseFloor(uint32_t mean_square, bool speech) {
+    if (!floor_initialized_) {
+        noise_floor_ = std::max<uint32_t>(mean_square, 1);
+        floor_initialized_ = true;
+        return;
+    }
+
+    if (mean_square < noise_floor_) {
+        // Track drops quickly so a loud first frame does not mask the real floor
+        noise_floor_ -= (noise_floor_ - mean_square) >> 2;
+    } else if (!speech) {
+        noise_floor_ += (mean_square - noise_floor_) >> 6;
+    } else if (stationary_frames_ >= stationary_required_) {
+        // Steady for longer than any utterance holds a level: a new noise source
+        noise_floor_ += (mean_square - noise_floor_) >> 4;
+    } else {
+        // Creep up very slowly during real speech so its energy does not raise the floor
+        noise_floor_ += (mean_square - noise_floor_) >> 11;
+    }
+
+    if (noise_floor_ == 0) {
+        noise_floor_ = 1;
+    }
+}
+
+bool VoiceActivityDetector::processFrame(uint32_t mean_square, uint16_t zcr_q8, uint32_t frame_start) {
+    const bool raw_speech = classifyFrame(mean_square, zcr_q8);
+    const uint32_t frame_end = frame_start + config_.frame_samples;
+    trackStationarity(mean_square, raw_speech || in_speech_);
+    updateNoiseFloor(mean_square, raw_speech || in_speech_);
+
+    if (!in_speech_) {
+        if (!raw_speech) {
+            onset_frames_ = 0;
+            return false;
+        }
+        if (onset_frames_ == 0) {
+            onset_start_sample_ = frame_start;
+        }
+        last_speech_end_ = frame_end;
+        if (++onset_frames_ < onset_required_) {
+            return false;
+        }
+        in_speech_ = true;
+        hangover_left_ = hangover_frames_;
+        openSegment(onset_start_sample_);
+        return true;
+    }
+
+    if (raw_speech) {
+        last_speech_end_ = frame_end;
+        hangover_left_ = hangover_frames_;
+        return true;
+    }
+
+    if (hangover_left_ > 0 && --hangover_left_ > 0) {
+        return true;
+    }
+
+    in_speech_ = false;
+    onset_frames_ = 0;
+    closeSegment(last_speech_end_);
+    return true;
+}
+
+void VoiceActivityDetector::openSegment(uint32_t start_sample) {
+    if (segments_.size() < kMaxSegments) {
+        Segment segment;
+        segment.start_sample = start_sample;
+        segment.end_sample = start_sample;
+        segments_.push_back(segment);
+    }
+    // When the table is full the last segment is simply extended by closeSegment()
+}
+
+void VoiceActivityDetector::closeSegment(uint32_t end_sample) {
+    if (!segments_.empty()) {
+        segments_.back().end_sample = std::max(segments_.back().end_sample, end_sample);
+    }
+}
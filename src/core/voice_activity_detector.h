@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Streaming fixed-point Voice Activity Detector
+ *
+ * Classifies fixed-size PCM frames as speech or non-speech using:
+ * - Mean-square frame energy compared against an adaptive noise floor
+ * - Zero-crossing rate (ZCR) to accept weak unvoiced onsets (s, f, z)
+ * - Onset confirmation and hangover so words are not chopped
+ * - Stationarity: energy that stays within 6 dB for longer than a sustained
+ *   vowel is a new noise source, and the floor rises quickly to learn it
+ *
+ * Integer arithmetic only, no frame buffering: samples are accumulated as
+ * they arrive, so it can run directly inside the real-time capture loop.
+ */
+class VoiceActivityDetector {
+public:
+    /**
+     * @brief Detector tuning parameters
+     */
+    struct Config {
+        uint32_t sample_rate = 16000;
+        uint16_t frame_samples = 256;       // 16 ms @ 16 kHz
+        uint16_t speech_ratio_q4 = 64;      // energy > floor * 4.0 (Q4) => speech
+        uint16_t weak_ratio_q4 = 32;        // energy > floor * 2.0 (Q4) + fricative ZCR => speech
+        uint16_t fricative_zcr_q8 = 64;     // ZCR >= 0.25 crossings/sample (Q8)
+        uint16_t max_zcr_q8 = 200;          // ZCR above ~0.78 is treated as broadband noise
+        uint32_t min_energy = 10000;        // Absolute mean-square floor (~-50 dBFS)
+        uint16_t onset_ms = 48;             // Consecutive speech required to open a segment
+        uint16_t hangover_ms = 320;         // Silence tolerated before closing a segment
+        uint16_t stationary_ms = 1000;      // Steady "speech" this long is learned as noise
+    };
+
+    /**
+     * @brief Speech segment expressed in samples since reset()
+     */
+    struct Segment {
+        uint32_t start_sample = 0;
+        uint32_t end_sample = 0;
+    };
+
+    static constexpr size_t kMaxSegments = 32;
+
+    VoiceActivityDetector();
+    explicit VoiceActivityDetector(const Config& config);
+
+    /**
+     * @brief Reset state and apply a new configuration
+     */
+    void configure(const Config& config);
+
+    /**
+     * @brief Clear all runtime state (noise floor, segments, counters)
+     */
+    void reset();
+
+    /**
+     * @brief Feed a block of mono 16-bit samples
+     * @return true if any completed frame in the block was inside a speech segment
+     *         (including onset and hangover frames)
+     */
+    bool process(const int16_t* samples, size_t count);
+
+    /**
+     * @brief Close a segment that is still open (call once the stream ends)
+     */
+    void finish();
+
+    bool isSpeech() const { return in_speech_; }
+    bool hasDetectedSpeech() const { return in_speech_ || !segments_.empty(); }
+
+    /**
+     * @brief Samples elapsed since the last frame classified as speech
+     *        (0 while speech is ongoing, total samples if none was ever seen)
+     */
+    uint32_t silenceSamples() const;
+    uint32_t silenceMs() const;
+
+    uint32_t processedSamples() const { return processed_samples_; }
+    uint32_t noiseFloor() const { return noise_floor_; }
+    const std::vector<Segment>& segments() const { return segments_; }
+
+private:
+    bool processFrame(uint32_t mean_square, uint16_t zcr_q8, uint32_t frame_start);
+    bool classifyFrame(uint32_t mean_square, uint16_t zcr_q8) const;
+    void trackStationarity(uint32_t mean_square, bool speech);
+    void updateNoiseFloor(uint32_t mean_square, bool speech);
+    void openSegment(uint32_t start_sample);
+    void closeSegment(uint32_t end_sample);
+    uint32_t msToFrames(uint16_t ms) const;
+
+    Config config_;
+    std::vector<Segment> segments_;
+
+    // Frame accumulator
+    uint64_t energy_acc_ = 0;
+    uint16_t zero_crossings_ = 0;
+    uint16_t frame_fill_ = 0;
+    bool last_negative_ = false;
+
+    // Detector state
+    uint32_t noise_floor_ = 0;
+    bool floor_initialized_ = false;
+    bool in_speech_ = false;
+    uint32_t onset_frames_ = 0;
+    uint32_t onset_start_sample_ = 0;
+    uint32_t hangover_left_ = 0;
+    uint32_t onset_required_ = 1;
+    uint32_t hangover_frames_ = 1;
+    uint32_t stationary_required_ = 1;
+    uint32_t stationary_level_ = 0;
+    uint32_t stationary_frames_ = 0;
+    uint32_t last_speech_end_ = 0;
+    uint32_t processed_samples_ = 0;
+};
@@ -2,15 +2,37 @@
 #include "core/settings_manager.h"
 #include "core/audio_manager.h"
 #include "core/microphone_manager.h"
+#include "core/wake_word_service.h"
+#include "core/http_response_source.h"
+#include "core/tts_cache.h"
+#include "core/lua_bytecode_cache.h"
+#include "core/lua_events.h"
+#include "core/lua_sandbox_pool.h"
+#include "core/lua_scheduler.h"
+#include "core/async_request_manager.h"
+#include "core/cancel_token.h"
 #include "core/command_center.h"
+#include "core/command_plan_executor.h"
+#include "core/event_router.h"
+#include "core/intent_matcher.h"
+#include "core/response_templates.h"
 #include "core/conversation_buffer.h"
+#include "core/conversation_context.h"
+#include "core/http_client_pool.h"
 #include "core/ble_hid_manager.h"
 #include "core/web_data_manager.h"
 #include "core/memory_manager.h"
 #include "peripheral/gpio_manager.h"
 #include "utils/logger.h"
+#include "utils/ima_adpcm_encoder.h"
+#include "utils/json_path_extractor.h"
+#include "utils/json_writer.h"
+#include "utils/prompt_template.h"
 #include <esp_http_client.h>
 #include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <freertos/stream_buffer.h>
+#include <algorithm>
 #include <cstring>
 #include <sstream>
 #include <WiFi.h>
@@ -34,19 +56,6 @@ constexpr const char* TAG = "VoiceAssistant";
 #define LOG_E(format, ...) Logger::getInstance().errorf("[VoiceAssistant] " format, ##__VA_ARGS__)
 #define LOG_W(format, ...) Logger::getInstance().warnf("[VoiceAssistant] " format, ##__VA_ARGS__)
 
-// Unified request structure for independent API
-struct UnifiedRequest {
-    std::string request_id;
-    VoiceAssistant::RequestType type;
-    VoiceAssistant::RequestStatus status;
-    std::string input;  // audio file, text, command name, etc.
-    std::vector<std::string> args;  // for commands
-    VoiceAssistant::RequestResult result;
-    uint64_t created_at_ms;
-    uint64_t started_at_ms;
-    uint64_t completed_at_ms;
-};
-
 // Task priorities and stack sizes
 constexpr UBaseType_t RECORDING_TASK_PRIORITY = 4;
 
@@ -54,7 +63,8 @@ constexpr size_t stackBytesToWords(size_t bytes) {
     return (bytes + sizeof(StackType_t) - 1) / sizeof(StackType_t);
 }
 
-constexpr size_t RECORDING_TASK_STACK = stackBytesToWords(4096);
+// Recording task also drives the streaming Whisper upload (HTTP/TLS) when enabled
+constexpr size_t RECORDING_TASK_STACK = stackBytesToWords(6 * 1024);
 constexpr UBaseType_t STT_TASK_PRIORITY = 3;
 constexpr size_t STT_TASK_STACK = stackBytesToWords(4096);  // 4KB stack - keep stack small, use heap for buffers
 constexpr UBaseType_t AI_TASK_PRIORITY = 3;
@@ -74,9 +84,206 @@ constexpr const char* GPT_ENDPOINT = "https://api.openai.com/v1/chat/completions
 // Recording config - unlimited duration (controlled by button press/release)
 constexpr uint32_t RECORDING_DURATION_SECONDS = 0;
 
+// VAD: stop once the user stops talking instead of waiting for the button release
+constexpr uint16_t RECORDING_VAD_END_SILENCE_MS = 900;
+constexpr uint16_t RECORDING_VAD_NO_SPEECH_TIMEOUT_MS = 8000;
+
 // Assistant recordings directory (separate from test recordings)
 constexpr const char* ASSISTANT_RECORDINGS_DIR = "/assistant_recordings";
 
+// Streaming STT: capture ring between MicrophoneManager and the uploader (~4 s of 16 kHz mono)
+constexpr size_t STT_STREAM_BUFFER_BYTES = 128 * 1024;
+constexpr size_t STT_STREAM_CHUNK_BYTES = 4096;
+
+// Streaming LLM: esp_http_client_read() only returns once the buffer is full, so keep
+// reads about one SSE delta long to hand each token to the parser as soon as it lands
+constexpr size_t LLM_STREAM_READ_BYTES = 64;
+
+// Error response bodies are only logged: keep at most this much of them
+constexpr size_t ERROR_BODY_LOG_BYTES = 4096;
+
+// Pooled connection settings per endpoint (the stage names the stats bucket)
+HttpClientPool::Options sttClientOptions() {
+    HttpClientPool::Options options;
+    options.stage = "stt";
+    options.timeout_ms = 30000;  // 30 second timeout
+    return options;
+}
+
+HttpClientPool::Options llmClientOptions() {
+    HttpClientPool::Options options;
+    options.stage = "llm";
+    options.timeout_ms = 90000;  // 90 seconds - local LLMs can be slow
+    options.buffer_size = 16384;
+    options.buffer_size_tx = 8192;
+    return options;
+}
+
+HttpClientPool::Options ttsClientOptions() {
+    HttpClientPool::Options options;
+    options.stage = "tts";
+    options.timeout_ms = 30000;
+    return options;
+}
+
+// Whisper multipart/form-data layout (shared by file-based and streaming uploads)
+constexpr const char* WHISPER_MULTIPART_BOUNDARY = "----WebKitFormBoundary7MA4YWxkTrZu0gW";
+
+std::string buildWhisperFileHeader() {
+    return std::string("--") + WHISPER_MULTIPART_BOUNDARY + "\r\n"
+        "Content-Disposition: form-data; name=\"file\"; filename=\"audio.wav\"\r\n"
+        "Content-Type: audio/wav\r\n\r\n";
+}
+
+std::string buildWhisperTrailer() {
+    return std::string("\r\n--") + WHISPER_MULTIPART_BOUNDARY + "\r\n"
+        "Content-Disposition: form-data; name=\"model\"\r\n\r\n"
+        "whisper-1\r\n"  // For OpenAI compatibility, faster-whisper accepts any model name
+        "--" + WHISPER_MULTIPART_BOUNDARY + "--\r\n";
+}
+
+std::string resolveWhisperEndpoint(const SettingsSnapshot& settings) {
+    return settings.localApiMode ? settings.whisperLocalEndpoint : settings.whisperCloudEndpoint;
+}
+
+bool useAdpcmUpload(const SettingsSnapshot& settings) {
+    const std::string& format = settings.localApiMode ? settings.whisperLocalUploadFormat
+                                                      : settings.whisperCloudUploadFormat;
+    return format == "adpcm";
+}
+
+/**
+ * Re-encode a 16-bit mono PCM WAV (as written by MicrophoneManager) to IMA-ADPCM WAV.
+ * Returns a PSRAM buffer owned by the caller, or nullptr if the input is not suitable.
+ */
+uint8_t* encodeWavToAdpcm(const uint8_t* wav, size_t wav_size, size_t& out_size) {
+    constexpr size_t kPcmHeaderSize = MicrophoneManager::kWavHeaderSize;
+    if (wav_size <= kPcmHeaderSize || memcmp(wav, "RIFF", 4) != 0 || memcmp(wav + 8, "WAVE", 4) != 0 ||
+        memcmp(wav + 36, "data", 4) != 0) {
+        return nullptr;
+    }
+
+    uint16_t format = 0;
+    uint16_t channels = 0;
+    uint16_t bits = 0;
+    uint32_t sample_rate = 0;
+    memcpy(&format, wav + 20, sizeof(format));
+    memcpy(&channels, wav + 22, sizeof(channels));
+    memcpy(&sample_rate, wav + 24, sizeof(sample_rate));
+    memcpy(&bits, wav + 34, sizeof(bits));
+    if (format != 1 || channels != 1 || bits != 16) {
+        return nullptr;
+    }
+
+    const size_t samples = (wav_size - kPcmHeaderSize) / sizeof(int16_t);
+    const size_t payload_capacity = ImaAdpcmEncoder::maxEncodedSize(samples);
+    uint8_t* out = static_cast<uint8_t*>(
+        heap_caps_malloc(ImaAdpcmEncoder::kWavHeaderSize + payload_capacity, MALLOC_CAP_SPIRAM));
+    if (!out) {
+        return nullptr;
+    }
+
+    ImaAdpcmEncoder encoder;
+    uint8_t* payload = out + ImaAdpcmEncoder::kWavHeaderSize;
+    size_t payload_size = encoder.encode(reinterpret_cast<const int16_t*>(wav + kPcmHeaderSize),
+                                         samples, payload, payload_capacity);
+    payload_size += encoder.flush(payload + payload_size, payload_capacity - payload_size);
+    ImaAdpcmEncoder::buildWavHeader(out, sample_rate, payload_size, samples);
+
+    out_size = ImaAdpcmEncoder::kWavHeaderSize + payload_size;
+    return out;
+}
+
+/**
+ * Acquire a pooled Whisper POST client with multipart and auth headers set.
+ * The caller opens it (fixed length or chunked) and releases it to the pool.
+ */
+esp_http_client_handle_t createWhisperClient(const SettingsSnapshot& settings, const std::string& url) {
+    HttpClientPool& pool = HttpClientPool::getInstance();
+    esp_http_client_handle_t client = pool.acquire(url, sttClientOptions());
+    if (!client) {
+        return nullptr;
+    }
+
+    std::string content_type = std::string("multipart/form-data; boundary=") + WHISPER_MULTIPART_BOUNDARY;
+    pool.setHeader(client, "Content-Type", content_type.c_str());
+    pool.setHeader(client, "User-Agent", "ESP32-VoiceAssistant/1.0");
+
+    // Optional: Add API key if using OpenAI cloud (local Whisper doesn't need it)
+    if (!settings.localApiMode && !settings.openAiApiKey.empty()) {
+        std::string auth_header = std::string("Bearer ") + settings.openAiApiKey;
+        pool.setHeader(client, "Authorization", auth_header.c_str());
+    }
+    return client;
+}
+
+bool writeHttpAll(esp_http_client_handle_t client, const char* data, size_t len) {
+    size_t offset = 0;
+    while (offset < len) {
+        int written = esp_http_client_write(client, data + offset, len - offset);
+        if (written <= 0) {
+            return false;
+        }
+        offset += written;
+    }
+    return true;
+}
+
+/**
+ * Stream the rest of a response body into extractor when the status is 200;
+ * otherwise keep up to ERROR_BODY_LOG_BYTES of it in error_body for the log.
+ * Returns the body size.
+ */
+size_t readJsonResponse(esp_http_client_handle_t client, int status_code,
+                        JsonPathExtractor& extractor, PsramString& error_body) {
+    char chunk[512];
+    size_t total = 0;
+    int read_len = 0;
+    while ((read_len = HttpClientPool::getInstance().read(client, chunk, sizeof(chunk))) > 0) {
+        total += read_len;
+        if (status_code == 200) {
+            extractor.feed(chunk, read_len);
+        } else if (error_body.size() < ERROR_BODY_LOG_BYTES) {
+            error_body.append(chunk, std::min<size_t>(read_len, ERROR_BODY_LOG_BYTES - error_body.size()));
+        }
+    }
+    return total;
+}
+
+/**
+ * Read the Whisper response body of a client whose headers were fetched and
+ * extract {"text": "..."}.
+ */
+bool readWhisperTranscription(esp_http_client_handle_t client, int status_code, int content_length,
+                              std::string& transcription) {
+    // Only {"text": "..."} is kept, the rest (segments of verbose replies) streams past
+    JsonPathExtractor json;
+    json.addPath("text");
+    PsramString error_body;
+    const size_t body_bytes = readJsonResponse(client, status_code, json, error_body);
+
+    LOG_I("HTTP Status: %d, Content-Length: %d", status_code, content_length);
+    LOG_I("Response body: %u bytes", (unsigned)body_bytes);
+
+    if (status_code != 200) {
+        LOG_E("Whisper API returned error status: %d", status_code);
+        LOG_E("Response: %s", error_body.c_str());
+        return false;
+    }
+
+    if (!json.finish()) {
+        LOG_E("Failed to parse JSON response");
+        return false;
+    }
+    if (json.type(0) != JsonPathExtractor::Type::String) {
+        LOG_E("Invalid JSON response format (missing 'text' field)");
+        return false;
+    }
+
+    transcription = json.value(0);
+    return true;
+}
+
 std::string joinArgs(const std::vector<std::string>& args) {
     std::string joined;
     for (size_t i = 0; i < args.size(); ++i) {
@@ -132,6 +339,21 @@ std::string formatConversationEntry(const ConversationEntry& entry) {
     return content;
 }
 
+std::vector<ConversationContext::Turn> toContextTurns(const std::vector<ConversationEntry>& entries) {
+    std::vector<ConversationContext::Turn> turns;
+    turns.reserve(entries.size());
+    for (const auto& entry : entries) {
+        ConversationContext::Turn turn;
+        turn.id = entry.id;
+        turn.role = entry.role == "assistant" ? "assistant" : "user";
+        turn.content = formatConversationEntry(entry);
+        if (!turn.content.empty()) {
+            turns.push_back(std::move(turn));
+        }
+    }
+    return turns;
+}
+
 std::string sanitizePlaceholderName(const std::string& raw) {
     std::string normalized;
     normalized.reserve(raw.size());
@@ -372,6 +594,7 @@ std::string readFileToString(const char* path) {
 std::mutex prompt_definition_mutex;
 VoiceAssistantPromptDefinition prompt_definition_cache;
 bool prompt_definition_loaded = false;
+uint32_t prompt_definition_generation = 0;  // Bumped on every (re)load
 
 bool parsePromptDefinition(const std::string& raw, VoiceAssistantPromptDefinition& definition, std::string& error) {
     definition.prompt_template.clear();
@@ -426,6 +649,22 @@ bool parsePromptDefinition(const std::string& raw, VoiceAssistantPromptDefinitio
                 }
             }
 
+            cJSON* ttl = cJSON_GetObjectItem(cmd_item, "ttl_ms");
+            if (ttl && cJSON_IsNumber(ttl) && ttl->valuedouble > 0) {
+                cmd.ttl_ms = static_cast<uint32_t>(ttl->valuedouble);
+            }
+            cmd.stale_while_revalidate = cJSON_IsTrue(cJSON_GetObjectItem(cmd_item, "stale_while_revalidate"));
+
+            cJSON* events = cJSON_GetObjectItem(cmd_item, "invalidate_on");
+            if (events && cJSON_IsArray(events)) {
+                cJSON* event = nullptr;
+                cJSON_ArrayForEach(event, events) {
+                    if (event && cJSON_IsString(event) && event->valuestring) {
+                        cmd.invalidate_on.emplace_back(event->valuestring);
+                    }
+                }
+            }
+
             if (!cmd.command.empty()) {
                 definition.auto_populate.push_back(std::move(cmd));
             }
@@ -455,10 +694,27 @@ VoiceAssistantPromptDefinition getPromptDefinition(bool force_reload = false) {
     if (!prompt_definition_loaded || force_reload) {
         prompt_definition_cache = loadPromptDefinitionFromJson();
         prompt_definition_loaded = true;
+        prompt_definition_generation++;
     }
     return prompt_definition_cache;
 }
 
+uint32_t getPromptDefinitionGeneration() {
+    std::lock_guard<std::mutex> lock(prompt_definition_mutex);
+    if (!prompt_definition_loaded) {
+        prompt_definition_cache = loadPromptDefinitionFromJson();
+        prompt_definition_loaded = true;
+        prompt_definition_generation++;
+    }
+    return prompt_definition_generation;
+}
+
+// "{{LUA_API_LIST}}" -> "LUA_API_LIST"
+std::string placeholderName(const char* placeholder) {
+    const std::string text(placeholder);
+    return text.size() > 4 ? text.substr(2, text.size() - 4) : text;
+}
+
 } // namespace
 
 VoiceAssistant& VoiceAssistant::getInstance() {
@@ -500,6 +756,8 @@ bool VoiceAssistant::begin() {
         return false;
     }
 
+    LuaScheduler::getInstance().begin();
+
     // Set initialized_ before creating worker tasks so they don't exit immediately
     initialized_ = true;
 
@@ -530,11 +788,22 @@ bool VoiceAssistant::begin() {
         return false;
     }
 
+    WakeWordService& wake_word = WakeWordService::getInstance();
+    wake_word.setDetectionCallback([this](std::vector<int16_t>&& preroll) {
+        triggerListening(std::move(preroll));
+    });
+    if (!wake_word.begin()) {
+        LOG_W("Wake word listener unavailable, push-to-talk only");
+    }
+
     LOG_I("Voice assistant initialized successfully (using MicrophoneManager)");
     return true;
 }
 
 void VoiceAssistant::end() {
+    WakeWordService::getInstance().end();
+    WakeWordService::getInstance().setDetectionCallback(nullptr);
+
     initialized_ = false;
     if (sttTask_) {
         xTaskNotifyGive(sttTask_);
@@ -590,15 +859,29 @@ bool VoiceAssistant::isInitialized() const {
     return initialized_;
 }
 
-CommandResult VoiceAssistant::executeLuaScript(const std::string& script) {
-    std::lock_guard<std::mutex> lock(lua_mutex_);
-    return lua_sandbox_.execute(script);
+CommandResult VoiceAssistant::executeLuaScript(const std::string& script, LuaScheduler::Source source) {
+    return LuaScheduler::getInstance().run(script, source);
 }
 
-void VoiceAssistant::triggerListening() {
-    LOG_I("Voice assistant manually triggered (bypass wake word)");
-    // TODO: Signal the capture task to start listening
-    // For now, just log the trigger
+void VoiceAssistant::triggerListening(std::vector<int16_t> preroll) {
+    LOG_I("Hands-free listening triggered (%u ms pre-roll)",
+          static_cast<unsigned>(preroll.size() * 1000 / 16000));
+
+    if (!initialized_) {
+        LOG_W("Voice assistant not initialized, ignoring trigger");
+        return;
+    }
+    if (recordingTask_) {
+        LOG_W("Recording already in progress, ignoring trigger");
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pending_preroll_mutex_);
+        pending_preroll_ = std::move(preroll);
+    }
+    hands_free_session_.store(true);
+    startRecording();
 }
 
 void VoiceAssistant::startRecording() {
@@ -608,6 +891,14 @@ void VoiceAssistant::startRecording() {
         LOG_W("Recording already in progress");
         return;
     }
+    if (!hands_free_session_.load()) {
+        // Push-to-talk: never reuse audio left over from a trigger that did not start
+        std::lock_guard<std::mutex> lock(pending_preroll_mutex_);
+        pending_preroll_.clear();
+    }
+
+    // Speaking again abandons the previous turn if it is still waiting on the LLM
+    turn_cancel_.store(true);
 
     // Reset stop flag
     stop_recording_flag_.store(false);
@@ -616,12 +907,35 @@ void VoiceAssistant::startRecording() {
         last_recorded_file_.clear();
     }
 
+    // Connect to the endpoints while the user speaks
+    prewarmConnections();
+
     // Create recording task (lightweight wrapper around MicrophoneManager)
     xTaskCreatePinnedToCore(
         recordingTask, "voice_recording", RECORDING_TASK_STACK,
         this, RECORDING_TASK_PRIORITY, &recordingTask_, tskNO_AFFINITY);
 }
 
+void VoiceAssistant::prewarmConnections() {
+    if (WiFi.status() != WL_CONNECTED) {
+        return;
+    }
+    const SettingsSnapshot& settings = SettingsManager::getInstance().getSnapshot();
+    std::vector<HttpClientPool::PrewarmTarget> targets;
+
+    // A streaming upload opens its own connection as soon as recording starts
+    if (!settings.sttStreamingUpload) {
+        targets.push_back({resolveWhisperEndpoint(settings), sttClientOptions()});
+    }
+    targets.push_back({settings.localApiMode ? settings.llmLocalEndpoint : settings.llmCloudEndpoint,
+                       llmClientOptions()});
+    if (settings.ttsEnabled) {
+        targets.push_back({settings.localApiMode ? settings.ttsLocalEndpoint : settings.ttsCloudEndpoint,
+                           ttsClientOptions()});
+    }
+    HttpClientPool::getInstance().prewarm(std::move(targets));
+}
+
 void VoiceAssistant::stopRecordingAndProcess() {
     LOG_I("Stopping voice recording and starting processing");
 
@@ -649,9 +963,36 @@ void VoiceAssistant::recordingTask(void* param) {
     config.bits_per_sample = 16;
     config.channels = 1;
     config.enable_agc = true;
-    config.level_callback = nullptr;  // No UI updates needed for voice assistant
     config.custom_directory = ASSISTANT_RECORDINGS_DIR;  // Use dedicated assistant recordings directory
     config.filename_prefix = "assistant";  // Use "assistant" prefix for filenames
+    config.enable_vad = true;  // Trim silence and auto-stop at end of speech (smaller upload, earlier STT)
+    config.vad_auto_stop = true;
+    config.vad_trim_silence = true;
+    config.vad_end_silence_ms = RECORDING_VAD_END_SILENCE_MS;
+    config.vad_no_speech_timeout_ms = RECORDING_VAD_NO_SPEECH_TIMEOUT_MS;
+    {
+        std::lock_guard<std::mutex> lock(va->pending_preroll_mutex_);
+        config.preroll = std::move(va->pending_preroll_);
+        va->pending_preroll_.clear();
+    }
+
+    // Streaming STT: upload to Whisper while recording through a PSRAM-backed capture ring
+    const SettingsSnapshot& settings = SettingsManager::getInstance().getSnapshot();
+    StreamBufferHandle_t stream = nullptr;
+    StaticStreamBuffer_t* stream_struct = nullptr;
+    uint8_t* stream_storage = nullptr;
+    if (settings.sttStreamingUpload) {
+        stream_struct = static_cast<StaticStreamBuffer_t*>(heap_caps_malloc(sizeof(StaticStreamBuffer_t), MALLOC_CAP_INTERNAL));
+        stream_storage = static_cast<uint8_t*>(heap_caps_malloc(STT_STREAM_BUFFER_BYTES + 1, MALLOC_CAP_SPIRAM));
+        if (stream_struct && stream_storage) {
+            stream = xStreamBufferCreateStatic(STT_STREAM_BUFFER_BYTES, 1, stream_storage, stream_struct);
+        }
+        if (!stream) {
+            LOG_W("Failed to create STT stream buffer, falling back to file upload");
+        }
+    }
+    config.stream_buffer = stream;
+    config.save_to_file = !stream || settings.sttSaveRecordings;
 
     // Start recording using MicrophoneManager
     auto handle = MicrophoneManager::getInstance().startRecording(
@@ -659,22 +1000,49 @@ void VoiceAssistant::recordingTask(void* param) {
         va->stop_recording_flag_
     );
 
+    MicrophoneManager::RecordingResult result;
+    bool streamed = false;
+    std::string streamed_transcription;
+
+    if (handle) {
+        if (stream) {
+            streamed = va->streamWhisperRequest(handle, stream, config, result, streamed_transcription);
+        } else {
+            // Wait for recording to complete and get result
+            result = MicrophoneManager::getInstance().getRecordingResult(handle);
+        }
+    }
+
+    if (stream) {
+        vStreamBufferDelete(stream);
+    }
+    heap_caps_free(stream_storage);
+    heap_caps_free(stream_struct);
+
     if (!handle) {
         LOG_E("Failed to start recording");
+        va->hands_free_session_.store(false);
         va->recordingTask_ = nullptr;
         va->stop_recording_flag_.store(false);
         vTaskDelete(nullptr);
         return;
     }
 
-    // Wait for recording to complete and get result
-    auto result = MicrophoneManager::getInstance().getRecordingResult(handle);
-
-    if (result.success) {
-        LOG_I("Recording completed successfully: %s (%u bytes, %u ms)",
+    if (streamed) {
+        LOG_I("Recording transcribed while streaming (%u bytes, %u ms)", result.pcm_bytes, result.duration_ms);
+        {
+            std::lock_guard<std::mutex> lock(va->last_recorded_mutex_);
+            va->last_recorded_file_ = result.file_path;
+        }
+        va->publishTranscriptionResult(!streamed_transcription.empty(), streamed_transcription);
+    } else if (result.success && !result.file_path.empty()) {
+        LOG_I("Recording completed successfully: %s (%u bytes, %u ms, %u speech segment(s), %u ms silence trimmed%s)",
               result.file_path.c_str(),
               result.file_size_bytes,
-              result.duration_ms);
+              result.duration_ms,
+              static_cast<unsigned>(result.speech_segments.size()),
+              result.trimmed_ms,
+              result.stopped_by_vad ? ", auto-stopped" : "");
 
         {
             std::lock_guard<std::mutex> lock(va->last_recorded_mutex_);
@@ -692,14 +1060,24 @@ void VoiceAssistant::recordingTask(void* param) {
             xTaskNotifyGive(va->sttTask_);
         }
 
+    } else if (result.success) {
+        // Audio was captured but the streaming upload failed and no file copy was kept
+        LOG_E("Streaming STT failed and no recording file to fall back to");
+        va->publishTranscriptionResult(false, std::string());
     } else {
-        LOG_E("Recording failed");
-        
+        va->hands_free_session_.store(false);
+        const bool no_speech = config.enable_vad && !result.speech_detected;
+        if (no_speech) {
+            LOG_W("No speech detected, skipping STT");
+        } else {
+            LOG_E("Recording failed");
+        }
+
         // Notify UI about failure via voiceCommandQueue
         VoiceCommand* cmd = new VoiceCommand();
         cmd->command = "error";
-        cmd->text = "Errore registrazione audio";
-        cmd->output = "Microphone recording failed";
+        cmd->text = no_speech ? "Nessun parlato rilevato" : "Errore registrazione audio";
+        cmd->output = no_speech ? "No speech detected in recording" : "Microphone recording failed";
         
         if (xQueueSend(va->voiceCommandQueue_, &cmd, pdMS_TO_TICKS(100)) != pdPASS) {
              delete cmd;
@@ -745,33 +1123,44 @@ void VoiceAssistant::speechToTextTask(void* param) {
 
         std::string transcription;
         bool success = va->makeWhisperRequest(queued_file, transcription);
+        va->publishTranscriptionResult(success && !transcription.empty(), transcription);
+    }
 
-        if (success && !transcription.empty()) {
-            LOG_I("STT successful: %s", transcription.c_str());
+    LOG_I("Speech-to-text task ended");
+    vTaskDelete(NULL);
+}
 
-            // Send ONLY to UI layer for autosend decision (LLM processing now controlled by UI)
-            std::string* transcription_copy = new std::string(transcription);
-            if (xQueueSend(va->voiceTranscriptionQueue_, &transcription_copy, pdMS_TO_TICKS(1000)) != pdPASS) {
-                LOG_W("Voice transcription queue full");
-                delete transcription_copy;
-            }
-        } else {
-            LOG_E("STT failed or empty transcription");
-            
-            // Notify UI about STT failure
-            VoiceCommand* cmd = new VoiceCommand();
-            cmd->command = "error";
-            cmd->text = "Errore trascrizione";
-            cmd->output = "Speech to text failed";
-            
-            if (xQueueSend(va->voiceCommandQueue_, &cmd, pdMS_TO_TICKS(100)) != pdPASS) {
-                 delete cmd;
+void VoiceAssistant::publishTranscriptionResult(bool success, const std::string& transcription) {
+    const bool hands_free = hands_free_session_.exchange(false);
+    if (success) {
+        LOG_I("STT successful: %s", transcription.c_str());
+
+        if (hands_free && SettingsManager::getInstance().getAutosendEnabled()) {
+            // No UI is waiting on a wake-word session: go straight to the LLM
+            if (sendTextMessage(transcription)) {
+                return;
             }
         }
-    }
 
-    LOG_I("Speech-to-text task ended");
-    vTaskDelete(NULL);
+        // Send ONLY to UI layer for autosend decision (LLM processing now controlled by UI)
+        std::string* transcription_copy = new std::string(transcription);
+        if (xQueueSend(voiceTranscriptionQueue_, &transcription_copy, pdMS_TO_TICKS(1000)) != pdPASS) {
+            LOG_W("Voice transcription queue full");
+            delete transcription_copy;
+        }
+    } else {
+        LOG_E("STT failed or empty transcription");
+
+        // Notify UI about STT failure
+        VoiceCommand* cmd = new VoiceCommand();
+        cmd->command = "error";
+        cmd->text = "Errore trascrizione";
+        cmd->output = "Speech to text failed";
+
+        if (xQueueSend(voiceCommandQueue_, &cmd, pdMS_TO_TICKS(100)) != pdPASS) {
+             delete cmd;
+        }
+    }
 }
 
 void VoiceAssistant::aiProcessingTask(void* param) {
@@ -779,155 +1168,310 @@ void VoiceAssistant::aiProcessingTask(void* param) {
     LOG_I("AI processing task started");
 
     while (va->initialized_) {
-        // Wait for text to process (from submitLLM or send text message)
+        // Wait for text to process (from the STT task or sendTextMessage)
         std::string* text = nullptr;
         if (xQueueReceive(va->transcriptionQueue_, &text, pdMS_TO_TICKS(1000)) == pdPASS) {
             if (text && !text->empty()) {
-                LOG_I("Processing text with LLM: %s", text->c_str());
-
-                // Call LLM
-                std::string llm_response;
-                bool success = va->makeGPTRequest(*text, llm_response);
-
-                if (success && !llm_response.empty()) {
-                    LOG_I("LLM response received");
-
-                    // Parse command from LLM response
-                    VoiceCommand cmd;
-                    if (va->parseGPTCommand(llm_response, cmd)) {
-                        LOG_I("Command parsed successfully: %s (text: %s)", cmd.command.c_str(), cmd.text.c_str());
-
-                        // Check if this is a Lua script command
-                        bool is_script_command = (cmd.command == "lua_script" ||
-                                                 cmd.command.find("script") != std::string::npos ||
-                                                 (!cmd.args.empty() && cmd.args[0].find("function") != std::string::npos));
-
-                        if (is_script_command) {
-                            // Execute as Lua script
-                            std::string script_content;
-                            if (cmd.command == "lua_script" && !cmd.args.empty()) {
-                                script_content = cmd.args[0];
-                            } else if (!cmd.args.empty()) {
-                                script_content = cmd.args[0];
-                            } else {
-                                script_content = cmd.text;
-                            }
+                va->turn_cancel_.store(false);
+                CancelToken::Scope cancel_scope{CancelToken(&va->turn_cancel_)};
+                VoiceCommand cmd;
+                if (va->processText(*text, cmd)) {
+                    VoiceCommand* cmd_copy = new VoiceCommand(cmd);
+                    if (xQueueSend(va->voiceCommandQueue_, &cmd_copy, pdMS_TO_TICKS(100)) != pdPASS) {
+                        LOG_W("Voice command queue full");
+                        delete cmd_copy;
+                    }
+                }
+            }
+            delete text;
+        } else {
+            // Nothing queued: use the idle time to fold old turns into the summary
+            va->summarizeConversationIfIdle();
+        }
+    }
 
-                            LOG_I("Executing Lua script: %s", script_content.c_str());
-                            CommandResult script_result = va->executeLuaScript(script_content);
+    LOG_I("AI processing task ended");
+    vTaskDelete(NULL);
+}
 
-                            cmd.output = script_result.message;
-                            if (!cmd.output.empty()) {
-                                LOG_I("Lua command output: %s", cmd.output.c_str());
-                            }
+bool VoiceAssistant::processText(const std::string& text, VoiceCommand& response, TextTurn turn) {
+    // One conversation: user and assistant turns are appended to ConversationBuffer in order
+    std::lock_guard<std::mutex> lock(llm_mutex_);
+    const bool record = turn != TextTurn::Detached;
+    if (turn == TextTurn::Record) {
+        ConversationBuffer::getInstance().addUserMessage(text);
+    }
 
-                            if (script_result.success) {
-                                LOG_I("Lua script executed successfully: %s", script_result.message.c_str());
-                                cmd.text = "Script eseguito con successo. Output: " + script_result.message;
-                            } else {
-                                LOG_E("Lua script execution failed: %s", script_result.message.c_str());
-                                cmd.text = "Errore nell'esecuzione dello script: " + script_result.message;
-                            }
+    if (tryLocalIntent(text, response, record)) {
+        return true;
+    }
 
-                            if (script_result.success && !cmd.output.empty()) {
-                                if (!cmd.needs_refinement) {
-                                    cmd.needs_refinement = va->shouldRefineOutput(cmd);
-                                    LOG_I("Using heuristic for refinement decision: %s",
-                                          cmd.needs_refinement ? "true" : "false");
-                                }
+    bool replied = false;
+    LOG_I("Processing text with LLM%s: %s", record ? "" : " (detached)", text.c_str());
+
+    // Prompt variables from the auto_populate commands (cached between turns)
+    populatePromptVariables(getPromptDefinition().auto_populate);
+
+    // Call LLM (partial replies are published while it streams). A detached
+    // request sends the system prompt alone, without the conversation.
+    std::string llm_response;
+    const std::string detached_system = record ? std::string() : getSystemPrompt();
+    if (record) {
+        beginStreamingResponse();
+    }
+    const uint32_t llm_start = millis();
+    bool success = makeGPTRequest(text, llm_response, record, record ? nullptr : &detached_system);
+    const bool cancelled = CancelToken::current().cancelled();
+    if (success && !cancelled) {
+        IntentMatcher::getInstance().recordLlm(millis() - llm_start);
+    }
+
+    if (cancelled) {
+        // Nothing is executed or spoken for an abandoned turn
+        LOG_I("Turn cancelled after %u ms", (unsigned)(millis() - llm_start));
+    } else if (success && !llm_response.empty()) {
+        LOG_I("LLM response received");
+
+        // Parse command from LLM response
+        VoiceCommand cmd;
+        if (parseGPTCommand(llm_response, cmd)) {
+            LOG_I("Command parsed successfully: %s (text: %s)", cmd.command.c_str(), cmd.text.c_str());
+
+            // Check if this is a Lua script command
+            bool is_script_command = (cmd.command == "lua_script" ||
+                                     cmd.command.find("script") != std::string::npos ||
+                                     (!cmd.args.empty() && cmd.args[0].find("function") != std::string::npos));
+
+            if (!cmd.plan.empty()) {
+                // Several commands: independent ones run in parallel, one refinement
+                executeCommandPlan(cmd);
+            } else if (is_script_command) {
+                // Execute as Lua script
+                std::string script_content;
+                if (cmd.command == "lua_script" && !cmd.args.empty()) {
+                    script_content = cmd.args[0];
+                } else if (!cmd.args.empty()) {
+                    script_content = cmd.args[0];
+                } else {
+                    script_content = cmd.text;
+                }
 
-                                if (cmd.needs_refinement) {
-                                    LOG_I("Lua output needs refinement, processing...");
-                                    bool refined = va->refineCommandOutput(cmd);
+                LOG_I("Executing Lua script: %s", script_content.c_str());
+                CommandResult script_result = executeLuaScript(script_content);
 
-                                    if (refined && !cmd.refined_output.empty()) {
-                                        cmd.text = cmd.refined_output;
-                                        LOG_I("Using refined output: %s", cmd.refined_output.c_str());
-                                    } else {
-                                        LOG_W("Refinement failed, using original output");
-                                    }
-                                }
-                            }
+                cmd.output = script_result.message;
+                if (!cmd.output.empty()) {
+                    LOG_I("Lua command output: %s", cmd.output.c_str());
+                }
+
+                if (script_result.success) {
+                    LOG_I("Lua script executed successfully: %s", script_result.message.c_str());
+                    cmd.text = "Script eseguito con successo. Output: " + script_result.message;
+                } else {
+                    LOG_E("Lua script execution failed: %s", script_result.message.c_str());
+                    cmd.text = "Errore nell'esecuzione dello script: " + script_result.message;
+                }
+
+                if (script_result.success && !cmd.output.empty()) {
+                    if (!cmd.needs_refinement) {
+                        cmd.needs_refinement = shouldRefineOutput(cmd);
+                        LOG_I("Using heuristic for refinement decision: %s",
+                              cmd.needs_refinement ? "true" : "false");
+                    }
+
+                    if (cmd.needs_refinement) {
+                        LOG_I("Lua output needs refinement, processing...");
+                        bool refined = refineCommandOutput(cmd);
+
+                        if (refined && !cmd.refined_output.empty()) {
+                            cmd.text = cmd.refined_output;
+                            LOG_I("Using refined output: %s", cmd.refined_output.c_str());
                         } else {
-                            if (cmd.command != "none" && cmd.command != "unknown" && !cmd.command.empty()) {
-                                CommandResult result = CommandCenter::getInstance().executeCommand(cmd.command, cmd.args);
+                            LOG_W("Refinement failed, using original output");
+                        }
+                    }
+                }
+            } else {
+                if (cmd.command != "none" && cmd.command != "unknown" && !cmd.command.empty()) {
+                    CommandResult result = CommandCenter::getInstance().executeCommand(cmd.command, cmd.args);
 
-                                cmd.output = result.message;
-                                if (!cmd.output.empty()) {
-                                    LOG_I("Command output: %s", cmd.output.c_str());
-                                }
+                    cmd.output = result.message;
+                    if (!cmd.output.empty()) {
+                        LOG_I("Command output: %s", cmd.output.c_str());
+                    }
+
+                    if (result.success) {
+                        LOG_I("Command executed successfully: %s", result.message.c_str());
 
-                                if (result.success) {
-                                    LOG_I("Command executed successfully: %s", result.message.c_str());
-
-                                    if (!cmd.output.empty()) {
-                                        if (!cmd.needs_refinement) {
-                                            cmd.needs_refinement = va->shouldRefineOutput(cmd);
-                                            LOG_I("Using heuristic for refinement decision: %s",
-                                                  cmd.needs_refinement ? "true" : "false");
-                                        }
-
-                                        if (cmd.needs_refinement) {
-                                            LOG_I("Command output needs refinement, processing...");
-                                            bool refined = va->refineCommandOutput(cmd);
-
-                                            if (refined && !cmd.refined_output.empty()) {
-                                                cmd.text = cmd.refined_output;
-                                                LOG_I("Using refined output: %s", cmd.refined_output.c_str());
-                                            } else {
-                                                LOG_W("Refinement failed, using original output");
-                                            }
-                                        }
-                                    }
+                        if (!cmd.output.empty()) {
+                            if (!cmd.needs_refinement) {
+                                cmd.needs_refinement = shouldRefineOutput(cmd);
+                                LOG_I("Using heuristic for refinement decision: %s",
+                                      cmd.needs_refinement ? "true" : "false");
+                            }
+
+                            if (cmd.needs_refinement) {
+                                LOG_I("Command output needs refinement, processing...");
+                                bool refined = refineCommandOutput(cmd);
+
+                                if (refined && !cmd.refined_output.empty()) {
+                                    cmd.text = cmd.refined_output;
+                                    LOG_I("Using refined output: %s", cmd.refined_output.c_str());
                                 } else {
-                                    LOG_E("Command execution failed: %s", result.message.c_str());
+                                    LOG_W("Refinement failed, using original output");
                                 }
-                            } else {
-                                LOG_I("No command to execute (conversational response only)");
                             }
                         }
-
-                        va->captureCommandOutputVariables(cmd);
-                        const std::string response_text = cmd.text.empty() ? std::string("Comando elaborato") : cmd.text;
-                        ConversationBuffer::getInstance().addAssistantMessage(response_text,
-                                                                             cmd.command,
-                                                                             cmd.args,
-                                                                             cmd.output,
-                                                                             cmd.refined_output);
-
-                        VoiceCommand* cmd_copy = new VoiceCommand(cmd);
-                        if (xQueueSend(va->voiceCommandQueue_, &cmd_copy, pdMS_TO_TICKS(100)) != pdPASS) {
-                            LOG_W("Voice command queue full");
-                            delete cmd_copy;
-                        }
                     } else {
-                        LOG_E("Failed to parse command from LLM response");
-                        VoiceCommand cmd;
-                        cmd.command = "none";
-                        cmd.text = llm_response;
-                        cmd.args.clear();
-
-                        LOG_I("Using raw LLM response as fallback text");
-                        ConversationBuffer::getInstance().addAssistantMessage(llm_response,
-                                                                             "none",
-                                                                             std::vector<std::string>());
-
-                        VoiceCommand* cmd_copy = new VoiceCommand(cmd);
-                        if (xQueueSend(va->voiceCommandQueue_, &cmd_copy, pdMS_TO_TICKS(100)) != pdPASS) {
-                            LOG_W("Voice command queue full");
-                            delete cmd_copy;
-                        }
+                        LOG_E("Command execution failed: %s", result.message.c_str());
                     }
                 } else {
-                    LOG_E("LLM request failed or empty response");
+                    LOG_I("No command to execute (conversational response only)");
                 }
-                delete text;
             }
+
+            captureCommandOutputVariables(cmd);
+            const std::string response_text = cmd.text.empty() ? std::string("Comando elaborato") : cmd.text;
+            if (record) {
+                ConversationBuffer::getInstance().addAssistantMessage(response_text,
+                                                                     cmd.command,
+                                                                     cmd.args,
+                                                                     cmd.output,
+                                                                     cmd.refined_output);
+            }
+
+            response = cmd;
+            replied = true;
+        } else {
+            LOG_E("Failed to parse command from LLM response");
+            VoiceCommand cmd;
+            cmd.command = "none";
+            cmd.text = llm_response;
+            cmd.args.clear();
+
+            LOG_I("Using raw LLM response as fallback text");
+            if (record) {
+                ConversationBuffer::getInstance().addAssistantMessage(llm_response,
+                                                                     "none",
+                                                                     std::vector<std::string>());
+            }
+
+            response = cmd;
+            replied = true;
         }
+    } else {
+        LOG_E("LLM request failed or empty response");
+    }
+    if (record) {
+        endStreamingResponse();
     }
+    last_llm_activity_ms_ = millis();
+    return replied;
+}
 
-    LOG_I("AI processing task ended");
-    vTaskDelete(NULL);
+void VoiceAssistant::summarizeConversationIfIdle() {
+    static constexpr uint32_t kIdleMs = 8000;          // Quiet time after the last reply
+    static constexpr uint32_t kRetryMs = 60000;        // Back-off after a failed summary request
+    static constexpr size_t kMinPendingTurns = 4;      // Fold at least two exchanges at a time
+    static constexpr size_t kMaxPendingTurns = 16;
+    static constexpr size_t kMaxTurnChars = 600;
+
+    const uint32_t now = millis();
+    if (now - last_llm_activity_ms_ < kIdleMs || (summary_retry_ms_ && now < summary_retry_ms_) ||
+        hands_free_session_.load() || WiFi.status() != WL_CONNECTED) {
+        return;
+    }
+
+    // An async LLM request owns the conversation right now
+    std::unique_lock<std::mutex> llm_lock(llm_mutex_, std::try_to_lock);
+    if (!llm_lock.owns_lock()) {
+        return;
+    }
+
+    const SettingsSnapshot& settings = SettingsManager::getInstance().getSnapshot();
+    const size_t budget = settings.llmContextTokens;
+    if (budget == 0) {
+        return;
+    }
+
+    ConversationBuffer& buffer = ConversationBuffer::getInstance();
+    const ConversationBuffer::Summary summary = buffer.getSummary();
+    ConversationContext::Plan plan = ConversationContext::fit(toContextTurns(buffer.getEntries()), summary, budget);
+    if (plan.pending.size() < kMinPendingTurns) {
+        return;
+    }
+    if (plan.pending.size() > kMaxPendingTurns) {
+        plan.pending.resize(kMaxPendingTurns);
+    }
+
+    // Keep the summary to about a quarter of the history budget
+    const size_t max_words = std::max<size_t>(40, budget / 5);
+    const std::string system_prompt =
+        "You maintain the running summary of a conversation between a user and a voice assistant. "
+        "Reply with the updated summary only: plain text, no JSON, no preamble, at most " +
+        std::to_string(max_words) + " words, in the language of the conversation. Keep names, "
+        "preferences, decisions, open requests and device state; drop greetings and small talk.";
+
+    std::string request = "Current summary: ";
+    request += summary.text.empty() ? "(none)" : summary.text;
+    request += "\n\nNew turns:\n";
+    for (const auto& turn : plan.pending) {
+        request += turn.role + ": ";
+        request.append(turn.content, 0, kMaxTurnChars);
+        request += "\n";
+    }
+
+    const uint32_t start = millis();
+    std::string updated;
+    if (!makeGPTRequest(request, updated, false, &system_prompt) || updated.empty()) {
+        LOG_W("Conversation summary request failed, retrying in %u s", (unsigned)(kRetryMs / 1000));
+        summary_retry_ms_ = millis() + kRetryMs;
+        return;
+    }
+    summary_retry_ms_ = 0;
+
+    const size_t max_chars = max_words * 8;
+    if (updated.size() > max_chars) {
+        const size_t cut = updated.rfind(' ', max_chars);
+        updated.resize(cut == std::string::npos ? max_chars : cut);
+    }
+
+    if (buffer.setSummary(updated, plan.pending.back().id)) {
+        LOG_I("Conversation summary updated: %u turns folded in %u ms (%u bytes, ~%u tokens)",
+              (unsigned)plan.pending.size(), (unsigned)(millis() - start), (unsigned)updated.size(),
+              (unsigned)ConversationContext::estimateTokens(updated));
+    }
+    last_llm_activity_ms_ = millis();
+}
+
+bool VoiceAssistant::tryLocalIntent(const std::string& text, VoiceCommand& response, bool record) {
+    IntentMatcher::Result intent;
+    if (!IntentMatcher::getInstance().match(text, intent)) {
+        return false;
+    }
+
+    const uint32_t start = millis();
+    CommandResult result = runCommand(intent.command, intent.args);
+    IntentMatcher::getInstance().recordLocal(result.success, millis() - start);
+
+    if (!result.success) {
+        LOG_I("Local intent %s failed (%s), falling back to LLM", intent.command.c_str(), result.message.c_str());
+        return false;
+    }
+    LOG_I("Local intent handled: %s (%u ms)", intent.command.c_str(), (unsigned)(millis() - start));
+
+    VoiceCommand cmd(intent.command, intent.args);
+    cmd.transcription = text;
+    cmd.output = result.message;
+    cmd.text = intent.reply.empty() ? result.message
+                                    : IntentGrammar::expand(intent.reply, {{"result", result.message}});
+
+    captureCommandOutputVariables(cmd);
+    if (record) {
+        ConversationBuffer::getInstance().addAssistantMessage(cmd.text, cmd.command, cmd.args, text, cmd.output);
+    }
+    response = cmd;
+    return true;
 }
 
 // HTTP helpers - Whisper STT API
@@ -997,34 +1541,30 @@ bool VoiceAssistant::makeWhisperRequest(const std::string& file_path, std::strin
     LOG_I("File read successfully: %u bytes", bytes_read);
 
     // Get endpoint from settings - support both local and cloud modes
-    std::string whisper_url;
     const SettingsSnapshot& settings = SettingsManager::getInstance().getSnapshot();
-
-    if (settings.localApiMode) {
-        // Local mode: use configured local Whisper endpoint
-        whisper_url = settings.whisperLocalEndpoint;
-        LOG_I("Using LOCAL Whisper API at: %s", whisper_url.c_str());
-    } else {
-        // Cloud mode: use configured cloud Whisper endpoint
-        whisper_url = settings.whisperCloudEndpoint;
-        LOG_I("Using CLOUD Whisper API at: %s", whisper_url.c_str());
+    const std::string whisper_url = resolveWhisperEndpoint(settings);
+    LOG_I("Using %s Whisper API at: %s", settings.localApiMode ? "LOCAL" : "CLOUD", whisper_url.c_str());
+
+    // Compressed upload (IMA-ADPCM, 4:1) for endpoints configured for it
+    if (useAdpcmUpload(settings)) {
+        const uint32_t encode_start_ms = millis();
+        size_t encoded_size = 0;
+        uint8_t* encoded = encodeWavToAdpcm(file_data, file_size, encoded_size);
+        if (encoded) {
+            LOG_I("ADPCM upload: %u -> %u bytes in %u ms",
+                  file_size, encoded_size, static_cast<unsigned>(millis() - encode_start_ms));
+            heap_caps_free(file_data);
+            file_data = encoded;
+            file_size = encoded_size;
+        } else {
+            LOG_W("ADPCM encoding skipped (not 16-bit mono PCM or out of memory), uploading WAV as is");
+        }
     }
 
     // Build multipart/form-data request manually
-    const char* boundary = "----WebKitFormBoundary7MA4YWxkTrZu0gW";
-
-    // Calculate content length for multipart body
-    std::string header_part = std::string("--") + boundary + "\r\n"
-        "Content-Disposition: form-data; name=\"file\"; filename=\"audio.wav\"\r\n"
-        "Content-Type: audio/wav\r\n\r\n";
-
-    std::string model_part = std::string("\r\n--") + boundary + "\r\n"
-        "Content-Disposition: form-data; name=\"model\"\r\n\r\n"
-        "whisper-1\r\n";  // For OpenAI compatibility, faster-whisper accepts any model name
-
-    std::string footer_part = std::string("--") + boundary + "--\r\n";
-
-    size_t total_length = header_part.length() + file_size + model_part.length() + footer_part.length();
+    const std::string header_part = buildWhisperFileHeader();
+    const std::string trailer_part = buildWhisperTrailer();
+    size_t total_length = header_part.length() + file_size + trailer_part.length();
 
     // Verify WiFi connectivity before HTTPS request
     if (!WiFi.isConnected()) {
@@ -1037,20 +1577,7 @@ bool VoiceAssistant::makeWhisperRequest(const std::string& file_path, std::strin
     LOG_I("Configuring HTTP client for URL: %s", whisper_url.c_str());
     LOG_I("Total content length: %u bytes", total_length);
 
-    esp_http_client_config_t config = {};
-    config.url = whisper_url.c_str();
-    config.method = HTTP_METHOD_POST;
-    config.timeout_ms = 30000;  // 30 second timeout
-    config.buffer_size = 4096;
-    config.buffer_size_tx = 4096;
-    // For HTTPS: skip certificate validation (development mode)
-    // For production, set config.cert_pem to a valid root CA certificate
-    // Note: Ensure RTC time is synchronized via NTP for certificate validation
-    config.skip_cert_common_name_check = true;
-    config.use_global_ca_store = false;
-
-    LOG_I("Initializing HTTP client...");
-    esp_http_client_handle_t client = esp_http_client_init(&config);
+    esp_http_client_handle_t client = createWhisperClient(settings, whisper_url);
     if (!client) {
         LOG_E("Failed to initialize HTTP client");
         heap_caps_free(file_data);
@@ -1058,142 +1585,198 @@ bool VoiceAssistant::makeWhisperRequest(const std::string& file_path, std::strin
     }
     LOG_I("HTTP client initialized successfully");
 
-    // Set headers
-    std::string content_type = std::string("multipart/form-data; boundary=") + boundary;
-    esp_http_client_set_header(client, "Content-Type", content_type.c_str());
-    esp_http_client_set_header(client, "User-Agent", "ESP32-VoiceAssistant/1.0");
-    LOG_I("HTTP headers set: Content-Type=%s", content_type.c_str());
+    // Open connection, write multipart header, file data in chunks, then model part and footer
+    LOG_I("Sending multipart body (%u bytes of audio) to %s...", file_size, whisper_url.c_str());
+    auto write_body = [&](esp_http_client_handle_t c) {
+        bool write_ok = writeHttpAll(c, header_part.c_str(), header_part.length());
+        const size_t chunk_size = 4096;
+        size_t offset = 0;
+        while (write_ok && offset < file_size) {
+            if (CancelToken::current().cancelled()) {
+                LOG_I("Upload cancelled at offset %u", offset);
+                return false;
+            }
+            size_t to_write = (file_size - offset) < chunk_size ? (file_size - offset) : chunk_size;
+            write_ok = writeHttpAll(c, reinterpret_cast<const char*>(file_data + offset), to_write);
+            offset += to_write;
+        }
+        if (write_ok) {
+            write_ok = writeHttpAll(c, trailer_part.c_str(), trailer_part.length());
+        }
+        if (!write_ok) {
+            LOG_E("Failed to write multipart body at offset %u", offset);
+        }
+        return write_ok;
+    };
 
-    // Optional: Add API key if using OpenAI cloud (local Whisper doesn't need it)
-    if (!settings.localApiMode && !settings.openAiApiKey.empty()) {
-        std::string auth_header = std::string("Bearer ") + settings.openAiApiKey;
-        esp_http_client_set_header(client, "Authorization", auth_header.c_str());
-        LOG_I("Using API key for cloud authentication");
-    }
+    HttpClientPool& pool = HttpClientPool::getInstance();
+    int content_length = -1;
+    const int status_code = pool.request(client, total_length, write_body, content_length);
+
+    // Free file data buffer (no longer needed)
+    heap_caps_free(file_data);
 
-    // Open connection
-    LOG_I("Opening HTTP connection to %s...", whisper_url.c_str());
-    esp_err_t err = esp_http_client_open(client, total_length);
-    if (err != ESP_OK) {
-        LOG_E("Failed to open HTTP connection: %s (0x%x)", esp_err_to_name(err), err);
-        LOG_E("WiFi status: %d", WiFi.status());
+    if (status_code < 0) {
+        LOG_E("Whisper request failed, WiFi status: %d", WiFi.status());
         LOG_E("Check if server is reachable and port is correct");
-        esp_http_client_cleanup(client);
-        heap_caps_free(file_data);
+        pool.release(client);
         return false;
     }
-    LOG_I("HTTP connection opened successfully");
 
-    // Write multipart body in chunks
-    int written = 0;
+    const bool ok = readWhisperTranscription(client, status_code, content_length, transcription);
+    pool.release(client);
 
-    // Write header part
-    LOG_I("Writing multipart header (%u bytes)...", header_part.length());
-    written = esp_http_client_write(client, header_part.c_str(), header_part.length());
-    if (written < 0) {
-        LOG_E("Failed to write header part");
-        esp_http_client_close(client);
-        esp_http_client_cleanup(client);
-        heap_caps_free(file_data);
-        return false;
+    if (ok) {
+        LOG_I("Transcription: %s", transcription.c_str());
     }
-    LOG_I("Header written successfully");
+    return ok;
+}
 
-    // Write file data in chunks
-    LOG_I("Writing audio file data (%u bytes)...", file_size);
-    const size_t chunk_size = 4096;
-    size_t offset = 0;
-    while (offset < file_size) {
-        size_t to_write = (file_size - offset) < chunk_size ? (file_size - offset) : chunk_size;
-        written = esp_http_client_write(client, (char*)(file_data + offset), to_write);
-        if (written < 0) {
-            LOG_E("Failed to write file data at offset %u", offset);
-            esp_http_client_close(client);
-            esp_http_client_cleanup(client);
-            heap_caps_free(file_data);
-            return false;
-        }
-        offset += written;
-    }
-    LOG_I("Audio file data written successfully (%u bytes)", offset);
+bool VoiceAssistant::streamWhisperRequest(MicrophoneManager::RecordingHandle handle,
+                                          StreamBufferHandle_t stream,
+                                          const MicrophoneManager::RecordingConfig& recording_config,
+                                          MicrophoneManager::RecordingResult& result,
+                                          std::string& transcription) {
+    LOG_I("Making Whisper STT request (streaming while recording)");
 
-    // Write model part
-    written = esp_http_client_write(client, model_part.c_str(), model_part.length());
-    if (written < 0) {
-        LOG_E("Failed to write model part");
-        esp_http_client_close(client);
-        esp_http_client_cleanup(client);
-        heap_caps_free(file_data);
+    MicrophoneManager& mic = MicrophoneManager::getInstance();
+    const SettingsSnapshot& settings = SettingsManager::getInstance().getSnapshot();
+    const std::string whisper_url = resolveWhisperEndpoint(settings);
+
+    // IMA-ADPCM needs 16-bit mono input; anything else goes out as PCM
+    const bool adpcm = useAdpcmUpload(settings) &&
+                       recording_config.bits_per_sample == 16 && recording_config.channels == 1;
+    const size_t encoded_capacity = ImaAdpcmEncoder::maxEncodedSize(STT_STREAM_CHUNK_BYTES / sizeof(int16_t));
+    ImaAdpcmEncoder* encoder = adpcm ? new (std::nothrow) ImaAdpcmEncoder() : nullptr;
+
+    uint8_t* chunk = static_cast<uint8_t*>(heap_caps_malloc(STT_STREAM_CHUNK_BYTES, MALLOC_CAP_SPIRAM));
+    uint8_t* encoded = adpcm ? static_cast<uint8_t*>(heap_caps_malloc(encoded_capacity, MALLOC_CAP_SPIRAM)) : nullptr;
+    if (!chunk || (adpcm && (!encoder || !encoded))) {
+        LOG_E("Failed to allocate stream buffers");
+        heap_caps_free(chunk);
+        heap_caps_free(encoded);
+        delete encoder;
+        result = mic.getRecordingResult(handle);
         return false;
     }
 
-    // Write footer part
-    written = esp_http_client_write(client, footer_part.c_str(), footer_part.length());
-    if (written < 0) {
-        LOG_E("Failed to write footer part");
-        esp_http_client_close(client);
-        esp_http_client_cleanup(client);
-        heap_caps_free(file_data);
-        return false;
+    // Open the connection right away so TCP/TLS setup overlaps with the user speaking
+    HttpClientPool& pool = HttpClientPool::getInstance();
+    esp_http_client_handle_t client = nullptr;
+    bool upload_ok = false;
+    if (WiFi.status() == WL_CONNECTED) {
+        client = createWhisperClient(settings, whisper_url);
+    } else {
+        LOG_E("WiFi not connected, streaming upload disabled for this recording");
+    }
+
+    if (client) {
+        esp_err_t err = pool.open(client, -1);  // -1 = chunked transfer encoding
+        if (err == ESP_OK) {
+            // WAV sizes are unknown until the end: use the 0xFFFFFFFF "until end of data" convention
+            uint8_t wav_header[ImaAdpcmEncoder::kWavHeaderSize];
+            size_t wav_header_size = MicrophoneManager::kWavHeaderSize;
+            if (adpcm) {
+                ImaAdpcmEncoder::buildWavHeader(wav_header, recording_config.sample_rate,
+                                                ImaAdpcmEncoder::kUnknownLength, 0);
+                wav_header_size = ImaAdpcmEncoder::kWavHeaderSize;
+            } else {
+                MicrophoneManager::buildWavHeader(wav_header,
+                                                  recording_config.sample_rate,
+                                                  recording_config.channels,
+                                                  recording_config.bits_per_sample,
+                                                  MicrophoneManager::kWavUnknownLength);
+            }
+            const std::string header_part = buildWhisperFileHeader();
+            upload_ok = pool.writeChunk(client, header_part.c_str(), header_part.length()) &&
+                        pool.writeChunk(client, reinterpret_cast<const char*>(wav_header), wav_header_size);
+            LOG_I("Streaming %s upload to %s %s", adpcm ? "ADPCM" : "PCM",
+                  whisper_url.c_str(), upload_ok ? "started" : "failed");
+        } else {
+            LOG_E("Failed to open HTTP connection: %s (0x%x)", esp_err_to_name(err), err);
+        }
     }
 
-    // Free file data buffer (no longer needed)
-    heap_caps_free(file_data);
-
-    // Fetch response
-    LOG_I("Fetching HTTP response headers...");
-    int content_length = esp_http_client_fetch_headers(client);
-    int status_code = esp_http_client_get_status_code(client);
-
-    // Read response body manually
-    PsramString response_buffer;
-    response_buffer.reserve(1024);
-    char read_buf[512];
-    int read_len = 0;
-    while ((read_len = esp_http_client_read(client, read_buf, sizeof(read_buf))) > 0) {
-        response_buffer.append(read_buf, read_len);
+    // Drain the capture ring until the recording ends; keep draining even if the
+    // upload failed so MicrophoneManager never has to drop audio meant for the file
+    size_t streamed_bytes = 0;
+    while (true) {
+        size_t received = xStreamBufferReceive(stream, chunk, STT_STREAM_CHUNK_BYTES, pdMS_TO_TICKS(50));
+        if (received > 0) {
+            const char* payload = reinterpret_cast<const char*>(chunk);
+            size_t payload_size = received;
+            if (adpcm) {
+                payload_size = encoder->encode(reinterpret_cast<const int16_t*>(chunk), received / sizeof(int16_t),
+                                               encoded, encoded_capacity);
+                payload = reinterpret_cast<const char*>(encoded);
+            }
+            if (upload_ok && payload_size > 0 && !pool.writeChunk(client, payload, payload_size)) {
+                LOG_E("Streaming upload write failed after %u bytes", streamed_bytes);
+                upload_ok = false;
+            }
+            streamed_bytes += payload_size;
+            continue;
+        }
+        if (!mic.isRecording() && xStreamBufferIsEmpty(stream) == pdTRUE) {
+            break;
+        }
     }
 
-    LOG_I("HTTP Status: %d, Content-Length: %d", status_code, content_length);
-    LOG_I("Response buffer size: %u bytes", response_buffer.length());
-
-    esp_http_client_close(client);
-    esp_http_client_cleanup(client);
-
-    if (status_code != 200) {
-        LOG_E("Whisper API returned error status: %d", status_code);
-        LOG_E("Response: %s", response_buffer.c_str());
-        return false;
+    if (adpcm && upload_ok) {
+        const size_t tail = encoder->flush(encoded, encoded_capacity);
+        if (tail > 0 && !pool.writeChunk(client, reinterpret_cast<const char*>(encoded), tail)) {
+            upload_ok = false;
+        }
+        streamed_bytes += tail;
+    }
+    heap_caps_free(chunk);
+    heap_caps_free(encoded);
+    delete encoder;
+
+    result = mic.getRecordingResult(handle);
+
+    if (upload_ok && (!result.success || result.stream_dropped_bytes > 0)) {
+        // No speech, or a gap in the uploaded audio: abandon the request and let the caller fall back
+        LOG_W("Abandoning streaming upload (success=%d, dropped=%u bytes)",
+              result.success, result.stream_dropped_bytes);
+        upload_ok = false;
+    }
+
+    bool ok = false;
+    bool sent = false;
+    if (upload_ok) {
+        const std::string trailer_part = buildWhisperTrailer();
+        sent = pool.writeChunk(client, trailer_part.c_str(), trailer_part.length()) &&
+               pool.writeChunk(client, nullptr, 0);
+        if (sent) {
+            LOG_I("Streaming upload complete (%u bytes of audio)", streamed_bytes);
+            const int content_length = pool.fetchHeaders(client);
+            ok = readWhisperTranscription(client, esp_http_client_get_status_code(client), content_length,
+                                          transcription);
+        } else {
+            LOG_E("Failed to finish streaming upload");
+        }
     }
 
-    // Parse JSON response: {"text": "transcribed text"}
-    cJSON* root = cJSON_Parse(response_buffer.c_str());
-    if (!root) {
-        LOG_E("Failed to parse JSON response");
-        return false;
+    if (client && !sent) {
+        // The chunked body stopped partway: the connection cannot carry another request
+        pool.markFailed(client);
     }
+    pool.release(client);
 
-    cJSON* text = cJSON_GetObjectItem(root, "text");
-    if (!text || !cJSON_IsString(text)) {
-        LOG_E("Invalid JSON response format (missing 'text' field)");
-        cJSON_Delete(root);
-        return false;
+    if (ok) {
+        LOG_I("Transcription: %s", transcription.c_str());
     }
-
-    transcription = text->valuestring;
-    cJSON_Delete(root);
-
-    LOG_I("Transcription: %s", transcription.c_str());
-    return true;
+    return ok;
 }
 
-bool VoiceAssistant::makeTTSRequest(const std::string& text, std::string& output_file_path, bool force_enable) {
-    LOG_I("Making TTS request for text: %s", text.c_str());
+esp_http_client_handle_t VoiceAssistant::openTTSResponse(const std::string& text, bool force_enable, int& content_length) {
+    content_length = -1;
 
     // Check if we have WiFi connection
     if (WiFi.status() != WL_CONNECTED) {
         LOG_E("WiFi not connected");
-        return false;
+        return nullptr;
     }
 
     // Get settings
@@ -1202,7 +1785,7 @@ bool VoiceAssistant::makeTTSRequest(const std::string& text, std::string& output
     // Check if TTS is enabled
     if (!force_enable && !settings.ttsEnabled) {
         LOG_W("TTS is disabled in settings");
-        return false;
+        return nullptr;
     }
 
     // Get endpoint based on local/cloud mode
@@ -1216,24 +1799,19 @@ bool VoiceAssistant::makeTTSRequest(const std::string& text, std::string& output
     }
 
     // Build JSON request body
-    cJSON* root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "model", settings.ttsModel.c_str());
-    cJSON_AddStringToObject(root, "input", text.c_str());
-    cJSON_AddStringToObject(root, "voice", settings.ttsVoice.c_str());
-    cJSON_AddNumberToObject(root, "speed", settings.ttsSpeed);
-    cJSON_AddStringToObject(root, "response_format", "wav");
-
-    // Add params object for tts-webui specific settings
-    cJSON* params = cJSON_CreateObject();
-    if (params) {
-        cJSON_AddStringToObject(params, "dtype", "int16"); // Request 16-bit integer PCM audio
-        cJSON_AddItemToObject(root, "params", params);
-    }
-
-    char* json_str = cJSON_PrintUnformatted(root);
-    std::string request_body(json_str);
-    cJSON_free(json_str);
-    cJSON_Delete(root);
+    std::string request_body;
+    request_body.reserve(text.size() + 192);
+    JsonWriter json(JsonWriter::appendTo(request_body));
+    json.beginObject();
+    json.key("model").value(settings.ttsModel);
+    json.key("input").value(text);
+    json.key("voice").value(settings.ttsVoice);
+    json.key("speed").value(static_cast<double>(settings.ttsSpeed));
+    json.key("response_format").value("wav");
+    // Params object for tts-webui specific settings
+    json.key("params").beginObject().key("dtype").value("int16").endObject();  // 16-bit integer PCM audio
+    json.endObject();
+    json.finish();
 
     LOG_I("TTS POST URL: %s", tts_url.c_str());
     LOG_I("TTS request body: %s", request_body.c_str());
@@ -1242,80 +1820,37 @@ bool VoiceAssistant::makeTTSRequest(const std::string& text, std::string& output
         s_active_lua_sandbox->appendOutput(std::string("[TTS] Body: ") + request_body);
     }
 
-    // Buffer for audio data - store in PSRAM to keep DRAM free
-    PsramVector<uint8_t> audio_data;
-    audio_data.reserve(8192);
-
-    // HTTP client event handler to capture binary audio data
-    auto http_event_handler = [](esp_http_client_event_t *evt) -> esp_err_t {
-        PsramVector<uint8_t>* data = static_cast<PsramVector<uint8_t>*>(evt->user_data);
-        switch(evt->event_id) {
-            case HTTP_EVENT_ON_DATA:
-                if (data && evt->data_len > 0) {
-                    const uint8_t* bytes = static_cast<const uint8_t*>(evt->data);
-                    data->insert(data->end(), bytes, bytes + evt->data_len);
-                }
-                break;
-            default:
-                break;
-        }
-        return ESP_OK;
-    };
-
-    // Verify WiFi connectivity before HTTPS request
-    if (!WiFi.isConnected()) {
-        LOG_E("WiFi not connected, cannot send TTS request");
-        return false;
-    }
-
-    // Configure HTTP client
-    esp_http_client_config_t config = {};
-    config.url = tts_url.c_str();
-    config.method = HTTP_METHOD_POST;
-    config.event_handler = http_event_handler;
-    config.user_data = &audio_data;
-    config.timeout_ms = 30000;  // 30 second timeout
-    config.buffer_size = 4096;
-    config.buffer_size_tx = 4096;
-    // For HTTPS: skip certificate validation (development mode)
-    config.skip_cert_common_name_check = true;
-    config.use_global_ca_store = false;
-
-    esp_http_client_handle_t client = esp_http_client_init(&config);
+    // Pooled HTTP client (body is read by the caller, not through events)
+    HttpClientPool& pool = HttpClientPool::getInstance();
+    esp_http_client_handle_t client = pool.acquire(tts_url, ttsClientOptions());
     if (!client) {
         LOG_E("Failed to initialize HTTP client");
-        return false;
+        return nullptr;
     }
 
     // Set headers
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_header(client, "User-Agent", "ESP32-VoiceAssistant/1.0");
+    pool.setHeader(client, "Content-Type", "application/json");
+    pool.setHeader(client, "User-Agent", "ESP32-VoiceAssistant/1.0");
 
     // Add API key if using cloud mode
     if (!settings.localApiMode && !settings.openAiApiKey.empty()) {
         std::string auth_header = std::string("Bearer ") + settings.openAiApiKey;
-        esp_http_client_set_header(client, "Authorization", auth_header.c_str());
+        pool.setHeader(client, "Authorization", auth_header.c_str());
         LOG_I("Using API key for cloud authentication");
     }
 
-    // Set POST data
-    esp_http_client_set_post_field(client, request_body.c_str(), request_body.length());
-
-    // Perform request
+    // Send request and wait for the response headers only
     LOG_I("Sending TTS request...");
-    esp_err_t err = esp_http_client_perform(client);
-    if (err != ESP_OK) {
-        LOG_E("HTTP request failed: %s", esp_err_to_name(err));
+    int status_code = pool.request(client, request_body.c_str(), request_body.length(), content_length);
+    if (status_code < 0) {
+        LOG_E("TTS HTTP request failed");
         if (s_active_lua_sandbox) {
-            s_active_lua_sandbox->appendOutput(std::string("[TTS ERROR] HTTP perform failed: ") + esp_err_to_name(err));
+            s_active_lua_sandbox->appendOutput("[TTS ERROR] HTTP request failed");
         }
-        esp_http_client_cleanup(client);
-        return false;
+        pool.release(client);
+        return nullptr;
     }
 
-    int status_code = esp_http_client_get_status_code(client);
-    int content_length = esp_http_client_get_content_length(client);
-
     LOG_I("HTTP Status: %d, Content-Length: %d", status_code, content_length);
     if (s_active_lua_sandbox) {
         s_active_lua_sandbox->appendOutput(std::string("[TTS] Status: ") + std::to_string(status_code) +
@@ -1327,34 +1862,15 @@ bool VoiceAssistant::makeTTSRequest(const std::string& text, std::string& output
         if (s_active_lua_sandbox) {
             s_active_lua_sandbox->appendOutput(std::string("[TTS ERROR] Server returned status: ") + std::to_string(status_code));
         }
-        esp_http_client_cleanup(client);
-        return false;
-    }
-
-    // Cleanup HTTP client (audio_data has been filled by event handler)
-    esp_http_client_cleanup(client);
-
-    if (audio_data.empty()) {
-        LOG_E("No audio data received from TTS API");
-        if (s_active_lua_sandbox) {
-            s_active_lua_sandbox->appendOutput("[TTS ERROR] No audio data received");
-        }
-        return false;
+        pool.release(client);
+        return nullptr;
     }
 
-    LOG_I("Received %u bytes of audio data", audio_data.size());
-    if (s_active_lua_sandbox) {
-        s_active_lua_sandbox->appendOutput(std::string("[TTS] Received ") + std::to_string(audio_data.size()) + " bytes");
-    }
+    return client;
+}
 
-    // Generate output filename with timestamp
-    char filename[128];
-    time_t now = time(nullptr);
-    struct tm* timeinfo = localtime(&now);
-    snprintf(filename, sizeof(filename), "tts_%04d%02d%02d_%02d%02d%02d.%s",
-             timeinfo->tm_year + 1900, timeinfo->tm_mon + 1, timeinfo->tm_mday,
-             timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec,
-             "wav");
+bool VoiceAssistant::resolveTTSOutputDir(fs::FS*& filesystem, std::string& dir_on_fs, std::string& display_dir) {
+    const SettingsSnapshot& settings = SettingsManager::getInstance().getSnapshot();
 
     // Parse output path to determine filesystem
     std::string output_dir = settings.ttsOutputPath;
@@ -1378,52 +1894,159 @@ bool VoiceAssistant::makeTTSRequest(const std::string& text, std::string& output
         LOG_I("Path doesn't start with /littlefs/ or /sd/, defaulting to SD card with path: %s", actual_path.c_str());
     }
 
+    filesystem = use_littlefs ? static_cast<fs::FS*>(&LittleFS) : static_cast<fs::FS*>(&SD_MMC);
+
     // Create output directory if it doesn't exist
-    if (use_littlefs) {
-        if (!LittleFS.exists(actual_path.c_str())) {
-            LOG_I("Creating TTS output directory on LittleFS: %s", actual_path.c_str());
-            // Create directory recursively
-            size_t pos = 0;
-            while ((pos = actual_path.find('/', pos + 1)) != std::string::npos) {
-                std::string subdir = actual_path.substr(0, pos);
-                if (!LittleFS.exists(subdir.c_str())) {
-                    LittleFS.mkdir(subdir.c_str());
-                }
-            }
-            LittleFS.mkdir(actual_path.c_str());
-        }
-    } else {
-        if (!SD_MMC.exists(actual_path.c_str())) {
-            LOG_I("Creating TTS output directory on SD card: %s", actual_path.c_str());
-            // Create directory recursively
-            size_t pos = 0;
-            while ((pos = actual_path.find('/', pos + 1)) != std::string::npos) {
-                std::string subdir = actual_path.substr(0, pos);
-                if (!SD_MMC.exists(subdir.c_str())) {
-                    SD_MMC.mkdir(subdir.c_str());
-                }
+    if (!filesystem->exists(actual_path.c_str())) {
+        LOG_I("Creating TTS output directory on %s: %s", use_littlefs ? "LittleFS" : "SD card", actual_path.c_str());
+        // Create directory recursively
+        size_t pos = 0;
+        while ((pos = actual_path.find('/', pos + 1)) != std::string::npos) {
+            std::string subdir = actual_path.substr(0, pos);
+            if (!filesystem->exists(subdir.c_str())) {
+                filesystem->mkdir(subdir.c_str());
             }
-            SD_MMC.mkdir(actual_path.c_str());
         }
+        filesystem->mkdir(actual_path.c_str());
     }
 
-    // Build full output path (for logging purposes, keep the original prefix)
-    std::string file_path_on_fs = actual_path + "/" + filename;
-    output_file_path = output_dir + "/" + filename;
+    dir_on_fs = actual_path;
+    display_dir = output_dir;
 
     // Hotfix: If the path was defaulted to SD card, ensure the returned path has the /sd prefix.
     if (output_dir.find("/littlefs/") != 0 && output_dir.find("/sd/") != 0) {
-        output_file_path = "/sd" + output_file_path;
+        display_dir = "/sd" + display_dir;
     }
+    return true;
+}
 
-    // Write audio data to file
-    File file;
-    if (use_littlefs) {
-        file = LittleFS.open(file_path_on_fs.c_str(), FILE_WRITE);
-    } else {
-        file = SD_MMC.open(file_path_on_fs.c_str(), FILE_WRITE);
+bool VoiceAssistant::resolveTTSOutputFile(fs::FS*& filesystem, std::string& path_on_fs, std::string& output_file_path) {
+    // Generate output filename with timestamp
+    char filename[128];
+    time_t now = time(nullptr);
+    struct tm* timeinfo = localtime(&now);
+    snprintf(filename, sizeof(filename), "tts_%04d%02d%02d_%02d%02d%02d.%s",
+             timeinfo->tm_year + 1900, timeinfo->tm_mon + 1, timeinfo->tm_mday,
+             timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec,
+             "wav");
+
+    std::string dir_on_fs;
+    std::string display_dir;
+    resolveTTSOutputDir(filesystem, dir_on_fs, display_dir);
+
+    // Build full output path (for logging purposes, keep the original prefix)
+    path_on_fs = dir_on_fs + "/" + filename;
+    output_file_path = display_dir + "/" + filename;
+    return true;
+}
+
+bool VoiceAssistant::prepareTTSCache(const std::string& text, std::string& cache_key) {
+    // The cache lives in <ttsOutputPath>/cache; flash gets a much smaller budget than SD
+    static constexpr size_t kCacheBytesSd = 32 * 1024 * 1024;
+    static constexpr size_t kCacheBytesLittleFs = 512 * 1024;
+
+    fs::FS* filesystem = nullptr;
+    std::string dir_on_fs;
+    std::string display_dir;
+    resolveTTSOutputDir(filesystem, dir_on_fs, display_dir);
+
+    const bool on_flash = filesystem == static_cast<fs::FS*>(&LittleFS);
+    if (!TtsCache::getInstance().configure(filesystem, dir_on_fs + "/cache", display_dir + "/cache",
+                                           on_flash ? kCacheBytesLittleFs : kCacheBytesSd)) {
+        return false;
+    }
+
+    const SettingsSnapshot& settings = SettingsManager::getInstance().getSnapshot();
+    TtsCache::VoiceParams params;
+    params.voice = settings.ttsVoice;
+    params.model = settings.ttsModel;
+    params.speed = settings.ttsSpeed;
+    params.format = "wav";  // What openTTSResponse() requests
+    cache_key = TtsCache::makeKey(text, params);
+    return true;
+}
+
+bool VoiceAssistant::synthesizeSpeech(const std::string& text, PsramVector<uint8_t>& audio,
+                                      const std::atomic<bool>* cancel, bool force_enable) {
+    audio.clear();
+
+    // The pooled handle polls the flag (or the caller's request token) while waiting on the server
+    CancelToken::Scope cancel_scope{CancelToken(cancel)};
+
+    int content_length = -1;
+    esp_http_client_handle_t client = openTTSResponse(text, force_enable, content_length);
+    if (!client) {
+        return false;
+    }
+
+    // Buffer for audio data - store in PSRAM to keep DRAM free
+    audio.reserve(content_length > 0 ? static_cast<size_t>(content_length) : 8192);
+
+    HttpClientPool& pool = HttpClientPool::getInstance();
+    char chunk[1024];
+    int read_len;
+    while ((read_len = pool.read(client, chunk, sizeof(chunk))) > 0) {
+        audio.insert(audio.end(), reinterpret_cast<uint8_t*>(chunk), reinterpret_cast<uint8_t*>(chunk) + read_len);
+    }
+    pool.release(client);
+
+    if (CancelToken::current().cancelled()) {
+        LOG_I("TTS synthesis cancelled");
+        audio.clear();
+        return false;
+    }
+
+    if (read_len < 0) {
+        LOG_E("TTS response read failed after %u bytes", (unsigned)audio.size());
+        return false;
+    }
+
+    if (audio.empty()) {
+        LOG_E("No audio data received from TTS API");
+        if (s_active_lua_sandbox) {
+            s_active_lua_sandbox->appendOutput("[TTS ERROR] No audio data received");
+        }
+        return false;
     }
 
+    LOG_I("Received %u bytes of audio data", audio.size());
+    if (s_active_lua_sandbox) {
+        s_active_lua_sandbox->appendOutput(std::string("[TTS] Received ") + std::to_string(audio.size()) + " bytes");
+    }
+    return true;
+}
+
+bool VoiceAssistant::makeTTSRequest(const std::string& text, std::string& output_file_path, bool force_enable) {
+    LOG_I("Making TTS request for text: %s", text.c_str());
+
+    if (!force_enable && !SettingsManager::getInstance().getSnapshot().ttsEnabled) {
+        LOG_W("TTS is disabled in settings");
+        return false;
+    }
+
+    std::string cache_key;
+    const bool cache_ready = prepareTTSCache(text, cache_key);
+    if (cache_ready && TtsCache::getInstance().lookup(cache_key, output_file_path)) {
+        LOG_I("TTS cache hit: %s", output_file_path.c_str());
+        return true;
+    }
+
+    PsramVector<uint8_t> audio_data;
+    if (!synthesizeSpeech(text, audio_data, nullptr, force_enable)) {
+        return false;
+    }
+
+    if (cache_ready && TtsCache::getInstance().store(cache_key, text, audio_data, output_file_path)) {
+        LOG_I("TTS audio cached to: %s (%u bytes)", output_file_path.c_str(), (unsigned)audio_data.size());
+        return true;
+    }
+
+    fs::FS* filesystem = nullptr;
+    std::string file_path_on_fs;
+    resolveTTSOutputFile(filesystem, file_path_on_fs, output_file_path);
+
+    // Write audio data to file
+    File file = filesystem->open(file_path_on_fs.c_str(), FILE_WRITE);
     if (!file) {
         LOG_E("Failed to open file for writing: %s", output_file_path.c_str());
         return false;
@@ -1442,7 +2065,105 @@ bool VoiceAssistant::makeTTSRequest(const std::string& text, std::string& output
     return true;
 }
 
-bool VoiceAssistant::makeGPTRequest(const std::string& prompt, std::string& response) {
+bool VoiceAssistant::speakStreaming(const std::string& text, std::string* saved_path) {
+    LOG_I("Streaming TTS for text: %s", text.c_str());
+    const uint32_t started_ms = millis();
+
+    std::string cache_key;
+    const bool cache_ready = prepareTTSCache(text, cache_key);
+    std::string cached_path;
+    if (cache_ready && TtsCache::getInstance().lookup(cache_key, cached_path)) {
+        if (!AudioManager::getInstance().playFile(cached_path.c_str())) {
+            LOG_E("Failed to play cached TTS audio %s", cached_path.c_str());
+            return false;
+        }
+        LOG_I("TTS played from cache after %u ms: %s", (unsigned)(millis() - started_ms), cached_path.c_str());
+        if (saved_path) {
+            *saved_path = cached_path;
+        }
+        return true;
+    }
+
+    int content_length = -1;
+    esp_http_client_handle_t client = openTTSResponse(text, true, content_length);
+    if (!client) {
+        return false;
+    }
+    const uint32_t headers_ms = millis() - started_ms;
+
+    HttpResponseSource::Config source_config;
+    source_config.release_client = [](esp_http_client_handle_t c) { HttpClientPool::getInstance().release(c); };
+    fs::FS* cache_fs = nullptr;
+    if (saved_path) {
+        // An explicitly saved file must outlive cache eviction
+        fs::FS* filesystem = nullptr;
+        resolveTTSOutputFile(filesystem, source_config.tee_path, *saved_path);
+        source_config.tee_fs = filesystem;
+    } else if (cache_ready && TtsCache::getInstance().reserve(cache_key, cache_fs, source_config.tee_path, cached_path)) {
+        // Complete downloads become cache entries; partial ones are removed by the source
+        source_config.tee_fs = cache_fs;
+        source_config.on_tee_closed = [cache_key, text](bool saved, size_t bytes) {
+            TtsCache::getInstance().commit(cache_key, text, saved, bytes);
+        };
+    }
+
+    std::unique_ptr<HttpResponseSource> source(new HttpResponseSource(source_config, "tts://stream.wav"));
+    if (!source->attach(client, content_length) || !source->waitForPrebuffer()) {
+        LOG_E("TTS stream did not deliver enough audio to start playback");
+        if (saved_path) {
+            saved_path->clear();
+        }
+        return false;
+    }
+
+    if (!AudioManager::getInstance().playSource(std::move(source))) {
+        LOG_E("Failed to start streamed TTS playback");
+        if (saved_path) {
+            saved_path->clear();
+        }
+        return false;
+    }
+
+    LOG_I("TTS time-to-first-audio: %u ms (headers after %u ms)",
+          (unsigned)(millis() - started_ms), (unsigned)headers_ms);
+    if (s_active_lua_sandbox) {
+        s_active_lua_sandbox->appendOutput(std::string("[TTS] Playing after ") +
+                                          std::to_string(millis() - started_ms) + " ms");
+    }
+    return true;
+}
+
+size_t VoiceAssistant::prewarmTTSCache(size_t max_items) {
+    static constexpr uint32_t kPrewarmMinHits = 2;  // Phrases actually repeated, not one-off replies
+
+    TtsCache& cache = TtsCache::getInstance();
+    std::string key;
+    if (!prepareTTSCache(std::string(), key)) {
+        return 0;
+    }
+
+    size_t synthesized = 0;
+    for (const std::string& text : cache.frequentTexts(TtsCache::kMaxEntries, kPrewarmMinHits)) {
+        if (synthesized >= max_items || WiFi.status() != WL_CONNECTED) {
+            break;
+        }
+        if (!prepareTTSCache(text, key) || cache.contains(key)) {
+            continue;
+        }
+
+        PsramVector<uint8_t> audio;
+        std::string output_file_path;
+        if (synthesizeSpeech(text, audio) && cache.store(key, text, audio, output_file_path)) {
+            ++synthesized;
+        }
+    }
+
+    LOG_I("TTS cache pre-warm: %u phrases synthesized", (unsigned)synthesized);
+    return synthesized;
+}
+
+bool VoiceAssistant::makeGPTRequest(const std::string& prompt, std::string& response, bool publish_progress,
+                                    const std::string* system_override) {
     LOG_I("Making Ollama/GPT request");
 
     // Check if we have WiFi connection
@@ -1482,11 +2203,20 @@ bool VoiceAssistant::makeGPTRequest(const std::string& prompt, std::string& resp
         return false;
     }
 
-    const std::string system_prompt = getSystemPrompt();
+    const std::string system_prompt = system_override ? *system_override : getSystemPrompt();
     LOG_I("System prompt size: %d bytes", system_prompt.length());
 
-    const std::vector<ConversationEntry> conversation_history = ConversationBuffer::getInstance().getEntries();
-    LOG_I("Conversation history entries: %d", conversation_history.size());
+    std::vector<ConversationEntry> conversation_history;
+    if (!system_override) {
+        conversation_history = ConversationBuffer::getInstance().getEntries();
+    }
+    const ConversationContext::Plan context = ConversationContext::fit(
+        toContextTurns(conversation_history),
+        system_override ? ConversationBuffer::Summary() : ConversationBuffer::getInstance().getSummary(),
+        settings.llmContextTokens);
+    LOG_I("Conversation context: %u of %u turns verbatim, summary %u bytes, %u pending summary, ~%u tokens",
+          (unsigned)context.turns.size(), (unsigned)(context.turns.size() + context.omitted),
+          (unsigned)context.summary.size(), (unsigned)context.pending.size(), (unsigned)context.tokens);
     const bool prompt_recorded = [&]() {
         if (conversation_history.empty()) {
             return false;
@@ -1501,114 +2231,49 @@ bool VoiceAssistant::makeGPTRequest(const std::string& prompt, std::string& resp
         return last.transcription == prompt;
     }();
 
-    auto buildRequestBody = [&](const std::string& model, PsramString& out) -> bool {
-        // Build JSON request body using cJSON
-        cJSON* root = cJSON_CreateObject();
-        if (!root) {
-            LOG_E("Failed to create JSON object");
-            return false;
-        }
-
-        cJSON_AddStringToObject(root, "model", model.c_str());
-
-        cJSON* messages = cJSON_CreateArray();
-        if (!messages) {
-            LOG_E("Failed to create messages array");
-            cJSON_Delete(root);
-            return false;
-        }
-
-        cJSON* system_msg = cJSON_CreateObject();
-        cJSON_AddStringToObject(system_msg, "role", "system");
-        cJSON_AddStringToObject(system_msg, "content", system_prompt.c_str());
-        cJSON_AddItemToArray(messages, system_msg);
-
-        auto append_message = [&](const std::string& role, const std::string& content) -> bool {
+    // Written twice per attempt: once to count the Content-Length, once into the
+    // connection, so the prompt and history are never copied into a body buffer
+    auto writeRequestBody = [&](JsonWriter& json, const std::string& model) {
+        auto append_message = [&json](const char* role, const std::string& content) {
             if (content.empty()) {
-                return true;
+                return;
             }
-            cJSON* msg = cJSON_CreateObject();
-            if (!msg) {
-                return false;
-            }
-            cJSON_AddStringToObject(msg, "role", role.c_str());
-            cJSON_AddStringToObject(msg, "content", content.c_str());
-            cJSON_AddItemToArray(messages, msg);
-            return true;
+            json.beginObject().key("role").value(role).key("content").value(content).endObject();
         };
 
-        for (const auto& entry : conversation_history) {
-            const std::string role = entry.role == "assistant" ? "assistant" : "user";
-            const std::string content = formatConversationEntry(entry);
-            if (!append_message(role, content)) {
-                LOG_E("Failed to append conversation entry to request");
-                cJSON_Delete(root);
-                return false;
-            }
+        json.beginObject();
+        json.key("model").value(model);
+        json.key("messages").beginArray();
+        json.beginObject().key("role").value("system").key("content").value(system_prompt).endObject();
+
+        if (!context.summary.empty()) {
+            json.beginObject().key("role").value("system").key("content")
+                .beginString()
+                .stringPart(std::string("Summary of the earlier conversation: "))
+                .stringPart(context.summary)
+                .endString()
+                .endObject();
         }
 
-        if (!prompt_recorded) {
-            if (!append_message("user", prompt)) {
-                LOG_E("Failed to append fallback user prompt");
-                cJSON_Delete(root);
-                return false;
-            }
+        for (const auto& turn : context.turns) {
+            append_message(turn.role.c_str(), turn.content);
         }
 
-        cJSON_AddItemToObject(root, "messages", messages);
-        cJSON_AddNumberToObject(root, "temperature", 0.7);
-        cJSON_AddBoolToObject(root, "stream", false);
-
-        char* json_str = cJSON_PrintUnformatted(root);
-        if (!json_str) {
-            LOG_E("Failed to serialize JSON");
-            cJSON_Delete(root);
-            return false;
+        if (!prompt_recorded) {
+            append_message("user", prompt);
         }
 
-        out.assign(json_str);
-        cJSON_free(json_str);
-        cJSON_Delete(root);
-        return true;
+        json.endArray();
+        json.key("temperature").value(0.7);
+        json.key("stream").value(settings.llmStreaming);
+        json.endObject();
     };
 
-    // Buffer for response
-    PsramString response_buffer;
-    response_buffer.reserve(4096);  // Increased buffer size
-
-    // HTTP client event handler with improved error handling
-    auto http_event_handler = [](esp_http_client_event_t *evt) -> esp_err_t {
-        PsramString* response = static_cast<PsramString*>(evt->user_data);
-        switch(evt->event_id) {
-            case HTTP_EVENT_ERROR:
-                LOG_E("HTTP_EVENT_ERROR");
-                break;
-            case HTTP_EVENT_ON_CONNECTED:
-                LOG_I("HTTP_EVENT_ON_CONNECTED");
-                break;
-            case HTTP_EVENT_HEADER_SENT:
-                LOG_I("HTTP_EVENT_HEADER_SENT");
-                break;
-            case HTTP_EVENT_ON_HEADER:
-                LOG_I("HTTP_EVENT_ON_HEADER: %s: %s", evt->header_key, evt->header_value);
-                break;
-            case HTTP_EVENT_ON_DATA:
-                if (response && evt->data_len > 0) {
-                    LOG_I("HTTP_EVENT_ON_DATA: %d bytes", evt->data_len);
-                    response->append((char*)evt->data, evt->data_len);
-                }
-                break;
-            case HTTP_EVENT_ON_FINISH:
-                LOG_I("HTTP_EVENT_ON_FINISH");
-                break;
-            case HTTP_EVENT_DISCONNECTED:
-                LOG_I("HTTP_EVENT_DISCONNECTED");
-                break;
-            default:
-                break;
-        }
-        return ESP_OK;
-    };
+    // Non-streamed reply: only the message content is extracted while reading;
+    // error bodies are kept for the log
+    JsonPathExtractor reply_json;
+    reply_json.addPath("choices[0].message.content");
+    PsramString error_body;
 
     // Verify WiFi connectivity before HTTPS request
     if (!WiFi.isConnected()) {
@@ -1617,60 +2282,71 @@ bool VoiceAssistant::makeGPTRequest(const std::string& prompt, std::string& resp
     }
 
     bool fallback_attempted = false;
-    PsramString request_body;
+    const bool streaming = settings.llmStreaming;
+    LlmStreamParser stream_parser;
 
     while (true) {
-        if (!buildRequestBody(selected_model, request_body)) {
-            return false;
-        }
-
-        LOG_I("Request body: %s", request_body.c_str());
-        response_buffer.clear();
-
-        // Configure HTTP client
-        esp_http_client_config_t config = {};
-        config.url = gpt_url.c_str();
-        config.method = HTTP_METHOD_POST;
-        config.event_handler = http_event_handler;
-        config.user_data = &response_buffer;
-        config.timeout_ms = 90000;  // 90 second timeout for large models (20B can take 60-80s)
-        config.buffer_size = 16384;  // Large buffer for responses
-        config.buffer_size_tx = 8192;
-        config.is_async = false;  // Synchronous mode for better stability
-        // For HTTPS: skip certificate validation (development mode)
-        config.skip_cert_common_name_check = true;
-        config.use_global_ca_store = false;
-
-        esp_http_client_handle_t client = esp_http_client_init(&config);
+        JsonWriter counter;
+        writeRequestBody(counter, selected_model);
+        const size_t body_length = counter.size();
+        LOG_I("Request body: %u bytes (model %s), streamed into the connection",
+              (unsigned)body_length, selected_model.c_str());
+        error_body.clear();
+        reply_json.reset();
+        stream_parser.reset();
+
+        // Pooled HTTP client (pre-warmed when push-to-talk started)
+        HttpClientPool& pool = HttpClientPool::getInstance();
+        esp_http_client_handle_t client = pool.acquire(gpt_url, llmClientOptions());
         if (!client) {
             LOG_E("Failed to initialize HTTP client");
             return false;
         }
 
         // Set headers
-        esp_http_client_set_header(client, "Content-Type", "application/json");
+        pool.setHeader(client, "Content-Type", "application/json");
+        if (streaming) {
+            pool.setHeader(client, "Accept", "text/event-stream, application/x-ndjson");
+        }
 
         // Optional: Add API key if using OpenAI cloud (Ollama doesn't need it)
         if (!settings.localApiMode && !settings.openAiApiKey.empty()) {
             std::string auth_header = std::string("Bearer ") + settings.openAiApiKey;
-            esp_http_client_set_header(client, "Authorization", auth_header.c_str());
+            pool.setHeader(client, "Authorization", auth_header.c_str());
             LOG_I("Using API key for cloud authentication");
         }
 
-        // Set POST data
-        esp_http_client_set_post_field(client, request_body.c_str(), request_body.length());
-
-        // Perform request
-        LOG_I("Sending HTTP request to LLM...");
-        esp_err_t err = esp_http_client_perform(client);
+        esp_err_t err = ESP_OK;
+        int content_length = 0;
+        size_t body_bytes = 0;
 
-        int status_code = esp_http_client_get_status_code(client);
-        int content_length = esp_http_client_get_content_length(client);
+        LOG_I("Sending %sHTTP request to LLM...", streaming ? "streaming " : "");
+        auto send_body = [&](esp_http_client_handle_t c) {
+            JsonWriter json([c](const char* data, size_t length) { return writeHttpAll(c, data, length); });
+            writeRequestBody(json, selected_model);
+            if (!json.finish() || json.size() != body_length) {
+                LOG_E("Failed to send request body (%u of %u bytes)", (unsigned)json.size(), (unsigned)body_length);
+                return false;
+            }
+            return true;
+        };
+        int status_code = pool.request(client, static_cast<int>(body_length), send_body, content_length);
+        if (status_code < 0) {
+            err = ESP_ERR_HTTP_CONNECT;
+            status_code = 0;
+        } else if (streaming && status_code == 200) {
+            // Drive the connection by hand so deltas are parsed as they arrive
+            if (!readGPTStream(client, stream_parser, publish_progress)) {
+                err = ESP_FAIL;
+            }
+        } else {
+            body_bytes = readJsonResponse(client, status_code, reply_json, error_body);
+        }
 
         if (err != ESP_OK) {
             LOG_E("HTTP request failed: %s (status=%d, content_len=%d)",
                   esp_err_to_name(err), status_code, content_length);
-            esp_http_client_cleanup(client);
+            pool.release(client);
 
             // If network error, don't retry with fallback model
             if (err == ESP_ERR_HTTP_CONNECT || err == ESP_ERR_HTTP_FETCH_HEADER) {
@@ -1681,9 +2357,10 @@ bool VoiceAssistant::makeGPTRequest(const std::string& prompt, std::string& resp
         }
 
         LOG_I("HTTP Status: %d, Content-Length: %d, Response size: %d",
-              status_code, content_length, response_buffer.size());
+              status_code, content_length,
+              streaming ? stream_parser.content().size() : body_bytes);
 
-        esp_http_client_cleanup(client);
+        pool.release(client);
 
         if (status_code == 404 && settings.localApiMode && !fallback_attempted) {
             LOG_W("Model '%s' not available on local endpoint, attempting fallback", selected_model.c_str());
@@ -1704,54 +2381,82 @@ bool VoiceAssistant::makeGPTRequest(const std::string& prompt, std::string& resp
 
         if (status_code != 200) {
             LOG_E("LLM API returned error status: %d", status_code);
-            LOG_E("Response: %s", response_buffer.c_str());
+            LOG_E("Response: %s", error_body.c_str());
             return false;
         }
 
-        LOG_I("LLM response: %s", response_buffer.c_str());
         break;
     }
 
-    // Parse JSON response
+    if (streaming) {
+        if (!stream_parser.error().empty()) {
+            LOG_E("LLM stream reported an error: %s", stream_parser.error().c_str());
+            return false;
+        }
+        // Prefer the exact command object; fall back to the raw content (prose replies)
+        response = stream_parser.commandReady() ? stream_parser.commandJson() : stream_parser.content();
+        if (response.empty()) {
+            LOG_E("LLM stream ended without content");
+            return false;
+        }
+        LOG_I("Extracted command JSON: %s", response.c_str());
+        return true;
+    }
+
     // OpenAI/Ollama format: {"choices": [{"message": {"content": "..."}}]}
-    cJSON* resp_root = cJSON_Parse(response_buffer.c_str());
-    if (!resp_root) {
+    if (!reply_json.finish()) {
         LOG_E("Failed to parse LLM response JSON");
         return false;
     }
-
-    cJSON* choices = cJSON_GetObjectItem(resp_root, "choices");
-    if (!choices || !cJSON_IsArray(choices) || cJSON_GetArraySize(choices) == 0) {
-        LOG_E("Invalid response format (missing 'choices' array)");
-        cJSON_Delete(resp_root);
+    if (reply_json.type(0) != JsonPathExtractor::Type::String) {
+        LOG_E("Invalid response format (missing 'choices[0].message.content')");
         return false;
     }
 
-    cJSON* first_choice = cJSON_GetArrayItem(choices, 0);
-    if (!first_choice) {
-        LOG_E("Invalid response format (empty choices array)");
-        cJSON_Delete(resp_root);
-        return false;
-    }
+    response = reply_json.value(0);
 
-    cJSON* message = cJSON_GetObjectItem(first_choice, "message");
-    if (!message) {
-        LOG_E("Invalid response format (missing 'message')");
-        cJSON_Delete(resp_root);
-        return false;
-    }
+    LOG_I("Extracted command JSON: %s", response.c_str());
+    return true;
+}
 
-    cJSON* content = cJSON_GetObjectItem(message, "content");
-    if (!content || !cJSON_IsString(content)) {
-        LOG_E("Invalid response format (missing 'content')");
-        cJSON_Delete(resp_root);
-        return false;
-    }
+bool VoiceAssistant::readGPTStream(esp_http_client_handle_t client, LlmStreamParser& parser, bool publish_progress) {
+    char chunk[LLM_STREAM_READ_BYTES];
+    const uint32_t start_ms = millis();
+    bool first_delta_logged = false;
 
-    response = content->valuestring;
-    cJSON_Delete(resp_root);
+    while (true) {
+        const int read_len = HttpClientPool::getInstance().read(client, chunk, sizeof(chunk));
+        if (read_len < 0) {
+            LOG_E("LLM stream read failed after %u deltas", parser.deltaCount());
+            return false;
+        }
+        if (read_len == 0) {
+            break;
+        }
 
-    LOG_I("Extracted command JSON: %s", response.c_str());
+        const bool changed = parser.feed(chunk, read_len);
+        if (!first_delta_logged && parser.deltaCount() > 0) {
+            first_delta_logged = true;
+            LOG_I("First LLM delta after %u ms", millis() - start_ms);
+        }
+        if (changed && publish_progress) {
+            updateStreamingResponse(parser.displayText(), parser.commandReady());
+        }
+        if (parser.commandReady()) {
+            // Nothing after the command object is used: stop here and let the caller execute it
+            LOG_I("Command object complete after %u ms (%u deltas), closing stream",
+                  millis() - start_ms, parser.deltaCount());
+            break;
+        }
+        if (parser.done()) {
+            break;
+        }
+    }
+
+    if (parser.finish() && publish_progress) {
+        updateStreamingResponse(parser.displayText(), parser.commandReady());
+    }
+    LOG_I("LLM stream finished in %u ms (%u content bytes)", millis() - start_ms, parser.content().size());
     return true;
 }
 
@@ -1765,26 +2470,36 @@ bool VoiceAssistant::parseGPTCommand(const std::string& response, VoiceCommand&
         return false;
     }
 
-    // Extract command field
-    cJSON* command = cJSON_GetObjectItem(root, "command");
-    if (!command || !cJSON_IsString(command)) {
-        LOG_E("Invalid command format (missing 'command' field)");
-        cJSON_Delete(root);
-        return false;
-    }
+    // Multi-command reply: {"plan": [{"id", "command", "args", "after"}, ...]} replaces command/args
+    cJSON* plan = cJSON_GetObjectItem(root, "plan");
+    cmd.plan = CommandPlan();
+    cmd.args.clear();
 
-    cmd.command = command->valuestring;
+    if (plan && cJSON_IsArray(plan) && cJSON_GetArraySize(plan) > 0) {
+        if (!parseCommandPlan(plan, cmd)) {
+            cJSON_Delete(root);
+            return false;
+        }
+    } else {
+        // Extract command field
+        cJSON* command = cJSON_GetObjectItem(root, "command");
+        if (!command || !cJSON_IsString(command)) {
+            LOG_E("Invalid command format (missing 'command' field)");
+            cJSON_Delete(root);
+            return false;
+        }
 
-    // Extract args field (optional)
-    cJSON* args = cJSON_GetObjectItem(root, "args");
-    cmd.args.clear();
+        cmd.command = command->valuestring;
 
-    if (args && cJSON_IsArray(args)) {
-        int args_count = cJSON_GetArraySize(args);
-        for (int i = 0; i < args_count; i++) {
-            cJSON* arg = cJSON_GetArrayItem(args, i);
-            if (arg && cJSON_IsString(arg)) {
-                cmd.args.push_back(arg->valuestring);
+        // Extract args field (optional)
+        cJSON* args = cJSON_GetObjectItem(root, "args");
+        if (args && cJSON_IsArray(args)) {
+            int args_count = cJSON_GetArraySize(args);
+            for (int i = 0; i < args_count; i++) {
+                cJSON* arg = cJSON_GetArrayItem(args, i);
+                if (arg && cJSON_IsString(arg)) {
+                    cmd.args.push_back(arg->valuestring);
+                }
             }
         }
     }
@@ -1826,6 +2541,131 @@ bool VoiceAssistant::parseGPTCommand(const std::string& response, VoiceCommand&
     return true;
 }
 
+bool VoiceAssistant::parseCommandPlan(cJSON* plan, VoiceCommand& cmd) {
+    const int step_count = cJSON_GetArraySize(plan);
+    for (int i = 0; i < step_count; i++) {
+        cJSON* item = cJSON_GetArrayItem(plan, i);
+        cJSON* command = item ? cJSON_GetObjectItem(item, "command") : nullptr;
+        if (!command || !cJSON_IsString(command)) {
+            LOG_E("Invalid plan step %d (missing 'command' field)", i + 1);
+            return false;
+        }
+
+        CommandPlan::Step step;
+        step.command = command->valuestring;
+
+        cJSON* id = cJSON_GetObjectItem(item, "id");
+        if (id && cJSON_IsString(id)) {
+            step.id = id->valuestring;
+        } else if (id && cJSON_IsNumber(id)) {
+            step.id = std::to_string(id->valueint);
+        }
+
+        cJSON* args = cJSON_GetObjectItem(item, "args");
+        if (args && cJSON_IsArray(args)) {
+            cJSON* arg = nullptr;
+            cJSON_ArrayForEach(arg, args) {
+                if (cJSON_IsString(arg)) {
+                    step.args.push_back(arg->valuestring);
+                }
+            }
+        }
+
+        // "after": ["id", ...], a single id, or 1-based step numbers
+        cJSON* after = cJSON_GetObjectItem(item, "after");
+        auto add_dependency = [&step](cJSON* value) {
+            if (cJSON_IsString(value)) {
+                step.after.push_back(value->valuestring);
+            } else if (cJSON_IsNumber(value)) {
+                step.after.push_back(std::to_string(value->valueint));
+            }
+        };
+        if (after && cJSON_IsArray(after)) {
+            cJSON* value = nullptr;
+            cJSON_ArrayForEach(value, after) {
+                add_dependency(value);
+            }
+        } else if (after) {
+            add_dependency(after);
+        }
+
+        if (!cmd.plan.addStep(std::move(step))) {
+            LOG_E("Plan has more than %u steps", (unsigned)CommandPlan::kMaxSteps);
+            return false;
+        }
+    }
+
+    std::string error;
+    if (!cmd.plan.prepare(error)) {
+        LOG_E("Invalid plan: %s", error.c_str());
+        return false;
+    }
+
+    // A single step is an ordinary command (keeps the Lua script handling)
+    if (cmd.plan.size() == 1) {
+        cmd.command = cmd.plan.step(0).command;
+        cmd.args = cmd.plan.resolvedArgs(0);
+        cmd.plan = CommandPlan();
+        return true;
+    }
+
+    cmd.command = "plan";
+    for (const CommandPlan::Step& step : cmd.plan.steps()) {
+        cmd.args.push_back(step.command);
+    }
+    LOG_I("Parsed plan: %u steps, up to %u in parallel, depth %u",
+          (unsigned)cmd.plan.size(), (unsigned)cmd.plan.width(), (unsigned)cmd.plan.depth());
+    return true;
+}
+
+CommandResult VoiceAssistant::runCommand(const std::string& command, const std::vector<std::string>& args) {
+    if (command == "lua_script") {
+        return args.empty() ? CommandResult{false, "Missing script"} : executeLuaScript(args[0]);
+    }
+    return CommandCenter::getInstance().executeCommand(command, args);
+}
+
+void VoiceAssistant::executeCommandPlan(VoiceCommand& cmd) {
+    const bool all_ok = CommandPlanExecutor::run(
+        cmd.plan, [this](const std::string& command, const std::vector<std::string>& args) {
+            return runCommand(command, args);
+        });
+
+    cmd.output = cmd.plan.summary();
+    LOG_I("Plan output: %s", cmd.output.c_str());
+    if (!all_ok) {
+        for (const CommandPlan::Step& step : cmd.plan.steps()) {
+            if (step.state != CommandPlan::State::Done) {
+                LOG_W("Plan step %s (%s) %s: %s", step.id.c_str(), step.command.c_str(),
+                      CommandPlan::stateName(step.state), step.output.c_str());
+            }
+        }
+    }
+
+    // All step outputs go through ONE refinement request
+    if (!cmd.needs_refinement) {
+        for (const CommandPlan::Step& step : cmd.plan.steps()) {
+            VoiceCommand probe(step.command, step.args, "", "", step.output);
+            if (step.state == CommandPlan::State::Done && shouldRefineOutput(probe)) {
+                cmd.needs_refinement = true;
+                break;
+            }
+        }
+        LOG_I("Using heuristic for plan refinement decision: %s", cmd.needs_refinement ? "true" : "false");
+    }
+
+    if (cmd.needs_refinement) {
+        if (refineCommandOutput(cmd) && !cmd.refined_output.empty()) {
+            cmd.text = cmd.refined_output;
+            LOG_I("Using refined output: %s", cmd.refined_output.c_str());
+        } else {
+            LOG_W("Refinement failed, using original output");
+        }
+    }
+    LOG_I("Plan of %u commands handled with %u LLM requests",
+          (unsigned)cmd.plan.size(), cmd.needs_refinement ? 2u : 1u);
+}
+
 // Ollama API helpers
 bool VoiceAssistant::fetchOllamaModels(const std::string& base_url, std::vector<std::string>& models) {
     models.clear();
@@ -1874,100 +2714,60 @@ bool VoiceAssistant::fetchOllamaModels(const std::string& base_url, std::vector<
 
     LOG_I("Ollama tags endpoint: %s", ollama_tags_url.c_str());
 
-    // Buffer for response
-    PsramString response_buffer;
-    response_buffer.reserve(4096);
-
-    // HTTP client event handler
-    auto http_event_handler = [](esp_http_client_event_t *evt) -> esp_err_t {
-        PsramString* response = static_cast<PsramString*>(evt->user_data);
-        switch(evt->event_id) {
-            case HTTP_EVENT_ON_DATA:
-                if (response && evt->data_len > 0) {
-                    response->append((char*)evt->data, evt->data_len);
-                }
-                break;
-            default:
-                break;
-        }
-        return ESP_OK;
-    };
-
     // Verify WiFi connectivity before HTTP/HTTPS request
     if (!WiFi.isConnected()) {
         LOG_E("WiFi not connected, cannot fetch Ollama models");
         return false;
     }
 
-    // Configure HTTP client
-    esp_http_client_config_t config = {};
-    config.url = ollama_tags_url.c_str();
-    config.method = HTTP_METHOD_GET;
-    config.event_handler = http_event_handler;
-    config.user_data = &response_buffer;
-    config.timeout_ms = 10000;  // 10 second timeout
-    config.buffer_size = 4096;
-    // For HTTPS: skip certificate validation (development mode)
-    config.skip_cert_common_name_check = true;
-    config.use_global_ca_store = false;
-
-    esp_http_client_handle_t client = esp_http_client_init(&config);
+    // Pooled HTTP client: same host as the chat endpoint
+    HttpClientPool::Options options;
+    options.stage = "models";
+    options.method = HTTP_METHOD_GET;
+    options.timeout_ms = 10000;  // 10 second timeout
+    HttpClientPool& pool = HttpClientPool::getInstance();
+    esp_http_client_handle_t client = pool.acquire(ollama_tags_url, options);
     if (!client) {
         LOG_E("Failed to initialize HTTP client");
         return false;
     }
 
     // Perform request
-    esp_err_t err = esp_http_client_perform(client);
-    if (err != ESP_OK) {
-        LOG_E("HTTP request failed: %s", esp_err_to_name(err));
-        esp_http_client_cleanup(client);
+    int content_length = -1;
+    const int status_code = pool.request(client, nullptr, 0, content_length);
+    if (status_code < 0) {
+        LOG_E("HTTP request to %s failed", ollama_tags_url.c_str());
+        pool.release(client);
         return false;
     }
 
-    int status_code = esp_http_client_get_status_code(client);
-    LOG_I("HTTP Status: %d", status_code);
+    // Ollama format: {"models": [{"name": "llama3.2:3b", ...}, {"name": "mistral:7b", ...}]}
+    JsonPathExtractor json;
+    json.addPath("models[*].name");
+    json.setCallback([&models](size_t, JsonPathExtractor::Type type, const std::string& name) {
+        if (type == JsonPathExtractor::Type::String) {
+            models.push_back(name);
+            LOG_I("  - %s", name.c_str());
+        }
+    });
+    PsramString error_body;
+    const size_t body_bytes = readJsonResponse(client, status_code, json, error_body);
+    LOG_I("HTTP Status: %d, body %u bytes", status_code, (unsigned)body_bytes);
 
-    esp_http_client_cleanup(client);
+    pool.release(client);
 
     if (status_code != 200) {
         LOG_E("Ollama API returned error status: %d", status_code);
-        LOG_E("Response: %s", response_buffer.c_str());
+        LOG_E("Response: %s", error_body.c_str());
         return false;
     }
 
-    LOG_I("Ollama response: %s", response_buffer.c_str());
-
-    // Parse JSON response
-    // Ollama format: {"models": [{"name": "llama3.2:3b", ...}, {"name": "mistral:7b", ...}]}
-    cJSON* root = cJSON_Parse(response_buffer.c_str());
-    if (!root) {
+    if (!json.finish()) {
         LOG_E("Failed to parse Ollama response JSON");
+        models.clear();
         return false;
     }
-
-    cJSON* models_array = cJSON_GetObjectItem(root, "models");
-    if (!models_array || !cJSON_IsArray(models_array)) {
-        LOG_E("Invalid response format (missing 'models' array)");
-        cJSON_Delete(root);
-        return false;
-    }
-
-    int model_count = cJSON_GetArraySize(models_array);
-    LOG_I("Found %d models", model_count);
-
-    for (int i = 0; i < model_count; i++) {
-        cJSON* model_item = cJSON_GetArrayItem(models_array, i);
-        if (!model_item) continue;
-
-        cJSON* name = cJSON_GetObjectItem(model_item, "name");
-        if (name && cJSON_IsString(name)) {
-            models.push_back(name->valuestring);
-            LOG_I("  - %s", name->valuestring);
-        }
-    }
-
-    cJSON_Delete(root);
+    LOG_I("Found %u models", (unsigned)models.size());
 
     if (models.empty()) {
         LOG_W("No models found in Ollama API response");
@@ -2074,7 +2874,10 @@ std::string VoiceAssistant::buildRefinementPrompt(const VoiceCommand& cmd) {
     }
 
     // What command was executed?
-    if (!cmd.command.empty()) {
+    if (!cmd.plan.empty()) {
+        prompt += "Il sistema ha eseguito " + std::to_string(cmd.plan.size()) +
+                  " comandi; l'output riporta per ognuno [id] comando: esito, poi il suo risultato\n\n";
+    } else if (!cmd.command.empty()) {
         prompt += "Il sistema ha eseguito il comando: " + cmd.command;
         if (!cmd.args.empty() && !cmd.args[0].empty()) {
             // Show only first 100 chars of args to avoid huge prompts
@@ -2104,6 +2907,31 @@ std::string VoiceAssistant::buildRefinementPrompt(const VoiceCommand& cmd) {
     return prompt;
 }
 
+bool VoiceAssistant::renderOutputLocally(VoiceCommand& cmd) {
+    ResponseTemplates& templates = ResponseTemplates::getInstance();
+    if (cmd.plan.empty()) {
+        return templates.render(cmd.command, cmd.args, cmd.output, cmd.transcription, cmd.refined_output);
+    }
+
+    // Plans: every step with output needs a template, otherwise the LLM phrases them together
+    std::string combined;
+    for (const CommandPlan::Step& step : cmd.plan.steps()) {
+        if (step.state != CommandPlan::State::Done || step.output.empty()) {
+            continue;
+        }
+        std::string phrase;
+        if (!templates.render(step.command, step.args, step.output, cmd.transcription, phrase)) {
+            return false;
+        }
+        combined += combined.empty() ? phrase : " " + phrase;
+    }
+    if (combined.empty()) {
+        return false;
+    }
+    cmd.refined_output = std::move(combined);
+    return true;
+}
+
 bool VoiceAssistant::refineCommandOutput(VoiceCommand& cmd) {
     if (cmd.output.empty() || !cmd.needs_refinement) {
         LOG_W("refineCommandOutput called but output empty or doesn't need refinement");
@@ -2113,6 +2941,13 @@ bool VoiceAssistant::refineCommandOutput(VoiceCommand& cmd) {
     LOG_I("Refining command output (size: %zu bytes, extract: %s)",
           cmd.output.size(), cmd.refinement_extract_field.c_str());
 
+    // A matching response template phrases the output without a second LLM round trip
+    if (cmd.refinement_extract_field != "full" && cmd.refinement_extract_field != "json" &&
+        renderOutputLocally(cmd)) {
+        LOG_I("Refined locally with a response template: %s", cmd.refined_output.c_str());
+        return true;
+    }
+
     // Build refinement prompt
     std::string refinement_prompt = buildRefinementPrompt(cmd);
 
@@ -2159,178 +2994,37 @@ bool VoiceAssistant::refineCommandOutput(VoiceCommand& cmd) {
 }
 
 // ===== NEW INDEPENDENT API IMPLEMENTATION =====
+// Requests are queued on AsyncRequestManager, which runs them on its worker pool
 
-// Request storage for unified API
-static std::unordered_map<std::string, VoiceAssistant::RequestResult> g_request_results;
-static std::mutex g_request_results_mutex;
-static uint32_t g_request_counter = 0;
-static std::mutex g_request_counter_mutex;
-
-std::string generateRequestId() {
-    std::lock_guard<std::mutex> lock(g_request_counter_mutex);
-    return "req_" + std::to_string(millis()) + "_" + std::to_string(g_request_counter++);
+static bool asyncRequestsReady() {
+    AsyncRequestManager& manager = AsyncRequestManager::getInstance();
+    return manager.isRunning() || manager.begin();
 }
 
-bool VoiceAssistant::submitSTT(const std::string& audio_file, std::string& request_id) {
-    if (!initialized_) {
-        LOG_E("VoiceAssistant not initialized");
-        return false;
-    }
-
-    if (audio_file.empty()) {
-        LOG_E("Empty audio file path");
-        return false;
-    }
-
-    request_id = generateRequestId();
-    LOG_I("Submitting STT request %s for file: %s", request_id.c_str(), audio_file.c_str());
-
-    // Create result entry
-    {
-        std::lock_guard<std::mutex> lock(g_request_results_mutex);
-        RequestResult result;
-        result.status = RequestStatus::PENDING;
-        result.created_at_ms = millis();
-        g_request_results[request_id] = result;
-    }
-
-    // Queue for STT processing - add file to pending recordings
-    {
-        std::lock_guard<std::mutex> lock(pending_recordings_mutex_);
-        pending_recordings_.push(audio_file);
-    }
-
-    // Notify STT task
-    if (sttTask_) {
-        xTaskNotifyGive(sttTask_);
+static VoiceAssistant::RequestStatus toRequestStatus(AsyncRequestManager::RequestStatus status) {
+    switch (status) {
+        case AsyncRequestManager::RequestStatus::PENDING: return VoiceAssistant::RequestStatus::PENDING;
+        case AsyncRequestManager::RequestStatus::PROCESSING: return VoiceAssistant::RequestStatus::PROCESSING;
+        case AsyncRequestManager::RequestStatus::COMPLETED: return VoiceAssistant::RequestStatus::COMPLETED;
+        case AsyncRequestManager::RequestStatus::TIMEOUT: return VoiceAssistant::RequestStatus::TIMEOUT;
+        default: return VoiceAssistant::RequestStatus::FAILED;
     }
+}
 
-    return true;
+bool VoiceAssistant::submitSTT(const std::string& audio_file, std::string& request_id) {
+    return asyncRequestsReady() && AsyncRequestManager::getInstance().submitSTT(audio_file, request_id);
 }
 
 bool VoiceAssistant::submitLLM(const std::string& text, std::string& request_id) {
-    if (!initialized_) {
-        LOG_E("VoiceAssistant not initialized");
-        return false;
-    }
-
-    if (text.empty()) {
-        LOG_E("Empty text message");
-        return false;
-    }
-
-    request_id = generateRequestId();
-    LOG_I("Submitting LLM request %s for text: %s", request_id.c_str(), text.c_str());
-
-    // Create result entry
-    {
-        std::lock_guard<std::mutex> lock(g_request_results_mutex);
-        RequestResult result;
-        result.status = RequestStatus::PENDING;
-        result.created_at_ms = millis();
-        g_request_results[request_id] = result;
-    }
-
-    // Add to conversation history
-    ConversationBuffer::getInstance().addUserMessage(text);
-
-    // Send text directly to transcription queue (bypass STT)
-    std::string* text_copy = new std::string(text);
-    if (xQueueSend(transcriptionQueue_, &text_copy, pdMS_TO_TICKS(1000)) != pdPASS) {
-        LOG_W("Transcription queue full, discarding text");
-        delete text_copy;
-        return false;
-    }
-
-    return true;
+    return asyncRequestsReady() && AsyncRequestManager::getInstance().submitLLM(text, request_id);
 }
 
 bool VoiceAssistant::submitTTS(const std::string& text, std::string& request_id) {
-    if (!initialized_) {
-        LOG_E("VoiceAssistant not initialized");
-        return false;
-    }
-
-    if (text.empty()) {
-        LOG_E("Empty text for TTS");
-        return false;
-    }
-
-    if (WiFi.status() != WL_CONNECTED) {
-        LOG_E("WiFi not connected - cannot submit TTS request");
-        return false;
-    }
-
-    request_id = generateRequestId();
-    LOG_I("Submitting TTS request %s for text: %s", request_id.c_str(), text.c_str());
-
-    // Create result entry and mark as processing (TTS is synchronous)
-    std::string output_file;
-    bool success = makeTTSRequest(text, output_file);
-
-    {
-        std::lock_guard<std::mutex> lock(g_request_results_mutex);
-        RequestResult result;
-        result.status = success ? RequestStatus::COMPLETED : RequestStatus::FAILED;
-        result.output = output_file;
-        result.created_at_ms = millis();
-        result.completed_at_ms = millis();
-        if (!success) {
-            result.error_message = "TTS synthesis failed";
-        }
-        g_request_results[request_id] = result;
-    }
-
-    LOG_I("TTS request %s completed: %s", request_id.c_str(), success ? "SUCCESS" : "FAILED");
-    return success;
+    return asyncRequestsReady() && AsyncRequestManager::getInstance().submitTTS(text, request_id);
 }
 
 bool VoiceAssistant::submitCommand(const std::string& command, const std::vector<std::string>& args, std::string& request_id) {
-    if (!initialized_) {
-        LOG_E("VoiceAssistant not initialized");
-        return false;
-    }
-
-    if (command.empty()) {
-        LOG_E("Empty command name");
-        return false;
-    }
-
-    request_id = generateRequestId();
-    LOG_I("Submitting command request %s: %s", request_id.c_str(), command.c_str());
-
-    // Create result entry
-    {
-        std::lock_guard<std::mutex> lock(g_request_results_mutex);
-        RequestResult result;
-        result.status = RequestStatus::PROCESSING;
-        result.created_at_ms = millis();
-        g_request_results[request_id] = result;
-    }
-
-    // Execute command (synchronous)
-    CommandResult cmd_result;
-    if (command == "lua_script" && !args.empty()) {
-        // Execute as Lua script
-        cmd_result = executeLuaScript(args[0]);
-    } else {
-        // Execute via CommandCenter
-        cmd_result = CommandCenter::getInstance().executeCommand(command, args);
-    }
-
-    // Update result
-    {
-        std::lock_guard<std::mutex> lock(g_request_results_mutex);
-        if (g_request_results.find(request_id) != g_request_results.end()) {
-            g_request_results[request_id].status = cmd_result.success ? RequestStatus::COMPLETED : RequestStatus::FAILED;
-            g_request_results[request_id].output = cmd_result.message;
-            g_request_results[request_id].error_message = cmd_result.success ? "" : cmd_result.message;
-            g_request_results[request_id].completed_at_ms = millis();
-        }
-    }
-
-    LOG_I("Command request %s completed: %s", request_id.c_str(), cmd_result.success ? "SUCCESS" : "FAILED");
-    return cmd_result.success;
+    return asyncRequestsReady() && AsyncRequestManager::getInstance().submitCommand(command, args, request_id);
 }
 
 bool VoiceAssistant::getRequestStatus(const std::string& request_id, RequestResult& result) {
@@ -2339,14 +3033,18 @@ bool VoiceAssistant::getRequestStatus(const std::string& request_id, RequestResu
         return false;
     }
 
-    std::lock_guard<std::mutex> lock(g_request_results_mutex);
-    auto it = g_request_results.find(request_id);
-    if (it == g_request_results.end()) {
+    AsyncRequestManager::RequestResult async_result;
+    if (!AsyncRequestManager::getInstance().getRequestStatus(request_id, async_result)) {
         LOG_W("Request ID not found: %s", request_id.c_str());
         return false;
     }
 
-    result = it->second;
+    result.status = toRequestStatus(async_result.status);
+    result.output = async_result.output;
+    result.command_response = async_result.response;
+    result.error_message = async_result.error_message;
+    result.created_at_ms = async_result.created_at_ms;
+    result.completed_at_ms = async_result.completed_at_ms;
     return true;
 }
 
@@ -2355,22 +3053,23 @@ bool VoiceAssistant::cancelRequest(const std::string& request_id) {
         LOG_E("Empty request ID");
         return false;
     }
+    return AsyncRequestManager::getInstance().cancelRequest(request_id);
+}
 
-    std::lock_guard<std::mutex> lock(g_request_results_mutex);
-    auto it = g_request_results.find(request_id);
-    if (it == g_request_results.end()) {
-        LOG_W("Request ID not found: %s", request_id.c_str());
+bool VoiceAssistant::transcribeFile(const std::string& audio_file, std::string& transcription) {
+    if (!initialized_) {
+        LOG_E("VoiceAssistant not initialized");
         return false;
     }
+    return makeWhisperRequest(audio_file, transcription);
+}
 
-    if (it->second.status == RequestStatus::PENDING || it->second.status == RequestStatus::PROCESSING) {
-        it->second.status = RequestStatus::FAILED;
-        it->second.error_message = "Request cancelled by user";
-        LOG_I("Request %s cancelled", request_id.c_str());
-        return true;
+bool VoiceAssistant::synthesizeToFile(const std::string& text, std::string& output_file) {
+    if (!initialized_) {
+        LOG_E("VoiceAssistant not initialized");
+        return false;
     }
-
-    return false;
+    return makeTTSRequest(text, output_file);
 }
 
 // Public API for chat interface
@@ -2401,6 +3100,32 @@ bool VoiceAssistant::sendTextMessage(const std::string& text) {
 }
 
 
+VoiceAssistant::StreamingResponse VoiceAssistant::getStreamingResponse() const {
+    std::lock_guard<std::mutex> lock(streaming_response_mutex_);
+    return streaming_response_;
+}
+
+void VoiceAssistant::beginStreamingResponse() {
+    std::lock_guard<std::mutex> lock(streaming_response_mutex_);
+    streaming_response_.sequence++;
+    streaming_response_.active = true;
+    streaming_response_.command_ready = false;
+    streaming_response_.text.clear();
+}
+
+void VoiceAssistant::updateStreamingResponse(const std::string& text, bool command_ready) {
+    std::lock_guard<std::mutex> lock(streaming_response_mutex_);
+    streaming_response_.sequence++;
+    streaming_response_.command_ready = command_ready;
+    streaming_response_.text = text;
+}
+
+void VoiceAssistant::endStreamingResponse() {
+    std::lock_guard<std::mutex> lock(streaming_response_mutex_);
+    streaming_response_.sequence++;
+    streaming_response_.active = false;
+}
+
 bool VoiceAssistant::getLastResponse(VoiceCommand& response, uint32_t timeout_ms) {
     if (!initialized_) {
         LOG_E("VoiceAssistant not initialized");
@@ -2497,6 +3222,14 @@ std::string VoiceAssistant::listLuaCommands() const {
 
         // TTS API
         "tts.speak(text) - Text-to-speech synthesis",
+        "tts.play(text[, save]) - Speak while downloading (save=true also returns file path)",
+        "tts.prewarm([n]) - Re-synthesize up to n frequent cached phrases for the current voice",
+        "tts.cache_stats() - TTS cache hits/misses/entries/bytes",
+
+        // Events API
+        "events.on(name, fn[, label]) - Call fn(name, payload) on each event (wifi.connected, audio.title, time.minute, settings.*); returns handler id",
+        "events.off(id) - Remove an event handler",
+        "events.emit(name[, payload]) - Publish an event",
 
         // Documentation API
         "docs.api.gpio() - Read GPIO API documentation",
@@ -2509,6 +3242,7 @@ std::string VoiceAssistant::listLuaCommands() const {
         "docs.api.system() - Read System API documentation",
         "docs.api.calendar() - Read Calendar API documentation",
         "docs.api.tts() - Read TTS API documentation",
+        "docs.api.events() - Read Events API documentation",
         "docs.reference.cities() - Read cities reference",
         "docs.reference.weather() - Read weather API reference",
         "docs.examples.weather_query() - Read weather query examples",
@@ -2542,98 +3276,148 @@ std::string VoiceAssistant::listLuaCommands() const {
 
 std::string VoiceAssistant::getSystemPrompt() const {
     const SettingsSnapshot& settings = SettingsManager::getInstance().getSnapshot();
-    const VoiceAssistantPromptDefinition prompt_definition = getPromptDefinition();
-    return composeSystemPrompt(settings.voiceAssistantSystemPromptTemplate, prompt_definition);
+    const uint32_t definition_generation = getPromptDefinitionGeneration();
+    const uint32_t command_generation = CommandCenter::getInstance().getGeneration();
+
+    std::lock_guard<std::mutex> lock(system_prompt_mutex_);
+    SystemPromptCache& cache = system_prompt_cache_;
+    if (!cache.compiled_valid ||
+        cache.definition_generation != definition_generation ||
+        cache.command_generation != command_generation ||
+        cache.override_template != settings.voiceAssistantSystemPromptTemplate) {
+        const VoiceAssistantPromptDefinition prompt_definition = getPromptDefinition();
+        compileSystemPrompt(buildPromptSource(settings.voiceAssistantSystemPromptTemplate, prompt_definition),
+                            cache.compiled);
+        cache.definition_generation = definition_generation;
+        cache.command_generation = command_generation;
+        cache.override_template = settings.voiceAssistantSystemPromptTemplate;
+        cache.compiled_valid = true;
+        cache.rendered_valid = false;
+        LOG_I("System prompt compiled: %u literal bytes, %u slots",
+              (unsigned)cache.compiled.literalBytes(), (unsigned)cache.compiled.slotCount());
+    }
+
+    // Bonded hosts connect and disconnect without any counter, so they are
+    // compared by value
+    std::string host_list = bleHostList();
+    {
+        std::lock_guard<std::mutex> variables_lock(prompt_variables_mutex_);
+        if (cache.rendered_valid &&
+            cache.variables_generation == prompt_variables_generation_ &&
+            cache.host_list == host_list) {
+            return cache.rendered;
+        }
+        renderSystemPromptLocked(cache.compiled, host_list, cache.rendered);
+        cache.variables_generation = prompt_variables_generation_;
+    }
+    cache.host_list = std::move(host_list);
+    cache.rendered_valid = true;
+    return cache.rendered;
 }
 
 std::string VoiceAssistant::composeSystemPrompt(const std::string& override_template,
                                               const VoiceAssistantPromptDefinition& prompt_definition) const {
-    std::string prompt_template = override_template.empty()
-        ? prompt_definition.prompt_template
-        : override_template;
-    if (prompt_template.empty()) {
-        prompt_template = VOICE_ASSISTANT_FALLBACK_PROMPT_TEMPLATE;
-    }
+    PromptTemplate compiled;
+    compileSystemPrompt(buildPromptSource(override_template, prompt_definition), compiled);
 
-    auto commands = CommandCenter::getInstance().listCommands();
-    std::string command_list;
-    for (size_t i = 0; i < commands.size(); ++i) {
-        if (i > 0) {
-            command_list += "; ";
-        }
-        command_list += commands[i].name;
-        if (!commands[i].description.empty()) {
-            command_list += " (" + commands[i].description + ")";
-        }
-    }
+    std::string prompt;
+    const std::string host_list = bleHostList();
+    std::lock_guard<std::mutex> lock(prompt_variables_mutex_);
+    renderSystemPromptLocked(compiled, host_list, prompt);
+    return prompt;
+}
 
-    if (command_list.empty()) {
-        command_list = "none";
+std::string VoiceAssistant::buildPromptSource(const std::string& override_template,
+                                              const VoiceAssistantPromptDefinition& prompt_definition) const {
+    std::string source = override_template.empty()
+        ? prompt_definition.prompt_template
+        : override_template;
+    if (source.empty()) {
+        source = VOICE_ASSISTANT_FALLBACK_PROMPT_TEMPLATE;
     }
 
-    std::string host_list;
-    BleHidManager& ble = BleHidManager::getInstance();
-    if (!ble.isInitialized()) {
-        host_list = "unavailable (BLE not initialized)";
-    } else {
-        auto bonded_peers = ble.getBondedPeers();
-        if (bonded_peers.empty()) {
-            host_list = "none";
-        } else {
-            for (size_t i = 0; i < bonded_peers.size(); ++i) {
-                if (i > 0) {
-                    host_list += ", ";
-                }
-                host_list += bonded_peers[i].address.toString();
-                host_list += bonded_peers[i].isConnected ? " (connected)" : " (not connected)";
-            }
-        }
+    if (source.find(VOICE_ASSISTANT_BLE_HOSTS_PLACEHOLDER) == std::string::npos) {
+        source += " Bonded BLE hosts: ";
+        source += VOICE_ASSISTANT_BLE_HOSTS_PLACEHOLDER;
+        source += ".";
     }
 
-    std::string prompt = prompt_template;
-
-    // Replace {{LUA_API_LIST}} placeholder (includes all Lua APIs + CommandCenter commands)
-    const std::string lua_api_list = listLuaCommands();
-    const std::string lua_placeholder = VOICE_ASSISTANT_LUA_API_LIST_PLACEHOLDER;
-    const size_t lua_pos = prompt.find(lua_placeholder);
-    if (lua_pos != std::string::npos) {
-        prompt.replace(lua_pos, lua_placeholder.length(), lua_api_list);
+    for (const auto& section : prompt_definition.sections) {
+        source += section;
     }
+    return source;
+}
+
+void VoiceAssistant::compileSystemPrompt(const std::string& source, PromptTemplate& compiled) const {
+    // The command lists only change with CommandCenter registrations, so they
+    // are folded into the literals at compile time
+    const std::string lua_name = placeholderName(VOICE_ASSISTANT_LUA_API_LIST_PLACEHOLDER);
+    const std::string command_name = placeholderName(VOICE_ASSISTANT_COMMAND_LIST_PLACEHOLDER);
+    std::string lua_api_list;
+    std::string command_list;
 
-    // Legacy: Replace {{COMMAND_LIST}} if still present in old templates
-    const std::string placeholder = VOICE_ASSISTANT_COMMAND_LIST_PLACEHOLDER;
-    const size_t pos = prompt.find(placeholder);
-    if (pos != std::string::npos) {
-        auto commands = CommandCenter::getInstance().listCommands();
-        std::string command_list;
-        for (size_t i = 0; i < commands.size(); ++i) {
-            if (i > 0) {
-                command_list += "; ";
+    compiled.compile(source, [&](const std::string& name) -> const std::string* {
+        if (name == lua_name) {
+            if (lua_api_list.empty()) {
+                lua_api_list = listLuaCommands();
             }
-            command_list += commands[i].name;
-            if (!commands[i].description.empty()) {
-                command_list += " (" + commands[i].description + ")";
+            return &lua_api_list;
+        }
+        if (name == command_name) {
+            if (command_list.empty()) {
+                auto commands = CommandCenter::getInstance().listCommands();
+                for (size_t i = 0; i < commands.size(); ++i) {
+                    if (i > 0) {
+                        command_list += "; ";
+                    }
+                    command_list += commands[i].name;
+                    if (!commands[i].description.empty()) {
+                        command_list += " (" + commands[i].description + ")";
+                    }
+                }
+                if (command_list.empty()) {
+                    command_list = "none";
+                }
             }
+            return &command_list;
         }
-        if (command_list.empty()) {
-            command_list = "none";
+        return nullptr;
+    });
+}
+
+void VoiceAssistant::renderSystemPromptLocked(const PromptTemplate& compiled,
+                                              const std::string& host_list,
+                                              std::string& out) const {
+    const std::string hosts_name = placeholderName(VOICE_ASSISTANT_BLE_HOSTS_PLACEHOLDER);
+    compiled.render([&](const std::string& name) -> const std::string* {
+        if (name == hosts_name) {
+            return &host_list;
         }
-        prompt.replace(pos, placeholder.length(), command_list);
-    }
+        auto it = prompt_variables_.find(name);
+        return it != prompt_variables_.end() ? &it->second : nullptr;
+    }, out);
+}
 
-    const std::string hosts_placeholder = VOICE_ASSISTANT_BLE_HOSTS_PLACEHOLDER;
-    const size_t hosts_pos = prompt.find(hosts_placeholder);
-    if (hosts_pos != std::string::npos) {
-        prompt.replace(hosts_pos, hosts_placeholder.length(), host_list);
-    } else {
-        prompt += " Bonded BLE hosts: " + host_list + ".";
+std::string VoiceAssistant::bleHostList() const {
+    BleHidManager& ble = BleHidManager::getInstance();
+    if (!ble.isInitialized()) {
+        return "unavailable (BLE not initialized)";
     }
 
-    for (const auto& section : prompt_definition.sections) {
-        prompt += section;
+    auto bonded_peers = ble.getBondedPeers();
+    if (bonded_peers.empty()) {
+        return "none";
     }
 
-    return resolvePromptVariables(std::move(prompt));
+    std::string host_list;
+    for (size_t i = 0; i < bonded_peers.size(); ++i) {
+        if (i > 0) {
+            host_list += ", ";
+        }
+        host_list += bonded_peers[i].address.toString();
+        host_list += bonded_peers[i].isConnected ? " (connected)" : " (not connected)";
+    }
+    return host_list;
 }
 
 void VoiceAssistant::reloadPromptDefinition() {
@@ -2746,7 +3530,12 @@ void VoiceAssistant::setSystemPromptVariable(const std::string& key, const std::
         return;
     }
     std::lock_guard<std::mutex> lock(prompt_variables_mutex_);
+    auto it = prompt_variables_.find(key);
+    if (it != prompt_variables_.end() && it->second == value) {
+        return;
+    }
     prompt_variables_[key] = value;
+    prompt_variables_generation_++;
 }
 
 void VoiceAssistant::clearSystemPromptVariable(const std::string& key) {
@@ -2754,12 +3543,15 @@ void VoiceAssistant::clearSystemPromptVariable(const std::string& key) {
         return;
     }
     std::lock_guard<std::mutex> lock(prompt_variables_mutex_);
-    prompt_variables_.erase(key);
+    if (prompt_variables_.erase(key) > 0) {
+        prompt_variables_generation_++;
+    }
 }
 
 void VoiceAssistant::clearSystemPromptVariables() {
     std::lock_guard<std::mutex> lock(prompt_variables_mutex_);
     prompt_variables_.clear();
+    prompt_variables_generation_++;
 }
 
 std::unordered_map<std::string, std::string> VoiceAssistant::getSystemPromptVariables() const {
@@ -2768,20 +3560,17 @@ std::unordered_map<std::string, std::string> VoiceAssistant::getSystemPromptVari
 }
 
 std::string VoiceAssistant::resolvePromptVariables(std::string prompt) const {
-    std::lock_guard<std::mutex> lock(prompt_variables_mutex_);
-    for (const auto& pair : prompt_variables_) {
-        const std::string& key = pair.first;
-        const std::string& value = pair.second;
-        if (key.empty()) {
-            continue;
-        }
-        const std::string placeholder = "{{" + key + "}}";
-        size_t pos = 0;
-        while ((pos = prompt.find(placeholder, pos)) != std::string::npos) {
-            prompt.replace(pos, placeholder.length(), value);
-            pos += value.length();
-        }
+    PromptTemplate compiled;
+    compiled.compile(prompt);
+    if (compiled.slotCount() == 0) {
+        return prompt;
     }
+
+    std::lock_guard<std::mutex> lock(prompt_variables_mutex_);
+    compiled.render([this](const std::string& name) -> const std::string* {
+        auto it = prompt_variables_.find(name);
+        return it != prompt_variables_.end() ? &it->second : nullptr;
+    }, prompt);
     return prompt;
 }
 
@@ -2814,19 +3603,25 @@ bool VoiceAssistant::executeAutoPopulateCommands(const std::string& raw_json, st
         return false;
     }
 
-    if (definition.auto_populate.empty()) {
-        return true; // No commands to execute
-    }
-
-    CommandCenter& cc = CommandCenter::getInstance();
+    populatePromptVariables(definition.auto_populate);
+    return true;
+}
 
-    for (const auto& auto_cmd : definition.auto_populate) {
-        LOG_I("[VoiceAssistant] Auto-populating with command: %s", auto_cmd.command.c_str());
+void VoiceAssistant::populatePromptVariables(const std::vector<AutoPopulateCommand>& commands) {
+    if (commands.empty()) {
+        return; // No commands to execute
+    }
 
-        CommandResult result = cc.executeCommand(auto_cmd.command, auto_cmd.args);
+    const uint32_t start = millis();
+    const std::vector<AutoPopulateCache::Result> results = auto_populate_cache_.populate(
+        commands, [this](const AutoPopulateCommand& auto_cmd, AutoPopulateCache::Value& value) {
+            LOG_I("Auto-populating with command: %s", auto_cmd.command.c_str());
+            CommandResult result = runCommand(auto_cmd.command, auto_cmd.args);
+            if (!result.success) {
+                LOG_W("Auto-populate command failed: %s - %s", auto_cmd.command.c_str(), result.message.c_str());
+                return false;
+            }
 
-        if (result.success) {
-            // Create a VoiceCommand to capture variables
             VoiceCommand cmd;
             cmd.command = auto_cmd.command;
             cmd.args = auto_cmd.args;
@@ -2835,25 +3630,60 @@ bool VoiceAssistant::executeAutoPopulateCommands(const std::string& raw_json, st
             // Check if output should be refined
             if (shouldRefineOutput(cmd)) {
                 if (!refineCommandOutput(cmd)) {
-                    LOG_W("[VoiceAssistant] Failed to refine auto-populate command output");
+                    LOG_W("Failed to refine auto-populate command output");
                 }
             }
+            value.output = std::move(cmd.output);
+            value.refined_output = std::move(cmd.refined_output);
+            return true;
+        });
 
-            captureCommandOutputVariables(cmd);
-            LOG_I("[VoiceAssistant] Auto-populate completed: %s", auto_cmd.command.c_str());
-        } else {
-            LOG_W("[VoiceAssistant] Auto-populate command failed: %s - %s",
-                  auto_cmd.command.c_str(), result.message.c_str());
+    // Captured here, in prompt order, whichever worker ran the command
+    for (size_t i = 0; i < commands.size(); ++i) {
+        if (!results[i].valid) {
+            continue;
         }
-    }
+        VoiceCommand cmd;
+        cmd.command = commands[i].command;
+        cmd.args = commands[i].args;
+        cmd.output = results[i].value.output;
+        cmd.refined_output = results[i].value.refined_output;
+        captureCommandOutputVariables(cmd);
+    }
+    LOG_I("Auto-populate: %u commands ready in %u ms", (unsigned)commands.size(), (unsigned)(millis() - start));
+}
 
-    return true;
+std::vector<AutoPopulateCache::Stats> VoiceAssistant::getAutoPopulateStats() const {
+    return auto_populate_cache_.getStats();
 }
 
 // LuaSandbox implementation
+namespace {
+int luaPanic(lua_State* L) {
+    const char* message = lua_tostring(L, -1);
+    LOG_E("Lua panic: %s", message ? message : "unknown");
+    return 0;  // Aborts
+}
+} // namespace
+
+constexpr size_t VoiceAssistant::LuaSandbox::kMemoryLimit;
+constexpr size_t VoiceAssistant::LuaSandbox::kRecycleFootprint;
+
 VoiceAssistant::LuaSandbox::LuaSandbox() : L(nullptr) {
-    L = luaL_newstate();
+    createState();
+}
+
+VoiceAssistant::LuaSandbox::~LuaSandbox() {
+    if (L) {
+        lua_close(L);
+        L = nullptr;
+    }
+}
+
+void VoiceAssistant::LuaSandbox::createState() {
+    L = lua_newstate(LuaArena::alloc, &arena_);
     if (L) {
+        lua_atpanic(L, luaPanic);
         luaL_openlibs(L);
         setupSandbox();
     } else {
@@ -2861,11 +3691,19 @@ VoiceAssistant::LuaSandbox::LuaSandbox() : L(nullptr) {
     }
 }
 
-VoiceAssistant::LuaSandbox::~LuaSandbox() {
+bool VoiceAssistant::LuaSandbox::needsRecycle() const {
+    return arena_.stats().failures > 0 || arena_.stats().footprint > kRecycleFootprint;
+}
+
+void VoiceAssistant::LuaSandbox::recycle() {
     if (L) {
-        lua_close(L);
+        // Run the finalizers (files a script left open) but skip freeing every object
+        lua_gc(L, LUA_GCCOLLECT, 0);
         L = nullptr;
     }
+    arena_.drop();
+    output_buffer_.clear();
+    createState();
 }
 
 void VoiceAssistant::LuaSandbox::setupSandbox() {
@@ -3050,6 +3888,28 @@ void VoiceAssistant::LuaSandbox::setupSandbox() {
         tts = {
             speak = function(text)
                 return esp32_tts_speak(text)
+            end,
+            play = function(text, save)
+                return esp32_tts_play(text, save)
+            end,
+            prewarm = function(n)
+                return esp32_tts_prewarm(n)
+            end,
+            cache_stats = function()
+                return esp32_tts_cache_stats()
+            end
+        }
+
+        -- Events API (handlers run on the Lua scheduler)
+        events = {
+            on = function(name, fn, label)
+                return esp32_events_on(name, fn, label)
+            end,
+            off = function(id)
+                return esp32_events_off(id)
+            end,
+            emit = function(name, payload)
+                return esp32_events_emit(name, payload)
             end
         }
 
@@ -3065,7 +3925,8 @@ void VoiceAssistant::LuaSandbox::setupSandbox() {
                 led = function() return memory.read_file("docs/api/led.json") end,
                 system = function() return memory.read_file("docs/api/system.json") end,
                 calendar = function() return memory.read_file("docs/api/calendar.json") end,
-                tts = function() return memory.read_file("docs/api/tts.json") end
+                tts = function() return memory.read_file("docs/api/tts.json") end,
+                events = function() return memory.read_file("docs/api/events.json") end
             },
             reference = {
                 cities = function() return memory.read_file("docs/reference/cities.json") end,
@@ -3131,8 +3992,16 @@ void VoiceAssistant::LuaSandbox::setupSandbox() {
     lua_register(L, "esp32_cjson_encode", lua_cjson_encode);
     lua_register(L, "esp32_cjson_decode", lua_cjson_decode);
 
+    // Event handlers
+    lua_register(L, "esp32_events_on", lua_events_on);
+    lua_register(L, "esp32_events_off", lua_events_off);
+    lua_register(L, "esp32_events_emit", lua_events_emit);
+
     // TTS function
     lua_register(L, "esp32_tts_speak", lua_tts_speak);
+    lua_register(L, "esp32_tts_play", lua_tts_play);
+    lua_register(L, "esp32_tts_prewarm", lua_tts_prewarm);
+    lua_register(L, "esp32_tts_cache_stats", lua_tts_cache_stats);
 
     // Radio/Audio player functions
     lua_register(L, "esp32_radio_play", lua_radio_play);
@@ -3145,6 +4014,73 @@ void VoiceAssistant::LuaSandbox::setupSandbox() {
 
     // Utility functions
     lua_register(L, "println", lua_println);
+
+    saveBaseline();
+}
+
+namespace {
+constexpr const char* kLuaBaselineKey = "sandbox_baseline";
+} // namespace
+
+void VoiceAssistant::LuaSandbox::saveBaseline() {
+    // Shallow copy of the globals, restored by reset()
+    lua_newtable(L);
+    lua_pushglobaltable(L);
+    lua_pushnil(L);
+    while (lua_next(L, -2) != 0) {
+        lua_pushvalue(L, -2);
+        lua_insert(L, -2);
+        lua_rawset(L, -5);          // baseline[key] = value, leaves key for lua_next
+    }
+    lua_pop(L, 1);
+    lua_setfield(L, LUA_REGISTRYINDEX, kLuaBaselineKey);
+}
+
+void VoiceAssistant::LuaSandbox::reset() {
+    output_buffer_.clear();
+    if (!L) {
+        return;
+    }
+
+    lua_settop(L, 0);
+    lua_getfield(L, LUA_REGISTRYINDEX, kLuaBaselineKey);   // 1: baseline
+    lua_pushglobaltable(L);                                 // 2: globals
+    if (!lua_istable(L, 1)) {
+        lua_settop(L, 0);
+        return;
+    }
+
+    // Drop globals the script defined (clearing fields during lua_next is allowed)
+    lua_pushnil(L);
+    while (lua_next(L, 2) != 0) {
+        lua_pop(L, 1);
+        lua_pushvalue(L, -1);
+        const bool known = lua_rawget(L, 1) != LUA_TNIL;
+        lua_pop(L, 1);
+        if (!known) {
+            lua_pushvalue(L, -1);
+            lua_pushnil(L);
+            lua_rawset(L, 2);
+        }
+    }
+
+    // Put back the ones it replaced or removed
+    lua_pushnil(L);
+    while (lua_next(L, 1) != 0) {
+        lua_pushvalue(L, -2);
+        lua_rawget(L, 2);
+        if (lua_rawequal(L, -1, -2)) {
+            lua_pop(L, 2);
+        } else {
+            lua_pop(L, 1);
+            lua_pushvalue(L, -2);
+            lua_insert(L, -2);
+            lua_rawset(L, 2);
+        }
+    }
+
+    lua_settop(L, 0);
+    lua_gc(L, LUA_GCSTEP, 0);
 }
 
 std::string VoiceAssistant::LuaSandbox::preprocessScript(const std::string& script) {
@@ -3233,69 +4169,61 @@ std::string VoiceAssistant::LuaSandbox::preprocessScript(const std::string& scri
     return output;
 }
 
-CommandResult VoiceAssistant::LuaSandbox::execute(const std::string& script) {
-    if (!L) {
-        return {false, "Lua state not initialized"};
+int VoiceAssistant::LuaSandbox::loadChunk(const std::string& source, bool preprocess, const char* chunkname) {
+    auto& cache = LuaBytecodeCache::getInstance();
+    const uint64_t key = LuaBytecodeCache::makeKey(source, preprocess);
+    if (cache.load(L, key)) {
+        return LUA_OK;
     }
 
+    const int64_t start = esp_timer_get_time();
     // Preprocess script to fix common LLM mistakes
-    std::string processed_script = preprocessScript(script);
-
-    output_buffer_.clear();
-    struct SandboxActivation {
-        LuaSandbox* previous;
-        SandboxActivation(LuaSandbox* current) : previous(s_active_lua_sandbox) {
-            s_active_lua_sandbox = current;
-        }
-        ~SandboxActivation() {
-            s_active_lua_sandbox = previous;
-        }
-    } activation(this);
-
-    int result = luaL_dostring(L, processed_script.c_str());
+    const std::string processed = preprocess ? preprocessScript(source) : source;
+    const int status = luaL_loadbuffer(L, processed.c_str(), processed.size(), chunkname);
+    if (status == LUA_OK) {
+        cache.store(L, key, static_cast<uint32_t>(esp_timer_get_time() - start));
+    }
+    return status;
+}
 
-    if (result != LUA_OK) {
-        const char* error = lua_tostring(L, -1);
-        std::string error_msg = "Lua error: ";
-        error_msg += error ? error : "unknown";
-        lua_pop(L, 1); // Remove error message from stack
+int VoiceAssistant::LuaSandbox::loadScript(const std::string& script) {
+    return loadChunk(script, true, "=lua_script");
+}
 
-        Serial.printf("[LUA] Execution error: %s\n", error_msg.c_str());
-        if (!output_buffer_.empty()) {
-            error_msg += "\nOutput:\n";
-            error_msg += output_buffer_;
-        }
-        return {false, error_msg};
-    }
+VoiceAssistant::LuaSandbox* VoiceAssistant::LuaSandbox::activate(LuaSandbox* sandbox) {
+    LuaSandbox* previous = s_active_lua_sandbox;
+    s_active_lua_sandbox = sandbox;
+    return previous;
+}
 
-    // Capture return value if present on stack
+void VoiceAssistant::LuaSandbox::appendReturnValue(lua_State* L, std::string& output) {
     if (lua_gettop(L) > 0) {
         int type = lua_type(L, -1);
         if (type == LUA_TSTRING) {
             const char* ret_str = lua_tostring(L, -1);
             if (ret_str && strlen(ret_str) > 0) {
-                if (!output_buffer_.empty()) {
-                    output_buffer_ += "\n";
+                if (!output.empty()) {
+                    output += "\n";
                 }
-                output_buffer_ += "Return value:\n";
-                output_buffer_ += ret_str;
+                output += "Return value:\n";
+                output += ret_str;
                 Serial.printf("[LUA] Captured return string: %s\n", ret_str);
             }
         } else if (type == LUA_TNUMBER) {
             lua_Number num = lua_tonumber(L, -1);
-            if (!output_buffer_.empty()) {
-                output_buffer_ += "\n";
+            if (!output.empty()) {
+                output += "\n";
             }
-            output_buffer_ += "Return value: ";
-            output_buffer_ += std::to_string(static_cast<double>(num));
+            output += "Return value: ";
+            output += std::to_string(static_cast<double>(num));
             Serial.printf("[LUA] Captured return number: %.2f\n", static_cast<double>(num));
         } else if (type == LUA_TBOOLEAN) {
             bool bool_val = lua_toboolean(L, -1);
-            if (!output_buffer_.empty()) {
-                output_buffer_ += "\n";
+            if (!output.empty()) {
+                output += "\n";
             }
-            output_buffer_ += "Return value: ";
-            output_buffer_ += bool_val ? "true" : "false";
+            output += "Return value: ";
+            output += bool_val ? "true" : "false";
             Serial.printf("[LUA] Captured return boolean: %s\n", bool_val ? "true" : "false");
         } else if (type == LUA_TTABLE) {
             // Simple table to string (basic implementation)
@@ -3313,15 +4241,62 @@ CommandResult VoiceAssistant::LuaSandbox::execute(const std::string& script) {
                 lua_pop(L, 1);  // remove value, keep key for next iteration
             }
             table_str += "}";
-            if (!output_buffer_.empty()) {
-                output_buffer_ += "\n";
+            if (!output.empty()) {
+                output += "\n";
             }
-            output_buffer_ += "Return value:\n";
-            output_buffer_ += table_str;
+            output += "Return value:\n";
+            output += table_str;
             Serial.printf("[LUA] Captured return table: %s\n", table_str.c_str());
         }
         lua_pop(L, 1);  // Remove return value from stack
     }
+}
+
+CommandResult VoiceAssistant::LuaSandbox::execute(const std::string& script) {
+    if (!L) {
+        return {false, "Lua state not initialized"};
+    }
+
+    output_buffer_.clear();
+    struct SandboxActivation {
+        LuaSandbox* previous;
+        SandboxActivation(LuaSandbox* current) : previous(s_active_lua_sandbox) {
+            s_active_lua_sandbox = current;
+        }
+        ~SandboxActivation() {
+            s_active_lua_sandbox = previous;
+        }
+    } activation(this);
+
+    arena_.resetPeak();
+    const size_t memory_before = arena_.stats().current;
+    int result = loadChunk(script, true, "=lua_script");
+    if (result == LUA_OK) {
+        result = lua_pcall(L, 0, LUA_MULTRET, 0);
+    }
+    Serial.printf("[LUA] Memory: peak +%u bytes, %u bytes live, %u%% fragmentation\n",
+                  static_cast<unsigned>(arena_.stats().peak - memory_before),
+                  static_cast<unsigned>(arena_.stats().current), static_cast<unsigned>(arena_.fragmentation()));
+
+    if (result != LUA_OK) {
+        const char* error = lua_tostring(L, -1);
+        std::string error_msg = "Lua error: ";
+        error_msg += error ? error : "unknown";
+        lua_pop(L, 1); // Remove error message from stack
+        if (result == LUA_ERRMEM) {
+            error_msg += " (script memory limit " + std::to_string(kMemoryLimit / 1024) + " KB)";
+        }
+
+        Serial.printf("[LUA] Execution error: %s\n", error_msg.c_str());
+        if (!output_buffer_.empty()) {
+            error_msg += "\nOutput:\n";
+            error_msg += output_buffer_;
+        }
+        return {false, error_msg};
+    }
+
+    // Capture return value if present on stack
+    appendReturnValue(L, output_buffer_);
 
     Serial.println("[LUA] Script executed successfully");
     const std::string message = output_buffer_.empty() ? "Lua script executed" : output_buffer_;
@@ -3360,13 +4335,20 @@ CommandResult VoiceAssistant::LuaSandbox::executeFile(const std::string& path) {
         }
     } activation(this);
 
-    int result = luaL_dostring(L, script_content.c_str());
+    const std::string chunkname = "@" + path;
+    int result = loadChunk(script_content, false, chunkname.c_str());
+    if (result == LUA_OK) {
+        result = lua_pcall(L, 0, LUA_MULTRET, 0);
+    }
 
     if (result != LUA_OK) {
         const char* error = lua_tostring(L, -1);
         std::string error_msg = "Lua error: ";
         error_msg += error ? error : "unknown";
         lua_pop(L, 1); // Remove error message from stack
+        if (result == LUA_ERRMEM) {
+            error_msg += " (script memory limit " + std::to_string(kMemoryLimit / 1024) + " KB)";
+        }
 
         if (!output_buffer_.empty()) {
             error_msg += "\nOutput:\n";
@@ -3579,11 +4561,69 @@ int VoiceAssistant::LuaSandbox::lua_cjson_decode(lua_State* L) {
     return 1;
 }
 
-// TTS function
-int VoiceAssistant::LuaSandbox::lua_tts_speak(lua_State* L) {
-    const char* text = luaL_checkstring(L, 1);
+// Event handler functions
+int VoiceAssistant::LuaSandbox::lua_events_on(lua_State* L) {
+    const char* name = luaL_checkstring(L, 1);
+    luaL_checktype(L, 2, LUA_TFUNCTION);
+
+    // Handlers outlive the script, so they must live in the scheduler's state
+    if (!LuaScheduler::getInstance().owns(L)) {
+        lua_pushnil(L);
+        lua_pushstring(L, "events.on is only available to scripts run by the Lua scheduler");
+        return 2;
+    }
 
-    // Check available DRAM memory before attempting TTS
+    std::string label;
+    if (lua_isstring(L, 3)) {
+        label = lua_tostring(L, 3);
+    } else {
+        lua_Debug ar;
+        lua_pushvalue(L, 2);
+        lua_getinfo(L, ">S", &ar);
+        label = std::string(ar.short_src) + ":" + std::to_string(ar.linedefined);
+    }
+
+    const uint32_t id = LuaEvents::getInstance().on(L, name, 2, label);
+    if (id == 0) {
+        lua_pushnil(L);
+        lua_pushstring(L, "Too many event handlers");
+        return 2;
+    }
+    lua_pushinteger(L, id);
+    return 1;
+}
+
+int VoiceAssistant::LuaSandbox::lua_events_off(lua_State* L) {
+    const lua_Integer id = luaL_checkinteger(L, 1);
+    lua_pushboolean(L, id > 0 && LuaEvents::getInstance().off(L, static_cast<uint32_t>(id)));
+    return 1;
+}
+
+int VoiceAssistant::LuaSandbox::lua_events_emit(lua_State* L) {
+    const char* name = luaL_checkstring(L, 1);
+    const char* payload = luaL_optstring(L, 2, "");
+    EventRouter::getInstance()->publish(name, const_cast<char*>(payload));
+    lua_pushboolean(L, true);
+    return 1;
+}
+
+// Run a binding's blocking work on a Lua I/O worker when the script runs as a
+// coroutine; the caller then returns lua_yield(L, 0) (no C++ objects may be
+// alive at that point) and the results arrive on resume. Otherwise the work
+// runs inline and `pushed` results are on the stack.
+static bool runBlocking(lua_State* L, const LuaScheduler::IoWork& work, int& pushed) {
+    if (LuaScheduler::getInstance().offload(L, work)) {
+        return true;
+    }
+    LuaCoroutines::Values results;
+    work(results);
+    pushed = LuaCoroutines::push(L, results);
+    return false;
+}
+
+// TTS functions
+// Check available DRAM memory before attempting TTS
+static bool ttsMemoryAvailable() {
     // With reduced DMA buffers (buf_len=96, buf_count=6 for 24kHz):
     // - Actual I2S DMA need: ~2-3KB
     // - I2S initialization overhead: ~5-10KB
@@ -3612,23 +4652,95 @@ int VoiceAssistant::LuaSandbox::lua_tts_speak(lua_State* L) {
         LOG_W("[TTS] Insufficient DRAM for TTS: %u bytes free (need ~%u bytes, PSRAM: %u bytes). "
               "Cannot allocate I2S DMA buffers.", 
               (unsigned)free_dram, (unsigned)min_required_dram, (unsigned)free_psram);
+        return false;
+    }
+    return true;
+}
+
+int VoiceAssistant::LuaSandbox::lua_tts_speak(lua_State* L) {
+    const char* text = luaL_checkstring(L, 1);
+
+    if (!ttsMemoryAvailable()) {
+        lua_pushnil(L);
+        lua_pushstring(L, "Insufficient memory for TTS (low DRAM)");
+        return 2;
+    }
+
+    int pushed = 0;
+    if (runBlocking(L, [text = std::string(text)](LuaCoroutines::Values& results) {
+            std::string output_file;
+            if (VoiceAssistant::getInstance().makeTTSRequest(text, output_file)) {
+                results.push_back(LuaCoroutines::Value::string(output_file));
+            } else {
+                results.push_back(LuaCoroutines::Value::nil());
+                results.push_back(LuaCoroutines::Value::string("TTS request failed"));
+            }
+        }, pushed)) {
+        return lua_yield(L, 0);
+    }
+    return pushed;
+}
+
+int VoiceAssistant::LuaSandbox::lua_tts_play(lua_State* L) {
+    const char* text = luaL_checkstring(L, 1);
+    bool save = lua_toboolean(L, 2);
+
+    if (!ttsMemoryAvailable()) {
         lua_pushnil(L);
         lua_pushstring(L, "Insufficient memory for TTS (low DRAM)");
         return 2;
     }
 
-    VoiceAssistant& va = VoiceAssistant::getInstance();
-    std::string output_file;
-    bool success = va.makeTTSRequest(text, output_file);
+    int pushed = 0;
+    if (runBlocking(L, [text = std::string(text), save](LuaCoroutines::Values& results) {
+            std::string saved_path;
+            if (!VoiceAssistant::getInstance().speakStreaming(text, save ? &saved_path : nullptr)) {
+                results.push_back(LuaCoroutines::Value::nil());
+                results.push_back(LuaCoroutines::Value::string("TTS playback failed"));
+            } else if (save && !saved_path.empty()) {
+                results.push_back(LuaCoroutines::Value::string(saved_path));
+            } else {
+                results.push_back(LuaCoroutines::Value::boolean(true));
+            }
+        }, pushed)) {
+        return lua_yield(L, 0);
+    }
+    return pushed;
+}
+
+int VoiceAssistant::LuaSandbox::lua_tts_prewarm(lua_State* L) {
+    const lua_Integer max_items = luaL_optinteger(L, 1, 8);
 
-    if (success) {
-        lua_pushstring(L, output_file.c_str());
-        return 1;
-    } else {
+    if (!ttsMemoryAvailable()) {
         lua_pushnil(L);
-        lua_pushstring(L, "TTS request failed");
+        lua_pushstring(L, "Insufficient memory for TTS (low DRAM)");
         return 2;
     }
+
+    size_t synthesized = VoiceAssistant::getInstance().prewarmTTSCache(max_items > 0 ? static_cast<size_t>(max_items) : 0);
+    lua_pushinteger(L, static_cast<lua_Integer>(synthesized));
+    return 1;
+}
+
+int VoiceAssistant::LuaSandbox::lua_tts_cache_stats(lua_State* L) {
+    const TtsCache::Stats stats = TtsCache::getInstance().getStats();
+
+    lua_newtable(L);
+    lua_pushinteger(L, stats.hits);
+    lua_setfield(L, -2, "hits");
+    lua_pushinteger(L, stats.misses);
+    lua_setfield(L, -2, "misses");
+    lua_pushinteger(L, stats.stores);
+    lua_setfield(L, -2, "stores");
+    lua_pushinteger(L, stats.evictions);
+    lua_setfield(L, -2, "evictions");
+    lua_pushinteger(L, static_cast<lua_Integer>(stats.entries));
+    lua_setfield(L, -2, "entries");
+    lua_pushinteger(L, static_cast<lua_Integer>(stats.bytes));
+    lua_setfield(L, -2, "bytes");
+    lua_pushinteger(L, static_cast<lua_Integer>(stats.max_bytes));
+    lua_setfield(L, -2, "max_bytes");
+    return 1;
 }
 
 int VoiceAssistant::LuaSandbox::lua_gpio_read(lua_State* L) {
@@ -3669,6 +4781,9 @@ int VoiceAssistant::LuaSandbox::lua_gpio_toggle(lua_State* L) {
 
 int VoiceAssistant::LuaSandbox::lua_delay(lua_State* L) {
     int ms = luaL_checkinteger(L, 1);
+    if (LuaCoroutines::canYield(L)) {
+        return LuaCoroutines::sleep(L, ms > 0 ? static_cast<uint32_t>(ms) : 0);
+    }
     delay(ms);
     return 0;
 }
@@ -3974,6 +5089,7 @@ int VoiceAssistant::LuaSandbox::lua_radio_status(lua_State* L) {
         case SourceType::LITTLEFS: source_str = "LITTLEFS"; break;
         case SourceType::SD_CARD: source_str = "SD_CARD"; break;
         case SourceType::HTTP_STREAM: source_str = "HTTP_STREAM"; break;
+        case SourceType::HTTP_RESPONSE: source_str = "HTTP_RESPONSE"; break;
     }
     status << "Source: " << source_str << "\n";
 
@@ -4057,15 +5173,17 @@ int VoiceAssistant::LuaSandbox::lua_webdata_fetch_once(lua_State* L) {
     const char* url = luaL_checkstring(L, 1);
     const char* filename = luaL_checkstring(L, 2);
 
-    auto& webData = WebDataManager::getInstance();
-    WebDataManager::RequestResult result = webData.fetchOnce(url, filename);
-
-    lua_pushboolean(L, result.success);
-    if (!result.success) {
-        lua_pushstring(L, result.error_message.c_str());
-        return 2;
+    int pushed = 0;
+    if (runBlocking(L, [url = std::string(url), filename = std::string(filename)](LuaCoroutines::Values& results) {
+            WebDataManager::RequestResult result = WebDataManager::getInstance().fetchOnce(url, filename);
+            results.push_back(LuaCoroutines::Value::boolean(result.success));
+            if (!result.success) {
+                results.push_back(LuaCoroutines::Value::string(result.error_message));
+            }
+        }, pushed)) {
+        return lua_yield(L, 0);
     }
-    return 1;
+    return pushed;
 }
 
 int VoiceAssistant::LuaSandbox::lua_webdata_fetch_scheduled(lua_State* L) {
@@ -5,6 +5,8 @@
 #include <freertos/queue.h>
 
 #include <cJSON.h>
+#include <esp_http_client.h>
+#include <FS.h>
 #include <string>
 #include <vector>
 #include <atomic>
@@ -13,7 +15,15 @@
 #include <unordered_map>
 
 #include "core/voice_assistant_prompt.h"
+#include "core/auto_populate_cache.h"
 #include "core/command_center.h"
+#include "core/lua_scheduler.h"
+#include "core/microphone_manager.h"
+#include "utils/command_plan.h"
+#include "utils/llm_stream_parser.h"
+#include "utils/lua_arena.h"
+#include "utils/prompt_template.h"
+#include "utils/psram_allocator.h"
 
 extern "C" {
 #include <lua.h>
@@ -44,6 +54,8 @@ public:
         bool needs_refinement;      // Flag indicating if output should be refined
         std::string refinement_extract_field; // Which field to extract from refinement JSON (Phase 2)
 
+        CommandPlan plan;           // Multi-command reply ({"plan": [...]}), command is then "plan"
+
         VoiceCommand() : needs_refinement(false), refinement_extract_field("text") {}
         VoiceCommand(std::string cmd, std::vector<std::string> a, std::string txt = "", std::string speech = "", std::string out = "")
             : command(std::move(cmd)),
@@ -55,6 +67,14 @@ public:
               refinement_extract_field("text") {}
     };
 
+    /** LLM reply as it is being streamed (see getStreamingResponse) */
+    struct StreamingResponse {
+        uint32_t sequence = 0;       // Bumped on every update
+        bool active = false;         // An LLM request is in flight
+        bool command_ready = false;  // The command object is complete and being executed
+        std::string text;            // Reply text received so far
+    };
+
     /** Audio buffer structure */
     struct AudioBuffer {
         uint8_t* data = nullptr;
@@ -84,6 +104,13 @@ public:
         } payload;
     };
 
+    /** How processText() ties the text to the conversation */
+    enum class TextTurn {
+        Recorded,   // The user message is in ConversationBuffer already (voice pipeline, sendTextMessage)
+        Record,     // Add the user message once the conversation is ours, so turns never interleave
+        Detached    // Background job: no history, nothing recorded or streamed to the UI
+    };
+
     /** Request types for unified submission API */
     enum class RequestType {
         STT,      // Speech-to-text
@@ -145,6 +172,31 @@ public:
      */
     bool submitTTS(const std::string& text, std::string& request_id);
 
+    /**
+     * Synthesize text and start playing it while the audio is still downloading
+     * @param text Text to synthesize
+     * @param saved_path Optional: also tee the audio to ttsOutputPath and return its path
+     *                   (the file is complete once the download ends; removed on failure)
+     * @return true once playback has started
+     */
+    bool speakStreaming(const std::string& text, std::string* saved_path = nullptr);
+
+    /**
+     * Synthesize the most used cached phrases again for the current voice settings
+     * (entries cached under another voice/model/speed are misses until then)
+     * @param max_items Upper bound on TTS requests made
+     * @return Number of phrases synthesized
+     */
+    size_t prewarmTTSCache(size_t max_items = 8);
+
+    /**
+     * Synthesize text into memory (the endpoint's WAV, unmodified)
+     * @param cancel Optional flag polled while downloading; the request is abandoned once set
+     * @return true if audio was received
+     */
+    bool synthesizeSpeech(const std::string& text, PsramVector<uint8_t>& audio,
+                          const std::atomic<bool>* cancel = nullptr, bool force_enable = true);
+
     /**
      * Submit command for execution (Lua or CommandCenter)
      * @param command Command name
@@ -169,8 +221,29 @@ public:
      */
     bool cancelRequest(const std::string& request_id);
 
-    /** Manually trigger voice assistant listening, bypassing wake word */
-    void triggerListening();
+    /**
+     * Run the text through local intents or the LLM and wait for the reply
+     * (serialized with the voice pipeline)
+     * @param response Output: parsed reply, command already executed
+     * @param turn Whether the exchange belongs to the conversation
+     * @return true if a reply was produced
+     */
+    bool processText(const std::string& text, VoiceCommand& response, TextTurn turn = TextTurn::Recorded);
+
+    /** Transcribe an audio file with the configured Whisper endpoint */
+    bool transcribeFile(const std::string& audio_file, std::string& transcription);
+
+    /** Synthesize text into an audio file; output_file receives its path */
+    bool synthesizeToFile(const std::string& text, std::string& output_file);
+
+    /**
+     * Start a hands-free listening session (wake word or manual trigger)
+     * @param preroll Audio captured just before the trigger, prepended to the recording
+     *
+     * The recording auto-stops at end of speech and, when autosend is enabled,
+     * the transcription goes straight to the LLM instead of waiting for the UI.
+     */
+    void triggerListening(std::vector<int16_t> preroll = {});
 
     /** Start recording audio (called when button is pressed) */
     void startRecording();
@@ -187,6 +260,12 @@ public:
     /** Get last transcription (without LLM processing) - NEW for autosend logic */
     bool getLastTranscription(std::string& transcription, uint32_t timeout_ms = 500);
 
+    /**
+     * Snapshot of the reply currently streamed by the LLM (llmStreaming setting).
+     * Cheap to poll from UI timers and web handlers; compare `sequence` to detect updates.
+     */
+    StreamingResponse getStreamingResponse() const;
+
     QueueHandle_t getCommandQueue() const { return voiceCommandQueue_; }
     QueueHandle_t getTranscriptionQueue() const { return voiceTranscriptionQueue_; }
 
@@ -208,6 +287,9 @@ public:
     std::unordered_map<std::string, std::string> getSystemPromptVariables() const;
     bool executeAutoPopulateCommands(const std::string& raw_json, std::string& error);
 
+    /** Per auto_populate command: cache hits, misses and run cost */
+    std::vector<AutoPopulateCache::Stats> getAutoPopulateStats() const;
+
     /** Fetch available models from Ollama API */
     bool fetchOllamaModels(const std::string& base_url, std::vector<std::string>& models);
 
@@ -215,17 +297,43 @@ public:
     class LuaSandbox {
     private:
         lua_State* L;
+        LuaArena arena_{kMemoryLimit};
 
+        void createState();
         void setupSandbox();
+        void saveBaseline();
         std::string preprocessScript(const std::string& script);
+        /** Push the compiled chunk (from LuaBytecodeCache when possible); LUA_OK or an error on the stack */
+        int loadChunk(const std::string& source, bool preprocess, const char* chunkname);
 
     public:
+        static constexpr size_t kMemoryLimit = 512 * 1024;          // Per state, in PSRAM
+        static constexpr size_t kRecycleFootprint = 192 * 1024;     // Rebuild states that grew past this
+
         LuaSandbox();
         ~LuaSandbox();
 
         CommandResult execute(const std::string& script);
         CommandResult executeFile(const std::string& path);
 
+        /** Push an LLM script compiled as a chunk, for callers that run it themselves (LuaScheduler) */
+        int loadScript(const std::string& script);
+        lua_State* state() const { return L; }
+
+        /** Append the value on top of L to output the way execute() reports it, and pop it */
+        static void appendReturnValue(lua_State* L, std::string& output);
+        /** Route binding output on this thread to sandbox; @return the previously active one */
+        static LuaSandbox* activate(LuaSandbox* sandbox);
+
+        /** Clear the stack and output, restore the globals as they were after setup */
+        void reset();
+
+        /** True once a script hit the memory limit or left the arena oversized */
+        bool needsRecycle() const;
+        /** Rebuild the state from scratch, dropping its arena instead of lua_close() */
+        void recycle();
+        const LuaArena& arena() const { return arena_; }
+
         // Lua C API bindings
         static int lua_gpio_write(lua_State* L);
         static int lua_gpio_read(lua_State* L);
@@ -260,8 +368,16 @@ public:
         static int lua_cjson_encode(lua_State* L);
         static int lua_cjson_decode(lua_State* L);
 
+        // Event handlers (LuaEvents)
+        static int lua_events_on(lua_State* L);
+        static int lua_events_off(lua_State* L);
+        static int lua_events_emit(lua_State* L);
+
         // TTS function
         static int lua_tts_speak(lua_State* L);
+        static int lua_tts_play(lua_State* L);
+        static int lua_tts_prewarm(lua_State* L);
+        static int lua_tts_cache_stats(lua_State* L);
 
         // Radio/Audio player functions
         static int lua_radio_play(lua_State* L);
@@ -276,7 +392,9 @@ public:
         std::string output_buffer_;
     };
 
-    CommandResult executeLuaScript(const std::string& script);
+    /** Run a script on the Lua scheduler under the source's timeout */
+    CommandResult executeLuaScript(const std::string& script,
+                                   LuaScheduler::Source source = LuaScheduler::Source::Llm);
 
 private:
     VoiceAssistant();
@@ -291,18 +409,46 @@ private:
 
     // HTTP helpers
     bool makeWhisperRequest(const std::string& file_path, std::string& transcription);
-    bool makeGPTRequest(const std::string& prompt, std::string& response);
+    bool streamWhisperRequest(MicrophoneManager::RecordingHandle handle,
+                              StreamBufferHandle_t stream,
+                              const MicrophoneManager::RecordingConfig& recording_config,
+                              MicrophoneManager::RecordingResult& result,
+                              std::string& transcription);
+    // system_override: send only this system prompt and the prompt, without
+    // conversation history (side requests such as the summary)
+    bool makeGPTRequest(const std::string& prompt, std::string& response, bool publish_progress = false,
+                        const std::string* system_override = nullptr);
+    bool readGPTStream(esp_http_client_handle_t client, LlmStreamParser& parser, bool publish_progress);
     bool parseGPTCommand(const std::string& response, VoiceCommand& cmd);
+    bool parseCommandPlan(cJSON* plan, VoiceCommand& cmd);
+    void executeCommandPlan(VoiceCommand& cmd);
+    CommandResult runCommand(const std::string& command, const std::vector<std::string>& args);
+    bool tryLocalIntent(const std::string& text, VoiceCommand& response, bool record);
+    void summarizeConversationIfIdle();
+
+    // Streaming reply snapshot helpers
+    void beginStreamingResponse();
+    void updateStreamingResponse(const std::string& text, bool command_ready);
+    void endStreamingResponse();
+
+    // Background connect to the STT/LLM/TTS endpoints (HttpClientPool)
+    void prewarmConnections();
 
-    // TTS helper
+    // TTS helpers
     bool makeTTSRequest(const std::string& text, std::string& output_file_path, bool force_enable = true);
+    esp_http_client_handle_t openTTSResponse(const std::string& text, bool force_enable, int& content_length);
+    bool resolveTTSOutputDir(fs::FS*& filesystem, std::string& dir_on_fs, std::string& display_dir);
+    bool resolveTTSOutputFile(fs::FS*& filesystem, std::string& path_on_fs, std::string& output_file_path);
+    bool prepareTTSCache(const std::string& text, std::string& cache_key);
 
     // Output refinement helpers (Phase 1: Output Refinement System)
     bool shouldRefineOutput(const VoiceCommand& cmd);
     bool refineCommandOutput(VoiceCommand& cmd);
+    bool renderOutputLocally(VoiceCommand& cmd);
     std::string buildRefinementPrompt(const VoiceCommand& cmd);
 
     // Queue helpers
+    void publishTranscriptionResult(bool success, const std::string& transcription);
     bool sendAudioBuffer(AudioBuffer* buffer);
     bool receiveTranscribedText(std::string& text);
     bool sendCommand(VoiceCommand* cmd);
@@ -325,11 +471,45 @@ private:
     std::queue<std::string> pending_recordings_;
     std::mutex pending_recordings_mutex_;
 
-    LuaSandbox lua_sandbox_;
-    std::mutex lua_mutex_;
+    std::vector<int16_t> pending_preroll_;   // Handed from triggerListening() to the recording task
+    std::mutex pending_preroll_mutex_;
+    std::atomic<bool> hands_free_session_{false};
+
+    // Owned by the AI processing task
+    uint32_t last_llm_activity_ms_ = 0;
+    uint32_t summary_retry_ms_ = 0;
+
+    StreamingResponse streaming_response_;
+    mutable std::mutex streaming_response_mutex_;
+
     std::unordered_map<std::string, std::string> prompt_variables_;
+    uint32_t prompt_variables_generation_ = 0;  // Guarded by prompt_variables_mutex_
     mutable std::mutex prompt_variables_mutex_;
 
+    // Compiled system prompt, recompiled when the prompt file, the settings
+    // template or the command list change and re-rendered when a variable or
+    // the bonded host list changes
+    struct SystemPromptCache {
+        PromptTemplate compiled;
+        bool compiled_valid = false;
+        uint32_t definition_generation = 0;
+        uint32_t command_generation = 0;
+        std::string override_template;
+        bool rendered_valid = false;
+        uint32_t variables_generation = 0;
+        std::string host_list;
+        std::string rendered;
+    };
+    mutable SystemPromptCache system_prompt_cache_;
+    mutable std::mutex system_prompt_mutex_;
+
+    // One conversation turn at a time (voice pipeline, async LLM requests, summaries)
+    std::mutex llm_mutex_;
+    std::atomic<bool> turn_cancel_{false};     // Set by a new recording: the voice turn in flight is dropped
+
+    // Results of the prompt's auto_populate commands
+    AutoPopulateCache auto_populate_cache_;
+
     // Ollama models cache
     std::vector<std::string> cached_ollama_models_;
     std::string cached_ollama_endpoint_;
@@ -338,7 +518,14 @@ private:
     mutable std::mutex ollama_cache_mutex_;
 
     void captureCommandOutputVariables(const VoiceCommand& cmd);
+    void populatePromptVariables(const std::vector<AutoPopulateCommand>& commands);
     std::string composeSystemPrompt(const std::string& override_template,
                                     const VoiceAssistantPromptDefinition& prompt_definition) const;
+    std::string buildPromptSource(const std::string& override_template,
+                                  const VoiceAssistantPromptDefinition& prompt_definition) const;
+    void compileSystemPrompt(const std::string& source, PromptTemplate& compiled) const;
+    void renderSystemPromptLocked(const PromptTemplate& compiled, const std::string& host_list,
+                                  std::string& out) const;
+    std::string bleHostList() const;
     std::string resolvePromptVariables(std::string prompt) const;
 };
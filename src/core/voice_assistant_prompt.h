@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -14,6 +15,9 @@ constexpr const char* VOICE_ASSISTANT_BLE_HOSTS_PLACEHOLDER = "{{BLE_HOSTS}}";
 struct AutoPopulateCommand {
     std::string command;
     std::vector<std::string> args;
+    uint32_t ttl_ms = 0;                        // Result reused for this long (0: run every turn)
+    bool stale_while_revalidate = false;        // Use the expired result while it refreshes
+    std::vector<std::string> invalidate_on;     // EventRouter events that expire the result
 };
 
 struct VoiceAssistantPromptDefinition {
@@ -0,0 +1,403 @@
+#include "core/wake_word_service.h"
+#include "core/audio_manager.h"
+#include "core/microphone_manager.h"
+#include "core/settings_manager.h"
+#include "core/task_config.h"
+#include "lvgl_power_manager.h"
+#include "utils/logger.h"
+#include <Arduino.h>
+#include <FS.h>
+#include <LittleFS.h>
+#include <SD_MMC.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr uint32_t kSampleRate = 16000;
+constexpr size_t kStreamBufferBytes = 16 * 1024;   // ~0.5 s of capture slack
+constexpr size_t kReadChunkSamples = 512;
+constexpr uint32_t kIdlePollMs = 250;
+constexpr uint32_t kRestartHoldoffMs = 1500;       // Lets the triggered recording claim the microphone
+constexpr uint32_t kLoadWindowSamples = kSampleRate; // Re-evaluate the CPU budget every second of audio
+constexpr uint8_t kMaxInferenceStride = 4;
+constexpr size_t kMaxModelBytes = 512 * 1024;
+
+fs::FS* findModelFilesystem() {
+    if (SD_MMC.cardType() != CARD_NONE && SD_MMC.exists(WakeWordService::kModelPath)) {
+        return &SD_MMC;
+    }
+    if (LittleFS.exists(WakeWordService::kModelPath)) {
+        return &LittleFS;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+WakeWordService& WakeWordService::getInstance() {
+    static WakeWordService instance;
+    return instance;
+}
+
+bool WakeWordService::begin() {
+    if (task_handle_) {
+        return true;
+    }
+
+    stream_struct_ = static_cast<StaticStreamBuffer_t*>(heap_caps_malloc(sizeof(StaticStreamBuffer_t), MALLOC_CAP_INTERNAL));
+    stream_storage_ = static_cast<uint8_t*>(heap_caps_malloc(kStreamBufferBytes + 1, MALLOC_CAP_SPIRAM));
+    preroll_capacity_ = static_cast<size_t>(kPreRollMs) * kSampleRate / 1000;
+    preroll_ = static_cast<int16_t*>(heap_caps_malloc(preroll_capacity_ * sizeof(int16_t), MALLOC_CAP_SPIRAM));
+    if (stream_struct_ && stream_storage_) {
+        stream_ = xStreamBufferCreateStatic(kStreamBufferBytes, 1, stream_storage_, stream_struct_);
+    }
+    if (!stream_ || !preroll_) {
+        Logger::getInstance().error("[WakeWord] Failed to allocate capture buffers");
+        end();
+        return false;
+    }
+
+    SettingsManager& settings = SettingsManager::getInstance();
+    enabled_.store(settings.getWakeWordEnabled());
+    threshold_.store(settings.getWakeWordThreshold());
+    settings_listener_id_ = settings.addListener([this](SettingsManager::SettingKey key, const SettingsSnapshot& snapshot) {
+        if (key == SettingsManager::SettingKey::WakeWordEnabled) {
+            enabled_.store(snapshot.wakeWordEnabled);
+        } else if (key == SettingsManager::SettingKey::WakeWordThreshold) {
+            threshold_.store(snapshot.wakeWordThreshold);
+        }
+    });
+
+    running_.store(true);
+    BaseType_t result = xTaskCreatePinnedToCore(
+        taskEntry, "wake_word", TaskConfig::STACK_WAKE_WORD,
+        this, TaskConfig::PRIO_WAKE_WORD, &task_handle_, TaskConfig::CORE_WAKE_WORD);
+    if (result != pdPASS) {
+        Logger::getInstance().error("[WakeWord] Failed to create listener task");
+        task_handle_ = nullptr;
+        end();
+        return false;
+    }
+
+    Logger::getInstance().infof("[WakeWord] Listener started (%s)", enabled_.load() ? "enabled" : "disabled");
+    return true;
+}
+
+void WakeWordService::end() {
+    running_.store(false);
+    stop_flag_.store(true);
+
+    for (int i = 0; i < 300 && task_handle_; ++i) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    if (task_handle_) {
+        // Never free buffers under a live task
+        Logger::getInstance().warn("[WakeWord] Listener task did not stop, keeping buffers");
+        return;
+    }
+
+    if (settings_listener_id_ != 0) {
+        SettingsManager::getInstance().removeListener(settings_listener_id_);
+        settings_listener_id_ = 0;
+    }
+    if (stream_) {
+        vStreamBufferDelete(stream_);
+        stream_ = nullptr;
+    }
+    heap_caps_free(stream_storage_);
+    heap_caps_free(stream_struct_);
+    heap_caps_free(preroll_);
+    stream_storage_ = nullptr;
+    stream_struct_ = nullptr;
+    preroll_ = nullptr;
+    preroll_capacity_ = 0;
+    releaseModel();
+}
+
+void WakeWordService::setDetectionCallback(DetectionCallback callback) {
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    callback_ = std::move(callback);
+}
+
+WakeWordService::Stats WakeWordService::getStats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return stats_;
+}
+
+void WakeWordService::taskEntry(void* param) {
+    auto* service = static_cast<WakeWordService*>(param);
+    service->run();
+    service->task_handle_ = nullptr;
+    vTaskDelete(nullptr);
+}
+
+void WakeWordService::run() {
+    while (running_.load()) {
+        if (!shouldListen()) {
+            vTaskDelay(pdMS_TO_TICKS(kIdlePollMs));
+            continue;
+        }
+        listen();
+    }
+}
+
+bool WakeWordService::shouldListen() {
+    if (!enabled_.load()) {
+        // Retry a failed model load the next time the feature is switched on
+        model_failed_ = false;
+        return false;
+    }
+    if (!ensureModel()) {
+        return false;
+    }
+    if (static_cast<int32_t>(millis() - holdoff_until_ms_) < 0) {
+        return false;
+    }
+    return !MicrophoneManager::getInstance().isRecording() && !AudioManager::getInstance().isPlaying();
+}
+
+bool WakeWordService::ensureModel() {
+    if (spotter_.isLoaded()) {
+        return true;
+    }
+    if (model_failed_) {
+        return false;
+    }
+    model_failed_ = true;
+
+    fs::FS* fs = findModelFilesystem();
+    if (!fs) {
+        Logger::getInstance().warnf("[WakeWord] No model at %s (SD or LittleFS), wake word unavailable", kModelPath);
+        return false;
+    }
+
+    File file = fs->open(kModelPath, FILE_READ);
+    const size_t size = file ? file.size() : 0;
+    if (size == 0 || size > kMaxModelBytes) {
+        Logger::getInstance().errorf("[WakeWord] Invalid model file size: %u", static_cast<unsigned>(size));
+        file.close();
+        return false;
+    }
+
+    model_blob_ = static_cast<uint8_t*>(heap_caps_malloc(size, MALLOC_CAP_SPIRAM));
+    if (!model_blob_) {
+        Logger::getInstance().error("[WakeWord] Out of PSRAM for model");
+        file.close();
+        return false;
+    }
+    const size_t read = file.read(model_blob_, size);
+    file.close();
+
+    if (read != size || !spotter_.loadModel(model_blob_, size)) {
+        Logger::getInstance().error("[WakeWord] Model file is malformed");
+        releaseModel();
+        return false;
+    }
+
+    LogMelFrontend::Config frontend_config;
+    frontend_config.sample_rate = kSampleRate;
+    frontend_config.num_bins = spotter_.bins();
+    if (!frontend_.configure(frontend_config)) {
+        Logger::getInstance().errorf("[WakeWord] Unsupported model input (%u bins)", spotter_.bins());
+        releaseModel();
+        return false;
+    }
+
+    model_failed_ = false;
+    Logger::getInstance().infof("[WakeWord] Model loaded: %u frames x %u bins, %u MACs per inference",
+                                spotter_.frames(), spotter_.bins(),
+                                static_cast<unsigned>(spotter_.macsPerInference()));
+    return true;
+}
+
+void WakeWordService::releaseModel() {
+    spotter_.unload();
+    heap_caps_free(model_blob_);
+    model_blob_ = nullptr;
+}
+
+void WakeWordService::listen() {
+    MicrophoneManager& mic = MicrophoneManager::getInstance();
+
+    MicrophoneManager::RecordingConfig config;
+    config.sample_rate = kSampleRate;
+    config.bits_per_sample = 16;
+    config.channels = 1;
+    config.enable_agc = false;  // Features carry absolute level; the model sees raw audio
+    config.stream_buffer = stream_;
+    config.save_to_file = false;
+    config.preemptible = true;
+
+    xStreamBufferReset(stream_);
+    stop_flag_.store(false);
+    auto handle = mic.startRecording(config, stop_flag_);
+    if (!handle) {
+        vTaskDelay(pdMS_TO_TICKS(kIdlePollMs));
+        return;
+    }
+
+    listening_.store(true);
+    frontend_.reset();
+    spotter_.reset();
+    preroll_head_ = 0;
+    preroll_size_ = 0;
+    memset(score_history_, 0, sizeof(score_history_));
+    score_pos_ = 0;
+    frames_since_inference_ = 0;
+    load_busy_us_ = 0;
+    load_samples_ = 0;
+    Logger::getInstance().info("[WakeWord] Listening");
+
+    int16_t chunk[kReadChunkSamples];
+    bool detected = false;
+    while (running_.load() && enabled_.load()) {
+        // The producer only sends whole, even-sized chunks, so reads stay sample aligned
+        const size_t bytes = xStreamBufferReceive(stream_, chunk, sizeof(chunk), pdMS_TO_TICKS(50));
+        if (bytes >= sizeof(int16_t)) {
+            const size_t count = bytes / sizeof(int16_t);
+            const int64_t start_us = esp_timer_get_time();
+            pushPreRoll(chunk, count);
+            detected = processSamples(chunk, count);
+            updateLoad(static_cast<uint32_t>(esp_timer_get_time() - start_us), count);
+            if (detected) {
+                break;
+            }
+        } else if (!mic.isRecording()) {
+            // Preempted by playback or a foreground recording
+            break;
+        }
+    }
+
+    stop_flag_.store(true);
+    mic.getRecordingResult(handle);
+    listening_.store(false);
+
+    if (detected) {
+        uint32_t sum = 0;
+        for (uint8_t score : score_history_) {
+            sum += score;
+        }
+        handleDetection(static_cast<uint8_t>(sum / kSmoothingWindow));
+    } else {
+        Logger::getInstance().info("[WakeWord] Listening paused");
+    }
+}
+
+bool WakeWordService::processSamples(const int16_t* samples, size_t count) {
+    const uint32_t threshold = static_cast<uint32_t>(threshold_.load()) * 255 / 100;
+    uint32_t frames = 0;
+    uint32_t inferences = 0;
+    uint8_t smoothed = 0;
+    bool detected = false;
+
+    size_t offset = 0;
+    while (offset < count && !detected) {
+        offset += frontend_.push(samples + offset, count - offset);
+        if (!frontend_.frameReady()) {
+            continue;
+        }
+        spotter_.pushFrame(frontend_.features());
+        ++frames;
+        if (!spotter_.ready() || ++frames_since_inference_ < inference_stride_) {
+            continue;
+        }
+        frames_since_inference_ = 0;
+
+        score_history_[score_pos_] = spotter_.infer();
+        score_pos_ = static_cast<uint8_t>((score_pos_ + 1) % kSmoothingWindow);
+        ++inferences;
+
+        uint32_t sum = 0;
+        for (uint8_t score : score_history_) {
+            sum += score;
+        }
+        smoothed = static_cast<uint8_t>(sum / kSmoothingWindow);
+        detected = smoothed >= threshold;
+    }
+
+    if (frames > 0) {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.frames += frames;
+        stats_.inferences += inferences;
+        if (inferences > 0) {
+            stats_.last_score = smoothed;
+        }
+    }
+    return detected;
+}
+
+void WakeWordService::updateLoad(uint32_t busy_us, size_t samples) {
+    load_busy_us_ += busy_us;
+    load_samples_ += samples;
+    if (load_samples_ < kLoadWindowSamples) {
+        return;
+    }
+
+    const uint64_t audio_us = static_cast<uint64_t>(load_samples_) * 1000000ULL / kSampleRate;
+    const uint16_t load = static_cast<uint16_t>(std::min<uint64_t>(1000, load_busy_us_ * 1000 / audio_us));
+    load_busy_us_ = 0;
+    load_samples_ = 0;
+
+    if (load > kCpuBudgetPermille && inference_stride_ < kMaxInferenceStride) {
+        ++inference_stride_;
+        Logger::getInstance().warnf("[WakeWord] CPU load %u%% over budget, inference every %u frames",
+                                    load / 10, inference_stride_);
+    } else if (load < kCpuBudgetPermille / 3 && inference_stride_ > 1) {
+        --inference_stride_;
+    }
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.load_permille = load;
+    stats_.inference_stride = inference_stride_;
+}
+
+void WakeWordService::pushPreRoll(const int16_t* samples, size_t count) {
+    if (count >= preroll_capacity_) {
+        memcpy(preroll_, samples + (count - preroll_capacity_), preroll_capacity_ * sizeof(int16_t));
+        preroll_head_ = 0;
+        preroll_size_ = preroll_capacity_;
+        return;
+    }
+    const size_t tail = (preroll_head_ + preroll_size_) % preroll_capacity_;
+    const size_t first = std::min(count, preroll_capacity_ - tail);
+    memcpy(preroll_ + tail, samples, first * sizeof(int16_t));
+    memcpy(preroll_, samples + first, (count - first) * sizeof(int16_t));
+    preroll_size_ += count;
+    if (preroll_size_ > preroll_capacity_) {
+        preroll_head_ = (preroll_head_ + preroll_size_ - preroll_capacity_) % preroll_capacity_;
+        preroll_size_ = preroll_capacity_;
+    }
+}
+
+std::vector<int16_t> WakeWordService::takePreRoll() {
+    std::vector<int16_t> preroll(preroll_size_);
+    const size_t first = std::min(preroll_size_, preroll_capacity_ - preroll_head_);
+    memcpy(preroll.data(), preroll_ + preroll_head_, first * sizeof(int16_t));
+    memcpy(preroll.data() + first, preroll_, (preroll_size_ - first) * sizeof(int16_t));
+    preroll_head_ = 0;
+    preroll_size_ = 0;
+    return preroll;
+}
+
+void WakeWordService::handleDetection(uint8_t score) {
+    holdoff_until_ms_ = millis() + kRestartHoldoffMs;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        ++stats_.detections;
+        stats_.last_detection_ms = millis();
+    }
+    Logger::getInstance().infof("[WakeWord] Wake word detected (score %u/255)", score);
+    LVGLPowerManager::getInstance().onWakeWordDetected();
+
+    DetectionCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(callback_mutex_);
+        callback = callback_;
+    }
+    if (callback) {
+        callback(takePreRoll());
+    }
+}
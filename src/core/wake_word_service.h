@@ -0,0 +1,124 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/stream_buffer.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "core/keyword_spotter.h"
+#include "core/log_mel_frontend.h"
+
+/**
+ * @brief Always-listening wake-word detector
+ *
+ * While enabled, a task on the worker core keeps a preemptible MicrophoneManager
+ * capture running (stream only, no file), feeds it through LogMelFrontend and
+ * KeywordSpotter, and averages the last few keyword scores against the
+ * configured threshold. Any playback or foreground recording preempts the
+ * capture; listening resumes once the microphone and speaker are idle again.
+ *
+ * On detection the capture is released and the detection callback receives the
+ * last kPreRollMs of audio, which the caller prepends to its own recording so
+ * words spoken right after the keyword are not clipped.
+ *
+ * Inference runs every `stride` feature frames (20 ms hop); the stride grows when
+ * the measured processing time exceeds kCpuBudgetPermille of real time.
+ *
+ * The model is loaded from kModelPath (SD card first, then LittleFS); see
+ * KeywordSpotter for the blob format. Without a model the service stays idle.
+ */
+class WakeWordService {
+public:
+    static constexpr const char* kModelPath = "/models/wakeword.kws";
+    static constexpr uint32_t kPreRollMs = 500;
+    static constexpr uint16_t kCpuBudgetPermille = 200;
+
+    struct Stats {
+        uint32_t frames = 0;
+        uint32_t inferences = 0;
+        uint32_t detections = 0;
+        uint8_t last_score = 0;          // Smoothed keyword probability (0-255)
+        uint8_t inference_stride = 1;    // Frames between inferences
+        uint16_t load_permille = 0;      // Processing time / audio time
+        uint32_t last_detection_ms = 0;  // millis() of the last detection
+    };
+
+    using DetectionCallback = std::function<void(std::vector<int16_t>&& preroll)>;
+
+    static WakeWordService& getInstance();
+
+    /**
+     * @brief Start the listener task (listening itself follows the wakeWordEnabled setting)
+     * @return true if the task is running
+     */
+    bool begin();
+
+    /**
+     * @brief Stop listening, end the task and release the model
+     */
+    void end();
+
+    void setDetectionCallback(DetectionCallback callback);
+
+    bool isListening() const { return listening_.load(); }
+    bool hasModel() const { return spotter_.isLoaded(); }
+    Stats getStats() const;
+
+private:
+    WakeWordService() = default;
+    ~WakeWordService() = default;
+    WakeWordService(const WakeWordService&) = delete;
+    WakeWordService& operator=(const WakeWordService&) = delete;
+
+    static void taskEntry(void* param);
+    void run();
+    bool shouldListen();
+    bool ensureModel();
+    void releaseModel();
+    void listen();
+    bool processSamples(const int16_t* samples, size_t count);
+    void updateLoad(uint32_t busy_us, size_t samples);
+    void pushPreRoll(const int16_t* samples, size_t count);
+    std::vector<int16_t> takePreRoll();
+    void handleDetection(uint8_t score);
+
+    LogMelFrontend frontend_;
+    KeywordSpotter spotter_;
+    uint8_t* model_blob_ = nullptr;
+    bool model_failed_ = false;
+
+    TaskHandle_t task_handle_ = nullptr;
+    StreamBufferHandle_t stream_ = nullptr;
+    StaticStreamBuffer_t* stream_struct_ = nullptr;
+    uint8_t* stream_storage_ = nullptr;
+
+    int16_t* preroll_ = nullptr;
+    size_t preroll_capacity_ = 0;
+    size_t preroll_head_ = 0;
+    size_t preroll_size_ = 0;
+
+    static constexpr uint8_t kSmoothingWindow = 3;
+    uint8_t score_history_[kSmoothingWindow] = {};
+    uint8_t score_pos_ = 0;
+    uint8_t inference_stride_ = 1;
+    uint8_t frames_since_inference_ = 0;
+    uint64_t load_busy_us_ = 0;
+    size_t load_samples_ = 0;
+    uint32_t holdoff_until_ms_ = 0;
+
+    std::atomic<bool> running_{false};
+    std::atomic<bool> listening_{false};
+    std::atomic<bool> enabled_{false};
+    std::atomic<uint8_t> threshold_{85};
+    std::atomic<bool> stop_flag_{false};
+    uint32_t settings_listener_id_ = 0;
+
+    DetectionCallback callback_;
+    std::mutex callback_mutex_;
+    Stats stats_;
+    mutable std::mutex stats_mutex_;
+};
@@ -1,4 +1,5 @@
 #include "core/web_data_manager.h"
+#include "core/cancel_token.h"
 #include "core/storage_access_manager.h"
 #include "core/storage_manager.h"
 #include "core/settings_manager.h"
@@ -352,6 +353,13 @@ WebDataManager::RequestResult WebDataManager::makeHttpRequest(const std::string&
         return result;
     }
 
+    // Requests run for an AsyncRequestManager job stop reading once it is cancelled
+    const CancelToken cancel = CancelToken::current();
+    if (cancel.cancelled()) {
+        result.error_message = "Request cancelled";
+        return result;
+    }
+
     WiFiClient http_client;
     HTTPClient http;
     http.setTimeout(request_timeout_ms_);
@@ -393,6 +401,12 @@ WebDataManager::RequestResult WebDataManager::makeHttpRequest(const std::string&
                     bool stream_error = false;
 
                     while ((is_chunked && stream->connected()) || (!is_chunked && remaining > 0)) {
+                        if (cancel.cancelled()) {
+                            // http.end() below drops the connection
+                            stream_error = true;
+                            result.error_message = "Request cancelled";
+                            break;
+                        }
                         size_t available = stream->available();
                         if (available == 0) {
                             if (!stream->connected()) {
@@ -411,6 +411,7 @@ void WebServerManager::registerRoutes() {
     server_->on("/api/lua/execute", HTTP_POST, [this]() { handleApiLuaExecute(); });
     server_->on("/api/assistant/chat", HTTP_POST, [this]() { handleAssistantChat(); });
     server_->on(UriBraces("/api/assistant/chat/{}"), HTTP_GET, [this]() { handleAssistantChatStatus(); });
+    server_->on(UriBraces("/api/assistant/chat/{}"), HTTP_DELETE, [this]() { handleAssistantChatCancel(); });
     server_->on("/api/assistant/audio/start", HTTP_POST, [this]() { handleAssistantAudioStart(); });
     server_->on("/api/assistant/audio/stop", HTTP_POST, [this]() { handleAssistantAudioStop(); });
     server_->on("/api/assistant/conversation", HTTP_GET, [this]() { handleAssistantConversationGet(); });
@@ -599,7 +600,7 @@ void WebServerManager::handleApiLuaExecute() {
     }
 
     VoiceAssistant& assistant = VoiceAssistant::getInstance();
-    const CommandResult result = assistant.executeLuaScript(script);
+    const CommandResult result = assistant.executeLuaScript(script, LuaScheduler::Source::Web);
 
     StaticJsonDocument<256> out;
     out["status"] = result.success ? "success" : "error";
@@ -721,7 +722,7 @@ void WebServerManager::handleAssistantChatStatus() {
         return;
     }
 
-    StaticJsonDocument<768> doc;
+    JsonDocument doc;
     doc["status"] = requestStatusToString(result.status);
     doc["request_id"] = request_id.c_str();
     doc["created_at_ms"] = result.created_at_ms;
@@ -737,6 +738,13 @@ void WebServerManager::handleAssistantChatStatus() {
     if (result.status == AsyncRequestManager::RequestStatus::COMPLETED) {
         JsonObject response = doc.createNestedObject("response");
         appendCommandToJson(response, result.response, false);
+    } else if (result.status == AsyncRequestManager::RequestStatus::PROCESSING) {
+        // Reply text streamed so far (llmStreaming), so the page can render it before completion
+        const VoiceAssistant::StreamingResponse partial = VoiceAssistant::getInstance().getStreamingResponse();
+        if (partial.active && !partial.text.empty()) {
+            doc["partial_text"] = partial.text.c_str();
+            doc["command_ready"] = partial.command_ready;
+        }
     }
 
     String payload;
@@ -744,6 +752,21 @@ void WebServerManager::handleAssistantChatStatus() {
     sendJson(200, payload);
 }
 
+void WebServerManager::handleAssistantChatCancel() {
+    const std::string request_id = server_->pathArg(0).c_str();
+    if (request_id.empty()) {
+        sendJson(400, "{\"status\":\"error\",\"message\":\"Missing request ID\"}");
+        return;
+    }
+
+    // Aborts the LLM call in flight too; the status then reads "failed"
+    if (!AsyncRequestManager::getInstance().cancelRequest(request_id)) {
+        sendJson(404, "{\"status\":\"error\",\"message\":\"Request not found or already finished\"}");
+        return;
+    }
+    sendJson(200, "{\"status\":\"cancelled\"}");
+}
+
 void WebServerManager::handleAssistantAudioStart() {
     SettingsManager& settings = SettingsManager::getInstance();
     OperatingMode_t mode = settings.getOperatingMode();
@@ -909,9 +932,17 @@ void WebServerManager::handleAssistantSettingsGet() {
     doc["dockerHostIp"] = snapshot.dockerHostIp;
     doc["whisperCloudEndpoint"] = snapshot.whisperCloudEndpoint;
     doc["whisperLocalEndpoint"] = snapshot.whisperLocalEndpoint;
+    doc["whisperCloudUploadFormat"] = snapshot.whisperCloudUploadFormat;
+    doc["whisperLocalUploadFormat"] = snapshot.whisperLocalUploadFormat;
+    doc["sttStreamingUpload"] = snapshot.sttStreamingUpload;
+    doc["sttSaveRecordings"] = snapshot.sttSaveRecordings;
+    doc["wakeWordEnabled"] = snapshot.wakeWordEnabled;
+    doc["wakeWordThreshold"] = snapshot.wakeWordThreshold;
     doc["llmCloudEndpoint"] = snapshot.llmCloudEndpoint;
     doc["llmLocalEndpoint"] = snapshot.llmLocalEndpoint;
     doc["llmModel"] = snapshot.llmModel;
+    doc["llmStreaming"] = snapshot.llmStreaming;
+    doc["llmContextTokens"] = snapshot.llmContextTokens;
     doc["activeWhisperEndpoint"] =
         snapshot.localApiMode ? snapshot.whisperLocalEndpoint : snapshot.whisperCloudEndpoint;
     doc["activeLlmEndpoint"] =
@@ -973,6 +1004,26 @@ void WebServerManager::handleAssistantSettingsPost() {
     if (whisper_local && !whisper_local.isNull()) {
         settings.setWhisperLocalEndpoint(whisper_local.as<const char*>());
     }
+    JsonVariant whisper_cloud_format = doc["whisperCloudUploadFormat"];
+    if (whisper_cloud_format && !whisper_cloud_format.isNull()) {
+        settings.setWhisperCloudUploadFormat(whisper_cloud_format.as<const char*>());
+    }
+    JsonVariant whisper_local_format = doc["whisperLocalUploadFormat"];
+    if (whisper_local_format && !whisper_local_format.isNull()) {
+        settings.setWhisperLocalUploadFormat(whisper_local_format.as<const char*>());
+    }
+    if (doc.containsKey("sttStreamingUpload")) {
+        settings.setSttStreamingUpload(doc["sttStreamingUpload"] | false);
+    }
+    if (doc.containsKey("sttSaveRecordings")) {
+        settings.setSttSaveRecordings(doc["sttSaveRecordings"] | true);
+    }
+    if (doc.containsKey("wakeWordEnabled")) {
+        settings.setWakeWordEnabled(doc["wakeWordEnabled"] | false);
+    }
+    if (doc.containsKey("wakeWordThreshold")) {
+        settings.setWakeWordThreshold(doc["wakeWordThreshold"] | settings.getWakeWordThreshold());
+    }
 
     JsonVariant llm_cloud = doc["llmCloudEndpoint"];
     if (llm_cloud && !llm_cloud.isNull()) {
@@ -987,6 +1038,12 @@ void WebServerManager::handleAssistantSettingsPost() {
     if (llm_model && !llm_model.isNull()) {
         settings.setLlmModel(llm_model.as<const char*>());
     }
+    if (doc.containsKey("llmStreaming")) {
+        settings.setLlmStreaming(doc["llmStreaming"] | true);
+    }
+    if (doc.containsKey("llmContextTokens")) {
+        settings.setLlmContextTokens(doc["llmContextTokens"] | settings.getLlmContextTokens());
+    }
     JsonVariant system_prompt = doc["systemPromptTemplate"];
     if (system_prompt && !system_prompt.isNull()) {
         settings.setVoiceAssistantSystemPromptTemplate(system_prompt.as<const char*>());
@@ -32,6 +32,7 @@ private:
     void handleApiLuaExecute();
     void handleAssistantChat();
     void handleAssistantChatStatus();
+    void handleAssistantChatCancel();
     void handleAssistantAudioStart();
     void handleAssistantAudioStop();
     void handleAssistantConversationGet();
@@ -8,6 +8,7 @@
 #include "core/web_server_manager.h"
 #include "core/web_data_manager.h"
 #include "core/operating_modes.h"
+#include "core/event_router.h"
 
 // Constructor
 WifiManager::WifiManager() {
@@ -73,6 +74,8 @@ void WifiManager::wifi_task(void *pvParameters) {
             }
 
             WebDataManager::getInstance().notifyWifiReady();
+            EventRouter::getInstance()->publish("wifi.connected",
+                                                const_cast<char*>(WiFi.localIP().toString().c_str()));
 
             // Initialize and sync time via NTP
             auto& settings = SettingsManager::getInstance();
@@ -146,6 +149,8 @@ void WifiManager::wifi_task(void *pvParameters) {
                 }
 
                 WebDataManager::getInstance().notifyWifiReady();
+                EventRouter::getInstance()->publish("wifi.connected",
+                                                    const_cast<char*>(WiFi.localIP().toString().c_str()));
 
                 // Re-sync time after reconnection
                 auto& time_mgr = TimeManager::getInstance();
@@ -186,6 +191,7 @@ void WifiManager::wifi_task(void *pvParameters) {
                 msg.value = 0; // Disconnected
                 SystemTasks::postUiMessage(msg, 0);
                 WebDataManager::getInstance().notifyWifiDisconnected();
+                EventRouter::getInstance()->publish("wifi.disconnected", const_cast<char*>(""));
             }
             last_status = current_status;
         }
@@ -2,6 +2,8 @@
 #include "core/async_request_manager.h"
 #include "core/conversation_buffer.h"
 #include "core/voice_assistant.h"
+#include "core/lua_sandbox_pool.h"
+#include "core/tts_pipeline.h"
 #include "core/wifi_manager.h"
 #include "core/ble_hid_manager.h"
 #include "core/audio_manager.h"
@@ -72,6 +74,13 @@ AiChatScreen::~AiChatScreen() {
         lv_timer_del(tts_status_timer);
         tts_status_timer = nullptr;
     }
+    if (tts_playing) {
+        TtsPipeline::getInstance().cancel();
+    }
+    if (stream_timer) {
+        lv_timer_del(stream_timer);
+        stream_timer = nullptr;
+    }
     if (settings_listener_id != 0) {
         SettingsManager::getInstance().removeListener(settings_listener_id);
         settings_listener_id = 0;
@@ -88,7 +97,7 @@ void AiChatScreen::build(lv_obj_t* parent) {
     const SettingsSnapshot& snapshot = settings.getSnapshot();
 
     // Load Lua script for TTS
-    lua_sandbox_.executeFile("/memory/scripts/lvgl_tts_chat.lua");
+    LuaSandboxPool::getInstance().acquireUi()->executeFile("/memory/scripts/lvgl_tts_chat.lua");
 
     // Set initial auto_tts_enabled from settings
     auto_tts_enabled = settings.getTtsEnabled();
@@ -486,6 +495,7 @@ void AiChatScreen::updateStatusIcons() {
 
 void AiChatScreen::loadConversationHistory() {
     lv_obj_clean(chat_container); // Clear children
+    stream_label = nullptr;
 
     ConversationBuffer& buffer = ConversationBuffer::getInstance();
     if (!buffer.begin()) {
@@ -532,7 +542,7 @@ void AiChatScreen::loadConversationHistory() {
     lv_obj_scroll_to_y(root, LV_COORD_MAX, LV_ANIM_OFF);
 }
 
-void AiChatScreen::appendMessage(const String& role, const String& text, const String& meta, const String& output) {
+lv_obj_t* AiChatScreen::appendMessage(const String& role, const String& text, const String& meta, const String& output) {
     lv_obj_t* bubble = lv_obj_create(chat_container);
     lv_obj_set_size(bubble, lv_pct(85), LV_SIZE_CONTENT);
     lv_obj_set_style_pad_all(bubble, 14, 0);
@@ -586,15 +596,9 @@ void AiChatScreen::appendMessage(const String& role, const String& text, const S
                     const char* text_c = lv_label_get_text(content_label);
                     String msg_text(text_c);
                     if (!msg_text.isEmpty()) {
-                        String escaped_text = screen->escapeLuaString(msg_text);
-                        std::string lua_script = "speak_and_play(\"" + std::string(escaped_text.c_str()) + "\")";
-                        CommandResult res = screen->lua_sandbox_.execute(lua_script);
-                        if (res.success) {
-                            screen->setStatus("Parlando...", lv_color_hex(0x7EE7C0));
-                            screen->tts_playing = true;
-                        } else {
-                            screen->setStatus("Errore TTS", lv_color_hex(0xFF7B7B));
-                        }
+                        TtsPipeline::getInstance().speak(msg_text.c_str());
+                        screen->setStatus("Parlando...", lv_color_hex(0x7EE7C0));
+                        screen->startTtsStatusTimer();
                     }
                 }
             }
@@ -620,16 +624,7 @@ void AiChatScreen::appendMessage(const String& role, const String& text, const S
 
     lv_obj_update_layout(chat_container);
     lv_obj_scroll_to_y(root, LV_COORD_MAX, LV_ANIM_OFF); // Scroll root to bottom
-}
-
-String AiChatScreen::escapeLuaString(const String& s) {
-    String escaped = s;
-    escaped.replace("\\", "\\\\");
-    escaped.replace("\"", "\\\"");
-    escaped.replace("\n", "\\n");
-    escaped.replace("\r", "\\r");
-    escaped.replace("\t", "\\t");
-    return escaped;
+    return content;
 }
 
 void AiChatScreen::sendChatMessage() {
@@ -682,6 +677,14 @@ void AiChatScreen::sendChatMessage() {
     if (!poll_timer) {
         poll_timer = lv_timer_create(pollRequestTimer, 3000, this);
     }
+    startStreamPolling();
+
+    if (auto_tts_enabled) {
+        // Speaking starts with the first streamed sentence (streamPollTimer)
+        TtsPipeline::getInstance().start();
+    } else {
+        TtsPipeline::getInstance().cancel();
+    }
 
     lv_obj_clear_state(send_button, LV_STATE_DISABLED);
 }
@@ -801,10 +804,86 @@ void AiChatScreen::stopPolling() {
         lv_timer_del(poll_timer);
         poll_timer = nullptr;
     }
+    stopStreamPolling();
     setStatus("Pronto", lv_color_hex(0x70FFBA));
     current_request_id = "";
 }
 
+void AiChatScreen::startStreamPolling() {
+    stream_sequence = VoiceAssistant::getInstance().getStreamingResponse().sequence;
+    if (!stream_timer) {
+        stream_timer = lv_timer_create(streamPollTimer, STREAM_POLL_INTERVAL_MS, this);
+    }
+}
+
+void AiChatScreen::stopStreamPolling() {
+    if (stream_timer) {
+        lv_timer_del(stream_timer);
+        stream_timer = nullptr;
+    }
+    // The final reply replaces the live bubble
+    if (stream_label) {
+        lv_obj_del(lv_obj_get_parent(stream_label));
+        stream_label = nullptr;
+    }
+}
+
+void AiChatScreen::streamPollTimer(lv_timer_t* timer) {
+    AiChatScreen* screen = static_cast<AiChatScreen*>(timer->user_data);
+    if (!screen || !screen->polling_active) {
+        return;
+    }
+
+    const VoiceAssistant::StreamingResponse partial = VoiceAssistant::getInstance().getStreamingResponse();
+    if (partial.sequence == screen->stream_sequence) {
+        return;
+    }
+    screen->stream_sequence = partial.sequence;
+
+    if (!partial.active) {
+        // Reply finished: fetch the result now instead of waiting for the next 3 s poll
+        pollRequestTimer(screen->poll_timer);
+        return;
+    }
+    if (partial.text.empty()) {
+        return;
+    }
+
+    if (!screen->stream_label) {
+        screen->stream_label = screen->appendMessage("assistant", partial.text.c_str());
+    } else {
+        lv_label_set_text(screen->stream_label, partial.text.c_str());
+        lv_obj_scroll_to_y(screen->root, LV_COORD_MAX, LV_ANIM_OFF);
+    }
+    screen->setStatus(partial.command_ready ? "Esecuzione comando..." : "Risposta in arrivo...",
+                      lv_color_hex(0x7EE7C0));
+
+    // Code blocks are not read out; the final text is still spoken by finish()
+    if (screen->auto_tts_enabled && partial.text[0] != '`') {
+        TtsPipeline::getInstance().update(partial.text);
+        screen->startTtsStatusTimer();
+    }
+}
+
+void AiChatScreen::startTtsStatusTimer() {
+    tts_playing = true;
+    if (tts_status_timer) {
+        return;
+    }
+    tts_status_timer = lv_timer_create([](lv_timer_t* t) {
+        AiChatScreen* screen = static_cast<AiChatScreen*>(t->user_data);
+        if (!screen || !screen->tts_playing || screen->polling_active) {
+            return;  // Still streaming: the request status owns the label
+        }
+        if (!TtsPipeline::getInstance().isActive()) {
+            screen->tts_playing = false;
+            screen->setStatus("Risposta completata", lv_color_hex(0x70FFBA));
+            lv_timer_del(screen->tts_status_timer);
+            screen->tts_status_timer = nullptr;
+        }
+    }, 1000, this);
+}
+
 void AiChatScreen::setStatus(const String& text, lv_color_t color) {
     if (status_label) {
         lv_label_set_text(status_label, text.c_str());
@@ -849,39 +928,13 @@ void AiChatScreen::pollRequestTimer(lv_timer_t* timer) {
                     String meta = resp.command.empty() ? "" : "Comando: " + String(resp.command.c_str());
                     instance->appendMessage("assistant", resp.text.c_str(), meta, resp.output.c_str());
 
-                    // Automatic TTS trigger
+                    // Automatic TTS: speaks what the stream has not already queued
                     if (!resp.text.empty() && instance->auto_tts_enabled) {
-                        String resp_str(resp.text.c_str());
-                        String escaped_text = instance->escapeLuaString(resp_str);
-                        std::string lua_script = "speak_and_play(\"" + std::string(escaped_text.c_str()) + "\")";
-                        CommandResult res = instance->lua_sandbox_.execute(lua_script);
-                        if (res.success) {
-                            instance->setStatus("Parlando risposta...", lv_color_hex(0x7EE7C0));
-                            instance->tts_playing = true;
-                            // Start TTS status timer if not already
-                            if (!instance->tts_status_timer) {
-                                instance->tts_status_timer = lv_timer_create([](lv_timer_t* t) {
-                                    AiChatScreen* screen = static_cast<AiChatScreen*>(t->user_data);
-                                    if (screen && screen->tts_playing) {
-                                        // Call Lua to check radio status
-                                        CommandResult status_res = screen->lua_sandbox_.execute("local _, status = radio.status(); return status");
-                                        if (status_res.success) {
-                                            if (status_res.message.find("ENDED") != std::string::npos || status_res.message.find("STOPPED") != std::string::npos) {
-                                                screen->tts_playing = false;
-                                                screen->setStatus("Risposta completata", lv_color_hex(0x70FFBA));
-                                                if (screen->tts_status_timer) {
-                                                    lv_timer_del(screen->tts_status_timer);
-                                                    screen->tts_status_timer = nullptr;
-                                                }
-                                            }
-                                        }
-                                    }
-                                }, 1000, instance);
-                            }
-                        } else {
-                            instance->setStatus("Errore TTS", lv_color_hex(0xFF7B7B));
-                        }
+                        TtsPipeline::getInstance().finish(resp.text);
+                        instance->setStatus("Parlando risposta...", lv_color_hex(0x7EE7C0));
+                        instance->startTtsStatusTimer();
                     } else {
+                        TtsPipeline::getInstance().cancel();
                         instance->setStatus("Risposta ricevuta", lv_color_hex(0x70FFBA));
                     }
                 } else {
@@ -891,6 +944,7 @@ void AiChatScreen::pollRequestTimer(lv_timer_t* timer) {
                     }
                     instance->appendMessage("assistant", err_msg, "error", "");
                     instance->setStatus("Errore", lv_color_hex(0xFF7B7B));
+                    TtsPipeline::getInstance().cancel();
                 }
                 instance->loadConversationHistory(); // Refresh
                 return;
@@ -970,5 +1024,12 @@ void AiChatScreen::saveSettingsEvent(lv_event_t* e) {
 }
 
 void AiChatScreen::staticInit() {
-    // Any static initialization if needed
+    // Replies are spoken through the assistant's TTS endpoint and the audio manager
+    TtsPipeline::getInstance().setBackend(
+        [](const std::string& text, PsramVector<uint8_t>& audio, const std::atomic<bool>* cancel) {
+            return VoiceAssistant::getInstance().synthesizeSpeech(text, audio, cancel);
+        },
+        [](std::unique_ptr<IDataSource> source, uint32_t sample_rate) {
+            return AudioManager::getInstance().playSource(std::move(source), sample_rate);
+        });
 }
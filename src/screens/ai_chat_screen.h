@@ -11,6 +11,8 @@
 
 class AiChatScreen : public Screen {
 public:
+    static constexpr uint32_t STREAM_POLL_INTERVAL_MS = 150;
+
     ~AiChatScreen() override;
 
     void build(lv_obj_t* parent) override;
@@ -26,13 +28,17 @@ private:
     void applyTheme(const SettingsSnapshot& snapshot);
     void updateStatusIcons();
     void loadConversationHistory();
-    void appendMessage(const String& role, const String& text, const String& meta = "", const String& output = "");
+    lv_obj_t* appendMessage(const String& role, const String& text, const String& meta = "", const String& output = "");
     void sendChatMessage();
     void toggleRecording();
     bool handleTranscription(const String& transcription);
     void setStatus(const String& text, lv_color_t color);
     void updateLayout(bool landscape);
     void stopPolling();
+    void startStreamPolling();
+    void stopStreamPolling();
+    void startTtsStatusTimer();
+    static void streamPollTimer(lv_timer_t* timer);
     static void statusUpdateTimer(lv_timer_t* timer);
     static void pollRequestTimer(lv_timer_t* timer);
     static void sendButtonEvent(lv_event_t* e);
@@ -40,8 +46,6 @@ private:
     static void inputEvent(lv_event_t* e);
     static void autosendEvent(lv_event_t* e);
 
-    String escapeLuaString(const String& s);
-
     lv_obj_t* root = nullptr;
     lv_obj_t* header_container = nullptr;
     lv_obj_t* status_bar = nullptr;
@@ -71,6 +75,9 @@ private:
     lv_timer_t* status_timer = nullptr;
     lv_timer_t* poll_timer = nullptr;
     lv_timer_t* tts_status_timer = nullptr;
+    lv_timer_t* stream_timer = nullptr;
+    lv_obj_t* stream_label = nullptr;   // Live assistant bubble while the reply streams
+    uint32_t stream_sequence = 0;
     uint32_t settings_listener_id = 0;
     bool recording = false;
     bool autosend_enabled = true;
@@ -80,8 +87,6 @@ private:
     bool tts_playing = false;
     std::string current_request_id;
 
-    VoiceAssistant::LuaSandbox lua_sandbox_;
-
     void staticInit();
 
     void startRecording();
@@ -243,25 +243,13 @@ void MicrophoneTestScreen::recordingTask(void* param) {
 
     Logger::getInstance().info("[MicTest] Recording task started - using MicrophoneManager");
 
-    // Configure recording with UI callback for level updates
+    // Level updates are polled by levelPollTimer() from the LVGL task
     MicrophoneManager::RecordingConfig config;
     config.duration_seconds = kDefaultRecordingDurationSeconds;
     config.sample_rate = 16000;
     config.bits_per_sample = 16;
     config.channels = 1;
     config.enable_agc = true;
-    config.level_callback = [screen](uint16_t level) {
-        // Check if screen is still valid before accessing UI
-        if (!screen->screen_valid.load()) {
-            return;
-        }
-
-        // Lock LVGL mutex before accessing UI elements
-        if (lvgl_mutex_lock(pdMS_TO_TICKS(10))) {
-            screen->updateMicLevelIndicator(level);
-            lvgl_mutex_unlock();
-        }
-    };
 
     // Start recording using MicrophoneManager
     auto handle = MicrophoneManager::getInstance().startRecording(
@@ -280,6 +268,7 @@ void MicrophoneTestScreen::recordingTask(void* param) {
             screen->is_recording = false;
             screen->stop_recording_requested.store(false);
             screen->recording_task_handle = nullptr;
+            screen->stopLevelPolling();
             screen->applyThemeStyles(SettingsManager::getInstance().getSnapshot());
             screen->updateMicLevelIndicator(0);
             lvgl_mutex_unlock();
@@ -325,6 +314,7 @@ void MicrophoneTestScreen::recordingTask(void* param) {
         }
 
         screen->is_recording = false;
+        screen->stopLevelPolling();
         screen->updateMicLevelIndicator(0);
         screen->recording_task_handle = nullptr;
         screen->applyThemeStyles(SettingsManager::getInstance().getSnapshot());
@@ -341,6 +331,7 @@ void MicrophoneTestScreen::recordingTask(void* param) {
 MicrophoneTestScreen::~MicrophoneTestScreen() {
     // Invalidate screen to prevent callbacks from accessing destroyed object
     screen_valid.store(false);
+    stopLevelPolling();
 
     // Stop any ongoing recording
     if (is_recording) {
@@ -570,6 +561,28 @@ void MicrophoneTestScreen::updateMicLevelIndicator(uint16_t level) {
     }
 }
 
+void MicrophoneTestScreen::startLevelPolling() {
+    if (!level_timer) {
+        level_timer = lv_timer_create(levelPollTimer, LEVEL_POLL_INTERVAL_MS, this);
+    }
+}
+
+void MicrophoneTestScreen::stopLevelPolling() {
+    if (level_timer) {
+        lv_timer_del(level_timer);
+        level_timer = nullptr;
+    }
+}
+
+void MicrophoneTestScreen::levelPollTimer(lv_timer_t* timer) {
+    auto* screen = static_cast<MicrophoneTestScreen*>(timer->user_data);
+    if (!screen || !screen->is_recording) {
+        return;
+    }
+    const auto snapshot = MicrophoneManager::getInstance().getLevelSnapshot();
+    screen->updateMicLevelIndicator(snapshot.recording ? snapshot.level : 0);
+}
+
 void MicrophoneTestScreen::requestStopRecording() {
     if (!is_recording) {
         if (record_status_label) {
@@ -680,6 +693,7 @@ void MicrophoneTestScreen::handleRecordStartButton(lv_event_t* e) {
     screen->is_recording = true;
     screen->stop_recording_requested.store(false);
     screen->updateMicLevelIndicator(0);
+    screen->startLevelPolling();
     if (screen->record_status_label) {
         lv_label_set_text(screen->record_status_label, "Registrazione in corso...");
     }
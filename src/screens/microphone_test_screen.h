@@ -10,6 +10,7 @@
 class MicrophoneTestScreen : public Screen {
 public:
     static constexpr lv_coord_t CARD_HEIGHT_PX = 80;
+    static constexpr uint32_t LEVEL_POLL_INTERVAL_MS = 50;
 
     ~MicrophoneTestScreen() override;
 
@@ -23,7 +24,10 @@ protected:
     void refreshAudioFilesList();
     void updateMicLevelIndicator(uint16_t level);
     void requestStopRecording();
+    void startLevelPolling();
+    void stopLevelPolling();
     static void recordingTask(void* param);
+    static void levelPollTimer(lv_timer_t* timer);
 
     static void handleRecordStartButton(lv_event_t* e);
     static void handleRecordStopButton(lv_event_t* e);
@@ -42,6 +46,7 @@ protected:
     lv_obj_t* record_status_label = nullptr;
     lv_obj_t* playback_status_label = nullptr;
     lv_obj_t* files_container = nullptr;
+    lv_timer_t* level_timer = nullptr;
 
     uint32_t settings_listener_id = 0;
     bool updating_from_manager = false;
@@ -0,0 +1,222 @@
+#include "utils/command_plan.h"
+
+#include <algorithm>
+
+bool CommandPlan::addStep(Step step) {
+    if (steps_.size() >= kMaxSteps) {
+        return false;
+    }
+    steps_.push_back(std::move(step));
+    return true;
+}
+
+int CommandPlan::findStep(const std::string& id) const {
+    for (size_t i = 0; i < steps_.size(); ++i) {
+        if (steps_[i].id == id) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+bool CommandPlan::prepare(std::string& error) {
+    for (size_t i = 0; i < steps_.size(); ++i) {
+        Step& step = steps_[i];
+        if (step.id.empty()) {
+            step.id = std::to_string(i + 1);
+        }
+        if (step.command.empty()) {
+            error = "step " + step.id + " has no command";
+            return false;
+        }
+        for (size_t j = 0; j < i; ++j) {
+            if (steps_[j].id == step.id) {
+                error = "duplicate step id " + step.id;
+                return false;
+            }
+        }
+    }
+
+    for (Step& step : steps_) {
+        step.deps.clear();
+        for (const std::string& id : step.after) {
+            const int dep = findStep(id);
+            if (dep < 0) {
+                error = "step " + step.id + " waits for unknown step " + id;
+                return false;
+            }
+            step.deps.push_back(static_cast<size_t>(dep));
+        }
+        // {{id}} of a known step is an implicit dependency
+        for (const std::string& arg : step.args) {
+            for (size_t open = arg.find("{{"); open != std::string::npos; open = arg.find("{{", open + 2)) {
+                const size_t close = arg.find("}}", open + 2);
+                if (close == std::string::npos) {
+                    break;
+                }
+                const int dep = findStep(arg.substr(open + 2, close - open - 2));
+                if (dep >= 0) {
+                    step.deps.push_back(static_cast<size_t>(dep));
+                }
+            }
+        }
+        std::sort(step.deps.begin(), step.deps.end());
+        step.deps.erase(std::unique(step.deps.begin(), step.deps.end()), step.deps.end());
+    }
+
+    // Kahn's algorithm: every step must become reachable
+    std::vector<size_t> remaining(steps_.size());
+    for (size_t i = 0; i < steps_.size(); ++i) {
+        remaining[i] = steps_[i].deps.size();
+    }
+    std::vector<bool> placed(steps_.size(), false);
+    size_t placed_count = 0;
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (size_t i = 0; i < steps_.size(); ++i) {
+            if (placed[i] || remaining[i] != 0) {
+                continue;
+            }
+            placed[i] = true;
+            ++placed_count;
+            progress = true;
+            for (size_t j = 0; j < steps_.size(); ++j) {
+                if (std::find(steps_[j].deps.begin(), steps_[j].deps.end(), i) != steps_[j].deps.end()) {
+                    --remaining[j];
+                }
+            }
+        }
+    }
+    if (placed_count != steps_.size()) {
+        error = "dependency cycle between steps";
+        return false;
+    }
+    return true;
+}
+
+bool CommandPlan::claimNext(size_t& index) {
+    // Settle skips first so finished() never waits on a step that cannot run
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (Step& step : steps_) {
+            if (step.state != State::Pending) {
+                continue;
+            }
+            for (size_t dep : step.deps) {
+                const State dep_state = steps_[dep].state;
+                if (dep_state == State::Failed || dep_state == State::Skipped) {
+                    step.state = State::Skipped;
+                    step.output = "skipped: step " + steps_[dep].id + " did not succeed";
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < steps_.size(); ++i) {
+        Step& step = steps_[i];
+        if (step.state != State::Pending) {
+            continue;
+        }
+        const bool ready = std::all_of(step.deps.begin(), step.deps.end(),
+                                       [this](size_t dep) { return steps_[dep].state == State::Done; });
+        if (ready) {
+            step.state = State::Running;
+            index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<std::string> CommandPlan::resolvedArgs(size_t index) const {
+    std::vector<std::string> args = steps_[index].args;
+    for (std::string& arg : args) {
+        size_t open = arg.find("{{");
+        while (open != std::string::npos) {
+            const size_t close = arg.find("}}", open + 2);
+            if (close == std::string::npos) {
+                break;
+            }
+            const int dep = findStep(arg.substr(open + 2, close - open - 2));
+            if (dep < 0) {
+                open = arg.find("{{", open + 2);
+                continue;
+            }
+            const std::string& output = steps_[dep].output;
+            arg.replace(open, close + 2 - open, output);
+            open = arg.find("{{", open + output.size());
+        }
+    }
+    return args;
+}
+
+void CommandPlan::complete(size_t index, bool success, std::string output, uint32_t duration_ms) {
+    Step& step = steps_[index];
+    step.state = success ? State::Done : State::Failed;
+    step.output = std::move(output);
+    step.duration_ms = duration_ms;
+}
+
+bool CommandPlan::finished() const {
+    return std::none_of(steps_.begin(), steps_.end(), [](const Step& step) {
+        return step.state == State::Pending || step.state == State::Running;
+    });
+}
+
+bool CommandPlan::succeeded() const {
+    return std::all_of(steps_.begin(), steps_.end(), [](const Step& step) { return step.state == State::Done; });
+}
+
+// Level of each step: 0 without dependencies, else 1 + the deepest dependency (needs prepare())
+std::vector<size_t> CommandPlan::levels() const {
+    std::vector<size_t> level(steps_.size(), 0);
+    for (size_t pass = 0; pass < steps_.size(); ++pass) {
+        for (size_t i = 0; i < steps_.size(); ++i) {
+            for (size_t dep : steps_[i].deps) {
+                level[i] = std::max(level[i], level[dep] + 1);
+            }
+        }
+    }
+    return level;
+}
+
+size_t CommandPlan::width() const {
+    const std::vector<size_t> level = levels();
+    size_t widest = 0;
+    for (size_t l = 0; l < steps_.size(); ++l) {
+        widest = std::max<size_t>(widest, std::count(level.begin(), level.end(), l));
+    }
+    return widest;
+}
+
+size_t CommandPlan::depth() const {
+    const std::vector<size_t> level = levels();
+    return level.empty() ? 0 : *std::max_element(level.begin(), level.end()) + 1;
+}
+
+std::string CommandPlan::summary() const {
+    std::string out;
+    for (const Step& step : steps_) {
+        out += "[" + step.id + "] " + step.command + ": " + stateName(step.state) + "\n";
+        if (!step.output.empty()) {
+            out += step.output;
+            out += "\n";
+        }
+    }
+    return out;
+}
+
+const char* CommandPlan::stateName(State state) {
+    switch (state) {
+        case State::Pending: return "pending";
+        case State::Running: return "running";
+        case State::Done: return "ok";
+        case State::Failed: return "failed";
+        case State::Skipped: return "skipped";
+    }
+    return "?";
+}
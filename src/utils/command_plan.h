@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Several commands from one LLM reply, with dependency hints
+ *
+ * Reply format (see parseGPTCommand):
+ *   {"plan": [{"id": "led", "command": "led_brightness", "args": ["0"]},
+ *             {"id": "vol", "command": "volume_down", "args": []},
+ *             {"id": "meteo", "command": "lua_script", "args": ["..."]},
+ *             {"command": "bt_type", "args": ["<mac>", "{{meteo}}"], "after": ["meteo"]}],
+ *    "text": "...", "should_refine_output": true}
+ *
+ * A step runs once every step listed in "after" has succeeded; "{{id}}" in an
+ * argument is replaced by that step's output and implies the dependency.
+ * Steps without an id are named by their 1-based position. A step whose
+ * dependency failed or was skipped is skipped, independent steps still run.
+ *
+ * The plan only tracks state: it is not thread-safe, the executor serializes
+ * claimNext() / complete() around the (concurrent) command calls.
+ */
+class CommandPlan {
+public:
+    static constexpr size_t kMaxSteps = 8;
+
+    enum class State : uint8_t { Pending, Running, Done, Failed, Skipped };
+
+    struct Step {
+        std::string id;
+        std::string command;
+        std::vector<std::string> args;
+        std::vector<std::string> after;     // Step ids as written in the reply
+        std::vector<size_t> deps;           // Resolved by prepare()
+        State state = State::Pending;
+        std::string output;
+        uint32_t duration_ms = 0;
+    };
+
+    /** Append a step; false once kMaxSteps are queued */
+    bool addStep(Step step);
+
+    /**
+     * @brief Resolve ids and dependencies
+     * @return false (with a reason in error) for duplicate or unknown ids and cycles
+     */
+    bool prepare(std::string& error);
+
+    /** Claim the first pending step whose dependencies are done (marks it Running) */
+    bool claimNext(size_t& index);
+
+    /** Arguments of a step with {{id}} references expanded */
+    std::vector<std::string> resolvedArgs(size_t index) const;
+
+    void complete(size_t index, bool success, std::string output, uint32_t duration_ms);
+
+    /** Nothing pending or running */
+    bool finished() const;
+    /** Every step succeeded */
+    bool succeeded() const;
+
+    /** Most steps that can run at the same time (widest dependency level) */
+    size_t width() const;
+    /** Length of the longest dependency chain */
+    size_t depth() const;
+
+    /** Per-step results in order, the input of the single refinement request */
+    std::string summary() const;
+
+    bool empty() const { return steps_.empty(); }
+    size_t size() const { return steps_.size(); }
+    const Step& step(size_t index) const { return steps_[index]; }
+    const std::vector<Step>& steps() const { return steps_; }
+
+    static const char* stateName(State state);
+
+private:
+    std::vector<size_t> levels() const;
+    int findStep(const std::string& id) const;
+
+    std::vector<Step> steps_;
+};
@@ -0,0 +1,159 @@
+#include "ima_adpcm_encoder.h"
+
+#include <cstring>
+
+namespace {
+
+const int16_t kStepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+const int8_t kIndexTable[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+inline void writeLe16(uint8_t* p, uint16_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+inline void writeLe32(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v >> 16);
+    p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+} // namespace
+
+void ImaAdpcmEncoder::reset() {
+    fill_ = 0;
+    predictor_ = 0;
+    step_index_ = 0;
+}
+
+uint8_t ImaAdpcmEncoder::encodeSample(int32_t sample) {
+    int32_t step = kStepTable[step_index_];
+    int32_t diff = sample - predictor_;
+    uint8_t nibble = 0;
+    if (diff < 0) {
+        nibble = 8;
+        diff = -diff;
+    }
+
+    // Successive approximation; vpdiff mirrors exactly what the decoder reconstructs
+    int32_t vpdiff = step >> 3;
+    if (diff >= step) {
+        nibble |= 4;
+        diff -= step;
+        vpdiff += step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        nibble |= 2;
+        diff -= step;
+        vpdiff += step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        nibble |= 1;
+        vpdiff += step;
+    }
+
+    predictor_ += (nibble & 8) ? -vpdiff : vpdiff;
+    if (predictor_ > 32767) {
+        predictor_ = 32767;
+    } else if (predictor_ < -32768) {
+        predictor_ = -32768;
+    }
+
+    step_index_ += kIndexTable[nibble];
+    if (step_index_ < 0) {
+        step_index_ = 0;
+    } else if (step_index_ > 88) {
+        step_index_ = 88;
+    }
+    return nibble;
+}
+
+void ImaAdpcmEncoder::encodeBlock(uint8_t* out) {
+    // Block header: first sample verbatim + current step index
+    predictor_ = block_[0];
+    writeLe16(out, static_cast<uint16_t>(block_[0]));
+    out[2] = static_cast<uint8_t>(step_index_);
+    out[3] = 0;
+
+    uint8_t* data = out + 4;
+    for (size_t i = 1; i < kSamplesPerBlock; i += 2) {
+        const uint8_t low = encodeSample(block_[i]);
+        const uint8_t high = encodeSample(block_[i + 1]);
+        *data++ = static_cast<uint8_t>(low | (high << 4));
+    }
+}
+
+size_t ImaAdpcmEncoder::encode(const int16_t* pcm, size_t count, uint8_t* out, size_t out_capacity) {
+    size_t produced = 0;
+    for (size_t i = 0; i < count; ++i) {
+        block_[fill_++] = pcm[i];
+        if (fill_ < kSamplesPerBlock) {
+            continue;
+        }
+        if (produced + kBlockAlign > out_capacity) {
+            // Caller under-sized the output: keep the block pending rather than corrupt memory
+            fill_--;
+            return produced;
+        }
+        encodeBlock(out + produced);
+        produced += kBlockAlign;
+        fill_ = 0;
+    }
+    return produced;
+}
+
+size_t ImaAdpcmEncoder::flush(uint8_t* out, size_t out_capacity) {
+    if (fill_ == 0 || out_capacity < kBlockAlign) {
+        return 0;
+    }
+    memset(&block_[fill_], 0, (kSamplesPerBlock - fill_) * sizeof(int16_t));
+    encodeBlock(out);
+    fill_ = 0;
+    return kBlockAlign;
+}
+
+void ImaAdpcmEncoder::buildWavHeader(uint8_t* out, uint32_t sample_rate, uint32_t data_bytes, uint32_t total_samples) {
+    const uint32_t riff_size = (data_bytes == kUnknownLength) ? kUnknownLength
+                                                              : static_cast<uint32_t>(kWavHeaderSize - 8) + data_bytes;
+    const uint32_t bytes_per_second =
+        static_cast<uint32_t>((static_cast<uint64_t>(sample_rate) * kBlockAlign) / kSamplesPerBlock);
+
+    memcpy(out, "RIFF", 4);
+    writeLe32(out + 4, riff_size);
+    memcpy(out + 8, "WAVE", 4);
+
+    memcpy(out + 12, "fmt ", 4);
+    writeLe32(out + 16, 20);
+    writeLe16(out + 20, 0x0011);            // WAVE_FORMAT_IMA_ADPCM
+    writeLe16(out + 22, 1);                 // mono
+    writeLe32(out + 24, sample_rate);
+    writeLe32(out + 28, bytes_per_second);
+    writeLe16(out + 32, kBlockAlign);
+    writeLe16(out + 34, 4);                 // bits per sample
+    writeLe16(out + 36, 2);                 // cbSize
+    writeLe16(out + 38, kSamplesPerBlock);
+
+    memcpy(out + 40, "fact", 4);
+    writeLe32(out + 44, 4);
+    writeLe32(out + 48, total_samples);
+
+    memcpy(out + 52, "data", 4);
+    writeLe32(out + 56, data_bytes);
+}
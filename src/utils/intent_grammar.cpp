@@ -0,0 +1,314 @@
+#include "utils/intent_grammar.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace {
+
+struct NumberWord {
+    const char* word;
+    int value;
+};
+
+constexpr NumberWord kUnits[] = {
+    {"zero", 0}, {"un", 1}, {"uno", 1}, {"una", 1}, {"due", 2}, {"tre", 3}, {"quattro", 4},
+    {"cinque", 5}, {"sei", 6}, {"sette", 7}, {"otto", 8}, {"nove", 9}, {"dieci", 10},
+    {"undici", 11}, {"dodici", 12}, {"tredici", 13}, {"quattordici", 14}, {"quindici", 15},
+    {"sedici", 16}, {"diciassette", 17}, {"diciotto", 18}, {"diciannove", 19},
+};
+
+constexpr NumberWord kTens[] = {
+    {"venti", 20}, {"trenta", 30}, {"quaranta", 40}, {"cinquanta", 50},
+    {"sessanta", 60}, {"settanta", 70}, {"ottanta", 80}, {"novanta", 90},
+};
+
+constexpr const char* kFillers[] = {
+    "il", "lo", "la", "i", "gli", "le", "l", "un", "una", "per", "favore", "piacere",
+    "ok", "okay", "ehi", "hey", "ciao", "allora", "dai", "mi", "ci", "please",
+};
+
+int unitValue(const std::string& word) {
+    for (const NumberWord& unit : kUnits) {
+        if (word == unit.word) {
+            return unit.value;
+        }
+    }
+    return -1;
+}
+
+// "settantacinque", "ventuno" (elided vowel), "quaranta"
+int compoundValue(const std::string& word) {
+    for (const NumberWord& tens : kTens) {
+        const size_t length = strlen(tens.word);
+        if (word.compare(0, length, tens.word) == 0) {
+            if (word.size() == length) {
+                return tens.value;
+            }
+            const int unit = unitValue(word.substr(length));
+            if (unit >= 1 && unit <= 9) {
+                return tens.value + unit;
+            }
+        } else if (word.compare(0, length - 1, tens.word, length - 1) == 0) {
+            const std::string rest = word.substr(length - 1);
+            if (rest == "uno" || rest == "otto") {
+                return tens.value + unitValue(rest);
+            }
+        }
+    }
+    return word == "cento" ? 100 : -1;
+}
+
+// Fold a two-byte UTF-8 Latin-1 letter (0xC3 xx) to its lower-case ASCII base
+char foldLatin1(uint8_t second) {
+    const uint8_t c = second >= 0xA0 ? second - 0x20 : second;  // Lower to upper range 0x80-0x9F
+    if (c <= 0x85) return 'a';
+    if (c == 0x87) return 'c';
+    if (c >= 0x88 && c <= 0x8B) return 'e';
+    if (c >= 0x8C && c <= 0x8F) return 'i';
+    if (c == 0x91) return 'n';
+    if (c >= 0x92 && c <= 0x96) return 'o';
+    if (c >= 0x99 && c <= 0x9C) return 'u';
+    return 0;
+}
+
+} // namespace
+
+std::vector<std::string> IntentGrammar::normalize(const std::string& text) {
+    std::vector<std::string> words;
+    std::string current;
+    auto flush = [&]() {
+        if (!current.empty()) {
+            words.push_back(std::move(current));
+            current.clear();
+        }
+    };
+
+    for (size_t i = 0; i < text.size(); ++i) {
+        const uint8_t c = static_cast<uint8_t>(text[i]);
+        if (c < 0x80) {
+            if (isalnum(c)) {
+                current.push_back(static_cast<char>(tolower(c)));
+            } else {
+                flush();  // Punctuation, apostrophes ("l'audio") and spaces split words
+            }
+        } else if (c == 0xC3 && i + 1 < text.size()) {
+            const char folded = foldLatin1(static_cast<uint8_t>(text[++i]));
+            if (folded) {
+                current.push_back(folded);
+            } else {
+                flush();
+            }
+        } else {
+            flush();  // Other scripts/symbols are not part of the grammar
+            while (i + 1 < text.size() && (static_cast<uint8_t>(text[i + 1]) & 0xC0) == 0x80) {
+                ++i;
+            }
+        }
+    }
+    flush();
+    return words;
+}
+
+bool IntentGrammar::parseNumber(const std::vector<std::string>& words, size_t index, long& value, size_t& consumed) {
+    if (index >= words.size()) {
+        return false;
+    }
+    const std::string& word = words[index];
+    if (!word.empty() && word.size() <= 9 &&
+        std::all_of(word.begin(), word.end(), [](char c) { return isdigit(static_cast<unsigned char>(c)); })) {
+        value = strtol(word.c_str(), nullptr, 10);
+        consumed = 1;
+        return true;
+    }
+
+    int number = unitValue(word);
+    if (number < 0) {
+        number = compoundValue(word);
+    }
+    if (number < 0) {
+        return false;
+    }
+    value = number;
+    consumed = 1;
+    return true;
+}
+
+std::string IntentGrammar::expand(const std::string& templ, const Slots& slots) {
+    std::string out = templ;
+    for (const auto& slot : slots) {
+        const std::string placeholder = "{" + slot.first + "}";
+        size_t pos = 0;
+        while ((pos = out.find(placeholder, pos)) != std::string::npos) {
+            out.replace(pos, placeholder.size(), slot.second);
+            pos += slot.second.size();
+        }
+    }
+    return out;
+}
+
+bool IntentGrammar::isFiller(const std::string& word) {
+    for (const char* filler : kFillers) {
+        if (word == filler) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool IntentGrammar::addPattern(int intent, const std::string& pattern) {
+    Pattern compiled;
+    compiled.intent = intent;
+
+    size_t pos = 0;
+    while (pos < pattern.size()) {
+        while (pos < pattern.size() && pattern[pos] == ' ') {
+            ++pos;
+        }
+        if (pos >= pattern.size()) {
+            break;
+        }
+        size_t end = pattern.find(' ', pos);
+        if (end == std::string::npos) {
+            end = pattern.size();
+        }
+        std::string token = pattern.substr(pos, end - pos);
+        pos = end;
+
+        Element element;
+        if (token.size() >= 2 && token.front() == '[' && token.back() == ']') {
+            element.optional = true;
+            token = token.substr(1, token.size() - 2);
+        }
+
+        if (token.size() >= 2 && token.front() == '{' && token.back() == '}') {
+            const size_t colon = token.find(':');
+            if (colon == std::string::npos) {
+                return false;
+            }
+            element.slot = token.substr(1, colon - 1);
+            const std::string kind = token.substr(colon + 1, token.size() - colon - 2);
+            if (kind == "number") {
+                element.kind = Kind::Number;
+            } else if (kind == "word") {
+                element.kind = Kind::Word;
+            } else if (kind == "text") {
+                element.kind = Kind::Text;
+            } else {
+                return false;
+            }
+            if (element.slot.empty()) {
+                return false;
+            }
+        } else {
+            size_t start = 0;
+            while (start <= token.size()) {
+                size_t bar = token.find('|', start);
+                if (bar == std::string::npos) {
+                    bar = token.size();
+                }
+                const std::vector<std::string> words = normalize(token.substr(start, bar - start));
+                if (words.size() != 1) {
+                    return false;  // Each alternative is exactly one word
+                }
+                element.alternatives.push_back(words[0]);
+                start = bar + 1;
+            }
+        }
+
+        if (!compiled.elements.empty() && compiled.elements.back().kind == Kind::Text) {
+            return false;  // A text slot swallows the rest, nothing may follow
+        }
+        compiled.elements.push_back(std::move(element));
+    }
+
+    const bool has_required = std::any_of(compiled.elements.begin(), compiled.elements.end(),
+                                          [](const Element& e) { return !e.optional; });
+    if (!has_required) {
+        return false;  // Would match empty or filler-only utterances
+    }
+    patterns_.push_back(std::move(compiled));
+    return true;
+}
+
+bool IntentGrammar::match(const std::string& utterance, Match& result) const {
+    const std::vector<std::string> words = normalize(utterance);
+    if (words.empty()) {
+        return false;
+    }
+
+    for (const Pattern& pattern : patterns_) {
+        Slots slots;
+        if (matchFrom(pattern, 0, words, 0, slots)) {
+            result.intent = pattern.intent;
+            result.slots = std::move(slots);
+            result.words = words.size();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool IntentGrammar::matchFrom(const Pattern& pattern, size_t element, const std::vector<std::string>& words,
+                              size_t word, Slots& slots) const {
+    const size_t count = words.size();
+    if (element == pattern.elements.size()) {
+        while (word < count && isFiller(words[word])) {
+            ++word;
+        }
+        return word == count;
+    }
+
+    const Element& e = pattern.elements[element];
+    const size_t mark = slots.size();
+    if (word < count) {
+        switch (e.kind) {
+            case Kind::Literal:
+                if (std::find(e.alternatives.begin(), e.alternatives.end(), words[word]) != e.alternatives.end() &&
+                    matchFrom(pattern, element + 1, words, word + 1, slots)) {
+                    return true;
+                }
+                break;
+            case Kind::Number: {
+                long value = 0;
+                size_t used = 0;
+                if (parseNumber(words, word, value, used)) {
+                    slots.emplace_back(e.slot, std::to_string(value));
+                    if (matchFrom(pattern, element + 1, words, word + used, slots)) {
+                        return true;
+                    }
+                    slots.resize(mark);
+                }
+                break;
+            }
+            case Kind::Word:
+                if (!isFiller(words[word])) {
+                    slots.emplace_back(e.slot, words[word]);
+                    if (matchFrom(pattern, element + 1, words, word + 1, slots)) {
+                        return true;
+                    }
+                    slots.resize(mark);
+                }
+                break;
+            case Kind::Text: {
+                std::string text = words[word];
+                for (size_t i = word + 1; i < count; ++i) {
+                    text += ' ';
+                    text += words[i];
+                }
+                slots.emplace_back(e.slot, text);
+                if (matchFrom(pattern, element + 1, words, count, slots)) {
+                    return true;
+                }
+                slots.resize(mark);
+                break;
+            }
+        }
+    }
+
+    if (e.optional && matchFrom(pattern, element + 1, words, word, slots)) {
+        return true;
+    }
+    // Skip a filler word the pattern did not ask for
+    return word < count && isFiller(words[word]) && matchFrom(pattern, element, words, word + 1, slots);
+}
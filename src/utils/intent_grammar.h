@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Compiled keyword grammar for short spoken commands
+ *
+ * Pattern syntax (one pattern per string, words separated by spaces):
+ *   volume            literal word
+ *   alza|aumenta      any of the alternatives
+ *   [il]              optional element (also [su|più])
+ *   {n:number}        number slot: digits or Italian number words ("cinquanta")
+ *   {name:word}       one word
+ *   {query:text}      the rest of the utterance (last element only)
+ *
+ * Text is normalized before matching: lower case, Italian accents folded
+ * (più -> piu), punctuation dropped. A match must account for every word of the
+ * utterance; filler words ("per favore", articles, "ehi") are skipped wherever
+ * the pattern does not ask for them, so "alza il volume per favore" matches
+ * "alza [il] volume" but "alza il volume della radio in cucina" does not.
+ */
+class IntentGrammar {
+public:
+    using Slots = std::vector<std::pair<std::string, std::string>>;
+
+    struct Match {
+        int intent = -1;       // Index passed to addPattern()
+        Slots slots;
+        size_t words = 0;      // Words in the normalized utterance
+    };
+
+    /**
+     * @brief Compile a pattern for an intent
+     * @return false if the pattern is malformed (it is then ignored)
+     */
+    bool addPattern(int intent, const std::string& pattern);
+
+    void clear() { patterns_.clear(); }
+    size_t size() const { return patterns_.size(); }
+
+    /** First pattern (in insertion order) covering the whole utterance */
+    bool match(const std::string& utterance, Match& result) const;
+
+    /** Lower-cased, accent-folded words without punctuation */
+    static std::vector<std::string> normalize(const std::string& text);
+
+    /** Parse words[index...] as a number; sets consumed to the words used */
+    static bool parseNumber(const std::vector<std::string>& words, size_t index, long& value, size_t& consumed);
+
+    /** Replace {slot} placeholders in a template */
+    static std::string expand(const std::string& templ, const Slots& slots);
+
+private:
+    enum class Kind : uint8_t { Literal, Number, Word, Text };
+
+    struct Element {
+        Kind kind = Kind::Literal;
+        bool optional = false;
+        std::vector<std::string> alternatives;  // Literal
+        std::string slot;                       // Number/Word/Text
+    };
+
+    struct Pattern {
+        int intent = -1;
+        std::vector<Element> elements;
+    };
+
+    static bool isFiller(const std::string& word);
+    bool matchFrom(const Pattern& pattern, size_t element, const std::vector<std::string>& words,
+                   size_t word, Slots& slots) const;
+
+    std::vector<Pattern> patterns_;
+};
@@ -0,0 +1,156 @@
+#include "utils/intent_table.h"
+
+#include <ArduinoJson.h>
+#include <algorithm>
+
+#include "utils/logger.h"
+
+namespace {
+constexpr const char* TAG = "IntentMatcher";
+
+struct BuiltinIntent {
+    const char* command;
+    const char* arg;           // Single argument template, nullptr for none
+    const char* reply;
+    const char* patterns[6];   // nullptr-terminated
+};
+
+// Phrasings Whisper produces for the commands people say most; only used when
+// the command is registered
+constexpr BuiltinIntent kBuiltins[] = {
+    {"volume_set", "{n}", "Volume al {n}%",
+     {"[imposta|metti|porta] [il] volume [a|al] {n:number} [percento|cento]", nullptr}},
+    {"volume_up", nullptr, "Volume alzato",
+     {"alza|aumenta|alzare|aumentare|alzi [il] volume", "volume su|più", "più volume", nullptr}},
+    {"volume_down", nullptr, "Volume abbassato",
+     {"abbassa|diminuisci|abbassare|diminuire|abbassi [il] volume", "volume giù|meno", "meno volume", nullptr}},
+    {"led_brightness", "{n}", "LED al {n}%",
+     {"[imposta|metti|porta] [luminosità] led [a|al] {n:number} [percento|cento]", nullptr}},
+    {"brightness_set", "{n}", "Luminosità al {n}%",
+     {"[imposta|metti|porta] [la] luminosità [schermo|display] [a|al] {n:number} [percento|cento]", nullptr}},
+    {"brightness_up", nullptr, "Luminosità aumentata",
+     {"alza|aumenta|alzare|aumentare [la] luminosità", "luminosità su|più", "più luce|luminosità", nullptr}},
+    {"brightness_down", nullptr, "Luminosità diminuita",
+     {"abbassa|diminuisci|abbassare|diminuire [la] luminosità", "luminosità giù|meno", "meno luce|luminosità", nullptr}},
+    {"radio_stop", nullptr, "Riproduzione fermata",
+     {"stop|ferma|fermare|spegni|basta [radio|musica|audio|riproduzione]", nullptr}},
+};
+
+std::string escapeLuaLiteral(const std::string& value) {
+    std::string out;
+    out.reserve(value.size());
+    for (char c : value) {
+        if (c == '\\' || c == '"' || c == '\'') {
+            out.push_back('\\');
+        }
+        out.push_back(c == '\n' ? ' ' : c);
+    }
+    return out;
+}
+} // namespace
+
+constexpr size_t IntentTable::kMaxWords;
+
+void IntentTable::clear() {
+    grammar_.clear();
+    intents_.clear();
+}
+
+bool IntentTable::addUserIntents(const std::string& json) {
+    JsonDocument doc;
+    DeserializationError err = deserializeJson(doc, json);
+    if (err) {
+        Logger::getInstance().errorf("[%s] User intents parse error: %s", TAG, err.c_str());
+        return false;
+    }
+
+    for (JsonObjectConst item : doc["intents"].as<JsonArrayConst>()) {
+        Intent intent;
+        intent.command = item["command"] | "";
+        intent.reply = item["reply"] | "";
+        if (intent.command.empty()) {
+            continue;
+        }
+        for (JsonVariantConst arg : item["args"].as<JsonArrayConst>()) {
+            intent.args.push_back(arg.as<const char*>() ? arg.as<const char*>() : "");
+        }
+        std::vector<std::string> patterns;
+        for (JsonVariantConst pattern : item["patterns"].as<JsonArrayConst>()) {
+            if (pattern.is<const char*>()) {
+                patterns.push_back(pattern.as<const char*>());
+            }
+        }
+        addIntent(std::move(intent), patterns);
+    }
+    return true;
+}
+
+void IntentTable::addBuiltins(const std::vector<std::string>& registered) {
+    for (const BuiltinIntent& builtin : kBuiltins) {
+        if (std::find(registered.begin(), registered.end(), builtin.command) == registered.end()) {
+            continue;
+        }
+        Intent intent;
+        intent.command = builtin.command;
+        if (builtin.arg) {
+            intent.args.push_back(builtin.arg);
+        }
+        intent.reply = builtin.reply;
+        std::vector<std::string> patterns;
+        for (const char* const* pattern = builtin.patterns; *pattern; ++pattern) {
+            patterns.push_back(*pattern);
+        }
+        addIntent(std::move(intent), patterns);
+    }
+}
+
+void IntentTable::addCommandNames(const std::vector<std::string>& registered) {
+    // A command missing its arguments fails and the text falls through to the LLM
+    for (const std::string& name : registered) {
+        std::string pattern = name;
+        std::replace(pattern.begin(), pattern.end(), '_', ' ');
+        Intent intent;
+        intent.command = name;
+        addIntent(std::move(intent), {pattern});
+    }
+}
+
+bool IntentTable::match(const std::string& text, Result& result) const {
+    IntentGrammar::Match match;
+    if (IntentGrammar::normalize(text).size() > kMaxWords || !grammar_.match(text, match) ||
+        match.intent < 0 || static_cast<size_t>(match.intent) >= intents_.size()) {
+        return false;
+    }
+
+    const Intent& intent = intents_[match.intent];
+    result.command = intent.command;
+    result.args.clear();
+
+    IntentGrammar::Slots arg_slots = match.slots;
+    if (intent.command == "lua_script") {
+        for (auto& slot : arg_slots) {
+            slot.second = escapeLuaLiteral(slot.second);
+        }
+    }
+    for (const std::string& arg : intent.args) {
+        result.args.push_back(IntentGrammar::expand(arg, arg_slots));
+    }
+    result.reply = IntentGrammar::expand(intent.reply, match.slots);
+    return true;
+}
+
+void IntentTable::addIntent(Intent intent, const std::vector<std::string>& patterns) {
+    const int index = static_cast<int>(intents_.size());
+    size_t added = 0;
+    for (const std::string& pattern : patterns) {
+        if (grammar_.addPattern(index, pattern)) {
+            ++added;
+        } else {
+            Logger::getInstance().warnf("[%s] Ignoring malformed pattern for %s: %s", TAG,
+                                        intent.command.c_str(), pattern.c_str());
+        }
+    }
+    if (added > 0) {
+        intents_.push_back(std::move(intent));
+    }
+}
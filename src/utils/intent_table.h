@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "utils/intent_grammar.h"
+
+/**
+ * @brief Intents and the grammar compiled from them
+ *
+ * The part of IntentMatcher that does not touch storage or CommandCenter.
+ * Intents are added in priority order (first matching pattern wins): user
+ * intents from /intents.json, the built-in Italian phrasings of registered
+ * commands, then every registered command by name.
+ */
+class IntentTable {
+public:
+    static constexpr size_t kMaxWords = 12;  // Longer utterances are conversation, not commands
+
+    struct Result {
+        std::string command;
+        std::vector<std::string> args;
+        std::string reply;             // Slots expanded; may still contain {result}
+    };
+
+    void clear();
+
+    /**
+     * @brief Add the intents of an /intents.json document
+     * @return false if the document does not parse
+     */
+    bool addUserIntents(const std::string& json);
+
+    /** Built-in phrasings of the commands in registered */
+    void addBuiltins(const std::vector<std::string>& registered);
+
+    /** Each command said by name, underscores as spaces ("system status") */
+    void addCommandNames(const std::vector<std::string>& registered);
+
+    /** Match a whole utterance; slots are expanded into args and reply */
+    bool match(const std::string& text, Result& result) const;
+
+    size_t intents() const { return intents_.size(); }
+    size_t patterns() const { return grammar_.size(); }
+
+private:
+    struct Intent {
+        std::string command;
+        std::vector<std::string> args;
+        std::string reply;
+    };
+
+    void addIntent(Intent intent, const std::vector<std::string>& patterns);
+
+    IntentGrammar grammar_;
+    std::vector<Intent> intents_;
+};
@@ -0,0 +1,449 @@
+#include "utils/json_path_extractor.h"
+
+#include <cctype>
+#include <cstdint>
+
+namespace {
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool isWhitespace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+bool isLiteralChar(char c) {
+    return isalnum(static_cast<unsigned char>(c)) || c == '+' || c == '-' || c == '.';
+}
+
+} // namespace
+
+constexpr size_t JsonPathExtractor::kMaxPaths;
+constexpr size_t JsonPathExtractor::kMaxDepth;
+constexpr size_t JsonPathExtractor::kMaxKeyBytes;
+constexpr int32_t JsonPathExtractor::kKeyStep;
+constexpr int32_t JsonPathExtractor::kAnyIndex;
+
+bool JsonPathExtractor::addPath(const char* path) {
+    if (!path || !*path || paths_.size() >= kMaxPaths) {
+        return false;
+    }
+
+    Path compiled;
+    const char* c = path;
+    while (*c) {
+        Step step;
+        if (*c == '[') {
+            ++c;
+            if (*c == '*') {
+                step.index = kAnyIndex;
+                ++c;
+            } else {
+                if (!isdigit(static_cast<unsigned char>(*c))) {
+                    return false;
+                }
+                int64_t index = 0;
+                while (isdigit(static_cast<unsigned char>(*c))) {
+                    index = index * 10 + (*c++ - '0');
+                    if (index > INT32_MAX) {
+                        return false;
+                    }
+                }
+                step.index = static_cast<int32_t>(index);
+            }
+            if (*c++ != ']') {
+                return false;
+            }
+        } else {
+            while (*c && *c != '.' && *c != '[') {
+                step.key.push_back(*c++);
+            }
+            if (step.key.empty()) {
+                return false;
+            }
+        }
+        compiled.steps.push_back(std::move(step));
+        if (*c == '.' && (!*++c || *c == '.' || *c == '[')) {
+            return false;  // "a.", "a..b", "a.[0]"
+        }
+    }
+
+    if (compiled.steps.size() > kMaxDepth) {
+        return false;
+    }
+    paths_.push_back(std::move(compiled));
+    return true;
+}
+
+void JsonPathExtractor::reset() {
+    state_ = State::Value;
+    frames_.clear();
+    targets_ = 0;
+    in_key_ = false;
+    key_overflow_ = false;
+    key_.clear();
+    std::string().swap(capture_);
+    literal_first_ = 0;
+    escape_ = false;
+    unicode_digits_ = 0;
+    unicode_value_ = 0;
+    high_surrogate_ = 0;
+    for (Path& path : paths_) {
+        path.type = Type::None;
+        std::string().swap(path.value);
+    }
+}
+
+const std::string& JsonPathExtractor::value(size_t path) const {
+    static const std::string kEmpty;
+    return path < paths_.size() ? paths_[path].value : kEmpty;
+}
+
+bool JsonPathExtractor::feed(const char* data, size_t length) {
+    if (state_ == State::Error) {
+        return false;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        if (state_ == State::String && !escape_ && unicode_digits_ == 0 && !high_surrogate_) {
+            // Plain run inside a string: copy (or skip) it in one go
+            size_t end = i;
+            while (end < length && data[end] != '"' && data[end] != '\\' &&
+                   static_cast<unsigned char>(data[end]) >= 0x20) {
+                ++end;
+            }
+            appendRun(data + i, end - i);
+            i = end;
+            if (i == length) {
+                break;
+            }
+        }
+        if (!step(data[i])) {
+            state_ = State::Error;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JsonPathExtractor::step(char c) {
+    if (state_ == State::String) {
+        return stringChar(c);
+    }
+    if (state_ == State::Literal) {
+        if (isLiteralChar(c)) {
+            if (targets_) {
+                capture_.push_back(c);
+            }
+            return true;
+        }
+        switch (literal_first_) {
+            case 't': endValue(Type::True); break;
+            case 'f': endValue(Type::False); break;
+            case 'n': endValue(Type::Null); break;
+            default: endValue(Type::Number); break;
+        }
+        // The delimiter belongs to the enclosing structure
+    }
+
+    if (isWhitespace(c)) {
+        return true;
+    }
+
+    switch (state_) {
+        case State::Value:
+            return startValue(c);
+        case State::ValueOrEnd:
+            return c == ']' ? closeContainer(true) : startValue(c);
+        case State::KeyOrEnd:
+            if (c == '}') {
+                return closeContainer(false);
+            }
+            // Fall through
+        case State::Key:
+            if (c != '"') {
+                return false;
+            }
+            in_key_ = true;
+            key_overflow_ = false;
+            key_.clear();
+            state_ = State::String;
+            return true;
+        case State::Colon:
+            if (c != ':') {
+                return false;
+            }
+            state_ = State::Value;
+            return true;
+        case State::AfterValue: {
+            Frame& frame = frames_.back();
+            if (c == ',') {
+                if (frame.array) {
+                    ++frame.index;
+                    state_ = State::Value;
+                } else {
+                    state_ = State::Key;
+                }
+                return true;
+            }
+            return c == (frame.array ? ']' : '}') && closeContainer(frame.array);
+        }
+        default:
+            return false;  // Trailing data after the document, or already failed
+    }
+}
+
+bool JsonPathExtractor::startValue(char c) {
+    const size_t depth = frames_.size();
+    uint32_t child = (uint32_t(1) << paths_.size()) - 1;
+    if (depth > 0) {
+        if (frames_.back().array) {
+            matchIndex();
+        }
+        child = frames_.back().child;
+    }
+
+    targets_ = 0;
+    uint32_t deeper = 0;
+    for (size_t p = 0; p < paths_.size(); ++p) {
+        const uint32_t bit = uint32_t(1) << p;
+        if (!(child & bit)) {
+            continue;
+        }
+        if (paths_[p].steps.size() == depth) {
+            targets_ |= bit;
+        } else if (paths_[p].steps.size() > depth) {
+            deeper |= bit;
+        }
+    }
+
+    capture_.clear();
+    switch (c) {
+        case '{':
+        case '[': {
+            if (depth >= kMaxDepth) {
+                return false;
+            }
+            const bool array = c == '[';
+            report(array ? Type::Array : Type::Object);
+            targets_ = 0;
+            Frame frame;
+            frame.array = array;
+            frame.mask = deeper;
+            frames_.push_back(frame);
+            state_ = array ? State::ValueOrEnd : State::KeyOrEnd;
+            return true;
+        }
+        case '"':
+            in_key_ = false;
+            state_ = State::String;
+            return true;
+        default:
+            if (c == '-' || isdigit(static_cast<unsigned char>(c)) || c == 't' || c == 'f' || c == 'n') {
+                literal_first_ = c;
+                if (targets_) {
+                    capture_.push_back(c);
+                }
+                state_ = State::Literal;
+                return true;
+            }
+            return false;
+    }
+}
+
+void JsonPathExtractor::endValue(Type type) {
+    report(type);
+    targets_ = 0;
+    state_ = frames_.empty() ? State::Done : State::AfterValue;
+}
+
+bool JsonPathExtractor::closeContainer(bool array) {
+    if (frames_.empty() || frames_.back().array != array) {
+        return false;
+    }
+    frames_.pop_back();
+    state_ = frames_.empty() ? State::Done : State::AfterValue;
+    return true;
+}
+
+void JsonPathExtractor::matchKey() {
+    Frame& frame = frames_.back();
+    const size_t depth = frames_.size() - 1;
+    frame.child = 0;
+    if (key_overflow_) {
+        return;
+    }
+    for (size_t p = 0; p < paths_.size(); ++p) {
+        const uint32_t bit = uint32_t(1) << p;
+        if ((frame.mask & bit) && paths_[p].steps[depth].index == kKeyStep && paths_[p].steps[depth].key == key_) {
+            frame.child |= bit;
+        }
+    }
+}
+
+void JsonPathExtractor::matchIndex() {
+    Frame& frame = frames_.back();
+    const size_t depth = frames_.size() - 1;
+    frame.child = 0;
+    for (size_t p = 0; p < paths_.size(); ++p) {
+        const uint32_t bit = uint32_t(1) << p;
+        if (!(frame.mask & bit)) {
+            continue;
+        }
+        const int32_t index = paths_[p].steps[depth].index;
+        if (index == kAnyIndex || (index >= 0 && static_cast<uint32_t>(index) == frame.index)) {
+            frame.child |= bit;
+        }
+    }
+}
+
+bool JsonPathExtractor::stringChar(char c) {
+    if (unicode_digits_ > 0) {
+        const int digit = hexValue(c);
+        if (digit < 0) {
+            return false;
+        }
+        unicode_value_ = (unicode_value_ << 4) | static_cast<uint32_t>(digit);
+        if (--unicode_digits_ == 0) {
+            appendCodepoint(unicode_value_);
+        }
+        return true;
+    }
+
+    if (escape_) {
+        escape_ = false;
+        switch (c) {
+            case '"':
+            case '\\':
+            case '/': appendDecoded(c); return true;
+            case 'b': appendDecoded('\b'); return true;
+            case 'f': appendDecoded('\f'); return true;
+            case 'n': appendDecoded('\n'); return true;
+            case 'r': appendDecoded('\r'); return true;
+            case 't': appendDecoded('\t'); return true;
+            case 'u':
+                unicode_digits_ = 4;
+                unicode_value_ = 0;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    if (c == '\\') {
+        escape_ = true;
+        return true;
+    }
+    if (c == '"') {
+        if (high_surrogate_) {
+            high_surrogate_ = 0;
+            appendCodepoint(0xFFFD);  // Unpaired high surrogate
+        }
+        if (in_key_) {
+            in_key_ = false;
+            matchKey();
+            state_ = State::Colon;
+        } else {
+            endValue(Type::String);
+        }
+        return true;
+    }
+    if (static_cast<unsigned char>(c) < 0x20) {
+        return false;  // Raw control characters are not allowed in strings
+    }
+    appendDecoded(c);
+    return true;
+}
+
+void JsonPathExtractor::appendDecoded(char c) {
+    if (high_surrogate_) {
+        high_surrogate_ = 0;
+        appendCodepoint(0xFFFD);
+    }
+    if (in_key_) {
+        if (key_.size() < kMaxKeyBytes) {
+            key_.push_back(c);
+        } else {
+            key_overflow_ = true;
+        }
+    } else if (targets_) {
+        capture_.push_back(c);
+    }
+}
+
+void JsonPathExtractor::appendRun(const char* text, size_t length) {
+    if (in_key_) {
+        const size_t room = kMaxKeyBytes - key_.size();
+        key_.append(text, length < room ? length : room);
+        key_overflow_ |= length > room;
+    } else if (targets_) {
+        capture_.append(text, length);
+    }
+}
+
+void JsonPathExtractor::appendCodepoint(uint32_t codepoint) {
+    if (codepoint >= 0xDC00 && codepoint <= 0xDFFF && high_surrogate_) {
+        codepoint = 0x10000 + ((high_surrogate_ - 0xD800) << 10) + (codepoint - 0xDC00);
+        high_surrogate_ = 0;
+    } else {
+        if (high_surrogate_) {
+            high_surrogate_ = 0;
+            appendCodepoint(0xFFFD);
+        }
+        if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+            high_surrogate_ = codepoint;  // Wait for the low half
+            return;
+        }
+        if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+            codepoint = 0xFFFD;
+        }
+    }
+
+    char bytes[4];
+    size_t length = 0;
+    if (codepoint < 0x80) {
+        bytes[length++] = static_cast<char>(codepoint);
+    } else if (codepoint < 0x800) {
+        bytes[length++] = static_cast<char>(0xC0 | (codepoint >> 6));
+        bytes[length++] = static_cast<char>(0x80 | (codepoint & 0x3F));
+    } else if (codepoint < 0x10000) {
+        bytes[length++] = static_cast<char>(0xE0 | (codepoint >> 12));
+        bytes[length++] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        bytes[length++] = static_cast<char>(0x80 | (codepoint & 0x3F));
+    } else {
+        bytes[length++] = static_cast<char>(0xF0 | (codepoint >> 18));
+        bytes[length++] = static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+        bytes[length++] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        bytes[length++] = static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+    for (size_t i = 0; i < length; ++i) {
+        appendDecoded(bytes[i]);
+    }
+}
+
+void JsonPathExtractor::report(Type type) {
+    if (!targets_) {
+        return;
+    }
+    const bool single = (targets_ & (targets_ - 1)) == 0;
+    for (size_t p = 0; p < paths_.size(); ++p) {
+        if (!(targets_ & (uint32_t(1) << p))) {
+            continue;
+        }
+        if (callback_) {
+            callback_(p, type, capture_);
+        }
+        Path& path = paths_[p];
+        if (path.type == Type::None) {
+            path.type = type;
+            if (single && !callback_) {
+                path.value.swap(capture_);  // Only one path wants it: no copy
+            } else {
+                path.value = capture_;
+            }
+        }
+    }
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Incremental JSON pull parser that extracts a few paths
+ *
+ * Fed the response body in arbitrary slices straight from the HTTP reads, it
+ * tracks only the container stack and the current key. String escapes are
+ * decoded for values at a registered path only, into one capture buffer; every
+ * other value is skipped as it streams past, so no tree and no copy of the body
+ * is ever built.
+ *
+ * Path syntax: dot-separated keys plus [n] or [*] array steps, e.g.
+ * "choices[0].message.content", "models[*].name", "error". The first match of
+ * each path is kept (value(), type()); the callback, if set, sees every match
+ * (all elements of a [*] step). Objects and arrays can be matched to test for
+ * their presence, their value is left empty. Numbers and literals are reported
+ * as their source text.
+ *
+ * Validation is structural (brackets, commas, colons, string escapes); literal
+ * tokens are only checked loosely.
+ */
+class JsonPathExtractor {
+public:
+    enum class Type : uint8_t { None, String, Number, True, False, Null, Object, Array };
+
+    static constexpr size_t kMaxPaths = 16;
+    static constexpr size_t kMaxDepth = 32;
+    static constexpr size_t kMaxKeyBytes = 64;   // Longer keys never match a path
+
+    using OnValue = std::function<void(size_t path, Type type, const std::string& value)>;
+
+    /** Register a path; its index is the registration order. False if malformed or full */
+    bool addPath(const char* path);
+    void setCallback(OnValue callback) { callback_ = std::move(callback); }
+
+    /** Clear the parse state and the captured values, keep the paths */
+    void reset();
+
+    /** Consume a slice of the document; false once it is not valid JSON */
+    bool feed(const char* data, size_t length);
+
+    /** True if exactly one complete JSON value was read */
+    bool finish() const { return state_ == State::Done; }
+
+    bool failed() const { return state_ == State::Error; }
+    bool found(size_t path) const { return type(path) != Type::None; }
+    Type type(size_t path) const { return path < paths_.size() ? paths_[path].type : Type::None; }
+    const std::string& value(size_t path) const;
+
+private:
+    enum class State : uint8_t {
+        Value,          // Expecting a value
+        ValueOrEnd,     // After '[': a value or ']'
+        KeyOrEnd,       // After '{': a key or '}'
+        Key,            // After ',' in an object
+        Colon,
+        AfterValue,     // ',' or the closing bracket
+        String,
+        Literal,
+        Done,
+        Error,
+    };
+
+    struct Step {
+        std::string key;
+        int32_t index = kKeyStep;   // >= 0 array index, kAnyIndex for [*]
+    };
+
+    struct Path {
+        std::vector<Step> steps;
+        Type type = Type::None;     // First match
+        std::string value;
+    };
+
+    struct Frame {
+        bool array = false;
+        uint32_t index = 0;         // Current element (arrays)
+        uint32_t mask = 0;          // Paths that can still match below this container
+        uint32_t child = 0;         // Paths matching the current member
+    };
+
+    static constexpr int32_t kKeyStep = -1;
+    static constexpr int32_t kAnyIndex = -2;
+
+    bool step(char c);
+    bool startValue(char c);
+    void endValue(Type type);
+    bool closeContainer(bool array);
+    void matchKey();
+    void matchIndex();
+    bool stringChar(char c);
+    void appendCodepoint(uint32_t codepoint);
+    void appendDecoded(char c);
+    void appendRun(const char* text, size_t length);
+    void report(Type type);
+
+    std::vector<Path> paths_;
+    OnValue callback_;
+
+    State state_ = State::Value;
+    std::vector<Frame> frames_;
+    uint32_t targets_ = 0;          // Paths ending at the value being read
+    bool in_key_ = false;           // String being read is an object key
+    bool key_overflow_ = false;
+    std::string key_;
+    std::string capture_;
+    char literal_first_ = 0;
+
+    // String escape decoding
+    bool escape_ = false;
+    uint8_t unicode_digits_ = 0;
+    uint32_t unicode_value_ = 0;
+    uint32_t high_surrogate_ = 0;
+};
@@ -0,0 +1,213 @@
+#include "utils/json_writer.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+constexpr size_t JsonWriter::kMaxDepth;
+constexpr size_t JsonWriter::kStagingBytes;
+
+JsonWriter::JsonWriter(Sink sink) : sink_(std::move(sink)) {
+    if (sink_) {
+        staging_.reset(new (std::nothrow) char[kStagingBytes]);
+    }
+}
+
+JsonWriter::Sink JsonWriter::appendTo(std::string& out) {
+    return [&out](const char* data, size_t length) {
+        out.append(data, length);
+        return true;
+    };
+}
+
+void JsonWriter::separator() {
+    if (after_key_) {
+        after_key_ = false;  // The key already placed the separator
+        return;
+    }
+    const uint64_t bit = uint64_t(1) << depth_;
+    if (has_items_ & bit) {
+        raw(',');
+    }
+    has_items_ |= bit;
+}
+
+void JsonWriter::push() {
+    if (depth_ >= kMaxDepth) {
+        ok_ = false;
+        return;
+    }
+    ++depth_;
+    has_items_ &= ~(uint64_t(1) << depth_);
+}
+
+void JsonWriter::pop() {
+    if (depth_ > 0) {
+        --depth_;
+    }
+    after_key_ = false;
+}
+
+JsonWriter& JsonWriter::beginObject() {
+    separator();
+    raw('{');
+    push();
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+    raw('}');
+    pop();
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray() {
+    separator();
+    raw('[');
+    push();
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+    raw(']');
+    pop();
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(const char* name) {
+    separator();
+    raw('"');
+    escaped(name, strlen(name));
+    raw("\":", 2);
+    after_key_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const char* text) {
+    return text ? value(text, strlen(text)) : null();
+}
+
+JsonWriter& JsonWriter::value(const char* text, size_t length) {
+    beginString();
+    escaped(text, length);
+    return endString();
+}
+
+JsonWriter& JsonWriter::value(bool flag) {
+    separator();
+    if (flag) {
+        raw("true", 4);
+    } else {
+        raw("false", 5);
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(double number) {
+    if (!std::isfinite(number)) {
+        return null();  // JSON has no NaN/Infinity (cJSON prints null too)
+    }
+    separator();
+    char buffer[32];
+    // Shortest form that round-trips, like cJSON
+    int length = snprintf(buffer, sizeof(buffer), "%.15g", number);
+    if (strtod(buffer, nullptr) != number) {
+        length = snprintf(buffer, sizeof(buffer), "%.17g", number);
+    }
+    raw(buffer, static_cast<size_t>(length));
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(int64_t number) {
+    separator();
+    char buffer[24];
+    const int length = snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(number));
+    raw(buffer, static_cast<size_t>(length));
+    return *this;
+}
+
+JsonWriter& JsonWriter::null() {
+    separator();
+    raw("null", 4);
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginString() {
+    separator();
+    raw('"');
+    return *this;
+}
+
+JsonWriter& JsonWriter::stringPart(const char* text, size_t length) {
+    escaped(text, length);
+    return *this;
+}
+
+JsonWriter& JsonWriter::endString() {
+    raw('"');
+    return *this;
+}
+
+void JsonWriter::escaped(const char* text, size_t length) {
+    static const char kHex[] = "0123456789abcdef";
+    size_t run = 0;  // Start of the current run of bytes that need no escaping
+    for (size_t i = 0; i < length; ++i) {
+        const unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        raw(text + run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"':  raw("\\\"", 2); break;
+            case '\\': raw("\\\\", 2); break;
+            case '\n': raw("\\n", 2); break;
+            case '\r': raw("\\r", 2); break;
+            case '\t': raw("\\t", 2); break;
+            case '\b': raw("\\b", 2); break;
+            case '\f': raw("\\f", 2); break;
+            default: {
+                const char unicode[6] = {'\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0x0F]};
+                raw(unicode, sizeof(unicode));
+                break;
+            }
+        }
+    }
+    raw(text + run, length - run);
+}
+
+void JsonWriter::raw(char c) {
+    raw(&c, 1);
+}
+
+void JsonWriter::raw(const char* data, size_t length) {
+    size_ += length;
+    if (!sink_ || !ok_) {
+        return;  // Counting only, or the sink already failed
+    }
+    if (!staging_ || staged_ + length > kStagingBytes) {
+        flushStaging();
+        if (!staging_ || length >= kStagingBytes) {
+            ok_ = ok_ && sink_(data, length);  // Large runs bypass the staging buffer
+            return;
+        }
+    }
+    memcpy(staging_.get() + staged_, data, length);
+    staged_ += length;
+}
+
+void JsonWriter::flushStaging() {
+    if (staged_ > 0 && ok_) {
+        ok_ = sink_(staging_.get(), staged_);
+    }
+    staged_ = 0;
+}
+
+bool JsonWriter::finish() {
+    if (sink_) {
+        flushStaging();
+    }
+    return ok_;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+/**
+ * @brief Forward-only JSON writer that escapes straight into a sink
+ *
+ * Used for request bodies built from large strings (system prompt, history)
+ * where a cJSON tree plus its printed copy would hold the text three times.
+ * Output goes through a small staging buffer to the sink (e.g. the HTTP
+ * connection), so no body-sized buffer is needed. Without a sink the writer
+ * only counts, which gives the exact Content-Length (or reserve size) for a
+ * second pass that writes the same calls:
+ *
+ *   JsonWriter counter;           writeBody(counter);
+ *   JsonWriter out(sink);         writeBody(out); out.finish();
+ *
+ * Commas and nesting are handled by the writer; structural misuse (a value
+ * without a key inside an object, unbalanced end*()) is the caller's bug and
+ * is not checked. Strings are passed through as UTF-8; only '"', '\\' and
+ * control characters are escaped.
+ */
+class JsonWriter {
+public:
+    /** Receives output in pieces; returns false to abort (e.g. socket error) */
+    using Sink = std::function<bool(const char* data, size_t length)>;
+
+    static constexpr size_t kMaxDepth = 32;
+    static constexpr size_t kStagingBytes = 512;
+
+    JsonWriter() = default;
+    explicit JsonWriter(Sink sink);
+
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+    JsonWriter& key(const char* name);
+
+    JsonWriter& value(const char* text);
+    JsonWriter& value(const char* text, size_t length);
+    JsonWriter& value(const std::string& text) { return value(text.data(), text.size()); }
+    JsonWriter& value(bool flag);
+    JsonWriter& value(double number);
+    JsonWriter& value(int number) { return value(static_cast<int64_t>(number)); }
+    JsonWriter& value(int64_t number);
+    JsonWriter& null();
+
+    /** A string value written in several parts (avoids concatenating them first) */
+    JsonWriter& beginString();
+    JsonWriter& stringPart(const char* text, size_t length);
+    JsonWriter& stringPart(const std::string& text) { return stringPart(text.data(), text.size()); }
+    JsonWriter& endString();
+
+    /** Push the staged bytes to the sink; false if the sink failed at any point */
+    bool finish();
+
+    /** Bytes produced so far (including staged ones) */
+    size_t size() const { return size_; }
+    bool ok() const { return ok_; }
+
+    /** Convenience sink that appends to a string */
+    static Sink appendTo(std::string& out);
+
+private:
+    void separator();
+    void push();
+    void pop();
+    void raw(const char* data, size_t length);
+    void raw(char c);
+    void escaped(const char* text, size_t length);
+    void flushStaging();
+
+    Sink sink_;
+    std::unique_ptr<char[]> staging_;  // Heap, only with a sink: callers run on small task stacks
+    size_t staged_ = 0;
+    size_t size_ = 0;
+    bool ok_ = true;
+    size_t depth_ = 0;
+    uint64_t has_items_ = 0;    // Bit per depth: a value was written at this level
+    bool after_key_ = false;
+};
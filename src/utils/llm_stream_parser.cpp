@@ -0,0 +1,351 @@
+#include "utils/llm_stream_parser.h"
+
+#include <cstring>
+
+namespace {
+
+// Replies are a few KB; anything bigger than this is not a chat completion
+constexpr size_t kMaxRawBytes = 64 * 1024;
+
+bool startsWith(const std::string& value, const char* prefix) {
+    return value.compare(0, strlen(prefix), prefix) == 0;
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Payload fields, in JsonPathExtractor registration order
+enum Field : size_t {
+    kError,
+    kErrorMessage,
+    kChoice,
+    kDelta,
+    kMessage,
+    kFinishReason,
+    kOllamaMessage,
+    kOllamaResponse,
+    kOllamaDone,
+};
+
+constexpr const char* kFieldPaths[] = {
+    "error",
+    "error.message",
+    "choices[0]",
+    "choices[0].delta.content",
+    "choices[0].message.content",
+    "choices[0].finish_reason",
+    "message.content",
+    "response",
+    "done",
+};
+
+} // namespace
+
+LlmStreamParser::LlmStreamParser() {
+    for (const char* path : kFieldPaths) {
+        payload_.addPath(path);
+    }
+    reset();
+}
+
+void LlmStreamParser::reset() {
+    line_.clear();
+    raw_.clear();
+    content_.clear();
+    text_.clear();
+    error_.clear();
+    delta_count_ = 0;
+    done_ = false;
+
+    content_is_object_ = false;
+    content_started_ = false;
+    command_begin_ = std::string::npos;
+    command_end_ = std::string::npos;
+    depth_ = 0;
+    in_string_ = false;
+    escape_ = false;
+    unicode_digits_ = 0;
+    unicode_value_ = 0;
+    high_surrogate_ = 0;
+    expect_key_ = false;
+    key_.clear();
+    text_state_ = TextState::Idle;
+}
+
+bool LlmStreamParser::feed(const char* data, size_t length) {
+    if (!data || length == 0) {
+        return false;
+    }
+    if (delta_count_ == 0 && raw_.size() + length <= kMaxRawBytes) {
+        raw_.append(data, length);
+    }
+
+    bool changed = false;
+    while (length > 0) {
+        const char* newline = static_cast<const char*>(memchr(data, '\n', length));
+        if (!newline) {
+            line_.append(data, length);
+            break;
+        }
+        const size_t take = static_cast<size_t>(newline - data);
+        line_.append(data, take);
+        changed |= handleLine();
+        line_.clear();
+        data += take + 1;
+        length -= take + 1;
+    }
+    return changed;
+}
+
+bool LlmStreamParser::finish() {
+    bool changed = false;
+    if (!line_.empty()) {
+        changed = handleLine();
+        line_.clear();
+    }
+    if (delta_count_ == 0 && !raw_.empty()) {
+        // Not a stream: the server answered with one (possibly pretty-printed) completion
+        changed |= handlePayload(raw_.data(), raw_.size());
+    }
+    raw_.clear();
+    raw_.shrink_to_fit();
+    if (delta_count_ > 0) {
+        done_ = true;
+    }
+    return changed;
+}
+
+std::string LlmStreamParser::commandJson() const {
+    if (!commandReady()) {
+        return std::string();
+    }
+    return content_.substr(command_begin_, command_end_ - command_begin_);
+}
+
+bool LlmStreamParser::handleLine() {
+    if (!line_.empty() && line_.back() == '\r') {
+        line_.pop_back();
+    }
+    if (line_.empty()) {
+        return false;
+    }
+
+    if (startsWith(line_, "data:")) {
+        size_t offset = 5;
+        if (offset < line_.size() && line_[offset] == ' ') {
+            ++offset;
+        }
+        if (line_.compare(offset, std::string::npos, "[DONE]") == 0) {
+            done_ = true;
+            return false;
+        }
+        return handlePayload(line_.data() + offset, line_.size() - offset);
+    }
+    if (line_[0] == '{') {
+        return handlePayload(line_.data(), line_.size());  // NDJSON
+    }
+    return false;  // SSE comments, event:, id:, retry:
+}
+
+bool LlmStreamParser::handlePayload(const char* json, size_t length) {
+    payload_.reset();
+    if (!payload_.feed(json, length) || !payload_.finish()) {
+        return false;
+    }
+
+    bool changed = false;
+    const JsonPathExtractor::Type error = payload_.type(kError);
+    if (error != JsonPathExtractor::Type::None && error != JsonPathExtractor::Type::Null) {
+        if (error == JsonPathExtractor::Type::String) {
+            error_ = payload_.value(kError);
+        } else if (payload_.type(kErrorMessage) == JsonPathExtractor::Type::String) {
+            error_ = payload_.value(kErrorMessage);
+        } else {
+            error_ = "unknown error";
+        }
+        done_ = true;
+    }
+
+    auto append = [&](Field field) {
+        if (payload_.type(field) != JsonPathExtractor::Type::String) {
+            return false;
+        }
+        changed |= appendContent(payload_.value(field).data(), payload_.value(field).size());
+        return true;
+    };
+
+    // OpenAI: choices[0].delta.content (streamed) or choices[0].message.content (single reply)
+    if (payload_.found(kChoice)) {
+        if (!append(kDelta)) {
+            append(kMessage);
+        }
+        if (payload_.type(kFinishReason) == JsonPathExtractor::Type::String) {
+            done_ = true;
+        }
+    } else {
+        // Ollama native: message.content (/api/chat) or response (/api/generate)
+        if (!append(kOllamaMessage)) {
+            append(kOllamaResponse);
+        }
+        if (payload_.type(kOllamaDone) == JsonPathExtractor::Type::True) {
+            done_ = true;
+        }
+    }
+    return changed;
+}
+
+bool LlmStreamParser::appendContent(const char* text, size_t length) {
+    if (length == 0) {
+        return false;
+    }
+    if (delta_count_++ == 0) {
+        raw_.clear();
+        raw_.shrink_to_fit();
+    }
+
+    const bool was_object = content_is_object_;
+    const size_t previous_size = displayText().size();
+    for (size_t i = 0; i < length; ++i) {
+        content_.push_back(text[i]);
+        scanContent(text[i]);
+    }
+    return was_object != content_is_object_ || displayText().size() != previous_size;
+}
+
+void LlmStreamParser::scanContent(char c) {
+    const size_t position = content_.size() - 1;
+
+    if (!content_started_) {
+        if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+            return;
+        }
+        if (c == '{') {
+            content_started_ = true;
+            content_is_object_ = true;
+            command_begin_ = position;
+            depth_ = 1;
+            expect_key_ = true;
+            return;
+        }
+        // ```json fences: keep waiting for the object; anything else is plain prose
+        const size_t first = content_.find_first_not_of(" \n\r\t");
+        if (content_[first] != '`') {
+            content_started_ = true;
+        }
+        return;
+    }
+    if (!content_is_object_ || commandReady()) {
+        return;
+    }
+
+    if (in_string_) {
+        std::string* target = text_state_ == TextState::Key ? &key_
+                            : text_state_ == TextState::Capture ? &text_ : nullptr;
+        if (unicode_digits_ > 0) {
+            const int digit = hexValue(c);
+            unicode_value_ = (unicode_value_ << 4) | static_cast<uint32_t>(digit < 0 ? 0 : digit);
+            if (--unicode_digits_ == 0 && target == &text_) {
+                appendCodepoint(unicode_value_);
+            }
+            return;
+        }
+        if (escape_) {
+            escape_ = false;
+            if (c == 'u') {
+                unicode_digits_ = 4;
+                unicode_value_ = 0;
+                return;
+            }
+            if (target) {
+                switch (c) {
+                    case 'n': target->push_back('\n'); break;
+                    case 't': target->push_back('\t'); break;
+                    case 'r': target->push_back('\r'); break;
+                    case 'b': target->push_back('\b'); break;
+                    case 'f': target->push_back('\f'); break;
+                    default: target->push_back(c); break;  // \" \\ \/
+                }
+            }
+            return;
+        }
+        if (c == '\\') {
+            escape_ = true;
+        } else if (c == '"') {
+            in_string_ = false;
+            if (text_state_ == TextState::Key) {
+                expect_key_ = false;
+            }
+            text_state_ = TextState::Idle;
+        } else if (target) {
+            target->push_back(c);
+        }
+        return;
+    }
+
+    switch (c) {
+        case '"':
+            in_string_ = true;
+            high_surrogate_ = 0;
+            if (depth_ == 1 && expect_key_) {
+                text_state_ = TextState::Key;
+                key_.clear();
+            } else if (depth_ == 1 && key_ == "text") {
+                text_state_ = TextState::Capture;
+                text_.clear();
+            } else {
+                text_state_ = TextState::Skip;
+            }
+            break;
+        case '{':
+        case '[':
+            ++depth_;
+            break;
+        case '}':
+        case ']':
+            if (--depth_ == 0) {
+                command_end_ = position + 1;
+            }
+            break;
+        case ',':
+            if (depth_ == 1) {
+                expect_key_ = true;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void LlmStreamParser::appendCodepoint(uint32_t codepoint) {
+    if (codepoint >= 0xD800 && codepoint < 0xDC00) {
+        high_surrogate_ = codepoint;
+        return;
+    }
+    if (codepoint >= 0xDC00 && codepoint < 0xE000) {
+        if (!high_surrogate_) {
+            return;
+        }
+        codepoint = 0x10000 + ((high_surrogate_ - 0xD800) << 10) + (codepoint - 0xDC00);
+    }
+    high_surrogate_ = 0;
+
+    if (codepoint < 0x80) {
+        text_.push_back(static_cast<char>(codepoint));
+    } else if (codepoint < 0x800) {
+        text_.push_back(static_cast<char>(0xC0 | (codepoint >> 6)));
+        text_.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    } else if (codepoint < 0x10000) {
+        text_.push_back(static_cast<char>(0xE0 | (codepoint >> 12)));
+        text_.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+        text_.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    } else {
+        text_.push_back(static_cast<char>(0xF0 | (codepoint >> 18)));
+        text_.push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F)));
+        text_.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+        text_.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    }
+}
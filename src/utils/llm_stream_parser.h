@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "utils/json_path_extractor.h"
+
+/**
+ * @brief Incremental parser for streamed chat completions
+ *
+ * Accepts the raw HTTP body in arbitrary slices and understands both wire formats:
+ * - OpenAI-style Server-Sent Events: "data: {...choices[0].delta.content...}" ... "data: [DONE]"
+ * - Ollama-style NDJSON: one {"message":{"content":...},"done":false} object per line
+ *
+ * Content deltas are appended to content(). The assistant replies with a command
+ * object ({"command":..., "args":[...], "text":"..."}), so the content is also
+ * scanned as it grows:
+ * - displayText() is the decoded value of the top-level "text" field so far (or
+ *   the raw content when the model answered with plain prose)
+ * - commandReady() turns true as soon as the outermost object is closed, and
+ *   commandJson() then holds exactly that object (code fences and trailing
+ *   tokens excluded), ready for parseGPTCommand()
+ *
+ * Servers that ignore "stream": true and send a single completion object are
+ * handled by finish().
+ */
+class LlmStreamParser {
+public:
+    LlmStreamParser();
+
+    void reset();
+
+    /**
+     * @brief Consume a slice of the response body
+     * @return true if displayText() changed
+     */
+    bool feed(const char* data, size_t length);
+
+    /**
+     * @brief Flush the last unterminated line at end of body
+     * @return true if displayText() changed
+     */
+    bool finish();
+
+    /** Stream signalled completion ([DONE], "done": true or a finish_reason) */
+    bool done() const { return done_; }
+
+    /** Outermost command object in the content is complete */
+    bool commandReady() const { return command_end_ != std::string::npos; }
+
+    /** Complete command object, empty until commandReady() */
+    std::string commandJson() const;
+
+    const std::string& content() const { return content_; }
+    const std::string& displayText() const { return content_is_object_ ? text_ : content_; }
+
+    /** Error message reported by the server inside the stream, if any */
+    const std::string& error() const { return error_; }
+
+    /** Number of content deltas received so far */
+    uint32_t deltaCount() const { return delta_count_; }
+
+private:
+    enum class TextState : uint8_t { Idle, Key, Capture, Skip };
+
+    bool handleLine();
+    bool handlePayload(const char* json, size_t length);
+    bool appendContent(const char* text, size_t length);
+    void scanContent(char c);
+    void appendCodepoint(uint32_t codepoint);
+
+    std::string line_;
+    std::string raw_;         // Body kept until the first delta, for non-streamed replies
+    std::string content_;
+    std::string text_;
+    std::string error_;
+    JsonPathExtractor payload_;   // Fields of one event/line, no tree per delta
+    uint32_t delta_count_ = 0;
+    bool done_ = false;
+
+    // Content scanner (JSON structure of the command object)
+    bool content_is_object_ = false;
+    bool content_started_ = false;
+    size_t command_begin_ = std::string::npos;
+    size_t command_end_ = std::string::npos;
+    int depth_ = 0;
+    bool in_string_ = false;
+    bool escape_ = false;
+    uint8_t unicode_digits_ = 0;   // Remaining hex digits of a \uXXXX escape
+    uint32_t unicode_value_ = 0;
+    uint32_t high_surrogate_ = 0;
+    bool expect_key_ = false;
+    std::string key_;
+    TextState text_state_ = TextState::Idle;
+};
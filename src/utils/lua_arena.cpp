@@ -0,0 +1,268 @@
+#include "utils/lua_arena.h"
+
+#include <esp_heap_caps.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+constexpr size_t kClassBytes[] = {16, 32, 48, 64, 80, 96, 128, 160, 192, 256, 320, 384, 512};
+
+// Size class by 16-byte granule: kClassIndex[(bytes + 15) / 16]
+constexpr uint8_t kClassIndex[] = {
+    0, 0, 1, 2, 3, 4, 5, 6, 6, 7, 7, 8, 8,
+    9, 9, 9, 9, 10, 10, 10, 10, 11, 11, 11, 11,
+    12, 12, 12, 12, 12, 12, 12, 12,
+};
+
+static_assert(sizeof(kClassIndex) == LuaArena::kMaxSmallBytes / 16 + 1, "one entry per granule");
+
+void* heapAlloc(size_t bytes) {
+    void* ptr = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!ptr) {
+        ptr = heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    return ptr;
+}
+
+size_t alignUp(size_t bytes, size_t align) {
+    return (bytes + align - 1) & ~(align - 1);
+}
+} // namespace
+
+constexpr size_t LuaArena::kPageBytes;
+constexpr size_t LuaArena::kMaxSmallBytes;
+constexpr size_t LuaArena::kDefaultLimit;
+constexpr size_t LuaArena::kClassCount;
+constexpr size_t LuaArena::kAlign;
+
+static_assert(sizeof(kClassBytes) / sizeof(kClassBytes[0]) == 13, "kClassCount mismatch");
+
+LuaArena::LuaArena(size_t limit) : limit_(limit) {}
+
+LuaArena::~LuaArena() {
+    drop();
+}
+
+void* LuaArena::alloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+    return static_cast<LuaArena*>(ud)->reallocate(ptr, osize, nsize);
+}
+
+void LuaArena::drop() {
+    while (pages_) {
+        Page* next = pages_->next;
+        heap_caps_free(pages_);
+        pages_ = next;
+    }
+    while (large_) {
+        LargeBlock* next = large_->next;
+        heap_caps_free(large_);
+        large_ = next;
+    }
+    std::fill(free_, free_ + kClassCount, nullptr);
+    kept_large_ = 0;
+    bump_ = nullptr;
+    bump_end_ = nullptr;
+    stats_ = Stats();
+}
+
+uint32_t LuaArena::fragmentation() const {
+    if (stats_.footprint == 0) {
+        return 0;
+    }
+    const size_t live = std::min(stats_.current, stats_.footprint);
+    return static_cast<uint32_t>((stats_.footprint - live) * 100 / stats_.footprint);
+}
+
+int LuaArena::classFor(size_t bytes) {
+    return bytes <= kMaxSmallBytes ? kClassIndex[(bytes + 15) / 16] : -1;
+}
+
+size_t LuaArena::largeHeaderBytes() {
+    return alignUp(sizeof(LargeBlock), kAlign);
+}
+
+int LuaArena::classOf(const void* ptr, size_t osize) const {
+    const int size_class = classFor(osize);
+    if (size_class < 0 || kept_large_ == 0 || inPages(ptr)) {
+        return size_class;
+    }
+    return -1;
+}
+
+bool LuaArena::inPages(const void* ptr) const {
+    const uint8_t* byte = static_cast<const uint8_t*>(ptr);
+    for (const Page* page = pages_; page; page = page->next) {
+        const uint8_t* start = reinterpret_cast<const uint8_t*>(page);
+        if (byte >= start && byte < start + kPageBytes) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void* LuaArena::reallocate(void* ptr, size_t osize, size_t nsize) {
+    if (!ptr) {
+        osize = 0;  // Lua passes the object type here
+    }
+
+    if (nsize == 0) {
+        if (ptr) {
+            const int size_class = classOf(ptr, osize);
+            if (size_class >= 0) {
+                releaseSmall(ptr, size_class);
+            } else {
+                if (classFor(osize) >= 0) {
+                    --kept_large_;
+                }
+                releaseLarge(ptr);
+            }
+            stats_.current -= osize;
+        }
+        return nullptr;
+    }
+
+    if (nsize > osize && stats_.current + (nsize - osize) > limit_) {
+        ++stats_.failures;
+        return nullptr;
+    }
+
+    const int new_class = classFor(nsize);
+    const int old_class = ptr ? classOf(ptr, osize) : 0;
+    const bool was_kept = ptr && old_class < 0 && classFor(osize) >= 0;
+    void* result = nullptr;
+    if (ptr && new_class >= 0 && new_class == old_class) {
+        result = ptr;
+    } else if (ptr && new_class < 0 && old_class < 0) {
+        result = resizeLarge(ptr, nsize);
+    }
+
+    if (!result) {
+        result = new_class >= 0 ? allocateSmall(new_class) : allocateLarge(nsize);
+        if (result && ptr) {
+            memcpy(result, ptr, std::min(osize, nsize));
+            if (old_class >= 0) {
+                releaseSmall(ptr, old_class);
+            } else {
+                releaseLarge(ptr);
+            }
+        } else if (!result) {
+            if (!ptr || nsize > osize) {
+                ++stats_.failures;
+                return nullptr;
+            }
+            // Lua assumes shrinking never fails: keep the larger block. A large
+            // block stays large; classOf() finds it by address from now on.
+            result = ptr;
+        }
+    }
+
+    const bool kept = result == ptr && old_class < 0 && new_class >= 0;
+    if (kept != was_kept) {
+        kept ? ++kept_large_ : --kept_large_;
+    }
+
+    if (!ptr) {
+        ++stats_.allocations;
+    }
+    stats_.current = stats_.current + nsize - osize;
+    stats_.peak = std::max(stats_.peak, stats_.current);
+    return result;
+}
+
+void* LuaArena::allocateSmall(int size_class) {
+    const size_t bytes = kClassBytes[size_class];
+    if (FreeBlock* block = free_[size_class]) {
+        free_[size_class] = block->next;
+        stats_.free_listed -= bytes;
+        return block;
+    }
+
+    if (static_cast<size_t>(bump_end_ - bump_) < bytes && !addPage()) {
+        return nullptr;
+    }
+    void* block = bump_;
+    bump_ += bytes;
+    return block;
+}
+
+void LuaArena::releaseSmall(void* ptr, int size_class) {
+    FreeBlock* block = static_cast<FreeBlock*>(ptr);
+    block->next = free_[size_class];
+    free_[size_class] = block;
+    stats_.free_listed += kClassBytes[size_class];
+}
+
+bool LuaArena::addPage() {
+    Page* page = static_cast<Page*>(heapAlloc(kPageBytes));
+    if (!page) {
+        return false;
+    }
+
+    // Hand the tail of the current page to the free lists (sizes are all multiples of 16)
+    while (bump_ && static_cast<size_t>(bump_end_ - bump_) >= kClassBytes[0]) {
+        int size_class = static_cast<int>(kClassCount) - 1;
+        while (kClassBytes[size_class] > static_cast<size_t>(bump_end_ - bump_)) {
+            --size_class;
+        }
+        releaseSmall(bump_, size_class);
+        bump_ += kClassBytes[size_class];
+    }
+
+    page->next = pages_;
+    pages_ = page;
+    bump_ = reinterpret_cast<uint8_t*>(page) + alignUp(sizeof(Page), kAlign);
+    bump_end_ = reinterpret_cast<uint8_t*>(page) + kPageBytes;
+    stats_.footprint += kPageBytes;
+    return true;
+}
+
+void* LuaArena::allocateLarge(size_t bytes) {
+    LargeBlock* block = static_cast<LargeBlock*>(heapAlloc(largeHeaderBytes() + bytes));
+    if (!block) {
+        return nullptr;
+    }
+    block->prev = nullptr;
+    block->next = large_;
+    block->bytes = bytes;
+    if (large_) {
+        large_->prev = block;
+    }
+    large_ = block;
+    stats_.footprint += largeHeaderBytes() + bytes;
+    return reinterpret_cast<uint8_t*>(block) + largeHeaderBytes();
+}
+
+void LuaArena::releaseLarge(void* ptr) {
+    LargeBlock* block = reinterpret_cast<LargeBlock*>(static_cast<uint8_t*>(ptr) - largeHeaderBytes());
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        large_ = block->next;
+    }
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+    stats_.footprint -= largeHeaderBytes() + block->bytes;
+    heap_caps_free(block);
+}
+
+void* LuaArena::resizeLarge(void* ptr, size_t bytes) {
+    LargeBlock* block = reinterpret_cast<LargeBlock*>(static_cast<uint8_t*>(ptr) - largeHeaderBytes());
+    const size_t old_bytes = block->bytes;
+    LargeBlock* moved = static_cast<LargeBlock*>(
+        heap_caps_realloc(block, largeHeaderBytes() + bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    if (!moved) {
+        return nullptr;  // Caller falls back to allocate + copy
+    }
+    if (moved->prev) {
+        moved->prev->next = moved;
+    } else {
+        large_ = moved;
+    }
+    if (moved->next) {
+        moved->next->prev = moved;
+    }
+    moved->bytes = bytes;
+    stats_.footprint = stats_.footprint - old_bytes + bytes;
+    return reinterpret_cast<uint8_t*>(moved) + largeHeaderBytes();
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief lua_Alloc backed by PSRAM pages with size classes
+ *
+ * Requests up to kMaxSmallBytes are rounded to one of a few size classes and
+ * carved from kPageBytes pages; freed blocks go to a per-class free list and
+ * are reused before the page grows. Larger requests (table parts, string
+ * buffers) get their own PSRAM block. Lua garbage therefore never lands in
+ * internal DRAM (unless the board has no PSRAM) and never fragments it.
+ *
+ * Every state gets its own arena: allocations beyond the limit fail, which
+ * Lua reports as "not enough memory" to the script, and drop() frees the whole
+ * state by releasing its pages instead of freeing every object.
+ *
+ * Not thread safe: only the thread running the state may use its arena.
+ */
+class LuaArena {
+public:
+    static constexpr size_t kPageBytes = 16 * 1024;
+    static constexpr size_t kMaxSmallBytes = 512;
+    static constexpr size_t kDefaultLimit = 512 * 1024;
+
+    struct Stats {
+        size_t current = 0;         // Bytes held by Lua
+        size_t peak = 0;            // Since resetPeak()
+        size_t footprint = 0;       // Pages and large blocks taken from the heap
+        size_t free_listed = 0;     // Small blocks waiting for reuse
+        uint32_t allocations = 0;
+        uint32_t failures = 0;      // Refused by the limit or the heap
+    };
+
+    explicit LuaArena(size_t limit = kDefaultLimit);
+    ~LuaArena();
+    LuaArena(const LuaArena&) = delete;
+    LuaArena& operator=(const LuaArena&) = delete;
+
+    /** lua_Alloc for lua_newstate(LuaArena::alloc, arena) */
+    static void* alloc(void* ud, void* ptr, size_t osize, size_t nsize);
+
+    /** Release every page and block; the state using the arena must not run again */
+    void drop();
+
+    void resetPeak() { stats_.peak = stats_.current; }
+    void setLimit(size_t limit) { limit_ = limit; }
+    size_t limit() const { return limit_; }
+    const Stats& stats() const { return stats_; }
+
+    /** Percentage of the footprint not holding live data (free lists, page tails, class rounding) */
+    uint32_t fragmentation() const;
+
+private:
+    static constexpr size_t kClassCount = 13;
+    static constexpr size_t kAlign = 16;
+
+    struct Page {
+        Page* next;
+    };
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct LargeBlock {
+        LargeBlock* prev;
+        LargeBlock* next;
+        size_t bytes;               // As requested by Lua
+    };
+
+    static int classFor(size_t bytes);
+    static size_t largeHeaderBytes();
+
+    /** Class of a live block: the size Lua reports, unless a kept large block holds it */
+    int classOf(const void* ptr, size_t osize) const;
+    bool inPages(const void* ptr) const;
+
+    void* reallocate(void* ptr, size_t osize, size_t nsize);
+    void* allocateSmall(int size_class);
+    void releaseSmall(void* ptr, int size_class);
+    void* allocateLarge(size_t bytes);
+    void releaseLarge(void* ptr);
+    void* resizeLarge(void* ptr, size_t bytes);
+    bool addPage();
+
+    size_t limit_;
+    Page* pages_ = nullptr;
+    uint8_t* bump_ = nullptr;
+    uint8_t* bump_end_ = nullptr;
+    FreeBlock* free_[kClassCount] = {};
+    LargeBlock* large_ = nullptr;
+    size_t kept_large_ = 0;         // Large blocks kept by a failed shrink to a small size
+    Stats stats_;
+};
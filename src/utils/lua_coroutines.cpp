@@ -0,0 +1,308 @@
+#include "utils/lua_coroutines.h"
+
+#include <algorithm>
+
+extern "C" {
+#include <lauxlib.h>
+}
+
+namespace {
+// Scheduler and task being resumed on this thread (set around lua_resume)
+thread_local LuaCoroutines* s_scheduler = nullptr;
+thread_local void* s_task = nullptr;
+
+// __index of an isolated _ENV (upvalue: _G). Values read through from _G, but a
+// table found there (string, gpio, ...) is first copied into the env, one level
+// deep, so assignments into it stay with the script
+int isolatedIndex(lua_State* L) {
+    lua_pushvalue(L, 2);
+    lua_gettable(L, lua_upvalueindex(1));
+    if (lua_type(L, -1) != LUA_TTABLE) {
+        return 1;
+    }
+    const int library = lua_gettop(L);
+    lua_newtable(L);
+    lua_pushnil(L);
+    while (lua_next(L, library)) {
+        lua_pushvalue(L, -2);
+        lua_insert(L, -2);
+        lua_rawset(L, -4);
+    }
+    lua_pushvalue(L, 2);
+    lua_pushvalue(L, -2);
+    lua_rawset(L, 1);
+    return 1;
+}
+} // namespace
+
+constexpr int LuaCoroutines::kHookInstructions;
+constexpr uint32_t LuaCoroutines::kSliceHooks;
+constexpr uint32_t LuaCoroutines::kIdle;
+
+LuaCoroutines::Value LuaCoroutines::Value::boolean(bool value) {
+    Value result;
+    result.type = Type::Boolean;
+    result.flag = value;
+    return result;
+}
+
+LuaCoroutines::Value LuaCoroutines::Value::integer(int64_t value) {
+    Value result;
+    result.type = Type::Integer;
+    result.number = value;
+    return result;
+}
+
+LuaCoroutines::Value LuaCoroutines::Value::string(std::string value) {
+    Value result;
+    result.type = Type::String;
+    result.text = std::move(value);
+    return result;
+}
+
+LuaCoroutines::LuaCoroutines(lua_State* L, std::function<uint32_t()> clock) : L_(L), clock_(std::move(clock)) {}
+
+LuaCoroutines::~LuaCoroutines() {
+    for (auto& task : tasks_) {
+        if (task->state != State::Finished) {
+            luaL_unref(L_, LUA_REGISTRYINDEX, task->ref);
+        }
+    }
+}
+
+void LuaCoroutines::spawn(uint32_t timeout_ms, Done done, void* user, bool isolate, int nargs) {
+    lua_State* co = lua_newthread(L_);
+    lua_insert(L_, -(nargs + 2));
+
+    if (isolate) {
+        // Upvalue 1 of a main chunk is _ENV: point it at a fresh table backed by _G
+        lua_newtable(L_);
+        lua_pushvalue(L_, -1);
+        lua_setfield(L_, -2, "_G");
+        lua_newtable(L_);
+        lua_pushglobaltable(L_);
+        lua_pushcclosure(L_, isolatedIndex, 1);
+        lua_setfield(L_, -2, "__index");
+        lua_setmetatable(L_, -2);
+        if (!lua_setupvalue(L_, -(nargs + 2), 1)) {
+            lua_pop(L_, 1);
+        }
+    }
+
+    lua_xmove(L_, co, nargs + 1);
+    lua_sethook(co, hook, LUA_MASKCOUNT, kHookInstructions);
+
+    std::unique_ptr<Task> task(new Task());
+    task->co = co;
+    task->nargs = nargs;
+    task->ref = luaL_ref(L_, LUA_REGISTRYINDEX);
+    task->start_ms = clock_();
+    task->timeout_ms = timeout_ms;
+    task->deadline_ms = task->start_ms + timeout_ms;
+    task->done = std::move(done);
+    task->user = user;
+    tasks_.push_back(std::move(task));
+    ++stats_.spawned;
+}
+
+uint32_t LuaCoroutines::step() {
+    std::vector<Completion> completions;
+    {
+        std::lock_guard<std::mutex> lock(completions_mutex_);
+        completions.swap(completions_);
+    }
+    for (Completion& completion : completions) {
+        for (auto& task : tasks_) {
+            if (task->state == State::Waiting && task->ticket == completion.ticket) {
+                task->nargs = push(task->co, completion.values);
+                task->state = State::Ready;
+                break;
+            }
+        }
+    }
+
+    // By index over the tasks present now: a Done callback may spawn (and grow tasks_),
+    // and coroutines spawned that way wait for the next step
+    const size_t count = tasks_.size();
+    uint32_t now = clock_();
+    for (size_t i = 0; i < count; ++i) {
+        Task& task = *tasks_[i];
+        if (task.state == State::Sleeping && reached(now, task.wake_ms)) {
+            task.state = State::Ready;
+        }
+        if (task.state != State::Finished && reached(now, task.deadline_ms)) {
+            finish(task, Status::Timeout, "script timed out after " + std::to_string(task.timeout_ms) + " ms");
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (tasks_[i]->state == State::Ready) {
+            resume(*tasks_[i]);
+        }
+    }
+    tasks_.erase(std::remove_if(tasks_.begin(), tasks_.end(),
+                                [](const std::unique_ptr<Task>& task) { return task->state == State::Finished; }),
+                 tasks_.end());
+
+    if (tasks_.empty()) {
+        return kIdle;
+    }
+    now = clock_();
+    uint32_t wait = kIdle;
+    for (const auto& task : tasks_) {
+        if (task->state == State::Ready) {
+            return 0;
+        }
+        uint32_t until = task->deadline_ms;
+        if (task->state == State::Sleeping && !reached(task->wake_ms, until)) {
+            until = task->wake_ms;
+        }
+        wait = std::min(wait, reached(now, until) ? 0 : until - now);
+    }
+    return wait;
+}
+
+void LuaCoroutines::complete(uint32_t ticket, Values values) {
+    {
+        std::lock_guard<std::mutex> lock(completions_mutex_);
+        completions_.push_back({ticket, std::move(values)});
+    }
+    if (wakeup_) {
+        wakeup_();
+    }
+}
+
+LuaCoroutines::Stats LuaCoroutines::getStats() const {
+    Stats stats = stats_;
+    stats.live = tasks_.size();
+    for (const auto& task : tasks_) {
+        switch (task->state) {
+            case State::Ready: ++stats.ready; break;
+            case State::Sleeping: ++stats.sleeping; break;
+            case State::Waiting: ++stats.waiting; break;
+            case State::Finished: break;
+        }
+    }
+    return stats;
+}
+
+bool LuaCoroutines::canYield(lua_State* L) {
+    const Task* task = static_cast<const Task*>(s_task);
+    return task && task->co == L && lua_isyieldable(L);
+}
+
+int LuaCoroutines::sleep(lua_State* L, uint32_t ms) {
+    Task* task = static_cast<Task*>(s_task);
+    task->state = State::Sleeping;
+    task->wake_ms = s_scheduler->clock_() + ms;
+    return lua_yield(L, 0);
+}
+
+uint32_t LuaCoroutines::suspend(lua_State* L) {
+    (void)L;
+    Task* task = static_cast<Task*>(s_task);
+    task->state = State::Waiting;
+    task->ticket = ++s_scheduler->next_ticket_;
+    return task->ticket;
+}
+
+LuaCoroutines* LuaCoroutines::current() {
+    return s_scheduler;
+}
+
+int LuaCoroutines::push(lua_State* L, const Values& values) {
+    for (const Value& value : values) {
+        switch (value.type) {
+            case Value::Type::Nil: lua_pushnil(L); break;
+            case Value::Type::Boolean: lua_pushboolean(L, value.flag); break;
+            case Value::Type::Integer: lua_pushinteger(L, static_cast<lua_Integer>(value.number)); break;
+            case Value::Type::String: lua_pushlstring(L, value.text.data(), value.text.size()); break;
+        }
+    }
+    return static_cast<int>(values.size());
+}
+
+void LuaCoroutines::hook(lua_State* L, lua_Debug* ar) {
+    (void)ar;
+    Task* task = static_cast<Task*>(s_task);
+    if (!task) {
+        return;  // Hook inherited by a coroutine resumed outside the scheduler
+    }
+    if (reached(s_scheduler->clock_(), task->deadline_ms)) {
+        task->timed_out = true;
+        if (L == task->co && lua_isyieldable(L)) {
+            lua_yield(L, 0);  // pcall cannot catch a yield: resume() ends the task
+            return;
+        }
+        // Nested coroutine or C boundary: raised again on every hook until back in task->co
+        luaL_error(L, "script timed out after %d ms", static_cast<int>(task->timeout_ms));
+        return;
+    }
+    if (L == task->co && ++task->hooks >= kSliceHooks && lua_isyieldable(L)) {
+        task->preempted = true;
+        lua_yield(L, 0);
+    }
+}
+
+void LuaCoroutines::resume(Task& task) {
+    LuaCoroutines* previous_scheduler = s_scheduler;
+    void* previous_task = s_task;
+    s_scheduler = this;
+    s_task = &task;
+    task.hooks = 0;
+    task.preempted = false;
+    if (observer_) {
+        observer_(task.user, true);
+    }
+
+    int nresults = 0;
+    const int nargs = task.nargs;
+    task.nargs = 0;
+    const int status = lua_resume(task.co, L_, nargs, &nresults);
+
+    if (observer_) {
+        observer_(task.user, false);
+    }
+    s_scheduler = previous_scheduler;
+    s_task = previous_task;
+    ++task.slices;
+
+    if (task.timed_out) {
+        finish(task, Status::Timeout, "script timed out after " + std::to_string(task.timeout_ms) + " ms");
+    } else if (status == LUA_YIELD) {
+        if (task.state == State::Ready) {
+            // Preempted, or coroutine.yield() from the script: discard yielded values
+            lua_pop(task.co, nresults);
+            if (task.preempted) {
+                ++stats_.preempted;
+            }
+        }
+    } else if (status == LUA_OK) {
+        finish(task, Status::Ok, "");
+    } else {
+        const char* message = lua_tostring(task.co, -1);
+        finish(task, Status::Error, message ? message : "unknown error");
+    }
+}
+
+void LuaCoroutines::finish(Task& task, Status status, const std::string& error) {
+    Result result;
+    result.status = status;
+    result.error = error;
+    result.elapsed_ms = clock_() - task.start_ms;
+    result.slices = task.slices;
+    switch (status) {
+        case Status::Ok: ++stats_.completed; break;
+        case Status::Error: ++stats_.failed; break;
+        case Status::Timeout: ++stats_.timed_out; break;
+    }
+
+    task.state = State::Finished;
+    if (task.done) {
+        task.done(task.co, result);
+    }
+    lua_closethread(task.co, L_);
+    luaL_unref(L_, LUA_REGISTRYINDEX, task.ref);
+    task.co = nullptr;
+    task.done = nullptr;
+}
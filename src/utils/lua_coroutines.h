@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <lua.h>
+}
+
+/**
+ * @brief Runs many Lua scripts as coroutines of one state on one thread
+ *
+ * step() resumes every ready coroutine once. A coroutine gives the thread
+ * back when it:
+ *   - sleeps: a binding returns sleep(L, ms)
+ *   - waits for blocking work done elsewhere: a binding takes a ticket with
+ *     suspend(L), returns lua_yield(L, 0), and whoever does the work calls
+ *     complete(ticket, values); the values become the binding's results
+ *   - runs kSliceHooks * kHookInstructions instructions: a count hook yields it
+ *   - calls coroutine.yield() at top level
+ * Sleeping scripts cost a table entry, not a task. A script still running
+ * (or waiting) at its deadline is ended with a timeout: the hook yields it
+ * out of any pcall and the thread is closed.
+ *
+ * All scripts share one state. An isolated script gets its own _ENV whose
+ * reads fall through to _G; a global table it reads (string, gpio, ...) is
+ * copied into it first, so string.upper = nil only changes that script's
+ * view. The copies are one level deep: nested tables
+ * (package.loaded), the string metatable and the debug library still reach
+ * the shared libraries. This keeps scripts from breaking each other by
+ * mistake; it is not a boundary against a hostile script.
+ *
+ * Bindings must check canYield(L) first and block as before when it is false:
+ * the state may be run outside the scheduler, or the call may come through a
+ * C boundary (string.gsub callback, metamethod) that cannot yield.
+ *
+ * Time comes from the clock given to the constructor (simulated in tests).
+ * Everything except complete() must be called on the scheduler thread.
+ */
+class LuaCoroutines {
+public:
+    static constexpr int kHookInstructions = 1000;
+    static constexpr uint32_t kSliceHooks = 20;             // Instructions per turn: 20k
+    static constexpr uint32_t kIdle = UINT32_MAX;           // step(): nothing to wake for
+
+    /** Result of blocking work, pushed as the binding's return values */
+    struct Value {
+        enum class Type : uint8_t { Nil, Boolean, Integer, String };
+        Type type = Type::Nil;
+        bool flag = false;
+        int64_t number = 0;
+        std::string text;
+
+        static Value nil() { return Value(); }
+        static Value boolean(bool value);
+        static Value integer(int64_t value);
+        static Value string(std::string value);
+    };
+    using Values = std::vector<Value>;
+
+    enum class Status : uint8_t { Ok, Error, Timeout };
+
+    struct Result {
+        Status status = Status::Ok;
+        std::string error;
+        uint32_t elapsed_ms = 0;    // Spawn to finish
+        uint32_t slices = 0;        // Times resumed
+    };
+
+    /** Called when a coroutine ends; for Ok its return values are on top of co's stack */
+    using Done = std::function<void(lua_State* co, const Result& result)>;
+    /** Called before (entering = true) and after every resume */
+    using Observer = std::function<void(void* user, bool entering)>;
+
+    struct Stats {
+        size_t live = 0;
+        size_t ready = 0;
+        size_t sleeping = 0;
+        size_t waiting = 0;
+        uint32_t spawned = 0;
+        uint32_t completed = 0;
+        uint32_t failed = 0;
+        uint32_t timed_out = 0;
+        uint32_t preempted = 0;     // Turns ended by the instruction budget
+    };
+
+    LuaCoroutines(lua_State* L, std::function<uint32_t()> clock);
+    ~LuaCoroutines();
+    LuaCoroutines(const LuaCoroutines&) = delete;
+    LuaCoroutines& operator=(const LuaCoroutines&) = delete;
+
+    /**
+     * @brief Start a function as a coroutine
+     *
+     * The function and nargs arguments above it are popped from L's stack.
+     * @param isolate Give a main chunk its own globals table (reads fall back to _G, library tables copied)
+     */
+    void spawn(uint32_t timeout_ms, Done done, void* user = nullptr, bool isolate = true, int nargs = 0);
+
+    /** Resume every ready coroutine once; @return ms until the next wake-up, 0 if ready, kIdle if none */
+    uint32_t step();
+
+    /** Deliver the results of suspend()ed work; thread safe */
+    void complete(uint32_t ticket, Values values);
+
+    void setObserver(Observer observer) { observer_ = std::move(observer); }
+    /** Called from complete() (any thread) so the owner can run step() */
+    void setWakeup(std::function<void()> wakeup) { wakeup_ = std::move(wakeup); }
+
+    Stats getStats() const;
+    bool empty() const { return tasks_.empty(); }
+
+    // For bindings, on the scheduler thread
+    static bool canYield(lua_State* L);
+    static int sleep(lua_State* L, uint32_t ms);
+    static uint32_t suspend(lua_State* L);
+    static LuaCoroutines* current();
+    static int push(lua_State* L, const Values& values);
+
+private:
+    enum class State : uint8_t { Ready, Sleeping, Waiting, Finished };
+
+    struct Task {
+        lua_State* co = nullptr;
+        int ref = 0;                // Registry reference keeping the thread alive
+        State state = State::Ready;
+        int nargs = 0;              // Values pushed for the next resume
+        uint32_t start_ms = 0;
+        uint32_t wake_ms = 0;
+        uint32_t deadline_ms = 0;
+        uint32_t timeout_ms = 0;
+        uint32_t ticket = 0;
+        uint32_t hooks = 0;         // Count hooks in the current turn
+        uint32_t slices = 0;
+        bool preempted = false;
+        bool timed_out = false;
+        Done done;
+        void* user = nullptr;
+    };
+
+    struct Completion {
+        uint32_t ticket;
+        Values values;
+    };
+
+    static void hook(lua_State* L, lua_Debug* ar);
+    void resume(Task& task);
+    void finish(Task& task, Status status, const std::string& error);
+    static bool reached(uint32_t now, uint32_t when) { return static_cast<int32_t>(now - when) >= 0; }
+
+    lua_State* L_;
+    std::function<uint32_t()> clock_;
+    std::vector<std::unique_ptr<Task>> tasks_;
+    Observer observer_;
+    std::function<void()> wakeup_;
+    uint32_t next_ticket_ = 0;
+    Stats stats_;
+
+    mutable std::mutex completions_mutex_;
+    std::vector<Completion> completions_;
+};
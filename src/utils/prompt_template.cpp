@@ -0,0 +1,86 @@
+#include "utils/prompt_template.h"
+
+void PromptTemplate::clear() {
+    literals_.clear();
+    segments_.clear();
+    slots_ = 0;
+}
+
+void PromptTemplate::appendLiteral(const char* data, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    if (!segments_.empty() && segments_.back().name.empty()) {
+        segments_.back().length += length;  // Merge with the previous literal
+    } else {
+        Segment segment;
+        segment.offset = literals_.size();
+        segment.length = length;
+        segments_.push_back(std::move(segment));
+    }
+    literals_.append(data, length);
+}
+
+void PromptTemplate::compile(const std::string& text, const Resolver& fixed) {
+    clear();
+    literals_.reserve(text.size());
+
+    size_t pos = 0;
+    while (pos < text.size()) {
+        const size_t open = text.find("{{", pos);
+        if (open == std::string::npos) {
+            break;
+        }
+        const size_t close = text.find("}}", open + 2);
+        if (close == std::string::npos) {
+            break;
+        }
+        const size_t name_length = close - open - 2;
+        if (name_length == 0 || text.find('{', open + 2) < close) {
+            // "{{}}" or "{{{x}}": keep the first brace as text and rescan
+            appendLiteral(text.data() + pos, open + 1 - pos);
+            pos = open + 1;
+            continue;
+        }
+
+        appendLiteral(text.data() + pos, open - pos);
+        std::string name = text.substr(open + 2, name_length);
+        const std::string* value = fixed ? fixed(name) : nullptr;
+        if (value) {
+            appendLiteral(value->data(), value->size());
+        } else {
+            Segment segment;
+            segment.name = std::move(name);
+            segments_.push_back(std::move(segment));
+            ++slots_;
+        }
+        pos = close + 2;
+    }
+    appendLiteral(text.data() + pos, text.size() - pos);
+}
+
+void PromptTemplate::render(const Resolver& resolver, std::string& out) const {
+    std::vector<const std::string*> values(segments_.size(), nullptr);
+    size_t total = literals_.size();
+    for (size_t i = 0; i < segments_.size(); ++i) {
+        const Segment& segment = segments_[i];
+        if (segment.name.empty()) {
+            continue;
+        }
+        values[i] = resolver ? resolver(segment.name) : nullptr;
+        total += values[i] ? values[i]->size() : segment.name.size() + 4;
+    }
+
+    out.clear();
+    out.reserve(total);
+    for (size_t i = 0; i < segments_.size(); ++i) {
+        const Segment& segment = segments_[i];
+        if (segment.name.empty()) {
+            out.append(literals_, segment.offset, segment.length);
+        } else if (values[i]) {
+            out.append(*values[i]);
+        } else {
+            out.append("{{").append(segment.name).append("}}");
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Prompt template compiled into literal and {{placeholder}} segments
+ *
+ * compile() scans the text once. Placeholders the fixed resolver knows (values
+ * that only change with the template, e.g. the command list) are folded into
+ * the literals; the rest stay as named slots filled by render(). Rendering is a
+ * single pass into a buffer reserved for the literal bytes plus the values, so
+ * no find/replace loop runs per variable. A slot the render resolver does not
+ * know is emitted verbatim as {{name}}.
+ */
+class PromptTemplate {
+public:
+    /** Returns the value for a placeholder name, nullptr if unknown */
+    using Resolver = std::function<const std::string*(const std::string& name)>;
+
+    void compile(const std::string& text, const Resolver& fixed = Resolver());
+    void clear();
+
+    void render(const Resolver& resolver, std::string& out) const;
+
+    bool empty() const { return segments_.empty(); }
+    size_t slotCount() const { return slots_; }
+    size_t literalBytes() const { return literals_.size(); }
+
+private:
+    struct Segment {
+        size_t offset = 0;     // Into literals_ (literal segments)
+        size_t length = 0;
+        std::string name;      // Non-empty for a slot
+    };
+
+    void appendLiteral(const char* data, size_t length);
+
+    std::string literals_;
+    std::vector<Segment> segments_;
+    size_t slots_ = 0;
+};
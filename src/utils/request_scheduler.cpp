@@ -0,0 +1,271 @@
+#include "utils/request_scheduler.h"
+
+#include <algorithm>
+
+namespace {
+bool reached(uint32_t now, uint32_t when) {
+    return static_cast<int32_t>(now - when) >= 0;
+}
+
+uint32_t average(uint32_t current, uint32_t sample) {
+    return current == 0 ? sample : (current * 7 + sample) / 8;
+}
+
+// Background requests leave one slot of a shared limit to everything else
+uint8_t limitFor(uint8_t limit, uint8_t priority) {
+    return priority == RequestScheduler::kBackgroundPriority && limit > 1 ? limit - 1 : limit;
+}
+} // namespace
+
+constexpr size_t RequestScheduler::kMaxRequests;
+constexpr size_t RequestScheduler::kMaxLanes;
+constexpr size_t RequestScheduler::kMaxEndpoints;
+constexpr RequestScheduler::Ticket RequestScheduler::kNoTicket;
+constexpr uint8_t RequestScheduler::kBackgroundPriority;
+
+RequestScheduler::RequestScheduler() {
+    generation_.fill(0);
+    lane_limit_.fill(1);
+    lane_running_.fill(0);
+    endpoint_limit_.fill(1);
+    endpoint_running_.fill(0);
+}
+
+void RequestScheduler::setLaneLimit(size_t lane, uint8_t limit) {
+    if (lane < kMaxLanes) {
+        lane_limit_[lane] = std::max<uint8_t>(limit, 1);
+    }
+}
+
+void RequestScheduler::setEndpointLimit(size_t endpoint, uint8_t limit) {
+    if (endpoint < kMaxEndpoints) {
+        endpoint_limit_[endpoint] = std::max<uint8_t>(limit, 1);
+    }
+}
+
+RequestScheduler::Ticket RequestScheduler::submit(uint8_t lane, uint8_t endpoint, uint8_t priority, uint32_t now,
+                                                  uint32_t timeout_ms) {
+    if (lane >= kMaxLanes || endpoint >= kMaxEndpoints) {
+        return kNoTicket;
+    }
+
+    // A free slot, else the collected one finished longest ago
+    size_t chosen = kMaxRequests;
+    for (size_t i = 0; i < kMaxRequests; ++i) {
+        const Entry& entry = entries_[i];
+        if (entry.state == State::Free) {
+            chosen = i;
+            break;
+        }
+        if (entry.collected && !entry.active &&
+            (chosen == kMaxRequests || reached(entries_[chosen].finished_ms, entry.finished_ms))) {
+            chosen = i;
+        }
+    }
+    if (chosen == kMaxRequests) {
+        ++stats_[lane].rejected;
+        return kNoTicket;
+    }
+
+    if (++generation_[chosen] == 0) {
+        generation_[chosen] = 1;     // Keep tickets non-zero
+    }
+    Entry& entry = entries_[chosen];
+    entry = Entry();
+    entry.state = State::Queued;
+    entry.lane = lane;
+    entry.endpoint = endpoint;
+    entry.priority = priority;
+    entry.sequence = ++sequence_;
+    entry.queued_ms = now;
+    entry.deadline_ms = now + timeout_ms;
+    ++stats_[lane].submitted;
+    return static_cast<Ticket>(generation_[chosen]) << 8 | chosen;
+}
+
+RequestScheduler::Ticket RequestScheduler::next(uint32_t now) {
+    expire(now);
+
+    Entry* best = nullptr;
+    size_t best_index = 0;
+    for (size_t i = 0; i < kMaxRequests; ++i) {
+        Entry& entry = entries_[i];
+        if (entry.state != State::Queued ||
+            lane_running_[entry.lane] >= limitFor(lane_limit_[entry.lane], entry.priority) ||
+            endpoint_running_[entry.endpoint] >= limitFor(endpoint_limit_[entry.endpoint], entry.priority)) {
+            continue;
+        }
+        if (best) {
+            if (entry.priority != best->priority) {
+                if (entry.priority < best->priority) {
+                    continue;
+                }
+            } else if (entry.deadline_ms != best->deadline_ms) {
+                if (reached(entry.deadline_ms, best->deadline_ms)) {
+                    continue;
+                }
+            } else if (entry.sequence > best->sequence) {
+                continue;
+            }
+        }
+        best = &entry;
+        best_index = i;
+    }
+    if (!best) {
+        return kNoTicket;
+    }
+
+    best->state = State::Running;
+    best->active = true;
+    best->started_ms = now;
+    ++lane_running_[best->lane];
+    ++endpoint_running_[best->endpoint];
+
+    LaneStats& stats = stats_[best->lane];
+    const uint32_t wait_ms = now - best->queued_ms;
+    stats.avg_wait_ms = average(stats.avg_wait_ms, wait_ms);
+    stats.max_wait_ms = std::max(stats.max_wait_ms, wait_ms);
+    return static_cast<Ticket>(generation_[best_index]) << 8 | best_index;
+}
+
+bool RequestScheduler::finish(Ticket ticket, bool success, uint32_t now) {
+    Entry* entry = find(ticket);
+    if (!entry || !entry->active) {
+        return false;
+    }
+
+    LaneStats& stats = stats_[entry->lane];
+    const uint32_t run_ms = now - entry->started_ms;
+    stats.avg_run_ms = average(stats.avg_run_ms, run_ms);
+    stats.max_run_ms = std::max(stats.max_run_ms, run_ms);
+    release(*entry);
+
+    if (entry->state != State::Running) {
+        return false;   // Timed out or cancelled while running
+    }
+    close(*entry, success ? State::Done : State::Failed, now);
+    return true;
+}
+
+bool RequestScheduler::cancel(Ticket ticket, uint32_t now) {
+    Entry* entry = find(ticket);
+    if (!entry || (entry->state != State::Queued && entry->state != State::Running)) {
+        return false;
+    }
+    close(*entry, State::Cancelled, now);
+    return true;
+}
+
+size_t RequestScheduler::expire(uint32_t now) {
+    size_t count = 0;
+    for (Entry& entry : entries_) {
+        if ((entry.state == State::Queued || entry.state == State::Running) && reached(now, entry.deadline_ms)) {
+            close(entry, State::TimedOut, now);
+            ++count;
+        }
+    }
+    return count;
+}
+
+bool RequestScheduler::collect(Ticket ticket) {
+    Entry* entry = find(ticket);
+    if (!entry || !finished(entry->state)) {
+        return false;
+    }
+    entry->collected = true;
+    return true;
+}
+
+size_t RequestScheduler::purge(uint32_t now, uint32_t ttl_ms) {
+    size_t count = 0;
+    for (Entry& entry : entries_) {
+        if (finished(entry.state) && !entry.active && now - entry.finished_ms > ttl_ms) {
+            entry.state = State::Free;
+            ++count;
+        }
+    }
+    return count;
+}
+
+uint32_t RequestScheduler::nextDeadline(uint32_t now) const {
+    uint32_t wait = UINT32_MAX;
+    for (const Entry& entry : entries_) {
+        if (entry.state == State::Queued || entry.state == State::Running) {
+            wait = std::min(wait, reached(now, entry.deadline_ms) ? 0 : entry.deadline_ms - now);
+        }
+    }
+    return wait;
+}
+
+bool RequestScheduler::get(Ticket ticket, Entry& entry) const {
+    const Entry* found = find(ticket);
+    if (!found) {
+        return false;
+    }
+    entry = *found;
+    return true;
+}
+
+size_t RequestScheduler::queued() const {
+    return std::count_if(entries_.begin(), entries_.end(),
+                         [](const Entry& entry) { return entry.state == State::Queued; });
+}
+
+size_t RequestScheduler::running() const {
+    return std::count_if(entries_.begin(), entries_.end(), [](const Entry& entry) { return entry.active; });
+}
+
+size_t RequestScheduler::endpointQueued(size_t endpoint) const {
+    return std::count_if(entries_.begin(), entries_.end(), [endpoint](const Entry& entry) {
+        return entry.state == State::Queued && entry.endpoint == endpoint;
+    });
+}
+
+RequestScheduler::LaneStats RequestScheduler::laneStats(size_t lane) const {
+    if (lane >= kMaxLanes) {
+        return LaneStats();
+    }
+    LaneStats stats = stats_[lane];
+    stats.running = lane_running_[lane];
+    stats.queued = std::count_if(entries_.begin(), entries_.end(), [lane](const Entry& entry) {
+        return entry.state == State::Queued && entry.lane == lane;
+    });
+    return stats;
+}
+
+RequestScheduler::Entry* RequestScheduler::find(Ticket ticket) {
+    const size_t index = slot(ticket);
+    if (ticket == kNoTicket || index >= kMaxRequests || (ticket >> 8) != generation_[index] ||
+        entries_[index].state == State::Free) {
+        return nullptr;
+    }
+    return &entries_[index];
+}
+
+const RequestScheduler::Entry* RequestScheduler::find(Ticket ticket) const {
+    return const_cast<RequestScheduler*>(this)->find(ticket);
+}
+
+void RequestScheduler::release(Entry& entry) {
+    entry.active = false;
+    --lane_running_[entry.lane];
+    --endpoint_running_[entry.endpoint];
+}
+
+void RequestScheduler::close(Entry& entry, State state, uint32_t now) {
+    entry.state = state;
+    entry.finished_ms = now;
+    LaneStats& stats = stats_[entry.lane];
+    switch (state) {
+        case State::Done: ++stats.completed; break;
+        case State::Failed: ++stats.failed; break;
+        case State::TimedOut: ++stats.timed_out; break;
+        case State::Cancelled: ++stats.cancelled; break;
+        default: break;
+    }
+}
+
+bool RequestScheduler::finished(State state) {
+    return state == State::Done || state == State::Failed || state == State::TimedOut ||
+           state == State::Cancelled;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Which queued request a free worker takes next, in a fixed table
+ *
+ * Requests go to a lane (STT, LLM, ...) and an endpoint (the server they
+ * call). A worker asking for work gets the highest priority queued request
+ * whose lane and endpoint are both under their concurrency limits; ties go to
+ * the earliest deadline, then to the oldest request. So a long LLM call holds
+ * one LLM slot and one slot of its server, while a command queued behind it
+ * starts on the next free worker.
+ *
+ * Priority alone only orders the queue: a background job that already holds
+ * the last slot would still make an interactive request wait for it. So
+ * requests at kBackgroundPriority use at most limit - 1 slots of a lane or
+ * endpoint whose limit is above 1, keeping one for everything else.
+ *
+ * Every request has a deadline: a queued request past it times out without
+ * running, a running one is reported as timed out at once and its result is
+ * discarded by finish() (the worker still counts against its lane and
+ * endpoint until then).
+ *
+ * Requests live in kMaxRequests slots, finished ones included until purge()
+ * or, once their owner has collect()ed the result, until a new submit() needs
+ * the slot. A result nobody collected is never evicted: submit() rejects
+ * instead. A ticket is the slot index plus a generation, so a stale ticket
+ * never matches a reused slot. Time is passed in by the caller. Not
+ * thread-safe: the owner serializes the calls.
+ */
+class RequestScheduler {
+public:
+    static constexpr size_t kMaxRequests = 32;
+    static constexpr size_t kMaxLanes = 4;
+    static constexpr size_t kMaxEndpoints = 4;
+
+    using Ticket = uint32_t;
+    static constexpr Ticket kNoTicket = 0;
+    static constexpr uint8_t kBackgroundPriority = 0;   // Lowest; never takes the last slot of a limit
+
+    enum class State : uint8_t { Free, Queued, Running, Done, Failed, TimedOut, Cancelled };
+
+    struct Entry {
+        State state = State::Free;
+        bool active = false;            // Held by a worker (also after a timeout or cancel)
+        bool collected = false;         // Finished and its result read; the slot may be reused
+        uint8_t lane = 0;
+        uint8_t endpoint = 0;
+        uint8_t priority = 0;           // Higher runs first
+        uint32_t sequence = 0;
+        uint32_t queued_ms = 0;
+        uint32_t started_ms = 0;
+        uint32_t finished_ms = 0;
+        uint32_t deadline_ms = 0;
+    };
+
+    struct LaneStats {
+        uint32_t submitted = 0;
+        uint32_t rejected = 0;          // Table full of unfinished or uncollected requests
+        uint32_t completed = 0;
+        uint32_t failed = 0;
+        uint32_t timed_out = 0;
+        uint32_t cancelled = 0;
+        size_t queued = 0;
+        size_t running = 0;
+        uint32_t avg_wait_ms = 0;       // Submit to start
+        uint32_t max_wait_ms = 0;
+        uint32_t avg_run_ms = 0;
+        uint32_t max_run_ms = 0;
+    };
+
+    RequestScheduler();
+
+    void setLaneLimit(size_t lane, uint8_t limit);
+    void setEndpointLimit(size_t endpoint, uint8_t limit);
+    uint8_t laneLimit(size_t lane) const { return lane < kMaxLanes ? lane_limit_[lane] : 0; }
+    uint8_t endpointLimit(size_t endpoint) const { return endpoint < kMaxEndpoints ? endpoint_limit_[endpoint] : 0; }
+    uint8_t endpointRunning(size_t endpoint) const { return endpoint < kMaxEndpoints ? endpoint_running_[endpoint] : 0; }
+
+    /** Queue a request; kNoTicket if every slot holds an unfinished or uncollected request */
+    Ticket submit(uint8_t lane, uint8_t endpoint, uint8_t priority, uint32_t now, uint32_t timeout_ms);
+
+    /** Start the best runnable request, kNoTicket if none (expires overdue ones first) */
+    Ticket next(uint32_t now);
+
+    /** Worker is done; false if the request timed out or was cancelled meanwhile */
+    bool finish(Ticket ticket, bool success, uint32_t now);
+
+    /** Cancel a queued or running request */
+    bool cancel(Ticket ticket, uint32_t now);
+
+    /** Time out requests past their deadline; returns how many */
+    size_t expire(uint32_t now);
+
+    /** The owner has read the finished result; false if unknown or not finished yet */
+    bool collect(Ticket ticket);
+
+    /** Free finished requests older than ttl_ms, collected or not */
+    size_t purge(uint32_t now, uint32_t ttl_ms);
+
+    /** Milliseconds until the next deadline of an unfinished request, UINT32_MAX if none */
+    uint32_t nextDeadline(uint32_t now) const;
+
+    bool get(Ticket ticket, Entry& entry) const;
+    static size_t slot(Ticket ticket) { return ticket & 0xFF; }
+
+    size_t queued() const;
+    size_t running() const;
+    size_t endpointQueued(size_t endpoint) const;
+    LaneStats laneStats(size_t lane) const;
+
+private:
+    Entry* find(Ticket ticket);
+    const Entry* find(Ticket ticket) const;
+    void release(Entry& entry);
+    void close(Entry& entry, State state, uint32_t now);
+    static bool finished(State state);
+
+    std::array<Entry, kMaxRequests> entries_;
+    std::array<uint8_t, kMaxRequests> generation_;
+    std::array<uint8_t, kMaxLanes> lane_limit_;
+    std::array<uint8_t, kMaxLanes> lane_running_;
+    std::array<uint8_t, kMaxEndpoints> endpoint_limit_;
+    std::array<uint8_t, kMaxEndpoints> endpoint_running_;
+    std::array<LaneStats, kMaxLanes> stats_;
+    uint32_t sequence_ = 0;
+};
@@ -0,0 +1,429 @@
+#include "utils/response_template.h"
+#include "utils/json_path_extractor.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+struct FilterName {
+    const char* name;
+    bool takes_arg;
+};
+
+constexpr FilterName kFilterNames[] = {
+    {"round", false}, {"fixed", true}, {"bytes", false}, {"duration", false},
+    {"map", true}, {"plural", true}, {"default", true},
+};
+
+struct UnitNames {
+    const char* one;
+    const char* many;
+};
+
+// Days, hours, minutes, seconds
+constexpr UnitNames kItalianUnits[] = {{"giorno", "giorni"}, {"ora", "ore"}, {"minuto", "minuti"}, {"secondo", "secondi"}};
+constexpr UnitNames kEnglishUnits[] = {{"day", "days"}, {"hour", "hours"}, {"minute", "minutes"}, {"second", "seconds"}};
+
+constexpr const char* kEnglishWords[] = {
+    "the", "what", "whats", "is", "are", "how", "weather", "show", "tell", "me", "my",
+    "please", "turn", "set", "much", "many", "free", "memory", "today", "and",
+};
+constexpr const char* kItalianWords[] = {
+    "il", "lo", "la", "che", "come", "qual", "quale", "quanto", "quanta", "quanti", "meteo",
+    "dimmi", "mostra", "di", "e", "fa", "tempo", "oggi", "memoria", "libera", "per", "mi",
+};
+
+bool parseNumber(const std::string& text, double& value) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    value = strtod(text.c_str(), &end);
+    return end && *end == '\0' && std::isfinite(value);
+}
+
+std::vector<std::string> split(const std::string& text, char separator) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+    for (;;) {
+        const size_t end = text.find(separator, start);
+        parts.push_back(text.substr(start, end == std::string::npos ? std::string::npos : end - start));
+        if (end == std::string::npos) {
+            return parts;
+        }
+        start = end + 1;
+    }
+}
+
+void replaceAll(std::string& text, const std::string& from, const std::string& to) {
+    for (size_t pos = text.find(from); pos != std::string::npos; pos = text.find(from, pos + to.size())) {
+        text.replace(pos, from.size(), to);
+    }
+}
+
+std::string trim(const std::string& text) {
+    const size_t begin = text.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) {
+        return std::string();
+    }
+    const size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(begin, end - begin + 1);
+}
+
+bool contains(const char* const* words, size_t count, const std::string& word) {
+    for (size_t i = 0; i < count; ++i) {
+        if (word == words[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+// Field values of one output, looked up by placeholder name
+struct ResponseTemplate::Fields {
+    std::vector<std::string> names;
+    std::vector<std::string> values;
+    std::vector<bool> present;
+
+    const std::string* find(const std::string& name) const {
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (names[i] == name) {
+                return present[i] ? &values[i] : nullptr;
+            }
+        }
+        return nullptr;
+    }
+};
+
+bool ResponseTemplate::compile(const std::string& text, Language language, std::string* error) {
+    segments_.clear();
+    language_ = language;
+
+    auto fail = [&](const std::string& reason) {
+        segments_.clear();
+        if (error) {
+            *error = reason;
+        }
+        return false;
+    };
+
+    size_t pos = 0;
+    while (pos < text.size()) {
+        const size_t open = text.find('{', pos);
+        if (open != pos) {
+            const size_t end = open == std::string::npos ? text.size() : open;
+            if (text.find('}', pos) < end) {
+                return fail("unbalanced '}'");
+            }
+            Segment literal;
+            literal.text = text.substr(pos, end - pos);
+            segments_.push_back(std::move(literal));
+            pos = end;
+            continue;
+        }
+
+        const size_t close = text.find('}', open);
+        if (close == std::string::npos || text.find('{', open + 1) < close) {
+            return fail("unbalanced '{'");
+        }
+        std::vector<std::string> parts = split(text.substr(open + 1, close - open - 1), '|');
+        Segment placeholder;
+        placeholder.field = true;
+        placeholder.text = trim(parts[0]);
+        if (placeholder.text.empty()) {
+            return fail("empty placeholder");
+        }
+        for (size_t i = 1; i < parts.size(); ++i) {
+            const size_t colon = parts[i].find(':');
+            const std::string name = trim(parts[i].substr(0, colon));
+            const FilterName* known = nullptr;
+            for (const FilterName& candidate : kFilterNames) {
+                if (name == candidate.name) {
+                    known = &candidate;
+                }
+            }
+            if (!known || known->takes_arg != (colon != std::string::npos)) {
+                return fail("bad filter '" + parts[i] + "'");
+            }
+            Filter filter;
+            filter.kind = static_cast<FilterKind>(known - kFilterNames);
+            if (colon != std::string::npos) {
+                filter.arg = parts[i].substr(colon + 1);
+            }
+            placeholder.filters.push_back(std::move(filter));
+        }
+        segments_.push_back(std::move(placeholder));
+        pos = close + 1;
+    }
+    return true;
+}
+
+bool ResponseTemplate::render(const std::string& output, std::string& out) const {
+    // Collect the fields once, then read the output in a single pass
+    Fields fields;
+    for (const Segment& segment : segments_) {
+        if (segment.field && std::find(fields.names.begin(), fields.names.end(), segment.text) == fields.names.end()) {
+            fields.names.push_back(segment.text);
+        }
+    }
+    fields.values.assign(fields.names.size(), std::string());
+    fields.present.assign(fields.names.size(), false);
+
+    const std::string body = trim(output);
+    const bool json = !body.empty() && (body[0] == '{' || body[0] == '[');
+
+    JsonPathExtractor extractor;
+    std::vector<int> path_of(fields.names.size(), -1);
+    std::vector<size_t> matches;
+    for (size_t i = 0; i < fields.names.size(); ++i) {
+        const std::string& name = fields.names[i];
+        if (name == "$output") {
+            fields.values[i] = body;
+            fields.present[i] = !body.empty();
+        } else if (name == "$items") {
+            size_t items = 0;
+            for (const std::string& line : split(body, '\n')) {
+                items += line.compare(0, 2, "- ") == 0;
+            }
+            fields.values[i] = std::to_string(items);
+            fields.present[i] = true;
+        } else if (json && name[0] != '$') {
+            const char* path = name[0] == '#' ? name.c_str() + 1 : name.c_str();
+            if (extractor.addPath(path)) {
+                path_of[i] = static_cast<int>(matches.size());
+                matches.push_back(0);
+            }
+        } else if (!json && name[0] != '$' && name[0] != '#') {
+            // key=value tokens separated by whitespace
+            const std::string key = name + "=";
+            for (size_t at = body.find(key); at != std::string::npos; at = body.find(key, at + 1)) {
+                if (at == 0 || isspace(static_cast<unsigned char>(body[at - 1]))) {
+                    const size_t begin = at + key.size();
+                    const size_t end = body.find_first_of(" \t\r\n", begin);
+                    fields.values[i] = body.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+                    fields.present[i] = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (!matches.empty()) {
+        extractor.setCallback([&matches](size_t path, JsonPathExtractor::Type, const std::string&) {
+            ++matches[path];
+        });
+        extractor.feed(body.data(), body.size());
+        if (!extractor.finish()) {
+            return false;
+        }
+        for (size_t i = 0; i < fields.names.size(); ++i) {
+            if (path_of[i] < 0) {
+                continue;
+            }
+            const size_t path = static_cast<size_t>(path_of[i]);
+            if (fields.names[i][0] == '#') {
+                fields.values[i] = std::to_string(matches[path]);
+                fields.present[i] = true;
+                continue;
+            }
+            switch (extractor.type(path)) {
+                case JsonPathExtractor::Type::String:
+                case JsonPathExtractor::Type::Number:
+                    fields.values[i] = extractor.value(path);
+                    fields.present[i] = true;
+                    break;
+                case JsonPathExtractor::Type::True:
+                case JsonPathExtractor::Type::False:
+                    fields.values[i] = extractor.type(path) == JsonPathExtractor::Type::True ? "true" : "false";
+                    fields.present[i] = true;
+                    break;
+                default:
+                    break;  // null and containers cannot be phrased
+            }
+        }
+    }
+
+    std::string text;
+    for (const Segment& segment : segments_) {
+        if (!segment.field) {
+            text += segment.text;
+            continue;
+        }
+        const std::string* found = fields.find(segment.text);
+        if (!found) {
+            auto fallback = std::find_if(segment.filters.begin(), segment.filters.end(),
+                                         [](const Filter& filter) { return filter.kind == FilterKind::Default; });
+            if (fallback == segment.filters.end()) {
+                return false;
+            }
+            text += fallback->arg;
+            continue;
+        }
+        std::string value = *found;
+        for (const Filter& filter : segment.filters) {
+            if (!applyFilter(filter, value)) {
+                return false;
+            }
+        }
+        text += value;
+    }
+
+    out = std::move(text);
+    return true;
+}
+
+std::string ResponseTemplate::formatNumber(double value, int decimals) const {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+    std::string text = buffer;
+    if (text == "-0" || (text.compare(0, 3, "-0.") == 0 && text.find_first_not_of("0", 3) == std::string::npos)) {
+        text.erase(0, 1);
+    }
+    if (language_ == Language::Italian) {
+        std::replace(text.begin(), text.end(), '.', ',');
+    }
+    return text;
+}
+
+bool ResponseTemplate::applyFilter(const Filter& filter, std::string& value) const {
+    double number = 0;
+    switch (filter.kind) {
+        case FilterKind::Default:
+            return true;
+
+        case FilterKind::Round:
+            if (!parseNumber(value, number)) {
+                return false;
+            }
+            value = formatNumber(std::round(number), 0);
+            return true;
+
+        case FilterKind::Fixed: {
+            if (!parseNumber(value, number)) {
+                return false;
+            }
+            const int decimals = std::max(0, std::min(6, atoi(filter.arg.c_str())));
+            value = formatNumber(number, decimals);
+            return true;
+        }
+
+        case FilterKind::Bytes: {
+            if (!parseNumber(value, number) || number < 0) {
+                return false;
+            }
+            static constexpr const char* kUnits[] = {"KB", "MB", "GB"};
+            if (number < 1024) {
+                value = formatNumber(number, 0) +
+                        (language_ == Language::English && number != 1 ? " bytes" : " byte");
+                return true;
+            }
+            size_t unit = 0;
+            number /= 1024;
+            while (number >= 1024 && unit < 2) {
+                number /= 1024;
+                ++unit;
+            }
+            value = formatNumber(number, number < 10 && unit > 0 ? 1 : 0) + " " + kUnits[unit];
+            return true;
+        }
+
+        case FilterKind::Duration: {
+            if (!parseNumber(value, number) || number < 0) {
+                return false;
+            }
+            const UnitNames* names = language_ == Language::English ? kEnglishUnits : kItalianUnits;
+            const uint64_t total = static_cast<uint64_t>(number);
+            const uint64_t amounts[] = {total / 86400, total % 86400 / 3600, total % 3600 / 60, total % 60};
+            std::vector<std::string> parts;
+            for (size_t i = 0; i < 4 && parts.size() < 2; ++i) {
+                if (amounts[i] == 0 && (i < 3 || !parts.empty())) {
+                    if (!parts.empty()) {
+                        break;  // Two adjacent units at most: "2 ore e 5 minuti", not "2 giorni e 5 minuti"
+                    }
+                    continue;
+                }
+                parts.push_back(std::to_string(amounts[i]) + " " + (amounts[i] == 1 ? names[i].one : names[i].many));
+            }
+            value = parts[0];
+            if (parts.size() > 1) {
+                value += (language_ == Language::English ? " and " : " e ") + parts[1];
+            }
+            return true;
+        }
+
+        case FilterKind::Map: {
+            const bool numeric = parseNumber(value, number);
+            const std::string* fallback = nullptr;
+            std::vector<std::string> entries = split(filter.arg, '/');
+            for (const std::string& entry : entries) {
+                const size_t eq = entry.find('=');
+                if (eq == std::string::npos) {
+                    continue;
+                }
+                const std::string key = entry.substr(0, eq);
+                double key_number = 0;
+                if (key == value || (numeric && parseNumber(key, key_number) && key_number == number)) {
+                    value = entry.substr(eq + 1);
+                    return true;
+                }
+                if (key == "else" || key == "*") {
+                    fallback = &entry;
+                }
+            }
+            if (!fallback) {
+                return false;
+            }
+            value = fallback->substr(fallback->find('=') + 1);
+            return true;
+        }
+
+        case FilterKind::Plural: {
+            if (!parseNumber(value, number)) {
+                return false;
+            }
+            // Italian and English agree: singular for exactly one, plural otherwise (also 0 and 1,5)
+            const std::vector<std::string> forms = split(filter.arg, '/');
+            std::string form;
+            if (forms.size() == 3) {
+                form = number == 0 ? forms[0] : number == 1 ? forms[1] : forms[2];
+            } else if (forms.size() == 2) {
+                form = number == 1 ? forms[0] : forms[1];
+            } else {
+                return false;
+            }
+            replaceAll(form, "#", value);
+            value = form;
+            return true;
+        }
+    }
+    return false;
+}
+
+ResponseTemplate::Language ResponseTemplate::guessLanguage(const std::string& text) {
+    size_t english = 0;
+    size_t italian = 0;
+    std::string word;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        const unsigned char c = i < text.size() ? static_cast<unsigned char>(text[i]) : ' ';
+        if (isalpha(c)) {
+            word.push_back(static_cast<char>(tolower(c)));
+            continue;
+        }
+        if (c == '\'' && !word.empty()) {
+            continue;  // "what's" -> "whats"
+        }
+        if (!word.empty()) {
+            english += contains(kEnglishWords, sizeof(kEnglishWords) / sizeof(kEnglishWords[0]), word);
+            italian += contains(kItalianWords, sizeof(kItalianWords) / sizeof(kItalianWords[0]), word);
+            word.clear();
+        }
+    }
+    return english > italian ? Language::English : Language::Italian;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Template that phrases a command output without asking the LLM
+ *
+ * Text with {field|filter|filter:arg} placeholders. Fields come from the
+ * output being phrased:
+ *   current.temperature_2m   JSON path (output is a JSON document)
+ *   heap_free                key=value token (any other output)
+ *   #models[*]               number of matches of a JSON path
+ *   $items                   lines starting with "- " (list outputs)
+ *   $output                  the whole output, trimmed
+ *
+ * Filters, applied left to right:
+ *   round, fixed:N           number with the language's decimal separator
+ *   bytes                    "512 byte", "1,5 MB"
+ *   duration                 seconds as "2 giorni e 3 ore" / "2 days and 3 hours"
+ *   map:0=sereno/3=coperto/else=variabile   lookup, "else" (or "*") is the fallback
+ *   plural:# grado/# gradi   one/many (or zero/one/many), "#" is the value
+ *   default:text             used when the field is missing
+ *
+ * A template only matches an output that has every field it uses (unless it
+ * has a default) with values its filters accept; render() returns false
+ * otherwise, so the caller can try the next template or the LLM.
+ */
+class ResponseTemplate {
+public:
+    enum class Language : uint8_t { Italian, English };
+
+    /** @return false (with a reason in error) for an unbalanced brace or unknown filter */
+    bool compile(const std::string& text, Language language, std::string* error = nullptr);
+
+    bool render(const std::string& output, std::string& out) const;
+
+    Language language() const { return language_; }
+    bool empty() const { return segments_.empty(); }
+
+    /** Crude guess from the user's words: English only when it clearly is */
+    static Language guessLanguage(const std::string& text);
+
+private:
+    enum class FilterKind : uint8_t { Round, Fixed, Bytes, Duration, Map, Plural, Default };
+
+    struct Filter {
+        FilterKind kind;
+        std::string arg;
+    };
+
+    struct Segment {
+        std::string text;               // Literal, or the field name of a placeholder
+        bool field = false;
+        std::vector<Filter> filters;
+    };
+
+    struct Fields;
+
+    bool applyFilter(const Filter& filter, std::string& value) const;
+    std::string formatNumber(double value, int decimals) const;
+
+    std::vector<Segment> segments_;
+    Language language_ = Language::Italian;
+};
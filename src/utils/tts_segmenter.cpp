@@ -0,0 +1,181 @@
+#include "utils/tts_segmenter.h"
+
+#include <cctype>
+#include <cstring>
+
+namespace {
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+bool isSentencePunct(char c) {
+    return c == '.' || c == '!' || c == '?';
+}
+
+bool isClosing(char c) {
+    return isSentencePunct(c) || c == '"' || c == '\'' || c == ')' || c == ']';
+}
+
+bool isMarkdown(char c) {
+    return c == '*' || c == '_' || c == '#' || c == '`';
+}
+
+bool isContinuationByte(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// Visible characters between begin and end, ignoring whitespace and markdown
+size_t visibleLength(const std::string& text, size_t begin, size_t end) {
+    size_t count = 0;
+    for (size_t i = begin; i < end; ++i) {
+        if (!isSpace(text[i]) && !isMarkdown(text[i]) && !isContinuationByte(text[i])) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+} // namespace
+
+TtsSegmenter::TtsSegmenter(size_t min_chars, size_t max_chars)
+    : min_chars_(min_chars), max_chars_(max_chars < 16 ? 16 : max_chars) {}
+
+void TtsSegmenter::reset() {
+    consumed_ = 0;
+    prefix_.clear();
+}
+
+void TtsSegmenter::update(const std::string& text, std::vector<std::string>& segments) {
+    split(text, false, segments);
+}
+
+void TtsSegmenter::finish(const std::string& text, std::vector<std::string>& segments) {
+    split(text, true, segments);
+}
+
+void TtsSegmenter::split(const std::string& text, bool final, std::vector<std::string>& segments) {
+    if (text.compare(0, prefix_.size(), prefix_) != 0) {
+        // Text was rewritten under us: what was spoken stays spoken, carry on from the same offset
+        if (consumed_ > text.size()) {
+            consumed_ = text.size();
+        }
+    }
+
+    size_t start = consumed_;
+    while (start < text.size()) {
+        size_t end = std::string::npos;
+        size_t search = start;
+        for (;;) {
+            const size_t candidate = findSentenceEnd(text, search, final);
+            if (candidate == std::string::npos) {
+                break;
+            }
+            end = candidate;
+            if (visibleLength(text, start, candidate) >= min_chars_) {
+                break;
+            }
+            search = candidate;  // Too short: merge with the next sentence
+            end = std::string::npos;
+        }
+
+        if (end == std::string::npos) {
+            if (text.size() - start > max_chars_) {
+                end = findClauseCut(text, start, start + max_chars_);
+            } else if (final) {
+                end = text.size();
+            } else {
+                break;  // Wait for more text
+            }
+        } else if (end - start > max_chars_) {
+            end = findClauseCut(text, start, start + max_chars_);
+        }
+
+        emit(text, start, end, segments);
+        start = end;
+    }
+
+    consumed_ = start;
+    prefix_.assign(text, 0, consumed_);
+}
+
+size_t TtsSegmenter::findSentenceEnd(const std::string& text, size_t from, bool final) const {
+    for (size_t i = from; i < text.size(); ++i) {
+        const char c = text[i];
+        if (c == '\n') {
+            return i + 1;
+        }
+
+        size_t j;
+        if (isSentencePunct(c)) {
+            j = i + 1;
+        } else if (c == '\xE2' && text.compare(i, 3, "\xE2\x80\xA6") == 0) {  // Unicode ellipsis
+            j = i + 3;
+        } else {
+            continue;
+        }
+
+        while (j < text.size() && isClosing(text[j])) {
+            ++j;
+        }
+        if (j == text.size()) {
+            // "3." could still become "3.5": only trust the end of the reply
+            return final ? j : std::string::npos;
+        }
+        if (isSpace(text[j])) {
+            return j;
+        }
+        i = j - 1;
+    }
+    return std::string::npos;
+}
+
+size_t TtsSegmenter::findClauseCut(const std::string& text, size_t from, size_t limit) const {
+    if (limit > text.size()) {
+        limit = text.size();
+    }
+    for (size_t i = limit; i > from + 1; --i) {
+        const char c = text[i - 1];
+        if ((c == ',' || c == ';' || c == ':') && i < text.size() && isSpace(text[i])) {
+            return i;
+        }
+    }
+    for (size_t i = limit; i > from + 1; --i) {
+        if (isSpace(text[i - 1])) {
+            return i;
+        }
+    }
+    // No break at all: hard cut, but never inside a UTF-8 sequence
+    while (limit > from + 1 && limit < text.size() && isContinuationByte(text[limit])) {
+        --limit;
+    }
+    return limit;
+}
+
+void TtsSegmenter::emit(const std::string& text, size_t begin, size_t end, std::vector<std::string>& segments) {
+    std::string segment;
+    segment.reserve(end - begin);
+    bool pending_space = false;
+    bool has_word = false;
+    for (size_t i = begin; i < end; ++i) {
+        const char c = text[i];
+        if (isMarkdown(c)) {
+            continue;
+        }
+        if (isSpace(c)) {
+            pending_space = !segment.empty();
+            continue;
+        }
+        if (pending_space) {
+            segment.push_back(' ');
+            pending_space = false;
+        }
+        segment.push_back(c);
+        if (isalnum(static_cast<unsigned char>(c)) || (static_cast<unsigned char>(c) & 0x80)) {
+            has_word = true;
+        }
+    }
+    if (has_word) {
+        segments.push_back(std::move(segment));
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Splits reply text into speakable segments as it grows
+ *
+ * update() takes the cumulative text of a reply (e.g. the streamed displayText)
+ * and emits every complete sentence not emitted before; finish() flushes the
+ * tail. A boundary is . ! ? ... or a newline followed by whitespace (closing
+ * quotes/brackets stay with their sentence), so decimals and URLs are not cut.
+ *
+ * Sentences shorter than min_chars are merged with the next one to avoid a TTS
+ * round trip per "Ok."; text running past max_chars without a sentence end is
+ * cut at the last clause boundary (, ; :) or space. Markdown markers (* _ # `)
+ * are dropped since the TTS engine would read them out.
+ */
+class TtsSegmenter {
+public:
+    explicit TtsSegmenter(size_t min_chars = 24, size_t max_chars = 220);
+
+    void reset();
+
+    /** Emit the segments completed by the latest cumulative text */
+    void update(const std::string& text, std::vector<std::string>& segments);
+
+    /** Emit everything left, including an unterminated last sentence */
+    void finish(const std::string& text, std::vector<std::string>& segments);
+
+    /** Bytes of the cumulative text already emitted */
+    size_t consumed() const { return consumed_; }
+
+private:
+    void split(const std::string& text, bool final, std::vector<std::string>& segments);
+    size_t findSentenceEnd(const std::string& text, size_t from, bool final) const;
+    size_t findClauseCut(const std::string& text, size_t from, size_t limit) const;
+    void emit(const std::string& text, size_t begin, size_t end, std::vector<std::string>& segments);
+
+    size_t min_chars_;
+    size_t max_chars_;
+    size_t consumed_ = 0;
+    std::string prefix_;   // Emitted part of the text, to detect rewrites
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+// Host stand-in for the parts of the Arduino core the firmware modules use
+// (native tests). Serial output is printed only when TEST_SERIAL is set.
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+inline unsigned long millis() {
+    return static_cast<unsigned long>(xTaskGetTickCount());
+}
+
+inline unsigned long micros() {
+    return static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - host_rtos::epoch()).count());
+}
+
+inline void delay(unsigned long ms) {
+    vTaskDelay(ms);
+}
+
+#define F(text) (text)
+
+class String {
+public:
+    String() = default;
+    String(const char* text) : value_(text ? text : "") {}
+    String(const std::string& text) : value_(text) {}
+    String(int value) : value_(std::to_string(value)) {}
+    String(unsigned int value) : value_(std::to_string(value)) {}
+    String(long value) : value_(std::to_string(value)) {}
+    String(unsigned long value) : value_(std::to_string(value)) {}
+
+    const char* c_str() const { return value_.c_str(); }
+    unsigned int length() const { return static_cast<unsigned int>(value_.size()); }
+    bool isEmpty() const { return value_.empty(); }
+    int indexOf(const char* text) const {
+        const size_t at = value_.find(text);
+        return at == std::string::npos ? -1 : static_cast<int>(at);
+    }
+    bool startsWith(const String& prefix) const { return value_.rfind(prefix.value_, 0) == 0; }
+    String substring(unsigned int from) const { return value_.substr(std::min<size_t>(from, value_.size())); }
+    String substring(unsigned int from, unsigned int to) const {
+        from = std::min<unsigned int>(from, length());
+        return value_.substr(from, std::max(from, to) - from);
+    }
+
+    String& operator+=(const String& other) { value_ += other.value_; return *this; }
+    String& operator+=(const char* other) { value_ += other ? other : ""; return *this; }
+    String& operator+=(char c) { value_ += c; return *this; }
+    friend String operator+(String a, const String& b) { return a += b; }
+    bool operator==(const String& other) const { return value_ == other.value_; }
+    bool operator!=(const String& other) const { return value_ != other.value_; }
+    bool operator<(const String& other) const { return value_ < other.value_; }
+    char operator[](unsigned int index) const { return index < value_.size() ? value_[index] : '\0'; }
+
+private:
+    std::string value_;
+};
+
+class HostSerial {
+public:
+    void begin(unsigned long) {}
+    size_t print(const char* text) { return write(text, std::strlen(text)); }
+    size_t print(const String& text) { return print(text.c_str()); }
+    size_t println(const char* text = "") { return print(text) + print("\n"); }
+    size_t println(const String& text) { return println(text.c_str()); }
+    size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        char line[512];
+        va_list args;
+        va_start(args, fmt);
+        const int n = vsnprintf(line, sizeof(line), fmt, args);
+        va_end(args);
+        return n > 0 ? print(line) : 0;
+    }
+    void flush() {}
+
+private:
+    size_t write(const char* data, size_t length) {
+        static const bool enabled = std::getenv("TEST_SERIAL") != nullptr;
+        return enabled ? fwrite(data, 1, length, stdout) : length;
+    }
+};
+
+inline HostSerial Serial;
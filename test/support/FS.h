@@ -0,0 +1,182 @@
+#pragma once
+
+// Host stand-in for the Arduino fs::FS / fs::File API (native tests). An FS is
+// rooted at a host directory; paths are absolute within it ("/tts/a.wav").
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File {
+public:
+    File() = default;
+
+    explicit operator bool() const { return impl_ && (impl_->file || impl_->directory); }
+
+    size_t write(const uint8_t* data, size_t length) {
+        if (!impl_ || !impl_->file || !impl_->writable) {
+            return 0;
+        }
+        return fwrite(data, 1, length, impl_->file);
+    }
+    size_t write(uint8_t byte) { return write(&byte, 1); }
+    size_t print(const char* text) { return write(reinterpret_cast<const uint8_t*>(text), strlen(text)); }
+
+    size_t read(uint8_t* data, size_t length) {
+        return impl_ && impl_->file ? fread(data, 1, length, impl_->file) : 0;
+    }
+    int read() {
+        uint8_t byte;
+        return read(&byte, 1) == 1 ? byte : -1;
+    }
+    size_t readBytes(char* data, size_t length) { return read(reinterpret_cast<uint8_t*>(data), length); }
+    int available() { return impl_ && impl_->file ? static_cast<int>(size() - position()) : 0; }
+
+    bool seek(uint32_t position, SeekMode mode = SeekSet) {
+        return impl_ && impl_->file && fseek(impl_->file, position, mode) == 0;
+    }
+    size_t position() const { return impl_ && impl_->file ? static_cast<size_t>(ftell(impl_->file)) : 0; }
+    size_t size() const {
+        if (!impl_ || !impl_->file) {
+            return 0;
+        }
+        fflush(impl_->file);
+        struct stat info;
+        return fstat(fileno(impl_->file), &info) == 0 ? static_cast<size_t>(info.st_size) : 0;
+    }
+    void flush() {
+        if (impl_ && impl_->file) {
+            fflush(impl_->file);
+        }
+    }
+
+    void close() {
+        if (impl_ && impl_->file) {
+            fclose(impl_->file);
+            impl_->file = nullptr;
+        }
+        if (impl_) {
+            impl_->directory = false;
+        }
+    }
+
+    const char* name() const { return impl_ ? impl_->name.c_str() : ""; }
+    const char* path() const { return impl_ ? impl_->path.c_str() : ""; }
+    bool isDirectory() const { return impl_ && impl_->directory; }
+    time_t getLastWrite() const {
+        struct stat info;
+        return impl_ && stat((impl_->root + impl_->path).c_str(), &info) == 0 ? info.st_mtime : 0;
+    }
+
+    File openNextFile(const char* mode = FILE_READ) {
+        if (!impl_ || !impl_->directory || impl_->next >= impl_->entries.size()) {
+            return File();
+        }
+        const std::string entry = impl_->entries[impl_->next++];
+        const std::string path = impl_->path == "/" ? "/" + entry : impl_->path + "/" + entry;
+        return File::open(impl_->root, path, mode);
+    }
+
+    static File open(const std::string& root, const std::string& path, const char* mode) {
+        File result;
+        auto impl = std::make_shared<Impl>();
+        impl->root = root;
+        impl->path = path;
+        impl->name = path.substr(path.rfind('/') + 1);
+        const std::string host = root + path;
+        struct stat info;
+        if (stat(host.c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+            DIR* dir = opendir(host.c_str());
+            if (!dir) {
+                return result;
+            }
+            while (dirent* entry = readdir(dir)) {
+                if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+                    impl->entries.emplace_back(entry->d_name);
+                }
+            }
+            closedir(dir);
+            std::sort(impl->entries.begin(), impl->entries.end());
+            impl->directory = true;
+        } else {
+            const std::string host_mode = std::string(mode) + "b";
+            impl->file = fopen(host.c_str(), host_mode.c_str());
+            impl->writable = mode[0] != 'r';
+            if (!impl->file) {
+                return result;
+            }
+        }
+        result.impl_ = impl;
+        return result;
+    }
+
+private:
+    struct Impl {
+        ~Impl() {
+            if (file) {
+                fclose(file);
+            }
+        }
+        std::string root;
+        std::string path;
+        std::string name;
+        FILE* file = nullptr;
+        bool writable = false;
+        bool directory = false;
+        std::vector<std::string> entries;
+        size_t next = 0;
+    };
+
+    std::shared_ptr<Impl> impl_;
+};
+
+class FS {
+public:
+    explicit FS(std::string root) : root_(std::move(root)) {}
+
+    File open(const char* path, const char* mode = FILE_READ, bool create = false) {
+        (void)create;
+        return File::open(root_, path, mode);
+    }
+    File open(const std::string& path, const char* mode = FILE_READ) { return open(path.c_str(), mode); }
+
+    bool exists(const char* path) {
+        struct stat info;
+        return stat((root_ + path).c_str(), &info) == 0;
+    }
+    bool exists(const std::string& path) { return exists(path.c_str()); }
+    bool remove(const char* path) { return ::unlink((root_ + path).c_str()) == 0; }
+    bool remove(const std::string& path) { return remove(path.c_str()); }
+    bool rename(const char* from, const char* to) { return ::rename((root_ + from).c_str(), (root_ + to).c_str()) == 0; }
+    bool rename(const std::string& from, const std::string& to) { return rename(from.c_str(), to.c_str()); }
+    bool mkdir(const char* path) { return ::mkdir((root_ + path).c_str(), 0755) == 0; }
+    bool mkdir(const std::string& path) { return mkdir(path.c_str()); }
+    bool rmdir(const char* path) { return ::rmdir((root_ + path).c_str()) == 0; }
+
+    const std::string& root() const { return root_; }
+
+protected:
+    std::string root_;
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
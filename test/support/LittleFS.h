@@ -0,0 +1,21 @@
+#pragma once
+
+// Host stand-in for the LittleFS global (native tests). It is an fs::FS with
+// no root until a test mounts it on a host directory.
+
+#include <string>
+
+#include "FS.h"
+
+namespace fs {
+
+class LittleFSFS : public FS {
+public:
+    LittleFSFS() : FS("") {}
+
+    void mount(const std::string& root) { root_ = root; }
+};
+
+} // namespace fs
+
+inline fs::LittleFSFS LittleFS;
@@ -0,0 +1,42 @@
+#pragma once
+
+// Host stand-in for esp_heap_caps.h (native tests): every capability is the C heap
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#define MALLOC_CAP_EXEC (1 << 0)
+#define MALLOC_CAP_32BIT (1 << 1)
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+namespace host_heap {
+// The next failNext() heap_caps_malloc/calloc/realloc calls return nullptr
+inline int& failNext() {
+    static int count = 0;
+    return count;
+}
+
+inline bool fail() {
+    if (failNext() <= 0) {
+        return false;
+    }
+    --failNext();
+    return true;
+}
+} // namespace host_heap
+
+inline void* heap_caps_malloc(size_t size, uint32_t) { return host_heap::fail() ? nullptr : std::malloc(size); }
+inline void* heap_caps_calloc(size_t count, size_t size, uint32_t) {
+    return host_heap::fail() ? nullptr : std::calloc(count, size);
+}
+inline void* heap_caps_realloc(void* ptr, size_t size, uint32_t) {
+    return host_heap::fail() ? nullptr : std::realloc(ptr, size);
+}
+inline void heap_caps_free(void* ptr) { std::free(ptr); }
+inline size_t heap_caps_get_free_size(uint32_t) { return 8 * 1024 * 1024; }
+inline size_t heap_caps_get_largest_free_block(uint32_t) { return 4 * 1024 * 1024; }
@@ -0,0 +1,633 @@
+#pragma once
+
+// Host stand-in for esp_http_client (native tests), over POSIX sockets.
+//
+// Follows the IDF 4.4 client where the firmware depends on it:
+// - open() connects only when not connected, then always sends the request head
+// - fetch_headers() returns -1 on timeout (a later call continues), 0 for
+//   chunked bodies, else the Content-Length
+// - read() fills the buffer until it is full or the body is complete; on a
+//   timeout it returns what it has (0 if nothing)
+// - perform() drains the body, then closes unless the response is keep-alive
+// - set_url() closes the connection when the host changes
+// - open() leaves the previous response's state in place, so
+//   is_complete_data_received() describes that response until fetch_headers()
+// Bytes left unread on a kept connection are seen by the next response, as on
+// the device.
+//
+// https:// URLs go over OpenSSL, capped at TLS 1.2 like mbedTLS on the device,
+// without certificate checks (the pool skips them too). With
+// save_client_session the session of the last handshake is offered on the next
+// connect, as esp-tls does with CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS.
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/ssl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <strings.h>
+#include <utility>
+#include <vector>
+
+#include "esp_err.h"
+
+typedef enum {
+    HTTP_METHOD_GET = 0,
+    HTTP_METHOD_POST,
+    HTTP_METHOD_PUT,
+    HTTP_METHOD_PATCH,
+    HTTP_METHOD_DELETE,
+    HTTP_METHOD_HEAD,
+    HTTP_METHOD_MAX,
+} esp_http_client_method_t;
+
+typedef enum {
+    HTTP_TRANSPORT_UNKNOWN = 0,
+    HTTP_TRANSPORT_OVER_TCP,
+    HTTP_TRANSPORT_OVER_SSL,
+} esp_http_client_transport_t;
+
+typedef struct {
+    const char* url = nullptr;
+    const char* host = nullptr;
+    int port = 0;
+    const char* path = nullptr;
+    const char* cert_pem = nullptr;
+    esp_http_client_method_t method = HTTP_METHOD_GET;
+    int timeout_ms = 5000;
+    bool disable_auto_redirect = false;
+    void* user_data = nullptr;
+    esp_http_client_transport_t transport_type = HTTP_TRANSPORT_UNKNOWN;
+    int buffer_size = 512;
+    int buffer_size_tx = 512;
+    bool is_async = false;
+    bool use_global_ca_store = false;
+    bool skip_cert_common_name_check = false;
+    bool keep_alive_enable = false;
+    int keep_alive_idle = 5;
+    int keep_alive_interval = 5;
+    int keep_alive_count = 3;
+    bool save_client_session = false;
+} esp_http_client_config_t;
+
+namespace host_http {
+
+/** Counters for tests: TCP connections opened, requests sent, TLS handshakes */
+struct Stats {
+    std::atomic<uint32_t> connects{0};
+    std::atomic<uint32_t> requests{0};
+    std::atomic<uint32_t> handshakes{0};
+    std::atomic<uint32_t> resumed{0};       // Handshakes that resumed a saved session
+};
+
+inline Stats& stats() {
+    static Stats instance;
+    return instance;
+}
+
+struct Url {
+    std::string scheme = "http";
+    std::string host;
+    int port = 80;
+    std::string path = "/";
+};
+
+inline Url parseUrl(const std::string& url) {
+    Url parsed;
+    size_t host_start = 0;
+    const size_t scheme_end = url.find("://");
+    if (scheme_end != std::string::npos) {
+        parsed.scheme = url.substr(0, scheme_end);
+        host_start = scheme_end + 3;
+    }
+    parsed.port = parsed.scheme == "https" ? 443 : 80;
+    size_t host_end = url.find_first_of("/?#", host_start);
+    if (host_end == std::string::npos) {
+        host_end = url.size();
+    } else {
+        parsed.path = url.substr(host_end);
+        if (parsed.path[0] != '/') {
+            parsed.path.insert(0, "/");
+        }
+    }
+    std::string authority = url.substr(host_start, host_end - host_start);
+    const size_t colon = authority.rfind(':');
+    if (colon != std::string::npos) {
+        parsed.port = std::atoi(authority.c_str() + colon + 1);
+        authority.erase(colon);
+    }
+    parsed.host = authority;
+    return parsed;
+}
+
+} // namespace host_http
+
+struct esp_http_client {
+    host_http::Url url;
+    esp_http_client_method_t method = HTTP_METHOD_GET;
+    int timeout_ms = 5000;
+    std::vector<std::pair<std::string, std::string>> headers;
+    const char* post_data = nullptr;
+    int post_len = 0;
+
+    bool save_session = false;
+    SSL_SESSION* session = nullptr; // Offered on the next TLS connect
+
+    int fd = -1;
+    SSL* ssl = nullptr;
+    std::string rx;                 // Received, not yet consumed
+
+    // Response being read
+    bool headers_done = false;
+    int status = 0;
+    int content_length = -1;
+    bool chunked = false;
+    bool until_close = false;       // Neither Content-Length nor chunked
+    bool keep_alive = true;
+    bool complete = false;
+    long body_left = 0;             // Content-Length bytes still to read
+    long chunk_left = 0;            // Bytes left in the current chunk
+    bool chunk_crlf = false;        // CRLF after chunk data still to skip
+};
+
+typedef struct esp_http_client* esp_http_client_handle_t;
+
+namespace host_http {
+
+inline SSL_CTX* tlsContext() {
+    static SSL_CTX* context = [] {
+        signal(SIGPIPE, SIG_IGN);  // SSL_write() cannot pass MSG_NOSIGNAL to a dead warm connection
+        SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+        SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, nullptr);
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);  // Only the handle's own session is offered
+        return ctx;
+    }();
+    return context;
+}
+
+inline int remainingMs(std::chrono::steady_clock::time_point start, int timeout_ms) {
+    const auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    return std::max(0, timeout_ms - static_cast<int>(waited));
+}
+
+/** Wait for the socket as OpenSSL asked; false on timeout or a hard error */
+inline bool waitTls(esp_http_client_handle_t client, int result, std::chrono::steady_clock::time_point start) {
+    const int error = SSL_get_error(client->ssl, result);
+    if (error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE) {
+        return false;
+    }
+    pollfd pfd = {client->fd, static_cast<short>(error == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT), 0};
+    return ::poll(&pfd, 1, remainingMs(start, client->timeout_ms)) == 1;
+}
+
+inline bool handshake(esp_http_client_handle_t client) {
+    client->ssl = SSL_new(tlsContext());
+    SSL_set_fd(client->ssl, client->fd);
+    SSL_set_tlsext_host_name(client->ssl, client->url.host.c_str());
+    if (client->save_session && client->session) {
+        SSL_set_session(client->ssl, client->session);
+    }
+    const auto start = std::chrono::steady_clock::now();
+    int result;
+    while ((result = SSL_connect(client->ssl)) != 1) {
+        if (!waitTls(client, result, start)) {
+            return false;
+        }
+    }
+    ++stats().handshakes;
+    if (SSL_session_reused(client->ssl)) {
+        ++stats().resumed;
+    }
+    if (client->save_session) {
+        if (client->session) {
+            SSL_SESSION_free(client->session);
+        }
+        client->session = SSL_get1_session(client->ssl);
+    }
+    return true;
+}
+
+inline void closeSocket(esp_http_client_handle_t client) {
+    if (client->ssl) {
+        SSL_shutdown(client->ssl);  // close_notify: without it OpenSSL drops the session
+        SSL_free(client->ssl);
+        client->ssl = nullptr;
+    }
+    if (client->fd >= 0) {
+        ::close(client->fd);
+        client->fd = -1;
+    }
+    client->rx.clear();
+    client->headers_done = false;
+    client->complete = false;
+}
+
+inline bool connectSocket(esp_http_client_handle_t client) {
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    const std::string port = std::to_string(client->url.port);
+    if (getaddrinfo(client->url.host.c_str(), port.c_str(), &hints, &result) != 0 || !result) {
+        return false;
+    }
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        freeaddrinfo(result);
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    int rc = ::connect(fd, result->ai_addr, result->ai_addrlen);
+    freeaddrinfo(result);
+    if (rc != 0 && errno == EINPROGRESS) {
+        pollfd pfd = {fd, POLLOUT, 0};
+        int error = 0;
+        socklen_t length = sizeof(error);
+        rc = (::poll(&pfd, 1, client->timeout_ms) == 1 &&
+              getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0) ? 0 : -1;
+    }
+    if (rc != 0) {
+        ::close(fd);
+        return false;
+    }
+    client->fd = fd;
+    client->rx.clear();
+    ++stats().connects;
+    if (client->url.scheme == "https" && !handshake(client)) {
+        closeSocket(client);
+        return false;
+    }
+    return true;
+}
+
+inline bool sendAll(esp_http_client_handle_t client, const char* data, size_t length) {
+    size_t sent = 0;
+    if (client->ssl) {
+        const auto start = std::chrono::steady_clock::now();
+        while (sent < length) {
+            const int n = SSL_write(client->ssl, data + sent, static_cast<int>(length - sent));
+            if (n > 0) {
+                sent += n;
+            } else if (!waitTls(client, n, start)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    while (sent < length) {
+        const ssize_t n = ::send(client->fd, data + sent, length - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            pollfd pfd = {client->fd, POLLOUT, 0};
+            if (::poll(&pfd, 1, client->timeout_ms) == 1) {
+                continue;
+            }
+        }
+        return false;
+    }
+    return true;
+}
+
+/** Receive more bytes into rx: >0 bytes, 0 on timeout, -1 on EOF or error */
+inline int fill(esp_http_client_handle_t client) {
+    if (client->fd < 0) {
+        return -1;
+    }
+    char buffer[4096];
+    if (client->ssl) {
+        const auto start = std::chrono::steady_clock::now();
+        while (true) {
+            const int n = SSL_read(client->ssl, buffer, sizeof(buffer));
+            if (n > 0) {
+                client->rx.append(buffer, n);
+                return n;
+            }
+            const int error = SSL_get_error(client->ssl, n);
+            if (error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE) {
+                return -1;
+            }
+            if (!waitTls(client, n, start)) {
+                return 0;
+            }
+        }
+    }
+    pollfd pfd = {client->fd, POLLIN, 0};
+    const int ready = ::poll(&pfd, 1, client->timeout_ms);
+    if (ready == 0) {
+        return 0;
+    }
+    const ssize_t n = ready > 0 ? ::recv(client->fd, buffer, sizeof(buffer), 0) : -1;
+    if (n > 0) {
+        client->rx.append(buffer, n);
+        return static_cast<int>(n);
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 0;
+    }
+    return -1;
+}
+
+inline bool parseHead(esp_http_client_handle_t client, const std::string& head) {
+    size_t line_end = head.find("\r\n");
+    const std::string status_line = head.substr(0, line_end);
+    if (status_line.compare(0, 5, "HTTP/") != 0 || status_line.size() < 12) {
+        return false;
+    }
+    client->status = std::atoi(status_line.c_str() + 9);
+    client->keep_alive = status_line.compare(0, 8, "HTTP/1.0") != 0;
+    client->content_length = -1;
+    client->chunked = false;
+    while (line_end != std::string::npos && line_end + 2 < head.size()) {
+        const size_t start = line_end + 2;
+        line_end = head.find("\r\n", start);
+        const std::string line = head.substr(start, line_end == std::string::npos ? std::string::npos : line_end - start);
+        const size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        const std::string key = line.substr(0, colon);
+        std::string value = line.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(' '));
+        if (strcasecmp(key.c_str(), "Content-Length") == 0) {
+            client->content_length = std::atoi(value.c_str());
+        } else if (strcasecmp(key.c_str(), "Transfer-Encoding") == 0) {
+            client->chunked = strcasecmp(value.c_str(), "chunked") == 0;
+        } else if (strcasecmp(key.c_str(), "Connection") == 0) {
+            client->keep_alive = strcasecmp(value.c_str(), "close") != 0;
+        }
+    }
+    client->until_close = !client->chunked && client->content_length < 0;
+    client->body_left = client->content_length > 0 ? client->content_length : 0;
+    client->chunk_left = 0;
+    client->chunk_crlf = false;
+    client->complete = !client->chunked && client->content_length == 0;
+    return true;
+}
+
+/** Decode body bytes already received: bytes copied, 0 if more input is needed */
+inline int decode(esp_http_client_handle_t client, char* buffer, int length) {
+    if (!client->chunked) {
+        size_t n = std::min(client->rx.size(), static_cast<size_t>(length));
+        if (!client->until_close) {
+            n = std::min(n, static_cast<size_t>(client->body_left));
+            client->body_left -= n;
+            client->complete = client->body_left == 0;
+        }
+        memcpy(buffer, client->rx.data(), n);
+        client->rx.erase(0, n);
+        return static_cast<int>(n);
+    }
+
+    while (!client->complete) {
+        if (client->chunk_crlf) {
+            if (client->rx.size() < 2) {
+                return 0;
+            }
+            client->rx.erase(0, 2);
+            client->chunk_crlf = false;
+        }
+        if (client->chunk_left > 0) {
+            const size_t n = std::min({client->rx.size(), static_cast<size_t>(length),
+                                       static_cast<size_t>(client->chunk_left)});
+            memcpy(buffer, client->rx.data(), n);
+            client->rx.erase(0, n);
+            client->chunk_left -= n;
+            client->chunk_crlf = client->chunk_left == 0;
+            return static_cast<int>(n);
+        }
+        const size_t line_end = client->rx.find("\r\n");
+        if (line_end == std::string::npos) {
+            return 0;
+        }
+        const long size = std::strtol(client->rx.c_str(), nullptr, 16);
+        if (size == 0) {
+            // Last chunk: skip (empty) trailers
+            const size_t end = client->rx.find("\r\n\r\n");
+            if (end == std::string::npos) {
+                return 0;
+            }
+            client->rx.erase(0, end + 4);
+            client->complete = true;
+            return 0;
+        }
+        client->rx.erase(0, line_end + 2);
+        client->chunk_left = size;
+    }
+    return 0;
+}
+
+inline const char* methodName(esp_http_client_method_t method) {
+    static const char* const names[] = {"GET", "POST", "PUT", "PATCH", "DELETE", "HEAD"};
+    return method < HTTP_METHOD_MAX ? names[method] : "GET";
+}
+
+} // namespace host_http
+
+inline esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t* config) {
+    if (!config || !config->url) {
+        return nullptr;
+    }
+    esp_http_client_handle_t client = new esp_http_client();
+    client->url = host_http::parseUrl(config->url);
+    client->method = config->method;
+    client->timeout_ms = config->timeout_ms;
+    client->save_session = config->save_client_session;
+    return client;
+}
+
+inline esp_err_t esp_http_client_close(esp_http_client_handle_t client) {
+    host_http::closeSocket(client);
+    return ESP_OK;
+}
+
+inline esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client) {
+    if (client) {
+        host_http::closeSocket(client);
+        if (client->session) {
+            SSL_SESSION_free(client->session);
+        }
+        delete client;
+    }
+    return ESP_OK;
+}
+
+inline esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char* url) {
+    const host_http::Url parsed = host_http::parseUrl(url);
+    if (parsed.scheme != client->url.scheme || parsed.host != client->url.host || parsed.port != client->url.port) {
+        host_http::closeSocket(client);
+    }
+    client->url = parsed;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method) {
+    client->method = method;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_http_client_set_timeout_ms(esp_http_client_handle_t client, int timeout_ms) {
+    client->timeout_ms = timeout_ms;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char* key, const char* value) {
+    for (auto& header : client->headers) {
+        if (strcasecmp(header.first.c_str(), key) == 0) {
+            header.second = value;
+            return ESP_OK;
+        }
+    }
+    client->headers.emplace_back(key, value);
+    return ESP_OK;
+}
+
+inline esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char* key) {
+    for (auto it = client->headers.begin(); it != client->headers.end(); ++it) {
+        if (strcasecmp(it->first.c_str(), key) == 0) {
+            client->headers.erase(it);
+            break;
+        }
+    }
+    return ESP_OK;
+}
+
+inline esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char* data, int len) {
+    client->post_data = data;
+    client->post_len = data ? len : 0;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len) {
+    if (client->fd < 0 && !host_http::connectSocket(client)) {
+        return ESP_ERR_HTTP_CONNECT;
+    }
+    std::string head = std::string(host_http::methodName(client->method)) + " " + client->url.path + " HTTP/1.1\r\n";
+    head += "Host: " + client->url.host + ":" + std::to_string(client->url.port) + "\r\n";
+    head += "User-Agent: ESP32 HTTP Client/1.0\r\n";
+    for (const auto& header : client->headers) {
+        head += header.first + ": " + header.second + "\r\n";
+    }
+    head += write_len >= 0 ? "Content-Length: " + std::to_string(write_len) + "\r\n" : "Transfer-Encoding: chunked\r\n";
+    head += "\r\n";
+
+    // The previous response's state (headers_done, complete, status) is left
+    // as it was until fetch_headers() parses the new one, as in IDF
+    ++host_http::stats().requests;
+    return host_http::sendAll(client, head.data(), head.size()) ? ESP_OK : ESP_ERR_HTTP_WRITE_DATA;
+}
+
+inline int esp_http_client_write(esp_http_client_handle_t client, const char* buffer, int len) {
+    if (client->fd < 0) {
+        return -1;
+    }
+    return host_http::sendAll(client, buffer, len) ? len : -1;
+}
+
+inline int esp_http_client_fetch_headers(esp_http_client_handle_t client) {
+    size_t end;
+    while ((end = client->rx.find("\r\n\r\n")) == std::string::npos) {
+        if (host_http::fill(client) <= 0) {
+            return -1;
+        }
+    }
+    const std::string head = client->rx.substr(0, end + 2);
+    client->rx.erase(0, end + 4);
+    if (!host_http::parseHead(client, head)) {
+        return -1;
+    }
+    client->headers_done = true;
+    return client->chunked ? 0 : std::max(client->content_length, 0);
+}
+
+inline int esp_http_client_read(esp_http_client_handle_t client, char* buffer, int len) {
+    if (!client->headers_done) {
+        return -1;
+    }
+    int total = 0;
+    while (total < len && !client->complete) {
+        const int n = host_http::decode(client, buffer + total, len - total);
+        if (n > 0) {
+            total += n;
+            continue;
+        }
+        if (client->complete) {
+            break;
+        }
+        const int received = host_http::fill(client);
+        if (received == 0) {
+            break;  // Timeout: return what there is
+        }
+        if (received < 0) {
+            if (client->until_close) {
+                client->complete = true;
+            } else if (total == 0) {
+                return -1;
+            }
+            break;
+        }
+    }
+    return total;
+}
+
+inline int esp_http_client_get_status_code(esp_http_client_handle_t client) {
+    return client->status;
+}
+
+inline int64_t esp_http_client_get_content_length(esp_http_client_handle_t client) {
+    return client->chunked ? -1 : client->content_length;
+}
+
+inline bool esp_http_client_is_chunked_response(esp_http_client_handle_t client) {
+    return client->chunked;
+}
+
+inline bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client) {
+    return client->headers_done && client->complete;
+}
+
+inline esp_err_t esp_http_client_perform(esp_http_client_handle_t client) {
+    esp_err_t err = esp_http_client_open(client, client->post_len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (client->post_len > 0 && esp_http_client_write(client, client->post_data, client->post_len) < 0) {
+        host_http::closeSocket(client);
+        return ESP_ERR_HTTP_WRITE_DATA;
+    }
+    if (esp_http_client_fetch_headers(client) < 0) {
+        host_http::closeSocket(client);
+        return ESP_ERR_HTTP_FETCH_HEADER;
+    }
+    char drain[512];
+    while (!client->complete) {
+        if (esp_http_client_read(client, drain, sizeof(drain)) <= 0 && !client->complete) {
+            host_http::closeSocket(client);
+            return ESP_FAIL;
+        }
+    }
+    if (!client->keep_alive) {
+        host_http::closeSocket(client);
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+// Host stand-in for esp_timer.h (native tests): microseconds since start
+
+#include <chrono>
+#include <cstdint>
+
+#include "freertos/task.h"
+
+inline int64_t esp_timer_get_time() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - host_rtos::epoch()).count();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS types used by the firmware (native tests).
+// Ticks are milliseconds; critical sections share one recursive mutex.
+
+#include <cstdint>
+#include <mutex>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY 0xffffffffUL
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+struct portMUX_TYPE {
+    int unused;
+};
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+namespace host_rtos {
+inline std::recursive_mutex& criticalMutex() {
+    static std::recursive_mutex mutex;
+    return mutex;
+}
+} // namespace host_rtos
+
+#define portENTER_CRITICAL(mux) ((void)(mux), host_rtos::criticalMutex().lock())
+#define portEXIT_CRITICAL(mux) ((void)(mux), host_rtos::criticalMutex().unlock())
+#define taskENTER_CRITICAL(mux) portENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL(mux) portEXIT_CRITICAL(mux)
@@ -0,0 +1,98 @@
+#pragma once
+
+// Host stand-in for FreeRTOS semaphores and mutexes (native tests): a counter
+// guarded by a std::mutex. Recursive mutexes track the owning thread.
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "freertos/FreeRTOS.h"
+
+struct HostSemaphore {
+    std::mutex mutex;
+    std::condition_variable changed;
+    UBaseType_t count = 0;
+    UBaseType_t max = 1;
+    std::thread::id owner;          // Recursive mutexes
+    UBaseType_t depth = 0;
+};
+
+typedef HostSemaphore* SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial) {
+    SemaphoreHandle_t semaphore = new HostSemaphore();
+    semaphore->max = max;
+    semaphore->count = initial;
+    return semaphore;
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+inline void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    delete semaphore;
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(semaphore->mutex);
+    auto available = [semaphore]() { return semaphore->count > 0; };
+    if (ticks == portMAX_DELAY) {
+        semaphore->changed.wait(lock, available);
+    } else if (!semaphore->changed.wait_for(lock, std::chrono::milliseconds(ticks), available)) {
+        return pdFALSE;
+    }
+    --semaphore->count;
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    std::lock_guard<std::mutex> lock(semaphore->mutex);
+    if (semaphore->count >= semaphore->max) {
+        return pdFALSE;
+    }
+    ++semaphore->count;
+    semaphore->changed.notify_one();
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    {
+        std::lock_guard<std::mutex> lock(semaphore->mutex);
+        if (semaphore->depth > 0 && semaphore->owner == std::this_thread::get_id()) {
+            ++semaphore->depth;
+            return pdTRUE;
+        }
+    }
+    if (xSemaphoreTake(semaphore, ticks) != pdTRUE) {
+        return pdFALSE;
+    }
+    std::lock_guard<std::mutex> lock(semaphore->mutex);
+    semaphore->owner = std::this_thread::get_id();
+    semaphore->depth = 1;
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore) {
+    {
+        std::lock_guard<std::mutex> lock(semaphore->mutex);
+        if (semaphore->depth == 0 || semaphore->owner != std::this_thread::get_id()) {
+            return pdFALSE;
+        }
+        if (--semaphore->depth > 0) {
+            return pdTRUE;
+        }
+        semaphore->owner = std::thread::id();
+    }
+    return xSemaphoreGive(semaphore);
+}
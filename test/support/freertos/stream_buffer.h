@@ -0,0 +1,130 @@
+#pragma once
+
+// Host stand-in for FreeRTOS stream buffers (native tests): a byte ring
+// guarded by a mutex, with blocking send/receive bounded by the tick timeout.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+#include "freertos/FreeRTOS.h"
+
+struct HostStreamBuffer {
+    std::mutex mutex;
+    std::condition_variable changed;
+    uint8_t* storage = nullptr;
+    size_t capacity = 0;
+    size_t head = 0;            // Next byte to receive
+    size_t count = 0;
+    size_t trigger = 1;
+    bool owned = false;         // Created by xStreamBufferCreate()
+};
+
+typedef HostStreamBuffer StaticStreamBuffer_t;
+typedef HostStreamBuffer* StreamBufferHandle_t;
+
+namespace host_rtos {
+template <typename Predicate>
+bool waitFor(HostStreamBuffer* buffer, std::unique_lock<std::mutex>& lock, TickType_t ticks, Predicate ready) {
+    if (ticks == portMAX_DELAY) {
+        buffer->changed.wait(lock, ready);
+        return true;
+    }
+    return buffer->changed.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+} // namespace host_rtos
+
+inline StreamBufferHandle_t xStreamBufferCreateStatic(size_t size, size_t trigger, uint8_t* storage,
+                                                      StaticStreamBuffer_t* buffer) {
+    if (!storage || !buffer || size == 0) {
+        return nullptr;
+    }
+    HostStreamBuffer* handle = new (buffer) HostStreamBuffer();
+    handle->storage = storage;
+    handle->capacity = size;
+    handle->trigger = std::max<size_t>(trigger, 1);
+    return handle;
+}
+
+inline StreamBufferHandle_t xStreamBufferCreate(size_t size, size_t trigger) {
+    auto* storage = static_cast<uint8_t*>(std::malloc(size + 1));
+    HostStreamBuffer* handle = xStreamBufferCreateStatic(size, trigger, storage, new HostStreamBuffer());
+    handle->owned = true;
+    return handle;
+}
+
+inline void vStreamBufferDelete(StreamBufferHandle_t buffer) {
+    if (!buffer) {
+        return;
+    }
+    if (buffer->owned) {
+        std::free(buffer->storage);
+        delete buffer;
+    } else {
+        buffer->~HostStreamBuffer();
+    }
+}
+
+inline size_t xStreamBufferSend(StreamBufferHandle_t buffer, const void* data, size_t length, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(buffer->mutex);
+    host_rtos::waitFor(buffer, lock, ticks, [buffer]() { return buffer->count < buffer->capacity; });
+    const size_t n = std::min(length, buffer->capacity - buffer->count);
+    const auto* in = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < n; ++i) {
+        buffer->storage[(buffer->head + buffer->count + i) % buffer->capacity] = in[i];
+    }
+    buffer->count += n;
+    if (n > 0) {
+        buffer->changed.notify_all();
+    }
+    return n;
+}
+
+inline size_t xStreamBufferReceive(StreamBufferHandle_t buffer, void* data, size_t length, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(buffer->mutex);
+    host_rtos::waitFor(buffer, lock, ticks, [buffer, length]() {
+        return buffer->count >= std::min(buffer->trigger, length);
+    });
+    const size_t n = std::min(length, buffer->count);
+    auto* out = static_cast<uint8_t*>(data);
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = buffer->storage[(buffer->head + i) % buffer->capacity];
+    }
+    buffer->head = (buffer->head + n) % buffer->capacity;
+    buffer->count -= n;
+    if (n > 0) {
+        buffer->changed.notify_all();
+    }
+    return n;
+}
+
+inline size_t xStreamBufferBytesAvailable(StreamBufferHandle_t buffer) {
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    return buffer->count;
+}
+
+inline size_t xStreamBufferSpacesAvailable(StreamBufferHandle_t buffer) {
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    return buffer->capacity - buffer->count;
+}
+
+inline BaseType_t xStreamBufferIsEmpty(StreamBufferHandle_t buffer) {
+    return xStreamBufferBytesAvailable(buffer) == 0 ? pdTRUE : pdFALSE;
+}
+
+inline BaseType_t xStreamBufferIsFull(StreamBufferHandle_t buffer) {
+    return xStreamBufferSpacesAvailable(buffer) == 0 ? pdTRUE : pdFALSE;
+}
+
+inline BaseType_t xStreamBufferReset(StreamBufferHandle_t buffer) {
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    buffer->head = 0;
+    buffer->count = 0;
+    buffer->changed.notify_all();
+    return pdPASS;
+}
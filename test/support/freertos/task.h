@@ -0,0 +1,56 @@
+#pragma once
+
+// Host stand-in for FreeRTOS tasks (native tests): each task is a detached
+// std::thread; vTaskDelete(nullptr) unwinds the calling task.
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void*);
+typedef struct HostTask* TaskHandle_t;
+
+namespace host_rtos {
+struct TaskExit {};
+
+inline std::chrono::steady_clock::time_point epoch() {
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return start;
+}
+} // namespace host_rtos
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t entry, const char*, uint32_t, void* param,
+                                          UBaseType_t, TaskHandle_t* handle, BaseType_t) {
+    std::thread([entry, param]() {
+        try {
+            entry(param);
+        } catch (const host_rtos::TaskExit&) {
+        }
+    }).detach();
+    if (handle) {
+        *handle = reinterpret_cast<TaskHandle_t>(1);
+    }
+    return pdPASS;
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t entry, const char* name, uint32_t stack, void* param,
+                              UBaseType_t priority, TaskHandle_t* handle) {
+    return xTaskCreatePinnedToCore(entry, name, stack, param, priority, handle, 0);
+}
+
+inline void vTaskDelete(TaskHandle_t task) {
+    if (!task) {
+        throw host_rtos::TaskExit();
+    }
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+inline TickType_t xTaskGetTickCount() {
+    return static_cast<TickType_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - host_rtos::epoch()).count());
+}
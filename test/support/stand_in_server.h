@@ -0,0 +1,408 @@
+#pragma once
+
+// Local HTTP/1.1 server standing in for the assistant endpoints (native tests).
+// One thread per connection, keep-alive, fixed-length or chunked responses that
+// the handler can pace (recorded streams replayed with token delays).
+// startTls() serves HTTPS instead, with a throw-away self-signed RSA-2048
+// certificate, TLS 1.2 and session tickets, as the cloud endpoints negotiate
+// with mbedTLS on the device.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <strings.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class StandInServer {
+public:
+    struct Request {
+        std::string method;
+        std::string path;
+        std::vector<std::pair<std::string, std::string>> headers;
+        std::string body;
+        uint32_t sequence = 0;      // 1 for the first request on its connection
+
+        std::string header(const char* key) const {
+            for (const auto& item : headers) {
+                if (strcasecmp(item.first.c_str(), key) == 0) {
+                    return item.second;
+                }
+            }
+            return std::string();
+        }
+    };
+
+    class Response {
+    public:
+        /** Send the status line and headers; content_length < 0 means chunked */
+        void begin(int status, const std::string& content_type, long content_length = -1) {
+            if (begun_) {
+                return;
+            }
+            begun_ = true;
+            chunked_ = content_length < 0;
+            std::string head = "HTTP/1.1 " + std::to_string(status) + " " + reason(status) + "\r\n";
+            head += "Content-Type: " + content_type + "\r\n";
+            head += chunked_ ? std::string("Transfer-Encoding: chunked\r\n")
+                             : "Content-Length: " + std::to_string(content_length) + "\r\n";
+            if (close_) {
+                head += "Connection: close\r\n";
+            }
+            head += "\r\n";
+            raw(head);
+        }
+
+        /** Body bytes (one chunk when chunked); false once the client is gone */
+        bool send(const std::string& data) {
+            if (data.empty()) {
+                return ok_;
+            }
+            if (!chunked_) {
+                return raw(data);
+            }
+            char size[16];
+            snprintf(size, sizeof(size), "%zx\r\n", data.size());
+            return raw(size + data + "\r\n");
+        }
+
+        /** Terminate a chunked body */
+        void end() {
+            if (begun_ && chunked_ && !ended_) {
+                raw("0\r\n\r\n");
+            }
+            ended_ = true;
+        }
+
+        void reply(int status, const std::string& content_type, const std::string& body) {
+            begin(status, content_type, static_cast<long>(body.size()));
+            send(body);
+            end();
+        }
+
+        /** Close the connection after this response (before begin(): also announced) */
+        void closeConnection() { close_ = true; }
+
+        void sleepMs(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+        bool ok() const { return ok_; }
+
+    private:
+        friend class StandInServer;
+
+        Response(int fd, SSL* ssl) : fd_(fd), ssl_(ssl) {}
+
+        static const char* reason(int status) {
+            switch (status) {
+                case 200: return "OK";
+                case 204: return "No Content";
+                case 400: return "Bad Request";
+                case 404: return "Not Found";
+                case 500: return "Internal Server Error";
+                case 503: return "Service Unavailable";
+                default: return "Status";
+            }
+        }
+
+        bool raw(const std::string& data) {
+            size_t sent = 0;
+            while (ok_ && sent < data.size()) {
+                const ssize_t n = ssl_ ? SSL_write(ssl_, data.data() + sent, static_cast<int>(data.size() - sent))
+                                       : ::send(fd_, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0) {
+                    ok_ = false;
+                    break;
+                }
+                sent += n;
+            }
+            return ok_;
+        }
+
+        int fd_;
+        SSL* ssl_;
+        bool begun_ = false;
+        bool chunked_ = false;
+        bool ended_ = false;
+        bool close_ = false;
+        bool ok_ = true;
+    };
+
+    using Handler = std::function<void(const Request& request, Response& response)>;
+
+    explicit StandInServer(Handler handler) : handler_(std::move(handler)) {}
+    ~StandInServer() {
+        stop();
+        if (tls_) {
+            SSL_CTX_free(tls_);
+        }
+    }
+
+    StandInServer(const StandInServer&) = delete;
+    StandInServer& operator=(const StandInServer&) = delete;
+
+    /** Keep-alive connections idle this long are closed by the server (0 = never) */
+    void setIdleTimeoutMs(uint32_t ms) { idle_timeout_ms_ = ms; }
+
+    /** start() serving HTTPS */
+    bool startTls() {
+        signal(SIGPIPE, SIG_IGN);  // SSL_write() cannot pass MSG_NOSIGNAL for a client that left
+        EVP_PKEY* key = EVP_RSA_gen(2048);
+        X509* cert = X509_new();
+        bool ok = key && cert;
+        if (ok) {
+            ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+            X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+            X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+            X509_set_pubkey(cert, key);
+            X509_NAME* name = X509_get_subject_name(cert);
+            X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                                       reinterpret_cast<const unsigned char*>("127.0.0.1"), -1, -1, 0);
+            X509_set_issuer_name(cert, name);
+            tls_ = SSL_CTX_new(TLS_server_method());
+            static const unsigned char kSessionContext[] = "stand-in";
+            ok = X509_sign(cert, key, EVP_sha256()) > 0 && tls_ &&
+                 SSL_CTX_set_max_proto_version(tls_, TLS1_2_VERSION) == 1 &&
+                 SSL_CTX_use_certificate(tls_, cert) == 1 && SSL_CTX_use_PrivateKey(tls_, key) == 1 &&
+                 SSL_CTX_set_session_id_context(tls_, kSessionContext, sizeof(kSessionContext) - 1) == 1;
+        }
+        X509_free(cert);
+        EVP_PKEY_free(key);
+        return ok && start();
+    }
+
+    bool start() {
+        listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (listen_fd_ < 0) {
+            return false;
+        }
+        int one = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+        socklen_t length = sizeof(address);
+        if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listen_fd_, 16) != 0 ||
+            ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            ::close(listen_fd_);
+            listen_fd_ = -1;
+            return false;
+        }
+        port_ = ntohs(address.sin_port);
+        running_ = true;
+        accept_thread_ = std::thread([this]() { acceptLoop(); });
+        return true;
+    }
+
+    void stop() {
+        if (!running_.exchange(false)) {
+            return;
+        }
+        ::shutdown(listen_fd_, SHUT_RDWR);
+        accept_thread_.join();
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        std::vector<std::thread> threads;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (int fd : open_fds_) {
+                ::shutdown(fd, SHUT_RDWR);
+            }
+            threads.swap(threads_);
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    int port() const { return port_; }
+    std::string url(const std::string& path) const {
+        return (tls_ ? "https" : "http") + std::string("://127.0.0.1:") + std::to_string(port_) + path;
+    }
+
+    uint32_t connections() const { return connections_.load(); }
+    uint32_t requests() const { return requests_.load(); }
+    uint32_t handshakes() const { return handshakes_.load(); }
+    uint32_t resumed() const { return resumed_.load(); }      // Abbreviated handshakes
+
+private:
+    void acceptLoop() {
+        while (running_) {
+            const int fd = ::accept(listen_fd_, nullptr, nullptr);
+            if (fd < 0) {
+                if (!running_) {
+                    break;
+                }
+                continue;
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            ++connections_;
+            std::lock_guard<std::mutex> lock(mutex_);
+            open_fds_.push_back(fd);
+            threads_.emplace_back([this, fd]() { serve(fd); });
+        }
+    }
+
+    // Receive into buffer: false on EOF, error, stop or idle timeout
+    bool receive(int fd, SSL* ssl, std::string& buffer, bool idle) {
+        const auto start = std::chrono::steady_clock::now();
+        while (running_) {
+            pollfd pfd = {fd, POLLIN, 0};
+            const int ready = ssl && SSL_pending(ssl) > 0 ? 1 : ::poll(&pfd, 1, 50);
+            if (ready == 0) {
+                const auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+                if (idle && idle_timeout_ms_ > 0 && waited >= idle_timeout_ms_) {
+                    return false;
+                }
+                continue;
+            }
+            char chunk[4096];
+            const ssize_t n = ready < 0 ? -1 : ssl ? SSL_read(ssl, chunk, sizeof(chunk))
+                                                   : ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                return false;
+            }
+            buffer.append(chunk, n);
+            return true;
+        }
+        return false;
+    }
+
+    bool readRequest(int fd, SSL* ssl, std::string& buffer, Request& request) {
+        size_t end;
+        while ((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+            if (!receive(fd, ssl, buffer, buffer.empty())) {
+                return false;
+            }
+        }
+        const std::string head = buffer.substr(0, end);
+        buffer.erase(0, end + 4);
+
+        size_t line_end = head.find("\r\n");
+        const std::string request_line = head.substr(0, line_end);
+        const size_t first = request_line.find(' ');
+        const size_t second = request_line.find(' ', first + 1);
+        request.method = request_line.substr(0, first);
+        request.path = request_line.substr(first + 1, second - first - 1);
+        request.headers.clear();
+        while (line_end != std::string::npos) {
+            const size_t start = line_end + 2;
+            line_end = head.find("\r\n", start);
+            const std::string line = head.substr(start, line_end == std::string::npos ? std::string::npos
+                                                                                      : line_end - start);
+            const size_t colon = line.find(':');
+            if (colon != std::string::npos) {
+                std::string value = line.substr(colon + 1);
+                value.erase(0, value.find_first_not_of(' '));
+                request.headers.emplace_back(line.substr(0, colon), value);
+            }
+        }
+
+        request.body.clear();
+        if (strcasecmp(request.header("Transfer-Encoding").c_str(), "chunked") == 0) {
+            while (true) {
+                size_t size_end;
+                while ((size_end = buffer.find("\r\n")) == std::string::npos) {
+                    if (!receive(fd, ssl, buffer, false)) {
+                        return false;
+                    }
+                }
+                const size_t size = std::strtoul(buffer.c_str(), nullptr, 16);
+                while (buffer.size() < size_end + 2 + size + 2) {
+                    if (!receive(fd, ssl, buffer, false)) {
+                        return false;
+                    }
+                }
+                request.body.append(buffer, size_end + 2, size);
+                buffer.erase(0, size_end + 2 + size + 2);
+                if (size == 0) {
+                    return true;
+                }
+            }
+        }
+        const size_t length = std::strtoul(request.header("Content-Length").c_str(), nullptr, 10);
+        while (buffer.size() < length) {
+            if (!receive(fd, ssl, buffer, false)) {
+                return false;
+            }
+        }
+        request.body = buffer.substr(0, length);
+        buffer.erase(0, length);
+        return true;
+    }
+
+    void serve(int fd) {
+        SSL* ssl = nullptr;
+        bool connected = true;
+        if (tls_) {
+            ssl = SSL_new(tls_);
+            SSL_set_fd(ssl, fd);
+            connected = SSL_accept(ssl) == 1;
+            if (connected) {
+                ++handshakes_;
+                resumed_ += SSL_session_reused(ssl) ? 1 : 0;
+            }
+        }
+        std::string buffer;
+        Request request;
+        while (running_ && connected && readRequest(fd, ssl, buffer, request)) {
+            ++request.sequence;
+            ++requests_;
+            Response response(fd, ssl);
+            if (strcasecmp(request.header("Connection").c_str(), "close") == 0) {
+                response.closeConnection();
+            }
+            handler_(request, response);
+            if (!response.begun_) {
+                response.reply(404, "text/plain", "not found");
+            }
+            response.end();
+            if (!response.ok() || response.close_) {
+                break;
+            }
+        }
+        if (ssl) {
+            SSL_shutdown(ssl);
+            SSL_free(ssl);
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        open_fds_.erase(std::remove(open_fds_.begin(), open_fds_.end(), fd), open_fds_.end());
+        ::close(fd);
+    }
+
+    Handler handler_;
+    int listen_fd_ = -1;
+    int port_ = 0;
+    uint32_t idle_timeout_ms_ = 0;
+    std::atomic<bool> running_{false};
+    std::atomic<uint32_t> connections_{0};
+    std::atomic<uint32_t> requests_{0};
+    std::atomic<uint32_t> handshakes_{0};
+    std::atomic<uint32_t> resumed_{0};
+    SSL_CTX* tls_ = nullptr;
+    std::thread accept_thread_;
+    std::mutex mutex_;
+    std::vector<int> open_fds_;
+    std::vector<std::thread> threads_;
+};
@@ -0,0 +1,176 @@
+// AutoGainControl: attack/release trajectories, the soft limiter, the noise
+// gate, and a throughput benchmark.
+
+#include <unity.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "core/auto_gain_control.h"
+
+namespace {
+
+constexpr size_t kBlock = AutoGainControl::kBlockSamples;
+constexpr int32_t kUnity = AutoGainControl::kUnityGain;
+
+std::vector<int16_t> tone(size_t count, int32_t amplitude, double step = 0.1) {
+    std::vector<int16_t> samples(count);
+    for (size_t i = 0; i < count; ++i) {
+        samples[i] = static_cast<int16_t>(std::lround(amplitude * std::sin(i * step)));
+    }
+    return samples;
+}
+
+// Runs a signal one block at a time and records the gain after each block
+std::vector<int32_t> gainTrajectory(AutoGainControl& agc, int32_t amplitude, size_t blocks) {
+    std::vector<int32_t> gains;
+    std::vector<int16_t> samples = tone(blocks * kBlock, amplitude);
+    for (size_t block = 0; block < blocks; ++block) {
+        gains.push_back(agc.process(samples.data() + block * kBlock, kBlock).gain_q10);
+    }
+    return gains;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_quiet_input_is_boosted_gradually() {
+    AutoGainControl agc;
+    const AutoGainControl::Config config;
+    const std::vector<int32_t> gains = gainTrajectory(agc, 1000, 250);
+
+    // 26000 / 1000 = 26x, clamped to max_gain
+    for (size_t i = 1; i < gains.size(); ++i) {
+        TEST_ASSERT_GREATER_OR_EQUAL(gains[i - 1], gains[i]);
+        // Release: never more than 1/32 of the remaining error per block
+        const int32_t step = gains[i] - gains[i - 1];
+        TEST_ASSERT_LESS_OR_EQUAL(std::max<int32_t>(1, (config.max_gain_q10 - gains[i - 1]) >> config.release_shift),
+                                  step);
+    }
+    TEST_ASSERT_LESS_THAN(config.max_gain_q10 / 2, gains[12]);                 // ~50 ms in
+    TEST_ASSERT_INT_WITHIN(config.max_gain_q10 / 20, config.max_gain_q10, gains[150]);   // ~600 ms in
+}
+
+void test_loud_onset_is_attenuated_within_a_few_blocks() {
+    AutoGainControl agc;
+    gainTrajectory(agc, 1000, 250);
+    TEST_ASSERT_GREATER_THAN(15 * kUnity, agc.gainQ10());
+
+    // 30000 peak needs < unity, clamped to min_gain
+    const std::vector<int32_t> gains = gainTrajectory(agc, 30000, 16);
+    for (size_t i = 1; i < gains.size(); ++i) {
+        TEST_ASSERT_LESS_OR_EQUAL(gains[i - 1], gains[i]);
+    }
+    TEST_ASSERT_LESS_THAN(11 * kUnity, gains[0]);              // Half the error in the first block
+    TEST_ASSERT_INT_WITHIN(kUnity / 10, kUnity, gains[7]);     // 8 blocks = 32 ms
+}
+
+void test_limiter_never_clips() {
+    AutoGainControl agc;
+    gainTrajectory(agc, 1000, 250);
+
+    // Loud onset while the gain is still high
+    std::vector<int16_t> samples = tone(4096, 30000);
+    const AutoGainControl::Stats stats = agc.process(samples.data(), samples.size());
+    printf("AGC loud onset: peak in %u, peak out %u\n", stats.peak_in, stats.peak_out);
+    TEST_ASSERT_LESS_THAN(32767, stats.peak_out);
+
+    size_t at_rail = 0;
+    for (int16_t sample : samples) {
+        if (sample >= 32767 || sample <= -32767) {
+            ++at_rail;
+        }
+    }
+    TEST_ASSERT_EQUAL(0u, at_rail);
+}
+
+void test_limiter_is_monotonic_and_transparent_below_knee() {
+    AutoGainControl::Config config;
+    config.min_gain_q10 = 4 * kUnity;
+    config.max_gain_q10 = 4 * kUnity;
+    config.gate_gain_q10 = 4 * kUnity;
+    AutoGainControl agc(config);
+
+    // reset() starts at unity; let the release settle on the fixed 4x
+    std::vector<int16_t> warm = tone(400 * kBlock, 1000);
+    agc.process(warm.data(), warm.size());
+    TEST_ASSERT_EQUAL(4 * kUnity, agc.gainQ10());
+
+    std::vector<int16_t> ramp;
+    for (int32_t value = -32768; value <= 32767; value += 7) {
+        ramp.push_back(static_cast<int16_t>(value));
+    }
+    const std::vector<int16_t> input = ramp;
+    agc.process(ramp.data(), ramp.size());
+
+    for (size_t i = 0; i < ramp.size(); ++i) {
+        if (i > 0) {
+            TEST_ASSERT_GREATER_OR_EQUAL(ramp[i - 1], ramp[i]);
+        }
+        const int32_t linear = input[i] * 4;
+        if (std::abs(linear) <= config.limiter_knee) {
+            TEST_ASSERT_EQUAL(linear, ramp[i]);
+        }
+    }
+    TEST_ASSERT_LESS_THAN(32767, ramp.back());
+    TEST_ASSERT_GREATER_THAN(-32767, ramp.front());
+}
+
+void test_noise_is_gated_not_boosted() {
+    AutoGainControl agc;
+    const AutoGainControl::Config config;
+    std::vector<int16_t> samples = tone(250 * kBlock, 100);
+    AutoGainControl::Stats stats = agc.process(samples.data(), samples.size());
+
+    TEST_ASSERT_TRUE(stats.gated);
+    TEST_ASSERT_EQUAL(config.gate_gain_q10, stats.gain_q10);
+    TEST_ASSERT_LESS_OR_EQUAL(stats.peak_in, stats.peak_out);
+
+    // Speech after the gate opens again is boosted
+    samples = tone(250 * kBlock, 1000);
+    stats = agc.process(samples.data(), samples.size());
+    TEST_ASSERT_FALSE(stats.gated);
+    TEST_ASSERT_GREATER_THAN(10 * kUnity, stats.gain_q10);
+}
+
+void test_gain_ramp_has_no_steps() {
+    AutoGainControl agc;
+    std::vector<int16_t> samples(8 * kBlock, 8000);
+    agc.process(samples.data(), samples.size());
+
+    // A constant input makes the applied gain visible per sample
+    std::vector<int16_t> constant(kBlock * 40, 2000);
+    agc.process(constant.data(), constant.size());
+    for (size_t i = 1; i < constant.size(); ++i) {
+        TEST_ASSERT_INT_WITHIN(40, constant[i - 1], constant[i]);
+    }
+}
+
+void test_benchmark() {
+    AutoGainControl agc;
+    std::vector<int16_t> samples = tone(2048, 3000);
+    const int rounds = 20000;
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        agc.process(samples.data(), samples.size());
+    }
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    printf("AGC: %.2f ns/sample (host)\n", ns / (2048.0 * rounds));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_quiet_input_is_boosted_gradually);
+    RUN_TEST(test_loud_onset_is_attenuated_within_a_few_blocks);
+    RUN_TEST(test_limiter_never_clips);
+    RUN_TEST(test_limiter_is_monotonic_and_transparent_below_knee);
+    RUN_TEST(test_noise_is_gated_not_boosted);
+    RUN_TEST(test_gain_ramp_has_no_steps);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
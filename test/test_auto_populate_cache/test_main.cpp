@@ -0,0 +1,252 @@
+// AutoPopulateCache with the real CommandPlanExecutor and stand-in commands of
+// 400, 300 and 200 ms: a cold turn runs them side by side instead of one after
+// another, warm turns reuse the results, an expired stale_while_revalidate
+// result is handed back at once while it refreshes, an EventRouter event
+// re-runs only the commands it invalidates, and a failed run keeps the last
+// result.
+
+#include <unity.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/auto_populate_cache.h"
+#include "core/event_router.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+class StandInCommands {
+public:
+    void define(const std::string& command, uint32_t delay_ms) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        delays_[command] = delay_ms;
+    }
+
+    void setFailing(bool failing) { failing_ = failing; }
+
+    /** Output of a run: the command and how many times it has run, e.g. "weather#2" */
+    AutoPopulateCache::Runner runner() {
+        return [this](const AutoPopulateCommand& command, AutoPopulateCache::Value& value) {
+            uint32_t delay_ms = 0;
+            int run = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                delay_ms = delays_[command.command];
+                run = ++runs_[command.command];
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+            if (failing_) {
+                return false;
+            }
+            value.output = command.command + "#" + std::to_string(run);
+            return true;
+        };
+    }
+
+    int runs(const std::string& command) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return runs_[command];
+    }
+
+private:
+    std::map<std::string, uint32_t> delays_;
+    std::map<std::string, int> runs_;
+    std::atomic<bool> failing_{false};
+    std::mutex mutex_;
+};
+
+AutoPopulateCommand command(const std::string& name, uint32_t ttl_ms, bool stale_while_revalidate = false,
+                            std::vector<std::string> invalidate_on = {}) {
+    AutoPopulateCommand item;
+    item.command = name;
+    item.ttl_ms = ttl_ms;
+    item.stale_while_revalidate = stale_while_revalidate;
+    item.invalidate_on = std::move(invalidate_on);
+    return item;
+}
+
+long populateMs(AutoPopulateCache& cache, const std::vector<AutoPopulateCommand>& commands,
+                const AutoPopulateCache::Runner& runner, std::vector<AutoPopulateCache::Result>& results) {
+    const Clock::time_point start = Clock::now();
+    results = cache.populate(commands, runner);
+    return static_cast<long>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count());
+}
+
+AutoPopulateCache::Stats statsFor(const AutoPopulateCache& cache, const std::string& command) {
+    for (const AutoPopulateCache::Stats& stats : cache.getStats()) {
+        if (stats.command == command) {
+            return stats;
+        }
+    }
+    return AutoPopulateCache::Stats();
+}
+
+// Waits for a background refresh to store its result, up to a second
+bool waitForRuns(const AutoPopulateCache& cache, const std::string& command, uint32_t runs) {
+    for (int i = 0; i < 100 && statsFor(cache, command).runs < runs; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return statsFor(cache, command).runs >= runs;
+}
+
+// Subscribed to EventRouter for the rest of the run, so it outlives the test
+AutoPopulateCache g_invalidated;
+
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_cold_turn_runs_commands_in_parallel_and_warm_turns_hit() {
+    StandInCommands stand_in;
+    stand_in.define("weather", 400);
+    stand_in.define("calendar", 300);
+    stand_in.define("sd_grep", 200);
+    const std::vector<AutoPopulateCommand> commands = {command("weather", 60000), command("calendar", 60000),
+                                                       command("sd_grep", 60000)};
+    const AutoPopulateCache::Runner runner = stand_in.runner();
+
+    // Before: one after another
+    const Clock::time_point start = Clock::now();
+    for (const AutoPopulateCommand& item : commands) {
+        AutoPopulateCache::Value value;
+        runner(item, value);
+    }
+    const long serial_ms =
+        static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count());
+
+    AutoPopulateCache cache;
+    std::vector<AutoPopulateCache::Result> results;
+    const long cold_ms = populateMs(cache, commands, runner, results);
+    TEST_ASSERT_EQUAL(3, results.size());
+    TEST_ASSERT_EQUAL_STRING("weather#2", results[0].value.output.c_str());    // In prompt order
+    TEST_ASSERT_EQUAL_STRING("calendar#2", results[1].value.output.c_str());
+    TEST_ASSERT_EQUAL_STRING("sd_grep#2", results[2].value.output.c_str());
+
+    long warm_ms = 0;
+    constexpr int kWarmTurns = 9;
+    for (int turn = 0; turn < kWarmTurns; ++turn) {
+        warm_ms = std::max(warm_ms, populateMs(cache, commands, runner, results));
+        TEST_ASSERT_TRUE(results[0].valid);
+        TEST_ASSERT_EQUAL_STRING("weather#2", results[0].value.output.c_str());
+    }
+
+    printf("3 commands of 400/300/200 ms: serial %ld ms, cold turn %ld ms, warm turns at most %ld ms\n", serial_ms,
+           cold_ms, warm_ms);
+    for (const AutoPopulateCache::Stats& stats : cache.getStats()) {
+        const uint32_t lookups = stats.hits + stats.stale_hits + stats.misses;
+        printf("  %-9s cost avg %3u ms max %3u ms, hits %u/%u (%.0f%%)\n", stats.command.c_str(),
+               (unsigned)stats.avg_ms, (unsigned)stats.max_ms, (unsigned)stats.hits, (unsigned)lookups,
+               100.0 * stats.hits / lookups);
+        TEST_ASSERT_EQUAL(1, stats.misses);
+        TEST_ASSERT_EQUAL(kWarmTurns, stats.hits);
+        TEST_ASSERT_EQUAL(1, stats.runs);
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL(900, serial_ms);
+    TEST_ASSERT_GREATER_OR_EQUAL(400, cold_ms);
+    TEST_ASSERT_LESS_THAN(600, cold_ms);       // The slowest command, not the sum
+    TEST_ASSERT_LESS_THAN(20, warm_ms);
+    TEST_ASSERT_EQUAL(2, stand_in.runs("weather"));
+}
+
+void test_zero_ttl_runs_every_turn() {
+    StandInCommands stand_in;
+    AutoPopulateCache cache;
+    const std::vector<AutoPopulateCommand> commands = {command("uptime", 0)};
+    std::vector<AutoPopulateCache::Result> results;
+    populateMs(cache, commands, stand_in.runner(), results);
+    populateMs(cache, commands, stand_in.runner(), results);
+    TEST_ASSERT_EQUAL_STRING("uptime#2", results[0].value.output.c_str());
+    TEST_ASSERT_EQUAL(2, statsFor(cache, "uptime").misses);
+    TEST_ASSERT_EQUAL(0, statsFor(cache, "uptime").hits);
+}
+
+void test_stale_result_is_used_while_it_refreshes() {
+    StandInCommands stand_in;
+    stand_in.define("snapshot", 300);
+    AutoPopulateCache cache;
+    const std::vector<AutoPopulateCommand> commands = {command("snapshot", 100, true)};
+    const AutoPopulateCache::Runner runner = stand_in.runner();
+    std::vector<AutoPopulateCache::Result> results;
+    populateMs(cache, commands, runner, results);
+    TEST_ASSERT_EQUAL_STRING("snapshot#1", results[0].value.output.c_str());
+
+    // Expired: handed back at once, refreshed behind the turn
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    const long stale_ms = populateMs(cache, commands, runner, results);
+    TEST_ASSERT_LESS_THAN(50, stale_ms);
+    TEST_ASSERT_EQUAL_STRING("snapshot#1", results[0].value.output.c_str());
+    TEST_ASSERT_EQUAL(1, statsFor(cache, "snapshot").stale_hits);
+
+    // While it runs, another turn gets the same stale value without a second run
+    populateMs(cache, commands, runner, results);
+    TEST_ASSERT_EQUAL_STRING("snapshot#1", results[0].value.output.c_str());
+
+    TEST_ASSERT_TRUE(waitForRuns(cache, "snapshot", 2));
+    populateMs(cache, commands, runner, results);
+    TEST_ASSERT_EQUAL_STRING("snapshot#2", results[0].value.output.c_str());
+    const AutoPopulateCache::Stats stats = statsFor(cache, "snapshot");
+    printf("stale_while_revalidate: expired result served in %ld ms while a 300 ms refresh ran\n", stale_ms);
+    TEST_ASSERT_EQUAL(2, stats.runs);
+    TEST_ASSERT_EQUAL(2, stats.stale_hits);
+    TEST_ASSERT_EQUAL(1, stats.hits);
+    TEST_ASSERT_EQUAL(1, stats.misses);
+}
+
+void test_event_invalidates_only_its_commands() {
+    StandInCommands stand_in;
+    const std::vector<AutoPopulateCommand> commands = {
+        command("snapshot", 60000, false, {"test.wifi.connected", "test.wifi.disconnected"}),
+        command("calendar", 60000)};
+    const AutoPopulateCache::Runner runner = stand_in.runner();
+    std::vector<AutoPopulateCache::Result> results;
+    populateMs(g_invalidated, commands, runner, results);
+
+    EventRouter::getInstance()->publish("test.wifi.connected");
+    populateMs(g_invalidated, commands, runner, results);
+    TEST_ASSERT_EQUAL_STRING("snapshot#2", results[0].value.output.c_str());
+    TEST_ASSERT_EQUAL_STRING("calendar#1", results[1].value.output.c_str());
+
+    EventRouter::getInstance()->publish("test.other");
+    populateMs(g_invalidated, commands, runner, results);
+    TEST_ASSERT_EQUAL(2, stand_in.runs("snapshot"));
+    TEST_ASSERT_EQUAL(1, stand_in.runs("calendar"));
+    TEST_ASSERT_EQUAL(2, statsFor(g_invalidated, "calendar").hits);
+    TEST_ASSERT_EQUAL(1, statsFor(g_invalidated, "snapshot").hits);
+}
+
+void test_failed_run_keeps_the_last_result() {
+    StandInCommands stand_in;
+    AutoPopulateCache cache;
+    std::vector<AutoPopulateCache::Result> results;
+    populateMs(cache, {command("weather", 0)}, stand_in.runner(), results);
+    stand_in.setFailing(true);
+    populateMs(cache, {command("weather", 0)}, stand_in.runner(), results);
+    TEST_ASSERT_TRUE(results[0].valid);
+    TEST_ASSERT_EQUAL_STRING("weather#1", results[0].value.output.c_str());
+    TEST_ASSERT_EQUAL(1, statsFor(cache, "weather").failures);
+
+    // Nothing to fall back on
+    populateMs(cache, {command("forecast", 0)}, stand_in.runner(), results);
+    TEST_ASSERT_FALSE(results[0].valid);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_cold_turn_runs_commands_in_parallel_and_warm_turns_hit);
+    RUN_TEST(test_zero_ttl_runs_every_turn);
+    RUN_TEST(test_stale_result_is_used_while_it_refreshes);
+    RUN_TEST(test_event_invalidates_only_its_commands);
+    RUN_TEST(test_failed_run_keeps_the_last_result);
+    return UNITY_END();
+}
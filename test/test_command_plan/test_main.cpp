@@ -0,0 +1,258 @@
+// CommandPlan and CommandPlanExecutor with a stand-in command runner: plan
+// validation, {{step}} substitution, dependency order, parallel steps and how
+// a failed step propagates to its dependents.
+
+#include <unity.h>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/command_plan_executor.h"
+#include "utils/command_plan.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// What the stand-in runner saw; assertions run on the test thread afterwards
+struct Call {
+    std::string command;
+    std::vector<std::string> args;
+    Clock::time_point start;
+    Clock::time_point end;
+};
+
+struct Behaviour {
+    uint32_t delay_ms = 0;
+    bool success = true;
+    std::string output;
+};
+
+class StandInRunner {
+public:
+    void define(const std::string& command, uint32_t delay_ms, bool success, const std::string& output) {
+        behaviours_[command] = {delay_ms, success, output};
+    }
+
+    CommandPlanExecutor::Runner runner() {
+        return [this](const std::string& command, const std::vector<std::string>& args) {
+            Call call{command, args, Clock::now(), Clock::time_point()};
+            const auto it = behaviours_.find(command);
+            const Behaviour behaviour = it != behaviours_.end() ? it->second : Behaviour{0, false, "unknown command"};
+            std::this_thread::sleep_for(std::chrono::milliseconds(behaviour.delay_ms));
+            call.end = Clock::now();
+            std::lock_guard<std::mutex> lock(mutex_);
+            calls_.push_back(call);
+            return CommandResult(behaviour.success, behaviour.output);
+        };
+    }
+
+    const Call* find(const std::string& command) const {
+        for (const Call& call : calls_) {
+            if (call.command == command) {
+                return &call;
+            }
+        }
+        return nullptr;
+    }
+
+    size_t calls() const { return calls_.size(); }
+
+private:
+    std::map<std::string, Behaviour> behaviours_;
+    std::mutex mutex_;
+    std::vector<Call> calls_;
+};
+
+CommandPlan::Step makeStep(const char* id, const char* command, std::vector<std::string> args = {},
+                           std::vector<std::string> after = {}) {
+    CommandPlan::Step step;
+    step.id = id;
+    step.command = command;
+    step.args = std::move(args);
+    step.after = std::move(after);
+    return step;
+}
+
+bool startsAfter(const Call* later, const Call* earlier) {
+    return later && earlier && later->start >= earlier->end;
+}
+
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_prepare_names_steps_and_rejects_bad_plans() {
+    std::string error;
+    CommandPlan plan;
+    TEST_ASSERT_TRUE(plan.addStep(makeStep("", "volume_down")));
+    TEST_ASSERT_TRUE(plan.addStep(makeStep("", "led_brightness", {"0"}, {"1"})));
+    TEST_ASSERT_TRUE(plan.prepare(error));
+    TEST_ASSERT_EQUAL_STRING("1", plan.step(0).id.c_str());
+    TEST_ASSERT_EQUAL_STRING("2", plan.step(1).id.c_str());
+    TEST_ASSERT_EQUAL(1, plan.step(1).deps.size());
+
+    struct {
+        std::vector<CommandPlan::Step> steps;
+        const char* error;
+    } bad[] = {
+        {{makeStep("a", "ping"), makeStep("a", "heap")}, "duplicate step id a"},
+        {{makeStep("a", "ping", {}, {"zz"})}, "step a waits for unknown step zz"},
+        {{makeStep("a", "ping", {}, {"b"}), makeStep("b", "heap", {}, {"a"})}, "dependency cycle between steps"},
+        {{makeStep("a", "ping", {"{{b}}"}), makeStep("b", "heap", {"{{a}}"})}, "dependency cycle between steps"},
+        {{makeStep("a", "ping"), makeStep("b", "")}, "step b has no command"},
+    };
+    for (auto& item : bad) {
+        CommandPlan invalid;
+        for (CommandPlan::Step& step : item.steps) {
+            invalid.addStep(std::move(step));
+        }
+        error.clear();
+        TEST_ASSERT_FALSE(invalid.prepare(error));
+        TEST_ASSERT_EQUAL_STRING(item.error, error.c_str());
+    }
+
+    CommandPlan full;
+    for (size_t i = 0; i < CommandPlan::kMaxSteps; ++i) {
+        TEST_ASSERT_TRUE(full.addStep(makeStep("", "ping")));
+    }
+    TEST_ASSERT_FALSE(full.addStep(makeStep("", "ping")));
+}
+
+void test_step_outputs_are_substituted() {
+    StandInRunner runner;
+    runner.define("weather", 30, true, "24 gradi, sole");
+    runner.define("bt_type", 0, true, "typed");
+
+    CommandPlan plan;
+    plan.addStep(makeStep("meteo", "weather"));
+    plan.addStep(makeStep("", "bt_type", {"AA:BB", "Meteo: {{meteo}} / {{unknown}} / {{meteo}}", "{{meteo"}));
+    std::string error;
+    TEST_ASSERT_TRUE(plan.prepare(error));
+    TEST_ASSERT_EQUAL(2, plan.depth());  // {{meteo}} implies the dependency
+
+    TEST_ASSERT_TRUE(CommandPlanExecutor::run(plan, runner.runner()));
+    const Call* type = runner.find("bt_type");
+    TEST_ASSERT_NOT_NULL(type);
+    TEST_ASSERT_TRUE(startsAfter(type, runner.find("weather")));
+    TEST_ASSERT_EQUAL_STRING("AA:BB", type->args[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("Meteo: 24 gradi, sole / {{unknown}} / 24 gradi, sole", type->args[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("{{meteo", type->args[2].c_str());
+}
+
+void test_dependencies_run_in_order() {
+    // Diamond: fetch, then parse and store in parallel, then report
+    StandInRunner runner;
+    runner.define("fetch", 40, true, "raw");
+    runner.define("parse", 60, true, "parsed");
+    runner.define("store", 60, true, "stored");
+    runner.define("report", 10, true, "done");
+
+    CommandPlan plan;
+    plan.addStep(makeStep("report", "report", {"{{parse}} + {{store}}"}));
+    plan.addStep(makeStep("parse", "parse", {"{{fetch}}"}));
+    plan.addStep(makeStep("store", "store", {}, {"fetch"}));
+    plan.addStep(makeStep("fetch", "fetch"));
+    std::string error;
+    TEST_ASSERT_TRUE(plan.prepare(error));
+    TEST_ASSERT_EQUAL(3, plan.depth());
+    TEST_ASSERT_EQUAL(2, plan.width());
+
+    CommandPlanExecutor::Stats stats;
+    TEST_ASSERT_TRUE(CommandPlanExecutor::run(plan, runner.runner(), &stats));
+    const Call* fetch = runner.find("fetch");
+    const Call* parse = runner.find("parse");
+    const Call* store = runner.find("store");
+    const Call* report = runner.find("report");
+    TEST_ASSERT_TRUE(startsAfter(parse, fetch));
+    TEST_ASSERT_TRUE(startsAfter(store, fetch));
+    TEST_ASSERT_TRUE(startsAfter(report, parse));
+    TEST_ASSERT_TRUE(startsAfter(report, store));
+    TEST_ASSERT_EQUAL_STRING("raw", parse->args[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("parsed + stored", report->args[0].c_str());
+
+    // parse and store overlapped
+    TEST_ASSERT_EQUAL(2, stats.workers);
+    TEST_ASSERT_LESS_THAN(stats.serial_ms, stats.elapsed_ms + 40);
+    printf("diamond: %u ms, %u ms one by one, %u workers\n", (unsigned)stats.elapsed_ms,
+           (unsigned)stats.serial_ms, (unsigned)stats.workers);
+}
+
+void test_independent_steps_run_in_parallel() {
+    StandInRunner runner;
+    runner.define("led", 100, true, "led off");
+    runner.define("volume", 100, true, "volume 30");
+    runner.define("weather", 100, true, "sole");
+
+    for (uint8_t max_workers : {CommandPlanExecutor::kMaxWorkers, uint8_t(1)}) {
+        CommandPlan plan;
+        plan.addStep(makeStep("", "led"));
+        plan.addStep(makeStep("", "volume"));
+        plan.addStep(makeStep("", "weather"));
+        std::string error;
+        TEST_ASSERT_TRUE(plan.prepare(error));
+        TEST_ASSERT_EQUAL(3, plan.width());
+
+        CommandPlanExecutor::Stats stats;
+        TEST_ASSERT_TRUE(CommandPlanExecutor::run(plan, runner.runner(), &stats, max_workers));
+        TEST_ASSERT_TRUE(plan.finished());
+        TEST_ASSERT_EQUAL(max_workers, stats.workers);
+        TEST_ASSERT_GREATER_OR_EQUAL(300, stats.serial_ms);
+        if (max_workers == 1) {
+            TEST_ASSERT_GREATER_OR_EQUAL(300, stats.elapsed_ms);
+        } else {
+            TEST_ASSERT_LESS_THAN(200, stats.elapsed_ms);
+        }
+        printf("3 independent steps, %u workers: %u ms (%u ms one by one)\n", (unsigned)stats.workers,
+               (unsigned)stats.elapsed_ms, (unsigned)stats.serial_ms);
+    }
+}
+
+void test_failure_skips_dependents_only() {
+    StandInRunner runner;
+    runner.define("weather", 20, false, "HTTP 503");
+    runner.define("bt_type", 0, true, "typed");
+    runner.define("tts", 0, true, "spoken");
+    runner.define("volume", 20, true, "volume 30");
+
+    CommandPlan plan;
+    plan.addStep(makeStep("meteo", "weather"));
+    plan.addStep(makeStep("type", "bt_type", {"{{meteo}}"}));
+    plan.addStep(makeStep("say", "tts", {}, {"type"}));     // Transitively depends on the failure
+    plan.addStep(makeStep("vol", "volume"));
+    std::string error;
+    TEST_ASSERT_TRUE(plan.prepare(error));
+
+    TEST_ASSERT_FALSE(CommandPlanExecutor::run(plan, runner.runner()));
+    TEST_ASSERT_TRUE(plan.finished());
+    TEST_ASSERT_FALSE(plan.succeeded());
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandPlan::State::Failed), static_cast<int>(plan.step(0).state));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandPlan::State::Skipped), static_cast<int>(plan.step(1).state));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandPlan::State::Skipped), static_cast<int>(plan.step(2).state));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandPlan::State::Done), static_cast<int>(plan.step(3).state));
+    TEST_ASSERT_EQUAL(2, runner.calls());
+    TEST_ASSERT_NULL(runner.find("bt_type"));
+    TEST_ASSERT_NULL(runner.find("tts"));
+
+    TEST_ASSERT_EQUAL_STRING(
+        "[meteo] weather: failed\nHTTP 503\n"
+        "[type] bt_type: skipped\nskipped: step meteo did not succeed\n"
+        "[say] tts: skipped\nskipped: step type did not succeed\n"
+        "[vol] volume: ok\nvolume 30\n",
+        plan.summary().c_str());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_prepare_names_steps_and_rejects_bad_plans);
+    RUN_TEST(test_step_outputs_are_substituted);
+    RUN_TEST(test_dependencies_run_in_order);
+    RUN_TEST(test_independent_steps_run_in_parallel);
+    RUN_TEST(test_failure_skips_dependents_only);
+    return UNITY_END();
+}
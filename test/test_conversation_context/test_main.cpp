@@ -0,0 +1,153 @@
+// ConversationContext: token estimates, which turns fit the budget, what is
+// left pending for the summarizer, and the size of a full 100-entry buffer
+// sent as is against the default 1024-token budget.
+
+#include <unity.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "core/conversation_context.h"
+
+namespace {
+
+using Turn = ConversationContext::Turn;
+
+Turn makeTurn(uint32_t id, const std::string& content) {
+    Turn turn;
+    turn.id = id;
+    turn.role = id % 2 ? "user" : "assistant";
+    turn.content = content;
+    return turn;
+}
+
+// n turns of exactly tokens_each estimated tokens
+std::vector<Turn> uniformTurns(size_t n, size_t tokens_each) {
+    std::vector<Turn> turns;
+    const std::string content((tokens_each - ConversationContext::kMessageOverheadTokens) * 4, 'a');
+    for (size_t i = 0; i < n; ++i) {
+        turns.push_back(makeTurn(static_cast<uint32_t>(i + 1), content));
+    }
+    return turns;
+}
+
+// A voice session as the buffer holds it: short requests, longer replies, some with a command
+std::vector<Turn> session(size_t entries) {
+    static const char* const kRequests[] = {
+        "Che tempo fa domani a Roma?",
+        "Abbassa il volume al trenta per cento",
+        "Scrivi sul computer: riunione spostata alle quindici, portare i documenti del progetto",
+        "Quanto manca al prossimo treno per Milano?",
+        "Ricordami di chiamare Marco quando arrivo a casa stasera",
+    };
+    static const char* const kReplies[] = {
+        "Domani a Roma sarà in prevalenza soleggiato, con una massima di ventiquattro gradi e una minima di "
+        "quindici. Il vento sarà debole da ovest e non sono previste piogge per tutta la giornata.",
+        "Ho abbassato il volume al trenta per cento.\nCommand: volume_set(30)",
+        "Fatto, ho scritto il testo sul computer collegato via Bluetooth.\n"
+        "Command: bt_type(AA:BB:CC:DD:EE:FF, riunione spostata alle quindici, portare i documenti del progetto)",
+        "Il prossimo treno per Milano parte alle 18:05 dal binario 7, tra ventidue minuti. Il successivo è alle "
+        "18:35. Vuoi che ti ricordi di uscire in tempo?",
+        "Va bene, te lo ricorderò appena il telefono si collega al Wi-Fi di casa.\n"
+        "Command: reminder_add(chiamare Marco, arrivo a casa)",
+    };
+    std::vector<Turn> turns;
+    for (size_t i = 0; i < entries; ++i) {
+        const std::string content = i % 2 == 0 ? kRequests[(i / 2) % 5] : kReplies[(i / 2 + i / 10) % 5];
+        turns.push_back(makeTurn(static_cast<uint32_t>(i + 1), content));
+    }
+    return turns;
+}
+
+size_t bytes(const std::vector<Turn>& turns) {
+    size_t total = 0;
+    for (const Turn& turn : turns) {
+        total += turn.content.size();
+    }
+    return total;
+}
+
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_estimate_counts_code_points() {
+    const size_t overhead = ConversationContext::kMessageOverheadTokens;
+    TEST_ASSERT_EQUAL(overhead, ConversationContext::estimateTokens(""));
+    TEST_ASSERT_EQUAL(overhead + 1, ConversationContext::estimateTokens("ciao"));
+    TEST_ASSERT_EQUAL(overhead + 2, ConversationContext::estimateTokens("ciao!"));
+    // "perché è già" is 12 code points in 15 bytes
+    TEST_ASSERT_EQUAL(overhead + 3, ConversationContext::estimateTokens("perch\xc3\xa9 \xc3\xa8 gi\xc3\xa0"));
+}
+
+void test_zero_budget_keeps_everything() {
+    ConversationBuffer::Summary summary;
+    summary.text = "ignored";
+    summary.upto_id = 3;
+    const ConversationContext::Plan plan = ConversationContext::fit(uniformTurns(10, 50), summary, 0);
+    TEST_ASSERT_EQUAL(10, plan.turns.size());
+    TEST_ASSERT_TRUE(plan.summary.empty());
+    TEST_ASSERT_TRUE(plan.pending.empty());
+    TEST_ASSERT_EQUAL(0, plan.omitted);
+    TEST_ASSERT_EQUAL(500, plan.tokens);
+}
+
+void test_newest_turns_fit_the_budget() {
+    ConversationBuffer::Summary none;
+    ConversationContext::Plan plan = ConversationContext::fit(uniformTurns(10, 50), none, 220);
+    TEST_ASSERT_EQUAL(4, plan.turns.size());
+    TEST_ASSERT_EQUAL(7, plan.turns.front().id);
+    TEST_ASSERT_EQUAL(10, plan.turns.back().id);
+    TEST_ASSERT_EQUAL(200, plan.tokens);
+    TEST_ASSERT_EQUAL(6, plan.omitted);
+    TEST_ASSERT_EQUAL(6, plan.pending.size());
+    TEST_ASSERT_EQUAL(1, plan.pending.front().id);
+
+    // The newest turn is kept even when it alone is over budget
+    plan = ConversationContext::fit(uniformTurns(3, 500), none, 100);
+    TEST_ASSERT_EQUAL(1, plan.turns.size());
+    TEST_ASSERT_EQUAL(3, plan.turns[0].id);
+    TEST_ASSERT_EQUAL(500, plan.tokens);
+}
+
+void test_summary_shares_the_budget_and_covers_old_turns() {
+    ConversationBuffer::Summary summary;
+    summary.text = std::string(4 * 46, 's');   // 50 tokens
+    summary.upto_id = 4;
+    const ConversationContext::Plan plan = ConversationContext::fit(uniformTurns(10, 50), summary, 220);
+    TEST_ASSERT_EQUAL_STRING(summary.text.c_str(), plan.summary.c_str());
+    TEST_ASSERT_EQUAL(3, plan.turns.size());
+    TEST_ASSERT_EQUAL(200, plan.tokens);
+    TEST_ASSERT_EQUAL(7, plan.omitted);
+    // Turns 1-4 are in the summary already: only 5-7 wait for the summarizer
+    TEST_ASSERT_EQUAL(3, plan.pending.size());
+    TEST_ASSERT_EQUAL(5, plan.pending.front().id);
+    TEST_ASSERT_EQUAL(7, plan.pending.back().id);
+}
+
+void test_full_buffer_against_default_budget() {
+    const std::vector<Turn> turns = session(100);
+    ConversationBuffer::Summary none;
+    const ConversationContext::Plan everything = ConversationContext::fit(turns, none, 0);
+    const ConversationContext::Plan fitted = ConversationContext::fit(turns, none, 1024);
+    printf("100 entries: all sent %u tokens (%u bytes of history), 1024 budget %u tokens (%u bytes, %u turns)\n",
+           (unsigned)everything.tokens, (unsigned)bytes(everything.turns), (unsigned)fitted.tokens,
+           (unsigned)bytes(fitted.turns), (unsigned)fitted.turns.size());
+    TEST_ASSERT_LESS_OR_EQUAL(1024, fitted.tokens);
+    TEST_ASSERT_GREATER_THAN(1024 - 200, fitted.tokens);    // The budget is used, not wasted
+    TEST_ASSERT_LESS_THAN(everything.tokens / 2, fitted.tokens);
+    TEST_ASSERT_EQUAL(100, fitted.turns.back().id);
+    TEST_ASSERT_EQUAL(100 - fitted.turns.size(), fitted.pending.size());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_estimate_counts_code_points);
+    RUN_TEST(test_zero_budget_keeps_everything);
+    RUN_TEST(test_newest_turns_fit_the_budget);
+    RUN_TEST(test_summary_shares_the_budget_and_covers_old_turns);
+    RUN_TEST(test_full_buffer_against_default_budget);
+    return UNITY_END();
+}
@@ -0,0 +1,473 @@
+// HttpClientPool against local HTTP and HTTPS stand-in servers: which
+// connections release() keeps (a request body left unfinished, such as an
+// abandoned streaming upload, or a response left unread closes it), the retry on a dead warm connection, and the
+// connect time per stage for a full TLS handshake, a resumed session
+// (CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS) and a kept connection. Against a
+// server that stalls for a minute, the time from a cancel or a deadline to the
+// handle being released, while waiting for headers and while reading the body.
+
+#include <unity.h>
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/cancel_token.h"
+#include "core/http_client_pool.h"
+#include "stand_in_server.h"
+
+namespace {
+
+constexpr int kStageRounds = 20;
+constexpr size_t kBigBody = 64 * 1024;
+constexpr int kCancelRounds = 10;
+constexpr uint32_t kStallMs = 60000;
+constexpr int kRequestTimeoutMs = 90000;
+
+// Set at the end so stalled handlers return and the servers can stop
+std::atomic<bool> g_unstall{false};
+
+void stall(StandInServer::Response& response) {
+    for (uint32_t waited = 0; waited < kStallMs && !g_unstall; waited += 10) {
+        response.sleepMs(10);
+    }
+}
+
+void serve(const StandInServer::Request& request, StandInServer::Response& response) {
+    if (request.path == "/small") {
+        response.reply(200, "text/plain", "ok");
+    } else if (request.path == "/big") {
+        response.reply(200, "application/octet-stream", std::string(kBigBody, 'x'));
+    } else if (request.path == "/chunked") {
+        response.begin(200, "text/plain");
+        for (const char* part : {"uno ", "due ", "tre"}) {
+            response.send(part);
+        }
+        response.end();
+    } else if (request.path == "/cut") {
+        // Announces more than it sends, then drops the connection
+        response.begin(200, "text/plain", 1000);
+        response.send(std::string(100, 'x'));
+        response.closeConnection();
+    } else if (request.path == "/close") {
+        response.closeConnection();
+        response.reply(200, "text/plain", "bye");
+    } else if (request.path == "/upload") {
+        response.reply(200, "text/plain", std::to_string(request.body.size()));
+    } else if (request.path == "/slow") {
+        response.sleepMs(2000);
+        response.reply(200, "text/plain", "late");
+    } else if (request.path == "/stall_headers") {
+        stall(response);
+        response.reply(200, "text/plain", "late");
+    } else if (request.path == "/stall_body") {
+        response.begin(200, "text/plain", 1000);
+        response.send(std::string(100, 'x'));
+        stall(response);
+        response.send(std::string(900, 'x'));
+    } else if (request.path == "/trickle") {
+        // Healthy but slow: gaps longer than a cancel poll slice
+        response.begin(200, "text/plain");
+        for (int i = 0; i < 4; ++i) {
+            response.sleepMs(250);
+            response.send(std::string(256, 'a' + i));
+        }
+        response.end();
+    }
+}
+
+// Shared by the tests: a failed assertion unwinds without running destructors
+StandInServer g_http(serve);
+StandInServer g_idle(serve);    // Drops keep-alive connections after 100 ms
+StandInServer g_https(serve);
+
+HttpClientPool::StageStats stageStats(const char* stage) {
+    for (const HttpClientPool::StageStats& stats : HttpClientPool::getInstance().getStats()) {
+        if (stats.stage == stage) {
+            return stats;
+        }
+    }
+    return HttpClientPool::StageStats();
+}
+
+// One request through the pool; read_all = false releases with the body unread.
+// With open_us the request goes through open() + fetchHeaders() to time the
+// connect, else through request(). Returns the status, -1 on a failure.
+int exchange(const std::string& url, const char* stage, bool read_all = true, double* open_us = nullptr,
+             const CancelToken& cancel = CancelToken()) {
+    HttpClientPool& pool = HttpClientPool::getInstance();
+    HttpClientPool::Options options;
+    options.stage = stage;
+    options.timeout_ms = 3000;
+    options.cancel = cancel;
+    esp_http_client_handle_t client = pool.acquire(url, options);
+    TEST_ASSERT_NOT_NULL(client);
+
+    int status = -1;
+    if (!open_us) {
+        int content_length = 0;
+        status = pool.request(client, nullptr, 0, content_length);
+    } else {
+        const auto start = std::chrono::steady_clock::now();
+        if (pool.open(client, 0) == ESP_OK) {
+            *open_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            if (pool.fetchHeaders(client) >= 0) {
+                status = esp_http_client_get_status_code(client);
+            }
+        }
+    }
+    char buffer[4096];
+    while (status > 0 && read_all) {
+        const int read_len = pool.read(client, buffer, sizeof(buffer));
+        if (read_len < 0) {
+            status = -1;
+        }
+        if (read_len <= 0) {
+            break;
+        }
+    }
+    pool.release(client);
+    return status;
+}
+
+// A stalled request on a cancellable handle; fire() is called once the
+// request is waiting and returns when the token fires (millis()). Returns the
+// milliseconds from then until release() is done, -1 if the request succeeded.
+template <typename Fire>
+long cancelToIdleMs(const char* path, const CancelToken& cancel, Fire fire) {
+    HttpClientPool& pool = HttpClientPool::getInstance();
+    HttpClientPool::Options options;
+    options.stage = "cancel_idle";
+    options.method = HTTP_METHOD_GET;
+    options.timeout_ms = kRequestTimeoutMs;
+    options.cancel = cancel;
+    esp_http_client_handle_t client = pool.acquire(g_http.url(path), options);
+    TEST_ASSERT_NOT_NULL(client);
+
+    std::atomic<uint32_t> fired_ms{0};
+    std::thread canceller([&fired_ms, &fire]() { fired_ms = fire(); });
+    bool failed = pool.open(client, 0) != ESP_OK || pool.fetchHeaders(client) < 0;
+    char buffer[256];
+    for (int read_len = 1; !failed && read_len > 0;) {
+        read_len = pool.read(client, buffer, sizeof(buffer));
+        failed = read_len < 0;
+    }
+    pool.release(client);
+    const uint32_t idle_ms = millis();
+    canceller.join();
+    return failed ? static_cast<long>(idle_ms - fired_ms) : -1;
+}
+
+struct Spread {
+    long min;
+    long median;
+    long max;
+};
+
+Spread spread(std::vector<long> values) {
+    std::sort(values.begin(), values.end());
+    return {values.front(), values[values.size() / 2], values.back()};
+}
+
+} // namespace
+
+void setUp() {
+    HttpClientPool::getInstance().closeIdle();
+}
+
+void tearDown() {}
+
+void test_complete_responses_keep_the_connection() {
+    const uint32_t connections = g_http.connections();
+    TEST_ASSERT_EQUAL(200, exchange(g_http.url("/small"), "keep"));
+    TEST_ASSERT_EQUAL(200, exchange(g_http.url("/chunked"), "keep"));
+    TEST_ASSERT_EQUAL(200, exchange(g_http.url("/big"), "keep"));
+    TEST_ASSERT_EQUAL(200, exchange(g_http.url("/small"), "keep"));
+    TEST_ASSERT_EQUAL(connections + 1, g_http.connections());
+
+    const HttpClientPool::StageStats stats = stageStats("keep");
+    TEST_ASSERT_EQUAL(1, stats.cold);
+    TEST_ASSERT_EQUAL(3, stats.warm);
+    TEST_ASSERT_EQUAL(0, stats.retries);
+}
+
+void test_unread_body_closes_the_connection() {
+    const uint32_t connections = g_http.connections();
+    TEST_ASSERT_EQUAL(200, exchange(g_http.url("/big"), "unread", false));
+    TEST_ASSERT_EQUAL(200, exchange(g_http.url("/small"), "unread"));
+    TEST_ASSERT_EQUAL(200, exchange(g_http.url("/small"), "unread"));
+    // The unread body is not taken for the next response: a new connection
+    TEST_ASSERT_EQUAL(connections + 2, g_http.connections());
+    TEST_ASSERT_EQUAL(0, stageStats("unread").retries);
+}
+
+void test_unfinished_body_closes_the_connection() {
+    const uint32_t connections = g_http.connections();
+    TEST_ASSERT_EQUAL(200, exchange(g_http.url("/small"), "unsent"));
+
+    // Part of a 1000-byte body, then released: the handle still reports the
+    // previous response as complete, as esp_http_client does until new headers
+    HttpClientPool& pool = HttpClientPool::getInstance();
+    HttpClientPool::Options options;
+    options.stage = "unsent";
+    options.timeout_ms = 3000;
+    esp_http_client_handle_t client = pool.acquire(g_http.url("/upload"), options);
+    TEST_ASSERT_NOT_NULL(client);
+    TEST_ASSERT_EQUAL(ESP_OK, pool.open(client, 1000));
+    const std::string part(100, 'a');
+    TEST_ASSERT_EQUAL(100, esp_http_client_write(client, part.data(), static_cast<int>(part.size())));
+    TEST_ASSERT_TRUE(esp_http_client_is_complete_data_received(client));
+    pool.release(client);
+
+    // The next request goes out on a new connection, not into the open body
+    TEST_ASSERT_EQUAL(200, exchange(g_http.url("/small"), "unsent"));
+    TEST_ASSERT_EQUAL(connections + 2, g_http.connections());
+    const HttpClientPool::StageStats stats = stageStats("unsent");
+    TEST_ASSERT_EQUAL(2, stats.cold);
+    TEST_ASSERT_EQUAL(1, stats.warm);      // The upload itself, on the kept connection
+    TEST_ASSERT_EQUAL(0, stats.retries);
+}
+
+// The Whisper streaming upload: a chunked body written while recording, then
+// either finished and answered or abandoned (no speech, audio dropped)
+esp_http_client_handle_t startUpload(const char* stage) {
+    HttpClientPool& pool = HttpClientPool::getInstance();
+    HttpClientPool::Options options;
+    options.stage = stage;
+    options.timeout_ms = 3000;
+    esp_http_client_handle_t client = pool.acquire(g_http.url("/upload"), options);
+    TEST_ASSERT_NOT_NULL(client);
+    TEST_ASSERT_EQUAL(ESP_OK, pool.open(client, -1));
+    const std::string audio(1024, 'p');
+    for (int i = 0; i < 4; ++i) {
+        TEST_ASSERT_TRUE(pool.writeChunk(client, audio.data(), audio.size()));
+    }
+    return client;
+}
+
+void test_finished_upload_keeps_the_connection() {
+    HttpClientPool& pool = HttpClientPool::getInstance();
+    const uint32_t connections = g_http.connections();
+    esp_http_client_handle_t client = startUpload("upload");
+    TEST_ASSERT_TRUE(pool.writeChunk(client, nullptr, 0));
+    TEST_ASSERT_EQUAL(4, pool.fetchHeaders(client));
+    char body[16] = {};
+    TEST_ASSERT_EQUAL(4, pool.read(client, body, sizeof(body) - 1));
+    TEST_ASSERT_EQUAL_STRING("4096", body);
+    pool.release(client);
+
+    TEST_ASSERT_EQUAL(200, exchange(g_http.url("/small"), "upload"));
+    TEST_ASSERT_EQUAL(connections + 1, g_http.connections());
+    TEST_ASSERT_EQUAL(1, stageStats("upload").warm);
+}
+
+void test_abandoned_upload_is_not_reused() {
+    HttpClientPool& pool = HttpClientPool::getInstance();
+    const uint32_t connections = g_http.connections();
+    const uint32_t requests = g_http.requests();
+    TEST_ASSERT_EQUAL(200, exchange(g_http.url("/small"), "abandon"));
+
+    // Recording ended without speech: streamWhisperRequest() gives the request up
+    esp_http_client_handle_t client = startUpload("abandon");
+    pool.markFailed(client);
+    pool.release(client);
+
+    // Even without markFailed() the unfinished body is not kept
+    client = startUpload("abandon");
+    pool.release(client);
+
+    TEST_ASSERT_EQUAL(200, exchange(g_http.url("/small"), "abandon"));
+    TEST_ASSERT_EQUAL(connections + 3, g_http.connections());
+    // The server never saw a complete upload: only the two plain requests were answered
+    TEST_ASSERT_EQUAL(requests + 2, g_http.requests());
+    const HttpClientPool::StageStats stats = stageStats("abandon");
+    TEST_ASSERT_EQUAL(1, stats.warm);       // The first upload, on the kept connection
+    TEST_ASSERT_EQUAL(0, stats.retries);
+}
+
+void test_failed_read_closes_the_connection() {
+    const uint32_t connections = g_http.connections();
+    TEST_ASSERT_EQUAL(-1, exchange(g_http.url("/cut"), "failed"));
+    TEST_ASSERT_EQUAL(200, exchange(g_http.url("/small"), "failed"));
+    TEST_ASSERT_EQUAL(connections + 2, g_http.connections());
+    // Closed on release, so the next request did not trip over a dead socket
+    TEST_ASSERT_EQUAL(0, stageStats("failed").retries);
+}
+
+void test_cancelled_request_closes_the_connection() {
+    std::atomic<bool> cancel{false};
+    std::thread canceller([&cancel]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(150));
+        cancel = true;
+    });
+    const uint32_t connections = g_http.connections();
+    const auto start = std::chrono::steady_clock::now();
+    TEST_ASSERT_EQUAL(-1, exchange(g_http.url("/slow"), "cancel", true, nullptr, CancelToken(&cancel)));
+    const auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    canceller.join();
+    TEST_ASSERT_LESS_THAN(1000, elapsed_ms);
+    TEST_ASSERT_EQUAL(1, stageStats("cancel").cancelled);
+
+    TEST_ASSERT_EQUAL(200, exchange(g_http.url("/small"), "cancel"));
+    TEST_ASSERT_EQUAL(connections + 2, g_http.connections());
+}
+
+void test_cancel_to_idle_against_a_stalled_server() {
+    const uint32_t cancelled = stageStats("cancel_idle").cancelled;
+    std::vector<long> headers, body, deadline;
+    for (int i = 0; i < kCancelRounds; ++i) {
+        // Fired at different points of the poll slice
+        const uint32_t delay_ms = 150 + static_cast<uint32_t>(i) * 37 % HttpClientPool::kCancelPollMs;
+        std::atomic<bool> flag{false};
+        auto cancel_after = [&flag, delay_ms]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+            flag = true;
+            return static_cast<uint32_t>(millis());
+        };
+        headers.push_back(cancelToIdleMs("/stall_headers", CancelToken(&flag), cancel_after));
+        flag = false;
+        body.push_back(cancelToIdleMs("/stall_body", CancelToken(&flag), cancel_after));
+
+        std::atomic<bool> never{false};
+        const uint32_t deadline_ms = millis() + delay_ms;
+        deadline.push_back(cancelToIdleMs("/stall_headers", CancelToken(&never, deadline_ms), [deadline_ms]() {
+            while (static_cast<int32_t>(millis() - deadline_ms) < 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return deadline_ms;
+        }));
+    }
+
+    const Spread phases[] = {spread(headers), spread(body), spread(deadline)};
+    const char* const names[] = {"cancel waiting for headers", "cancel reading the body", "deadline"};
+    printf("Stalled server (request timeout %d s), to idle over %d runs (min/median/max):\n", kRequestTimeoutMs / 1000,
+           kCancelRounds);
+    for (size_t i = 0; i < 3; ++i) {
+        printf("  %-27s %3ld / %3ld / %3ld ms\n", names[i], phases[i].min, phases[i].median, phases[i].max);
+        TEST_ASSERT_GREATER_OR_EQUAL(0, phases[i].min);
+        // Within a poll slice, plus scheduling slack
+        TEST_ASSERT_LESS_THAN(HttpClientPool::kCancelPollMs + 50, phases[i].max);
+    }
+    TEST_ASSERT_EQUAL(3 * kCancelRounds, stageStats("cancel_idle").cancelled - cancelled);
+}
+
+void test_slow_response_arrives_whole_across_slices() {
+    std::atomic<bool> flag{false};
+    HttpClientPool& pool = HttpClientPool::getInstance();
+    HttpClientPool::Options options;
+    options.stage = "trickle";
+    options.method = HTTP_METHOD_GET;
+    options.timeout_ms = 3000;
+    options.cancel = CancelToken(&flag);
+    esp_http_client_handle_t client = pool.acquire(g_http.url("/trickle"), options);
+    TEST_ASSERT_NOT_NULL(client);
+    TEST_ASSERT_EQUAL(ESP_OK, pool.open(client, 0));
+    TEST_ASSERT_EQUAL(0, pool.fetchHeaders(client));    // Chunked
+
+    std::string received;
+    char buffer[128];
+    for (int read_len; (read_len = pool.read(client, buffer, sizeof(buffer))) > 0;) {
+        received.append(buffer, read_len);
+    }
+    pool.release(client);
+    TEST_ASSERT_EQUAL(1024, received.size());
+    TEST_ASSERT_EQUAL('d', received.back());
+    TEST_ASSERT_EQUAL(0, stageStats("trickle").cancelled);
+}
+
+void test_dead_warm_connection_is_retried() {
+    const uint32_t connections = g_idle.connections();
+    TEST_ASSERT_EQUAL(200, exchange(g_idle.url("/small"), "dead"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));  // Past the server's idle timeout
+    TEST_ASSERT_EQUAL(200, exchange(g_idle.url("/small"), "dead"));
+
+    // A server that closes after its response is caught the same way
+    TEST_ASSERT_EQUAL(200, exchange(g_idle.url("/close"), "dead"));
+    TEST_ASSERT_EQUAL(200, exchange(g_idle.url("/small"), "dead"));
+
+    TEST_ASSERT_EQUAL(connections + 3, g_idle.connections());
+    TEST_ASSERT_EQUAL(2, stageStats("dead").retries);
+}
+
+void test_tls_connect_time_per_stage() {
+    host_http::Stats& tls = host_http::stats();
+
+    // Full handshake: a new handle has no session to offer
+    double full_us = 0;
+    const uint32_t full_start = tls.handshakes;
+    for (int i = 0; i < kStageRounds; ++i) {
+        HttpClientPool::getInstance().closeIdle();
+        double open_us = 0;
+        TEST_ASSERT_EQUAL(200, exchange(g_https.url("/small"), "tls_full", true, &open_us));
+        full_us += open_us / kStageRounds;
+    }
+    TEST_ASSERT_EQUAL(full_start + kStageRounds, tls.handshakes.load());
+
+    // Resumed: the handle keeps its session when the connection is closed
+    TEST_ASSERT_EQUAL(200, exchange(g_https.url("/big"), "tls_prime", false));
+    double resumed_us = 0;
+    const uint32_t resumed_start = tls.resumed;
+    const uint32_t server_resumed_start = g_https.resumed();
+    for (int i = 0; i < kStageRounds; ++i) {
+        double open_us = 0;
+        TEST_ASSERT_EQUAL(200, exchange(g_https.url("/big"), "tls_resumed", false, &open_us));
+        resumed_us += open_us / kStageRounds;
+    }
+    TEST_ASSERT_EQUAL(resumed_start + kStageRounds, tls.resumed.load());
+    TEST_ASSERT_EQUAL(server_resumed_start + kStageRounds, g_https.resumed());
+
+    // Kept: the connection stays open between complete responses
+    TEST_ASSERT_EQUAL(200, exchange(g_https.url("/small"), "tls_kept"));
+    double kept_us = 0;
+    const uint32_t kept_start = tls.handshakes;
+    for (int i = 0; i < kStageRounds; ++i) {
+        double open_us = 0;
+        TEST_ASSERT_EQUAL(200, exchange(g_https.url("/small"), "tls_kept", true, &open_us));
+        kept_us += open_us / kStageRounds;
+    }
+    TEST_ASSERT_EQUAL(kept_start, tls.handshakes.load());
+
+    printf("TLS connect (open) per stage over %d rounds: full handshake %.0f us, resumed session %.0f us, "
+           "kept connection %.0f us\n", kStageRounds, full_us, resumed_us, kept_us);
+    for (const char* stage : {"tls_full", "tls_resumed", "tls_kept"}) {
+        const HttpClientPool::StageStats stats = stageStats(stage);
+        printf("  %-12s cold %2u (avg %u ms), warm %2u (avg %u ms), retries %u\n", stage, (unsigned)stats.cold,
+               (unsigned)stats.cold_avg_ms, (unsigned)stats.warm, (unsigned)stats.warm_avg_ms,
+               (unsigned)stats.retries);
+    }
+    TEST_ASSERT_EQUAL(kStageRounds, stageStats("tls_kept").warm);
+    TEST_ASSERT_TRUE(resumed_us < full_us);
+    TEST_ASSERT_TRUE(kept_us < resumed_us);
+}
+
+int main() {
+    g_idle.setIdleTimeoutMs(100);
+    if (!g_http.start() || !g_idle.start() || !g_https.startTls()) {
+        return 1;
+    }
+    UNITY_BEGIN();
+    RUN_TEST(test_complete_responses_keep_the_connection);
+    RUN_TEST(test_unread_body_closes_the_connection);
+    RUN_TEST(test_unfinished_body_closes_the_connection);
+    RUN_TEST(test_finished_upload_keeps_the_connection);
+    RUN_TEST(test_abandoned_upload_is_not_reused);
+    RUN_TEST(test_failed_read_closes_the_connection);
+    RUN_TEST(test_cancelled_request_closes_the_connection);
+    RUN_TEST(test_cancel_to_idle_against_a_stalled_server);
+    RUN_TEST(test_slow_response_arrives_whole_across_slices);
+    RUN_TEST(test_dead_warm_connection_is_retried);
+    RUN_TEST(test_tls_connect_time_per_stage);
+    const int failures = UNITY_END();
+    g_unstall = true;
+    g_http.stop();
+    g_idle.stop();
+    g_https.stop();
+    return failures;
+}
@@ -0,0 +1,321 @@
+// HttpResponseSource against a local stand-in TTS server: time-to-first-audio
+// compared with downloading the whole file first, WAV header fix-up, the tee
+// file, and aborted or truncated downloads.
+
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <FS.h>
+
+#include "core/http_client_pool.h"
+#include "core/http_response_source.h"
+#include "stand_in_server.h"
+
+namespace {
+
+constexpr uint32_t kSampleRate = 24000;
+constexpr size_t kAudioBytes = 2 * kSampleRate * 2;    // 2 s of mono PCM16
+constexpr size_t kChunkBytes = 960;                     // 20 ms of audio
+constexpr uint32_t kFirstByteMs = 150;                  // Synthesis latency before the first chunk
+constexpr uint32_t kChunkIntervalMs = 4;                // Synthesis at 5x real time
+constexpr size_t kWavHeaderBytes = 44;
+
+void putLe32(std::string& out, size_t offset, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[offset + i] = static_cast<char>(value >> (8 * i));
+    }
+}
+
+uint32_t getLe32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// 44-byte PCM header with the given RIFF/data sizes (streaming encoders write 0 or 0xFFFFFFFF)
+std::string wavHeader(uint32_t data_size) {
+    std::string header("RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x01\0\0\0\0\0\0\0\0\0\x02\0\x10\0data\0\0\0\0", 44);
+    putLe32(header, 4, data_size == 0xFFFFFFFF ? data_size : data_size + 36);
+    putLe32(header, 24, kSampleRate);
+    putLe32(header, 28, kSampleRate * 2);
+    putLe32(header, 40, data_size);
+    return header;
+}
+
+std::string pcm() {
+    std::string audio(kAudioBytes, '\0');
+    for (size_t i = 0; i < audio.size(); ++i) {
+        audio[i] = static_cast<char>((i * 7919) >> 3);
+    }
+    return audio;
+}
+
+uint32_t elapsedMs(std::chrono::steady_clock::time_point since) {
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - since).count());
+}
+
+// /stream: chunked, data size 0xFFFFFFFF; /sized: Content-Length, data size 0;
+// /truncated: Content-Length, connection closed halfway through the audio
+StandInServer g_server([](const StandInServer::Request& request, StandInServer::Response& response) {
+    const std::string audio = pcm();
+    const bool stream = request.path == "/stream";
+    const bool truncated = request.path == "/truncated";
+    const std::string header = wavHeader(stream ? 0xFFFFFFFF : 0);
+
+    response.sleepMs(kFirstByteMs);
+    if (truncated) {
+        response.closeConnection();
+    }
+    response.begin(200, "audio/wav", stream ? -1 : static_cast<long>(header.size() + audio.size()));
+    response.send(header);
+    const size_t limit = truncated ? audio.size() / 2 : audio.size();
+    for (size_t offset = 0; offset < limit && response.ok(); offset += kChunkBytes) {
+        response.sleepMs(kChunkIntervalMs);
+        response.send(audio.substr(offset, std::min(kChunkBytes, limit - offset)));
+    }
+});
+
+std::string g_root;
+
+esp_http_client_handle_t openTts(const char* path, int& content_length) {
+    HttpClientPool& pool = HttpClientPool::getInstance();
+    HttpClientPool::Options options;
+    options.stage = "tts";
+    options.timeout_ms = 5000;
+    esp_http_client_handle_t client = pool.acquire(g_server.url(path), options);
+    const std::string body = R"({"input":"Ciao","voice":"test","response_format":"wav"})";
+    if (!client || pool.request(client, body.data(), body.size(), content_length) != 200) {
+        pool.release(client);
+        return nullptr;
+    }
+    return client;
+}
+
+HttpResponseSource::Config sourceConfig() {
+    HttpResponseSource::Config config;
+    config.release_client = [](esp_http_client_handle_t c) { HttpClientPool::getInstance().release(c); };
+    return config;
+}
+
+std::string readAll(HttpResponseSource& source) {
+    std::string out;
+    char buffer[1500];
+    size_t n;
+    while ((n = source.read(buffer, sizeof(buffer))) > 0) {
+        out.append(buffer, n);
+    }
+    return out;
+}
+
+std::string readHostFile(const std::string& path) {
+    std::string out;
+    FILE* file = fopen((g_root + path).c_str(), "rb");
+    if (!file) {
+        return out;
+    }
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        out.append(buffer, n);
+    }
+    fclose(file);
+    return out;
+}
+
+struct TeeResult {
+    std::atomic<bool> closed{false};
+    std::atomic<bool> saved{false};
+    std::atomic<size_t> bytes{0};
+};
+
+bool waitFor(const std::atomic<bool>& flag, uint32_t timeout_ms) {
+    const auto start = std::chrono::steady_clock::now();
+    while (!flag.load() && elapsedMs(start) < timeout_ms) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return flag.load();
+}
+
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_time_to_first_audio() {
+    // Progressive: play once the header and the jitter buffer are in
+    auto start = std::chrono::steady_clock::now();
+    int content_length = -1;
+    esp_http_client_handle_t client = openTts("/stream", content_length);
+    TEST_ASSERT_NOT_NULL(client);
+    const uint32_t headers_ms = elapsedMs(start);
+    HttpResponseSource source(sourceConfig());
+    TEST_ASSERT_TRUE(source.attach(client, content_length));
+    TEST_ASSERT_TRUE(source.waitForPrebuffer());
+    uint8_t first[kWavHeaderBytes + 512];
+    TEST_ASSERT_EQUAL(sizeof(first), source.read(first, sizeof(first)));
+    const uint32_t progressive_ms = elapsedMs(start);
+    readAll(source);
+    const uint32_t progressive_done_ms = elapsedMs(start);
+    TEST_ASSERT_TRUE(source.getStats().finished);
+    TEST_ASSERT_FALSE(source.getStats().failed);
+
+    // Previous path: whole body into memory, written to a file, then played
+    start = std::chrono::steady_clock::now();
+    client = openTts("/stream", content_length);
+    TEST_ASSERT_NOT_NULL(client);
+    std::string body;
+    char buffer[4096];
+    int n;
+    while ((n = HttpClientPool::getInstance().read(client, buffer, sizeof(buffer))) > 0) {
+        body.append(buffer, n);
+    }
+    HttpClientPool::getInstance().release(client);
+    fs::FS filesystem(g_root);
+    File file = filesystem.open("/whole.wav", FILE_WRITE);
+    file.write(reinterpret_cast<const uint8_t*>(body.data()), body.size());
+    file.close();
+    file = filesystem.open("/whole.wav", FILE_READ);
+    TEST_ASSERT_EQUAL(sizeof(first), file.read(first, sizeof(first)));
+    file.close();
+    const uint32_t whole_ms = elapsedMs(start);
+
+    printf("TTS time-to-first-audio: progressive %u ms (headers %u ms, body done %u ms), whole file %u ms\n",
+           (unsigned)progressive_ms, (unsigned)headers_ms, (unsigned)progressive_done_ms, (unsigned)whole_ms);
+    TEST_ASSERT_EQUAL(kWavHeaderBytes + kAudioBytes, body.size());
+    TEST_ASSERT_LESS_THAN(whole_ms - 200, progressive_ms);
+    // Prebuffer of 16 KB takes ~17 chunk intervals after the first byte
+    TEST_ASSERT_LESS_THAN(kFirstByteMs + 200, progressive_ms);
+    // Draining the ring adds nothing once the body is in
+    TEST_ASSERT_LESS_THAN(whole_ms + 50, progressive_done_ms);
+}
+
+void test_streamed_wav_is_patched_and_tee_finalized() {
+    for (const char* path : {"/stream", "/sized"}) {
+        int content_length = -1;
+        esp_http_client_handle_t client = openTts(path, content_length);
+        TEST_ASSERT_NOT_NULL(client);
+
+        TeeResult tee;
+        fs::FS filesystem(g_root);
+        HttpResponseSource::Config config = sourceConfig();
+        config.tee_fs = &filesystem;
+        config.tee_path = "/tee.wav";
+        config.on_tee_closed = [&tee](bool saved, size_t bytes) {
+            tee.saved = saved;
+            tee.bytes = bytes;
+            tee.closed = true;
+        };
+        HttpResponseSource source(config);
+        TEST_ASSERT_TRUE(source.attach(client, content_length));
+        TEST_ASSERT_TRUE(source.waitForPrebuffer());
+
+        // The header region stays seekable for the decoder's chunk walk
+        uint8_t header[kWavHeaderBytes];
+        TEST_ASSERT_EQUAL(sizeof(header), source.read(header, sizeof(header)));
+        TEST_ASSERT_TRUE(source.seek(0));
+        const std::string played = readAll(source);
+        TEST_ASSERT_EQUAL(kWavHeaderBytes + kAudioBytes, played.size());
+        TEST_ASSERT_TRUE(played.compare(kWavHeaderBytes, std::string::npos, pcm()) == 0);
+
+        const uint32_t data_size = getLe32(reinterpret_cast<const uint8_t*>(played.data()) + 40);
+        if (content_length > 0) {
+            TEST_ASSERT_EQUAL(kAudioBytes, data_size);          // From Content-Length
+        } else {
+            TEST_ASSERT_EQUAL(0xFFFFFFFFu, data_size);          // Open-ended: play to the end
+        }
+
+        TEST_ASSERT_TRUE(waitFor(tee.closed, 2000));
+        TEST_ASSERT_TRUE(tee.saved);
+        TEST_ASSERT_EQUAL(played.size(), tee.bytes.load());
+        const std::string saved = readHostFile("/tee.wav");
+        TEST_ASSERT_EQUAL(played.size(), saved.size());
+        const auto* bytes = reinterpret_cast<const uint8_t*>(saved.data());
+        TEST_ASSERT_EQUAL(saved.size() - 8, getLe32(bytes + 4));
+        TEST_ASSERT_EQUAL(kAudioBytes, getLe32(bytes + 40));
+        TEST_ASSERT_TRUE(saved.compare(kWavHeaderBytes, std::string::npos, pcm()) == 0);
+        filesystem.remove("/tee.wav");
+    }
+}
+
+void test_abort_removes_partial_tee() {
+    int content_length = -1;
+    esp_http_client_handle_t client = openTts("/stream", content_length);
+    TEST_ASSERT_NOT_NULL(client);
+
+    TeeResult tee;
+    fs::FS filesystem(g_root);
+    HttpResponseSource::Config config = sourceConfig();
+    config.tee_fs = &filesystem;
+    config.tee_path = "/aborted.wav";
+    config.on_tee_closed = [&tee](bool saved, size_t bytes) {
+        tee.saved = saved;
+        tee.bytes = bytes;
+        tee.closed = true;
+    };
+    {
+        HttpResponseSource source(config);
+        TEST_ASSERT_TRUE(source.attach(client, content_length));
+        TEST_ASSERT_TRUE(source.waitForPrebuffer());
+        // Playback interrupted: the source goes away without waiting for the socket
+        const auto start = std::chrono::steady_clock::now();
+        source.close();
+        TEST_ASSERT_LESS_THAN(50u, elapsedMs(start));
+    }
+    TEST_ASSERT_TRUE(waitFor(tee.closed, 2000));
+    TEST_ASSERT_FALSE(tee.saved);
+    TEST_ASSERT_LESS_THAN(kWavHeaderBytes + kAudioBytes, tee.bytes.load());
+    TEST_ASSERT_FALSE(filesystem.exists("/aborted.wav"));
+}
+
+void test_truncated_body_fails() {
+    int content_length = -1;
+    esp_http_client_handle_t client = openTts("/truncated", content_length);
+    TEST_ASSERT_NOT_NULL(client);
+    TEST_ASSERT_EQUAL(kWavHeaderBytes + kAudioBytes, content_length);
+
+    TeeResult tee;
+    fs::FS filesystem(g_root);
+    HttpResponseSource::Config config = sourceConfig();
+    config.tee_fs = &filesystem;
+    config.tee_path = "/truncated.wav";
+    config.on_tee_closed = [&tee](bool saved, size_t bytes) {
+        tee.saved = saved;
+        tee.bytes = bytes;
+        tee.closed = true;
+    };
+    HttpResponseSource source(config);
+    TEST_ASSERT_TRUE(source.attach(client, content_length));
+    const std::string played = readAll(source);
+    TEST_ASSERT_EQUAL(kWavHeaderBytes + kAudioBytes / 2, played.size());
+    TEST_ASSERT_TRUE(source.getStats().finished);
+    TEST_ASSERT_TRUE(source.getStats().failed);
+    TEST_ASSERT_TRUE(waitFor(tee.closed, 2000));
+    TEST_ASSERT_FALSE(tee.saved);
+    TEST_ASSERT_FALSE(filesystem.exists("/truncated.wav"));
+}
+
+int main() {
+    char root[] = "/tmp/http_source_XXXXXX";
+    if (!mkdtemp(root) || !g_server.start()) {
+        return 1;
+    }
+    g_root = root;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_time_to_first_audio);
+    RUN_TEST(test_streamed_wav_is_patched_and_tee_finalized);
+    RUN_TEST(test_abort_removes_partial_tee);
+    RUN_TEST(test_truncated_body_fails);
+    const int failures = UNITY_END();
+
+    g_server.stop();
+    remove((g_root + "/whole.wav").c_str());
+    rmdir(root);
+    return failures;
+}
@@ -0,0 +1,250 @@
+// ImaAdpcmEncoder: round trip through a reference IMA-ADPCM decoder (SNR on
+// speech-like signals at several levels), block layout, streaming in odd
+// chunk sizes, the WAV header, the compression ratio of an upload and the
+// encoder's cost per sample.
+
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "utils/ima_adpcm_encoder.h"
+
+namespace {
+
+constexpr uint32_t kRate = 16000;
+constexpr double kPi = 3.14159265358979323846;
+constexpr size_t kBlock = ImaAdpcmEncoder::kBlockAlign;
+constexpr size_t kBlockSamples = ImaAdpcmEncoder::kSamplesPerBlock;
+
+// Reference decoder, as in the IMA ADPCM recommendation (and ffmpeg's adpcm_ima_wav)
+const int16_t kSteps[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+const int8_t kIndexSteps[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+std::vector<int16_t> decode(const std::vector<uint8_t>& encoded) {
+    std::vector<int16_t> pcm;
+    for (size_t offset = 0; offset + kBlock <= encoded.size(); offset += kBlock) {
+        const uint8_t* block = encoded.data() + offset;
+        int32_t predictor = static_cast<int16_t>(block[0] | (block[1] << 8));
+        int32_t index = block[2];
+        pcm.push_back(static_cast<int16_t>(predictor));
+        for (size_t i = 4; i < kBlock; ++i) {
+            for (int shift : {0, 4}) {
+                const uint8_t nibble = (block[i] >> shift) & 0x0F;
+                const int32_t step = kSteps[index];
+                const int32_t diff = (step >> 3) + ((nibble & 4) ? step : 0) + ((nibble & 2) ? step >> 1 : 0) +
+                                     ((nibble & 1) ? step >> 2 : 0);
+                predictor += (nibble & 8) ? -diff : diff;
+                predictor = std::max(-32768, std::min(32767, predictor));
+                index = std::max(0, std::min(88, index + kIndexSteps[nibble & 7]));
+                pcm.push_back(static_cast<int16_t>(predictor));
+            }
+        }
+    }
+    return pcm;
+}
+
+std::vector<uint8_t> encodeAll(const std::vector<int16_t>& pcm, size_t chunk) {
+    ImaAdpcmEncoder encoder;
+    std::vector<uint8_t> out(ImaAdpcmEncoder::maxEncodedSize(pcm.size()));
+    size_t produced = 0;
+    for (size_t offset = 0; offset < pcm.size(); offset += chunk) {
+        const size_t count = std::min(chunk, pcm.size() - offset);
+        produced += encoder.encode(pcm.data() + offset, count, out.data() + produced, out.size() - produced);
+    }
+    produced += encoder.flush(out.data() + produced, out.size() - produced);
+    out.resize(produced);
+    return out;
+}
+
+// Voiced syllables (a few formant-weighted harmonics under an envelope) with
+// fricative bursts and pauses, peaking near peak
+std::vector<int16_t> speechLike(double seconds, double peak, uint32_t seed) {
+    uint32_t state = seed;
+    auto uniform = [&state]() {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) / 16777216.0;
+    };
+    std::vector<double> signal;
+    const size_t total = static_cast<size_t>(seconds * kRate);
+    while (signal.size() < total) {
+        const size_t fricative = static_cast<size_t>(uniform() * 0.06 * kRate);
+        for (size_t i = 0; i < fricative; ++i) {
+            signal.push_back((uniform() - 0.5) * 0.3);
+        }
+        const size_t voiced = static_cast<size_t>((0.1 + uniform() * 0.15) * kRate);
+        const double f0 = 100 + uniform() * 120;
+        const double formant = 400 + uniform() * 500;
+        for (size_t i = 0; i < voiced; ++i) {
+            const double t = static_cast<double>(i) / voiced;
+            double sample = 0;
+            for (int harmonic = 1; harmonic <= 10; ++harmonic) {
+                const double weight = std::exp(-std::pow((f0 * harmonic - formant) / 300.0, 2)) + 0.05;
+                sample += weight * std::sin(2 * kPi * f0 * harmonic * i / kRate);
+            }
+            signal.push_back(sample * std::sin(kPi * t) * 0.6);
+        }
+        signal.insert(signal.end(), static_cast<size_t>(uniform() * 0.08 * kRate), 0.0);
+    }
+    signal.resize(total);
+
+    double max = 1e-9;
+    for (double sample : signal) {
+        max = std::max(max, std::fabs(sample));
+    }
+    std::vector<int16_t> pcm(total);
+    for (size_t i = 0; i < total; ++i) {
+        pcm[i] = static_cast<int16_t>(std::lround(signal[i] / max * peak));
+    }
+    return pcm;
+}
+
+double snrDb(const std::vector<int16_t>& reference, const std::vector<int16_t>& decoded) {
+    double signal = 0;
+    double noise = 0;
+    for (size_t i = 0; i < reference.size(); ++i) {
+        const double error = static_cast<double>(reference[i]) - decoded[i];
+        signal += static_cast<double>(reference[i]) * reference[i];
+        noise += error * error;
+    }
+    return 10 * std::log10(signal / std::max(noise, 1.0));
+}
+
+uint32_t readLe32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint16_t readLe16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_round_trip_snr() {
+    // Quiet, normal and loud speech, as the AGC leaves it
+    for (double peak : {2000.0, 8000.0, 26000.0}) {
+        const std::vector<int16_t> pcm = speechLike(5.0, peak, static_cast<uint32_t>(peak));
+        const std::vector<uint8_t> encoded = encodeAll(pcm, 4096);
+        const std::vector<int16_t> decoded = decode(encoded);
+        TEST_ASSERT_GREATER_OR_EQUAL(pcm.size(), decoded.size());
+        const double snr = snrDb(pcm, decoded);
+        printf("ADPCM round trip, speech-like peak %5.0f: SNR %.1f dB\n", peak, snr);
+        TEST_ASSERT_GREATER_OR_EQUAL(25.0, snr);
+    }
+
+    // A pure tone, the easy case
+    std::vector<int16_t> tone(kRate);
+    for (size_t i = 0; i < tone.size(); ++i) {
+        tone[i] = static_cast<int16_t>(std::lround(10000 * std::sin(2 * kPi * 440 * i / kRate)));
+    }
+    const double snr = snrDb(tone, decode(encodeAll(tone, 512)));
+    printf("ADPCM round trip, 440 Hz tone: SNR %.1f dB\n", snr);
+    TEST_ASSERT_GREATER_OR_EQUAL(30.0, snr);
+}
+
+void test_blocks_start_with_the_sample_verbatim() {
+    const std::vector<int16_t> pcm = speechLike(1.0, 12000, 7);
+    const std::vector<uint8_t> encoded = encodeAll(pcm, 320);
+    TEST_ASSERT_EQUAL(0, encoded.size() % kBlock);
+    for (size_t block = 0; block * kBlockSamples < pcm.size(); ++block) {
+        const uint8_t* header = encoded.data() + block * kBlock;
+        TEST_ASSERT_EQUAL_INT16(pcm[block * kBlockSamples], static_cast<int16_t>(readLe16(header)));
+        TEST_ASSERT_LESS_OR_EQUAL(88, header[2]);
+        TEST_ASSERT_EQUAL(0, header[3]);
+    }
+}
+
+void test_chunking_does_not_change_the_output() {
+    // The capture loop hands over whatever the ring holds: any chunking gives the same bytes
+    const std::vector<int16_t> pcm = speechLike(2.0, 9000, 11);
+    const std::vector<uint8_t> whole = encodeAll(pcm, pcm.size());
+    for (size_t chunk : {1u, 7u, 504u, 505u, 506u, 1024u}) {
+        const std::vector<uint8_t> chunked = encodeAll(pcm, chunk);
+        TEST_ASSERT_EQUAL(whole.size(), chunked.size());
+        TEST_ASSERT_EQUAL_MEMORY(whole.data(), chunked.data(), whole.size());
+    }
+
+    // Output smaller than a block: nothing is written, the samples stay pending
+    ImaAdpcmEncoder encoder;
+    uint8_t small[kBlock - 1];
+    TEST_ASSERT_EQUAL(0, encoder.encode(pcm.data(), kBlockSamples, small, sizeof(small)));
+    uint8_t block[kBlock];
+    TEST_ASSERT_EQUAL(kBlock, encoder.flush(block, sizeof(block)));
+    TEST_ASSERT_EQUAL(0, encoder.flush(block, sizeof(block)));
+}
+
+void test_wav_header() {
+    uint8_t header[ImaAdpcmEncoder::kWavHeaderSize];
+    ImaAdpcmEncoder::buildWavHeader(header, kRate, 10 * kBlock, 10 * kBlockSamples);
+    TEST_ASSERT_EQUAL_MEMORY("RIFF", header, 4);
+    TEST_ASSERT_EQUAL(ImaAdpcmEncoder::kWavHeaderSize - 8 + 10 * kBlock, readLe32(header + 4));
+    TEST_ASSERT_EQUAL_MEMORY("WAVEfmt ", header + 8, 8);
+    TEST_ASSERT_EQUAL(0x0011, readLe16(header + 20));
+    TEST_ASSERT_EQUAL(1, readLe16(header + 22));
+    TEST_ASSERT_EQUAL(kRate, readLe32(header + 24));
+    TEST_ASSERT_EQUAL(kRate * kBlock / kBlockSamples, readLe32(header + 28));
+    TEST_ASSERT_EQUAL(kBlock, readLe16(header + 32));
+    TEST_ASSERT_EQUAL(4, readLe16(header + 34));
+    TEST_ASSERT_EQUAL(kBlockSamples, readLe16(header + 38));
+    TEST_ASSERT_EQUAL_MEMORY("fact", header + 40, 4);
+    TEST_ASSERT_EQUAL(10 * kBlockSamples, readLe32(header + 48));
+    TEST_ASSERT_EQUAL_MEMORY("data", header + 52, 4);
+    TEST_ASSERT_EQUAL(10 * kBlock, readLe32(header + 56));
+
+    // Streaming upload: sizes unknown until the end
+    ImaAdpcmEncoder::buildWavHeader(header, kRate, ImaAdpcmEncoder::kUnknownLength, 0);
+    TEST_ASSERT_EQUAL(ImaAdpcmEncoder::kUnknownLength, readLe32(header + 4));
+    TEST_ASSERT_EQUAL(ImaAdpcmEncoder::kUnknownLength, readLe32(header + 56));
+}
+
+void test_compression_ratio() {
+    // A 6 s command as uploaded: WAV header plus body, PCM against ADPCM
+    const std::vector<int16_t> pcm = speechLike(6.0, 9000, 3);
+    const size_t pcm_bytes = 44 + pcm.size() * sizeof(int16_t);
+    const size_t adpcm_bytes = ImaAdpcmEncoder::kWavHeaderSize + encodeAll(pcm, 4096).size();
+    const double ratio = static_cast<double>(pcm_bytes) / adpcm_bytes;
+    printf("ADPCM upload of 6 s: PCM %u bytes, ADPCM %u bytes, ratio %.2f:1\n", (unsigned)pcm_bytes,
+           (unsigned)adpcm_bytes, ratio);
+    TEST_ASSERT_GREATER_OR_EQUAL(3.9, ratio);
+    TEST_ASSERT_LESS_OR_EQUAL(4.0, ratio);
+}
+
+void test_benchmark() {
+    const std::vector<int16_t> pcm = speechLike(2.0, 9000, 5);
+    std::vector<uint8_t> out(ImaAdpcmEncoder::maxEncodedSize(pcm.size()));
+    ImaAdpcmEncoder encoder;
+    const int rounds = 200;
+    size_t produced = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        encoder.reset();
+        produced += encoder.encode(pcm.data(), pcm.size(), out.data(), out.size());
+    }
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    TEST_ASSERT_GREATER_THAN(0, produced);
+    printf("ADPCM encode: %.2f ns/sample (host)\n", ns / (static_cast<double>(pcm.size()) * rounds));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip_snr);
+    RUN_TEST(test_blocks_start_with_the_sample_verbatim);
+    RUN_TEST(test_chunking_does_not_change_the_output);
+    RUN_TEST(test_wav_header);
+    RUN_TEST(test_compression_ratio);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,215 @@
+// IntentTable (the grammar behind IntentMatcher) over a phrase corpus written
+// the way Whisper transcribes commands: which utterances are handled locally,
+// with which arguments, and which fall through to the LLM.
+
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "utils/intent_grammar.h"
+#include "utils/intent_table.h"
+
+namespace {
+
+// CommandCenter registrations on the device (names only)
+const std::vector<std::string> kRegistered = {
+    "ping", "uptime", "heap", "sd_status", "time", "time_unix", "time_sync", "time_status", "log_tail",
+    "radio_play", "wifi_switch", "bt_pair", "bt_type", "bt_send_key", "bt_mouse_move", "bt_click",
+    "volume_up", "volume_down", "volume_set", "radio_stop", "brightness_up", "brightness_down",
+    "brightness_set", "led_brightness", "system_status", "intent_stats", "intent_reload",
+    "lua_cache_stats", "lua_pool_stats", "lua_sched_stats", "lua_exec", "lua_script",
+    "calendar_list", "calendar_create_alarm",
+};
+
+std::string fixture(const std::string& name) {
+    std::ifstream file(std::string(TEST_PROJECT_DIR) + "/test/test_intent_matcher/fixtures/" + name, std::ios::binary);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+struct Phrase {
+    std::string utterance;
+    std::string expected;   // "command arg|arg", "-" = LLM
+};
+
+std::vector<Phrase> corpus() {
+    std::vector<Phrase> phrases;
+    std::istringstream lines(fixture("phrases.tsv"));
+    std::string line;
+    while (std::getline(lines, line)) {
+        const size_t tab = line.find('\t');
+        if (line.empty() || line[0] == '#' || tab == std::string::npos) {
+            continue;
+        }
+        phrases.push_back({line.substr(0, tab), line.substr(tab + 1)});
+    }
+    return phrases;
+}
+
+std::string describe(const IntentTable::Result& result) {
+    std::string out = result.command;
+    for (size_t i = 0; i < result.args.size(); ++i) {
+        out += (i == 0 ? " " : "|") + result.args[i];
+    }
+    return out;
+}
+
+IntentTable deviceTable() {
+    IntentTable table;
+    TEST_ASSERT_TRUE(table.addUserIntents(fixture("intents.json")));
+    table.addBuiltins(kRegistered);
+    table.addCommandNames(kRegistered);
+    return table;
+}
+
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_normalize_folds_case_accents_and_punctuation() {
+    const std::vector<std::string> words = IntentGrammar::normalize("Più LUMINOSITÀ, per favore! Com'è?");
+    const char* expected[] = {"piu", "luminosita", "per", "favore", "com", "e"};
+    TEST_ASSERT_EQUAL(6, words.size());
+    for (size_t i = 0; i < words.size(); ++i) {
+        TEST_ASSERT_EQUAL_STRING(expected[i], words[i].c_str());
+    }
+}
+
+void test_numbers_in_digits_and_words() {
+    const struct {
+        const char* word;
+        long value;
+    } cases[] = {{"50", 50}, {"zero", 0}, {"dieci", 10}, {"diciannove", 19}, {"venti", 20},
+                 {"ventuno", 21}, {"ventotto", 28}, {"trentatre", 33}, {"settantacinque", 75},
+                 {"novantanove", 99}, {"cento", 100}};
+    for (const auto& item : cases) {
+        long value = -1;
+        size_t consumed = 0;
+        TEST_ASSERT_TRUE(IntentGrammar::parseNumber({item.word}, 0, value, consumed));
+        TEST_ASSERT_EQUAL(item.value, value);
+        TEST_ASSERT_EQUAL(1, consumed);
+    }
+    long value = 0;
+    size_t consumed = 0;
+    TEST_ASSERT_FALSE(IntentGrammar::parseNumber({"ventizero"}, 0, value, consumed));
+    TEST_ASSERT_FALSE(IntentGrammar::parseNumber({"volume"}, 0, value, consumed));
+    TEST_ASSERT_FALSE(IntentGrammar::parseNumber({"1234567890"}, 0, value, consumed));
+}
+
+void test_malformed_patterns_are_rejected() {
+    IntentGrammar grammar;
+    TEST_ASSERT_FALSE(grammar.addPattern(0, "[il] [la]"));              // Nothing required
+    TEST_ASSERT_FALSE(grammar.addPattern(0, "cerca {query:text} ora"));  // Text slot must be last
+    TEST_ASSERT_FALSE(grammar.addPattern(0, "volume {n:numero}"));
+    TEST_ASSERT_FALSE(grammar.addPattern(0, "volume {n}"));
+    TEST_ASSERT_FALSE(grammar.addPattern(0, "alza|l'audio volume"));  // An alternative is one word
+    TEST_ASSERT_EQUAL(0, grammar.size());
+    TEST_ASSERT_TRUE(grammar.addPattern(0, "cerca {query:text}"));
+}
+
+void test_phrase_corpus() {
+    const IntentTable table = deviceTable();
+    const std::vector<Phrase> phrases = corpus();
+    TEST_ASSERT_GREATER_THAN(50u, phrases.size());
+
+    size_t local = 0;
+    size_t expected_local = 0;
+    size_t wrong = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const Phrase& phrase : phrases) {
+        IntentTable::Result result;
+        const std::string got = table.match(phrase.utterance, result) ? describe(result) : "-";
+        local += got != "-" ? 1 : 0;
+        expected_local += phrase.expected != "-" ? 1 : 0;
+        if (got != phrase.expected) {
+            printf("  %-50s expected %-30s got %s\n", phrase.utterance.c_str(), phrase.expected.c_str(), got.c_str());
+            ++wrong;
+        }
+    }
+    const double per_phrase_us = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count() / phrases.size();
+
+    printf("corpus: %u phrases, %u handled locally (%u%%), %u for the LLM, %.1f us per match, %u patterns\n",
+           (unsigned)phrases.size(), (unsigned)local, (unsigned)(100 * local / phrases.size()),
+           (unsigned)(phrases.size() - local), per_phrase_us, (unsigned)table.patterns());
+    TEST_ASSERT_EQUAL(0, wrong);
+    TEST_ASSERT_EQUAL(expected_local, local);
+}
+
+void test_replies_expand_slots() {
+    const IntentTable table = deviceTable();
+    IntentTable::Result result;
+    TEST_ASSERT_TRUE(table.match("Volume a quaranta", result));
+    TEST_ASSERT_EQUAL_STRING("Volume al 40%", result.reply.c_str());
+    TEST_ASSERT_TRUE(table.match("accendi la luce in cucina", result));
+    TEST_ASSERT_EQUAL_STRING("Luce cucina accesa", result.reply.c_str());
+    TEST_ASSERT_TRUE(table.match("system status", result));
+    TEST_ASSERT_EQUAL_STRING("", result.reply.c_str());
+    TEST_ASSERT_EQUAL(0, result.args.size());
+}
+
+void test_user_intents_take_priority() {
+    IntentTable table;
+    TEST_ASSERT_TRUE(table.addUserIntents(
+        R"json({"intents":[{"command":"lua_script","patterns":["alza [il] volume"],"args":["amp.up()"]},
+                           {"command":"lua_script","patterns":["di {text:text}"],"args":["say(\"{text}\")"]},
+                           {"command":"","patterns":["heap"]},
+                           {"command":"heap","patterns":["[solo] [opzionale]"]}]})json"));
+    table.addBuiltins(kRegistered);
+    table.addCommandNames(kRegistered);
+
+    IntentTable::Result result;
+    TEST_ASSERT_TRUE(table.match("Alza il volume", result));
+    TEST_ASSERT_EQUAL_STRING("lua_script", result.command.c_str());
+    TEST_ASSERT_EQUAL_STRING("amp.up()", result.args[0].c_str());
+
+    // Intents without a command or a valid pattern are dropped
+    TEST_ASSERT_TRUE(table.match("heap", result));
+    TEST_ASSERT_EQUAL_STRING("heap", result.command.c_str());
+    TEST_ASSERT_FALSE(table.match("solo", result));
+
+    TEST_ASSERT_TRUE(table.match("di ciao a tutti", result));
+    TEST_ASSERT_EQUAL_STRING("say(\"ciao a tutti\")", result.args[0].c_str());
+
+    TEST_ASSERT_FALSE(table.addUserIntents("{\"intents\": [ broken"));
+}
+
+void test_builtins_need_their_command() {
+    IntentTable table;
+    table.addBuiltins({"volume_up"});
+    table.addCommandNames({"volume_up"});
+    IntentTable::Result result;
+    TEST_ASSERT_TRUE(table.match("alza il volume", result));
+    TEST_ASSERT_TRUE(table.match("volume up", result));
+    TEST_ASSERT_FALSE(table.match("volume al 50", result));
+    TEST_ASSERT_FALSE(table.match("stop", result));
+}
+
+void test_long_utterances_go_to_the_llm() {
+    IntentTable table;
+    TEST_ASSERT_TRUE(table.addUserIntents(R"({"intents":[{"command":"web_search","patterns":["cerca {q:text}"],"args":["{q}"]}]})"));
+    IntentTable::Result result;
+    TEST_ASSERT_TRUE(table.match("cerca ristoranti aperti adesso vicino alla stazione centrale di milano", result));
+    TEST_ASSERT_FALSE(table.match("cerca ristoranti aperti adesso vicino alla stazione centrale di milano con parcheggio gratuito",
+                                  result));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_normalize_folds_case_accents_and_punctuation);
+    RUN_TEST(test_numbers_in_digits_and_words);
+    RUN_TEST(test_malformed_patterns_are_rejected);
+    RUN_TEST(test_phrase_corpus);
+    RUN_TEST(test_replies_expand_slots);
+    RUN_TEST(test_user_intents_take_priority);
+    RUN_TEST(test_builtins_need_their_command);
+    RUN_TEST(test_long_utterances_go_to_the_llm);
+    return UNITY_END();
+}
@@ -0,0 +1,404 @@
+// JsonPathExtractor over recorded API responses (chat completion, Ollama tags,
+// Whisper verbose_json) fed at arbitrary slice sizes, and its peak heap and
+// parse time against the cJSON_Parse() tree the firmware used before.
+
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "utils/json_path_extractor.h"
+
+// Heap accounting for the benchmark: every operator new in the process
+namespace {
+size_t g_heap_now = 0;
+size_t g_heap_peak = 0;
+}
+
+void* operator new(size_t size) {
+    void* block = malloc(size + sizeof(max_align_t));
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    *static_cast<size_t*>(block) = size;
+    g_heap_now += size;
+    g_heap_peak = g_heap_now > g_heap_peak ? g_heap_now : g_heap_peak;
+    return static_cast<char*>(block) + sizeof(max_align_t);
+}
+
+void operator delete(void* pointer) noexcept {
+    if (pointer) {
+        void* block = static_cast<char*>(pointer) - sizeof(max_align_t);
+        g_heap_now -= *static_cast<size_t*>(block);
+        free(block);
+    }
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+namespace {
+
+constexpr int kRounds = 300;
+constexpr size_t kReadSlice = 512;      // An HTTP read on the device
+
+std::string fixture(const std::string& name) {
+    std::ifstream file(std::string(TEST_PROJECT_DIR) + "/test/test_json_path_extractor/fixtures/" + name,
+                       std::ios::binary);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+bool feedSlices(JsonPathExtractor& extractor, const std::string& body, size_t slice) {
+    for (size_t offset = 0; offset < body.size(); offset += slice) {
+        if (!extractor.feed(body.data() + offset, std::min(slice, body.size() - offset))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// What cJSON_Parse() allocates: one node per value with its key and string
+// copied out (struct cJSON: next, prev, child, type, valuestring, valueint,
+// valuedouble, string), built from the whole body held in memory
+struct TreeNode {
+    TreeNode* next = nullptr;
+    TreeNode* prev = nullptr;
+    TreeNode* child = nullptr;
+    int type = 0;
+    char* valuestring = nullptr;
+    int valueint = 0;
+    double valuedouble = 0;
+    char* string = nullptr;
+};
+
+enum TreeType { kTreeNull, kTreeBool, kTreeNumber, kTreeString, kTreeArray, kTreeObject };
+
+void treeDelete(TreeNode* node) {
+    while (node) {
+        TreeNode* next = node->next;
+        treeDelete(node->child);
+        delete[] node->valuestring;
+        delete[] node->string;
+        delete node;
+        node = next;
+    }
+}
+
+void appendUtf8(std::string& out, uint32_t codepoint) {
+    if (codepoint < 0x80) {
+        out += static_cast<char>(codepoint);
+    } else if (codepoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codepoint >> 6));
+        out += static_cast<char>(0x80 | (codepoint & 0x3F));
+    } else if (codepoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codepoint >> 12));
+        out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codepoint & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (codepoint >> 18));
+        out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+}
+
+void skipSpace(const char*& p) {
+    while (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t') {
+        ++p;
+    }
+}
+
+char* treeString(const char*& p) {
+    std::string out;
+    ++p;  // Opening quote
+    while (*p && *p != '"') {
+        if (*p != '\\') {
+            out += *p++;
+            continue;
+        }
+        ++p;
+        const char escape = *p++;
+        switch (escape) {
+            case 'n': out += '\n'; break;
+            case 't': out += '\t'; break;
+            case 'r': out += '\r'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'u': {
+                uint32_t codepoint = strtoul(std::string(p, 4).c_str(), nullptr, 16);
+                p += 4;
+                if (codepoint >= 0xD800 && codepoint < 0xDC00 && p[0] == '\\' && p[1] == 'u') {
+                    const uint32_t low = strtoul(std::string(p + 2, 4).c_str(), nullptr, 16);
+                    codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                    p += 6;
+                }
+                appendUtf8(out, codepoint);
+                break;
+            }
+            default: out += escape; break;
+        }
+    }
+    ++p;  // Closing quote
+    char* copy = new char[out.size() + 1];
+    memcpy(copy, out.c_str(), out.size() + 1);
+    return copy;
+}
+
+TreeNode* treeValue(const char*& p) {
+    skipSpace(p);
+    TreeNode* node = new TreeNode();
+    if (*p == '"') {
+        node->type = kTreeString;
+        node->valuestring = treeString(p);
+    } else if (*p == '{' || *p == '[') {
+        const char close = *p == '{' ? '}' : ']';
+        node->type = *p == '{' ? kTreeObject : kTreeArray;
+        ++p;
+        skipSpace(p);
+        TreeNode* last = nullptr;
+        while (*p && *p != close) {
+            char* key = nullptr;
+            if (node->type == kTreeObject) {
+                key = treeString(p);
+                skipSpace(p);
+                ++p;  // ':'
+            }
+            TreeNode* child = treeValue(p);
+            child->string = key;
+            child->prev = last;
+            (last ? last->next : node->child) = child;
+            last = child;
+            skipSpace(p);
+            if (*p == ',') {
+                ++p;
+                skipSpace(p);
+            }
+        }
+        ++p;
+    } else if (*p == 't' || *p == 'f' || *p == 'n') {
+        node->type = *p == 'n' ? kTreeNull : kTreeBool;
+        node->valueint = *p == 't';
+        p += *p == 'f' ? 5 : 4;
+    } else {
+        char* end = nullptr;
+        node->type = kTreeNumber;
+        node->valuedouble = strtod(p, &end);
+        node->valueint = static_cast<int>(node->valuedouble);
+        p = end;
+    }
+    return node;
+}
+
+TreeNode* treeParse(const std::string& body) {
+    const char* p = body.c_str();
+    return treeValue(p);
+}
+
+TreeNode* treeGet(TreeNode* node, const char* key) {
+    for (TreeNode* child = node ? node->child : nullptr; child; child = child->next) {
+        if (child->string && strcmp(child->string, key) == 0) {
+            return child;
+        }
+    }
+    return nullptr;
+}
+
+TreeNode* treeAt(TreeNode* node, int index) {
+    TreeNode* child = node ? node->child : nullptr;
+    while (child && index-- > 0) {
+        child = child->next;
+    }
+    return child;
+}
+
+// A response body and what the firmware takes out of it
+struct Case {
+    const char* name;
+    const char* fixture;
+    const char* path;
+    std::vector<std::string> (*tree_values)(TreeNode* root);
+};
+
+std::vector<std::string> chatContent(TreeNode* root) {
+    return {treeGet(treeGet(treeAt(treeGet(root, "choices"), 0), "message"), "content")->valuestring};
+}
+
+std::vector<std::string> modelNames(TreeNode* root) {
+    std::vector<std::string> names;
+    for (TreeNode* model = treeGet(root, "models")->child; model; model = model->next) {
+        names.push_back(treeGet(model, "name")->valuestring);
+    }
+    return names;
+}
+
+std::vector<std::string> whisperText(TreeNode* root) {
+    return {treeGet(root, "text")->valuestring};
+}
+
+const Case kCases[] = {
+    {"chat completion", "chat_completion.json", "choices[0].message.content", chatContent},
+    {"ollama tags", "ollama_tags.json", "models[*].name", modelNames},
+    {"whisper verbose", "whisper_verbose.json", "text", whisperText},
+};
+
+// Values the extractor reports for a case, every match in order
+std::vector<std::string> extract(const Case& item, const std::string& body, size_t slice) {
+    std::vector<std::string> values;
+    JsonPathExtractor extractor;
+    TEST_ASSERT_TRUE(extractor.addPath(item.path));
+    extractor.setCallback([&values](size_t, JsonPathExtractor::Type type, const std::string& value) {
+        TEST_ASSERT_EQUAL(static_cast<int>(JsonPathExtractor::Type::String), static_cast<int>(type));
+        values.push_back(value);
+    });
+    TEST_ASSERT_TRUE(feedSlices(extractor, body, slice));
+    TEST_ASSERT_TRUE(extractor.finish());
+    return values;
+}
+
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_fixtures_at_any_slice_size() {
+    for (const Case& item : kCases) {
+        const std::string body = fixture(item.fixture);
+        TEST_ASSERT_FALSE(body.empty());
+        TreeNode* root = treeParse(body);
+        const std::vector<std::string> expected = item.tree_values(root);
+        treeDelete(root);
+
+        for (size_t slice : {1, 2, 3, 7, 64, 512, 4096, 65536}) {
+            const std::vector<std::string> values = extract(item, body, slice);
+            TEST_ASSERT_EQUAL(expected.size(), values.size());
+            for (size_t i = 0; i < values.size(); ++i) {
+                TEST_ASSERT_EQUAL_STRING(expected[i].c_str(), values[i].c_str());
+            }
+        }
+    }
+
+    const std::vector<std::string> names = extract(kCases[1], fixture(kCases[1].fixture), 13);
+    TEST_ASSERT_EQUAL(8, names.size());
+    TEST_ASSERT_EQUAL_STRING("llama3.2:3b", names.front().c_str());
+    TEST_ASSERT_EQUAL_STRING("nomic-embed-text:latest", names.back().c_str());
+}
+
+void test_escapes_types_and_first_match() {
+    const char* doc = "{\"a\\u0062\":[1,{\"x\":\"\\ud83c\\udf1e\\n\\\"q\\\"\\/\"},true],"
+                      "\"b\":{\"c\":null,\"d\":-1.5e3},\"e\":\"\\ud800x\",\"b\":{\"d\":2}}";
+    JsonPathExtractor extractor;
+    for (const char* path : {"ab[1].x", "b.d", "b.c", "ab[2]", "b", "e", "zz"}) {
+        TEST_ASSERT_TRUE(extractor.addPath(path));
+    }
+    for (const char* p = doc; *p; ++p) {
+        TEST_ASSERT_TRUE(extractor.feed(p, 1));
+    }
+    TEST_ASSERT_TRUE(extractor.finish());
+    TEST_ASSERT_EQUAL_STRING("\xF0\x9F\x8C\x9E\n\"q\"/", extractor.value(0).c_str());
+    TEST_ASSERT_EQUAL_STRING("-1.5e3", extractor.value(1).c_str());  // First match, source text
+    TEST_ASSERT_EQUAL(static_cast<int>(JsonPathExtractor::Type::Number), static_cast<int>(extractor.type(1)));
+    TEST_ASSERT_EQUAL(static_cast<int>(JsonPathExtractor::Type::Null), static_cast<int>(extractor.type(2)));
+    TEST_ASSERT_EQUAL(static_cast<int>(JsonPathExtractor::Type::True), static_cast<int>(extractor.type(3)));
+    TEST_ASSERT_EQUAL(static_cast<int>(JsonPathExtractor::Type::Object), static_cast<int>(extractor.type(4)));
+    TEST_ASSERT_EQUAL_STRING("", extractor.value(4).c_str());
+    TEST_ASSERT_EQUAL_STRING("\xEF\xBF\xBDx", extractor.value(5).c_str());  // Lone surrogate: U+FFFD
+    TEST_ASSERT_FALSE(extractor.found(6));
+
+    extractor.reset();
+    TEST_ASSERT_FALSE(extractor.found(0));
+    TEST_ASSERT_TRUE(extractor.feed("{\"b\":{\"d\":7}}", 13));
+    TEST_ASSERT_TRUE(extractor.finish());
+    TEST_ASSERT_EQUAL_STRING("7", extractor.value(1).c_str());
+}
+
+void test_malformed_documents_and_paths() {
+    const char* documents[] = {"{\"a\":}", "{\"a\" 1}", "[1,]x", "{\"a\":\"\x01\"}", "[1 2]", "{}}", "{\"a\":[}"};
+    for (const char* document : documents) {
+        JsonPathExtractor extractor;
+        extractor.addPath("a");
+        TEST_ASSERT_FALSE(extractor.feed(document, strlen(document)));
+        TEST_ASSERT_TRUE(extractor.failed());
+        TEST_ASSERT_FALSE(extractor.finish());
+    }
+
+    JsonPathExtractor truncated;
+    truncated.addPath("a");
+    TEST_ASSERT_TRUE(truncated.feed("{\"a\":\"half", 10));
+    TEST_ASSERT_FALSE(truncated.finish());
+
+    JsonPathExtractor paths;
+    TEST_ASSERT_TRUE(paths.addPath("a[0].b"));
+    TEST_ASSERT_TRUE(paths.addPath("[*]"));
+    for (const char* path : {"a.", "a..b", "[x]", "a.[0]"}) {
+        TEST_ASSERT_FALSE(paths.addPath(path));
+    }
+}
+
+void test_heap_and_time_against_a_tree() {
+    for (const Case& item : kCases) {
+        const std::string body = fixture(item.fixture);
+
+        // Before: the reads appended to a response buffer, then cJSON_Parse()
+        size_t base = g_heap_now;
+        g_heap_peak = base;
+        std::vector<std::string> tree_values;
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < kRounds; ++round) {
+            std::string buffer;
+            for (size_t offset = 0; offset < body.size(); offset += kReadSlice) {
+                buffer.append(body, offset, kReadSlice);
+            }
+            TreeNode* root = treeParse(buffer);
+            tree_values = item.tree_values(root);
+            treeDelete(root);
+        }
+        const double tree_us = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count() / kRounds;
+        const size_t tree_peak = g_heap_peak - base;
+
+        // Now: each read goes straight into the extractor
+        std::vector<std::string> values;
+        JsonPathExtractor extractor;
+        extractor.addPath(item.path);
+        extractor.setCallback([&values](size_t, JsonPathExtractor::Type, const std::string& value) {
+            values.push_back(value);
+        });
+        values.reserve(tree_values.size());
+        base = g_heap_now;
+        g_heap_peak = base;
+        start = std::chrono::steady_clock::now();
+        for (int round = 0; round < kRounds; ++round) {
+            extractor.reset();
+            values.clear();
+            TEST_ASSERT_TRUE(feedSlices(extractor, body, kReadSlice));
+            TEST_ASSERT_TRUE(extractor.finish());
+        }
+        const double extractor_us = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count() / kRounds;
+        const size_t extractor_peak = g_heap_peak - base;
+
+        printf("%-16s %5u B | tree: peak %6u B %7.1f us | extractor: peak %5u B %7.1f us\n", item.name,
+               (unsigned)body.size(), (unsigned)tree_peak, tree_us, (unsigned)extractor_peak, extractor_us);
+        TEST_ASSERT_TRUE(values == tree_values);
+        TEST_ASSERT_LESS_THAN(tree_peak, extractor_peak);
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_fixtures_at_any_slice_size);
+    RUN_TEST(test_escapes_types_and_first_match);
+    RUN_TEST(test_malformed_documents_and_paths);
+    RUN_TEST(test_heap_and_time_against_a_tree);
+    return UNITY_END();
+}
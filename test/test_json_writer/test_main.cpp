@@ -0,0 +1,358 @@
+// JsonWriter: output checked by a strict parser (escapes, control characters,
+// UTF-8, nesting), the counting pass against the streamed length, sink
+// failures, and the peak heap and time of an LLM request body against the
+// cJSON tree + print + copy the firmware used before.
+
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "utils/json_path_extractor.h"
+#include "utils/json_writer.h"
+
+// Heap accounting for the benchmark: every operator new in the process
+namespace {
+size_t g_heap_now = 0;
+size_t g_heap_peak = 0;
+}
+
+void* operator new(size_t size) {
+    void* block = malloc(size + sizeof(max_align_t));
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    *static_cast<size_t*>(block) = size;
+    g_heap_now += size;
+    g_heap_peak = g_heap_now > g_heap_peak ? g_heap_now : g_heap_peak;
+    return static_cast<char*>(block) + sizeof(max_align_t);
+}
+
+void operator delete(void* pointer) noexcept {
+    if (pointer) {
+        void* block = static_cast<char*>(pointer) - sizeof(max_align_t);
+        g_heap_now -= *static_cast<size_t*>(block);
+        free(block);
+    }
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+namespace {
+
+constexpr int kRounds = 300;
+
+struct Message {
+    std::string role;
+    std::string content;
+};
+
+// The request makeGPTRequest sends: system prompt, summary, history turns
+struct Request {
+    std::string model = "gpt-4o-mini";
+    std::string system_prompt;
+    std::string summary;
+    std::vector<Message> turns;
+};
+
+void writeRequest(JsonWriter& json, const Request& request) {
+    json.beginObject();
+    json.key("model").value(request.model);
+    json.key("messages").beginArray();
+    json.beginObject().key("role").value("system").key("content").value(request.system_prompt).endObject();
+    json.beginObject().key("role").value("system").key("content")
+        .beginString()
+        .stringPart(std::string("Summary of the earlier conversation: "))
+        .stringPart(request.summary)
+        .endString()
+        .endObject();
+    for (const Message& turn : request.turns) {
+        json.beginObject().key("role").value(turn.role).key("content").value(turn.content).endObject();
+    }
+    json.endArray();
+    json.key("temperature").value(0.7);
+    json.key("stream").value(true);
+    json.endObject();
+}
+
+// 12 KB prompt, 40 turns and a summary: about 26 KB of body
+Request largeRequest() {
+    Request request;
+    while (request.system_prompt.size() < 12 * 1024) {
+        request.system_prompt += "You are a voice assistant on an ESP32. Reply in short sentences.\n"
+                                 "Commands: \"volume_set(n)\", \"bt_type(mac, text)\", \t\"led(r,g,b)\".\n";
+    }
+    request.summary = "The user asked about the weather in Rome and set the volume to 30%.";
+    for (int i = 0; i < 40; ++i) {
+        Message turn;
+        turn.role = i % 2 ? "assistant" : "user";
+        while (turn.content.size() < 300) {
+            turn.content += i % 2 ? "Domani sarà soleggiato, massima 24\xC2\xB0" "C.\nCommand: volume_set(30) "
+                                  : "Che tempo fa domani? \"Roma\" \\ centro ";
+        }
+        request.turns.push_back(turn);
+    }
+    return request;
+}
+
+std::string write(const std::function<void(JsonWriter&)>& body) {
+    std::string out;
+    JsonWriter json(JsonWriter::appendTo(out));
+    body(json);
+    TEST_ASSERT_TRUE(json.finish());
+    TEST_ASSERT_EQUAL(out.size(), json.size());
+    return out;
+}
+
+// Parses the document strictly and returns the decoded value at path
+std::string parsed(const std::string& document, const char* path) {
+    JsonPathExtractor extractor;
+    extractor.addPath(path);
+    TEST_ASSERT_TRUE(extractor.feed(document.data(), document.size()));
+    TEST_ASSERT_TRUE(extractor.finish());
+    return extractor.value(0);
+}
+
+// What the cJSON request cost: one node per value with its key and string
+// copied in, cJSON_PrintUnformatted() into a growing buffer, then the
+// printed text copied into the request body
+struct TreeNode {
+    TreeNode* next = nullptr;
+    TreeNode* child = nullptr;
+    char* key = nullptr;
+    char* text = nullptr;
+    int type = 0;   // 0 string, 1 number, 2 true, 3 object, 4 array
+};
+
+char* copyOf(const std::string& text) {
+    char* copy = static_cast<char*>(operator new(text.size() + 1));
+    memcpy(copy, text.c_str(), text.size() + 1);
+    return copy;
+}
+
+TreeNode* add(TreeNode*& tail, TreeNode* parent, const char* key, int type, const std::string& text = "") {
+    TreeNode* node = new TreeNode();
+    node->type = type;
+    node->key = key ? copyOf(key) : nullptr;
+    node->text = type == 0 ? copyOf(text) : nullptr;
+    (tail ? tail->next : parent->child) = node;
+    tail = node;
+    return node;
+}
+
+void treeDelete(TreeNode* node) {
+    while (node) {
+        TreeNode* next = node->next;
+        treeDelete(node->child);
+        operator delete(node->key);
+        operator delete(node->text);
+        delete node;
+        node = next;
+    }
+}
+
+void treePrint(const TreeNode* node, std::string& out) {
+    auto quoted = [&out](const char* text) {
+        JsonWriter json(JsonWriter::appendTo(out));
+        json.value(text);
+        json.finish();
+    };
+    for (bool first = true; node; node = node->next, first = false) {
+        if (!first) {
+            out += ',';
+        }
+        if (node->key) {
+            quoted(node->key);
+            out += ':';
+        }
+        switch (node->type) {
+            case 0: quoted(node->text); break;
+            case 1: out += "0.7"; break;
+            case 2: out += "true"; break;
+            default:
+                out += node->type == 3 ? '{' : '[';
+                treePrint(node->child, out);
+                out += node->type == 3 ? '}' : ']';
+                break;
+        }
+    }
+}
+
+std::string treeRequest(const Request& request) {
+    TreeNode root;
+    root.type = 3;
+    TreeNode* fields = nullptr;
+    add(fields, &root, "model", 0, request.model);
+    TreeNode* messages = add(fields, &root, "messages", 4);
+    TreeNode* items = nullptr;
+    auto message = [&](const std::string& role, const std::string& content) {
+        TreeNode* object = add(items, messages, nullptr, 3);
+        TreeNode* members = nullptr;
+        add(members, object, "role", 0, role);
+        add(members, object, "content", 0, content);
+    };
+    message("system", request.system_prompt);
+    message("system", "Summary of the earlier conversation: " + request.summary);
+    for (const Message& turn : request.turns) {
+        message(turn.role, turn.content);
+    }
+    add(fields, &root, "temperature", 1);
+    add(fields, &root, "stream", 2);
+
+    std::string printed = "{";
+    treePrint(root.child, printed);
+    printed += '}';
+    std::string body(printed);
+    treeDelete(root.child);
+    return body;
+}
+
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_escapes_and_utf8_round_trip() {
+    std::string all_controls;
+    for (int c = 1; c < 0x20; ++c) {
+        all_controls += static_cast<char>(c);
+    }
+    const std::string texts[] = {
+        "plain",
+        "quote \" backslash \\ slash /",
+        "tab\tline\nreturn\rback\bfeed\f",
+        all_controls,
+        std::string("nul\0byte", 8),
+        "UTF-8: \xC3\xA8 \xE2\x82\xAC \xF0\x9F\x8C\x9E",
+        "",
+    };
+    for (const std::string& text : texts) {
+        const std::string document = write([&text](JsonWriter& json) {
+            json.beginObject().key("k\"ey").value(text).endObject();
+        });
+        TEST_ASSERT_TRUE(parsed(document, "k\"ey") == text);
+    }
+    TEST_ASSERT_EQUAL_STRING("{\"a\":\"\\u0001\\u001f\\n\\\"\"}", write([](JsonWriter& json) {
+        json.beginObject().key("a").value("\x01\x1f\n\"").endObject();
+    }).c_str());
+    TEST_ASSERT_EQUAL_STRING("[\"nul\\u0000byte\"]", write([](JsonWriter& json) {
+        json.beginArray().value("nul\0byte", 8).endArray();
+    }).c_str());
+}
+
+void test_structure_and_scalars() {
+    const std::string document = write([](JsonWriter& json) {
+        json.beginObject();
+        json.key("a").beginArray().value(1).value(int64_t(-9007199254740993LL)).value(0.1).value(1e300)
+            .value(true).value(false).null().value(static_cast<const char*>(nullptr)).endArray();
+        json.key("b").beginObject().key("c").beginArray().endArray().key("d").beginObject().endObject()
+            .endObject();
+        json.key("e").beginString().stringPart("one, ").stringPart(std::string("two")).endString();
+        json.key("f").value(0.0 / 0.0);
+        json.endObject();
+    });
+    TEST_ASSERT_EQUAL_STRING("{\"a\":[1,-9007199254740993,0.1,1e+300,true,false,null,null],"
+                             "\"b\":{\"c\":[],\"d\":{}},\"e\":\"one, two\",\"f\":null}",
+                             document.c_str());
+    TEST_ASSERT_EQUAL_STRING("one, two", parsed(document, "e").c_str());
+    TEST_ASSERT_EQUAL_STRING("0.1", parsed(document, "a[2]").c_str());
+}
+
+void test_counting_pass_matches_the_stream() {
+    const Request request = largeRequest();
+    JsonWriter counter;
+    writeRequest(counter, request);
+    TEST_ASSERT_TRUE(counter.finish());
+
+    // Sink pieces never exceed the staging buffer except for long runs passed through
+    std::string body;
+    size_t writes = 0;
+    JsonWriter json([&body, &writes](const char* data, size_t length) {
+        body.append(data, length);
+        ++writes;
+        return true;
+    });
+    writeRequest(json, request);
+    TEST_ASSERT_TRUE(json.finish());
+    TEST_ASSERT_EQUAL(body.size(), counter.size());
+    TEST_ASSERT_LESS_THAN(body.size() / 64, writes);
+
+    TEST_ASSERT_TRUE(parsed(body, "messages[0].content") == request.system_prompt);
+    TEST_ASSERT_TRUE(parsed(body, "messages[41].content") == request.turns[39].content);
+    TEST_ASSERT_TRUE(body == treeRequest(request));
+}
+
+void test_sink_failure_stops_writing() {
+    size_t delivered = 0;
+    JsonWriter json([&delivered](const char*, size_t length) {
+        if (delivered > 1000) {
+            return false;   // The connection dropped
+        }
+        delivered += length;
+        return true;
+    });
+    writeRequest(json, largeRequest());
+    TEST_ASSERT_FALSE(json.finish());
+    TEST_ASSERT_FALSE(json.ok());
+    TEST_ASSERT_LESS_THAN(1000 + JsonWriter::kStagingBytes + 1, delivered);
+}
+
+void test_heap_and_time_against_a_tree() {
+    const Request request = largeRequest();
+
+    // Before: cJSON tree, printed, copied into the body, sent
+    size_t base = g_heap_now;
+    g_heap_peak = base;
+    size_t tree_length = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < kRounds; ++round) {
+        tree_length = treeRequest(request).size();
+    }
+    const double tree_us = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count() / kRounds;
+    const size_t tree_peak = g_heap_peak - base;
+
+    // Now: count, then stream into the connection
+    size_t sent = 0;
+    base = g_heap_now;
+    g_heap_peak = base;
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < kRounds; ++round) {
+        JsonWriter counter;
+        writeRequest(counter, request);
+        sent = 0;
+        JsonWriter json([&sent](const char*, size_t length) {
+            sent += length;
+            return true;
+        });
+        writeRequest(json, request);
+        TEST_ASSERT_TRUE(json.finish());
+        TEST_ASSERT_EQUAL(counter.size(), sent);
+    }
+    const double writer_us = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count() / kRounds;
+    const size_t writer_peak = g_heap_peak - base;
+
+    printf("%u B body | tree + print + copy: peak %6u B %6.1f us | JsonWriter count + stream: peak %4u B %6.1f us\n",
+           (unsigned)sent, (unsigned)tree_peak, tree_us, (unsigned)writer_peak, writer_us);
+    TEST_ASSERT_EQUAL(tree_length, sent);
+    TEST_ASSERT_GREATER_THAN(3 * sent, tree_peak);
+    TEST_ASSERT_LESS_OR_EQUAL(1024, writer_peak);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_escapes_and_utf8_round_trip);
+    RUN_TEST(test_structure_and_scalars);
+    RUN_TEST(test_counting_pass_matches_the_stream);
+    RUN_TEST(test_sink_failure_stops_writing);
+    RUN_TEST(test_heap_and_time_against_a_tree);
+    return UNITY_END();
+}
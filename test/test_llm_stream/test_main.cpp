@@ -0,0 +1,272 @@
+// LlmStreamParser over recorded OpenAI SSE / Ollama NDJSON replies: split at
+// arbitrary byte boundaries, and replayed by a local stand-in server with token
+// delays, read through HttpClientPool the way VoiceAssistant::readGPTStream()
+// does.
+
+#include <unity.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/http_client_pool.h"
+#include "stand_in_server.h"
+#include "utils/llm_stream_parser.h"
+
+namespace {
+
+constexpr uint32_t kTokenDelayMs = 15;
+constexpr int kReadBytes = 64;          // LLM_STREAM_READ_BYTES in voice_assistant.cpp
+
+struct Expected {
+    const char* fixture;
+    const char* command_json;           // nullptr: no command object
+    const char* text;
+    const char* error;                  // Substring of error(), nullptr: none
+};
+
+const Expected kCases[] = {
+    {"openai_command.sse",
+     R"({"command": "volume_up", "args": ["20"], "text": "Ho alzato il volume al 20%."})",
+     "Ho alzato il volume al 20%.", nullptr},
+    {"openai_escapes.sse",
+     R"({"command":"web_search","args":["{\"q\":\"meteo }\"}"],"text":"Ecco \"il meteo\" è pronto\nciao 😀"})",
+     "Ecco \"il meteo\" è pronto\nciao 😀", nullptr},
+    {"ollama_command.ndjson",
+     "{\n  \"command\": \"light_on\",\n  \"args\": [\"cucina\"],\n  \"text\": \"Accendo la luce in cucina.\"\n}",
+     "Accendo la luce in cucina.", nullptr},
+    {"ollama_prose.ndjson", nullptr,
+     "Non ho trovato un comando adatto, ma posso aiutarti a cercarlo.", nullptr},
+    {"openai_full.json",
+     R"({"command": "none", "args": [], "text": "Ciao! Come posso aiutarti?"})",
+     "Ciao! Come posso aiutarti?", nullptr},
+    {"openai_error.sse", nullptr, "", "does not exist"},
+};
+
+std::string fixture(const std::string& name) {
+    std::ifstream file(std::string(TEST_PROJECT_DIR) + "/test/test_llm_stream/fixtures/" + name, std::ios::binary);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+// The events (SSE) or lines (NDJSON) the server wrote one at a time
+std::vector<std::string> records(const std::string& body) {
+    const std::string separator = body.compare(0, 5, "data:") == 0 ? "\n\n" : "\n";
+    std::vector<std::string> result;
+    size_t start = 0;
+    while (start < body.size()) {
+        size_t end = body.find(separator, start);
+        end = end == std::string::npos ? body.size() : end + separator.size();
+        result.push_back(body.substr(start, end - start));
+        start = end;
+    }
+    return result;
+}
+
+void checkResult(const Expected& expected, const LlmStreamParser& parser) {
+    TEST_ASSERT_EQUAL_STRING(expected.text, parser.displayText().c_str());
+    if (expected.command_json) {
+        TEST_ASSERT_TRUE(parser.commandReady());
+        TEST_ASSERT_EQUAL_STRING(expected.command_json, parser.commandJson().c_str());
+    } else {
+        TEST_ASSERT_FALSE(parser.commandReady());
+    }
+    if (expected.error) {
+        TEST_ASSERT_NOT_NULL(strstr(parser.error().c_str(), expected.error));
+    } else {
+        TEST_ASSERT_TRUE(parser.error().empty());
+    }
+}
+
+uint32_t elapsedMs(std::chrono::steady_clock::time_point since) {
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - since).count());
+}
+
+// Replays fixtures: "/<fixture>" streams its records kTokenDelayMs apart; the
+// non-streamed completion arrives in one piece after the whole generation time
+struct ReplayServer {
+    std::atomic<size_t> records_sent{0};
+    std::atomic<bool> client_left{false};
+    StandInServer server{[this](const StandInServer::Request& request, StandInServer::Response& response) {
+        const std::string name = request.path.substr(1);
+        const std::string body = fixture(name);
+        const std::vector<std::string> parts = records(body);
+        records_sent = 0;
+        client_left = false;
+        if (name.find(".json") != std::string::npos) {
+            response.sleepMs(kTokenDelayMs * 20);
+            response.reply(200, "application/json", body);
+            records_sent = 1;
+            return;
+        }
+        response.begin(200, name.find(".sse") != std::string::npos ? "text/event-stream" : "application/x-ndjson");
+        for (const std::string& part : parts) {
+            response.sleepMs(kTokenDelayMs);
+            if (!response.send(part)) {
+                client_left = true;
+                return;
+            }
+            ++records_sent;
+        }
+    }};
+};
+
+// Shared by the tests: a failed assertion unwinds without running destructors
+ReplayServer g_replay;
+
+struct StreamTiming {
+    uint32_t first_delta_ms = 0;
+    uint32_t command_ready_ms = 0;
+    uint32_t finished_ms = 0;
+    uint32_t updates = 0;
+};
+
+// VoiceAssistant::readGPTStream() against the stand-in server
+bool streamReply(const std::string& url, LlmStreamParser& parser, StreamTiming& timing) {
+    HttpClientPool& pool = HttpClientPool::getInstance();
+    HttpClientPool::Options options;
+    options.stage = "llm";
+    options.timeout_ms = 5000;
+    esp_http_client_handle_t client = pool.acquire(url, options);
+    TEST_ASSERT_NOT_NULL(client);
+    pool.setHeader(client, "Content-Type", "application/json");
+
+    const std::string request = R"({"model":"test","stream":true,"messages":[]})";
+    const auto start = std::chrono::steady_clock::now();
+    int content_length = 0;
+    const int status = pool.request(client, request.data(), request.size(), content_length);
+    if (status != 200) {
+        pool.release(client);
+        return false;
+    }
+
+    char chunk[kReadBytes];
+    bool ok = true;
+    while (true) {
+        const int read_len = pool.read(client, chunk, sizeof(chunk));
+        if (read_len < 0) {
+            ok = false;
+            break;
+        }
+        if (read_len == 0) {
+            break;
+        }
+        timing.updates += parser.feed(chunk, read_len) ? 1 : 0;
+        if (!timing.first_delta_ms && parser.deltaCount() > 0) {
+            timing.first_delta_ms = elapsedMs(start);
+        }
+        if (parser.commandReady()) {
+            timing.command_ready_ms = elapsedMs(start);
+            break;
+        }
+        if (parser.done()) {
+            break;
+        }
+    }
+    parser.finish();
+    timing.finished_ms = elapsedMs(start);
+    pool.release(client);
+    return ok;
+}
+
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_parser_is_independent_of_slice_boundaries() {
+    for (const Expected& expected : kCases) {
+        const std::string body = fixture(expected.fixture);
+        TEST_ASSERT_FALSE(body.empty());
+        for (size_t step : {1, 2, 3, 5, 7, 13, 64, 4096}) {
+            LlmStreamParser parser;
+            for (size_t offset = 0; offset < body.size(); offset += step) {
+                parser.feed(body.data() + offset, std::min(step, body.size() - offset));
+            }
+            parser.finish();
+            checkResult(expected, parser);
+        }
+    }
+}
+
+void test_command_is_ready_before_the_stream_ends() {
+    for (const Expected& expected : kCases) {
+        const std::string body = fixture(expected.fixture);
+        if (!expected.command_json || std::string(expected.fixture).find(".json") != std::string::npos) {
+            continue;  // Streamed command replies only
+        }
+        LlmStreamParser parser;
+        size_t ready_at = 0;
+        for (size_t offset = 0; offset < body.size() && !ready_at; ++offset) {
+            parser.feed(body.data() + offset, 1);
+            ready_at = parser.commandReady() ? offset + 1 : 0;
+        }
+        TEST_ASSERT_NOT_EQUAL(0, ready_at);
+        // The stream still carries the stop event (and any trailing tokens)
+        TEST_ASSERT_LESS_THAN(body.size(), ready_at);
+        TEST_ASSERT_EQUAL_STRING(expected.command_json, parser.commandJson().c_str());
+    }
+}
+
+void test_replayed_streams_through_the_pool() {
+    for (const Expected& expected : kCases) {
+        const size_t total_records = records(fixture(expected.fixture)).size();
+        const uint32_t stream_ms = static_cast<uint32_t>(total_records) * kTokenDelayMs;
+
+        LlmStreamParser parser;
+        StreamTiming timing;
+        TEST_ASSERT_TRUE(streamReply(g_replay.server.url(std::string("/") + expected.fixture), parser, timing));
+        checkResult(expected, parser);
+        printf("%-22s first delta %4u ms, command ready %4u ms, read done %4u ms, full stream %4u ms, %u updates\n",
+               expected.fixture, (unsigned)timing.first_delta_ms, (unsigned)timing.command_ready_ms,
+               (unsigned)timing.finished_ms, (unsigned)stream_ms, (unsigned)timing.updates);
+
+        if (parser.deltaCount() > 1) {
+            // Text is published as it arrives, not once at the end
+            TEST_ASSERT_GREATER_THAN(1u, timing.updates);
+            TEST_ASSERT_LESS_THAN(timing.finished_ms, timing.first_delta_ms + kTokenDelayMs);
+        }
+    }
+}
+
+void test_reading_stops_at_the_command_object() {
+    // Eleven trailing prose tokens follow the fenced command object
+    const char* name = "ollama_command.ndjson";
+    const size_t total_records = records(fixture(name)).size();
+    LlmStreamParser parser;
+    StreamTiming timing;
+    TEST_ASSERT_TRUE(streamReply(g_replay.server.url(std::string("/") + name), parser, timing));
+    TEST_ASSERT_TRUE(parser.commandReady());
+    TEST_ASSERT_EQUAL(std::string::npos, parser.content().find("Se vuoi"));
+    TEST_ASSERT_LESS_THAN((total_records - 5) * kTokenDelayMs, timing.command_ready_ms);
+
+    // The connection was dropped, so the server stopped sending the tail
+    for (int i = 0; i < 100 && !g_replay.client_left; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(kTokenDelayMs));
+    }
+    TEST_ASSERT_TRUE(g_replay.client_left);
+    TEST_ASSERT_LESS_THAN(total_records, g_replay.records_sent.load());
+}
+
+int main() {
+    if (!g_replay.server.start()) {
+        return 1;
+    }
+    UNITY_BEGIN();
+    RUN_TEST(test_parser_is_independent_of_slice_boundaries);
+    RUN_TEST(test_command_is_ready_before_the_stream_ends);
+    RUN_TEST(test_replayed_streams_through_the_pool);
+    RUN_TEST(test_reading_stops_at_the_command_object);
+    const int failures = UNITY_END();
+    g_replay.server.stop();
+    return failures;
+}
@@ -0,0 +1,315 @@
+// LuaArena: a large block whose shrink to a small size falls back to keeping
+// it stays accounted as large, random churn with injected heap failures keeps
+// block contents, and a fragmentation report over allocation-heavy Lua scripts
+// against the C heap (peak bytes held by malloc for the same script).
+
+#include <unity.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <esp_heap_caps.h>
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+}
+
+#include "utils/lua_arena.h"
+
+namespace {
+
+struct Script {
+    const char* name;
+    const char* code;
+};
+
+const Script kScripts[] = {
+    {"tables",
+     "local t = {}\n"
+     "for i = 1, 2000 do t[i] = {x = i, y = i * 2, name = 'n' .. i} end\n"
+     "for i = 1, 2000, 2 do t[i] = nil end\n"
+     "collectgarbage()\n"
+     "for i = 1, 2000, 2 do t[i] = {i, i + 1, i + 2} end\n"
+     "return #t"},
+    {"strings",
+     "local parts = {}\n"
+     "for i = 1, 3000 do parts[#parts + 1] = string.format('%d:%s', i, string.rep('a', i % 40)) end\n"
+     "local s = table.concat(parts, ',')\n"
+     "local n = 0\n"
+     "for w in s:gmatch('[^,]+') do n = n + #w end\n"
+     "return n"},
+    {"closures",
+     "local fs = {}\n"
+     "for i = 1, 1500 do fs[i] = function() return i end end\n"
+     "local sum = 0\n"
+     "for i = 1, #fs do sum = sum + fs[i]() end\n"
+     "fs = nil\n"
+     "collectgarbage()\n"
+     "return sum"},
+    {"records",
+     "local rows = {}\n"
+     "for d = 1, 200 do local r = {} for k = 1, 12 do r['k' .. k] = d * k end rows[d] = r end\n"
+     "local acc = {}\n"
+     "for _, r in ipairs(rows) do acc[#acc + 1] = r.k3 .. '/' .. r.k7 end\n"
+     "return #table.concat(acc, ';')"},
+    {"grow_shrink",
+     "local t = {}\n"
+     "for i = 1, 8000 do t[i] = i end\n"
+     "for i = 8000, 1, -1 do t[i] = nil end\n"
+     "collectgarbage()\n"
+     "t.x = 1\n"
+     "local u = {}\n"
+     "for i = 1, 100 do u[i] = i end\n"
+     "return #u"},
+};
+
+// The C heap as the baseline: bytes held and the peak
+struct HeapCount {
+    size_t current = 0;
+    size_t peak = 0;
+};
+
+void* countingAlloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+    HeapCount* count = static_cast<HeapCount*>(ud);
+    if (!ptr) {
+        osize = 0;
+    }
+    if (nsize == 0) {
+        free(ptr);
+        count->current -= osize;
+        return nullptr;
+    }
+    void* result = realloc(ptr, nsize);
+    if (result) {
+        count->current = count->current + nsize - osize;
+        count->peak = count->current > count->peak ? count->current : count->peak;
+    }
+    return result;
+}
+
+bool runScript(lua_State* L, const char* code) {
+    if (luaL_dostring(L, code) != LUA_OK) {
+        printf("  error: %s\n", lua_tostring(L, -1));
+        lua_pop(L, 1);
+        return false;
+    }
+    lua_settop(L, 0);
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    return true;
+}
+
+void* arenaAlloc(LuaArena& arena, void* ptr, size_t osize, size_t nsize) {
+    return LuaArena::alloc(&arena, ptr, osize, nsize);
+}
+
+// Deterministic pattern so moved blocks can be checked
+uint8_t patternByte(uint32_t seed, size_t i) {
+    return static_cast<uint8_t>(seed * 31 + i * 7);
+}
+
+uint32_t nextRandom(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+} // namespace
+
+void setUp() {
+    host_heap::failNext() = 0;
+}
+
+void tearDown() {
+    host_heap::failNext() = 0;
+}
+
+void test_failed_shrink_keeps_a_large_block_large() {
+    LuaArena arena;
+    uint8_t* big = static_cast<uint8_t*>(arenaAlloc(arena, nullptr, LUA_TTABLE, 4096));
+    TEST_ASSERT_NOT_NULL(big);
+    memset(big, 0xAB, 4096);
+
+    // No page yet and the heap refuses one (PSRAM, then internal): the block is kept
+    host_heap::failNext() = 2;
+    TEST_ASSERT_EQUAL_PTR(big, arenaAlloc(arena, big, 4096, 100));
+    TEST_ASSERT_EQUAL(0, host_heap::failNext());
+    TEST_ASSERT_EQUAL(100, arena.stats().current);
+
+    void* other = arenaAlloc(arena, nullptr, LUA_TSTRING, 100);
+    TEST_ASSERT_NOT_NULL(other);
+    const size_t footprint = arena.stats().footprint;
+
+    // Freed as the large block it is (4096 bytes and a 32-byte header), not
+    // pushed onto the 128-byte free list
+    arenaAlloc(arena, big, 100, 0);
+    TEST_ASSERT_EQUAL(0, arena.stats().free_listed);
+    TEST_ASSERT_EQUAL(footprint - 4096 - 32, arena.stats().footprint);
+    void* reused = arenaAlloc(arena, nullptr, LUA_TSTRING, 100);
+    TEST_ASSERT_TRUE(reused != big);
+
+    // A kept block that grows again is resized as a large block, contents intact
+    LuaArena fresh;
+    uint8_t* kept = static_cast<uint8_t*>(arenaAlloc(fresh, nullptr, LUA_TTABLE, 2048));
+    memset(kept, 0x5C, 2048);
+    host_heap::failNext() = 2;
+    TEST_ASSERT_EQUAL_PTR(kept, arenaAlloc(fresh, kept, 2048, 64));
+    uint8_t* grown = static_cast<uint8_t*>(arenaAlloc(fresh, kept, 64, 3000));
+    TEST_ASSERT_NOT_NULL(grown);
+    for (size_t i = 0; i < 64; ++i) {
+        TEST_ASSERT_EQUAL_HEX8(0x5C, grown[i]);
+    }
+    TEST_ASSERT_EQUAL(0, fresh.stats().free_listed);
+    arenaAlloc(fresh, grown, 3000, 0);
+    TEST_ASSERT_EQUAL(0, fresh.stats().footprint);
+
+    arenaAlloc(arena, other, 100, 0);
+    arenaAlloc(arena, reused, 100, 0);
+}
+
+void test_random_churn_keeps_contents() {
+    constexpr size_t kSlots = 256;
+    constexpr int kOperations = 40000;
+    struct Slot {
+        uint8_t* ptr = nullptr;
+        size_t size = 0;
+        uint32_t seed = 0;
+    };
+    std::vector<Slot> slots(kSlots);
+    LuaArena arena(8 * 1024 * 1024);
+    uint32_t random = 12345;
+    uint32_t kept = 0;
+    size_t live = 0;
+
+    auto intact = [](const Slot& slot, size_t bytes) {
+        for (size_t i = 0; i < bytes; ++i) {
+            if (slot.ptr[i] != patternByte(slot.seed, i)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    for (int op = 0; op < kOperations; ++op) {
+        Slot& slot = slots[nextRandom(random) % kSlots];
+        // Mostly small blocks, some large ones, many crossing kMaxSmallBytes
+        const uint32_t pick = nextRandom(random) % 100;
+        const size_t size = pick < 70 ? 1 + nextRandom(random) % 256
+                          : pick < 90 ? 400 + nextRandom(random) % 300
+                          : 1024 + nextRandom(random) % 8192;
+        if (op % 53 == 0) {
+            host_heap::failNext() = 2;
+        }
+
+        if (!slot.ptr) {
+            uint8_t* ptr = static_cast<uint8_t*>(arenaAlloc(arena, nullptr, LUA_TSTRING, size));
+            if (ptr) {
+                slot = {ptr, size, static_cast<uint32_t>(op)};
+                for (size_t i = 0; i < size; ++i) {
+                    ptr[i] = patternByte(slot.seed, i);
+                }
+                live += size;
+            }
+        } else if (pick % 3 == 0) {
+            TEST_ASSERT_TRUE(intact(slot, slot.size));
+            arenaAlloc(arena, slot.ptr, slot.size, 0);
+            live -= slot.size;
+            slot = Slot();
+        } else {
+            uint8_t* ptr = static_cast<uint8_t*>(arenaAlloc(arena, slot.ptr, slot.size, size));
+            if (!ptr) {
+                TEST_ASSERT_TRUE(size > slot.size);     // Only growing may fail
+                TEST_ASSERT_TRUE(intact(slot, slot.size));
+            } else {
+                kept += ptr == slot.ptr && size < slot.size;
+                const size_t common = size < slot.size ? size : slot.size;
+                slot.ptr = ptr;
+                TEST_ASSERT_TRUE(intact(slot, common));
+                for (size_t i = common; i < size; ++i) {
+                    ptr[i] = patternByte(slot.seed, i);
+                }
+                live = live - slot.size + size;
+                slot.size = size;
+            }
+        }
+        host_heap::failNext() = 0;
+        TEST_ASSERT_EQUAL(live, arena.stats().current);
+    }
+
+    for (Slot& slot : slots) {
+        if (slot.ptr) {
+            TEST_ASSERT_TRUE(intact(slot, slot.size));
+            arenaAlloc(arena, slot.ptr, slot.size, 0);
+        }
+    }
+    TEST_ASSERT_EQUAL(0, arena.stats().current);
+    // Only pages are left: every large block went back to the heap
+    TEST_ASSERT_EQUAL(0, arena.stats().footprint % LuaArena::kPageBytes);
+    printf("churn: %d operations, %u blocks kept in place on a shrink, %u failures, %u KB of pages left\n",
+           kOperations, (unsigned)kept, (unsigned)arena.stats().failures,
+           (unsigned)(arena.stats().footprint / 1024));
+}
+
+void test_lua_scripts_fragmentation_report() {
+    // heap peak: bytes malloc held for the same script; lua peak: bytes Lua held in the
+    // arena; pages kept / rerun: footprint after a full GC, after one and two runs;
+    // unused: fragmentation() after the first run's GC (free lists and page tails)
+    printf("%-12s %9s %9s %10s %9s %6s %8s\n", "script", "heap peak", "lua peak", "pages kept", "rerun", "unused",
+           "allocs");
+    for (const Script& script : kScripts) {
+        HeapCount heap;
+        lua_State* baseline = lua_newstate(countingAlloc, &heap);
+        luaL_openlibs(baseline);
+        TEST_ASSERT_TRUE_MESSAGE(runScript(baseline, script.code), script.name);
+        lua_close(baseline);
+
+        LuaArena arena;
+        lua_State* L = lua_newstate(LuaArena::alloc, &arena);
+        TEST_ASSERT_NOT_NULL(L);
+        luaL_openlibs(L);
+        TEST_ASSERT_TRUE_MESSAGE(runScript(L, script.code), script.name);
+        const LuaArena::Stats first = arena.stats();
+        const uint32_t fragmentation = arena.fragmentation();
+
+        // The second run reuses the free lists instead of growing the pages
+        TEST_ASSERT_TRUE_MESSAGE(runScript(L, script.code), script.name);
+        const LuaArena::Stats second = arena.stats();
+        TEST_ASSERT_EQUAL(0, second.failures);
+        TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(first.footprint + LuaArena::kPageBytes, second.footprint, script.name);
+
+        printf("%-12s %8uK %8uK %9uK %8uK %5u%% %8u\n", script.name, (unsigned)(heap.peak / 1024),
+               (unsigned)(first.peak / 1024), (unsigned)(first.footprint / 1024),
+               (unsigned)(second.footprint / 1024), (unsigned)fragmentation, (unsigned)second.allocations);
+        lua_close(L);
+        TEST_ASSERT_EQUAL(0, arena.stats().current);
+    }
+}
+
+void test_limit_fails_the_script_not_the_state() {
+    LuaArena arena(96 * 1024);
+    lua_State* L = lua_newstate(LuaArena::alloc, &arena);
+    TEST_ASSERT_NOT_NULL(L);
+    luaL_openlibs(L);
+
+    const int status = luaL_dostring(L, "local t = {} for i = 1, 100000 do t[i] = 'row ' .. i end return #t");
+    TEST_ASSERT_TRUE(status != LUA_OK);
+    TEST_ASSERT_EQUAL_STRING("not enough memory", lua_tostring(L, -1));
+    TEST_ASSERT_GREATER_THAN(0, arena.stats().failures);
+    TEST_ASSERT_LESS_OR_EQUAL(96 * 1024, arena.stats().peak);
+    lua_settop(L, 0);
+
+    TEST_ASSERT_EQUAL(LUA_OK, luaL_dostring(L, "return 6 * 7"));
+    TEST_ASSERT_EQUAL(42, lua_tointeger(L, -1));
+    lua_close(L);
+    TEST_ASSERT_EQUAL(0, arena.stats().current);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_failed_shrink_keeps_a_large_block_large);
+    RUN_TEST(test_random_churn_keeps_contents);
+    RUN_TEST(test_lua_scripts_fragmentation_report);
+    RUN_TEST(test_limit_fails_the_script_not_the_state);
+    return UNITY_END();
+}
@@ -0,0 +1,222 @@
+// LuaBytecodeCache on a host LittleFS directory: keys, memory hits, chunks
+// persisted on their second use and loaded back from flash once evicted from
+// PSRAM, damaged files dropped, the flash file cap, and the time a hit saves
+// against compiling the script again.
+
+#include <unity.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <LittleFS.h>
+#include <esp_timer.h>
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+}
+
+#include "core/lua_bytecode_cache.h"
+
+namespace {
+
+char g_root[] = "/tmp/lua_cache_XXXXXX";
+lua_State* g_L = nullptr;
+
+// A scheduled event script; variant v returns 55 * v
+std::string eventScript(int variant, int steps = 8) {
+    std::string script = "local variant = " + std::to_string(variant) + "\n"
+                         "local function clamp(v, lo, hi) if v < lo then return lo elseif v > hi then return hi end return v end\n";
+    for (int i = 0; i < steps; ++i) {
+        const std::string n = std::to_string(i);
+        script += "local t" + n + " = { name = \"step" + n + "\", level = clamp(variant * " + n +
+                  " % 17, 2, 14), on = (" + n + " % 3 == 0) }\n";
+    }
+    script += "local sum = 0\nfor i = 1, 10 do sum = sum + i * variant end\nreturn sum\n";
+    return script;
+}
+
+std::string pathFor(uint64_t key) {
+    char path[64];
+    snprintf(path, sizeof(path), "%s/%016" PRIx64 ".luac", LuaBytecodeCache::CACHE_DIR, key);
+    return path;
+}
+
+// Compile as the sandbox does on a miss and store the chunk; returns compile microseconds
+uint32_t compileAndStore(const std::string& source, uint64_t key) {
+    const int64_t start = esp_timer_get_time();
+    TEST_ASSERT_EQUAL(LUA_OK, luaL_loadbuffer(g_L, source.data(), source.size(), "=lua_script"));
+    const uint32_t compile_us = static_cast<uint32_t>(esp_timer_get_time() - start);
+    LuaBytecodeCache::getInstance().store(g_L, key, compile_us);
+    lua_pop(g_L, 1);
+    return compile_us;
+}
+
+lua_Integer runLoaded() {
+    TEST_ASSERT_EQUAL(LUA_OK, lua_pcall(g_L, 0, 1, 0));
+    const lua_Integer result = lua_tointeger(g_L, -1);
+    lua_pop(g_L, 1);
+    return result;
+}
+
+// Pushes enough other chunks to evict everything older from PSRAM
+void fillMemory(int first_variant) {
+    for (size_t i = 0; i < LuaBytecodeCache::kMaxMemoryEntries; ++i) {
+        const std::string source = eventScript(first_variant + static_cast<int>(i));
+        compileAndStore(source, LuaBytecodeCache::makeKey(source, true));
+    }
+}
+
+} // namespace
+
+void setUp() {
+    TEST_ASSERT_TRUE(LuaBytecodeCache::getInstance().clear());
+}
+
+void tearDown() {}
+
+void test_keys_cover_source_and_mode() {
+    const std::string source = eventScript(1);
+    TEST_ASSERT_TRUE(LuaBytecodeCache::makeKey(source, true) == LuaBytecodeCache::makeKey(source, true));
+    TEST_ASSERT_TRUE(LuaBytecodeCache::makeKey(source, true) != LuaBytecodeCache::makeKey(source, false));
+    TEST_ASSERT_TRUE(LuaBytecodeCache::makeKey(source, true) != LuaBytecodeCache::makeKey(eventScript(2), true));
+    TEST_ASSERT_TRUE(LuaBytecodeCache::makeKey(source, true) != LuaBytecodeCache::makeKey(source + " ", true));
+}
+
+void test_second_use_is_persisted() {
+    LuaBytecodeCache& cache = LuaBytecodeCache::getInstance();
+    const LuaBytecodeCache::Stats before = cache.getStats();
+    const std::string source = eventScript(3);
+    const uint64_t key = LuaBytecodeCache::makeKey(source, true);
+
+    TEST_ASSERT_FALSE(cache.load(g_L, key));
+    compileAndStore(source, key);
+    TEST_ASSERT_FALSE(LittleFS.exists(pathFor(key)));    // One-off snippets stay off flash
+
+    TEST_ASSERT_TRUE(cache.load(g_L, key));
+    TEST_ASSERT_EQUAL(165, runLoaded());
+    TEST_ASSERT_TRUE(LittleFS.exists(pathFor(key)));
+
+    TEST_ASSERT_TRUE(cache.load(g_L, key));
+    TEST_ASSERT_EQUAL(165, runLoaded());
+
+    const LuaBytecodeCache::Stats after = cache.getStats();
+    TEST_ASSERT_EQUAL(1, after.misses - before.misses);
+    TEST_ASSERT_EQUAL(2, after.memory_hits - before.memory_hits);
+    TEST_ASSERT_EQUAL(1, after.disk_writes - before.disk_writes);
+    TEST_ASSERT_EQUAL(1, after.memory_entries);
+    TEST_ASSERT_EQUAL(1, after.disk_entries);
+}
+
+void test_evicted_chunk_loads_from_flash() {
+    LuaBytecodeCache& cache = LuaBytecodeCache::getInstance();
+    const std::string source = eventScript(4);
+    const uint64_t key = LuaBytecodeCache::makeKey(source, true);
+    compileAndStore(source, key);
+    TEST_ASSERT_TRUE(cache.load(g_L, key));
+    lua_pop(g_L, 1);
+
+    const LuaBytecodeCache::Stats before = cache.getStats();
+    fillMemory(100);
+    TEST_ASSERT_EQUAL(LuaBytecodeCache::kMaxMemoryEntries, cache.getStats().memory_entries);
+    TEST_ASSERT_GREATER_THAN(before.evictions, cache.getStats().evictions);
+
+    TEST_ASSERT_TRUE(cache.load(g_L, key));
+    TEST_ASSERT_EQUAL(220, runLoaded());
+    TEST_ASSERT_EQUAL(1, cache.getStats().disk_hits - before.disk_hits);
+}
+
+void test_damaged_chunk_is_dropped() {
+    LuaBytecodeCache& cache = LuaBytecodeCache::getInstance();
+    const std::string source = eventScript(5);
+    const uint64_t key = LuaBytecodeCache::makeKey(source, true);
+    compileAndStore(source, key);
+    TEST_ASSERT_TRUE(cache.load(g_L, key));
+    lua_pop(g_L, 1);
+    fillMemory(200);
+
+    // Keep the header, damage the bytecode
+    File file = LittleFS.open(pathFor(key), FILE_WRITE);
+    const uint8_t damaged[] = {'L', 'B', 'C', '1', 0, 0, 0, 0, 'j', 'u', 'n', 'k'};
+    file.write(damaged, sizeof(damaged));
+    file.close();
+
+    const LuaBytecodeCache::Stats before = cache.getStats();
+    TEST_ASSERT_FALSE(cache.load(g_L, key));
+    TEST_ASSERT_EQUAL(1, cache.getStats().misses - before.misses);
+    TEST_ASSERT_FALSE(LittleFS.exists(pathFor(key)));
+
+    // Compiled again and cached as usual
+    compileAndStore(source, key);
+    TEST_ASSERT_TRUE(cache.load(g_L, key));
+    TEST_ASSERT_EQUAL(275, runLoaded());
+}
+
+void test_flash_keeps_the_newest_files() {
+    LuaBytecodeCache& cache = LuaBytecodeCache::getInstance();
+    const int count = static_cast<int>(LuaBytecodeCache::kMaxDiskEntries) + 4;
+    for (int i = 0; i < count; ++i) {
+        const std::string source = eventScript(300 + i);
+        const uint64_t key = LuaBytecodeCache::makeKey(source, true);
+        compileAndStore(source, key);
+        TEST_ASSERT_TRUE(cache.load(g_L, key));
+        lua_pop(g_L, 1);
+    }
+    const LuaBytecodeCache::Stats stats = cache.getStats();
+    TEST_ASSERT_EQUAL(LuaBytecodeCache::kMaxDiskEntries, stats.disk_entries);
+    TEST_ASSERT_LESS_OR_EQUAL(LuaBytecodeCache::kMaxDiskBytes, stats.disk_bytes);
+    TEST_ASSERT_FALSE(LittleFS.exists(pathFor(LuaBytecodeCache::makeKey(eventScript(300), true))));
+    TEST_ASSERT_TRUE(LittleFS.exists(pathFor(LuaBytecodeCache::makeKey(eventScript(300 + count - 1), true))));
+}
+
+void test_hit_against_compile_time() {
+    constexpr int kRounds = 500;
+    LuaBytecodeCache& cache = LuaBytecodeCache::getInstance();
+    const std::string source = eventScript(7, 40);
+    const uint64_t key = LuaBytecodeCache::makeKey(source, true);
+
+    int64_t start = esp_timer_get_time();
+    for (int round = 0; round < kRounds; ++round) {
+        TEST_ASSERT_EQUAL(LUA_OK, luaL_loadbuffer(g_L, source.data(), source.size(), "=lua_script"));
+        lua_pop(g_L, 1);
+    }
+    const double compile_us = double(esp_timer_get_time() - start) / kRounds;
+
+    compileAndStore(source, key);
+    start = esp_timer_get_time();
+    for (int round = 0; round < kRounds; ++round) {
+        TEST_ASSERT_TRUE(cache.load(g_L, key));
+        lua_pop(g_L, 1);
+    }
+    const double hit_us = double(esp_timer_get_time() - start) / kRounds;
+
+    const LuaBytecodeCache::Stats stats = cache.getStats();
+    printf("%u B script: compile %.1f us, cached load %.1f us (%.1fx), chunk %u B\n", (unsigned)source.size(),
+           compile_us, hit_us, compile_us / hit_us, (unsigned)stats.memory_bytes);
+    TEST_ASSERT_LESS_THAN(compile_us, hit_us);
+}
+
+int main() {
+    if (!mkdtemp(g_root)) {
+        return 1;
+    }
+    LittleFS.mount(g_root);
+    g_L = luaL_newstate();
+    luaL_openlibs(g_L);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_keys_cover_source_and_mode);
+    RUN_TEST(test_second_use_is_persisted);
+    RUN_TEST(test_evicted_chunk_loads_from_flash);
+    RUN_TEST(test_damaged_chunk_is_dropped);
+    RUN_TEST(test_flash_keeps_the_newest_files);
+    RUN_TEST(test_hit_against_compile_time);
+    const int failures = UNITY_END();
+
+    lua_close(g_L);
+    system((std::string("rm -rf ") + g_root).c_str());
+    return failures;
+}
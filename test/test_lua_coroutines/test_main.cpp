@@ -0,0 +1,335 @@
+// LuaCoroutines on a simulated clock: sleeping scripts wake in order without
+// burning turns, compute-bound scripts are preempted and time out, suspended
+// work completed from another thread resumes its script, Done callbacks may
+// spawn while step() walks the task list, pcall cannot catch a timeout, and
+// library changes stay with the isolated script that made them.
+
+#include <unity.h>
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+}
+
+#include "utils/lua_coroutines.h"
+
+namespace {
+
+uint32_t g_now = 0;                         // Simulated milliseconds
+std::vector<uint32_t> g_tickets;            // Suspended by fetch()
+
+// delay(ms): yields under the scheduler, fails where a real binding would block
+int luaDelay(lua_State* L) {
+    const uint32_t ms = static_cast<uint32_t>(luaL_checkinteger(L, 1));
+    if (!LuaCoroutines::canYield(L)) {
+        return luaL_error(L, "delay outside the scheduler");
+    }
+    return LuaCoroutines::sleep(L, ms);
+}
+
+// fetch(): hands the work to the test, which completes the ticket
+int luaFetch(lua_State* L) {
+    if (!LuaCoroutines::canYield(L)) {
+        return luaL_error(L, "fetch outside the scheduler");
+    }
+    g_tickets.push_back(LuaCoroutines::suspend(L));
+    return lua_yield(L, 0);
+}
+
+// advance(ms): moves the simulated clock, for scripts that run past their deadline mid-turn
+int luaAdvance(lua_State* L) {
+    g_now += static_cast<uint32_t>(luaL_checkinteger(L, 1));
+    return 0;
+}
+
+// Finished coroutines in order, with what they returned
+struct Finished {
+    std::string name;
+    LuaCoroutines::Status status;
+    uint32_t elapsed_ms;
+    uint32_t slices;
+    std::string value;
+    std::string error;
+};
+
+class Harness {
+public:
+    Harness() : L_(luaL_newstate()) {
+        luaL_openlibs(L_);
+        lua_register(L_, "delay", luaDelay);
+        lua_register(L_, "fetch", luaFetch);
+        lua_register(L_, "advance", luaAdvance);
+        coroutines_.reset(new LuaCoroutines(L_, [] { return g_now; }));
+    }
+
+    ~Harness() {
+        coroutines_.reset();
+        lua_close(L_);
+    }
+
+    lua_State* state() { return L_; }
+    LuaCoroutines& coroutines() { return *coroutines_; }
+    std::vector<Finished>& finished() { return finished_; }
+
+    bool spawn(const std::string& name, const std::string& code, uint32_t timeout_ms,
+               LuaCoroutines::Done also = nullptr) {
+        if (luaL_loadstring(L_, code.c_str()) != LUA_OK) {
+            lua_pop(L_, 1);
+            return false;
+        }
+        coroutines_->spawn(timeout_ms, [this, name, also](lua_State* co, const LuaCoroutines::Result& result) {
+            const char* value = result.status == LuaCoroutines::Status::Ok ? lua_tostring(co, -1) : nullptr;
+            finished_.push_back({name, result.status, result.elapsed_ms, result.slices, value ? value : "",
+                                 result.error});
+            if (also) {
+                also(co, result);
+            }
+        });
+        return true;
+    }
+
+    // Step until idle, jumping the clock to each wake-up; @return steps taken
+    uint32_t runUntilIdle(uint32_t max_steps = 10000) {
+        uint32_t steps = 0;
+        while (steps < max_steps) {
+            const uint32_t wait = coroutines_->step();
+            ++steps;
+            if (wait == LuaCoroutines::kIdle) {
+                break;
+            }
+            g_now += wait;
+        }
+        return steps;
+    }
+
+    const Finished* find(const std::string& name) const {
+        for (const Finished& item : finished_) {
+            if (item.name == name) {
+                return &item;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    lua_State* L_;
+    std::unique_ptr<LuaCoroutines> coroutines_;
+    std::vector<Finished> finished_;
+};
+
+} // namespace
+
+void setUp() {
+    g_now = 1000;
+    g_tickets.clear();
+}
+
+void tearDown() {}
+
+void test_sleepers_wake_in_order() {
+    Harness harness;
+    constexpr int kScripts = 100;
+    for (int i = 0; i < kScripts; ++i) {
+        // Three polls each, periods 10..1000 ms
+        const int period = 10 * (kScripts - i);
+        TEST_ASSERT_TRUE(harness.spawn("s" + std::to_string(i),
+                                       "local n = 0 for _ = 1, 3 do delay(" + std::to_string(period) +
+                                           ") n = n + 1 end return n",
+                                       60000));
+    }
+    // First turn: everyone starts and sleeps; the wait is the shortest period
+    TEST_ASSERT_EQUAL(10, harness.coroutines().step());
+    const LuaCoroutines::Stats stats = harness.coroutines().getStats();
+    TEST_ASSERT_EQUAL(kScripts, stats.sleeping);
+    TEST_ASSERT_EQUAL(0, stats.ready);
+    TEST_ASSERT_EQUAL(10, harness.coroutines().step());     // Nothing due: nobody is resumed
+
+    const uint32_t steps = harness.runUntilIdle();
+    TEST_ASSERT_EQUAL(kScripts, harness.finished().size());
+    for (int i = 0; i < kScripts; ++i) {
+        const Finished* item = harness.find("s" + std::to_string(i));
+        TEST_ASSERT_NOT_NULL(item);
+        TEST_ASSERT_EQUAL_STRING("3", item->value.c_str());
+        TEST_ASSERT_EQUAL(3 * 10 * (kScripts - i), item->elapsed_ms);
+        TEST_ASSERT_EQUAL(4, item->slices);                 // Start plus three wake-ups
+    }
+    // The shortest sleeper finishes first, the longest last
+    TEST_ASSERT_EQUAL_STRING("s99", harness.finished().front().name.c_str());
+    TEST_ASSERT_EQUAL_STRING("s0", harness.finished().back().name.c_str());
+    TEST_ASSERT_TRUE(harness.coroutines().empty());
+    TEST_ASSERT_EQUAL(LuaCoroutines::kIdle, harness.coroutines().step());
+    printf("%d sleepers, 3 polls each: %u steps over %u simulated ms\n", kScripts, (unsigned)steps,
+           (unsigned)(g_now - 1000));
+}
+
+void test_busy_scripts_are_preempted_and_time_out() {
+    Harness harness;
+    TEST_ASSERT_TRUE(harness.spawn("busy", "local x = 0 for i = 1, 200000 do x = x + i end return x", 60000));
+    TEST_ASSERT_TRUE(harness.spawn("spin", "while true do end", 500));
+    TEST_ASSERT_TRUE(harness.spawn("ticker", "for i = 1, 3 do delay(1) end return 'ticked'", 60000));
+
+    // Every turn gives each ready script one slice; the ticker is not held up by the others
+    for (int turn = 0; turn < 4; ++turn) {
+        TEST_ASSERT_EQUAL(0, harness.coroutines().step());
+        g_now += 1;
+    }
+    const Finished* ticker = harness.find("ticker");
+    TEST_ASSERT_NOT_NULL(ticker);
+    TEST_ASSERT_EQUAL_STRING("ticked", ticker->value.c_str());
+    TEST_ASSERT_NULL(harness.find("spin"));
+
+    g_now += 500;   // Past spin's deadline
+    harness.runUntilIdle();
+    const Finished* spin = harness.find("spin");
+    TEST_ASSERT_NOT_NULL(spin);
+    TEST_ASSERT_EQUAL(static_cast<int>(LuaCoroutines::Status::Timeout), static_cast<int>(spin->status));
+    TEST_ASSERT_EQUAL_STRING("script timed out after 500 ms", spin->error.c_str());
+    const Finished* busy = harness.find("busy");
+    TEST_ASSERT_NOT_NULL(busy);
+    TEST_ASSERT_EQUAL_STRING("20000100000", busy->value.c_str());
+    TEST_ASSERT_GREATER_THAN(1, busy->slices);
+
+    const LuaCoroutines::Stats stats = harness.coroutines().getStats();
+    TEST_ASSERT_GREATER_OR_EQUAL(busy->slices - 1 + 4, stats.preempted);
+    TEST_ASSERT_EQUAL(2, stats.completed);
+    TEST_ASSERT_EQUAL(1, stats.timed_out);
+}
+
+void test_completed_work_resumes_the_script() {
+    Harness harness;
+    uint32_t wakeups = 0;
+    harness.coroutines().setWakeup([&wakeups] { ++wakeups; });
+    TEST_ASSERT_TRUE(harness.spawn("fetcher", "local body, code = fetch() return body .. ' ' .. code", 10000));
+    TEST_ASSERT_TRUE(harness.spawn("late", "return fetch()", 300));
+
+    TEST_ASSERT_EQUAL(300, harness.coroutines().step());   // Both waiting: the nearest deadline
+    TEST_ASSERT_EQUAL(2, g_tickets.size());
+    TEST_ASSERT_EQUAL(2, harness.coroutines().getStats().waiting);
+
+    // Delivered from an I/O worker thread
+    const uint32_t ticket = g_tickets[0];
+    std::thread worker([&harness, ticket] {
+        harness.coroutines().complete(ticket, {LuaCoroutines::Value::string("sereno"),
+                                               LuaCoroutines::Value::integer(200)});
+    });
+    worker.join();
+    TEST_ASSERT_EQUAL(1, wakeups);
+    g_now += 50;
+    harness.coroutines().step();
+    const Finished* fetcher = harness.find("fetcher");
+    TEST_ASSERT_NOT_NULL(fetcher);
+    TEST_ASSERT_EQUAL_STRING("sereno 200", fetcher->value.c_str());
+    TEST_ASSERT_EQUAL(50, fetcher->elapsed_ms);
+
+    // Never completed: fails at its deadline, and a completion after that is ignored
+    harness.runUntilIdle();
+    const Finished* late = harness.find("late");
+    TEST_ASSERT_NOT_NULL(late);
+    TEST_ASSERT_EQUAL(static_cast<int>(LuaCoroutines::Status::Timeout), static_cast<int>(late->status));
+    TEST_ASSERT_EQUAL(300, late->elapsed_ms);
+    harness.coroutines().complete(g_tickets[1], {LuaCoroutines::Value::nil()});
+    TEST_ASSERT_EQUAL(LuaCoroutines::kIdle, harness.coroutines().step());
+}
+
+void test_done_callbacks_may_spawn_during_step() {
+    Harness harness;
+    constexpr int kSleepers = 64;
+    int spawned = 0;
+    // Each one times out in the same step; its Done callback spawns two more scripts,
+    // growing the task list while step() walks it
+    LuaCoroutines::Done respawn = [&harness, &spawned](lua_State*, const LuaCoroutines::Result&) {
+        for (int i = 0; i < 2; ++i) {
+            harness.spawn("child" + std::to_string(spawned++), "delay(5) return 'child'", 1000);
+        }
+    };
+    for (int i = 0; i < kSleepers; ++i) {
+        TEST_ASSERT_TRUE(harness.spawn("sleeper" + std::to_string(i), "delay(60000)", 100, respawn));
+    }
+    harness.coroutines().step();
+    TEST_ASSERT_EQUAL(kSleepers, harness.coroutines().getStats().sleeping);
+
+    g_now += 100;
+    // The children spawned by the timeouts wait for the next step
+    TEST_ASSERT_EQUAL(0, harness.coroutines().step());
+    TEST_ASSERT_EQUAL(kSleepers, harness.finished().size());
+    TEST_ASSERT_EQUAL(2 * kSleepers, harness.coroutines().getStats().ready);
+
+    harness.runUntilIdle();
+    TEST_ASSERT_EQUAL(3 * kSleepers, harness.finished().size());
+    const LuaCoroutines::Stats stats = harness.coroutines().getStats();
+    TEST_ASSERT_EQUAL(kSleepers, stats.timed_out);
+    TEST_ASSERT_EQUAL(2 * kSleepers, stats.completed);
+    TEST_ASSERT_EQUAL(3 * kSleepers, stats.spawned);
+    for (const Finished& item : harness.finished()) {
+        if (item.name.compare(0, 5, "child") == 0) {
+            TEST_ASSERT_EQUAL_STRING("child", item.value.c_str());
+            TEST_ASSERT_EQUAL(5, item.elapsed_ms);
+        }
+    }
+}
+
+void test_pcall_cannot_catch_the_timeout() {
+    Harness harness;
+    TEST_ASSERT_TRUE(harness.spawn("guarded", "while true do pcall(function() while true do advance(1) end end) end",
+                                   50));
+    TEST_ASSERT_TRUE(harness.spawn("retrying",
+                                   "while true do local ok, err = pcall(function() for i = 1, 1e9 do advance(1) end end) "
+                                   "if not ok then advance(1) end end",
+                                   50));
+    TEST_ASSERT_TRUE(harness.spawn("nested",
+                                   "while true do pcall(coroutine.wrap(function() while true do advance(1) end end)) end",
+                                   50));
+    TEST_ASSERT_TRUE(harness.spawn("sleeper", "delay(10) return 'woke'", 600000));
+
+    harness.runUntilIdle();
+    TEST_ASSERT_EQUAL(4, harness.finished().size());
+    for (const char* name : {"guarded", "retrying", "nested"}) {
+        const Finished* item = harness.find(name);
+        TEST_ASSERT_NOT_NULL(item);
+        TEST_ASSERT_EQUAL(static_cast<int>(LuaCoroutines::Status::Timeout), static_cast<int>(item->status));
+        TEST_ASSERT_EQUAL_STRING("script timed out after 50 ms", item->error.c_str());
+    }
+    TEST_ASSERT_EQUAL_STRING("woke", harness.find("sleeper")->value.c_str());
+    TEST_ASSERT_EQUAL(3, harness.coroutines().getStats().timed_out);
+}
+
+void test_isolated_scripts_keep_library_changes_to_themselves() {
+    Harness harness;
+    TEST_ASSERT_EQUAL(LUA_OK, luaL_dostring(harness.state(), "gpio = { level = 0 }"));
+    TEST_ASSERT_TRUE(harness.spawn("vandal",
+                                   "string.upper = nil  _G.delay = nil  gpio.level = 7  leaked = true "
+                                   "return tostring(string.upper) .. ' ' .. gpio.level .. ' ' .. tostring(_G.leaked)",
+                                   1000));
+    harness.runUntilIdle();
+    TEST_ASSERT_EQUAL_STRING("nil 7 true", harness.find("vandal")->value.c_str());
+
+    TEST_ASSERT_TRUE(harness.spawn("next",
+                                   "local n = 0 for _ in pairs(string) do n = n + 1 end "
+                                   "return string.upper('ok') .. ' ' .. gpio.level .. ' ' .. tostring(leaked) .. ' ' .. "
+                                   "type(delay) .. ' ' .. tostring(n > 10)",
+                                   1000));
+    harness.runUntilIdle();
+    TEST_ASSERT_EQUAL_STRING("OK 0 nil function true", harness.find("next")->value.c_str());
+
+    // The shared state is untouched
+    TEST_ASSERT_EQUAL(LUA_OK, luaL_dostring(harness.state(), "return gpio.level + #string.upper('abc')"));
+    TEST_ASSERT_EQUAL(3, lua_tointeger(harness.state(), -1));
+    lua_pop(harness.state(), 1);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_sleepers_wake_in_order);
+    RUN_TEST(test_busy_scripts_are_preempted_and_time_out);
+    RUN_TEST(test_completed_work_resumes_the_script);
+    RUN_TEST(test_done_callbacks_may_spawn_during_step);
+    RUN_TEST(test_pcall_cannot_catch_the_timeout);
+    RUN_TEST(test_isolated_scripts_keep_library_changes_to_themselves);
+    return UNITY_END();
+}
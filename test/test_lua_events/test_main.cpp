@@ -0,0 +1,263 @@
+// LuaEvents with real Lua handlers run as LuaCoroutines, the way LuaScheduler
+// starts them: a burst keeps the latest invocations per handler, the queue,
+// running and handler caps hold, publish-to-start latency from another task,
+// and a spinning handler timing out without holding up the others.
+
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <Arduino.h>
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+}
+
+#include "core/event_router.h"
+#include "core/lua_events.h"
+#include "utils/lua_coroutines.h"
+
+namespace {
+
+constexpr uint32_t kHandlerTimeoutMs = 300;
+
+// The handler half of LuaScheduler: start what LuaEvents lets start, then step
+class Runner {
+public:
+    Runner() : L_(luaL_newstate()) {
+        luaL_openlibs(L_);
+        luaL_dostring(L_, "log = {}");
+        LuaEvents::getInstance().clear();
+        coroutines_.reset(new LuaCoroutines(L_, [] { return static_cast<uint32_t>(millis()); }));
+    }
+
+    ~Runner() {
+        LuaEvents::getInstance().setWakeup(nullptr);
+        LuaEvents::getInstance().clear();
+        coroutines_.reset();
+        lua_close(L_);
+    }
+
+    /** Register the function expression code for event; @return handler id */
+    uint32_t on(const std::string& event, const std::string& code) {
+        if (luaL_dostring(L_, ("return " + code).c_str()) != LUA_OK) {
+            return 0;
+        }
+        const uint32_t id = LuaEvents::getInstance().on(L_, event, -1, "test");
+        lua_pop(L_, 1);
+        return id;
+    }
+
+    uint32_t turn() {
+        LuaEvents& events = LuaEvents::getInstance();
+        LuaEvents::Invocation invocation;
+        while (events.next(invocation)) {
+            lua_rawgeti(L_, LUA_REGISTRYINDEX, invocation.ref);
+            lua_pushlstring(L_, invocation.event.data(), invocation.event.size());
+            lua_pushlstring(L_, invocation.payload.data(), invocation.payload.size());
+            const uint32_t id = invocation.handler_id;
+            coroutines_->spawn(kHandlerTimeoutMs,
+                               [id](lua_State*, const LuaCoroutines::Result& result) {
+                                   LuaEvents::getInstance().finished(id, result.status == LuaCoroutines::Status::Ok,
+                                                                     0);
+                               },
+                               nullptr, false, 2);
+        }
+        return coroutines_->step();
+    }
+
+    void runUntilIdle() {
+        for (int i = 0; i < 100000 && (turn() != LuaCoroutines::kIdle || LuaEvents::getInstance().getStats().pending);
+             ++i) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    /** Payloads the handlers appended to the global log, space separated */
+    std::string log() {
+        luaL_dostring(L_, "return table.concat(log, ' ')");
+        const std::string text = lua_tostring(L_, -1);
+        lua_pop(L_, 1);
+        return text;
+    }
+
+    lua_State* state() { return L_; }
+    LuaCoroutines& coroutines() { return *coroutines_; }
+
+private:
+    lua_State* L_;
+    std::unique_ptr<LuaCoroutines> coroutines_;
+};
+
+const LuaEvents::HandlerStats* handler(const LuaEvents::Stats& stats, uint32_t id) {
+    for (const LuaEvents::HandlerStats& item : stats.handlers) {
+        if (item.id == id) {
+            return &item;
+        }
+    }
+    return nullptr;
+}
+
+const char* const kLogPayload = "function(name, payload) log[#log + 1] = payload end";
+
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_burst_keeps_the_latest_payloads() {
+    Runner runner;
+    const uint32_t id = runner.on("audio.title", kLogPayload);
+    TEST_ASSERT_NOT_EQUAL(0, id);
+    const LuaEvents::Stats before = LuaEvents::getInstance().getStats();
+
+    // Published through EventRouter while the scheduler is busy elsewhere
+    for (int i = 1; i <= 10; ++i) {
+        const std::string title = "t" + std::to_string(i);
+        EventRouter::getInstance()->publish("audio.title", const_cast<char*>(title.c_str()));
+    }
+    EventRouter::getInstance()->publish("audio.other", const_cast<char*>("ignored"));
+    runner.runUntilIdle();
+
+    const LuaEvents::Stats stats = LuaEvents::getInstance().getStats();
+    TEST_ASSERT_EQUAL_STRING("t7 t8 t9 t10", runner.log().c_str());
+    TEST_ASSERT_EQUAL(4, handler(stats, id)->calls);
+    TEST_ASSERT_EQUAL(6, handler(stats, id)->dropped);
+    TEST_ASSERT_EQUAL(6, stats.dropped - before.dropped);
+    TEST_ASSERT_EQUAL(0, stats.pending);
+}
+
+void test_queue_running_and_handler_caps() {
+    Runner runner;
+    LuaEvents& events = LuaEvents::getInstance();
+
+    // Sleeping handlers: at most kMaxRunning at once, one invocation per handler
+    uint32_t sleepers[LuaEvents::kMaxRunning + 2];
+    for (uint32_t& id : sleepers) {
+        id = runner.on("tick", "function() coroutine.yield() end");
+    }
+    events.post("tick", "");
+    events.post("tick", "");
+    runner.turn();
+    TEST_ASSERT_EQUAL(LuaEvents::kMaxRunning, events.getStats().running);
+    runner.runUntilIdle();
+    LuaEvents::Stats stats = events.getStats();
+    for (uint32_t id : sleepers) {
+        TEST_ASSERT_EQUAL(2, handler(stats, id)->calls);
+    }
+
+    // The whole queue holds kMaxPending invocations
+    events.clear();
+    for (size_t i = 0; i < LuaEvents::kMaxHandlers; ++i) {
+        TEST_ASSERT_NOT_EQUAL(0, runner.on("burst", kLogPayload));
+    }
+    TEST_ASSERT_EQUAL(0, runner.on("burst", kLogPayload));     // Over the handler cap
+    const uint32_t dropped = events.getStats().dropped;
+    events.post("burst", "a");
+    events.post("burst", "b");
+    stats = events.getStats();
+    TEST_ASSERT_EQUAL(LuaEvents::kMaxPending, stats.pending);
+    TEST_ASSERT_EQUAL(2 * LuaEvents::kMaxHandlers - LuaEvents::kMaxPending, stats.dropped - dropped);
+
+    // Removing a handler skips what it had queued
+    const uint32_t removed = stats.handlers.front().id;
+    TEST_ASSERT_TRUE(events.off(runner.state(), removed));
+    TEST_ASSERT_FALSE(events.off(runner.state(), removed));
+    runner.runUntilIdle();
+    stats = events.getStats();
+    uint32_t calls = 0;
+    for (const LuaEvents::HandlerStats& item : stats.handlers) {
+        calls += item.calls;
+    }
+    TEST_ASSERT_NULL(handler(stats, removed));
+    TEST_ASSERT_EQUAL(LuaEvents::kMaxPending - 1, calls);
+    TEST_ASSERT_EQUAL(0, stats.pending);
+}
+
+void test_latency_from_another_task() {
+    Runner runner;
+    constexpr int kEvents = 20;
+    const uint32_t id = runner.on("time.minute", kLogPayload);
+
+    std::mutex mutex;
+    std::condition_variable woken;
+    bool wake = false;
+    LuaEvents::getInstance().setWakeup([&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        wake = true;
+        woken.notify_one();
+    });
+
+    std::atomic<bool> done{false};
+    std::thread publisher([&done] {
+        for (int i = 0; i < kEvents; ++i) {
+            const std::string minute = "m" + std::to_string(i);
+            EventRouter::getInstance()->publish("time.minute", const_cast<char*>(minute.c_str()));
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        done = true;
+    });
+    while (!done || LuaEvents::getInstance().getStats().pending) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            woken.wait_for(lock, std::chrono::milliseconds(10), [&wake] { return wake; });
+            wake = false;
+        }
+        runner.turn();
+    }
+    publisher.join();
+    runner.runUntilIdle();
+
+    const LuaEvents::HandlerStats* stats = handler(LuaEvents::getInstance().getStats(), id);
+    printf("%d events from another task: latency avg %u ms, max %u ms\n", kEvents, (unsigned)stats->avg_latency_ms,
+           (unsigned)stats->max_latency_ms);
+    TEST_ASSERT_EQUAL(kEvents, stats->calls);
+    TEST_ASSERT_EQUAL(0, stats->dropped);
+    TEST_ASSERT_LESS_OR_EQUAL(2, stats->max_latency_ms);
+}
+
+void test_spinning_handler_times_out_alone() {
+    Runner runner;
+    const uint32_t spinner = runner.on("wifi.connected", "function() while true do end end");
+    const uint32_t failing = runner.on("wifi.connected", "function() error('no route') end");
+    const uint32_t logger = runner.on("wifi.connected", kLogPayload);
+
+    const uint32_t start = millis();
+    EventRouter::getInstance()->publish("wifi.connected", const_cast<char*>("192.168.1.20"));
+    runner.turn();
+    TEST_ASSERT_EQUAL_STRING("192.168.1.20", runner.log().c_str());    // Did not wait for the spinner
+    const uint32_t logged_ms = millis() - start;
+
+    runner.runUntilIdle();
+    const uint32_t spin_ms = millis() - start;
+    const LuaEvents::Stats stats = LuaEvents::getInstance().getStats();
+    printf("spinning handler ended after %u ms, other handler done after %u ms\n", (unsigned)spin_ms,
+           (unsigned)logged_ms);
+    TEST_ASSERT_EQUAL(1, handler(stats, spinner)->failures);
+    TEST_ASSERT_EQUAL(1, handler(stats, failing)->failures);
+    TEST_ASSERT_EQUAL(0, handler(stats, logger)->failures);
+    TEST_ASSERT_EQUAL(1, handler(stats, logger)->calls);
+    TEST_ASSERT_GREATER_OR_EQUAL(kHandlerTimeoutMs, spin_ms);
+    TEST_ASSERT_LESS_THAN(kHandlerTimeoutMs + 100, spin_ms);
+    TEST_ASSERT_LESS_OR_EQUAL(5, logged_ms);
+    TEST_ASSERT_EQUAL(1, runner.coroutines().getStats().timed_out);
+}
+
+int main() {
+    LuaEvents::getInstance().begin();
+    UNITY_BEGIN();
+    RUN_TEST(test_burst_keeps_the_latest_payloads);
+    RUN_TEST(test_queue_running_and_handler_caps);
+    RUN_TEST(test_latency_from_another_task);
+    RUN_TEST(test_spinning_handler_times_out_alone);
+    return UNITY_END();
+}
@@ -0,0 +1,228 @@
+// LuaStatePool (LuaSandboxPool's logic) over real Lua states in LuaArenas:
+// scripts that block in delay() run side by side instead of one at a time
+// behind a single sandbox, a lease is exclusive and comes back reset, an
+// exhausted pool times out, a state that hit its memory limit is rebuilt, and
+// the UI state keeps its globals.
+
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+}
+
+#include "core/lua_state_pool.h"
+#include "utils/lua_arena.h"
+
+namespace {
+
+constexpr int kScripts = 9;
+constexpr int kScriptMs = 20;
+
+// The parts of VoiceAssistant::LuaSandbox the pool relies on, with delay()
+// blocking the calling thread as the firmware binding does
+class TestSandbox {
+public:
+    static constexpr size_t kMemoryLimit = 256 * 1024;
+    static constexpr size_t kRecycleFootprint = 192 * 1024;
+
+    TestSandbox() { createState(); }
+    ~TestSandbox() { lua_close(L); }
+
+    bool execute(const std::string& script, std::string* error = nullptr) {
+        const bool ok = luaL_dostring(L, script.c_str()) == LUA_OK;
+        if (!ok && error) {
+            *error = lua_tostring(L, -1);
+        }
+        return ok;
+    }
+
+    bool hasGlobal(const char* name) {
+        const bool found = lua_getglobal(L, name) != LUA_TNIL;
+        lua_pop(L, 1);
+        return found;
+    }
+
+    void reset() {
+        lua_settop(L, 0);
+        lua_pushnil(L);
+        lua_setglobal(L, "leftover");
+        lua_gc(L, LUA_GCCOLLECT, 0);
+    }
+
+    bool needsRecycle() const {
+        return arena_.stats().failures > 0 || arena_.stats().footprint > kRecycleFootprint;
+    }
+
+    void recycle() {
+        lua_gc(L, LUA_GCCOLLECT, 0);
+        arena_.drop();
+        createState();
+        ++rebuilt;
+    }
+
+    const LuaArena& arena() const { return arena_; }
+
+    int rebuilt = 0;
+
+private:
+    static int luaDelay(lua_State* L) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(luaL_checkinteger(L, 1)));
+        return 0;
+    }
+
+    void createState() {
+        L = lua_newstate(LuaArena::alloc, &arena_);
+        luaL_openlibs(L);
+        lua_register(L, "delay", luaDelay);
+    }
+
+    LuaArena arena_{kMemoryLimit};
+    lua_State* L = nullptr;
+};
+
+using TestPool = LuaStatePool<TestSandbox>;
+
+double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+const std::string kDelayScript = "delay(" + std::to_string(kScriptMs) + ")";
+
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_blocking_scripts_run_side_by_side() {
+    TestPool& pool = TestPool::getInstance();
+    pool.begin();
+    const TestPool::Stats before = pool.getStats();
+
+    // Before: one sandbox behind a mutex
+    TestSandbox single;
+    std::mutex single_mutex;
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kScripts; ++i) {
+        threads.emplace_back([&]() {
+            std::lock_guard<std::mutex> lock(single_mutex);
+            single.execute(kDelayScript);
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const double single_ms = elapsedMs(start);
+
+    // Now: a state from the pool each
+    threads.clear();
+    std::atomic<int> failed{0};
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kScripts; ++i) {
+        threads.emplace_back([&]() {
+            TestPool::Lease lease = pool.acquire();
+            if (!lease || !lease->execute(kDelayScript)) {
+                ++failed;
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const double pool_ms = elapsedMs(start);
+
+    const TestPool::Stats stats = pool.getStats();
+    printf("%d scripts of %d ms: one sandbox %.1f ms, pool of %u %.1f ms (max wait %u ms)\n", kScripts, kScriptMs,
+           single_ms, (unsigned)TestPool::kPoolSize, pool_ms, (unsigned)stats.max_wait_ms);
+    TEST_ASSERT_EQUAL(0, failed.load());
+    TEST_ASSERT_GREATER_OR_EQUAL(kScripts * kScriptMs, single_ms);
+    TEST_ASSERT_LESS_THAN(single_ms / 2, pool_ms);
+    TEST_ASSERT_EQUAL(TestPool::kPoolSize, stats.size);
+    TEST_ASSERT_EQUAL(TestPool::kPoolSize, stats.peak_in_use);
+    TEST_ASSERT_EQUAL(0, stats.in_use);
+    TEST_ASSERT_EQUAL(kScripts, stats.acquired - before.acquired);
+    TEST_ASSERT_GREATER_OR_EQUAL(kScripts - TestPool::kPoolSize, stats.waited - before.waited);
+}
+
+void test_exhausted_pool_times_out_and_leases_come_back_reset() {
+    TestPool& pool = TestPool::getInstance();
+    const TestPool::Stats before = pool.getStats();
+    std::vector<TestPool::Lease> leases;
+    for (size_t i = 0; i < TestPool::kPoolSize; ++i) {
+        leases.push_back(pool.acquire());
+        TEST_ASSERT_TRUE(leases.back());
+        TEST_ASSERT_TRUE(leases.back()->execute("leftover = 1"));
+    }
+    TEST_ASSERT_FALSE(pool.acquire(30));
+    TEST_ASSERT_EQUAL(1, pool.getStats().timeouts - before.timeouts);
+
+    leases.pop_back();
+    TestPool::Lease again = pool.acquire(30);
+    TEST_ASSERT_TRUE(again);
+    TEST_ASSERT_FALSE(again->hasGlobal("leftover"));
+    TEST_ASSERT_TRUE(again->hasGlobal("delay"));
+
+    // Moving a lease does not give the state back twice
+    TestPool::Lease moved = std::move(again);
+    TEST_ASSERT_FALSE(again);
+    TEST_ASSERT_TRUE(moved);
+    moved = TestPool::Lease();
+    leases.clear();
+    TEST_ASSERT_EQUAL(0, pool.getStats().in_use);
+}
+
+void test_state_over_its_limit_is_rebuilt() {
+    TestPool& pool = TestPool::getInstance();
+    const TestPool::Stats before = pool.getStats();
+    TestSandbox* sandbox = nullptr;
+    {
+        TestPool::Lease lease = pool.acquire();
+        sandbox = &*lease;
+        std::string error;
+        TEST_ASSERT_FALSE(lease->execute("local t = {} for i = 1, 1e6 do t[i] = tostring(i) end", &error));
+        TEST_ASSERT_NOT_EQUAL(std::string::npos, error.find("not enough memory"));
+        TEST_ASSERT_TRUE(lease->needsRecycle());
+    }
+    const TestPool::Stats stats = pool.getStats();
+    TEST_ASSERT_EQUAL(1, stats.recycled - before.recycled);
+    TEST_ASSERT_EQUAL(1, sandbox->rebuilt);
+    TEST_ASSERT_FALSE(sandbox->needsRecycle());
+    TEST_ASSERT_LESS_OR_EQUAL(TestPool::kPoolSize * TestSandbox::kRecycleFootprint, stats.arena_bytes);
+
+    TestPool::Lease lease = pool.acquire();
+    TEST_ASSERT_TRUE(lease->execute("local t = {} for i = 1, 100 do t[i] = i end"));
+}
+
+void test_ui_state_keeps_its_globals() {
+    TestPool& pool = TestPool::getInstance();
+    {
+        TestPool::Lease ui = pool.acquireUi();
+        TEST_ASSERT_TRUE(ui->execute("leftover = 'screen'"));
+    }
+    TestPool::Lease ui = pool.acquireUi();
+    TEST_ASSERT_TRUE(ui->hasGlobal("leftover"));
+
+    // Pooled states are unaffected while the UI state is held
+    TestPool::Lease pooled = pool.acquire(30);
+    TEST_ASSERT_TRUE(pooled);
+    TEST_ASSERT_FALSE(pooled->hasGlobal("leftover"));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_blocking_scripts_run_side_by_side);
+    RUN_TEST(test_exhausted_pool_times_out_and_leases_come_back_reset);
+    RUN_TEST(test_state_over_its_limit_is_rebuilt);
+    RUN_TEST(test_ui_state_keeps_its_globals);
+    return UNITY_END();
+}
@@ -0,0 +1,322 @@
+// PromptTemplate against the find/replace composition getSystemPrompt() used
+// before: same output for data/voice_assistant_prompt.json, and the time to
+// build the prompt on every request versus a cached compile.
+
+#include <unity.h>
+
+#include <ArduinoJson.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "core/voice_assistant_prompt.h"
+#include "utils/prompt_template.h"
+
+namespace {
+
+constexpr int kIterations = 2000;
+
+struct Command {
+    const char* name;
+    const char* description;
+};
+
+// A subset of the CommandCenter registrations on the device
+const Command kCommands[] = {
+    {"ping", "Health check"}, {"uptime", "Uptime in seconds"}, {"heap", "Free heap and PSRAM"},
+    {"sd_status", "SD card status"}, {"time", "Local time"}, {"time_sync", "Sync time over NTP"},
+    {"log_tail", "Last log lines"}, {"radio_play", "Play an internet radio station"},
+    {"radio_stop", "Stop the radio"}, {"volume_up", "Raise the volume"}, {"volume_down", "Lower the volume"},
+    {"volume_set", "Set the volume 0-100"}, {"brightness_set", "Set the display brightness"},
+    {"bt_type", "Type text on the bonded BLE host"}, {"bt_send_key", "Send a key to the BLE host"},
+    {"system_status", "System summary"}, {"lua_exec", "Run a Lua script"},
+    {"calendar_list", "List calendar events"}, {"calendar_create_alarm", "Create an alarm"},
+    {"web_search", ""},
+};
+
+const char* const kLuaNamespaces[] = {"gpio", "memory", "webData", "docs", "audio", "display", "ble",
+                                      "radio", "calendar", "system", "led", "tts"};
+
+std::string fixture(const std::string& path) {
+    std::ifstream file(std::string(TEST_PROJECT_DIR) + "/" + path, std::ios::binary);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+std::string placeholderName(const char* placeholder) {
+    const std::string text(placeholder);
+    return text.substr(2, text.size() - 4);
+}
+
+// The pieces VoiceAssistant gathers for a prompt
+struct PromptInputs {
+    VoiceAssistantPromptDefinition definition;
+    std::string host_list = "AA:BB:CC:DD:EE:FF (connected), 11:22:33:44:55:66 (not connected)";
+    std::unordered_map<std::string, std::string> variables;
+};
+
+// CommandCenter::listCommands() formatted as in compileSystemPrompt()
+std::string commandList() {
+    std::string list;
+    for (const Command& command : kCommands) {
+        if (!list.empty()) {
+            list += "; ";
+        }
+        list += command.name;
+        if (command.description[0]) {
+            list += std::string(" (") + command.description + ")";
+        }
+    }
+    return list;
+}
+
+std::string luaApiList() {
+    std::string list;
+    for (const char* ns : kLuaNamespaces) {
+        for (const char* fn : {"get", "set", "list", "read", "write"}) {
+            if (!list.empty()) {
+                list += ", ";
+            }
+            list += std::string(ns) + "." + fn + "()";
+        }
+    }
+    return list + "; commands: " + commandList();
+}
+
+PromptInputs deviceInputs() {
+    PromptInputs inputs;
+    JsonDocument doc;
+    TEST_ASSERT_FALSE(deserializeJson(doc, fixture("data/voice_assistant_prompt.json")));
+    inputs.definition.prompt_template = doc["prompt_template"] | "";
+    for (JsonVariantConst section : doc["sections"].as<JsonArrayConst>()) {
+        inputs.definition.sections.push_back(section.as<const char*>() ? section.as<const char*>() : "");
+    }
+    TEST_ASSERT_FALSE(inputs.definition.prompt_template.empty());
+
+    inputs.variables["command_lua_exec_output"] = "heap 182344, psram 7340032, wifi -61 dBm, uptime 3h12m";
+    inputs.variables["last_command_name"] = "volume_set";
+    inputs.variables["last_command_output"] = "Volume impostato al 40%";
+    inputs.variables["last_command_text"] = "Ho impostato il volume al 40%.";
+    inputs.variables["last_command_raw_output"] = "{\"volume\":40}";
+    for (int i = 0; i < 12; ++i) {
+        inputs.variables["command_sensor_" + std::to_string(i) + "_output"] = "value " + std::to_string(i * 7);
+    }
+    return inputs;
+}
+
+// getSystemPrompt() before the template was compiled: every call rebuilds the
+// lists and runs one find/replace loop per variable
+std::string findReplacePrompt(const PromptInputs& inputs) {
+    std::string prompt = inputs.definition.prompt_template;
+
+    const std::string lua_placeholder = VOICE_ASSISTANT_LUA_API_LIST_PLACEHOLDER;
+    const size_t lua_pos = prompt.find(lua_placeholder);
+    if (lua_pos != std::string::npos) {
+        prompt.replace(lua_pos, lua_placeholder.length(), luaApiList());
+    }
+    const std::string command_placeholder = VOICE_ASSISTANT_COMMAND_LIST_PLACEHOLDER;
+    const size_t command_pos = prompt.find(command_placeholder);
+    if (command_pos != std::string::npos) {
+        prompt.replace(command_pos, command_placeholder.length(), commandList());
+    }
+    const std::string hosts_placeholder = VOICE_ASSISTANT_BLE_HOSTS_PLACEHOLDER;
+    const size_t hosts_pos = prompt.find(hosts_placeholder);
+    if (hosts_pos != std::string::npos) {
+        prompt.replace(hosts_pos, hosts_placeholder.length(), inputs.host_list);
+    } else {
+        prompt += " Bonded BLE hosts: " + inputs.host_list + ".";
+    }
+    for (const auto& section : inputs.definition.sections) {
+        prompt += section;
+    }
+
+    for (const auto& pair : inputs.variables) {
+        const std::string placeholder = "{{" + pair.first + "}}";
+        size_t pos = 0;
+        while ((pos = prompt.find(placeholder, pos)) != std::string::npos) {
+            prompt.replace(pos, placeholder.length(), pair.second);
+            pos += pair.second.length();
+        }
+    }
+    return prompt;
+}
+
+// buildPromptSource() + compileSystemPrompt()
+void compilePrompt(const PromptInputs& inputs, PromptTemplate& compiled) {
+    std::string source = inputs.definition.prompt_template;
+    if (source.find(VOICE_ASSISTANT_BLE_HOSTS_PLACEHOLDER) == std::string::npos) {
+        source += " Bonded BLE hosts: ";
+        source += VOICE_ASSISTANT_BLE_HOSTS_PLACEHOLDER;
+        source += ".";
+    }
+    for (const auto& section : inputs.definition.sections) {
+        source += section;
+    }
+
+    const std::string lua_name = placeholderName(VOICE_ASSISTANT_LUA_API_LIST_PLACEHOLDER);
+    const std::string command_name = placeholderName(VOICE_ASSISTANT_COMMAND_LIST_PLACEHOLDER);
+    std::string lua_api_list;
+    std::string command_list;
+    compiled.compile(source, [&](const std::string& name) -> const std::string* {
+        if (name == lua_name) {
+            if (lua_api_list.empty()) {
+                lua_api_list = luaApiList();
+            }
+            return &lua_api_list;
+        }
+        if (name == command_name) {
+            if (command_list.empty()) {
+                command_list = commandList();
+            }
+            return &command_list;
+        }
+        return nullptr;
+    });
+}
+
+// renderSystemPromptLocked()
+void renderPrompt(const PromptInputs& inputs, const PromptTemplate& compiled, std::string& out) {
+    const std::string hosts_name = placeholderName(VOICE_ASSISTANT_BLE_HOSTS_PLACEHOLDER);
+    compiled.render([&](const std::string& name) -> const std::string* {
+        if (name == hosts_name) {
+            return &inputs.host_list;
+        }
+        auto it = inputs.variables.find(name);
+        return it != inputs.variables.end() ? &it->second : nullptr;
+    }, out);
+}
+
+template <typename Fn>
+double microsPerCall(Fn&& fn) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+        fn();
+    }
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / kIterations;
+}
+
+PromptTemplate::Resolver mapResolver(const std::unordered_map<std::string, std::string>& values) {
+    return [&values](const std::string& name) -> const std::string* {
+        auto it = values.find(name);
+        return it != values.end() ? &it->second : nullptr;
+    };
+}
+
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_literals_and_slots() {
+    PromptTemplate compiled;
+    TEST_ASSERT_TRUE(compiled.empty());
+    compiled.compile("Ciao {{name}}, sono le {{time}}. {{name}}!");
+    TEST_ASSERT_EQUAL(3, compiled.slotCount());
+    TEST_ASSERT_EQUAL(strlen("Ciao , sono le . !"), compiled.literalBytes());
+
+    const std::unordered_map<std::string, std::string> values = {{"name", "Luca"}, {"time", "18:30"}};
+    std::string out;
+    compiled.render(mapResolver(values), out);
+    TEST_ASSERT_EQUAL_STRING("Ciao Luca, sono le 18:30. Luca!", out.c_str());
+
+    compiled.clear();
+    TEST_ASSERT_TRUE(compiled.empty());
+    TEST_ASSERT_EQUAL(0, compiled.slotCount());
+}
+
+void test_fixed_values_are_folded_into_literals() {
+    const std::unordered_map<std::string, std::string> fixed = {{"LIST", "a; b; c"}};
+    PromptTemplate compiled;
+    compiled.compile("Comandi: {{LIST}}. Ultimo: {{last}}.", mapResolver(fixed));
+    TEST_ASSERT_EQUAL(1, compiled.slotCount());
+    TEST_ASSERT_EQUAL(strlen("Comandi: a; b; c. Ultimo: ."), compiled.literalBytes());
+
+    const std::unordered_map<std::string, std::string> values = {{"last", "ping"}, {"LIST", "ignored"}};
+    std::string out;
+    compiled.render(mapResolver(values), out);
+    TEST_ASSERT_EQUAL_STRING("Comandi: a; b; c. Ultimo: ping.", out.c_str());
+}
+
+void test_unknown_and_malformed_placeholders_stay_verbatim() {
+    const char* cases[][2] = {
+        {"{{unknown}} resta", "{{unknown}} resta"},
+        {"vuoto {{}} resta", "vuoto {{}} resta"},
+        {"tripla {{{x}}}", "tripla {X}"},
+        {"aperta {{x", "aperta {{x"},
+        {"piano [{\"args\":[\"{{a}}\"]}]", "piano [{\"args\":[\"{{a}}\"]}]"},
+        {"", ""},
+    };
+    const std::unordered_map<std::string, std::string> values = {{"x", "X"}};
+    for (const auto& item : cases) {
+        PromptTemplate compiled;
+        compiled.compile(item[0]);
+        std::string out = "stale";
+        compiled.render(mapResolver(values), out);
+        TEST_ASSERT_EQUAL_STRING(item[1], out.c_str());
+    }
+
+    // No resolver at all: every slot is emitted as written
+    PromptTemplate compiled;
+    compiled.compile("{{a}}-{{b}}");
+    std::string out;
+    compiled.render(PromptTemplate::Resolver(), out);
+    TEST_ASSERT_EQUAL_STRING("{{a}}-{{b}}", out.c_str());
+}
+
+void test_device_prompt_matches_find_replace() {
+    PromptInputs inputs = deviceInputs();
+    PromptTemplate compiled;
+    compilePrompt(inputs, compiled);
+    std::string rendered;
+    renderPrompt(inputs, compiled, rendered);
+    TEST_ASSERT_EQUAL_STRING(findReplacePrompt(inputs).c_str(), rendered.c_str());
+
+    // Plan examples in the prompt ({{a}}, {{id}}) are not variables
+    TEST_ASSERT_NOT_EQUAL(std::string::npos, rendered.find("{{id}}"));
+    TEST_ASSERT_EQUAL(std::string::npos, rendered.find("{{LUA_API_LIST}}"));
+    TEST_ASSERT_EQUAL(std::string::npos, rendered.find("{{last_command_name}}"));
+
+    // A variable change only needs a new render
+    inputs.variables["last_command_name"] = "radio_play";
+    inputs.host_list = "none";
+    renderPrompt(inputs, compiled, rendered);
+    TEST_ASSERT_EQUAL_STRING(findReplacePrompt(inputs).c_str(), rendered.c_str());
+}
+
+void test_prompt_build_time() {
+    const PromptInputs inputs = deviceInputs();
+    PromptTemplate compiled;
+    std::string rendered;
+    std::string old_prompt;
+
+    const double find_replace_us = microsPerCall([&] { old_prompt = findReplacePrompt(inputs); });
+    const double compile_render_us = microsPerCall([&] {
+        compilePrompt(inputs, compiled);
+        renderPrompt(inputs, compiled, rendered);
+    });
+    const double render_us = microsPerCall([&] { renderPrompt(inputs, compiled, rendered); });
+
+    TEST_ASSERT_EQUAL_STRING(old_prompt.c_str(), rendered.c_str());
+    printf("prompt: %u bytes, %u literal bytes, %u slots, %u variables\n", (unsigned)rendered.size(),
+           (unsigned)compiled.literalBytes(), (unsigned)compiled.slotCount(), (unsigned)inputs.variables.size());
+    printf("find/replace %.1f us, compile+render %.1f us, cached render %.1f us per prompt\n",
+           find_replace_us, compile_render_us, render_us);
+    TEST_ASSERT_TRUE(render_us < find_replace_us);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_literals_and_slots);
+    RUN_TEST(test_fixed_values_are_folded_into_literals);
+    RUN_TEST(test_unknown_and_malformed_placeholders_stay_verbatim);
+    RUN_TEST(test_device_prompt_matches_find_replace);
+    RUN_TEST(test_prompt_build_time);
+    return UNITY_END();
+}
@@ -0,0 +1,327 @@
+// RequestScheduler under a simulated mixed load: commands, STT, TTS and
+// interactive LLM calls plus a burst of background LLM jobs on three workers.
+// Queueing latency per request type with the AsyncRequestManager lanes and
+// endpoints, against one FIFO queue over the same workers.
+
+#include <unity.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include "utils/request_scheduler.h"
+
+namespace {
+
+enum Lane : uint8_t { kStt, kLlm, kTts, kCommand };
+enum Endpoint : uint8_t { kLocal, kLlmServer, kSpeechServer };
+enum Priority : uint8_t { kBackground, kNormal, kInteractive };
+
+constexpr size_t kWorkers = 3;
+constexpr uint32_t kLoadMs = 600000;
+const char* const kLaneNames[] = {"stt", "llm", "tts", "command"};
+// As configured by AsyncRequestManager
+constexpr uint8_t kLaneLimits[] = {1, 2, 1, 2};
+constexpr uint8_t kEndpointLimits[] = {kWorkers, 2, 2};
+constexpr uint32_t kTimeoutMs[] = {60000, 180000, 60000, 30000};
+
+struct Job {
+    uint8_t lane;
+    uint8_t endpoint;
+    uint8_t priority;
+    uint32_t arrive_ms;
+    uint32_t run_ms;
+};
+
+struct Outcome {
+    std::array<std::vector<uint32_t>, RequestScheduler::kMaxLanes> waits;
+    std::array<uint32_t, RequestScheduler::kMaxLanes> timed_out{};
+    std::array<uint8_t, RequestScheduler::kMaxEndpoints> max_running{};
+    uint32_t rejected = 0;
+    std::vector<uint32_t> interactive_llm_waits;
+    std::vector<uint32_t> background_waits;     // The burst; both are in the llm waits too
+};
+
+class Random {
+public:
+    explicit Random(uint32_t seed) : state_(seed) {}
+
+    double uniform() {
+        state_ = state_ * 1664525u + 1013904223u;
+        return ((state_ >> 8) + 0.5) / 16777216.0;
+    }
+
+    uint32_t between(uint32_t low, uint32_t high) {
+        return low + static_cast<uint32_t>(uniform() * (high - low));
+    }
+
+    uint32_t exponential(uint32_t mean_ms) {
+        return static_cast<uint32_t>(-std::log(uniform()) * mean_ms);
+    }
+
+private:
+    uint32_t state_;
+};
+
+void addStream(std::vector<Job>& jobs, Random& random, uint8_t lane, uint8_t endpoint, uint32_t mean_gap_ms,
+               uint32_t min_run_ms, uint32_t max_run_ms, bool mixed_priority) {
+    for (uint32_t at = random.exponential(mean_gap_ms); at < kLoadMs; at += random.exponential(mean_gap_ms)) {
+        const uint8_t priority = mixed_priority && random.uniform() < 0.5 ? kNormal : kInteractive;
+        jobs.push_back({lane, endpoint, priority, at, random.between(min_run_ms, max_run_ms)});
+    }
+}
+
+// Ten minutes of use: the voice pipeline, web console commands, and at 200 s a
+// scheduled job queueing eight LLM summaries in the background
+std::vector<Job> mixedLoad() {
+    Random random(2024);
+    std::vector<Job> jobs;
+    addStream(jobs, random, kCommand, kLocal, 3000, 30, 300, true);
+    addStream(jobs, random, kLlm, kLlmServer, 20000, 2000, 10000, false);
+    addStream(jobs, random, kStt, kSpeechServer, 20000, 500, 1500, false);
+    addStream(jobs, random, kTts, kSpeechServer, 20000, 1000, 3000, true);
+    for (int i = 0; i < 8; ++i) {
+        jobs.push_back({kLlm, kLlmServer, kBackground, 200000 + static_cast<uint32_t>(i) * 10,
+                        random.between(5000, 10000)});
+    }
+    std::stable_sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) { return a.arrive_ms < b.arrive_ms; });
+    return jobs;
+}
+
+// Event-driven: at each instant finish due workers, queue arrivals, then let
+// idle workers take work. fifo puts everything in one lane and one endpoint
+// with equal priority and timeout, so requests start in arrival order.
+Outcome simulate(const std::vector<Job>& jobs, bool fifo) {
+    RequestScheduler scheduler;
+    for (size_t lane = 0; lane < RequestScheduler::kMaxLanes; ++lane) {
+        scheduler.setLaneLimit(lane, fifo ? kWorkers : kLaneLimits[lane]);
+    }
+    for (size_t endpoint = 0; endpoint < 3; ++endpoint) {
+        scheduler.setEndpointLimit(endpoint, fifo ? kWorkers : kEndpointLimits[endpoint]);
+    }
+
+    struct Worker {
+        RequestScheduler::Ticket ticket = RequestScheduler::kNoTicket;
+        uint32_t end_ms = 0;
+    };
+    std::array<Worker, kWorkers> workers;
+    std::map<RequestScheduler::Ticket, size_t> tickets;
+    Outcome outcome;
+    size_t arrived = 0;
+    uint32_t now = 0;
+
+    for (;;) {
+        for (Worker& worker : workers) {
+            if (worker.ticket != RequestScheduler::kNoTicket && worker.end_ms <= now) {
+                scheduler.finish(worker.ticket, true, now);
+                scheduler.collect(worker.ticket);     // The client polls the result at once
+                worker.ticket = RequestScheduler::kNoTicket;
+            }
+        }
+        for (; arrived < jobs.size() && jobs[arrived].arrive_ms <= now; ++arrived) {
+            const Job& job = jobs[arrived];
+            const RequestScheduler::Ticket ticket =
+                fifo ? scheduler.submit(0, 0, kNormal, now, 180000)
+                     : scheduler.submit(job.lane, job.endpoint, job.priority, now, kTimeoutMs[job.lane]);
+            if (ticket == RequestScheduler::kNoTicket) {
+                ++outcome.rejected;
+                continue;
+            }
+            tickets[ticket] = arrived;
+        }
+        for (Worker& worker : workers) {
+            if (worker.ticket != RequestScheduler::kNoTicket) {
+                continue;
+            }
+            const RequestScheduler::Ticket ticket = scheduler.next(now);
+            if (ticket == RequestScheduler::kNoTicket) {
+                break;
+            }
+            const Job& job = jobs[tickets[ticket]];
+            worker.ticket = ticket;
+            worker.end_ms = now + job.run_ms;
+            outcome.waits[job.lane].push_back(now - job.arrive_ms);
+            if (job.lane == kLlm) {
+                (job.priority == kBackground ? outcome.background_waits : outcome.interactive_llm_waits)
+                    .push_back(now - job.arrive_ms);
+            }
+        }
+        for (size_t endpoint = 0; endpoint < RequestScheduler::kMaxEndpoints; ++endpoint) {
+            outcome.max_running[endpoint] = std::max(outcome.max_running[endpoint], scheduler.endpointRunning(endpoint));
+        }
+
+        uint32_t next = arrived < jobs.size() ? jobs[arrived].arrive_ms : UINT32_MAX;
+        for (const Worker& worker : workers) {
+            if (worker.ticket != RequestScheduler::kNoTicket) {
+                next = std::min(next, worker.end_ms);
+            }
+        }
+        if (next == UINT32_MAX) {
+            break;      // Nothing running and nothing left to arrive
+        }
+        now = next;
+    }
+    for (size_t lane = 0; lane < RequestScheduler::kMaxLanes; ++lane) {
+        outcome.timed_out[lane] = scheduler.laneStats(lane).timed_out;
+    }
+    return outcome;
+}
+
+uint32_t percentile(std::vector<uint32_t> values, double fraction) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()))];
+}
+
+void report(const char* policy, const Outcome& outcome) {
+    for (size_t lane = 0; lane < RequestScheduler::kMaxLanes; ++lane) {
+        const std::vector<uint32_t>& waits = outcome.waits[lane];
+        printf("  %-6s %-8s %4u requests  wait p50 %6u ms  p95 %6u ms  max %6u ms  timed out %u\n", policy,
+               kLaneNames[lane], (unsigned)waits.size(), (unsigned)percentile(waits, 0.5),
+               (unsigned)percentile(waits, 0.95), (unsigned)percentile(waits, 1.0), (unsigned)outcome.timed_out[lane]);
+    }
+    printf("  %-6s llm interactive p95 %u ms max %u ms, background burst of %u last started after %u ms\n", policy,
+           (unsigned)percentile(outcome.interactive_llm_waits, 0.95),
+           (unsigned)percentile(outcome.interactive_llm_waits, 1.0), (unsigned)outcome.background_waits.size(),
+           (unsigned)percentile(outcome.background_waits, 1.0));
+}
+
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_endpoint_queued_counts_waiting_requests() {
+    RequestScheduler scheduler;
+    scheduler.setLaneLimit(kLlm, 1);
+    scheduler.setEndpointLimit(kLlmServer, 1);
+    const RequestScheduler::Ticket first = scheduler.submit(kLlm, kLlmServer, kNormal, 0, 1000);
+    const RequestScheduler::Ticket second = scheduler.submit(kLlm, kLlmServer, kNormal, 0, 1000);
+    scheduler.submit(kCommand, kLocal, kNormal, 0, 1000);
+    TEST_ASSERT_EQUAL(2, scheduler.endpointQueued(kLlmServer));
+    TEST_ASSERT_EQUAL(1, scheduler.endpointQueued(kLocal));
+
+    // Waiting behind the endpoint limit still counts: the endpoint is in use
+    TEST_ASSERT_EQUAL(first, scheduler.next(10));
+    TEST_ASSERT_EQUAL(1, scheduler.endpointQueued(kLlmServer));
+    TEST_ASSERT_EQUAL(1, scheduler.endpointRunning(kLlmServer));
+
+    TEST_ASSERT_TRUE(scheduler.cancel(second, 20));
+    TEST_ASSERT_EQUAL(0, scheduler.endpointQueued(kLlmServer));
+    TEST_ASSERT_TRUE(scheduler.finish(first, true, 30));
+    TEST_ASSERT_EQUAL(0, scheduler.endpointRunning(kLlmServer));
+    TEST_ASSERT_EQUAL(0, scheduler.endpointQueued(RequestScheduler::kMaxEndpoints));
+}
+
+void test_background_leaves_a_slot_free() {
+    RequestScheduler scheduler;
+    scheduler.setLaneLimit(kLlm, 2);
+    scheduler.setEndpointLimit(kLlmServer, 2);
+    const RequestScheduler::Ticket first = scheduler.submit(kLlm, kLlmServer, kBackground, 0, 60000);
+    scheduler.submit(kLlm, kLlmServer, kBackground, 0, 60000);
+    TEST_ASSERT_EQUAL(first, scheduler.next(0));
+    TEST_ASSERT_EQUAL(RequestScheduler::kNoTicket, scheduler.next(0));    // The second slot is held back
+
+    const RequestScheduler::Ticket interactive = scheduler.submit(kLlm, kLlmServer, kInteractive, 10, 60000);
+    TEST_ASSERT_EQUAL(interactive, scheduler.next(10));
+
+    // The same holds for the endpoint, and a limit of 1 is not held back
+    scheduler.setLaneLimit(kStt, 3);
+    scheduler.setEndpointLimit(kSpeechServer, 1);
+    const RequestScheduler::Ticket stt = scheduler.submit(kStt, kSpeechServer, kBackground, 20, 60000);
+    TEST_ASSERT_EQUAL(stt, scheduler.next(20));
+    TEST_ASSERT_TRUE(scheduler.finish(stt, true, 30));
+    scheduler.setEndpointLimit(kSpeechServer, 2);
+    scheduler.submit(kStt, kSpeechServer, kBackground, 40, 60000);
+    scheduler.submit(kStt, kSpeechServer, kBackground, 40, 60000);
+    TEST_ASSERT_NOT_EQUAL(RequestScheduler::kNoTicket, scheduler.next(40));
+    TEST_ASSERT_EQUAL(RequestScheduler::kNoTicket, scheduler.next(40));
+}
+
+void test_uncollected_results_are_not_evicted() {
+    RequestScheduler scheduler;
+    scheduler.setLaneLimit(kCommand, 2);
+    std::vector<RequestScheduler::Ticket> tickets;
+    for (size_t i = 0; i < RequestScheduler::kMaxRequests; ++i) {
+        tickets.push_back(scheduler.submit(kCommand, kLocal, kNormal, 0, 1000));
+        TEST_ASSERT_NOT_EQUAL(RequestScheduler::kNoTicket, tickets.back());
+        TEST_ASSERT_EQUAL(tickets.back(), scheduler.next(0));
+        TEST_ASSERT_TRUE(scheduler.finish(tickets.back(), true, static_cast<uint32_t>(i)));
+    }
+
+    // Every slot holds a result nobody has read: refuse rather than drop one
+    TEST_ASSERT_EQUAL(RequestScheduler::kNoTicket, scheduler.submit(kCommand, kLocal, kNormal, 100, 1000));
+    TEST_ASSERT_EQUAL(1, scheduler.laneStats(kCommand).rejected);
+    RequestScheduler::Entry entry;
+    for (RequestScheduler::Ticket ticket : tickets) {
+        TEST_ASSERT_TRUE(scheduler.get(ticket, entry));
+        TEST_ASSERT_EQUAL(RequestScheduler::State::Done, entry.state);
+    }
+
+    // A collected result gives its slot up; the oldest collected one goes first
+    TEST_ASSERT_FALSE(scheduler.collect(RequestScheduler::kNoTicket));
+    TEST_ASSERT_TRUE(scheduler.collect(tickets[5]));
+    TEST_ASSERT_TRUE(scheduler.collect(tickets[3]));
+    const RequestScheduler::Ticket reused = scheduler.submit(kCommand, kLocal, kNormal, 100, 1000);
+    TEST_ASSERT_EQUAL(RequestScheduler::slot(tickets[3]), RequestScheduler::slot(reused));
+    TEST_ASSERT_FALSE(scheduler.get(tickets[3], entry));
+    TEST_ASSERT_TRUE(scheduler.get(tickets[5], entry));
+
+    // Unfinished requests cannot be collected; the TTL still frees uncollected results
+    TEST_ASSERT_FALSE(scheduler.collect(reused));
+    TEST_ASSERT_NOT_EQUAL(RequestScheduler::kNoTicket, scheduler.submit(kCommand, kLocal, kNormal, 100, 1000));
+    TEST_ASSERT_EQUAL(RequestScheduler::kNoTicket, scheduler.submit(kCommand, kLocal, kNormal, 100, 1000));
+    TEST_ASSERT_EQUAL(RequestScheduler::kMaxRequests - 2, scheduler.purge(5000, 1000));
+    TEST_ASSERT_NOT_EQUAL(RequestScheduler::kNoTicket, scheduler.submit(kCommand, kLocal, kNormal, 5000, 1000));
+}
+
+void test_mixed_load_queueing_latency() {
+    const std::vector<Job> jobs = mixedLoad();
+    const Outcome lanes = simulate(jobs, false);
+    const Outcome fifo = simulate(jobs, true);
+    printf("%u requests over %u s on %u workers\n", (unsigned)jobs.size(), (unsigned)(kLoadMs / 1000),
+           (unsigned)kWorkers);
+    report("lanes", lanes);
+    report("fifo", fifo);
+
+    // Everything ran, within the limits
+    TEST_ASSERT_EQUAL(0, lanes.rejected);
+    size_t ran = 0;
+    for (size_t lane = 0; lane < RequestScheduler::kMaxLanes; ++lane) {
+        TEST_ASSERT_EQUAL(0, lanes.timed_out[lane]);
+        ran += lanes.waits[lane].size();
+    }
+    TEST_ASSERT_EQUAL(jobs.size(), ran);
+    TEST_ASSERT_EQUAL(8, lanes.background_waits.size());
+    for (size_t endpoint = 0; endpoint < 3; ++endpoint) {
+        TEST_ASSERT_LESS_OR_EQUAL(kEndpointLimits[endpoint], lanes.max_running[endpoint]);
+    }
+
+    // The burst holds one LLM worker, so commands and speech keep flowing meanwhile
+    const uint32_t command_p95 = percentile(lanes.waits[kCommand], 0.95);
+    TEST_ASSERT_LESS_THAN(percentile(fifo.waits[kCommand], 0.95), command_p95);
+    TEST_ASSERT_LESS_THAN(percentile(fifo.waits[kCommand], 1.0), percentile(lanes.waits[kCommand], 1.0));
+    TEST_ASSERT_LESS_THAN(percentile(fifo.waits[kStt], 1.0), percentile(lanes.waits[kStt], 1.0));
+
+    // Interactive LLM calls go ahead of the burst: the background jobs keep to
+    // one LLM slot, so none waits for a background job (each runs 5 s or more)
+    const uint32_t interactive_max = percentile(lanes.interactive_llm_waits, 1.0);
+    TEST_ASSERT_LESS_OR_EQUAL(percentile(fifo.interactive_llm_waits, 0.95),
+                              percentile(lanes.interactive_llm_waits, 0.95));
+    TEST_ASSERT_LESS_THAN(percentile(fifo.interactive_llm_waits, 1.0), interactive_max);
+    TEST_ASSERT_LESS_THAN(5000, interactive_max);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_endpoint_queued_counts_waiting_requests);
+    RUN_TEST(test_background_leaves_a_slot_free);
+    RUN_TEST(test_uncollected_results_are_not_evicted);
+    RUN_TEST(test_mixed_load_queueing_latency);
+    return UNITY_END();
+}
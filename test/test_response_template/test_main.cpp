@@ -0,0 +1,183 @@
+// ResponseTemplate over the templates shipped in data/memory/docs: every one
+// compiles, and the open-meteo and wttr.in templates phrase the outputs the
+// examples show, falling through to a shorter template when a field is missing.
+
+#include <unity.h>
+
+#include <ArduinoJson.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "utils/response_template.h"
+
+namespace {
+
+struct DocTemplate {
+    std::string source;
+    std::string command;
+    std::string match;
+    std::string italian;
+    std::string english;
+};
+
+std::string fixture(const std::string& path) {
+    std::ifstream file(std::string(TEST_PROJECT_DIR) + "/" + path, std::ios::binary);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+// The "response_templates" arrays of every JSON file under data/memory/docs
+std::vector<DocTemplate> docTemplates() {
+    std::vector<DocTemplate> templates;
+    const std::filesystem::path root = std::filesystem::path(TEST_PROJECT_DIR) / "data/memory/docs";
+    for (const auto& item : std::filesystem::recursive_directory_iterator(root)) {
+        if (item.path().extension() != ".json") {
+            continue;
+        }
+        const std::string relative = std::filesystem::relative(item.path(), TEST_PROJECT_DIR).string();
+        JsonDocument doc;
+        if (deserializeJson(doc, fixture(relative))) {
+            continue;
+        }
+        for (JsonObjectConst entry : doc["response_templates"].as<JsonArrayConst>()) {
+            templates.push_back({relative, entry["command"] | "", entry["match"] | "", entry["it"] | "",
+                                 entry["en"] | ""});
+        }
+    }
+    return templates;
+}
+
+// Same selection as ResponseTemplates::render(): the first template that renders wins
+bool phrase(const std::string& command, const std::string& script, const std::string& output,
+            ResponseTemplate::Language language, std::string& text) {
+    for (const DocTemplate& entry : docTemplates()) {
+        if (entry.command != command || script.find(entry.match) == std::string::npos) {
+            continue;
+        }
+        const bool english = language == ResponseTemplate::Language::English && !entry.english.empty();
+        ResponseTemplate compiled;
+        if (!compiled.compile(english ? entry.english : entry.italian, language) || !compiled.render(output, text)) {
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+// Step 2 of the weather example: the script and the output it documents
+void weatherExample(std::string& script, std::string& output) {
+    JsonDocument doc;
+    TEST_ASSERT_FALSE(deserializeJson(doc, fixture("data/memory/docs/examples/weather_query.json")));
+    JsonObjectConst step;
+    for (JsonObjectConst item : doc["weather_query"]["scenario"].as<JsonArrayConst>()) {
+        step = item;
+    }
+    for (JsonVariantConst line : step["args_template"].as<JsonArrayConst>()) {
+        script += line.as<const char*>();
+        script += "\n";
+    }
+    output = step["output_example"] | "";
+}
+
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_doc_templates_compile() {
+    const std::vector<DocTemplate> templates = docTemplates();
+    TEST_ASSERT_GREATER_OR_EQUAL(4, templates.size());
+    for (const DocTemplate& entry : templates) {
+        std::string error;
+        ResponseTemplate italian;
+        ResponseTemplate english;
+        TEST_ASSERT_FALSE_MESSAGE(entry.command.empty(), entry.source.c_str());
+        TEST_ASSERT_TRUE_MESSAGE(italian.compile(entry.italian, ResponseTemplate::Language::Italian, &error),
+                                 (entry.source + ": " + error).c_str());
+        TEST_ASSERT_TRUE_MESSAGE(english.compile(entry.english, ResponseTemplate::Language::English, &error),
+                                 (entry.source + ": " + error).c_str());
+    }
+}
+
+void test_weather_example_is_phrased() {
+    std::string script;
+    std::string output;
+    weatherExample(script, output);
+    TEST_ASSERT_TRUE(script.find("open-meteo") != std::string::npos);
+
+    std::string text;
+    TEST_ASSERT_TRUE(phrase("lua_script", script, output, ResponseTemplate::Language::Italian, text));
+    TEST_ASSERT_EQUAL_STRING("La temperatura adesso è di 15 gradi, cielo coperto, con vento a 11 km/h.",
+                             text.c_str());
+    TEST_ASSERT_TRUE(phrase("lua_script", script, output, ResponseTemplate::Language::English, text));
+    TEST_ASSERT_EQUAL_STRING("It is 15 degrees now, overcast, with wind at 11 km/h.", text.c_str());
+}
+
+void test_missing_fields_fall_through() {
+    std::string script;
+    std::string output;
+    weatherExample(script, output);
+    std::string text;
+
+    // No wind: the template without it
+    const std::string no_wind =
+        R"({"current": {"time": "2025-04-12T15:00", "temperature_2m": 1.2, "weather_code": 61}})";
+    TEST_ASSERT_TRUE(phrase("lua_script", script, no_wind, ResponseTemplate::Language::Italian, text));
+    TEST_ASSERT_EQUAL_STRING("La temperatura adesso è di 1 grado, pioggia leggera.", text.c_str());
+
+    // Temperature only
+    const std::string temperature_only = R"({"current": {"temperature_2m": -0.4}})";
+    TEST_ASSERT_TRUE(phrase("lua_script", script, temperature_only, ResponseTemplate::Language::English, text));
+    TEST_ASSERT_EQUAL_STRING("It is 0 degrees now.", text.c_str());
+
+    // Nothing to phrase: left to the LLM
+    TEST_ASSERT_FALSE(phrase("lua_script", script, "HTTP error 503", ResponseTemplate::Language::Italian, text));
+    TEST_ASSERT_FALSE(phrase("lua_exec", script, output, ResponseTemplate::Language::Italian, text));
+}
+
+void test_unknown_weather_code_uses_the_fallback() {
+    std::string script;
+    std::string output;
+    weatherExample(script, output);
+    const std::string odd = R"({"current": {"temperature_2m": 20, "weather_code": 7, "wind_speed_10m": 3}})";
+    std::string text;
+    TEST_ASSERT_TRUE(phrase("lua_script", script, odd, ResponseTemplate::Language::Italian, text));
+    TEST_ASSERT_EQUAL_STRING("La temperatura adesso è di 20 gradi, tempo variabile, con vento a 3 km/h.", text.c_str());
+
+    // "*" is still accepted as the fallback key
+    ResponseTemplate legacy;
+    TEST_ASSERT_TRUE(legacy.compile("{code|map:0=sereno/*=variabile}", ResponseTemplate::Language::Italian));
+    TEST_ASSERT_TRUE(legacy.render("code=7", text));
+    TEST_ASSERT_EQUAL_STRING("variabile", text.c_str());
+    ResponseTemplate strict;
+    TEST_ASSERT_TRUE(strict.compile("{code|map:0=sereno/3=coperto}", ResponseTemplate::Language::Italian));
+    TEST_ASSERT_FALSE(strict.render("code=7", text));
+}
+
+void test_wttr_output_is_phrased() {
+    const std::string script = "webData.fetch_once('https://wttr.in/Roma?format=j1', 'wttr.json')";
+    const std::string output =
+        R"({"current_condition": [{"FeelsLikeC": "17", "humidity": "63", "temp_C": "18",)"
+        R"( "weatherDesc": [{"value": "Partly cloudy"}]}], "nearest_area": [{"areaName": [{"value": "Rome"}]}]})";
+    std::string text;
+    TEST_ASSERT_TRUE(phrase("lua_script", script, output, ResponseTemplate::Language::Italian, text));
+    TEST_ASSERT_EQUAL_STRING(
+        "La temperatura adesso è di 18 gradi, percepiti 17 gradi, con umidità al 63%.", text.c_str());
+    TEST_ASSERT_TRUE(phrase("lua_script", script, output, ResponseTemplate::Language::English, text));
+    TEST_ASSERT_EQUAL_STRING("It is 18 degrees now (Partly cloudy), feels like 17, humidity 63%.", text.c_str());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_doc_templates_compile);
+    RUN_TEST(test_weather_example_is_phrased);
+    RUN_TEST(test_missing_fields_fall_through);
+    RUN_TEST(test_unknown_weather_code_uses_the_fallback);
+    RUN_TEST(test_wttr_output_is_phrased);
+    return UNITY_END();
+}
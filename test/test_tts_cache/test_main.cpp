@@ -0,0 +1,364 @@
+// TtsCache on a host directory: key stability (whitespace, speed rounding,
+// fields), LRU / size / entry-count / age eviction, index persistence, and
+// downloads written under a temporary name until commit().
+
+#include <unity.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+
+#include <FS.h>
+
+#include "core/tts_cache.h"
+
+namespace {
+
+char g_root[] = "/tmp/tts_cache_XXXXXX";
+fs::FS* g_fs = nullptr;
+int g_dir_count = 0;
+
+TtsCache::VoiceParams params(const char* voice = "alloy", float speed = 1.0f) {
+    TtsCache::VoiceParams result;
+    result.voice = voice;
+    result.model = "tts-1";
+    result.format = "wav";
+    result.speed = speed;
+    return result;
+}
+
+PsramVector<uint8_t> audio(size_t bytes) {
+    PsramVector<uint8_t> data(bytes);
+    for (size_t i = 0; i < bytes; ++i) {
+        data[i] = static_cast<uint8_t>(i);
+    }
+    return data;
+}
+
+// A fresh cache directory: configure() reloads whenever the directory changes
+std::string freshDir(size_t max_bytes) {
+    const std::string dir = "/cache" + std::to_string(++g_dir_count);
+    TEST_ASSERT_TRUE(TtsCache::getInstance().configure(g_fs, dir, "/sd" + dir, max_bytes));
+    return dir;
+}
+
+std::string store(const std::string& text, size_t bytes) {
+    const std::string key = TtsCache::makeKey(text, params());
+    std::string path;
+    TEST_ASSERT_TRUE(TtsCache::getInstance().store(key, text, audio(bytes), path));
+    return key;
+}
+
+bool fileExists(const std::string& dir, const std::string& key, const char* suffix = ".wav") {
+    return g_fs->exists(dir + "/c_" + key + suffix);
+}
+
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_key_ignores_whitespace_layout() {
+    const std::string key = TtsCache::makeKey("Buongiorno a tutti", params());
+    TEST_ASSERT_EQUAL(16, key.size());
+    TEST_ASSERT_EQUAL(std::string::npos, key.find_first_not_of("0123456789abcdef"));
+    TEST_ASSERT_EQUAL_STRING(key.c_str(), TtsCache::makeKey("  Buongiorno   a\ttutti\n", params()).c_str());
+    TEST_ASSERT_EQUAL_STRING(key.c_str(), TtsCache::makeKey("Buongiorno\r\na tutti", params()).c_str());
+    TEST_ASSERT_TRUE(key != TtsCache::makeKey("Buongiornoa tutti", params()));
+    TEST_ASSERT_TRUE(key != TtsCache::makeKey("Buongiorno a tutti!", params()));
+    TEST_ASSERT_TRUE(key != TtsCache::makeKey("buongiorno a tutti", params()));
+}
+
+void test_key_rounds_speed() {
+    const std::string key = TtsCache::makeKey("Ciao", params("alloy", 1.0f));
+    TEST_ASSERT_EQUAL_STRING(key.c_str(), TtsCache::makeKey("Ciao", params("alloy", 1.0000001f)).c_str());
+    TEST_ASSERT_EQUAL_STRING(key.c_str(), TtsCache::makeKey("Ciao", params("alloy", 0.1f * 10.0f)).c_str());
+    TEST_ASSERT_EQUAL_STRING(key.c_str(), TtsCache::makeKey("Ciao", params("alloy", 1.004f)).c_str());
+    TEST_ASSERT_TRUE(key != TtsCache::makeKey("Ciao", params("alloy", 1.01f)));
+    TEST_ASSERT_TRUE(key != TtsCache::makeKey("Ciao", params("alloy", 1.25f)));
+}
+
+void test_key_covers_every_voice_field() {
+    const TtsCache::VoiceParams base = params();
+    const std::string key = TtsCache::makeKey("Ciao", base);
+    TtsCache::VoiceParams changed = base;
+    changed.voice = "nova";
+    TEST_ASSERT_TRUE(key != TtsCache::makeKey("Ciao", changed));
+    changed = base;
+    changed.model = "tts-1-hd";
+    TEST_ASSERT_TRUE(key != TtsCache::makeKey("Ciao", changed));
+    changed = base;
+    changed.format = "mp3";
+    TEST_ASSERT_TRUE(key != TtsCache::makeKey("Ciao", changed));
+
+    // Fields are separated: "Cia" + "oalloy" is not "Ciao" + "alloy"
+    changed = base;
+    changed.voice = "oalloy";
+    TEST_ASSERT_TRUE(key != TtsCache::makeKey("Cia", changed));
+}
+
+void test_key_is_stable_across_builds() {
+    // Keys name files that outlive firmware updates: FNV-1a 64 over the fields, each ending in 0x1f
+    TEST_ASSERT_EQUAL_STRING("519ab021fdceb14a", TtsCache::makeKey("Buongiorno a tutti", params()).c_str());
+}
+
+void test_store_and_lookup() {
+    TtsCache& cache = TtsCache::getInstance();
+    const std::string dir = freshDir(64 * 1024);
+    const TtsCache::Stats before = cache.getStats();
+
+    std::string path;
+    const std::string key = TtsCache::makeKey("Ciao", params());
+    TEST_ASSERT_FALSE(cache.lookup(key, path));
+    TEST_ASSERT_TRUE(cache.store(key, "Ciao", audio(1000), path));
+    TEST_ASSERT_EQUAL_STRING(("/sd" + dir + "/c_" + key + ".wav").c_str(), path.c_str());
+    TEST_ASSERT_TRUE(fileExists(dir, key));
+    TEST_ASSERT_FALSE(fileExists(dir, key, ".part"));
+
+    path.clear();
+    TEST_ASSERT_TRUE(cache.lookup(key, path));
+    TEST_ASSERT_EQUAL_STRING(("/sd" + dir + "/c_" + key + ".wav").c_str(), path.c_str());
+
+    const TtsCache::Stats stats = cache.getStats();
+    TEST_ASSERT_EQUAL(before.hits + 1, stats.hits);
+    TEST_ASSERT_EQUAL(before.misses + 1, stats.misses);
+    TEST_ASSERT_EQUAL(before.stores + 1, stats.stores);
+    TEST_ASSERT_EQUAL(1, stats.entries);
+    TEST_ASSERT_EQUAL(1000, stats.bytes);
+
+    // A file lost from storage is a miss, not a broken path
+    g_fs->remove(dir + "/c_" + key + ".wav");
+    TEST_ASSERT_FALSE(cache.lookup(key, path));
+    TEST_ASSERT_EQUAL(0, cache.getStats().entries);
+}
+
+void test_one_reply_cannot_flush_the_cache() {
+    TtsCache& cache = TtsCache::getInstance();
+    freshDir(4000);
+    std::string path;
+    TEST_ASSERT_FALSE(cache.store(TtsCache::makeKey("lunga", params()), "lunga", audio(1001), path));
+    TEST_ASSERT_TRUE(cache.store(TtsCache::makeKey("breve", params()), "breve", audio(1000), path));
+}
+
+void test_size_budget_evicts_least_recently_used() {
+    TtsCache& cache = TtsCache::getInstance();
+    const std::string dir = freshDir(4000);
+    const std::string a = store("uno", 1000);
+    const std::string b = store("due", 1000);
+    const std::string c = store("tre", 1000);
+    const std::string d = store("quattro", 1000);
+    TEST_ASSERT_EQUAL(4000, cache.getStats().bytes);
+
+    std::string path;
+    TEST_ASSERT_TRUE(cache.lookup(a, path));   // "uno" is now the most recent
+    const std::string e = store("cinque", 1000);
+
+    TEST_ASSERT_TRUE(cache.contains(a));
+    TEST_ASSERT_FALSE(cache.contains(b));
+    TEST_ASSERT_FALSE(fileExists(dir, b));
+    TEST_ASSERT_TRUE(cache.contains(c));
+    TEST_ASSERT_TRUE(cache.contains(d));
+    TEST_ASSERT_TRUE(cache.contains(e));
+    TEST_ASSERT_EQUAL(4000, cache.getStats().bytes);
+
+    // Shrinking the budget evicts down to it, oldest first
+    TEST_ASSERT_TRUE(cache.configure(g_fs, dir, "/sd" + dir, 2000));
+    TEST_ASSERT_EQUAL(2, cache.getStats().entries);
+    TEST_ASSERT_TRUE(cache.contains(a));
+    TEST_ASSERT_TRUE(cache.contains(e));
+    TEST_ASSERT_FALSE(fileExists(dir, c));
+    TEST_ASSERT_FALSE(fileExists(dir, d));
+}
+
+void test_entry_limit_evicts_least_recently_used() {
+    TtsCache& cache = TtsCache::getInstance();
+    freshDir(1024 * 1024);
+    std::string first;
+    for (size_t i = 0; i <= TtsCache::kMaxEntries; ++i) {
+        const std::string key = store("frase " + std::to_string(i), 16);
+        first = i == 0 ? key : first;
+    }
+    TEST_ASSERT_EQUAL(TtsCache::kMaxEntries, cache.getStats().entries);
+    TEST_ASSERT_FALSE(cache.contains(first));
+    TEST_ASSERT_TRUE(cache.contains(TtsCache::makeKey("frase 1", params())));
+}
+
+void test_old_entries_expire() {
+    TtsCache& cache = TtsCache::getInstance();
+    const std::string dir = "/cache" + std::to_string(++g_dir_count);
+    TEST_ASSERT_TRUE(g_fs->mkdir(dir));
+
+    const std::string old_key = TtsCache::makeKey("vecchia", params());
+    const std::string fresh_key = TtsCache::makeKey("recente", params());
+    const std::string unsynced_key = TtsCache::makeKey("senza orologio", params());
+    const uint32_t now = static_cast<uint32_t>(time(nullptr));
+    const uint32_t max_age_s = TtsCache::kMaxAgeDays * 24 * 3600;
+    char index[512];
+    snprintf(index, sizeof(index),
+             "{\"version\":1,\"tick\":3,\"entries\":["
+             "{\"key\":\"%s\",\"bytes\":10,\"created\":%u,\"last_use\":3,\"hits\":9},"
+             "{\"key\":\"%s\",\"bytes\":10,\"created\":%u,\"last_use\":1,\"hits\":0},"
+             "{\"key\":\"%s\",\"bytes\":10,\"created\":0,\"last_use\":2,\"hits\":0}]}",
+             old_key.c_str(), (unsigned)(now - max_age_s - 60), fresh_key.c_str(),
+             (unsigned)(now - max_age_s + 3600), unsynced_key.c_str());
+    File file = g_fs->open(dir + "/index.json", FILE_WRITE);
+    file.write(reinterpret_cast<const uint8_t*>(index), strlen(index));
+    file.close();
+    for (const std::string& key : {old_key, fresh_key, unsynced_key}) {
+        File audio_file = g_fs->open(dir + "/c_" + key + ".wav", FILE_WRITE);
+        audio_file.write(reinterpret_cast<const uint8_t*>("0123456789"), 10);
+        audio_file.close();
+    }
+
+    TEST_ASSERT_TRUE(cache.configure(g_fs, dir, "/sd" + dir, 64 * 1024));
+    TEST_ASSERT_FALSE(cache.contains(old_key));      // Past kMaxAgeDays, even though most used
+    TEST_ASSERT_FALSE(fileExists(dir, old_key));
+    TEST_ASSERT_TRUE(cache.contains(fresh_key));
+    TEST_ASSERT_TRUE(cache.contains(unsynced_key));  // Age starts at the first synced clock
+    TEST_ASSERT_EQUAL(20, cache.getStats().bytes);
+}
+
+void test_index_survives_reconfigure() {
+    TtsCache& cache = TtsCache::getInstance();
+    const std::string dir = freshDir(64 * 1024);
+    const std::string key = store("Ho acceso la luce", 100);
+    store("Una risposta molto lunga " + std::string(TtsCache::kMaxIndexedTextChars, 'x'), 100);
+    std::string path;
+    TEST_ASSERT_TRUE(cache.lookup(key, path));
+    TEST_ASSERT_TRUE(cache.lookup(key, path));
+
+    freshDir(64 * 1024);   // Switching away persists the pending hits
+    TEST_ASSERT_FALSE(cache.contains(key));
+    TEST_ASSERT_TRUE(cache.configure(g_fs, dir, "/sd" + dir, 64 * 1024));
+    TEST_ASSERT_TRUE(cache.contains(key));
+    TEST_ASSERT_EQUAL(2, cache.getStats().entries);
+
+    // Only short phrases keep their text for pre-warming
+    const std::vector<std::string> texts = cache.frequentTexts(8, 0);
+    TEST_ASSERT_EQUAL(1, texts.size());
+    TEST_ASSERT_EQUAL_STRING("Ho acceso la luce", texts[0].c_str());
+    TEST_ASSERT_EQUAL(1, cache.frequentTexts(8, 2).size());
+    TEST_ASSERT_EQUAL(0, cache.frequentTexts(8, 3).size());
+}
+
+void test_download_is_only_playable_after_commit() {
+    TtsCache& cache = TtsCache::getInstance();
+    const std::string dir = freshDir(64 * 1024);
+    const std::string key = TtsCache::makeKey("In streaming", params());
+
+    fs::FS* filesystem = nullptr;
+    std::string path_on_fs;
+    std::string output_path;
+    TEST_ASSERT_TRUE(cache.reserve(key, filesystem, path_on_fs, output_path));
+    TEST_ASSERT_EQUAL_PTR(g_fs, filesystem);
+    TEST_ASSERT_EQUAL_STRING((dir + "/c_" + key + ".part").c_str(), path_on_fs.c_str());
+    TEST_ASSERT_EQUAL_STRING(("/sd" + dir + "/c_" + key + ".wav").c_str(), output_path.c_str());
+
+    // Half-written: nothing under the playable name
+    File file = filesystem->open(path_on_fs, FILE_WRITE);
+    const PsramVector<uint8_t> data = audio(2000);
+    file.write(data.data(), 1000);
+    std::string path;
+    TEST_ASSERT_FALSE(fileExists(dir, key));
+    TEST_ASSERT_FALSE(cache.lookup(key, path));
+    file.write(data.data() + 1000, 1000);
+    file.close();
+
+    cache.commit(key, "In streaming", true, 2000);
+    TEST_ASSERT_TRUE(fileExists(dir, key));
+    TEST_ASSERT_FALSE(fileExists(dir, key, ".part"));
+    TEST_ASSERT_TRUE(cache.lookup(key, path));
+    TEST_ASSERT_EQUAL_STRING(output_path.c_str(), path.c_str());
+    TEST_ASSERT_EQUAL(2000, cache.getStats().bytes);
+
+    // Re-synthesized while cached: the old file stays playable until the new one is complete
+    TEST_ASSERT_TRUE(cache.reserve(key, filesystem, path_on_fs, output_path));
+    file = filesystem->open(path_on_fs, FILE_WRITE);
+    file.write(data.data(), 500);
+    file.close();
+    TEST_ASSERT_TRUE(cache.lookup(key, path));
+    cache.commit(key, "In streaming", true, 500);
+    TEST_ASSERT_EQUAL(1, cache.getStats().entries);
+    TEST_ASSERT_EQUAL(500, cache.getStats().bytes);
+    file = g_fs->open(dir + "/c_" + key + ".wav", FILE_READ);
+    TEST_ASSERT_EQUAL(500, file.size());
+    file.close();
+}
+
+void test_failed_download_leaves_nothing() {
+    TtsCache& cache = TtsCache::getInstance();
+    const std::string dir = freshDir(4000);
+    fs::FS* filesystem = nullptr;
+    std::string path_on_fs;
+    std::string output_path;
+
+    const std::string aborted = TtsCache::makeKey("Interrotta", params());
+    TEST_ASSERT_TRUE(cache.reserve(aborted, filesystem, path_on_fs, output_path));
+    File file = filesystem->open(path_on_fs, FILE_WRITE);
+    file.write(audio(300).data(), 300);
+    file.close();
+    cache.commit(aborted, "Interrotta", false, 300);
+    TEST_ASSERT_FALSE(fileExists(dir, aborted, ".part"));
+    TEST_ASSERT_FALSE(cache.contains(aborted));
+
+    const std::string too_big = TtsCache::makeKey("Troppo lunga", params());
+    TEST_ASSERT_TRUE(cache.reserve(too_big, filesystem, path_on_fs, output_path));
+    file = filesystem->open(path_on_fs, FILE_WRITE);
+    file.write(audio(1500).data(), 1500);
+    file.close();
+    cache.commit(too_big, "Troppo lunga", true, 1500);
+    TEST_ASSERT_FALSE(fileExists(dir, too_big, ".part"));
+    TEST_ASSERT_FALSE(fileExists(dir, too_big));
+    TEST_ASSERT_FALSE(cache.contains(too_big));
+    TEST_ASSERT_EQUAL(0, cache.getStats().entries);
+}
+
+void test_leftovers_are_swept_on_configure() {
+    TtsCache& cache = TtsCache::getInstance();
+    const std::string dir = freshDir(64 * 1024);
+    const std::string kept = store("Tenuta", 100);
+
+    // Power lost mid-download, and a file written before its index update
+    const std::string partial = TtsCache::makeKey("A metà", params());
+    const std::string unindexed = TtsCache::makeKey("Mai indicizzata", params());
+    for (const std::string& name : {"/c_" + partial + ".part", "/c_" + unindexed + ".wav", std::string("/note.txt")}) {
+        File file = g_fs->open(dir + name, FILE_WRITE);
+        file.write(reinterpret_cast<const uint8_t*>("x"), 1);
+        file.close();
+    }
+
+    freshDir(64 * 1024);
+    TEST_ASSERT_TRUE(cache.configure(g_fs, dir, "/sd" + dir, 64 * 1024));
+    TEST_ASSERT_TRUE(fileExists(dir, kept));
+    TEST_ASSERT_FALSE(fileExists(dir, partial, ".part"));
+    TEST_ASSERT_FALSE(fileExists(dir, unindexed));
+    TEST_ASSERT_TRUE(g_fs->exists(dir + "/note.txt"));   // Not ours
+    TEST_ASSERT_EQUAL(1, cache.getStats().entries);
+}
+
+int main() {
+    if (!mkdtemp(g_root)) {
+        return 1;
+    }
+    fs::FS filesystem(g_root);
+    g_fs = &filesystem;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_key_ignores_whitespace_layout);
+    RUN_TEST(test_key_rounds_speed);
+    RUN_TEST(test_key_covers_every_voice_field);
+    RUN_TEST(test_key_is_stable_across_builds);
+    RUN_TEST(test_store_and_lookup);
+    RUN_TEST(test_one_reply_cannot_flush_the_cache);
+    RUN_TEST(test_size_budget_evicts_least_recently_used);
+    RUN_TEST(test_entry_limit_evicts_least_recently_used);
+    RUN_TEST(test_old_entries_expire);
+    RUN_TEST(test_index_survives_reconfigure);
+    RUN_TEST(test_download_is_only_playable_after_commit);
+    RUN_TEST(test_failed_download_leaves_nothing);
+    RUN_TEST(test_leftovers_are_swept_on_configure);
+    const int failures = UNITY_END();
+    system((std::string("rm -rf ") + g_root).c_str());
+    return failures;
+}
@@ -0,0 +1,520 @@
+// TtsSegmenter cut rules, and TtsPipeline against a local stand-in TTS server:
+// segment order, requests in flight, time-to-first-audio while the reply is
+// still streaming, and cancellation of pending and in-flight segments.
+
+#include <unity.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../lib/openESPaudio/src/data_source.h"
+#include "core/cancel_token.h"
+#include "core/http_client_pool.h"
+#include "core/tts_pipeline.h"
+#include "stand_in_server.h"
+#include "utils/tts_segmenter.h"
+
+namespace {
+
+constexpr uint32_t kSampleRate = 24000;
+constexpr size_t kPcmBytesPerChar = 480;   // 10 ms of mono PCM16 per character
+constexpr uint32_t kBaseLatencyMs = 80;    // Synthesis time: base + per character
+constexpr uint32_t kLatencyPerCharMs = 2;
+constexpr size_t kSendChunkBytes = 4096;
+constexpr size_t kPlayChunkBytes = 960;    // 20 ms of audio, played at 10x real time
+constexpr uint32_t kPlayChunkMs = 2;
+constexpr uint32_t kTokenDelayMs = 15;     // LLM stream, one word per token
+constexpr size_t kWavHeaderBytes = 44;
+
+const char* const kReply =
+    "Certo! Oggi a Milano il cielo sarà sereno fino a sera. "
+    "La temperatura massima arriverà a 23.5 gradi, con vento debole da nord-ovest. "
+    "Domani è prevista qualche nuvola in più, ma senza pioggia. "
+    "Trovi i dettagli su https://meteo.example.it/milano. "
+    "Vuoi che ti ricordi di prendere l'ombrello?";
+
+const char* const kReplySegments[] = {
+    "Certo! Oggi a Milano il cielo sarà sereno fino a sera.",
+    "La temperatura massima arriverà a 23.5 gradi, con vento debole da nord-ovest.",
+    "Domani è prevista qualche nuvola in più, ma senza pioggia.",
+    "Trovi i dettagli su https://meteo.example.it/milano.",
+    "Vuoi che ti ricordi di prendere l'ombrello?",
+};
+
+uint32_t elapsedMs(std::chrono::steady_clock::time_point since) {
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - since).count());
+}
+
+void putLe16(std::string& out, size_t offset, uint16_t value) {
+    out[offset] = static_cast<char>(value);
+    out[offset + 1] = static_cast<char>(value >> 8);
+}
+
+void putLe32(std::string& out, size_t offset, uint32_t value) {
+    putLe16(out, offset, static_cast<uint16_t>(value));
+    putLe16(out, offset + 2, static_cast<uint16_t>(value >> 16));
+}
+
+// The audio the stand-in "speaks" for a text: the text bytes repeated, so the
+// played stream shows which segment each byte came from
+std::string pcmFor(const std::string& text) {
+    std::string pcm(text.size() * kPcmBytesPerChar, '\0');
+    for (size_t i = 0; i < pcm.size(); ++i) {
+        pcm[i] = text[i % text.size()];
+    }
+    return pcm;
+}
+
+std::string wavFor(const std::string& text, uint32_t sample_rate = kSampleRate) {
+    const std::string pcm = pcmFor(text);
+    std::string wav("RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x01\0\0\0\0\0\0\0\0\0\x02\0\x10\0data\0\0\0\0", 44);
+    putLe32(wav, 4, static_cast<uint32_t>(pcm.size() + 36));
+    putLe32(wav, 24, sample_rate);
+    putLe32(wav, 28, sample_rate * 2);
+    putLe32(wav, 40, static_cast<uint32_t>(pcm.size()));
+    return wav + pcm;
+}
+
+std::vector<std::string> segmentAll(const std::string& text, TtsSegmenter segmenter = TtsSegmenter()) {
+    std::vector<std::string> segments;
+    segmenter.finish(text, segments);
+    return segments;
+}
+
+// POST /v1/audio/speech with the text as body: a WAV after a length-dependent
+// synthesis time, sent in pieces. Counts requests being served and abandoned ones.
+struct TtsServer {
+    std::atomic<int> in_flight{0};
+    std::atomic<uint32_t> abandoned{0};
+    std::mutex mutex;
+    std::vector<std::string> texts;        // In arrival order
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        texts.clear();
+        abandoned = 0;
+    }
+
+    StandInServer server{[this](const StandInServer::Request& request, StandInServer::Response& response) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            texts.push_back(request.body);
+        }
+        ++in_flight;
+        response.sleepMs(kBaseLatencyMs + kLatencyPerCharMs * static_cast<uint32_t>(request.body.size()));
+        const bool mismatch = request.body.find("44100") != std::string::npos;
+        const std::string wav = wavFor(request.body, mismatch ? 44100 : kSampleRate);
+        response.begin(200, "audio/wav", static_cast<long>(wav.size()));
+        for (size_t offset = 0; offset < wav.size(); offset += kSendChunkBytes) {
+            if (!response.send(wav.substr(offset, kSendChunkBytes))) {
+                ++abandoned;
+                break;
+            }
+            response.sleepMs(1);
+        }
+        --in_flight;
+    }};
+};
+
+// Shared by the tests: a failed assertion unwinds without running destructors
+TtsServer g_tts;
+
+// Synthesis calls made by the pipeline at once
+std::atomic<int> g_synthesizing{0};
+std::atomic<int> g_max_synthesizing{0};
+
+struct SynthesisCount {
+    SynthesisCount() {
+        const int now = ++g_synthesizing;
+        int seen = g_max_synthesizing.load();
+        while (now > seen && !g_max_synthesizing.compare_exchange_weak(seen, now)) {
+        }
+    }
+    ~SynthesisCount() { --g_synthesizing; }
+};
+
+// VoiceAssistant::synthesizeSpeech() against the stand-in server
+bool synthesize(const std::string& text, PsramVector<uint8_t>& audio, const std::atomic<bool>* cancel) {
+    audio.clear();
+    SynthesisCount count;
+    CancelToken::Scope cancel_scope{CancelToken(cancel)};
+
+    HttpClientPool& pool = HttpClientPool::getInstance();
+    HttpClientPool::Options options;
+    options.stage = "tts";
+    options.timeout_ms = 5000;
+    esp_http_client_handle_t client = pool.acquire(g_tts.server.url("/v1/audio/speech"), options);
+    if (!client) {
+        return false;
+    }
+    pool.setHeader(client, "Content-Type", "text/plain");
+    int content_length = -1;
+    if (pool.request(client, text.data(), text.size(), content_length) != 200) {
+        pool.release(client);
+        return false;
+    }
+
+    char chunk[1024];
+    int read_len;
+    while ((read_len = pool.read(client, chunk, sizeof(chunk))) > 0) {
+        audio.insert(audio.end(), reinterpret_cast<uint8_t*>(chunk), reinterpret_cast<uint8_t*>(chunk) + read_len);
+    }
+    pool.release(client);
+    return read_len == 0 && !CancelToken::current().cancelled() && !audio.empty();
+}
+
+// AudioManager::playSource(): drains the stream on its own thread
+struct Player {
+    std::thread thread;
+    std::atomic<bool> finished{true};
+    std::mutex mutex;
+    std::string stream;
+    uint32_t sample_rate = 0;
+    std::atomic<uint32_t> starts{0};
+    std::chrono::steady_clock::time_point first_pcm;
+    bool have_pcm = false;
+
+    void reset() {
+        join();
+        std::lock_guard<std::mutex> lock(mutex);
+        stream.clear();
+        starts = 0;
+        have_pcm = false;
+    }
+
+    bool play(std::unique_ptr<IDataSource> source, uint32_t rate) {
+        join();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stream.clear();
+            sample_rate = rate;
+            have_pcm = false;
+            ++starts;
+        }
+        finished = false;
+        thread = std::thread([this, src = std::move(source)]() {
+            char buffer[kPlayChunkBytes];
+            size_t n;
+            while ((n = src->read(buffer, sizeof(buffer))) > 0) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stream.append(buffer, n);
+                    if (!have_pcm && stream.size() > kWavHeaderBytes) {
+                        have_pcm = true;
+                        first_pcm = std::chrono::steady_clock::now();
+                    }
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(kPlayChunkMs));
+            }
+            src->close();
+            finished = true;
+        });
+        return true;
+    }
+
+    void join() {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    bool waitFinished(uint32_t timeout_ms) {
+        for (uint32_t waited = 0; !finished && waited < timeout_ms; waited += 5) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return finished;
+    }
+
+    std::string pcm() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stream.size() > kWavHeaderBytes ? stream.substr(kWavHeaderBytes) : std::string();
+    }
+};
+
+Player g_player;
+
+void resetBackend() {
+    g_player.reset();
+    g_tts.reset();
+    g_max_synthesizing = 0;
+    TtsPipeline::getInstance().setBackend(
+        synthesize,
+        [](std::unique_ptr<IDataSource> source, uint32_t sample_rate) {
+            return g_player.play(std::move(source), sample_rate);
+        });
+}
+
+uint32_t cancelledRequests() {
+    for (const HttpClientPool::StageStats& stats : HttpClientPool::getInstance().getStats()) {
+        if (stats.stage == "tts") {
+            return stats.cancelled;
+        }
+    }
+    return 0;
+}
+
+bool waitInactive(uint32_t timeout_ms) {
+    for (uint32_t waited = 0; TtsPipeline::getInstance().isActive() && waited < timeout_ms; waited += 5) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return !TtsPipeline::getInstance().isActive();
+}
+
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_segmenter_cuts_at_sentence_ends() {
+    const std::vector<std::string> segments = segmentAll(kReply);
+    TEST_ASSERT_EQUAL(sizeof(kReplySegments) / sizeof(kReplySegments[0]), segments.size());
+    for (size_t i = 0; i < segments.size(); ++i) {
+        TEST_ASSERT_EQUAL_STRING(kReplySegments[i], segments[i].c_str());
+    }
+}
+
+void test_segmenter_streaming_matches_one_shot() {
+    const std::string reply(kReply);
+    const std::vector<std::string> expected = segmentAll(reply);
+    for (size_t step : {1, 2, 3, 7, 16}) {
+        TtsSegmenter segmenter;
+        std::vector<std::string> segments;
+        for (size_t length = step; length < reply.size(); length += step) {
+            segmenter.update(reply.substr(0, length), segments);
+        }
+        segmenter.finish(reply, segments);
+        TEST_ASSERT_EQUAL(expected.size(), segments.size());
+        for (size_t i = 0; i < segments.size(); ++i) {
+            TEST_ASSERT_EQUAL_STRING(expected[i].c_str(), segments[i].c_str());
+        }
+    }
+}
+
+void test_segmenter_waits_on_a_trailing_period() {
+    TtsSegmenter segmenter;
+    std::vector<std::string> segments;
+    segmenter.update("La temperatura massima arriverà a 23.", segments);
+    TEST_ASSERT_EQUAL(0, segments.size());   // Could still become 23.5
+    segmenter.update("La temperatura massima arriverà a 23.5 gradi. Domani", segments);
+    TEST_ASSERT_EQUAL(1, segments.size());
+    TEST_ASSERT_EQUAL_STRING("La temperatura massima arriverà a 23.5 gradi.", segments[0].c_str());
+}
+
+void test_segmenter_merges_short_sentences() {
+    const std::vector<std::string> segments = segmentAll("Ok. Fatto. Ho spento la luce in cucina e in sala.");
+    TEST_ASSERT_EQUAL(1, segments.size());
+    TEST_ASSERT_EQUAL_STRING("Ok. Fatto. Ho spento la luce in cucina e in sala.", segments[0].c_str());
+}
+
+void test_segmenter_cuts_long_text_at_clauses() {
+    const std::string text =
+        "ho acceso la luce in cucina, ho abbassato le tapparelle in sala, ho impostato il termostato "
+        "a venti gradi e ho avviato la lavatrice con il programma delicati";
+    const std::vector<std::string> segments = segmentAll(text, TtsSegmenter(24, 60));
+    TEST_ASSERT_GREATER_THAN(1u, segments.size());
+    std::string joined;
+    for (const std::string& segment : segments) {
+        TEST_ASSERT_LESS_OR_EQUAL(60u, segment.size());
+        joined += (joined.empty() ? "" : " ") + segment;
+    }
+    TEST_ASSERT_EQUAL_STRING("ho acceso la luce in cucina,", segments[0].c_str());
+    TEST_ASSERT_EQUAL_STRING(text.c_str(), joined.c_str());
+}
+
+void test_segmenter_drops_markdown() {
+    const std::vector<std::string> segments = segmentAll("**Attenzione:** il forno è `acceso` da _due_ ore.\n# Fine");
+    TEST_ASSERT_EQUAL(2, segments.size());
+    TEST_ASSERT_EQUAL_STRING("Attenzione: il forno è acceso da due ore.", segments[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("Fine", segments[1].c_str());
+}
+
+void test_pipeline_plays_segments_in_order() {
+    resetBackend();
+    TtsPipeline& pipeline = TtsPipeline::getInstance();
+    pipeline.speak(kReply);
+    TEST_ASSERT_TRUE(waitInactive(10000));
+    TEST_ASSERT_TRUE(g_player.waitFinished(1000));
+
+    std::string expected;
+    for (const char* segment : kReplySegments) {
+        expected += pcmFor(segment);
+    }
+    const std::string played = g_player.pcm();
+    TEST_ASSERT_EQUAL(expected.size(), played.size());
+    TEST_ASSERT_TRUE(played == expected);
+    TEST_ASSERT_EQUAL(kSampleRate, g_player.sample_rate);
+
+    const TtsPipeline::Stats stats = pipeline.getStats();
+    TEST_ASSERT_EQUAL(5, stats.segments);
+    TEST_ASSERT_EQUAL(5, stats.synthesized);
+    TEST_ASSERT_EQUAL(5, stats.played);
+    TEST_ASSERT_EQUAL(0, stats.failed);
+
+    // Synthesis overlaps, within the limit
+    TEST_ASSERT_EQUAL(TtsPipeline::kMaxInFlight, g_max_synthesizing.load());
+    printf("in order: first audio %u ms, %d requests in flight at most\n",
+           (unsigned)stats.first_audio_ms, g_max_synthesizing.load());
+}
+
+void test_pipeline_speaks_while_the_reply_streams() {
+    // Baseline: wait for the whole reply, then one request for all of it
+    resetBackend();
+    const std::string reply(kReply);
+    size_t words = 1;
+    for (char c : reply) {
+        words += c == ' ' ? 1 : 0;
+    }
+    const uint32_t stream_ms = static_cast<uint32_t>(words) * kTokenDelayMs;
+    auto start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(stream_ms));
+    PsramVector<uint8_t> whole;
+    TEST_ASSERT_TRUE(synthesize(reply, whole, nullptr));
+    const uint32_t whole_ms = elapsedMs(start);
+
+    // Pipelined: sentences go out while the LLM is still writing
+    resetBackend();
+    TtsPipeline& pipeline = TtsPipeline::getInstance();
+    start = std::chrono::steady_clock::now();
+    pipeline.start();
+    for (size_t end = reply.find(' '); end != std::string::npos; end = reply.find(' ', end + 1)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(kTokenDelayMs));
+        pipeline.update(reply.substr(0, end + 1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(kTokenDelayMs));
+    const uint32_t finish_ms = elapsedMs(start);
+    const TtsPipeline::Stats at_finish = pipeline.getStats();
+    pipeline.finish(reply);
+    TEST_ASSERT_TRUE(waitInactive(10000));
+    TEST_ASSERT_TRUE(g_player.waitFinished(1000));
+
+    const TtsPipeline::Stats stats = pipeline.getStats();
+    const uint32_t first_pcm_ms = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        g_player.first_pcm - start).count());
+    printf("streamed reply (%u ms): first audio %u ms pipelined, %u ms after the whole reply\n",
+           (unsigned)stream_ms, (unsigned)first_pcm_ms, (unsigned)whole_ms);
+
+    TEST_ASSERT_EQUAL(5, stats.played);
+    TEST_ASSERT_NOT_EQUAL(0, at_finish.first_audio_ms);   // Playing before the reply was complete
+    TEST_ASSERT_LESS_THAN(finish_ms, first_pcm_ms);
+    TEST_ASSERT_LESS_THAN(whole_ms / 2, first_pcm_ms);
+}
+
+void test_cancel_drops_pending_segments() {
+    resetBackend();
+    TtsPipeline& pipeline = TtsPipeline::getInstance();
+    std::string reply;
+    for (int i = 0; i < 4; ++i) {
+        reply += kReply;
+        reply += ' ';
+    }
+    pipeline.speak(reply);
+    for (int i = 0; i < 400 && g_player.starts == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    TEST_ASSERT_EQUAL(1, g_player.starts);
+
+    const uint32_t cancelled_before = cancelledRequests();
+    const auto cancelled_at = std::chrono::steady_clock::now();
+    pipeline.cancel();
+    TEST_ASSERT_FALSE(pipeline.isActive());
+    TEST_ASSERT_TRUE(g_player.waitFinished(1000));
+    const uint32_t stop_ms = elapsedMs(cancelled_at);
+
+    // Workers notice within one cancel poll of the pool; nothing new is requested
+    std::this_thread::sleep_for(std::chrono::milliseconds(2 * HttpClientPool::kCancelPollMs + 100));
+    size_t requested;
+    {
+        std::lock_guard<std::mutex> lock(g_tts.mutex);
+        requested = g_tts.texts.size();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    const TtsPipeline::Stats stats = pipeline.getStats();
+    printf("cancel: playback stopped in %u ms, %u of %u segments requested, %u played\n",
+           (unsigned)stop_ms, (unsigned)requested, (unsigned)stats.segments, (unsigned)stats.played);
+
+    TEST_ASSERT_EQUAL(20, stats.segments);
+    TEST_ASSERT_LESS_THAN(stats.segments, stats.played);
+    TEST_ASSERT_LESS_THAN(stats.segments, requested);
+    TEST_ASSERT_EQUAL(0, g_tts.in_flight.load());
+    TEST_ASSERT_GREATER_THAN(cancelled_before, cancelledRequests());   // In-flight downloads abandoned
+    {
+        std::lock_guard<std::mutex> lock(g_tts.mutex);
+        TEST_ASSERT_EQUAL(requested, g_tts.texts.size());
+    }
+    TEST_ASSERT_LESS_THAN(100u + TtsPipeline::kSegmentWaitMs / 100, stop_ms);
+}
+
+void test_new_session_cancels_the_previous_one() {
+    resetBackend();
+    TtsPipeline& pipeline = TtsPipeline::getInstance();
+    const uint32_t first = pipeline.speak(kReply);
+    for (int i = 0; i < 400 && g_player.starts == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    const uint32_t second = pipeline.speak("Va bene, lascio perdere il meteo per oggi.");
+    TEST_ASSERT_NOT_EQUAL(first, second);
+    TEST_ASSERT_TRUE(waitInactive(5000));
+    TEST_ASSERT_TRUE(g_player.waitFinished(1000));
+
+    // The second session played on its own, the first one was abandoned
+    TEST_ASSERT_EQUAL(2, g_player.starts);
+    TEST_ASSERT_TRUE(g_player.pcm() == pcmFor("Va bene, lascio perdere il meteo per oggi."));
+    TEST_ASSERT_EQUAL(second, pipeline.getStats().session);
+}
+
+void test_mismatched_and_failed_segments_are_skipped() {
+    resetBackend();
+    TtsPipeline& pipeline = TtsPipeline::getInstance();
+    // The second segment comes back at another sample rate, the third is refused
+    TtsPipeline::getInstance().setBackend(
+        [](const std::string& text, PsramVector<uint8_t>& audio, const std::atomic<bool>* cancel) {
+            return text.find("rifiuta") == std::string::npos && synthesize(text, audio, cancel);
+        },
+        [](std::unique_ptr<IDataSource> source, uint32_t sample_rate) {
+            return g_player.play(std::move(source), sample_rate);
+        });
+    pipeline.start();
+    pipeline.finish("Prima frase da dire, abbastanza lunga. Questa arriva a 44100 hertz, non va bene. "
+                    "Il server rifiuta questa frase per intero. Ultima frase da dire, abbastanza lunga.");
+    TEST_ASSERT_TRUE(waitInactive(5000));
+    TEST_ASSERT_TRUE(g_player.waitFinished(1000));
+
+    const TtsPipeline::Stats stats = pipeline.getStats();
+    TEST_ASSERT_EQUAL(4, stats.segments);
+    TEST_ASSERT_EQUAL(1, stats.failed);
+    TEST_ASSERT_EQUAL(2, stats.played);
+    TEST_ASSERT_TRUE(g_player.pcm() == pcmFor("Prima frase da dire, abbastanza lunga.") +
+                                       pcmFor("Ultima frase da dire, abbastanza lunga."));
+}
+
+int main() {
+    if (!g_tts.server.start()) {
+        return 1;
+    }
+    UNITY_BEGIN();
+    RUN_TEST(test_segmenter_cuts_at_sentence_ends);
+    RUN_TEST(test_segmenter_streaming_matches_one_shot);
+    RUN_TEST(test_segmenter_waits_on_a_trailing_period);
+    RUN_TEST(test_segmenter_merges_short_sentences);
+    RUN_TEST(test_segmenter_cuts_long_text_at_clauses);
+    RUN_TEST(test_segmenter_drops_markdown);
+    RUN_TEST(test_pipeline_plays_segments_in_order);
+    RUN_TEST(test_pipeline_speaks_while_the_reply_streams);
+    RUN_TEST(test_cancel_drops_pending_segments);
+    RUN_TEST(test_new_session_cancels_the_previous_one);
+    RUN_TEST(test_mismatched_and_failed_segments_are_skipped);
+    const int failures = UNITY_END();
+    TtsPipeline::getInstance().cancel();
+    g_player.join();
+    g_tts.server.stop();
+    return failures;
+}
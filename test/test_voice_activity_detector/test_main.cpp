@@ -0,0 +1,463 @@
+// VoiceActivityDetector over a generated, labelled corpus: speech-like
+// utterances (voiced syllables with fricative onsets) mixed with white,
+// pink and mains-hum noise at several SNRs, plus noise-only clips.
+
+#include <unity.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "core/voice_activity_detector.h"
+
+namespace {
+
+constexpr uint32_t kRate = 16000;
+constexpr double kPi = 3.14159265358979323846;
+
+// Same rule as MicrophoneManager with the voice assistant's settings
+constexpr uint32_t kEndSilenceMs = 900;
+constexpr size_t kChunkSamples = 512;
+
+uint32_t msToSamples(uint32_t ms) {
+    return ms * kRate / 1000;
+}
+
+class Rng {
+public:
+    explicit Rng(uint32_t seed) : state_(seed ? seed : 1) {}
+    uint32_t next() {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 17;
+        state_ ^= state_ << 5;
+        return state_;
+    }
+    double uniform() { return (next() >> 8) / 16777216.0; }
+    double range(double lo, double hi) { return lo + (hi - lo) * uniform(); }
+    double gauss() {
+        double sum = 0;
+        for (int i = 0; i < 6; ++i) {
+            sum += uniform();
+        }
+        return (sum - 3.0) * 1.41421356;
+    }
+
+private:
+    uint32_t state_;
+};
+
+enum class Noise { White, Pink, Hum };
+
+struct Clip {
+    std::vector<float> signal;      // Speech only, before mixing
+    std::vector<uint8_t> active;    // Ground truth per sample
+};
+
+// One syllable: optional fricative onset, then a voiced part with a few
+// formant-weighted harmonics under a raised-cosine envelope
+void addSyllable(Clip& clip, Rng& rng, double level) {
+    if (rng.uniform() < 0.35) {
+        const size_t length = msToSamples(static_cast<uint32_t>(rng.range(40, 90)));
+        double previous = 0;
+        for (size_t i = 0; i < length; ++i) {
+            const double white = rng.gauss();
+            const double high = white - previous;   // First-difference high-pass
+            previous = white;
+            clip.signal.push_back(static_cast<float>(high * level * 0.12));
+            clip.active.push_back(1);
+        }
+    }
+
+    const size_t length = msToSamples(static_cast<uint32_t>(rng.range(110, 260)));
+    const double f0 = rng.range(95, 220);
+    const double formant1 = rng.range(350, 800);
+    const double formant2 = rng.range(1000, 2200);
+    double phase = 0;
+    for (size_t i = 0; i < length; ++i) {
+        const double t = static_cast<double>(i) / length;
+        const double envelope = 0.5 - 0.5 * std::cos(2 * kPi * std::min(1.0, t * 1.15));
+        const double pitch = f0 * (1.0 + 0.04 * std::sin(2 * kPi * 3 * t));
+        phase += 2 * kPi * pitch / kRate;
+        double sample = 0;
+        for (int harmonic = 1; harmonic <= 12; ++harmonic) {
+            const double frequency = pitch * harmonic;
+            const double weight = std::exp(-std::pow((frequency - formant1) / 300.0, 2)) +
+                                  0.5 * std::exp(-std::pow((frequency - formant2) / 400.0, 2)) + 0.05;
+            sample += weight * std::sin(phase * harmonic);
+        }
+        clip.signal.push_back(static_cast<float>(sample * envelope * level * 0.45));
+        clip.active.push_back(1);
+    }
+}
+
+void addSilence(Clip& clip, uint32_t ms) {
+    const size_t length = msToSamples(ms);
+    clip.signal.insert(clip.signal.end(), length, 0.0f);
+    clip.active.insert(clip.active.end(), length, 0);
+}
+
+// Lead-in, a few phrases of words separated by short and long pauses, tail
+Clip makeUtterance(uint32_t seed, double level) {
+    Rng rng(seed);
+    Clip clip;
+    addSilence(clip, static_cast<uint32_t>(rng.range(600, 1200)));
+    const int phrases = 2 + static_cast<int>(rng.uniform() * 2);
+    for (int phrase = 0; phrase < phrases; ++phrase) {
+        const int words = 2 + static_cast<int>(rng.uniform() * 4);
+        for (int word = 0; word < words; ++word) {
+            const int syllables = 1 + static_cast<int>(rng.uniform() * 3);
+            for (int syllable = 0; syllable < syllables; ++syllable) {
+                addSyllable(clip, rng, level);
+                addSilence(clip, static_cast<uint32_t>(rng.range(15, 50)));
+            }
+            addSilence(clip, static_cast<uint32_t>(rng.range(60, 200)));
+        }
+        addSilence(clip, static_cast<uint32_t>(rng.range(400, 700)));
+    }
+    addSilence(clip, 1500);
+    return clip;
+}
+
+std::vector<float> makeNoise(Noise type, size_t length, double rms, uint32_t seed) {
+    Rng rng(seed);
+    std::vector<float> noise(length);
+    double b0 = 0, b1 = 0, b2 = 0;
+    for (size_t i = 0; i < length; ++i) {
+        double sample = 0;
+        switch (type) {
+            case Noise::White:
+                sample = rng.gauss();
+                break;
+            case Noise::Pink: {
+                // Paul Kellet's economy filter, roughly -3 dB/octave
+                const double white = rng.gauss();
+                b0 = 0.99765 * b0 + white * 0.0990460;
+                b1 = 0.96300 * b1 + white * 0.2965164;
+                b2 = 0.57000 * b2 + white * 1.0526913;
+                sample = (b0 + b1 + b2 + white * 0.1848) * 0.45;
+                break;
+            }
+            case Noise::Hum: {
+                const double t = static_cast<double>(i) / kRate;
+                sample = 1.2 * std::sin(2 * kPi * 50 * t) + 0.6 * std::sin(2 * kPi * 150 * t) +
+                         0.3 * std::sin(2 * kPi * 250 * t) + 0.2 * rng.gauss();
+                break;
+            }
+        }
+        noise[i] = static_cast<float>(sample);
+    }
+
+    double energy = 0;
+    for (float sample : noise) {
+        energy += static_cast<double>(sample) * sample;
+    }
+    const double scale = rms / std::sqrt(energy / std::max<size_t>(length, 1));
+    for (float& sample : noise) {
+        sample = static_cast<float>(sample * scale);
+    }
+    return noise;
+}
+
+double rmsOfActive(const Clip& clip) {
+    double energy = 0;
+    size_t count = 0;
+    for (size_t i = 0; i < clip.signal.size(); ++i) {
+        if (clip.active[i]) {
+            energy += static_cast<double>(clip.signal[i]) * clip.signal[i];
+            ++count;
+        }
+    }
+    return count ? std::sqrt(energy / count) : 0.0;
+}
+
+std::vector<int16_t> toPcm(const std::vector<float>& signal) {
+    std::vector<int16_t> pcm(signal.size());
+    for (size_t i = 0; i < signal.size(); ++i) {
+        pcm[i] = static_cast<int16_t>(std::max(-32768.0f, std::min(32767.0f, std::round(signal[i]))));
+    }
+    return pcm;
+}
+
+std::vector<int16_t> mix(const Clip& clip, Noise type, double snr_db, uint32_t seed) {
+    const double noise_rms = rmsOfActive(clip) / std::pow(10.0, snr_db / 20.0);
+    std::vector<float> mixed = makeNoise(type, clip.signal.size(), noise_rms, seed);
+    for (size_t i = 0; i < mixed.size(); ++i) {
+        mixed[i] += clip.signal[i];
+    }
+    return toPcm(mixed);
+}
+
+void feed(VoiceActivityDetector& vad, const std::vector<int16_t>& pcm) {
+    for (size_t offset = 0; offset < pcm.size(); offset += kChunkSamples) {
+        vad.process(pcm.data() + offset, std::min(kChunkSamples, pcm.size() - offset));
+    }
+    vad.finish();
+}
+
+struct Score {
+    uint64_t true_positive = 0;
+    uint64_t false_positive = 0;
+    uint64_t false_negative = 0;
+
+    double precision() const {
+        return true_positive + false_positive ? static_cast<double>(true_positive) / (true_positive + false_positive) : 1.0;
+    }
+    double recall() const {
+        return true_positive + false_negative ? static_cast<double>(true_positive) / (true_positive + false_negative) : 1.0;
+    }
+};
+
+// Sample-level scoring. Samples within the onset time before speech and the
+// hangover after it are not scored: the detector holds segments open there
+// by design.
+void score(const VoiceActivityDetector& vad, const std::vector<uint8_t>& active, Score& total) {
+    const VoiceActivityDetector::Config config;
+    const size_t before = msToSamples(config.onset_ms);
+    const size_t after = msToSamples(config.hangover_ms);
+
+    std::vector<uint8_t> detected(active.size(), 0);
+    for (const VoiceActivityDetector::Segment& segment : vad.segments()) {
+        for (uint32_t i = segment.start_sample; i < segment.end_sample && i < detected.size(); ++i) {
+            detected[i] = 1;
+        }
+    }
+
+    std::vector<uint8_t> collar(active.size(), 0);
+    for (size_t i = 0; i < active.size(); ++i) {
+        if (active[i] && (i == 0 || !active[i - 1])) {
+            for (size_t j = i > before ? i - before : 0; j < i; ++j) {
+                collar[j] = 1;
+            }
+        }
+        if (active[i] && (i + 1 == active.size() || !active[i + 1])) {
+            for (size_t j = i + 1; j < std::min(active.size(), i + 1 + after); ++j) {
+                collar[j] = 1;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < active.size(); ++i) {
+        if (active[i]) {
+            detected[i] ? ++total.true_positive : ++total.false_negative;
+        } else if (detected[i] && !collar[i]) {
+            ++total.false_positive;
+        }
+    }
+}
+
+uint32_t speechMs(const VoiceActivityDetector& vad) {
+    uint32_t samples = 0;
+    for (const VoiceActivityDetector::Segment& segment : vad.segments()) {
+        samples += segment.end_sample - segment.start_sample;
+    }
+    return samples * 1000 / kRate;
+}
+
+const Noise kNoises[] = {Noise::White, Noise::Pink, Noise::Hum};
+const char* const kNoiseNames[] = {"white", "pink", "hum"};
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_corpus_precision_recall() {
+    const double snrs[] = {20.0, 10.0, 6.0};
+    const double levels[] = {1500.0, 6000.0};
+    Score overall;
+
+    for (double snr : snrs) {
+        Score per_snr;
+        for (size_t n = 0; n < 3; ++n) {
+            for (uint32_t seed = 1; seed <= 6; ++seed) {
+                const Clip clip = makeUtterance(seed * 7919 + static_cast<uint32_t>(snr), levels[seed % 2]);
+                VoiceActivityDetector vad;
+                feed(vad, mix(clip, kNoises[n], snr, seed * 31 + static_cast<uint32_t>(n)));
+                score(vad, clip.active, per_snr);
+            }
+        }
+        printf("VAD corpus SNR %4.1f dB: precision %.3f recall %.3f\n", snr, per_snr.precision(), per_snr.recall());
+        overall.true_positive += per_snr.true_positive;
+        overall.false_positive += per_snr.false_positive;
+        overall.false_negative += per_snr.false_negative;
+
+        if (snr >= 10.0) {
+            TEST_ASSERT_GREATER_OR_EQUAL(0.90, per_snr.precision());
+            TEST_ASSERT_GREATER_OR_EQUAL(0.90, per_snr.recall());
+        }
+    }
+    printf("VAD corpus overall: precision %.3f recall %.3f\n", overall.precision(), overall.recall());
+    TEST_ASSERT_GREATER_OR_EQUAL(0.85, overall.precision());
+    TEST_ASSERT_GREATER_OR_EQUAL(0.85, overall.recall());
+}
+
+void test_noise_only_has_no_speech() {
+    for (size_t n = 0; n < 3; ++n) {
+        for (double rms : {30.0, 300.0, 1500.0}) {
+            VoiceActivityDetector vad;
+            feed(vad, toPcm(makeNoise(kNoises[n], msToSamples(10000), rms, 99 + static_cast<uint32_t>(rms))));
+            printf("VAD noise-only %-5s rms %6.0f: %u ms flagged\n", kNoiseNames[n], rms, (unsigned)speechMs(vad));
+            TEST_ASSERT_FALSE(vad.hasDetectedSpeech());
+        }
+    }
+}
+
+void test_noise_step_is_learned() {
+    // Background noise jumping by 12 dB (a fan switching on) opens one short
+    // segment; once it has stayed steady for stationary_ms the floor learns it
+    std::vector<float> noise = makeNoise(Noise::Pink, msToSamples(20000), 200, 5);
+    const std::vector<float> loud = makeNoise(Noise::Pink, msToSamples(16000), 800, 6);
+    std::copy(loud.begin(), loud.end(), noise.begin() + msToSamples(4000));
+    const std::vector<int16_t> pcm = toPcm(noise);
+
+    // The MicrophoneManager stop rule fires soon after the step, not at the end of the clip
+    VoiceActivityDetector vad;
+    size_t stopped_at = 0;
+    for (size_t offset = 0; offset < pcm.size(); offset += kChunkSamples) {
+        vad.process(pcm.data() + offset, std::min(kChunkSamples, pcm.size() - offset));
+        if (!stopped_at && vad.hasDetectedSpeech() && !vad.isSpeech() && vad.silenceMs() >= kEndSilenceMs) {
+            stopped_at = vad.processedSamples();
+        }
+    }
+    vad.finish();
+    const uint32_t stop_ms = static_cast<uint32_t>(stopped_at * 1000 / kRate);
+    printf("VAD noise +12 dB step: %u ms flagged, auto-stop at %u ms (step at 4000 ms)\n", (unsigned)speechMs(vad),
+           (unsigned)stop_ms);
+    TEST_ASSERT_LESS_OR_EQUAL(2500u, speechMs(vad));
+    TEST_ASSERT_LESS_OR_EQUAL(1u, vad.segments().size());
+    TEST_ASSERT_GREATER_THAN(0u, stopped_at);
+    TEST_ASSERT_LESS_OR_EQUAL(4000u + 2500u + kEndSilenceMs + 100u, stop_ms);
+}
+
+void test_long_utterance_is_not_learned() {
+    // Eight seconds of talking without a long pause: syllables never hold a
+    // level, so the floor stays put and the whole utterance is one segment
+    Rng rng(17);
+    Clip clip;
+    addSilence(clip, 800);
+    while (clip.signal.size() < msToSamples(8800)) {
+        addSyllable(clip, rng, 3000);
+        addSilence(clip, static_cast<uint32_t>(rng.range(20, 120)));
+    }
+    addSilence(clip, 1500);
+
+    VoiceActivityDetector vad;
+    feed(vad, mix(clip, Noise::Pink, 15.0, 9));
+    Score result;
+    score(vad, clip.active, result);
+    printf("VAD 8 s utterance: %u segments, recall %.3f\n", (unsigned)vad.segments().size(), result.recall());
+    TEST_ASSERT_EQUAL(1u, vad.segments().size());
+    TEST_ASSERT_GREATER_OR_EQUAL(0.95, result.recall());
+}
+
+void test_onset_is_confirmed_within_onset_time() {
+    Clip clip;
+    addSilence(clip, 1000);
+    Rng rng(3);
+    while (clip.signal.size() < msToSamples(2000)) {
+        addSyllable(clip, rng, 4000);
+    }
+    addSilence(clip, 1500);
+    const std::vector<int16_t> pcm = mix(clip, Noise::White, 20.0, 11);
+    const uint32_t speech_start = msToSamples(1000);
+
+    const VoiceActivityDetector::Config config;
+    const uint32_t frame = config.frame_samples;
+    VoiceActivityDetector vad;
+    uint32_t confirmed_at = 0;
+    for (size_t offset = 0; offset < pcm.size() && !confirmed_at; offset += frame) {
+        vad.process(pcm.data() + offset, std::min<size_t>(frame, pcm.size() - offset));
+        if (vad.isSpeech()) {
+            confirmed_at = vad.processedSamples();
+        }
+    }
+
+    TEST_ASSERT_GREATER_THAN(0u, confirmed_at);
+    TEST_ASSERT_LESS_OR_EQUAL(speech_start + msToSamples(config.onset_ms) + 2 * frame, confirmed_at);
+    TEST_ASSERT_EQUAL(1u, vad.segments().size());
+    // The segment starts at the first speech frame, not when it was confirmed
+    TEST_ASSERT_INT_WITHIN(frame, speech_start, vad.segments()[0].start_sample);
+}
+
+void test_short_click_is_rejected() {
+    std::vector<float> signal = makeNoise(Noise::White, msToSamples(2000), 40, 8);
+    for (size_t i = 0; i < msToSamples(16); ++i) {
+        signal[msToSamples(1000) + i] += (i % 2 ? -12000.0f : 12000.0f) * (1.0f - static_cast<float>(i) / msToSamples(16));
+    }
+    VoiceActivityDetector vad;
+    feed(vad, toPcm(signal));
+    TEST_ASSERT_FALSE(vad.hasDetectedSpeech());
+}
+
+void test_hangover_merges_short_pauses() {
+    Rng rng(21);
+    Clip clip;
+    addSilence(clip, 800);
+    addSyllable(clip, rng, 4000);
+    addSilence(clip, 200);          // Within the 320 ms hangover: same segment
+    addSyllable(clip, rng, 4000);
+    addSilence(clip, 700);          // Longer than the hangover: new segment
+    addSyllable(clip, rng, 4000);
+    addSilence(clip, 1000);
+
+    VoiceActivityDetector vad;
+    feed(vad, mix(clip, Noise::Pink, 20.0, 4));
+    TEST_ASSERT_EQUAL(2u, vad.segments().size());
+}
+
+// MicrophoneManager stops when !isSpeech() && silenceMs() >= vad_end_silence_ms
+void test_end_of_speech_stops_after_end_silence() {
+    Rng rng(42);
+    Clip clip;
+    addSilence(clip, 700);
+    for (int i = 0; i < 4; ++i) {
+        addSyllable(clip, rng, 3000);
+        addSilence(clip, 40);
+    }
+    addSilence(clip, 600);          // Mid-sentence pause shorter than the end silence
+    for (int i = 0; i < 4; ++i) {
+        addSyllable(clip, rng, 3000);
+        addSilence(clip, 40);
+    }
+    size_t speech_end = clip.active.size();
+    while (speech_end > 0 && !clip.active[speech_end - 1]) {
+        --speech_end;
+    }
+    addSilence(clip, 3000);
+    const std::vector<int16_t> pcm = mix(clip, Noise::White, 15.0, 77);
+
+    VoiceActivityDetector vad;
+    size_t stopped_at = 0;
+    for (size_t offset = 0; offset < pcm.size(); offset += kChunkSamples) {
+        vad.process(pcm.data() + offset, std::min(kChunkSamples, pcm.size() - offset));
+        if (vad.hasDetectedSpeech() && !vad.isSpeech() && vad.silenceMs() >= kEndSilenceMs) {
+            stopped_at = vad.processedSamples();
+            break;
+        }
+    }
+
+    TEST_ASSERT_GREATER_THAN(0u, stopped_at);
+    TEST_ASSERT_GREATER_THAN(speech_end, stopped_at);   // Not during the 600 ms pause
+    const uint32_t stop_delay_ms = static_cast<uint32_t>((stopped_at - speech_end) * 1000 / kRate);
+    printf("VAD end-of-speech stop %u ms after the last syllable\n", (unsigned)stop_delay_ms);
+    // The fading tail of the last syllable may fall below threshold one frame early
+    const VoiceActivityDetector::Config config;
+    TEST_ASSERT_GREATER_OR_EQUAL(kEndSilenceMs - config.frame_samples * 1000 / kRate, stop_delay_ms);
+    TEST_ASSERT_LESS_OR_EQUAL(kEndSilenceMs + (kChunkSamples + 2 * config.frame_samples) * 1000 / kRate,
+                              stop_delay_ms);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_corpus_precision_recall);
+    RUN_TEST(test_noise_only_has_no_speech);
+    RUN_TEST(test_noise_step_is_learned);
+    RUN_TEST(test_long_utterance_is_not_learned);
+    RUN_TEST(test_onset_is_confirmed_within_onset_time);
+    RUN_TEST(test_short_click_is_rejected);
+    RUN_TEST(test_hangover_merges_short_pauses);
+    RUN_TEST(test_end_of_speech_stops_after_end_silence);
+    return UNITY_END();
+}
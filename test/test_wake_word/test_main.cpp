@@ -0,0 +1,698 @@
+// Wake-word harness: LogMelFrontend + KeywordSpotter over WAV fixtures,
+// reporting detection rate, false accepts per hour and detection latency.
+//
+// The detection rule mirrors WakeWordService: an inference per 20 ms frame,
+// the mean of the last kSmoothing scores against the threshold, and the
+// frontend restarted after kRestartHoldoffMs once the keyword is detected.
+//
+// Without a trained model in the tree, the built-in run renders a synthetic
+// keyword and distractors to WAV and matches them with a template model in
+// the KWS1 format. To evaluate a real model:
+//
+//   WAKEWORD_MODEL=wakeword.kws WAKEWORD_FIXTURES=dir pio test -e native
+//
+// with 16 kHz mono 16-bit WAVs in dir/positive (one keyword per clip) and
+// dir/negative (anything else; long recordings give a better FA/h figure).
+
+#include <unity.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "core/keyword_spotter.h"
+#include "core/log_mel_frontend.h"
+#include "core/voice_activity_detector.h"
+
+namespace {
+
+constexpr uint32_t kRate = 16000;
+constexpr double kPi = 3.14159265358979323846;
+
+// WakeWordService settings
+constexpr uint8_t kSmoothing = 3;
+constexpr uint32_t kRestartHoldoffMs = 1500;
+constexpr uint8_t kDefaultThresholdPercent = 85;
+
+constexpr uint16_t kModelFrames = 32;      // 640 ms window
+constexpr uint8_t kModelInputShift = 5;
+constexpr int64_t kMatchFloorPercent = 60;  // Template score at probability 0.5
+
+uint32_t msToSamples(double ms) {
+    return static_cast<uint32_t>(ms * kRate / 1000);
+}
+
+double samplesToMs(double samples) {
+    return samples * 1000.0 / kRate;
+}
+
+// ---------------------------------------------------------------------------
+// WAV
+
+void put16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(static_cast<uint8_t>(value));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+void put32(std::vector<uint8_t>& out, uint32_t value) {
+    put16(out, static_cast<uint16_t>(value));
+    put16(out, static_cast<uint16_t>(value >> 16));
+}
+
+uint32_t get32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint16_t get16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+std::vector<uint8_t> encodeWav(const std::vector<int16_t>& samples) {
+    std::vector<uint8_t> out;
+    const uint32_t data_bytes = static_cast<uint32_t>(samples.size() * 2);
+    out.insert(out.end(), {'R', 'I', 'F', 'F'});
+    put32(out, 36 + data_bytes);
+    out.insert(out.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+    put32(out, 16);
+    put16(out, 1);              // PCM
+    put16(out, 1);              // Mono
+    put32(out, kRate);
+    put32(out, kRate * 2);
+    put16(out, 2);
+    put16(out, 16);
+    out.insert(out.end(), {'d', 'a', 't', 'a'});
+    put32(out, data_bytes);
+    for (int16_t sample : samples) {
+        put16(out, static_cast<uint16_t>(sample));
+    }
+    return out;
+}
+
+// 16 kHz mono 16-bit PCM only, like the microphone capture
+bool decodeWav(const std::vector<uint8_t>& bytes, std::vector<int16_t>& samples) {
+    if (bytes.size() < 12 || memcmp(bytes.data(), "RIFF", 4) != 0 || memcmp(bytes.data() + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+    bool format_ok = false;
+    size_t offset = 12;
+    while (offset + 8 <= bytes.size()) {
+        const uint8_t* chunk = bytes.data() + offset;
+        const uint32_t size = get32(chunk + 4);
+        const size_t body = offset + 8;
+        if (body + size > bytes.size()) {
+            return false;
+        }
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            format_ok = get16(chunk + 8) == 1 && get16(chunk + 10) == 1 && get32(chunk + 12) == kRate &&
+                        get16(chunk + 22) == 16;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!format_ok) {
+                return false;
+            }
+            samples.resize(size / 2);
+            for (size_t i = 0; i < samples.size(); ++i) {
+                samples[i] = static_cast<int16_t>(get16(bytes.data() + body + i * 2));
+            }
+            return true;
+        }
+        offset = body + size + (size & 1);
+    }
+    return false;
+}
+
+bool readWavFile(const std::filesystem::path& path, std::vector<int16_t>& samples) {
+    std::ifstream file(path, std::ios::binary);
+    const std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return decodeWav(bytes, samples);
+}
+
+// ---------------------------------------------------------------------------
+// Detector
+
+struct Run {
+    std::vector<size_t> detections;     // Sample index at which each detection fired
+};
+
+class Harness {
+public:
+    bool load(const uint8_t* blob, size_t size, uint8_t threshold_percent = kDefaultThresholdPercent) {
+        threshold_ = static_cast<uint32_t>(threshold_percent) * 255 / 100;
+        return frontend_.configure(LogMelFrontend::Config()) && spotter_.loadModel(blob, size) &&
+               spotter_.bins() == frontend_.numBins();
+    }
+
+    Run run(const std::vector<int16_t>& samples) {
+        Run result;
+        restart();
+        size_t offset = 0;
+        while (offset < samples.size()) {
+            offset += frontend_.push(samples.data() + offset, samples.size() - offset);
+            if (!frontend_.frameReady()) {
+                continue;
+            }
+            spotter_.pushFrame(frontend_.features());
+            if (!spotter_.ready()) {
+                continue;
+            }
+            scores_[pos_] = spotter_.infer();
+            pos_ = (pos_ + 1) % kSmoothing;
+
+            uint32_t sum = 0;
+            for (uint8_t score : scores_) {
+                sum += score;
+            }
+            if (sum / kSmoothing >= threshold_) {
+                result.detections.push_back(offset);
+                offset += msToSamples(kRestartHoldoffMs);
+                restart();
+            }
+        }
+        return result;
+    }
+
+private:
+    void restart() {
+        frontend_.reset();
+        spotter_.reset();
+        memset(scores_, 0, sizeof(scores_));
+        pos_ = 0;
+    }
+
+    LogMelFrontend frontend_;
+    KeywordSpotter spotter_;
+    uint32_t threshold_ = 0;
+    uint8_t scores_[kSmoothing] = {};
+    uint8_t pos_ = 0;
+};
+
+struct Report {
+    uint32_t positives = 0;
+    uint32_t detected = 0;
+    double negative_ms = 0;
+    uint32_t false_accepts = 0;
+    std::vector<double> latencies_ms;
+
+    double falseAcceptsPerHour() const {
+        return negative_ms > 0 ? false_accepts * 3600000.0 / negative_ms : 0.0;
+    }
+
+    void print(const char* name) const {
+        std::vector<double> sorted = latencies_ms;
+        std::sort(sorted.begin(), sorted.end());
+        printf("%s: detected %u/%u (%.1f%%), %u false accepts in %.1f min (%.1f/h)\n", name, detected, positives,
+               positives ? 100.0 * detected / positives : 0.0, false_accepts, negative_ms / 60000.0,
+               falseAcceptsPerHour());
+        if (!sorted.empty()) {
+            printf("%s: latency after keyword end min %.0f / median %.0f / max %.0f ms\n", name, sorted.front(),
+                   sorted[sorted.size() / 2], sorted.back());
+        }
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Synthetic audio
+
+class Rng {
+public:
+    explicit Rng(uint32_t seed) : state_(seed ? seed : 1) {}
+    uint32_t next() {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 17;
+        state_ ^= state_ << 5;
+        return state_;
+    }
+    double uniform() { return (next() >> 8) / 16777216.0; }
+    double range(double lo, double hi) { return lo + (hi - lo) * uniform(); }
+    double gauss() {
+        double sum = 0;
+        for (int i = 0; i < 6; ++i) {
+            sum += uniform();
+        }
+        return (sum - 3.0) * 1.41421356;
+    }
+
+private:
+    uint32_t state_;
+};
+
+// Voiced sound with gliding pitch and two gliding formants
+struct Voice {
+    double ms;
+    double f0_from, f0_to;
+    double formant1_from, formant1_to;
+    double formant2_from, formant2_to;
+};
+
+void appendVoice(std::vector<float>& out, const Voice& voice, double level) {
+    const size_t length = msToSamples(voice.ms);
+    double phase = 0;
+    for (size_t i = 0; i < length; ++i) {
+        const double t = static_cast<double>(i) / length;
+        const double envelope = std::min(1.0, std::min(t, 1.0 - t) * 8.0);
+        const double f0 = voice.f0_from + (voice.f0_to - voice.f0_from) * t;
+        const double formant1 = voice.formant1_from + (voice.formant1_to - voice.formant1_from) * t;
+        const double formant2 = voice.formant2_from + (voice.formant2_to - voice.formant2_from) * t;
+        phase += 2 * kPi * f0 / kRate;
+        double sample = 0;
+        for (int harmonic = 1; harmonic * f0 < 4000; ++harmonic) {
+            const double frequency = harmonic * f0;
+            const double weight = std::exp(-std::pow((frequency - formant1) / 150.0, 2)) +
+                                  0.7 * std::exp(-std::pow((frequency - formant2) / 200.0, 2)) + 0.02;
+            sample += weight * std::sin(phase * harmonic);
+        }
+        out.push_back(static_cast<float>(sample * envelope * level * 0.5));
+    }
+}
+
+void appendSilence(std::vector<float>& out, double ms) {
+    out.insert(out.end(), msToSamples(ms), 0.0f);
+}
+
+struct Variation {
+    double stretch = 1.0;       // Duration scale
+    double pitch = 1.0;         // Pitch and formant scale
+    double level = 6000.0;
+};
+
+// Two syllables: "hey" with a rising second formant, then a falling "ko"
+std::vector<float> renderKeyword(const Variation& v) {
+    std::vector<float> out;
+    appendVoice(out, {220 * v.stretch, 150 * v.pitch, 170 * v.pitch, 650 * v.pitch, 500 * v.pitch,
+                      1500 * v.pitch, 2300 * v.pitch}, v.level);
+    appendSilence(out, 50 * v.stretch);
+    appendVoice(out, {260 * v.stretch, 180 * v.pitch, 120 * v.pitch, 500 * v.pitch, 400 * v.pitch,
+                      1000 * v.pitch, 800 * v.pitch}, v.level);
+    return out;
+}
+
+std::vector<float> renderBabble(Rng& rng, double ms, double level) {
+    std::vector<float> out;
+    while (samplesToMs(out.size()) < ms) {
+        const double f0 = rng.range(90, 240);
+        Voice voice{rng.range(80, 300), f0, f0 * rng.range(0.8, 1.2), rng.range(300, 900), rng.range(300, 900),
+                    rng.range(800, 2600), rng.range(800, 2600)};
+        appendVoice(out, voice, level * rng.range(0.3, 1.0));
+        appendSilence(out, rng.range(20, 250));
+    }
+    out.resize(msToSamples(ms));
+    return out;
+}
+
+std::vector<float> renderNoise(Rng& rng, double ms, double rms, bool pink) {
+    std::vector<float> out(msToSamples(ms));
+    double b0 = 0, b1 = 0, b2 = 0;
+    for (float& sample : out) {
+        const double white = rng.gauss();
+        if (pink) {
+            b0 = 0.99765 * b0 + white * 0.0990460;
+            b1 = 0.96300 * b1 + white * 0.2965164;
+            b2 = 0.57000 * b2 + white * 1.0526913;
+            sample = static_cast<float>((b0 + b1 + b2 + white * 0.1848) * 0.3 * rms);
+        } else {
+            sample = static_cast<float>(white * rms);
+        }
+    }
+    return out;
+}
+
+void mixInto(std::vector<float>& base, const std::vector<float>& signal, size_t at) {
+    for (size_t i = 0; i < signal.size() && at + i < base.size(); ++i) {
+        base[at + i] += signal[i];
+    }
+}
+
+std::vector<int16_t> toPcm(const std::vector<float>& signal) {
+    std::vector<int16_t> pcm(signal.size());
+    for (size_t i = 0; i < signal.size(); ++i) {
+        pcm[i] = static_cast<int16_t>(std::max(-32768.0f, std::min(32767.0f, std::round(signal[i]))));
+    }
+    return pcm;
+}
+
+// Every fixture goes through the WAV encoder and decoder, as files would
+std::vector<int16_t> throughWav(const std::vector<float>& signal) {
+    std::vector<int16_t> decoded;
+    TEST_ASSERT_TRUE(decodeWav(encodeWav(toPcm(signal)), decoded));
+    return decoded;
+}
+
+// ---------------------------------------------------------------------------
+// Template model
+
+// Quantized model input for the window ending right after the keyword, as
+// the last inference before a detection sees it
+std::vector<int32_t> keywordWindow(const std::vector<float>& keyword, uint8_t& bins) {
+    LogMelFrontend frontend;
+    frontend.configure(LogMelFrontend::Config());
+    bins = frontend.numBins();
+
+    std::vector<float> padded(msToSamples(kModelFrames * 20 + 200), 0.0f);
+    mixInto(padded, keyword, padded.size() - keyword.size() - msToSamples(40));
+    const std::vector<int16_t> pcm = toPcm(padded);
+
+    std::vector<int32_t> frames;
+    size_t offset = 0;
+    while (offset < pcm.size()) {
+        offset += frontend.push(pcm.data() + offset, pcm.size() - offset);
+        if (frontend.frameReady()) {
+            for (uint8_t b = 0; b < bins; ++b) {
+                frames.push_back(std::min(127, frontend.features()[b] >> kModelInputShift));
+            }
+        }
+    }
+    frames.erase(frames.begin(), frames.end() - static_cast<size_t>(kModelFrames) * bins);
+    return frames;
+}
+
+// Matched filter over the log-mel window, averaged over tempo and pitch
+// variants of the keyword. Per frame the weights are the features minus
+// their mean, so a level change cancels out.
+// Logit = (correlation + bias) >> shift against a constant 0 logit.
+std::vector<uint32_t> buildTemplateModel() {
+    uint8_t bins = 0;
+    std::vector<std::vector<int32_t>> windows;
+    for (double stretch : {0.92, 1.0, 1.08}) {
+        for (double pitch : {0.96, 1.0, 1.04}) {
+            Variation variation;
+            variation.stretch = stretch;
+            variation.pitch = pitch;
+            windows.push_back(keywordWindow(renderKeyword(variation), bins));
+        }
+    }
+
+    const size_t inputs = windows[0].size();
+    std::vector<double> shaped(inputs, 0.0);
+    for (const std::vector<int32_t>& window : windows) {
+        for (size_t f = 0; f < kModelFrames; ++f) {
+            double mean = 0;
+            for (uint8_t b = 0; b < bins; ++b) {
+                mean += static_cast<double>(window[f * bins + b]) / bins;
+            }
+            for (uint8_t b = 0; b < bins; ++b) {
+                shaped[f * bins + b] += window[f * bins + b] - mean;
+            }
+        }
+    }
+
+    // Any speech shares the long-term spectral shape: remove it (and a linear
+    // tilt) from every frame so only the keyword's own pattern is matched
+    std::vector<double> profile(bins, 0.0);
+    {
+        Rng rng(77);
+        std::vector<float> babble = renderBabble(rng, 20000, 5000);
+        mixInto(babble, renderNoise(rng, 20000, 60, true), 0);
+        const std::vector<int16_t> pcm = toPcm(babble);
+        LogMelFrontend frontend;
+        frontend.configure(LogMelFrontend::Config());
+        size_t offset = 0;
+        while (offset < pcm.size()) {
+            offset += frontend.push(pcm.data() + offset, pcm.size() - offset);
+            if (frontend.frameReady()) {
+                for (uint8_t b = 0; b < bins; ++b) {
+                    profile[b] += frontend.features()[b] >> kModelInputShift;
+                }
+            }
+        }
+    }
+    std::vector<std::vector<double>> basis(2, std::vector<double>(bins));
+    for (uint8_t b = 0; b < bins; ++b) {
+        basis[0][b] = b - (bins - 1) / 2.0;
+        basis[1][b] = profile[b];
+    }
+    for (size_t k = 0; k < basis.size(); ++k) {
+        // Zero mean, then Gram-Schmidt against the earlier vectors
+        double mean = 0;
+        for (double value : basis[k]) {
+            mean += value / bins;
+        }
+        for (double& value : basis[k]) {
+            value -= mean;
+        }
+        for (size_t j = 0; j < k; ++j) {
+            double dot = 0;
+            for (uint8_t b = 0; b < bins; ++b) {
+                dot += basis[k][b] * basis[j][b];
+            }
+            for (uint8_t b = 0; b < bins; ++b) {
+                basis[k][b] -= dot * basis[j][b];
+            }
+        }
+        double norm = 0;
+        for (double value : basis[k]) {
+            norm += value * value;
+        }
+        for (double& value : basis[k]) {
+            value /= std::sqrt(norm);
+        }
+    }
+
+    for (size_t f = 0; f < kModelFrames; ++f) {
+        double* frame = &shaped[f * bins];
+        for (const std::vector<double>& vector : basis) {
+            double dot = 0;
+            for (uint8_t b = 0; b < bins; ++b) {
+                dot += frame[b] * vector[b];
+            }
+            for (uint8_t b = 0; b < bins; ++b) {
+                frame[b] -= dot * vector[b];
+            }
+        }
+    }
+
+    double peak = 1e-9;
+    for (double value : shaped) {
+        peak = std::max(peak, std::fabs(value));
+    }
+    std::vector<int8_t> weights(inputs);
+    for (size_t f = 0; f < kModelFrames; ++f) {
+        int32_t sum = 0;
+        for (uint8_t b = 0; b < bins; ++b) {
+            weights[f * bins + b] = static_cast<int8_t>(std::lround(shaped[f * bins + b] * 120 / peak));
+            sum += weights[f * bins + b];
+        }
+        // Rounding must not leave a per-frame offset, or the response follows the level
+        for (uint8_t b = 0; sum != 0; b = static_cast<uint8_t>((b + 1) % bins)) {
+            const int8_t step = sum > 0 ? -1 : 1;
+            weights[f * bins + b] = static_cast<int8_t>(weights[f * bins + b] + step);
+            sum += step;
+        }
+    }
+
+    // Calibrated on the variants: logit 0 at kMatchFloor of their mean match, ~40 at a full match
+    int64_t match = 0;
+    for (const std::vector<int32_t>& window : windows) {
+        for (size_t i = 0; i < inputs; ++i) {
+            match += static_cast<int64_t>(weights[i]) * window[i];
+        }
+    }
+    match /= static_cast<int64_t>(windows.size());
+    const int32_t bias = -static_cast<int32_t>(match * kMatchFloorPercent / 100);
+    uint8_t shift = 0;
+    while (((match * (100 - kMatchFloorPercent) / 100) >> shift) > 40) {
+        ++shift;
+    }
+
+    std::vector<uint8_t> blob;
+    put32(blob, KeywordSpotter::kModelMagic);
+    put16(blob, kModelFrames);
+    blob.push_back(bins);
+    blob.push_back(1);                  // Layers
+    put16(blob, 0);                     // input_offset
+    blob.push_back(kModelInputShift);
+    blob.push_back(0);                  // keyword_index
+    const float output_scale = 0.15f;
+    uint8_t scale_bytes[4];
+    memcpy(scale_bytes, &output_scale, 4);
+    blob.insert(blob.end(), scale_bytes, scale_bytes + 4);
+
+    put16(blob, static_cast<uint16_t>(inputs));
+    put16(blob, 2);
+    blob.push_back(shift);
+    blob.push_back(0);                  // No ReLU
+    put16(blob, 0);
+    put32(blob, static_cast<uint32_t>(bias));
+    put32(blob, 0);
+    for (int8_t weight : weights) {
+        blob.push_back(static_cast<uint8_t>(weight));
+    }
+    blob.insert(blob.end(), inputs, 0);     // "Other" logit stays 0
+    while (blob.size() % 4) {
+        blob.push_back(0);
+    }
+
+    // KeywordSpotter needs a 4-byte aligned blob
+    std::vector<uint32_t> aligned(blob.size() / 4);
+    memcpy(aligned.data(), blob.data(), blob.size());
+    return aligned;
+}
+
+std::vector<uint32_t>& templateModel() {
+    static std::vector<uint32_t> model = buildTemplateModel();
+    return model;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_wav_round_trip() {
+    std::vector<int16_t> samples = {0, 1, -1, 32767, -32768, 1234};
+    std::vector<uint8_t> bytes = encodeWav(samples);
+    std::vector<int16_t> decoded;
+    TEST_ASSERT_TRUE(decodeWav(bytes, decoded));
+    TEST_ASSERT_EQUAL(samples.size(), decoded.size());
+    for (size_t i = 0; i < samples.size(); ++i) {
+        TEST_ASSERT_EQUAL(samples[i], decoded[i]);
+    }
+
+    bytes[24] = 0x44;   // 44.1 kHz sample rate is rejected
+    bytes[25] = 0xAC;
+    TEST_ASSERT_FALSE(decodeWav(bytes, decoded));
+    TEST_ASSERT_FALSE(decodeWav(std::vector<uint8_t>(bytes.begin(), bytes.begin() + 30), decoded));
+}
+
+void test_template_model_loads() {
+    const std::vector<uint32_t>& model = templateModel();
+    const uint8_t* blob = reinterpret_cast<const uint8_t*>(model.data());
+    const size_t size = model.size() * 4;
+
+    KeywordSpotter spotter;
+    TEST_ASSERT_TRUE(spotter.loadModel(blob, size));
+    TEST_ASSERT_EQUAL(kModelFrames, spotter.frames());
+    TEST_ASSERT_EQUAL(static_cast<size_t>(kModelFrames) * 40 * 2, spotter.macsPerInference());
+    TEST_ASSERT_FALSE(spotter.loadModel(blob, size - 4));
+    TEST_ASSERT_FALSE(spotter.isLoaded());
+}
+
+void test_synthetic_fixtures() {
+    const std::vector<uint32_t>& model = templateModel();
+    Harness harness;
+    TEST_ASSERT_TRUE(harness.load(reinterpret_cast<const uint8_t*>(model.data()), model.size() * 4));
+    Report report;
+
+    // Positives: level, tempo and pitch variations over pink or white noise
+    Rng rng(2024);
+    for (int i = 0; i < 48; ++i) {
+        Variation variation;
+        variation.stretch = rng.range(0.9, 1.1);
+        variation.pitch = rng.range(0.94, 1.06);
+        variation.level = 6000.0 * std::pow(10.0, rng.range(-24, 6) / 20.0);
+        const std::vector<float> keyword = renderKeyword(variation);
+        const double snr_db = i % 3 == 0 ? 10.0 : 20.0;
+        const double keyword_rms = variation.level * 0.25;
+
+        std::vector<float> clip = renderNoise(rng, 3000, keyword_rms / std::pow(10.0, snr_db / 20.0), i % 2 == 0);
+        const size_t at = msToSamples(rng.range(800, 1600));
+        mixInto(clip, keyword, at);
+
+        const Run run = harness.run(throughWav(clip));
+        ++report.positives;
+        if (!run.detections.empty()) {
+            ++report.detected;
+            report.latencies_ms.push_back(samplesToMs(static_cast<double>(run.detections[0]) - (at + keyword.size())));
+        }
+    }
+
+    // Negatives: babble, noise, and the keyword's syllables in the wrong order or alone
+    for (int minute = 0; minute < 10; ++minute) {
+        std::vector<float> audio = renderNoise(rng, 60000, 60.0 * (1 + minute % 4), minute % 2 == 0);
+        mixInto(audio, renderBabble(rng, 60000, 5000), 0);
+
+        std::vector<float> near_miss;
+        const std::vector<float> keyword = renderKeyword(Variation());
+        const size_t split = msToSamples(220);
+        near_miss.assign(keyword.begin() + split, keyword.end());
+        near_miss.insert(near_miss.end(), keyword.begin(), keyword.begin() + split);
+        mixInto(audio, near_miss, msToSamples(15000));
+        mixInto(audio, std::vector<float>(keyword.begin(), keyword.begin() + split), msToSamples(30000));
+        std::vector<float> reversed(keyword.rbegin(), keyword.rend());
+        mixInto(audio, reversed, msToSamples(45000));
+
+        const Run run = harness.run(throughWav(audio));
+        report.negative_ms += 60000;
+        report.false_accepts += static_cast<uint32_t>(run.detections.size());
+    }
+
+    report.print("Wake word (synthetic)");
+    // A linear template is far weaker than a trained model; these bounds only
+    // guard the frontend, spotter and detection rule against regressions
+    TEST_ASSERT_GREATER_OR_EQUAL(46u, report.detected);
+    TEST_ASSERT_LESS_OR_EQUAL(12.0, report.falseAcceptsPerHour());
+    for (double latency : report.latencies_ms) {
+        TEST_ASSERT_LESS_OR_EQUAL(150.0, latency);
+    }
+}
+
+void test_fixture_directory() {
+    const char* model_path = getenv("WAKEWORD_MODEL");
+    const char* fixtures = getenv("WAKEWORD_FIXTURES");
+    if (!model_path || !fixtures) {
+        TEST_IGNORE_MESSAGE("Set WAKEWORD_MODEL and WAKEWORD_FIXTURES to evaluate a trained model");
+        return;
+    }
+
+    std::ifstream file(model_path, std::ios::binary);
+    const std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::vector<uint32_t> model((bytes.size() + 3) / 4);
+    memcpy(model.data(), bytes.data(), bytes.size());
+    Harness harness;
+    const char* threshold = getenv("WAKEWORD_THRESHOLD");
+    TEST_ASSERT_TRUE_MESSAGE(harness.load(reinterpret_cast<const uint8_t*>(model.data()), bytes.size(),
+                                          threshold ? static_cast<uint8_t>(atoi(threshold)) : kDefaultThresholdPercent),
+                             "Model does not load or does not match the 40-bin frontend");
+
+    Report report;
+    const std::filesystem::path root(fixtures);
+    for (const char* kind : {"positive", "negative"}) {
+        const std::filesystem::path dir = root / kind;
+        if (!std::filesystem::is_directory(dir)) {
+            continue;
+        }
+        for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+            std::vector<int16_t> samples;
+            if (entry.path().extension() != ".wav" || !readWavFile(entry.path(), samples)) {
+                printf("Skipping %s (not 16 kHz mono 16-bit PCM)\n", entry.path().string().c_str());
+                continue;
+            }
+            const Run run = harness.run(samples);
+            if (strcmp(kind, "negative") == 0) {
+                report.negative_ms += samplesToMs(static_cast<double>(samples.size()));
+                report.false_accepts += static_cast<uint32_t>(run.detections.size());
+                continue;
+            }
+
+            ++report.positives;
+            if (run.detections.empty()) {
+                printf("Missed %s\n", entry.path().filename().string().c_str());
+                continue;
+            }
+            ++report.detected;
+            // Unlabelled clips: the keyword ends where the VAD segment before the detection ends
+            VoiceActivityDetector vad;
+            vad.process(samples.data(), std::min(samples.size(), run.detections[0]));
+            vad.finish();
+            if (!vad.segments().empty()) {
+                const double end = vad.segments().back().end_sample;
+                report.latencies_ms.push_back(samplesToMs(static_cast<double>(run.detections[0]) - end));
+            }
+        }
+    }
+    report.print("Wake word (fixtures)");
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_wav_round_trip);
+    RUN_TEST(test_template_model_loads);
+    RUN_TEST(test_synthetic_fixtures);
+    RUN_TEST(test_fixture_directory);
+    return UNITY_END();
+}